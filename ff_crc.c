@@ -35,6 +35,25 @@
 
 #include "ff_headers.h"
 
+#if ( ffconfigCRC_HARDWARE != 0 )
+    #if defined( __ARM_FEATURE_CRC32 )
+        #include <arm_acle.h>
+        #define ffCRC32_ARM      1
+    #elif defined( __PCLMUL__ ) && defined( __SSE4_1__ )
+        #include <wmmintrin.h>
+        #include <smmintrin.h>
+        #define ffCRC32_PCLMUL    1
+    #endif
+#endif /* ffconfigCRC_HARDWARE */
+
+#ifndef ffCRC32_ARM
+    #define ffCRC32_ARM       0
+#endif
+
+#ifndef ffCRC32_PCLMUL
+    #define ffCRC32_PCLMUL    0
+#endif
+
 /*static*/ const uint32_t crc32_table[ 256 ] =
 {
     0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F,
@@ -82,11 +101,479 @@
     0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
 };
 
+#if ( ffconfigCRC_SLICING_BY_8 != 0 )
+
+/* crc32_slice_table[ k - 1 ][ x ] is the CRC of byte 'x' followed by 'k' zero
+ * bytes, so that 8 bytes can be handled with 8 independent look-ups.  The
+ * table for k = 0 is crc32_table. */
+    static const uint32_t crc32_slice_table[ 7 ][ 256 ] =
+    {
+        {
+            0x00000000, 0x191B3141, 0x32366282, 0x2B2D53C3, 0x646CC504, 0x7D77F445,
+            0x565AA786, 0x4F4196C7, 0xC8D98A08, 0xD1C2BB49, 0xFAEFE88A, 0xE3F4D9CB,
+            0xACB54F0C, 0xB5AE7E4D, 0x9E832D8E, 0x87981CCF, 0x4AC21251, 0x53D92310,
+            0x78F470D3, 0x61EF4192, 0x2EAED755, 0x37B5E614, 0x1C98B5D7, 0x05838496,
+            0x821B9859, 0x9B00A918, 0xB02DFADB, 0xA936CB9A, 0xE6775D5D, 0xFF6C6C1C,
+            0xD4413FDF, 0xCD5A0E9E, 0x958424A2, 0x8C9F15E3, 0xA7B24620, 0xBEA97761,
+            0xF1E8E1A6, 0xE8F3D0E7, 0xC3DE8324, 0xDAC5B265, 0x5D5DAEAA, 0x44469FEB,
+            0x6F6BCC28, 0x7670FD69, 0x39316BAE, 0x202A5AEF, 0x0B07092C, 0x121C386D,
+            0xDF4636F3, 0xC65D07B2, 0xED705471, 0xF46B6530, 0xBB2AF3F7, 0xA231C2B6,
+            0x891C9175, 0x9007A034, 0x179FBCFB, 0x0E848DBA, 0x25A9DE79, 0x3CB2EF38,
+            0x73F379FF, 0x6AE848BE, 0x41C51B7D, 0x58DE2A3C, 0xF0794F05, 0xE9627E44,
+            0xC24F2D87, 0xDB541CC6, 0x94158A01, 0x8D0EBB40, 0xA623E883, 0xBF38D9C2,
+            0x38A0C50D, 0x21BBF44C, 0x0A96A78F, 0x138D96CE, 0x5CCC0009, 0x45D73148,
+            0x6EFA628B, 0x77E153CA, 0xBABB5D54, 0xA3A06C15, 0x888D3FD6, 0x91960E97,
+            0xDED79850, 0xC7CCA911, 0xECE1FAD2, 0xF5FACB93, 0x7262D75C, 0x6B79E61D,
+            0x4054B5DE, 0x594F849F, 0x160E1258, 0x0F152319, 0x243870DA, 0x3D23419B,
+            0x65FD6BA7, 0x7CE65AE6, 0x57CB0925, 0x4ED03864, 0x0191AEA3, 0x188A9FE2,
+            0x33A7CC21, 0x2ABCFD60, 0xAD24E1AF, 0xB43FD0EE, 0x9F12832D, 0x8609B26C,
+            0xC94824AB, 0xD05315EA, 0xFB7E4629, 0xE2657768, 0x2F3F79F6, 0x362448B7,
+            0x1D091B74, 0x04122A35, 0x4B53BCF2, 0x52488DB3, 0x7965DE70, 0x607EEF31,
+            0xE7E6F3FE, 0xFEFDC2BF, 0xD5D0917C, 0xCCCBA03D, 0x838A36FA, 0x9A9107BB,
+            0xB1BC5478, 0xA8A76539, 0x3B83984B, 0x2298A90A, 0x09B5FAC9, 0x10AECB88,
+            0x5FEF5D4F, 0x46F46C0E, 0x6DD93FCD, 0x74C20E8C, 0xF35A1243, 0xEA412302,
+            0xC16C70C1, 0xD8774180, 0x9736D747, 0x8E2DE606, 0xA500B5C5, 0xBC1B8484,
+            0x71418A1A, 0x685ABB5B, 0x4377E898, 0x5A6CD9D9, 0x152D4F1E, 0x0C367E5F,
+            0x271B2D9C, 0x3E001CDD, 0xB9980012, 0xA0833153, 0x8BAE6290, 0x92B553D1,
+            0xDDF4C516, 0xC4EFF457, 0xEFC2A794, 0xF6D996D5, 0xAE07BCE9, 0xB71C8DA8,
+            0x9C31DE6B, 0x852AEF2A, 0xCA6B79ED, 0xD37048AC, 0xF85D1B6F, 0xE1462A2E,
+            0x66DE36E1, 0x7FC507A0, 0x54E85463, 0x4DF36522, 0x02B2F3E5, 0x1BA9C2A4,
+            0x30849167, 0x299FA026, 0xE4C5AEB8, 0xFDDE9FF9, 0xD6F3CC3A, 0xCFE8FD7B,
+            0x80A96BBC, 0x99B25AFD, 0xB29F093E, 0xAB84387F, 0x2C1C24B0, 0x350715F1,
+            0x1E2A4632, 0x07317773, 0x4870E1B4, 0x516BD0F5, 0x7A468336, 0x635DB277,
+            0xCBFAD74E, 0xD2E1E60F, 0xF9CCB5CC, 0xE0D7848D, 0xAF96124A, 0xB68D230B,
+            0x9DA070C8, 0x84BB4189, 0x03235D46, 0x1A386C07, 0x31153FC4, 0x280E0E85,
+            0x674F9842, 0x7E54A903, 0x5579FAC0, 0x4C62CB81, 0x8138C51F, 0x9823F45E,
+            0xB30EA79D, 0xAA1596DC, 0xE554001B, 0xFC4F315A, 0xD7626299, 0xCE7953D8,
+            0x49E14F17, 0x50FA7E56, 0x7BD72D95, 0x62CC1CD4, 0x2D8D8A13, 0x3496BB52,
+            0x1FBBE891, 0x06A0D9D0, 0x5E7EF3EC, 0x4765C2AD, 0x6C48916E, 0x7553A02F,
+            0x3A1236E8, 0x230907A9, 0x0824546A, 0x113F652B, 0x96A779E4, 0x8FBC48A5,
+            0xA4911B66, 0xBD8A2A27, 0xF2CBBCE0, 0xEBD08DA1, 0xC0FDDE62, 0xD9E6EF23,
+            0x14BCE1BD, 0x0DA7D0FC, 0x268A833F, 0x3F91B27E, 0x70D024B9, 0x69CB15F8,
+            0x42E6463B, 0x5BFD777A, 0xDC656BB5, 0xC57E5AF4, 0xEE530937, 0xF7483876,
+            0xB809AEB1, 0xA1129FF0, 0x8A3FCC33, 0x9324FD72
+        },
+        {
+            0x00000000, 0x01C26A37, 0x0384D46E, 0x0246BE59, 0x0709A8DC, 0x06CBC2EB,
+            0x048D7CB2, 0x054F1685, 0x0E1351B8, 0x0FD13B8F, 0x0D9785D6, 0x0C55EFE1,
+            0x091AF964, 0x08D89353, 0x0A9E2D0A, 0x0B5C473D, 0x1C26A370, 0x1DE4C947,
+            0x1FA2771E, 0x1E601D29, 0x1B2F0BAC, 0x1AED619B, 0x18ABDFC2, 0x1969B5F5,
+            0x1235F2C8, 0x13F798FF, 0x11B126A6, 0x10734C91, 0x153C5A14, 0x14FE3023,
+            0x16B88E7A, 0x177AE44D, 0x384D46E0, 0x398F2CD7, 0x3BC9928E, 0x3A0BF8B9,
+            0x3F44EE3C, 0x3E86840B, 0x3CC03A52, 0x3D025065, 0x365E1758, 0x379C7D6F,
+            0x35DAC336, 0x3418A901, 0x3157BF84, 0x3095D5B3, 0x32D36BEA, 0x331101DD,
+            0x246BE590, 0x25A98FA7, 0x27EF31FE, 0x262D5BC9, 0x23624D4C, 0x22A0277B,
+            0x20E69922, 0x2124F315, 0x2A78B428, 0x2BBADE1F, 0x29FC6046, 0x283E0A71,
+            0x2D711CF4, 0x2CB376C3, 0x2EF5C89A, 0x2F37A2AD, 0x709A8DC0, 0x7158E7F7,
+            0x731E59AE, 0x72DC3399, 0x7793251C, 0x76514F2B, 0x7417F172, 0x75D59B45,
+            0x7E89DC78, 0x7F4BB64F, 0x7D0D0816, 0x7CCF6221, 0x798074A4, 0x78421E93,
+            0x7A04A0CA, 0x7BC6CAFD, 0x6CBC2EB0, 0x6D7E4487, 0x6F38FADE, 0x6EFA90E9,
+            0x6BB5866C, 0x6A77EC5B, 0x68315202, 0x69F33835, 0x62AF7F08, 0x636D153F,
+            0x612BAB66, 0x60E9C151, 0x65A6D7D4, 0x6464BDE3, 0x662203BA, 0x67E0698D,
+            0x48D7CB20, 0x4915A117, 0x4B531F4E, 0x4A917579, 0x4FDE63FC, 0x4E1C09CB,
+            0x4C5AB792, 0x4D98DDA5, 0x46C49A98, 0x4706F0AF, 0x45404EF6, 0x448224C1,
+            0x41CD3244, 0x400F5873, 0x4249E62A, 0x438B8C1D, 0x54F16850, 0x55330267,
+            0x5775BC3E, 0x56B7D609, 0x53F8C08C, 0x523AAABB, 0x507C14E2, 0x51BE7ED5,
+            0x5AE239E8, 0x5B2053DF, 0x5966ED86, 0x58A487B1, 0x5DEB9134, 0x5C29FB03,
+            0x5E6F455A, 0x5FAD2F6D, 0xE1351B80, 0xE0F771B7, 0xE2B1CFEE, 0xE373A5D9,
+            0xE63CB35C, 0xE7FED96B, 0xE5B86732, 0xE47A0D05, 0xEF264A38, 0xEEE4200F,
+            0xECA29E56, 0xED60F461, 0xE82FE2E4, 0xE9ED88D3, 0xEBAB368A, 0xEA695CBD,
+            0xFD13B8F0, 0xFCD1D2C7, 0xFE976C9E, 0xFF5506A9, 0xFA1A102C, 0xFBD87A1B,
+            0xF99EC442, 0xF85CAE75, 0xF300E948, 0xF2C2837F, 0xF0843D26, 0xF1465711,
+            0xF4094194, 0xF5CB2BA3, 0xF78D95FA, 0xF64FFFCD, 0xD9785D60, 0xD8BA3757,
+            0xDAFC890E, 0xDB3EE339, 0xDE71F5BC, 0xDFB39F8B, 0xDDF521D2, 0xDC374BE5,
+            0xD76B0CD8, 0xD6A966EF, 0xD4EFD8B6, 0xD52DB281, 0xD062A404, 0xD1A0CE33,
+            0xD3E6706A, 0xD2241A5D, 0xC55EFE10, 0xC49C9427, 0xC6DA2A7E, 0xC7184049,
+            0xC25756CC, 0xC3953CFB, 0xC1D382A2, 0xC011E895, 0xCB4DAFA8, 0xCA8FC59F,
+            0xC8C97BC6, 0xC90B11F1, 0xCC440774, 0xCD866D43, 0xCFC0D31A, 0xCE02B92D,
+            0x91AF9640, 0x906DFC77, 0x922B422E, 0x93E92819, 0x96A63E9C, 0x976454AB,
+            0x9522EAF2, 0x94E080C5, 0x9FBCC7F8, 0x9E7EADCF, 0x9C381396, 0x9DFA79A1,
+            0x98B56F24, 0x99770513, 0x9B31BB4A, 0x9AF3D17D, 0x8D893530, 0x8C4B5F07,
+            0x8E0DE15E, 0x8FCF8B69, 0x8A809DEC, 0x8B42F7DB, 0x89044982, 0x88C623B5,
+            0x839A6488, 0x82580EBF, 0x801EB0E6, 0x81DCDAD1, 0x8493CC54, 0x8551A663,
+            0x8717183A, 0x86D5720D, 0xA9E2D0A0, 0xA820BA97, 0xAA6604CE, 0xABA46EF9,
+            0xAEEB787C, 0xAF29124B, 0xAD6FAC12, 0xACADC625, 0xA7F18118, 0xA633EB2F,
+            0xA4755576, 0xA5B73F41, 0xA0F829C4, 0xA13A43F3, 0xA37CFDAA, 0xA2BE979D,
+            0xB5C473D0, 0xB40619E7, 0xB640A7BE, 0xB782CD89, 0xB2CDDB0C, 0xB30FB13B,
+            0xB1490F62, 0xB08B6555, 0xBBD72268, 0xBA15485F, 0xB853F606, 0xB9919C31,
+            0xBCDE8AB4, 0xBD1CE083, 0xBF5A5EDA, 0xBE9834ED
+        },
+        {
+            0x00000000, 0xB8BC6765, 0xAA09C88B, 0x12B5AFEE, 0x8F629757, 0x37DEF032,
+            0x256B5FDC, 0x9DD738B9, 0xC5B428EF, 0x7D084F8A, 0x6FBDE064, 0xD7018701,
+            0x4AD6BFB8, 0xF26AD8DD, 0xE0DF7733, 0x58631056, 0x5019579F, 0xE8A530FA,
+            0xFA109F14, 0x42ACF871, 0xDF7BC0C8, 0x67C7A7AD, 0x75720843, 0xCDCE6F26,
+            0x95AD7F70, 0x2D111815, 0x3FA4B7FB, 0x8718D09E, 0x1ACFE827, 0xA2738F42,
+            0xB0C620AC, 0x087A47C9, 0xA032AF3E, 0x188EC85B, 0x0A3B67B5, 0xB28700D0,
+            0x2F503869, 0x97EC5F0C, 0x8559F0E2, 0x3DE59787, 0x658687D1, 0xDD3AE0B4,
+            0xCF8F4F5A, 0x7733283F, 0xEAE41086, 0x525877E3, 0x40EDD80D, 0xF851BF68,
+            0xF02BF8A1, 0x48979FC4, 0x5A22302A, 0xE29E574F, 0x7F496FF6, 0xC7F50893,
+            0xD540A77D, 0x6DFCC018, 0x359FD04E, 0x8D23B72B, 0x9F9618C5, 0x272A7FA0,
+            0xBAFD4719, 0x0241207C, 0x10F48F92, 0xA848E8F7, 0x9B14583D, 0x23A83F58,
+            0x311D90B6, 0x89A1F7D3, 0x1476CF6A, 0xACCAA80F, 0xBE7F07E1, 0x06C36084,
+            0x5EA070D2, 0xE61C17B7, 0xF4A9B859, 0x4C15DF3C, 0xD1C2E785, 0x697E80E0,
+            0x7BCB2F0E, 0xC377486B, 0xCB0D0FA2, 0x73B168C7, 0x6104C729, 0xD9B8A04C,
+            0x446F98F5, 0xFCD3FF90, 0xEE66507E, 0x56DA371B, 0x0EB9274D, 0xB6054028,
+            0xA4B0EFC6, 0x1C0C88A3, 0x81DBB01A, 0x3967D77F, 0x2BD27891, 0x936E1FF4,
+            0x3B26F703, 0x839A9066, 0x912F3F88, 0x299358ED, 0xB4446054, 0x0CF80731,
+            0x1E4DA8DF, 0xA6F1CFBA, 0xFE92DFEC, 0x462EB889, 0x549B1767, 0xEC277002,
+            0x71F048BB, 0xC94C2FDE, 0xDBF98030, 0x6345E755, 0x6B3FA09C, 0xD383C7F9,
+            0xC1366817, 0x798A0F72, 0xE45D37CB, 0x5CE150AE, 0x4E54FF40, 0xF6E89825,
+            0xAE8B8873, 0x1637EF16, 0x048240F8, 0xBC3E279D, 0x21E91F24, 0x99557841,
+            0x8BE0D7AF, 0x335CB0CA, 0xED59B63B, 0x55E5D15E, 0x47507EB0, 0xFFEC19D5,
+            0x623B216C, 0xDA874609, 0xC832E9E7, 0x708E8E82, 0x28ED9ED4, 0x9051F9B1,
+            0x82E4565F, 0x3A58313A, 0xA78F0983, 0x1F336EE6, 0x0D86C108, 0xB53AA66D,
+            0xBD40E1A4, 0x05FC86C1, 0x1749292F, 0xAFF54E4A, 0x322276F3, 0x8A9E1196,
+            0x982BBE78, 0x2097D91D, 0x78F4C94B, 0xC048AE2E, 0xD2FD01C0, 0x6A4166A5,
+            0xF7965E1C, 0x4F2A3979, 0x5D9F9697, 0xE523F1F2, 0x4D6B1905, 0xF5D77E60,
+            0xE762D18E, 0x5FDEB6EB, 0xC2098E52, 0x7AB5E937, 0x680046D9, 0xD0BC21BC,
+            0x88DF31EA, 0x3063568F, 0x22D6F961, 0x9A6A9E04, 0x07BDA6BD, 0xBF01C1D8,
+            0xADB46E36, 0x15080953, 0x1D724E9A, 0xA5CE29FF, 0xB77B8611, 0x0FC7E174,
+            0x9210D9CD, 0x2AACBEA8, 0x38191146, 0x80A57623, 0xD8C66675, 0x607A0110,
+            0x72CFAEFE, 0xCA73C99B, 0x57A4F122, 0xEF189647, 0xFDAD39A9, 0x45115ECC,
+            0x764DEE06, 0xCEF18963, 0xDC44268D, 0x64F841E8, 0xF92F7951, 0x41931E34,
+            0x5326B1DA, 0xEB9AD6BF, 0xB3F9C6E9, 0x0B45A18C, 0x19F00E62, 0xA14C6907,
+            0x3C9B51BE, 0x842736DB, 0x96929935, 0x2E2EFE50, 0x2654B999, 0x9EE8DEFC,
+            0x8C5D7112, 0x34E11677, 0xA9362ECE, 0x118A49AB, 0x033FE645, 0xBB838120,
+            0xE3E09176, 0x5B5CF613, 0x49E959FD, 0xF1553E98, 0x6C820621, 0xD43E6144,
+            0xC68BCEAA, 0x7E37A9CF, 0xD67F4138, 0x6EC3265D, 0x7C7689B3, 0xC4CAEED6,
+            0x591DD66F, 0xE1A1B10A, 0xF3141EE4, 0x4BA87981, 0x13CB69D7, 0xAB770EB2,
+            0xB9C2A15C, 0x017EC639, 0x9CA9FE80, 0x241599E5, 0x36A0360B, 0x8E1C516E,
+            0x866616A7, 0x3EDA71C2, 0x2C6FDE2C, 0x94D3B949, 0x090481F0, 0xB1B8E695,
+            0xA30D497B, 0x1BB12E1E, 0x43D23E48, 0xFB6E592D, 0xE9DBF6C3, 0x516791A6,
+            0xCCB0A91F, 0x740CCE7A, 0x66B96194, 0xDE0506F1
+        },
+        {
+            0x00000000, 0x3D6029B0, 0x7AC05360, 0x47A07AD0, 0xF580A6C0, 0xC8E08F70,
+            0x8F40F5A0, 0xB220DC10, 0x30704BC1, 0x0D106271, 0x4AB018A1, 0x77D03111,
+            0xC5F0ED01, 0xF890C4B1, 0xBF30BE61, 0x825097D1, 0x60E09782, 0x5D80BE32,
+            0x1A20C4E2, 0x2740ED52, 0x95603142, 0xA80018F2, 0xEFA06222, 0xD2C04B92,
+            0x5090DC43, 0x6DF0F5F3, 0x2A508F23, 0x1730A693, 0xA5107A83, 0x98705333,
+            0xDFD029E3, 0xE2B00053, 0xC1C12F04, 0xFCA106B4, 0xBB017C64, 0x866155D4,
+            0x344189C4, 0x0921A074, 0x4E81DAA4, 0x73E1F314, 0xF1B164C5, 0xCCD14D75,
+            0x8B7137A5, 0xB6111E15, 0x0431C205, 0x3951EBB5, 0x7EF19165, 0x4391B8D5,
+            0xA121B886, 0x9C419136, 0xDBE1EBE6, 0xE681C256, 0x54A11E46, 0x69C137F6,
+            0x2E614D26, 0x13016496, 0x9151F347, 0xAC31DAF7, 0xEB91A027, 0xD6F18997,
+            0x64D15587, 0x59B17C37, 0x1E1106E7, 0x23712F57, 0x58F35849, 0x659371F9,
+            0x22330B29, 0x1F532299, 0xAD73FE89, 0x9013D739, 0xD7B3ADE9, 0xEAD38459,
+            0x68831388, 0x55E33A38, 0x124340E8, 0x2F236958, 0x9D03B548, 0xA0639CF8,
+            0xE7C3E628, 0xDAA3CF98, 0x3813CFCB, 0x0573E67B, 0x42D39CAB, 0x7FB3B51B,
+            0xCD93690B, 0xF0F340BB, 0xB7533A6B, 0x8A3313DB, 0x0863840A, 0x3503ADBA,
+            0x72A3D76A, 0x4FC3FEDA, 0xFDE322CA, 0xC0830B7A, 0x872371AA, 0xBA43581A,
+            0x9932774D, 0xA4525EFD, 0xE3F2242D, 0xDE920D9D, 0x6CB2D18D, 0x51D2F83D,
+            0x167282ED, 0x2B12AB5D, 0xA9423C8C, 0x9422153C, 0xD3826FEC, 0xEEE2465C,
+            0x5CC29A4C, 0x61A2B3FC, 0x2602C92C, 0x1B62E09C, 0xF9D2E0CF, 0xC4B2C97F,
+            0x8312B3AF, 0xBE729A1F, 0x0C52460F, 0x31326FBF, 0x7692156F, 0x4BF23CDF,
+            0xC9A2AB0E, 0xF4C282BE, 0xB362F86E, 0x8E02D1DE, 0x3C220DCE, 0x0142247E,
+            0x46E25EAE, 0x7B82771E, 0xB1E6B092, 0x8C869922, 0xCB26E3F2, 0xF646CA42,
+            0x44661652, 0x79063FE2, 0x3EA64532, 0x03C66C82, 0x8196FB53, 0xBCF6D2E3,
+            0xFB56A833, 0xC6368183, 0x74165D93, 0x49767423, 0x0ED60EF3, 0x33B62743,
+            0xD1062710, 0xEC660EA0, 0xABC67470, 0x96A65DC0, 0x248681D0, 0x19E6A860,
+            0x5E46D2B0, 0x6326FB00, 0xE1766CD1, 0xDC164561, 0x9BB63FB1, 0xA6D61601,
+            0x14F6CA11, 0x2996E3A1, 0x6E369971, 0x5356B0C1, 0x70279F96, 0x4D47B626,
+            0x0AE7CCF6, 0x3787E546, 0x85A73956, 0xB8C710E6, 0xFF676A36, 0xC2074386,
+            0x4057D457, 0x7D37FDE7, 0x3A978737, 0x07F7AE87, 0xB5D77297, 0x88B75B27,
+            0xCF1721F7, 0xF2770847, 0x10C70814, 0x2DA721A4, 0x6A075B74, 0x576772C4,
+            0xE547AED4, 0xD8278764, 0x9F87FDB4, 0xA2E7D404, 0x20B743D5, 0x1DD76A65,
+            0x5A7710B5, 0x67173905, 0xD537E515, 0xE857CCA5, 0xAFF7B675, 0x92979FC5,
+            0xE915E8DB, 0xD475C16B, 0x93D5BBBB, 0xAEB5920B, 0x1C954E1B, 0x21F567AB,
+            0x66551D7B, 0x5B3534CB, 0xD965A31A, 0xE4058AAA, 0xA3A5F07A, 0x9EC5D9CA,
+            0x2CE505DA, 0x11852C6A, 0x562556BA, 0x6B457F0A, 0x89F57F59, 0xB49556E9,
+            0xF3352C39, 0xCE550589, 0x7C75D999, 0x4115F029, 0x06B58AF9, 0x3BD5A349,
+            0xB9853498, 0x84E51D28, 0xC34567F8, 0xFE254E48, 0x4C059258, 0x7165BBE8,
+            0x36C5C138, 0x0BA5E888, 0x28D4C7DF, 0x15B4EE6F, 0x521494BF, 0x6F74BD0F,
+            0xDD54611F, 0xE03448AF, 0xA794327F, 0x9AF41BCF, 0x18A48C1E, 0x25C4A5AE,
+            0x6264DF7E, 0x5F04F6CE, 0xED242ADE, 0xD044036E, 0x97E479BE, 0xAA84500E,
+            0x4834505D, 0x755479ED, 0x32F4033D, 0x0F942A8D, 0xBDB4F69D, 0x80D4DF2D,
+            0xC774A5FD, 0xFA148C4D, 0x78441B9C, 0x4524322C, 0x028448FC, 0x3FE4614C,
+            0x8DC4BD5C, 0xB0A494EC, 0xF704EE3C, 0xCA64C78C
+        },
+        {
+            0x00000000, 0xCB5CD3A5, 0x4DC8A10B, 0x869472AE, 0x9B914216, 0x50CD91B3,
+            0xD659E31D, 0x1D0530B8, 0xEC53826D, 0x270F51C8, 0xA19B2366, 0x6AC7F0C3,
+            0x77C2C07B, 0xBC9E13DE, 0x3A0A6170, 0xF156B2D5, 0x03D6029B, 0xC88AD13E,
+            0x4E1EA390, 0x85427035, 0x9847408D, 0x531B9328, 0xD58FE186, 0x1ED33223,
+            0xEF8580F6, 0x24D95353, 0xA24D21FD, 0x6911F258, 0x7414C2E0, 0xBF481145,
+            0x39DC63EB, 0xF280B04E, 0x07AC0536, 0xCCF0D693, 0x4A64A43D, 0x81387798,
+            0x9C3D4720, 0x57619485, 0xD1F5E62B, 0x1AA9358E, 0xEBFF875B, 0x20A354FE,
+            0xA6372650, 0x6D6BF5F5, 0x706EC54D, 0xBB3216E8, 0x3DA66446, 0xF6FAB7E3,
+            0x047A07AD, 0xCF26D408, 0x49B2A6A6, 0x82EE7503, 0x9FEB45BB, 0x54B7961E,
+            0xD223E4B0, 0x197F3715, 0xE82985C0, 0x23755665, 0xA5E124CB, 0x6EBDF76E,
+            0x73B8C7D6, 0xB8E41473, 0x3E7066DD, 0xF52CB578, 0x0F580A6C, 0xC404D9C9,
+            0x4290AB67, 0x89CC78C2, 0x94C9487A, 0x5F959BDF, 0xD901E971, 0x125D3AD4,
+            0xE30B8801, 0x28575BA4, 0xAEC3290A, 0x659FFAAF, 0x789ACA17, 0xB3C619B2,
+            0x35526B1C, 0xFE0EB8B9, 0x0C8E08F7, 0xC7D2DB52, 0x4146A9FC, 0x8A1A7A59,
+            0x971F4AE1, 0x5C439944, 0xDAD7EBEA, 0x118B384F, 0xE0DD8A9A, 0x2B81593F,
+            0xAD152B91, 0x6649F834, 0x7B4CC88C, 0xB0101B29, 0x36846987, 0xFDD8BA22,
+            0x08F40F5A, 0xC3A8DCFF, 0x453CAE51, 0x8E607DF4, 0x93654D4C, 0x58399EE9,
+            0xDEADEC47, 0x15F13FE2, 0xE4A78D37, 0x2FFB5E92, 0xA96F2C3C, 0x6233FF99,
+            0x7F36CF21, 0xB46A1C84, 0x32FE6E2A, 0xF9A2BD8F, 0x0B220DC1, 0xC07EDE64,
+            0x46EAACCA, 0x8DB67F6F, 0x90B34FD7, 0x5BEF9C72, 0xDD7BEEDC, 0x16273D79,
+            0xE7718FAC, 0x2C2D5C09, 0xAAB92EA7, 0x61E5FD02, 0x7CE0CDBA, 0xB7BC1E1F,
+            0x31286CB1, 0xFA74BF14, 0x1EB014D8, 0xD5ECC77D, 0x5378B5D3, 0x98246676,
+            0x852156CE, 0x4E7D856B, 0xC8E9F7C5, 0x03B52460, 0xF2E396B5, 0x39BF4510,
+            0xBF2B37BE, 0x7477E41B, 0x6972D4A3, 0xA22E0706, 0x24BA75A8, 0xEFE6A60D,
+            0x1D661643, 0xD63AC5E6, 0x50AEB748, 0x9BF264ED, 0x86F75455, 0x4DAB87F0,
+            0xCB3FF55E, 0x006326FB, 0xF135942E, 0x3A69478B, 0xBCFD3525, 0x77A1E680,
+            0x6AA4D638, 0xA1F8059D, 0x276C7733, 0xEC30A496, 0x191C11EE, 0xD240C24B,
+            0x54D4B0E5, 0x9F886340, 0x828D53F8, 0x49D1805D, 0xCF45F2F3, 0x04192156,
+            0xF54F9383, 0x3E134026, 0xB8873288, 0x73DBE12D, 0x6EDED195, 0xA5820230,
+            0x2316709E, 0xE84AA33B, 0x1ACA1375, 0xD196C0D0, 0x5702B27E, 0x9C5E61DB,
+            0x815B5163, 0x4A0782C6, 0xCC93F068, 0x07CF23CD, 0xF6999118, 0x3DC542BD,
+            0xBB513013, 0x700DE3B6, 0x6D08D30E, 0xA65400AB, 0x20C07205, 0xEB9CA1A0,
+            0x11E81EB4, 0xDAB4CD11, 0x5C20BFBF, 0x977C6C1A, 0x8A795CA2, 0x41258F07,
+            0xC7B1FDA9, 0x0CED2E0C, 0xFDBB9CD9, 0x36E74F7C, 0xB0733DD2, 0x7B2FEE77,
+            0x662ADECF, 0xAD760D6A, 0x2BE27FC4, 0xE0BEAC61, 0x123E1C2F, 0xD962CF8A,
+            0x5FF6BD24, 0x94AA6E81, 0x89AF5E39, 0x42F38D9C, 0xC467FF32, 0x0F3B2C97,
+            0xFE6D9E42, 0x35314DE7, 0xB3A53F49, 0x78F9ECEC, 0x65FCDC54, 0xAEA00FF1,
+            0x28347D5F, 0xE368AEFA, 0x16441B82, 0xDD18C827, 0x5B8CBA89, 0x90D0692C,
+            0x8DD55994, 0x46898A31, 0xC01DF89F, 0x0B412B3A, 0xFA1799EF, 0x314B4A4A,
+            0xB7DF38E4, 0x7C83EB41, 0x6186DBF9, 0xAADA085C, 0x2C4E7AF2, 0xE712A957,
+            0x15921919, 0xDECECABC, 0x585AB812, 0x93066BB7, 0x8E035B0F, 0x455F88AA,
+            0xC3CBFA04, 0x089729A1, 0xF9C19B74, 0x329D48D1, 0xB4093A7F, 0x7F55E9DA,
+            0x6250D962, 0xA90C0AC7, 0x2F987869, 0xE4C4ABCC
+        },
+        {
+            0x00000000, 0xA6770BB4, 0x979F1129, 0x31E81A9D, 0xF44F2413, 0x52382FA7,
+            0x63D0353A, 0xC5A73E8E, 0x33EF4E67, 0x959845D3, 0xA4705F4E, 0x020754FA,
+            0xC7A06A74, 0x61D761C0, 0x503F7B5D, 0xF64870E9, 0x67DE9CCE, 0xC1A9977A,
+            0xF0418DE7, 0x56368653, 0x9391B8DD, 0x35E6B369, 0x040EA9F4, 0xA279A240,
+            0x5431D2A9, 0xF246D91D, 0xC3AEC380, 0x65D9C834, 0xA07EF6BA, 0x0609FD0E,
+            0x37E1E793, 0x9196EC27, 0xCFBD399C, 0x69CA3228, 0x582228B5, 0xFE552301,
+            0x3BF21D8F, 0x9D85163B, 0xAC6D0CA6, 0x0A1A0712, 0xFC5277FB, 0x5A257C4F,
+            0x6BCD66D2, 0xCDBA6D66, 0x081D53E8, 0xAE6A585C, 0x9F8242C1, 0x39F54975,
+            0xA863A552, 0x0E14AEE6, 0x3FFCB47B, 0x998BBFCF, 0x5C2C8141, 0xFA5B8AF5,
+            0xCBB39068, 0x6DC49BDC, 0x9B8CEB35, 0x3DFBE081, 0x0C13FA1C, 0xAA64F1A8,
+            0x6FC3CF26, 0xC9B4C492, 0xF85CDE0F, 0x5E2BD5BB, 0x440B7579, 0xE27C7ECD,
+            0xD3946450, 0x75E36FE4, 0xB044516A, 0x16335ADE, 0x27DB4043, 0x81AC4BF7,
+            0x77E43B1E, 0xD19330AA, 0xE07B2A37, 0x460C2183, 0x83AB1F0D, 0x25DC14B9,
+            0x14340E24, 0xB2430590, 0x23D5E9B7, 0x85A2E203, 0xB44AF89E, 0x123DF32A,
+            0xD79ACDA4, 0x71EDC610, 0x4005DC8D, 0xE672D739, 0x103AA7D0, 0xB64DAC64,
+            0x87A5B6F9, 0x21D2BD4D, 0xE47583C3, 0x42028877, 0x73EA92EA, 0xD59D995E,
+            0x8BB64CE5, 0x2DC14751, 0x1C295DCC, 0xBA5E5678, 0x7FF968F6, 0xD98E6342,
+            0xE86679DF, 0x4E11726B, 0xB8590282, 0x1E2E0936, 0x2FC613AB, 0x89B1181F,
+            0x4C162691, 0xEA612D25, 0xDB8937B8, 0x7DFE3C0C, 0xEC68D02B, 0x4A1FDB9F,
+            0x7BF7C102, 0xDD80CAB6, 0x1827F438, 0xBE50FF8C, 0x8FB8E511, 0x29CFEEA5,
+            0xDF879E4C, 0x79F095F8, 0x48188F65, 0xEE6F84D1, 0x2BC8BA5F, 0x8DBFB1EB,
+            0xBC57AB76, 0x1A20A0C2, 0x8816EAF2, 0x2E61E146, 0x1F89FBDB, 0xB9FEF06F,
+            0x7C59CEE1, 0xDA2EC555, 0xEBC6DFC8, 0x4DB1D47C, 0xBBF9A495, 0x1D8EAF21,
+            0x2C66B5BC, 0x8A11BE08, 0x4FB68086, 0xE9C18B32, 0xD82991AF, 0x7E5E9A1B,
+            0xEFC8763C, 0x49BF7D88, 0x78576715, 0xDE206CA1, 0x1B87522F, 0xBDF0599B,
+            0x8C184306, 0x2A6F48B2, 0xDC27385B, 0x7A5033EF, 0x4BB82972, 0xEDCF22C6,
+            0x28681C48, 0x8E1F17FC, 0xBFF70D61, 0x198006D5, 0x47ABD36E, 0xE1DCD8DA,
+            0xD034C247, 0x7643C9F3, 0xB3E4F77D, 0x1593FCC9, 0x247BE654, 0x820CEDE0,
+            0x74449D09, 0xD23396BD, 0xE3DB8C20, 0x45AC8794, 0x800BB91A, 0x267CB2AE,
+            0x1794A833, 0xB1E3A387, 0x20754FA0, 0x86024414, 0xB7EA5E89, 0x119D553D,
+            0xD43A6BB3, 0x724D6007, 0x43A57A9A, 0xE5D2712E, 0x139A01C7, 0xB5ED0A73,
+            0x840510EE, 0x22721B5A, 0xE7D525D4, 0x41A22E60, 0x704A34FD, 0xD63D3F49,
+            0xCC1D9F8B, 0x6A6A943F, 0x5B828EA2, 0xFDF58516, 0x3852BB98, 0x9E25B02C,
+            0xAFCDAAB1, 0x09BAA105, 0xFFF2D1EC, 0x5985DA58, 0x686DC0C5, 0xCE1ACB71,
+            0x0BBDF5FF, 0xADCAFE4B, 0x9C22E4D6, 0x3A55EF62, 0xABC30345, 0x0DB408F1,
+            0x3C5C126C, 0x9A2B19D8, 0x5F8C2756, 0xF9FB2CE2, 0xC813367F, 0x6E643DCB,
+            0x982C4D22, 0x3E5B4696, 0x0FB35C0B, 0xA9C457BF, 0x6C636931, 0xCA146285,
+            0xFBFC7818, 0x5D8B73AC, 0x03A0A617, 0xA5D7ADA3, 0x943FB73E, 0x3248BC8A,
+            0xF7EF8204, 0x519889B0, 0x6070932D, 0xC6079899, 0x304FE870, 0x9638E3C4,
+            0xA7D0F959, 0x01A7F2ED, 0xC400CC63, 0x6277C7D7, 0x539FDD4A, 0xF5E8D6FE,
+            0x647E3AD9, 0xC209316D, 0xF3E12BF0, 0x55962044, 0x90311ECA, 0x3646157E,
+            0x07AE0FE3, 0xA1D90457, 0x579174BE, 0xF1E67F0A, 0xC00E6597, 0x66796E23,
+            0xA3DE50AD, 0x05A95B19, 0x34414184, 0x92364A30
+        },
+        {
+            0x00000000, 0xCCAA009E, 0x4225077D, 0x8E8F07E3, 0x844A0EFA, 0x48E00E64,
+            0xC66F0987, 0x0AC50919, 0xD3E51BB5, 0x1F4F1B2B, 0x91C01CC8, 0x5D6A1C56,
+            0x57AF154F, 0x9B0515D1, 0x158A1232, 0xD92012AC, 0x7CBB312B, 0xB01131B5,
+            0x3E9E3656, 0xF23436C8, 0xF8F13FD1, 0x345B3F4F, 0xBAD438AC, 0x767E3832,
+            0xAF5E2A9E, 0x63F42A00, 0xED7B2DE3, 0x21D12D7D, 0x2B142464, 0xE7BE24FA,
+            0x69312319, 0xA59B2387, 0xF9766256, 0x35DC62C8, 0xBB53652B, 0x77F965B5,
+            0x7D3C6CAC, 0xB1966C32, 0x3F196BD1, 0xF3B36B4F, 0x2A9379E3, 0xE639797D,
+            0x68B67E9E, 0xA41C7E00, 0xAED97719, 0x62737787, 0xECFC7064, 0x205670FA,
+            0x85CD537D, 0x496753E3, 0xC7E85400, 0x0B42549E, 0x01875D87, 0xCD2D5D19,
+            0x43A25AFA, 0x8F085A64, 0x562848C8, 0x9A824856, 0x140D4FB5, 0xD8A74F2B,
+            0xD2624632, 0x1EC846AC, 0x9047414F, 0x5CED41D1, 0x299DC2ED, 0xE537C273,
+            0x6BB8C590, 0xA712C50E, 0xADD7CC17, 0x617DCC89, 0xEFF2CB6A, 0x2358CBF4,
+            0xFA78D958, 0x36D2D9C6, 0xB85DDE25, 0x74F7DEBB, 0x7E32D7A2, 0xB298D73C,
+            0x3C17D0DF, 0xF0BDD041, 0x5526F3C6, 0x998CF358, 0x1703F4BB, 0xDBA9F425,
+            0xD16CFD3C, 0x1DC6FDA2, 0x9349FA41, 0x5FE3FADF, 0x86C3E873, 0x4A69E8ED,
+            0xC4E6EF0E, 0x084CEF90, 0x0289E689, 0xCE23E617, 0x40ACE1F4, 0x8C06E16A,
+            0xD0EBA0BB, 0x1C41A025, 0x92CEA7C6, 0x5E64A758, 0x54A1AE41, 0x980BAEDF,
+            0x1684A93C, 0xDA2EA9A2, 0x030EBB0E, 0xCFA4BB90, 0x412BBC73, 0x8D81BCED,
+            0x8744B5F4, 0x4BEEB56A, 0xC561B289, 0x09CBB217, 0xAC509190, 0x60FA910E,
+            0xEE7596ED, 0x22DF9673, 0x281A9F6A, 0xE4B09FF4, 0x6A3F9817, 0xA6959889,
+            0x7FB58A25, 0xB31F8ABB, 0x3D908D58, 0xF13A8DC6, 0xFBFF84DF, 0x37558441,
+            0xB9DA83A2, 0x7570833C, 0x533B85DA, 0x9F918544, 0x111E82A7, 0xDDB48239,
+            0xD7718B20, 0x1BDB8BBE, 0x95548C5D, 0x59FE8CC3, 0x80DE9E6F, 0x4C749EF1,
+            0xC2FB9912, 0x0E51998C, 0x04949095, 0xC83E900B, 0x46B197E8, 0x8A1B9776,
+            0x2F80B4F1, 0xE32AB46F, 0x6DA5B38C, 0xA10FB312, 0xABCABA0B, 0x6760BA95,
+            0xE9EFBD76, 0x2545BDE8, 0xFC65AF44, 0x30CFAFDA, 0xBE40A839, 0x72EAA8A7,
+            0x782FA1BE, 0xB485A120, 0x3A0AA6C3, 0xF6A0A65D, 0xAA4DE78C, 0x66E7E712,
+            0xE868E0F1, 0x24C2E06F, 0x2E07E976, 0xE2ADE9E8, 0x6C22EE0B, 0xA088EE95,
+            0x79A8FC39, 0xB502FCA7, 0x3B8DFB44, 0xF727FBDA, 0xFDE2F2C3, 0x3148F25D,
+            0xBFC7F5BE, 0x736DF520, 0xD6F6D6A7, 0x1A5CD639, 0x94D3D1DA, 0x5879D144,
+            0x52BCD85D, 0x9E16D8C3, 0x1099DF20, 0xDC33DFBE, 0x0513CD12, 0xC9B9CD8C,
+            0x4736CA6F, 0x8B9CCAF1, 0x8159C3E8, 0x4DF3C376, 0xC37CC495, 0x0FD6C40B,
+            0x7AA64737, 0xB60C47A9, 0x3883404A, 0xF42940D4, 0xFEEC49CD, 0x32464953,
+            0xBCC94EB0, 0x70634E2E, 0xA9435C82, 0x65E95C1C, 0xEB665BFF, 0x27CC5B61,
+            0x2D095278, 0xE1A352E6, 0x6F2C5505, 0xA386559B, 0x061D761C, 0xCAB77682,
+            0x44387161, 0x889271FF, 0x825778E6, 0x4EFD7878, 0xC0727F9B, 0x0CD87F05,
+            0xD5F86DA9, 0x19526D37, 0x97DD6AD4, 0x5B776A4A, 0x51B26353, 0x9D1863CD,
+            0x1397642E, 0xDF3D64B0, 0x83D02561, 0x4F7A25FF, 0xC1F5221C, 0x0D5F2282,
+            0x079A2B9B, 0xCB302B05, 0x45BF2CE6, 0x89152C78, 0x50353ED4, 0x9C9F3E4A,
+            0x121039A9, 0xDEBA3937, 0xD47F302E, 0x18D530B0, 0x965A3753, 0x5AF037CD,
+            0xFF6B144A, 0x33C114D4, 0xBD4E1337, 0x71E413A9, 0x7B211AB0, 0xB78B1A2E,
+            0x39041DCD, 0xF5AE1D53, 0x2C8E0FFF, 0xE0240F61, 0x6EAB0882, 0xA201081C,
+            0xA8C40105, 0x646E019B, 0xEAE10678, 0x264B06E6
+        }
+    };
+#endif /* ffconfigCRC_SLICING_BY_8 */
+
+#if ( ffCRC32_PCLMUL != 0 )
+
+/* Fold blocks of 16 bytes into the CRC with carry-less multiplications, and
+ * reduce the result with Barrett's method.  'ulLength' must be a multiple of 16
+ * and at least 64.  The constants are powers of x modulo the bit-reflected
+ * CRC-32 polynomial, as described in Intel's "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction". */
+    static uint32_t prvCRC32Fold( uint32_t ulCRC,
+                                  const uint8_t * pucData,
+                                  uint32_t ulLength )
+    {
+        const __m128i xK1K2 = _mm_set_epi64x( 0x1C6E41596LL, 0x154442BD4LL );
+        const __m128i xK3K4 = _mm_set_epi64x( 0x0CCAA009ELL, 0x1751997D0LL );
+        const __m128i xK5 = _mm_set_epi64x( 0LL, 0x163CD6124LL );
+        const __m128i xPolyMu = _mm_set_epi64x( 0x1F7011641LL, 0x1DB710641LL );
+        const __m128i xMask32 = _mm_set_epi32( 0, 0, 0, -1 );
+        __m128i x1, x2, x3, x4, xTemp;
+
+        x1 = _mm_loadu_si128( ( const __m128i * ) ( pucData + 0 ) );
+        x2 = _mm_loadu_si128( ( const __m128i * ) ( pucData + 16 ) );
+        x3 = _mm_loadu_si128( ( const __m128i * ) ( pucData + 32 ) );
+        x4 = _mm_loadu_si128( ( const __m128i * ) ( pucData + 48 ) );
+        x1 = _mm_xor_si128( x1, _mm_cvtsi32_si128( ( int ) ulCRC ) );
+        pucData += 64;
+        ulLength -= 64;
+
+        /* Fold 64 bytes at a time. */
+        while( ulLength >= 64 )
+        {
+            xTemp = _mm_clmulepi64_si128( x1, xK1K2, 0x00 );
+            x1 = _mm_clmulepi64_si128( x1, xK1K2, 0x11 );
+            x1 = _mm_xor_si128( _mm_xor_si128( x1, xTemp ), _mm_loadu_si128( ( const __m128i * ) ( pucData + 0 ) ) );
+
+            xTemp = _mm_clmulepi64_si128( x2, xK1K2, 0x00 );
+            x2 = _mm_clmulepi64_si128( x2, xK1K2, 0x11 );
+            x2 = _mm_xor_si128( _mm_xor_si128( x2, xTemp ), _mm_loadu_si128( ( const __m128i * ) ( pucData + 16 ) ) );
+
+            xTemp = _mm_clmulepi64_si128( x3, xK1K2, 0x00 );
+            x3 = _mm_clmulepi64_si128( x3, xK1K2, 0x11 );
+            x3 = _mm_xor_si128( _mm_xor_si128( x3, xTemp ), _mm_loadu_si128( ( const __m128i * ) ( pucData + 32 ) ) );
+
+            xTemp = _mm_clmulepi64_si128( x4, xK1K2, 0x00 );
+            x4 = _mm_clmulepi64_si128( x4, xK1K2, 0x11 );
+            x4 = _mm_xor_si128( _mm_xor_si128( x4, xTemp ), _mm_loadu_si128( ( const __m128i * ) ( pucData + 48 ) ) );
+
+            pucData += 64;
+            ulLength -= 64;
+        }
+
+        /* Fold the four lanes into one. */
+        xTemp = _mm_clmulepi64_si128( x1, xK3K4, 0x00 );
+        x1 = _mm_clmulepi64_si128( x1, xK3K4, 0x11 );
+        x1 = _mm_xor_si128( _mm_xor_si128( x1, xTemp ), x2 );
+
+        xTemp = _mm_clmulepi64_si128( x1, xK3K4, 0x00 );
+        x1 = _mm_clmulepi64_si128( x1, xK3K4, 0x11 );
+        x1 = _mm_xor_si128( _mm_xor_si128( x1, xTemp ), x3 );
+
+        xTemp = _mm_clmulepi64_si128( x1, xK3K4, 0x00 );
+        x1 = _mm_clmulepi64_si128( x1, xK3K4, 0x11 );
+        x1 = _mm_xor_si128( _mm_xor_si128( x1, xTemp ), x4 );
+
+        /* Fold the remaining blocks of 16 bytes. */
+        while( ulLength >= 16 )
+        {
+            xTemp = _mm_clmulepi64_si128( x1, xK3K4, 0x00 );
+            x1 = _mm_clmulepi64_si128( x1, xK3K4, 0x11 );
+            x1 = _mm_xor_si128( _mm_xor_si128( x1, xTemp ), _mm_loadu_si128( ( const __m128i * ) pucData ) );
+            pucData += 16;
+            ulLength -= 16;
+        }
+
+        /* Reduce 128 bits to 64 bits. */
+        xTemp = _mm_clmulepi64_si128( x1, xK3K4, 0x10 );
+        x1 = _mm_xor_si128( _mm_srli_si128( x1, 8 ), xTemp );
+
+        /* Reduce 64 bits to 32 bits. */
+        xTemp = _mm_srli_si128( x1, 4 );
+        x1 = _mm_clmulepi64_si128( _mm_and_si128( x1, xMask32 ), xK5, 0x00 );
+        x1 = _mm_xor_si128( x1, xTemp );
+
+        /* Barrett reduction. */
+        xTemp = x1;
+        x1 = _mm_clmulepi64_si128( _mm_and_si128( x1, xMask32 ), xPolyMu, 0x10 );
+        x1 = _mm_clmulepi64_si128( _mm_and_si128( x1, xMask32 ), xPolyMu, 0x00 );
+        x1 = _mm_xor_si128( x1, xTemp );
+
+        return ( uint32_t ) _mm_extract_epi32( x1, 1 );
+    }
+#endif /* ffCRC32_PCLMUL */
+
 uint32_t FF_GetCRC32( uint8_t * pbyData,
                       uint32_t stLength )
 {
     register uint32_t crc = 0xFFFFFFFF;
 
+    #if ( ffCRC32_ARM != 0 )
+    {
+        uint64_t ullWord;
+
+        while( stLength >= 8U )
+        {
+            memcpy( &ullWord, pbyData, sizeof( ullWord ) );
+            crc = __crc32d( crc, ullWord );
+            pbyData += 8;
+            stLength -= 8U;
+        }
+
+        while( stLength-- != 0 )
+        {
+            crc = __crc32b( crc, *( pbyData++ ) );
+        }
+    }
+    #elif ( ffCRC32_PCLMUL != 0 )
+    {
+        if( stLength >= 64U )
+        {
+            uint32_t ulBlocks = stLength & ~15UL;
+
+            crc = prvCRC32Fold( crc, pbyData, ulBlocks );
+            pbyData += ulBlocks;
+            stLength -= ulBlocks;
+        }
+    }
+    #endif /* if ( ffCRC32_ARM != 0 ) */
+
+    #if ( ffconfigCRC_SLICING_BY_8 != 0 )
+    {
+        while( stLength >= 8U )
+        {
+            crc ^= ( ( uint32_t ) pbyData[ 0 ] ) |
+                   ( ( uint32_t ) pbyData[ 1 ] << 8 ) |
+                   ( ( uint32_t ) pbyData[ 2 ] << 16 ) |
+                   ( ( uint32_t ) pbyData[ 3 ] << 24 );
+            crc = crc32_slice_table[ 6 ][ crc & 0xFF ] ^
+                  crc32_slice_table[ 5 ][ ( crc >> 8 ) & 0xFF ] ^
+                  crc32_slice_table[ 4 ][ ( crc >> 16 ) & 0xFF ] ^
+                  crc32_slice_table[ 3 ][ crc >> 24 ] ^
+                  crc32_slice_table[ 2 ][ pbyData[ 4 ] ] ^
+                  crc32_slice_table[ 1 ][ pbyData[ 5 ] ] ^
+                  crc32_slice_table[ 0 ][ pbyData[ 6 ] ] ^
+                  crc32_table[ pbyData[ 7 ] ];
+            pbyData += 8;
+            stLength -= 8U;
+        }
+    }
+    #endif /* ffconfigCRC_SLICING_BY_8 */
+
     while( stLength-- != 0 )
     {
         crc = ( ( crc >> 8 ) & 0x00FFFFFF ) ^ crc32_table[ ( crc ^ *( pbyData++ ) ) & 0x000000FF ];
@@ -169,6 +656,253 @@ static const uint8_t crc16_table_high[ 256 ] =
     0x082, 0x042, 0x043, 0x083, 0x041, 0x081, 0x080, 0x040,
 };
 
+#if ( ffconfigCRC_SLICING_BY_8 != 0 )
+
+/* The same as crc32_slice_table, for FF_GetCRC16().  The table for k = 0 is
+ * formed by crc16_table_high and crc16_table_low. */
+    static const uint16_t crc16_slice_table[ 7 ][ 256 ] =
+    {
+        {
+            0x0000, 0x9001, 0x6001, 0xF000, 0xC002, 0x5003, 0xA003, 0x3002,
+            0xC007, 0x5006, 0xA006, 0x3007, 0x0005, 0x9004, 0x6004, 0xF005,
+            0xC00D, 0x500C, 0xA00C, 0x300D, 0x000F, 0x900E, 0x600E, 0xF00F,
+            0x000A, 0x900B, 0x600B, 0xF00A, 0xC008, 0x5009, 0xA009, 0x3008,
+            0xC019, 0x5018, 0xA018, 0x3019, 0x001B, 0x901A, 0x601A, 0xF01B,
+            0x001E, 0x901F, 0x601F, 0xF01E, 0xC01C, 0x501D, 0xA01D, 0x301C,
+            0x0014, 0x9015, 0x6015, 0xF014, 0xC016, 0x5017, 0xA017, 0x3016,
+            0xC013, 0x5012, 0xA012, 0x3013, 0x0011, 0x9010, 0x6010, 0xF011,
+            0xC031, 0x5030, 0xA030, 0x3031, 0x0033, 0x9032, 0x6032, 0xF033,
+            0x0036, 0x9037, 0x6037, 0xF036, 0xC034, 0x5035, 0xA035, 0x3034,
+            0x003C, 0x903D, 0x603D, 0xF03C, 0xC03E, 0x503F, 0xA03F, 0x303E,
+            0xC03B, 0x503A, 0xA03A, 0x303B, 0x0039, 0x9038, 0x6038, 0xF039,
+            0x0028, 0x9029, 0x6029, 0xF028, 0xC02A, 0x502B, 0xA02B, 0x302A,
+            0xC02F, 0x502E, 0xA02E, 0x302F, 0x002D, 0x902C, 0x602C, 0xF02D,
+            0xC025, 0x5024, 0xA024, 0x3025, 0x0027, 0x9026, 0x6026, 0xF027,
+            0x0022, 0x9023, 0x6023, 0xF022, 0xC020, 0x5021, 0xA021, 0x3020,
+            0xC061, 0x5060, 0xA060, 0x3061, 0x0063, 0x9062, 0x6062, 0xF063,
+            0x0066, 0x9067, 0x6067, 0xF066, 0xC064, 0x5065, 0xA065, 0x3064,
+            0x006C, 0x906D, 0x606D, 0xF06C, 0xC06E, 0x506F, 0xA06F, 0x306E,
+            0xC06B, 0x506A, 0xA06A, 0x306B, 0x0069, 0x9068, 0x6068, 0xF069,
+            0x0078, 0x9079, 0x6079, 0xF078, 0xC07A, 0x507B, 0xA07B, 0x307A,
+            0xC07F, 0x507E, 0xA07E, 0x307F, 0x007D, 0x907C, 0x607C, 0xF07D,
+            0xC075, 0x5074, 0xA074, 0x3075, 0x0077, 0x9076, 0x6076, 0xF077,
+            0x0072, 0x9073, 0x6073, 0xF072, 0xC070, 0x5071, 0xA071, 0x3070,
+            0x0050, 0x9051, 0x6051, 0xF050, 0xC052, 0x5053, 0xA053, 0x3052,
+            0xC057, 0x5056, 0xA056, 0x3057, 0x0055, 0x9054, 0x6054, 0xF055,
+            0xC05D, 0x505C, 0xA05C, 0x305D, 0x005F, 0x905E, 0x605E, 0xF05F,
+            0x005A, 0x905B, 0x605B, 0xF05A, 0xC058, 0x5059, 0xA059, 0x3058,
+            0xC049, 0x5048, 0xA048, 0x3049, 0x004B, 0x904A, 0x604A, 0xF04B,
+            0x004E, 0x904F, 0x604F, 0xF04E, 0xC04C, 0x504D, 0xA04D, 0x304C,
+            0x0044, 0x9045, 0x6045, 0xF044, 0xC046, 0x5047, 0xA047, 0x3046,
+            0xC043, 0x5042, 0xA042, 0x3043, 0x0041, 0x9040, 0x6040, 0xF041
+        },
+        {
+            0x0000, 0xC051, 0xC0A1, 0x00F0, 0xC141, 0x0110, 0x01E0, 0xC1B1,
+            0xC281, 0x02D0, 0x0220, 0xC271, 0x03C0, 0xC391, 0xC361, 0x0330,
+            0xC501, 0x0550, 0x05A0, 0xC5F1, 0x0440, 0xC411, 0xC4E1, 0x04B0,
+            0x0780, 0xC7D1, 0xC721, 0x0770, 0xC6C1, 0x0690, 0x0660, 0xC631,
+            0xCA01, 0x0A50, 0x0AA0, 0xCAF1, 0x0B40, 0xCB11, 0xCBE1, 0x0BB0,
+            0x0880, 0xC8D1, 0xC821, 0x0870, 0xC9C1, 0x0990, 0x0960, 0xC931,
+            0x0F00, 0xCF51, 0xCFA1, 0x0FF0, 0xCE41, 0x0E10, 0x0EE0, 0xCEB1,
+            0xCD81, 0x0DD0, 0x0D20, 0xCD71, 0x0CC0, 0xCC91, 0xCC61, 0x0C30,
+            0xD401, 0x1450, 0x14A0, 0xD4F1, 0x1540, 0xD511, 0xD5E1, 0x15B0,
+            0x1680, 0xD6D1, 0xD621, 0x1670, 0xD7C1, 0x1790, 0x1760, 0xD731,
+            0x1100, 0xD151, 0xD1A1, 0x11F0, 0xD041, 0x1010, 0x10E0, 0xD0B1,
+            0xD381, 0x13D0, 0x1320, 0xD371, 0x12C0, 0xD291, 0xD261, 0x1230,
+            0x1E00, 0xDE51, 0xDEA1, 0x1EF0, 0xDF41, 0x1F10, 0x1FE0, 0xDFB1,
+            0xDC81, 0x1CD0, 0x1C20, 0xDC71, 0x1DC0, 0xDD91, 0xDD61, 0x1D30,
+            0xDB01, 0x1B50, 0x1BA0, 0xDBF1, 0x1A40, 0xDA11, 0xDAE1, 0x1AB0,
+            0x1980, 0xD9D1, 0xD921, 0x1970, 0xD8C1, 0x1890, 0x1860, 0xD831,
+            0xE801, 0x2850, 0x28A0, 0xE8F1, 0x2940, 0xE911, 0xE9E1, 0x29B0,
+            0x2A80, 0xEAD1, 0xEA21, 0x2A70, 0xEBC1, 0x2B90, 0x2B60, 0xEB31,
+            0x2D00, 0xED51, 0xEDA1, 0x2DF0, 0xEC41, 0x2C10, 0x2CE0, 0xECB1,
+            0xEF81, 0x2FD0, 0x2F20, 0xEF71, 0x2EC0, 0xEE91, 0xEE61, 0x2E30,
+            0x2200, 0xE251, 0xE2A1, 0x22F0, 0xE341, 0x2310, 0x23E0, 0xE3B1,
+            0xE081, 0x20D0, 0x2020, 0xE071, 0x21C0, 0xE191, 0xE161, 0x2130,
+            0xE701, 0x2750, 0x27A0, 0xE7F1, 0x2640, 0xE611, 0xE6E1, 0x26B0,
+            0x2580, 0xE5D1, 0xE521, 0x2570, 0xE4C1, 0x2490, 0x2460, 0xE431,
+            0x3C00, 0xFC51, 0xFCA1, 0x3CF0, 0xFD41, 0x3D10, 0x3DE0, 0xFDB1,
+            0xFE81, 0x3ED0, 0x3E20, 0xFE71, 0x3FC0, 0xFF91, 0xFF61, 0x3F30,
+            0xF901, 0x3950, 0x39A0, 0xF9F1, 0x3840, 0xF811, 0xF8E1, 0x38B0,
+            0x3B80, 0xFBD1, 0xFB21, 0x3B70, 0xFAC1, 0x3A90, 0x3A60, 0xFA31,
+            0xF601, 0x3650, 0x36A0, 0xF6F1, 0x3740, 0xF711, 0xF7E1, 0x37B0,
+            0x3480, 0xF4D1, 0xF421, 0x3470, 0xF5C1, 0x3590, 0x3560, 0xF531,
+            0x3300, 0xF351, 0xF3A1, 0x33F0, 0xF241, 0x3210, 0x32E0, 0xF2B1,
+            0xF181, 0x31D0, 0x3120, 0xF171, 0x30C0, 0xF091, 0xF061, 0x3030
+        },
+        {
+            0x0000, 0xFC01, 0xB801, 0x4400, 0x3001, 0xCC00, 0x8800, 0x7401,
+            0x6002, 0x9C03, 0xD803, 0x2402, 0x5003, 0xAC02, 0xE802, 0x1403,
+            0xC004, 0x3C05, 0x7805, 0x8404, 0xF005, 0x0C04, 0x4804, 0xB405,
+            0xA006, 0x5C07, 0x1807, 0xE406, 0x9007, 0x6C06, 0x2806, 0xD407,
+            0xC00B, 0x3C0A, 0x780A, 0x840B, 0xF00A, 0x0C0B, 0x480B, 0xB40A,
+            0xA009, 0x5C08, 0x1808, 0xE409, 0x9008, 0x6C09, 0x2809, 0xD408,
+            0x000F, 0xFC0E, 0xB80E, 0x440F, 0x300E, 0xCC0F, 0x880F, 0x740E,
+            0x600D, 0x9C0C, 0xD80C, 0x240D, 0x500C, 0xAC0D, 0xE80D, 0x140C,
+            0xC015, 0x3C14, 0x7814, 0x8415, 0xF014, 0x0C15, 0x4815, 0xB414,
+            0xA017, 0x5C16, 0x1816, 0xE417, 0x9016, 0x6C17, 0x2817, 0xD416,
+            0x0011, 0xFC10, 0xB810, 0x4411, 0x3010, 0xCC11, 0x8811, 0x7410,
+            0x6013, 0x9C12, 0xD812, 0x2413, 0x5012, 0xAC13, 0xE813, 0x1412,
+            0x001E, 0xFC1F, 0xB81F, 0x441E, 0x301F, 0xCC1E, 0x881E, 0x741F,
+            0x601C, 0x9C1D, 0xD81D, 0x241C, 0x501D, 0xAC1C, 0xE81C, 0x141D,
+            0xC01A, 0x3C1B, 0x781B, 0x841A, 0xF01B, 0x0C1A, 0x481A, 0xB41B,
+            0xA018, 0x5C19, 0x1819, 0xE418, 0x9019, 0x6C18, 0x2818, 0xD419,
+            0xC029, 0x3C28, 0x7828, 0x8429, 0xF028, 0x0C29, 0x4829, 0xB428,
+            0xA02B, 0x5C2A, 0x182A, 0xE42B, 0x902A, 0x6C2B, 0x282B, 0xD42A,
+            0x002D, 0xFC2C, 0xB82C, 0x442D, 0x302C, 0xCC2D, 0x882D, 0x742C,
+            0x602F, 0x9C2E, 0xD82E, 0x242F, 0x502E, 0xAC2F, 0xE82F, 0x142E,
+            0x0022, 0xFC23, 0xB823, 0x4422, 0x3023, 0xCC22, 0x8822, 0x7423,
+            0x6020, 0x9C21, 0xD821, 0x2420, 0x5021, 0xAC20, 0xE820, 0x1421,
+            0xC026, 0x3C27, 0x7827, 0x8426, 0xF027, 0x0C26, 0x4826, 0xB427,
+            0xA024, 0x5C25, 0x1825, 0xE424, 0x9025, 0x6C24, 0x2824, 0xD425,
+            0x003C, 0xFC3D, 0xB83D, 0x443C, 0x303D, 0xCC3C, 0x883C, 0x743D,
+            0x603E, 0x9C3F, 0xD83F, 0x243E, 0x503F, 0xAC3E, 0xE83E, 0x143F,
+            0xC038, 0x3C39, 0x7839, 0x8438, 0xF039, 0x0C38, 0x4838, 0xB439,
+            0xA03A, 0x5C3B, 0x183B, 0xE43A, 0x903B, 0x6C3A, 0x283A, 0xD43B,
+            0xC037, 0x3C36, 0x7836, 0x8437, 0xF036, 0x0C37, 0x4837, 0xB436,
+            0xA035, 0x5C34, 0x1834, 0xE435, 0x9034, 0x6C35, 0x2835, 0xD434,
+            0x0033, 0xFC32, 0xB832, 0x4433, 0x3032, 0xCC33, 0x8833, 0x7432,
+            0x6031, 0x9C30, 0xD830, 0x2431, 0x5030, 0xAC31, 0xE831, 0x1430
+        },
+        {
+            0x0000, 0xC03D, 0xC079, 0x0044, 0xC0F1, 0x00CC, 0x0088, 0xC0B5,
+            0xC1E1, 0x01DC, 0x0198, 0xC1A5, 0x0110, 0xC12D, 0xC169, 0x0154,
+            0xC3C1, 0x03FC, 0x03B8, 0xC385, 0x0330, 0xC30D, 0xC349, 0x0374,
+            0x0220, 0xC21D, 0xC259, 0x0264, 0xC2D1, 0x02EC, 0x02A8, 0xC295,
+            0xC781, 0x07BC, 0x07F8, 0xC7C5, 0x0770, 0xC74D, 0xC709, 0x0734,
+            0x0660, 0xC65D, 0xC619, 0x0624, 0xC691, 0x06AC, 0x06E8, 0xC6D5,
+            0x0440, 0xC47D, 0xC439, 0x0404, 0xC4B1, 0x048C, 0x04C8, 0xC4F5,
+            0xC5A1, 0x059C, 0x05D8, 0xC5E5, 0x0550, 0xC56D, 0xC529, 0x0514,
+            0xCF01, 0x0F3C, 0x0F78, 0xCF45, 0x0FF0, 0xCFCD, 0xCF89, 0x0FB4,
+            0x0EE0, 0xCEDD, 0xCE99, 0x0EA4, 0xCE11, 0x0E2C, 0x0E68, 0xCE55,
+            0x0CC0, 0xCCFD, 0xCCB9, 0x0C84, 0xCC31, 0x0C0C, 0x0C48, 0xCC75,
+            0xCD21, 0x0D1C, 0x0D58, 0xCD65, 0x0DD0, 0xCDED, 0xCDA9, 0x0D94,
+            0x0880, 0xC8BD, 0xC8F9, 0x08C4, 0xC871, 0x084C, 0x0808, 0xC835,
+            0xC961, 0x095C, 0x0918, 0xC925, 0x0990, 0xC9AD, 0xC9E9, 0x09D4,
+            0xCB41, 0x0B7C, 0x0B38, 0xCB05, 0x0BB0, 0xCB8D, 0xCBC9, 0x0BF4,
+            0x0AA0, 0xCA9D, 0xCAD9, 0x0AE4, 0xCA51, 0x0A6C, 0x0A28, 0xCA15,
+            0xDE01, 0x1E3C, 0x1E78, 0xDE45, 0x1EF0, 0xDECD, 0xDE89, 0x1EB4,
+            0x1FE0, 0xDFDD, 0xDF99, 0x1FA4, 0xDF11, 0x1F2C, 0x1F68, 0xDF55,
+            0x1DC0, 0xDDFD, 0xDDB9, 0x1D84, 0xDD31, 0x1D0C, 0x1D48, 0xDD75,
+            0xDC21, 0x1C1C, 0x1C58, 0xDC65, 0x1CD0, 0xDCED, 0xDCA9, 0x1C94,
+            0x1980, 0xD9BD, 0xD9F9, 0x19C4, 0xD971, 0x194C, 0x1908, 0xD935,
+            0xD861, 0x185C, 0x1818, 0xD825, 0x1890, 0xD8AD, 0xD8E9, 0x18D4,
+            0xDA41, 0x1A7C, 0x1A38, 0xDA05, 0x1AB0, 0xDA8D, 0xDAC9, 0x1AF4,
+            0x1BA0, 0xDB9D, 0xDBD9, 0x1BE4, 0xDB51, 0x1B6C, 0x1B28, 0xDB15,
+            0x1100, 0xD13D, 0xD179, 0x1144, 0xD1F1, 0x11CC, 0x1188, 0xD1B5,
+            0xD0E1, 0x10DC, 0x1098, 0xD0A5, 0x1010, 0xD02D, 0xD069, 0x1054,
+            0xD2C1, 0x12FC, 0x12B8, 0xD285, 0x1230, 0xD20D, 0xD249, 0x1274,
+            0x1320, 0xD31D, 0xD359, 0x1364, 0xD3D1, 0x13EC, 0x13A8, 0xD395,
+            0xD681, 0x16BC, 0x16F8, 0xD6C5, 0x1670, 0xD64D, 0xD609, 0x1634,
+            0x1760, 0xD75D, 0xD719, 0x1724, 0xD791, 0x17AC, 0x17E8, 0xD7D5,
+            0x1540, 0xD57D, 0xD539, 0x1504, 0xD5B1, 0x158C, 0x15C8, 0xD5F5,
+            0xD4A1, 0x149C, 0x14D8, 0xD4E5, 0x1450, 0xD46D, 0xD429, 0x1414
+        },
+        {
+            0x0000, 0xD101, 0xE201, 0x3300, 0x8401, 0x5500, 0x6600, 0xB701,
+            0x4801, 0x9900, 0xAA00, 0x7B01, 0xCC00, 0x1D01, 0x2E01, 0xFF00,
+            0x9002, 0x4103, 0x7203, 0xA302, 0x1403, 0xC502, 0xF602, 0x2703,
+            0xD803, 0x0902, 0x3A02, 0xEB03, 0x5C02, 0x8D03, 0xBE03, 0x6F02,
+            0x6007, 0xB106, 0x8206, 0x5307, 0xE406, 0x3507, 0x0607, 0xD706,
+            0x2806, 0xF907, 0xCA07, 0x1B06, 0xAC07, 0x7D06, 0x4E06, 0x9F07,
+            0xF005, 0x2104, 0x1204, 0xC305, 0x7404, 0xA505, 0x9605, 0x4704,
+            0xB804, 0x6905, 0x5A05, 0x8B04, 0x3C05, 0xED04, 0xDE04, 0x0F05,
+            0xC00E, 0x110F, 0x220F, 0xF30E, 0x440F, 0x950E, 0xA60E, 0x770F,
+            0x880F, 0x590E, 0x6A0E, 0xBB0F, 0x0C0E, 0xDD0F, 0xEE0F, 0x3F0E,
+            0x500C, 0x810D, 0xB20D, 0x630C, 0xD40D, 0x050C, 0x360C, 0xE70D,
+            0x180D, 0xC90C, 0xFA0C, 0x2B0D, 0x9C0C, 0x4D0D, 0x7E0D, 0xAF0C,
+            0xA009, 0x7108, 0x4208, 0x9309, 0x2408, 0xF509, 0xC609, 0x1708,
+            0xE808, 0x3909, 0x0A09, 0xDB08, 0x6C09, 0xBD08, 0x8E08, 0x5F09,
+            0x300B, 0xE10A, 0xD20A, 0x030B, 0xB40A, 0x650B, 0x560B, 0x870A,
+            0x780A, 0xA90B, 0x9A0B, 0x4B0A, 0xFC0B, 0x2D0A, 0x1E0A, 0xCF0B,
+            0xC01F, 0x111E, 0x221E, 0xF31F, 0x441E, 0x951F, 0xA61F, 0x771E,
+            0x881E, 0x591F, 0x6A1F, 0xBB1E, 0x0C1F, 0xDD1E, 0xEE1E, 0x3F1F,
+            0x501D, 0x811C, 0xB21C, 0x631D, 0xD41C, 0x051D, 0x361D, 0xE71C,
+            0x181C, 0xC91D, 0xFA1D, 0x2B1C, 0x9C1D, 0x4D1C, 0x7E1C, 0xAF1D,
+            0xA018, 0x7119, 0x4219, 0x9318, 0x2419, 0xF518, 0xC618, 0x1719,
+            0xE819, 0x3918, 0x0A18, 0xDB19, 0x6C18, 0xBD19, 0x8E19, 0x5F18,
+            0x301A, 0xE11B, 0xD21B, 0x031A, 0xB41B, 0x651A, 0x561A, 0x871B,
+            0x781B, 0xA91A, 0x9A1A, 0x4B1B, 0xFC1A, 0x2D1B, 0x1E1B, 0xCF1A,
+            0x0011, 0xD110, 0xE210, 0x3311, 0x8410, 0x5511, 0x6611, 0xB710,
+            0x4810, 0x9911, 0xAA11, 0x7B10, 0xCC11, 0x1D10, 0x2E10, 0xFF11,
+            0x9013, 0x4112, 0x7212, 0xA313, 0x1412, 0xC513, 0xF613, 0x2712,
+            0xD812, 0x0913, 0x3A13, 0xEB12, 0x5C13, 0x8D12, 0xBE12, 0x6F13,
+            0x6016, 0xB117, 0x8217, 0x5316, 0xE417, 0x3516, 0x0616, 0xD717,
+            0x2817, 0xF916, 0xCA16, 0x1B17, 0xAC16, 0x7D17, 0x4E17, 0x9F16,
+            0xF014, 0x2115, 0x1215, 0xC314, 0x7415, 0xA514, 0x9614, 0x4715,
+            0xB815, 0x6914, 0x5A14, 0x8B15, 0x3C14, 0xED15, 0xDE15, 0x0F14
+        },
+        {
+            0x0000, 0xC010, 0xC023, 0x0033, 0xC045, 0x0055, 0x0066, 0xC076,
+            0xC089, 0x0099, 0x00AA, 0xC0BA, 0x00CC, 0xC0DC, 0xC0EF, 0x00FF,
+            0xC111, 0x0101, 0x0132, 0xC122, 0x0154, 0xC144, 0xC177, 0x0167,
+            0x0198, 0xC188, 0xC1BB, 0x01AB, 0xC1DD, 0x01CD, 0x01FE, 0xC1EE,
+            0xC221, 0x0231, 0x0202, 0xC212, 0x0264, 0xC274, 0xC247, 0x0257,
+            0x02A8, 0xC2B8, 0xC28B, 0x029B, 0xC2ED, 0x02FD, 0x02CE, 0xC2DE,
+            0x0330, 0xC320, 0xC313, 0x0303, 0xC375, 0x0365, 0x0356, 0xC346,
+            0xC3B9, 0x03A9, 0x039A, 0xC38A, 0x03FC, 0xC3EC, 0xC3DF, 0x03CF,
+            0xC441, 0x0451, 0x0462, 0xC472, 0x0404, 0xC414, 0xC427, 0x0437,
+            0x04C8, 0xC4D8, 0xC4EB, 0x04FB, 0xC48D, 0x049D, 0x04AE, 0xC4BE,
+            0x0550, 0xC540, 0xC573, 0x0563, 0xC515, 0x0505, 0x0536, 0xC526,
+            0xC5D9, 0x05C9, 0x05FA, 0xC5EA, 0x059C, 0xC58C, 0xC5BF, 0x05AF,
+            0x0660, 0xC670, 0xC643, 0x0653, 0xC625, 0x0635, 0x0606, 0xC616,
+            0xC6E9, 0x06F9, 0x06CA, 0xC6DA, 0x06AC, 0xC6BC, 0xC68F, 0x069F,
+            0xC771, 0x0761, 0x0752, 0xC742, 0x0734, 0xC724, 0xC717, 0x0707,
+            0x07F8, 0xC7E8, 0xC7DB, 0x07CB, 0xC7BD, 0x07AD, 0x079E, 0xC78E,
+            0xC881, 0x0891, 0x08A2, 0xC8B2, 0x08C4, 0xC8D4, 0xC8E7, 0x08F7,
+            0x0808, 0xC818, 0xC82B, 0x083B, 0xC84D, 0x085D, 0x086E, 0xC87E,
+            0x0990, 0xC980, 0xC9B3, 0x09A3, 0xC9D5, 0x09C5, 0x09F6, 0xC9E6,
+            0xC919, 0x0909, 0x093A, 0xC92A, 0x095C, 0xC94C, 0xC97F, 0x096F,
+            0x0AA0, 0xCAB0, 0xCA83, 0x0A93, 0xCAE5, 0x0AF5, 0x0AC6, 0xCAD6,
+            0xCA29, 0x0A39, 0x0A0A, 0xCA1A, 0x0A6C, 0xCA7C, 0xCA4F, 0x0A5F,
+            0xCBB1, 0x0BA1, 0x0B92, 0xCB82, 0x0BF4, 0xCBE4, 0xCBD7, 0x0BC7,
+            0x0B38, 0xCB28, 0xCB1B, 0x0B0B, 0xCB7D, 0x0B6D, 0x0B5E, 0xCB4E,
+            0x0CC0, 0xCCD0, 0xCCE3, 0x0CF3, 0xCC85, 0x0C95, 0x0CA6, 0xCCB6,
+            0xCC49, 0x0C59, 0x0C6A, 0xCC7A, 0x0C0C, 0xCC1C, 0xCC2F, 0x0C3F,
+            0xCDD1, 0x0DC1, 0x0DF2, 0xCDE2, 0x0D94, 0xCD84, 0xCDB7, 0x0DA7,
+            0x0D58, 0xCD48, 0xCD7B, 0x0D6B, 0xCD1D, 0x0D0D, 0x0D3E, 0xCD2E,
+            0xCEE1, 0x0EF1, 0x0EC2, 0xCED2, 0x0EA4, 0xCEB4, 0xCE87, 0x0E97,
+            0x0E68, 0xCE78, 0xCE4B, 0x0E5B, 0xCE2D, 0x0E3D, 0x0E0E, 0xCE1E,
+            0x0FF0, 0xCFE0, 0xCFD3, 0x0FC3, 0xCFB5, 0x0FA5, 0x0F96, 0xCF86,
+            0xCF79, 0x0F69, 0x0F5A, 0xCF4A, 0x0F3C, 0xCF2C, 0xCF1F, 0x0F0F
+        },
+        {
+            0x0000, 0xCCC1, 0xD981, 0x1540, 0xF301, 0x3FC0, 0x2A80, 0xE641,
+            0xA601, 0x6AC0, 0x7F80, 0xB341, 0x5500, 0x99C1, 0x8C81, 0x4040,
+            0x0C01, 0xC0C0, 0xD580, 0x1941, 0xFF00, 0x33C1, 0x2681, 0xEA40,
+            0xAA00, 0x66C1, 0x7381, 0xBF40, 0x5901, 0x95C0, 0x8080, 0x4C41,
+            0x1802, 0xD4C3, 0xC183, 0x0D42, 0xEB03, 0x27C2, 0x3282, 0xFE43,
+            0xBE03, 0x72C2, 0x6782, 0xAB43, 0x4D02, 0x81C3, 0x9483, 0x5842,
+            0x1403, 0xD8C2, 0xCD82, 0x0143, 0xE702, 0x2BC3, 0x3E83, 0xF242,
+            0xB202, 0x7EC3, 0x6B83, 0xA742, 0x4103, 0x8DC2, 0x9882, 0x5443,
+            0x3004, 0xFCC5, 0xE985, 0x2544, 0xC305, 0x0FC4, 0x1A84, 0xD645,
+            0x9605, 0x5AC4, 0x4F84, 0x8345, 0x6504, 0xA9C5, 0xBC85, 0x7044,
+            0x3C05, 0xF0C4, 0xE584, 0x2945, 0xCF04, 0x03C5, 0x1685, 0xDA44,
+            0x9A04, 0x56C5, 0x4385, 0x8F44, 0x6905, 0xA5C4, 0xB084, 0x7C45,
+            0x2806, 0xE4C7, 0xF187, 0x3D46, 0xDB07, 0x17C6, 0x0286, 0xCE47,
+            0x8E07, 0x42C6, 0x5786, 0x9B47, 0x7D06, 0xB1C7, 0xA487, 0x6846,
+            0x2407, 0xE8C6, 0xFD86, 0x3147, 0xD706, 0x1BC7, 0x0E87, 0xC246,
+            0x8206, 0x4EC7, 0x5B87, 0x9746, 0x7107, 0xBDC6, 0xA886, 0x6447,
+            0x6008, 0xACC9, 0xB989, 0x7548, 0x9309, 0x5FC8, 0x4A88, 0x8649,
+            0xC609, 0x0AC8, 0x1F88, 0xD349, 0x3508, 0xF9C9, 0xEC89, 0x2048,
+            0x6C09, 0xA0C8, 0xB588, 0x7949, 0x9F08, 0x53C9, 0x4689, 0x8A48,
+            0xCA08, 0x06C9, 0x1389, 0xDF48, 0x3909, 0xF5C8, 0xE088, 0x2C49,
+            0x780A, 0xB4CB, 0xA18B, 0x6D4A, 0x8B0B, 0x47CA, 0x528A, 0x9E4B,
+            0xDE0B, 0x12CA, 0x078A, 0xCB4B, 0x2D0A, 0xE1CB, 0xF48B, 0x384A,
+            0x740B, 0xB8CA, 0xAD8A, 0x614B, 0x870A, 0x4BCB, 0x5E8B, 0x924A,
+            0xD20A, 0x1ECB, 0x0B8B, 0xC74A, 0x210B, 0xEDCA, 0xF88A, 0x344B,
+            0x500C, 0x9CCD, 0x898D, 0x454C, 0xA30D, 0x6FCC, 0x7A8C, 0xB64D,
+            0xF60D, 0x3ACC, 0x2F8C, 0xE34D, 0x050C, 0xC9CD, 0xDC8D, 0x104C,
+            0x5C0D, 0x90CC, 0x858C, 0x494D, 0xAF0C, 0x63CD, 0x768D, 0xBA4C,
+            0xFA0C, 0x36CD, 0x238D, 0xEF4C, 0x090D, 0xC5CC, 0xD08C, 0x1C4D,
+            0x480E, 0x84CF, 0x918F, 0x5D4E, 0xBB0F, 0x77CE, 0x628E, 0xAE4F,
+            0xEE0F, 0x22CE, 0x378E, 0xFB4F, 0x1D0E, 0xD1CF, 0xC48F, 0x084E,
+            0x440F, 0x88CE, 0x9D8E, 0x514F, 0xB70E, 0x7BCF, 0x6E8F, 0xA24E,
+            0xE20E, 0x2ECF, 0x3B8F, 0xF74E, 0x110F, 0xDDCE, 0xC88E, 0x044F
+        }
+    };
+#endif /* ffconfigCRC_SLICING_BY_8 */
+
 /*****************************************************************************
 * Description: Function to 16 bit CRC check a block of memory
 *
@@ -186,6 +920,25 @@ uint16_t FF_GetCRC16( uint8_t * pbyData,
     uint8_t bTableValue;
     uint16_t wCRC = 0;
 
+    #if ( ffconfigCRC_SLICING_BY_8 != 0 )
+    {
+        while( stLength >= 8U )
+        {
+            wCRC ^= ( uint16_t ) ( ( ( uint16_t ) pbyData[ 0 ] ) | ( ( uint16_t ) pbyData[ 1 ] << 8 ) );
+            wCRC = ( uint16_t ) ( crc16_slice_table[ 6 ][ wCRC & 0x00FF ] ^
+                                  crc16_slice_table[ 5 ][ ( wCRC >> 8 ) & 0x00FF ] ^
+                                  crc16_slice_table[ 4 ][ pbyData[ 2 ] ] ^
+                                  crc16_slice_table[ 3 ][ pbyData[ 3 ] ] ^
+                                  crc16_slice_table[ 2 ][ pbyData[ 4 ] ] ^
+                                  crc16_slice_table[ 1 ][ pbyData[ 5 ] ] ^
+                                  crc16_slice_table[ 0 ][ pbyData[ 6 ] ] ^
+                                  ( ( uint16_t ) ( crc16_table_high[ pbyData[ 7 ] ] << 8 ) | crc16_table_low[ pbyData[ 7 ] ] ) );
+            pbyData += 8;
+            stLength -= 8U;
+        }
+    }
+    #endif /* ffconfigCRC_SLICING_BY_8 */
+
     while( stLength-- != 0 )
     {
         bTableValue = ( uint8_t ) ( ( wCRC & 0x00FF ) ^ *pbyData++ );
@@ -233,6 +986,183 @@ static const uint8_t crc8_table[ 256 ] =
     182, 232, 10,  84,  215, 137, 107, 53
 };
 
+#if ( ffconfigCRC_SLICING_BY_8 != 0 )
+
+/* The same as crc32_slice_table, for FF_GetCRC8().  The table for k = 0 is
+ * crc8_table. */
+    static const uint8_t crc8_slice_table[ 7 ][ 256 ] =
+    {
+        {
+            0x00, 0xC4, 0x91, 0x55, 0x3B, 0xFF, 0xAA, 0x6E, 0x76, 0xB2, 0xE7, 0x23,
+            0x4D, 0x89, 0xDC, 0x18, 0xEC, 0x28, 0x7D, 0xB9, 0xD7, 0x13, 0x46, 0x82,
+            0x9A, 0x5E, 0x0B, 0xCF, 0xA1, 0x65, 0x30, 0xF4, 0xC1, 0x05, 0x50, 0x94,
+            0xFA, 0x3E, 0x6B, 0xAF, 0xB7, 0x73, 0x26, 0xE2, 0x8C, 0x48, 0x1D, 0xD9,
+            0x2D, 0xE9, 0xBC, 0x78, 0x16, 0xD2, 0x87, 0x43, 0x5B, 0x9F, 0xCA, 0x0E,
+            0x60, 0xA4, 0xF1, 0x35, 0x9B, 0x5F, 0x0A, 0xCE, 0xA0, 0x64, 0x31, 0xF5,
+            0xED, 0x29, 0x7C, 0xB8, 0xD6, 0x12, 0x47, 0x83, 0x77, 0xB3, 0xE6, 0x22,
+            0x4C, 0x88, 0xDD, 0x19, 0x01, 0xC5, 0x90, 0x54, 0x3A, 0xFE, 0xAB, 0x6F,
+            0x5A, 0x9E, 0xCB, 0x0F, 0x61, 0xA5, 0xF0, 0x34, 0x2C, 0xE8, 0xBD, 0x79,
+            0x17, 0xD3, 0x86, 0x42, 0xB6, 0x72, 0x27, 0xE3, 0x8D, 0x49, 0x1C, 0xD8,
+            0xC0, 0x04, 0x51, 0x95, 0xFB, 0x3F, 0x6A, 0xAE, 0x2F, 0xEB, 0xBE, 0x7A,
+            0x14, 0xD0, 0x85, 0x41, 0x59, 0x9D, 0xC8, 0x0C, 0x62, 0xA6, 0xF3, 0x37,
+            0xC3, 0x07, 0x52, 0x96, 0xF8, 0x3C, 0x69, 0xAD, 0xB5, 0x71, 0x24, 0xE0,
+            0x8E, 0x4A, 0x1F, 0xDB, 0xEE, 0x2A, 0x7F, 0xBB, 0xD5, 0x11, 0x44, 0x80,
+            0x98, 0x5C, 0x09, 0xCD, 0xA3, 0x67, 0x32, 0xF6, 0x02, 0xC6, 0x93, 0x57,
+            0x39, 0xFD, 0xA8, 0x6C, 0x74, 0xB0, 0xE5, 0x21, 0x4F, 0x8B, 0xDE, 0x1A,
+            0xB4, 0x70, 0x25, 0xE1, 0x8F, 0x4B, 0x1E, 0xDA, 0xC2, 0x06, 0x53, 0x97,
+            0xF9, 0x3D, 0x68, 0xAC, 0x58, 0x9C, 0xC9, 0x0D, 0x63, 0xA7, 0xF2, 0x36,
+            0x2E, 0xEA, 0xBF, 0x7B, 0x15, 0xD1, 0x84, 0x40, 0x75, 0xB1, 0xE4, 0x20,
+            0x4E, 0x8A, 0xDF, 0x1B, 0x03, 0xC7, 0x92, 0x56, 0x38, 0xFC, 0xA9, 0x6D,
+            0x99, 0x5D, 0x08, 0xCC, 0xA2, 0x66, 0x33, 0xF7, 0xEF, 0x2B, 0x7E, 0xBA,
+            0xD4, 0x10, 0x45, 0x81
+        },
+        {
+            0x00, 0xAB, 0x4F, 0xE4, 0x9E, 0x35, 0xD1, 0x7A, 0x25, 0x8E, 0x6A, 0xC1,
+            0xBB, 0x10, 0xF4, 0x5F, 0x4A, 0xE1, 0x05, 0xAE, 0xD4, 0x7F, 0x9B, 0x30,
+            0x6F, 0xC4, 0x20, 0x8B, 0xF1, 0x5A, 0xBE, 0x15, 0x94, 0x3F, 0xDB, 0x70,
+            0x0A, 0xA1, 0x45, 0xEE, 0xB1, 0x1A, 0xFE, 0x55, 0x2F, 0x84, 0x60, 0xCB,
+            0xDE, 0x75, 0x91, 0x3A, 0x40, 0xEB, 0x0F, 0xA4, 0xFB, 0x50, 0xB4, 0x1F,
+            0x65, 0xCE, 0x2A, 0x81, 0x31, 0x9A, 0x7E, 0xD5, 0xAF, 0x04, 0xE0, 0x4B,
+            0x14, 0xBF, 0x5B, 0xF0, 0x8A, 0x21, 0xC5, 0x6E, 0x7B, 0xD0, 0x34, 0x9F,
+            0xE5, 0x4E, 0xAA, 0x01, 0x5E, 0xF5, 0x11, 0xBA, 0xC0, 0x6B, 0x8F, 0x24,
+            0xA5, 0x0E, 0xEA, 0x41, 0x3B, 0x90, 0x74, 0xDF, 0x80, 0x2B, 0xCF, 0x64,
+            0x1E, 0xB5, 0x51, 0xFA, 0xEF, 0x44, 0xA0, 0x0B, 0x71, 0xDA, 0x3E, 0x95,
+            0xCA, 0x61, 0x85, 0x2E, 0x54, 0xFF, 0x1B, 0xB0, 0x62, 0xC9, 0x2D, 0x86,
+            0xFC, 0x57, 0xB3, 0x18, 0x47, 0xEC, 0x08, 0xA3, 0xD9, 0x72, 0x96, 0x3D,
+            0x28, 0x83, 0x67, 0xCC, 0xB6, 0x1D, 0xF9, 0x52, 0x0D, 0xA6, 0x42, 0xE9,
+            0x93, 0x38, 0xDC, 0x77, 0xF6, 0x5D, 0xB9, 0x12, 0x68, 0xC3, 0x27, 0x8C,
+            0xD3, 0x78, 0x9C, 0x37, 0x4D, 0xE6, 0x02, 0xA9, 0xBC, 0x17, 0xF3, 0x58,
+            0x22, 0x89, 0x6D, 0xC6, 0x99, 0x32, 0xD6, 0x7D, 0x07, 0xAC, 0x48, 0xE3,
+            0x53, 0xF8, 0x1C, 0xB7, 0xCD, 0x66, 0x82, 0x29, 0x76, 0xDD, 0x39, 0x92,
+            0xE8, 0x43, 0xA7, 0x0C, 0x19, 0xB2, 0x56, 0xFD, 0x87, 0x2C, 0xC8, 0x63,
+            0x3C, 0x97, 0x73, 0xD8, 0xA2, 0x09, 0xED, 0x46, 0xC7, 0x6C, 0x88, 0x23,
+            0x59, 0xF2, 0x16, 0xBD, 0xE2, 0x49, 0xAD, 0x06, 0x7C, 0xD7, 0x33, 0x98,
+            0x8D, 0x26, 0xC2, 0x69, 0x13, 0xB8, 0x5C, 0xF7, 0xA8, 0x03, 0xE7, 0x4C,
+            0x36, 0x9D, 0x79, 0xD2
+        },
+        {
+            0x00, 0x8F, 0x07, 0x88, 0x0E, 0x81, 0x09, 0x86, 0x1C, 0x93, 0x1B, 0x94,
+            0x12, 0x9D, 0x15, 0x9A, 0x38, 0xB7, 0x3F, 0xB0, 0x36, 0xB9, 0x31, 0xBE,
+            0x24, 0xAB, 0x23, 0xAC, 0x2A, 0xA5, 0x2D, 0xA2, 0x70, 0xFF, 0x77, 0xF8,
+            0x7E, 0xF1, 0x79, 0xF6, 0x6C, 0xE3, 0x6B, 0xE4, 0x62, 0xED, 0x65, 0xEA,
+            0x48, 0xC7, 0x4F, 0xC0, 0x46, 0xC9, 0x41, 0xCE, 0x54, 0xDB, 0x53, 0xDC,
+            0x5A, 0xD5, 0x5D, 0xD2, 0xE0, 0x6F, 0xE7, 0x68, 0xEE, 0x61, 0xE9, 0x66,
+            0xFC, 0x73, 0xFB, 0x74, 0xF2, 0x7D, 0xF5, 0x7A, 0xD8, 0x57, 0xDF, 0x50,
+            0xD6, 0x59, 0xD1, 0x5E, 0xC4, 0x4B, 0xC3, 0x4C, 0xCA, 0x45, 0xCD, 0x42,
+            0x90, 0x1F, 0x97, 0x18, 0x9E, 0x11, 0x99, 0x16, 0x8C, 0x03, 0x8B, 0x04,
+            0x82, 0x0D, 0x85, 0x0A, 0xA8, 0x27, 0xAF, 0x20, 0xA6, 0x29, 0xA1, 0x2E,
+            0xB4, 0x3B, 0xB3, 0x3C, 0xBA, 0x35, 0xBD, 0x32, 0xD9, 0x56, 0xDE, 0x51,
+            0xD7, 0x58, 0xD0, 0x5F, 0xC5, 0x4A, 0xC2, 0x4D, 0xCB, 0x44, 0xCC, 0x43,
+            0xE1, 0x6E, 0xE6, 0x69, 0xEF, 0x60, 0xE8, 0x67, 0xFD, 0x72, 0xFA, 0x75,
+            0xF3, 0x7C, 0xF4, 0x7B, 0xA9, 0x26, 0xAE, 0x21, 0xA7, 0x28, 0xA0, 0x2F,
+            0xB5, 0x3A, 0xB2, 0x3D, 0xBB, 0x34, 0xBC, 0x33, 0x91, 0x1E, 0x96, 0x19,
+            0x9F, 0x10, 0x98, 0x17, 0x8D, 0x02, 0x8A, 0x05, 0x83, 0x0C, 0x84, 0x0B,
+            0x39, 0xB6, 0x3E, 0xB1, 0x37, 0xB8, 0x30, 0xBF, 0x25, 0xAA, 0x22, 0xAD,
+            0x2B, 0xA4, 0x2C, 0xA3, 0x01, 0x8E, 0x06, 0x89, 0x0F, 0x80, 0x08, 0x87,
+            0x1D, 0x92, 0x1A, 0x95, 0x13, 0x9C, 0x14, 0x9B, 0x49, 0xC6, 0x4E, 0xC1,
+            0x47, 0xC8, 0x40, 0xCF, 0x55, 0xDA, 0x52, 0xDD, 0x5B, 0xD4, 0x5C, 0xD3,
+            0x71, 0xFE, 0x76, 0xF9, 0x7F, 0xF0, 0x78, 0xF7, 0x6D, 0xE2, 0x6A, 0xE5,
+            0x63, 0xEC, 0x64, 0xEB
+        },
+        {
+            0x00, 0xCD, 0x83, 0x4E, 0x1F, 0xD2, 0x9C, 0x51, 0x3E, 0xF3, 0xBD, 0x70,
+            0x21, 0xEC, 0xA2, 0x6F, 0x7C, 0xB1, 0xFF, 0x32, 0x63, 0xAE, 0xE0, 0x2D,
+            0x42, 0x8F, 0xC1, 0x0C, 0x5D, 0x90, 0xDE, 0x13, 0xF8, 0x35, 0x7B, 0xB6,
+            0xE7, 0x2A, 0x64, 0xA9, 0xC6, 0x0B, 0x45, 0x88, 0xD9, 0x14, 0x5A, 0x97,
+            0x84, 0x49, 0x07, 0xCA, 0x9B, 0x56, 0x18, 0xD5, 0xBA, 0x77, 0x39, 0xF4,
+            0xA5, 0x68, 0x26, 0xEB, 0xE9, 0x24, 0x6A, 0xA7, 0xF6, 0x3B, 0x75, 0xB8,
+            0xD7, 0x1A, 0x54, 0x99, 0xC8, 0x05, 0x4B, 0x86, 0x95, 0x58, 0x16, 0xDB,
+            0x8A, 0x47, 0x09, 0xC4, 0xAB, 0x66, 0x28, 0xE5, 0xB4, 0x79, 0x37, 0xFA,
+            0x11, 0xDC, 0x92, 0x5F, 0x0E, 0xC3, 0x8D, 0x40, 0x2F, 0xE2, 0xAC, 0x61,
+            0x30, 0xFD, 0xB3, 0x7E, 0x6D, 0xA0, 0xEE, 0x23, 0x72, 0xBF, 0xF1, 0x3C,
+            0x53, 0x9E, 0xD0, 0x1D, 0x4C, 0x81, 0xCF, 0x02, 0xCB, 0x06, 0x48, 0x85,
+            0xD4, 0x19, 0x57, 0x9A, 0xF5, 0x38, 0x76, 0xBB, 0xEA, 0x27, 0x69, 0xA4,
+            0xB7, 0x7A, 0x34, 0xF9, 0xA8, 0x65, 0x2B, 0xE6, 0x89, 0x44, 0x0A, 0xC7,
+            0x96, 0x5B, 0x15, 0xD8, 0x33, 0xFE, 0xB0, 0x7D, 0x2C, 0xE1, 0xAF, 0x62,
+            0x0D, 0xC0, 0x8E, 0x43, 0x12, 0xDF, 0x91, 0x5C, 0x4F, 0x82, 0xCC, 0x01,
+            0x50, 0x9D, 0xD3, 0x1E, 0x71, 0xBC, 0xF2, 0x3F, 0x6E, 0xA3, 0xED, 0x20,
+            0x22, 0xEF, 0xA1, 0x6C, 0x3D, 0xF0, 0xBE, 0x73, 0x1C, 0xD1, 0x9F, 0x52,
+            0x03, 0xCE, 0x80, 0x4D, 0x5E, 0x93, 0xDD, 0x10, 0x41, 0x8C, 0xC2, 0x0F,
+            0x60, 0xAD, 0xE3, 0x2E, 0x7F, 0xB2, 0xFC, 0x31, 0xDA, 0x17, 0x59, 0x94,
+            0xC5, 0x08, 0x46, 0x8B, 0xE4, 0x29, 0x67, 0xAA, 0xFB, 0x36, 0x78, 0xB5,
+            0xA6, 0x6B, 0x25, 0xE8, 0xB9, 0x74, 0x3A, 0xF7, 0x98, 0x55, 0x1B, 0xD6,
+            0x87, 0x4A, 0x04, 0xC9
+        },
+        {
+            0x00, 0x37, 0x6E, 0x59, 0xDC, 0xEB, 0xB2, 0x85, 0xA1, 0x96, 0xCF, 0xF8,
+            0x7D, 0x4A, 0x13, 0x24, 0x5B, 0x6C, 0x35, 0x02, 0x87, 0xB0, 0xE9, 0xDE,
+            0xFA, 0xCD, 0x94, 0xA3, 0x26, 0x11, 0x48, 0x7F, 0xB6, 0x81, 0xD8, 0xEF,
+            0x6A, 0x5D, 0x04, 0x33, 0x17, 0x20, 0x79, 0x4E, 0xCB, 0xFC, 0xA5, 0x92,
+            0xED, 0xDA, 0x83, 0xB4, 0x31, 0x06, 0x5F, 0x68, 0x4C, 0x7B, 0x22, 0x15,
+            0x90, 0xA7, 0xFE, 0xC9, 0x75, 0x42, 0x1B, 0x2C, 0xA9, 0x9E, 0xC7, 0xF0,
+            0xD4, 0xE3, 0xBA, 0x8D, 0x08, 0x3F, 0x66, 0x51, 0x2E, 0x19, 0x40, 0x77,
+            0xF2, 0xC5, 0x9C, 0xAB, 0x8F, 0xB8, 0xE1, 0xD6, 0x53, 0x64, 0x3D, 0x0A,
+            0xC3, 0xF4, 0xAD, 0x9A, 0x1F, 0x28, 0x71, 0x46, 0x62, 0x55, 0x0C, 0x3B,
+            0xBE, 0x89, 0xD0, 0xE7, 0x98, 0xAF, 0xF6, 0xC1, 0x44, 0x73, 0x2A, 0x1D,
+            0x39, 0x0E, 0x57, 0x60, 0xE5, 0xD2, 0x8B, 0xBC, 0xEA, 0xDD, 0x84, 0xB3,
+            0x36, 0x01, 0x58, 0x6F, 0x4B, 0x7C, 0x25, 0x12, 0x97, 0xA0, 0xF9, 0xCE,
+            0xB1, 0x86, 0xDF, 0xE8, 0x6D, 0x5A, 0x03, 0x34, 0x10, 0x27, 0x7E, 0x49,
+            0xCC, 0xFB, 0xA2, 0x95, 0x5C, 0x6B, 0x32, 0x05, 0x80, 0xB7, 0xEE, 0xD9,
+            0xFD, 0xCA, 0x93, 0xA4, 0x21, 0x16, 0x4F, 0x78, 0x07, 0x30, 0x69, 0x5E,
+            0xDB, 0xEC, 0xB5, 0x82, 0xA6, 0x91, 0xC8, 0xFF, 0x7A, 0x4D, 0x14, 0x23,
+            0x9F, 0xA8, 0xF1, 0xC6, 0x43, 0x74, 0x2D, 0x1A, 0x3E, 0x09, 0x50, 0x67,
+            0xE2, 0xD5, 0x8C, 0xBB, 0xC4, 0xF3, 0xAA, 0x9D, 0x18, 0x2F, 0x76, 0x41,
+            0x65, 0x52, 0x0B, 0x3C, 0xB9, 0x8E, 0xD7, 0xE0, 0x29, 0x1E, 0x47, 0x70,
+            0xF5, 0xC2, 0x9B, 0xAC, 0x88, 0xBF, 0xE6, 0xD1, 0x54, 0x63, 0x3A, 0x0D,
+            0x72, 0x45, 0x1C, 0x2B, 0xAE, 0x99, 0xC0, 0xF7, 0xD3, 0xE4, 0xBD, 0x8A,
+            0x0F, 0x38, 0x61, 0x56
+        },
+        {
+            0x00, 0x3D, 0x7A, 0x47, 0xF4, 0xC9, 0x8E, 0xB3, 0xF1, 0xCC, 0x8B, 0xB6,
+            0x05, 0x38, 0x7F, 0x42, 0xFB, 0xC6, 0x81, 0xBC, 0x0F, 0x32, 0x75, 0x48,
+            0x0A, 0x37, 0x70, 0x4D, 0xFE, 0xC3, 0x84, 0xB9, 0xEF, 0xD2, 0x95, 0xA8,
+            0x1B, 0x26, 0x61, 0x5C, 0x1E, 0x23, 0x64, 0x59, 0xEA, 0xD7, 0x90, 0xAD,
+            0x14, 0x29, 0x6E, 0x53, 0xE0, 0xDD, 0x9A, 0xA7, 0xE5, 0xD8, 0x9F, 0xA2,
+            0x11, 0x2C, 0x6B, 0x56, 0xC7, 0xFA, 0xBD, 0x80, 0x33, 0x0E, 0x49, 0x74,
+            0x36, 0x0B, 0x4C, 0x71, 0xC2, 0xFF, 0xB8, 0x85, 0x3C, 0x01, 0x46, 0x7B,
+            0xC8, 0xF5, 0xB2, 0x8F, 0xCD, 0xF0, 0xB7, 0x8A, 0x39, 0x04, 0x43, 0x7E,
+            0x28, 0x15, 0x52, 0x6F, 0xDC, 0xE1, 0xA6, 0x9B, 0xD9, 0xE4, 0xA3, 0x9E,
+            0x2D, 0x10, 0x57, 0x6A, 0xD3, 0xEE, 0xA9, 0x94, 0x27, 0x1A, 0x5D, 0x60,
+            0x22, 0x1F, 0x58, 0x65, 0xD6, 0xEB, 0xAC, 0x91, 0x97, 0xAA, 0xED, 0xD0,
+            0x63, 0x5E, 0x19, 0x24, 0x66, 0x5B, 0x1C, 0x21, 0x92, 0xAF, 0xE8, 0xD5,
+            0x6C, 0x51, 0x16, 0x2B, 0x98, 0xA5, 0xE2, 0xDF, 0x9D, 0xA0, 0xE7, 0xDA,
+            0x69, 0x54, 0x13, 0x2E, 0x78, 0x45, 0x02, 0x3F, 0x8C, 0xB1, 0xF6, 0xCB,
+            0x89, 0xB4, 0xF3, 0xCE, 0x7D, 0x40, 0x07, 0x3A, 0x83, 0xBE, 0xF9, 0xC4,
+            0x77, 0x4A, 0x0D, 0x30, 0x72, 0x4F, 0x08, 0x35, 0x86, 0xBB, 0xFC, 0xC1,
+            0x50, 0x6D, 0x2A, 0x17, 0xA4, 0x99, 0xDE, 0xE3, 0xA1, 0x9C, 0xDB, 0xE6,
+            0x55, 0x68, 0x2F, 0x12, 0xAB, 0x96, 0xD1, 0xEC, 0x5F, 0x62, 0x25, 0x18,
+            0x5A, 0x67, 0x20, 0x1D, 0xAE, 0x93, 0xD4, 0xE9, 0xBF, 0x82, 0xC5, 0xF8,
+            0x4B, 0x76, 0x31, 0x0C, 0x4E, 0x73, 0x34, 0x09, 0xBA, 0x87, 0xC0, 0xFD,
+            0x44, 0x79, 0x3E, 0x03, 0xB0, 0x8D, 0xCA, 0xF7, 0xB5, 0x88, 0xCF, 0xF2,
+            0x41, 0x7C, 0x3B, 0x06
+        },
+        {
+            0x00, 0x43, 0x86, 0xC5, 0x15, 0x56, 0x93, 0xD0, 0x2A, 0x69, 0xAC, 0xEF,
+            0x3F, 0x7C, 0xB9, 0xFA, 0x54, 0x17, 0xD2, 0x91, 0x41, 0x02, 0xC7, 0x84,
+            0x7E, 0x3D, 0xF8, 0xBB, 0x6B, 0x28, 0xED, 0xAE, 0xA8, 0xEB, 0x2E, 0x6D,
+            0xBD, 0xFE, 0x3B, 0x78, 0x82, 0xC1, 0x04, 0x47, 0x97, 0xD4, 0x11, 0x52,
+            0xFC, 0xBF, 0x7A, 0x39, 0xE9, 0xAA, 0x6F, 0x2C, 0xD6, 0x95, 0x50, 0x13,
+            0xC3, 0x80, 0x45, 0x06, 0x49, 0x0A, 0xCF, 0x8C, 0x5C, 0x1F, 0xDA, 0x99,
+            0x63, 0x20, 0xE5, 0xA6, 0x76, 0x35, 0xF0, 0xB3, 0x1D, 0x5E, 0x9B, 0xD8,
+            0x08, 0x4B, 0x8E, 0xCD, 0x37, 0x74, 0xB1, 0xF2, 0x22, 0x61, 0xA4, 0xE7,
+            0xE1, 0xA2, 0x67, 0x24, 0xF4, 0xB7, 0x72, 0x31, 0xCB, 0x88, 0x4D, 0x0E,
+            0xDE, 0x9D, 0x58, 0x1B, 0xB5, 0xF6, 0x33, 0x70, 0xA0, 0xE3, 0x26, 0x65,
+            0x9F, 0xDC, 0x19, 0x5A, 0x8A, 0xC9, 0x0C, 0x4F, 0x92, 0xD1, 0x14, 0x57,
+            0x87, 0xC4, 0x01, 0x42, 0xB8, 0xFB, 0x3E, 0x7D, 0xAD, 0xEE, 0x2B, 0x68,
+            0xC6, 0x85, 0x40, 0x03, 0xD3, 0x90, 0x55, 0x16, 0xEC, 0xAF, 0x6A, 0x29,
+            0xF9, 0xBA, 0x7F, 0x3C, 0x3A, 0x79, 0xBC, 0xFF, 0x2F, 0x6C, 0xA9, 0xEA,
+            0x10, 0x53, 0x96, 0xD5, 0x05, 0x46, 0x83, 0xC0, 0x6E, 0x2D, 0xE8, 0xAB,
+            0x7B, 0x38, 0xFD, 0xBE, 0x44, 0x07, 0xC2, 0x81, 0x51, 0x12, 0xD7, 0x94,
+            0xDB, 0x98, 0x5D, 0x1E, 0xCE, 0x8D, 0x48, 0x0B, 0xF1, 0xB2, 0x77, 0x34,
+            0xE4, 0xA7, 0x62, 0x21, 0x8F, 0xCC, 0x09, 0x4A, 0x9A, 0xD9, 0x1C, 0x5F,
+            0xA5, 0xE6, 0x23, 0x60, 0xB0, 0xF3, 0x36, 0x75, 0x73, 0x30, 0xF5, 0xB6,
+            0x66, 0x25, 0xE0, 0xA3, 0x59, 0x1A, 0xDF, 0x9C, 0x4C, 0x0F, 0xCA, 0x89,
+            0x27, 0x64, 0xA1, 0xE2, 0x32, 0x71, 0xB4, 0xF7, 0x0D, 0x4E, 0x8B, 0xC8,
+            0x18, 0x5B, 0x9E, 0xDD
+        }
+    };
+#endif /* ffconfigCRC_SLICING_BY_8 */
+
 /*****************************************************************************
 * Description: Function to CRC check a block of memory
 *
@@ -248,6 +1178,24 @@ uint8_t FF_GetCRC8( uint8_t * pbyData,
 {
     uint8_t byCRC = 0, byData;
 
+    #if ( ffconfigCRC_SLICING_BY_8 != 0 )
+    {
+        while( stLength >= 8U )
+        {
+            byCRC = ( uint8_t ) ( crc8_slice_table[ 6 ][ byCRC ^ pbyData[ 0 ] ] ^
+                                  crc8_slice_table[ 5 ][ pbyData[ 1 ] ] ^
+                                  crc8_slice_table[ 4 ][ pbyData[ 2 ] ] ^
+                                  crc8_slice_table[ 3 ][ pbyData[ 3 ] ] ^
+                                  crc8_slice_table[ 2 ][ pbyData[ 4 ] ] ^
+                                  crc8_slice_table[ 1 ][ pbyData[ 5 ] ] ^
+                                  crc8_slice_table[ 0 ][ pbyData[ 6 ] ] ^
+                                  crc8_table[ pbyData[ 7 ] ] );
+            pbyData += 8;
+            stLength -= 8U;
+        }
+    }
+    #endif /* ffconfigCRC_SLICING_BY_8 */
+
     while( stLength-- != 0 )
     {
         byData = *pbyData++;
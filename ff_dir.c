@@ -40,6 +40,7 @@
 
 #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
     #include <wchar.h>
+    #include <wctype.h>
 #endif
 
 #if defined( WIN32 )
@@ -107,6 +108,22 @@ static FF_Error_t FF_Traverse( FF_IOManager_t * pxIOManager,
 static int32_t FF_FindFreeDirent( FF_IOManager_t * pxIOManager,
                                   FF_FindParams_t * pxFindParams,
                                   uint16_t usSequential );
+static FF_Error_t prvReleaseFetchBuffer( FF_IOManager_t * pxIOManager,
+                                         FF_FetchContext_t * pxContext );
+static FF_Error_t prvFindNextEntry( FF_IOManager_t * pxIOManager,
+                                    FF_DirEnt_t * pxDirEntry );
+
+#if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
+
+/* Let 'pxContext->pxBuffer' point to a sector in the directory block of the
+ * I/O manager, reading the block when needed.  'pxBuffer' remains NULL when
+ * another context is using the block.  The sector is held like a buffer in
+ * read mode until prvReleaseFetchBuffer(). */
+    static FF_Error_t prvDirBlockFetch( FF_IOManager_t * pxIOManager,
+                                        FF_FetchContext_t * pxContext,
+                                        uint32_t ulEntry,
+                                        uint32_t ulItemLBA );
+#endif
 
 #if ( ffconfigLFN_SUPPORT != 0 )
     static int8_t FF_CreateLFNEntry( uint8_t * pucEntryBuffer,
@@ -116,6 +133,43 @@ static int32_t FF_FindFreeDirent( FF_IOManager_t * pxIOManager,
                                      uint8_t ucCheckSum );
 #endif /* ffconfigLFN_SUPPORT */
 
+#if ( ffconfigLFN_INDEX != 0 )
+
+/* Look up a name in the index of a directory, see ffconfigLFN_INDEX.
+ * Returns pdFALSE when the directory must be scanned after all. */
+    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+        static BaseType_t prvLFNIndexFind( FF_IOManager_t * pxIOManager,
+                                           FF_FindParams_t * pxFindParams,
+                                           const FF_T_WCHAR * pcName,
+                                           uint8_t ucAttrib,
+                                           FF_DirEnt_t * pxDirEntry,
+                                           uint32_t * pulResult,
+                                           FF_Error_t * pxError );
+    #else
+        static BaseType_t prvLFNIndexFind( FF_IOManager_t * pxIOManager,
+                                           FF_FindParams_t * pxFindParams,
+                                           const char * pcName,
+                                           uint8_t ucAttrib,
+                                           FF_DirEnt_t * pxDirEntry,
+                                           uint32_t * pulResult,
+                                           FF_Error_t * pxError );
+    #endif
+
+/* Calculate the hash of a name, which is the same for all names that only
+ * differ in case. */
+    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+        static uint16_t prvLFNIndexHash( const FF_T_WCHAR * pcName );
+    #else
+        static uint16_t prvLFNIndexHash( const char * pcName );
+    #endif
+
+/* Add a name to an index that is being built or updated.
+ * Returns pdFALSE when the index can not grow any further. */
+    static BaseType_t prvLFNIndexAppend( FF_LFNIndex_t * pxIndex,
+                                         uint16_t usHash,
+                                         uint16_t usEntry );
+#endif /* ffconfigLFN_INDEX */
+
 static BaseType_t FF_ValidShortChar( char cChar );
 
 #if ( ffconfigLFN_SUPPORT != 0 )
@@ -324,6 +378,7 @@ static BaseType_t FF_ShortNameExists( FF_IOManager_t * pxIOManager,
  * then the existence of that short file name will be checked as well. */
     BaseType_t testShortname;
     uint32_t xResult = 0ul;
+    BaseType_t xScanDirectory = pdTRUE;
 
     #if ( ffconfigUNICODE_UTF8_SUPPORT == 1 )
         int32_t utf8Error;
@@ -385,9 +440,24 @@ static BaseType_t FF_ShortNameExists( FF_IOManager_t * pxIOManager,
         pxFindParams->lFreeEntry = 0;
     }
 
-    xError = FF_InitEntryFetch( pxIOManager, pxFindParams->ulDirCluster, &xFetchContext );
+    #if ( ffconfigLFN_INDEX != 0 )
+        /* A free entry and the existence of the short name can only be
+         * found by scanning the directory. */
+        if( ( testShortname == pdFALSE ) &&
+            ( ( pxFindParams->ulFlags & FIND_FLAG_CREATE_FLAG ) == 0 ) &&
+            ( pxFindParams->pxLFNIndex == NULL ) &&
+            ( prvLFNIndexFind( pxIOManager, pxFindParams, pcName, pa_Attrib, pxDirEntry, &xResult, &xError ) != pdFALSE ) )
+        {
+            /* The index has given the answer. */
+            xScanDirectory = pdFALSE;
+        }
+        else
+    #endif /* ffconfigLFN_INDEX */
+    {
+        xError = FF_InitEntryFetch( pxIOManager, pxFindParams->ulDirCluster, &xFetchContext );
+    }
 
-    if( FF_isERR( xError ) == pdFALSE )
+    if( ( xScanDirectory != pdFALSE ) && ( FF_isERR( xError ) == pdFALSE ) )
     {
         for( pxDirEntry->usCurrentItem = 0; pxDirEntry->usCurrentItem < FF_MAX_ENTRIES_PER_DIRECTORY; pxDirEntry->usCurrentItem++ )
         {
@@ -595,6 +665,22 @@ static BaseType_t FF_ShortNameExists( FF_IOManager_t * pxIOManager,
                 #endif /* ffconfigLFN_SUPPORT */
             }
 
+            #if ( ffconfigLFN_INDEX != 0 )
+                if( pxFindParams->pxLFNIndex != NULL )
+                {
+                    /* The directory is being indexed: record every name in stead of comparing it. */
+                    if( prvLFNIndexAppend( pxFindParams->pxLFNIndex,
+                                           prvLFNIndexHash( pxDirEntry->pcFileName ),
+                                           ( uint16_t ) ( ( xLFNTotal != 0 ) ? lfnItem : pxDirEntry->usCurrentItem ) ) == pdFALSE )
+                    {
+                        break;
+                    }
+
+                    xLFNTotal = 0;
+                    continue;
+                }
+            #endif /* ffconfigLFN_INDEX */
+
             /* This function FF_FindEntryInDir( ) is either called with
             * pa_Attrib==0 or with pa_Attrib==FF_FAT_ATTR_DIR
             * In the last case the caller is looking for a directory */
@@ -685,6 +771,136 @@ static BaseType_t FF_ShortNameExists( FF_IOManager_t * pxIOManager,
 /*-----------------------------------------------------------*/
 
 
+#if ( ffconfigPATH_CACHE != 0 )
+
+/* The names "." and ".." are not stored in the path cache: a ".." entry
+ * would become wrong when its directory is moved. */
+    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+        static BaseType_t prvPathCacheSkip( const FF_T_WCHAR * pcName )
+    #else
+        static BaseType_t prvPathCacheSkip( const char * pcName )
+    #endif
+    {
+        BaseType_t xSkip = pdFALSE;
+
+        if( pcName[ 0 ] == '.' )
+        {
+            if( ( pcName[ 1 ] == '\0' ) || ( ( pcName[ 1 ] == '.' ) && ( pcName[ 2 ] == '\0' ) ) )
+            {
+                xSkip = pdTRUE;
+            }
+        }
+
+        return xSkip;
+    } /* prvPathCacheSkip() */
+/*-----------------------------------------------------------*/
+
+/* Returns the cluster of directory 'pcName' within 'ulParentCluster', or 0
+ * when it is not in the path cache. */
+    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+        static uint32_t prvPathCacheLookup( FF_IOManager_t * pxIOManager,
+                                            uint32_t ulParentCluster,
+                                            const FF_T_WCHAR * pcName )
+    #else
+        static uint32_t prvPathCacheLookup( FF_IOManager_t * pxIOManager,
+                                            uint32_t ulParentCluster,
+                                            const char * pcName )
+    #endif
+    {
+        FF_Partition_t * pxPartition = &( pxIOManager->xPartition );
+        FF_PathCache_t * pxEntry;
+        uint32_t ulDirCluster = 0ul;
+        BaseType_t xIndex;
+
+        if( prvPathCacheSkip( pcName ) == pdFALSE )
+        {
+            FF_PendSemaphore( pxIOManager->pvSemaphore ); /* Thread safety on shared object! */
+            {
+                for( xIndex = 0; xIndex < ffconfigPATH_CACHE_DEPTH; xIndex++ )
+                {
+                    pxEntry = &( pxPartition->pxPathCache[ xIndex ] );
+
+                    /* Directory names are not case-sensitive, just like in FF_FindEntryInDir(). */
+                    if( ( pxEntry->ulDirCluster != 0ul ) &&
+                        ( pxEntry->ulParentCluster == ulParentCluster ) &&
+                        #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+                            ( wcsicmp( ( const char * ) pxEntry->pcName, ( const char * ) pcName ) == 0 ) )
+                        #else
+                            ( FF_stricmp( pxEntry->pcName, pcName ) == 0 ) )
+                        #endif
+                    {
+                        pxEntry->ulLastUsed = ++( pxPartition->ulPCClock );
+                        ulDirCluster = pxEntry->ulDirCluster;
+                        break;
+                    }
+                }
+
+                if( ulDirCluster != 0ul )
+                {
+                    pxPartition->ulPCHits++;
+                }
+                else
+                {
+                    pxPartition->ulPCMisses++;
+                }
+            }
+            FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+        }
+
+        return ulDirCluster;
+    } /* prvPathCacheLookup() */
+/*-----------------------------------------------------------*/
+
+/* Store a directory that was found on disk, replacing the entry that was
+ * used least recently. */
+    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+        static void prvPathCacheAdd( FF_IOManager_t * pxIOManager,
+                                     uint32_t ulParentCluster,
+                                     const FF_T_WCHAR * pcName,
+                                     uint32_t ulDirCluster )
+    #else
+        static void prvPathCacheAdd( FF_IOManager_t * pxIOManager,
+                                     uint32_t ulParentCluster,
+                                     const char * pcName,
+                                     uint32_t ulDirCluster )
+    #endif
+    {
+        FF_Partition_t * pxPartition = &( pxIOManager->xPartition );
+        FF_PathCache_t * pxEntry = pxPartition->pxPathCache;
+        BaseType_t xIndex;
+
+        /* Ensure the name won't cause a buffer overrun. */
+        if( ( prvPathCacheSkip( pcName ) == pdFALSE ) && ( STRLEN( pcName ) < ffconfigMAX_FILENAME ) )
+        {
+            FF_PendSemaphore( pxIOManager->pvSemaphore );
+            {
+                for( xIndex = 0; xIndex < ffconfigPATH_CACHE_DEPTH; xIndex++ )
+                {
+                    if( pxPartition->pxPathCache[ xIndex ].ulDirCluster == 0ul )
+                    {
+                        pxEntry = &( pxPartition->pxPathCache[ xIndex ] );
+                        break;
+                    }
+
+                    if( pxPartition->pxPathCache[ xIndex ].ulLastUsed < pxEntry->ulLastUsed )
+                    {
+                        pxEntry = &( pxPartition->pxPathCache[ xIndex ] );
+                    }
+                }
+
+                STRNCPY( pxEntry->pcName, pcName, ffconfigMAX_FILENAME - 1 );
+                pxEntry->pcName[ ffconfigMAX_FILENAME - 1 ] = '\0';
+                pxEntry->ulParentCluster = ulParentCluster;
+                pxEntry->ulDirCluster = ulDirCluster;
+                pxEntry->ulLastUsed = ++( pxPartition->ulPCClock );
+            }
+            FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+        }
+    } /* prvPathCacheAdd() */
+/*-----------------------------------------------------------*/
+
+#endif /* ffconfigPATH_CACHE */
+
 /**
  *	@private
  **/
@@ -718,7 +934,8 @@ static BaseType_t FF_ShortNameExists( FF_IOManager_t * pxIOManager,
     #endif
 
     #if ( ffconfigPATH_CACHE != 0 )
-        BaseType_t xIndex;
+        uint32_t ulParentCluster;
+        uint32_t ulCachedCluster;
     #endif
 
     memset( &xFindParams, '\0', sizeof( xFindParams ) );
@@ -741,31 +958,6 @@ static BaseType_t FF_ShortNameExists( FF_IOManager_t * pxIOManager,
         }
 
         xFound = pdFALSE;
-
-        #if ( ffconfigPATH_CACHE != 0 )                   /* Is the requested pcPath in the PATH CACHE? */
-        {
-            FF_PendSemaphore( pxIOManager->pvSemaphore ); /* Thread safety on shared object! */
-            {
-                for( xIndex = 0; xIndex < ffconfigPATH_CACHE_DEPTH; xIndex++ )
-                {
-                    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
-                        if( wcslen( pxIOManager->xPartition.pxPathCache[ xIndex ].pcPath ) == ( size_t ) pathLen )
-                    #else
-                        if( strlen( pxIOManager->xPartition.pxPathCache[ xIndex ].pcPath ) == ( size_t ) pathLen )
-                    #endif
-                    {
-                        if( FF_strmatch( pxIOManager->xPartition.pxPathCache[ xIndex ].pcPath, pcPath, pathLen ) )
-                        {
-                            xFindParams.ulDirCluster = pxIOManager->xPartition.pxPathCache[ xIndex ].ulDirCluster;
-                            xFound = pdTRUE;
-                            break;
-                        }
-                    }
-                }
-            }
-            FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
-        }
-        #endif /* ffconfigPATH_CACHE */
     }
 
     if( xFound == pdFALSE )
@@ -774,8 +966,33 @@ static BaseType_t FF_ShortNameExists( FF_IOManager_t * pxIOManager,
 
         do
         {
-            xMyDirectory.usCurrentItem = 0;
-            xFindParams.ulDirCluster = FF_FindEntryInDir( pxIOManager, &xFindParams, pcToken, ( uint8_t ) FF_FAT_ATTR_DIR, &xMyDirectory, &xError );
+            /* With a path cache, every directory that is passed on the way is
+             * looked up in the cache first, so the longest cached part of the
+             * path is never searched on disk. */
+            #if ( ffconfigPATH_CACHE != 0 )
+                ulParentCluster = xFindParams.ulDirCluster;
+                ulCachedCluster = prvPathCacheLookup( pxIOManager, ulParentCluster, pcToken );
+
+                if( ulCachedCluster != 0ul )
+                {
+                    xFindParams.ulDirCluster = ulCachedCluster;
+                }
+                else
+            #endif
+            {
+                xMyDirectory.usCurrentItem = 0;
+                xFindParams.ulDirCluster = FF_FindEntryInDir( pxIOManager, &xFindParams, pcToken, ( uint8_t ) FF_FAT_ATTR_DIR, &xMyDirectory, &xError );
+
+                #if ( ffconfigPATH_CACHE != 0 )
+                {
+                    /* Only cache if the dir was actually found! */
+                    if( ( FF_isERR( xError ) == pdFALSE ) && ( xFindParams.ulDirCluster != 0ul ) )
+                    {
+                        prvPathCacheAdd( pxIOManager, ulParentCluster, pcToken, xFindParams.ulDirCluster );
+                    }
+                }
+                #endif
+            }
 
             if( xFindParams.ulDirCluster == 0ul )
             {
@@ -790,41 +1007,6 @@ static BaseType_t FF_ShortNameExists( FF_IOManager_t * pxIOManager,
         {
             xError = FF_createERR( FF_FINDDIR, FF_ERR_FILE_INVALID_PATH );
         }
-
-        #if ( ffconfigPATH_CACHE != 0 ) /* Update the PATH CACHE with a new PATH. */
-        {
-            /* Only cache if the dir was actually found! */
-            if( ( FF_isERR( xError ) == pdFALSE ) && ( xFindParams.ulDirCluster != 0ul ) )
-            {
-                FF_PendSemaphore( pxIOManager->pvSemaphore );
-                {
-                    if( pathLen < ffconfigMAX_FILENAME ) /* Ensure the PATH won't cause a buffer overrun. */
-                    {
-                        #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
-                        {
-                            memcpy( pxIOManager->xPartition.pxPathCache[ pxIOManager->xPartition.ulPCIndex ].pcPath, pcPath, pathLen * sizeof( FF_T_WCHAR ) );
-                        }
-                        #else
-                        {
-                            memcpy( pxIOManager->xPartition.pxPathCache[ pxIOManager->xPartition.ulPCIndex ].pcPath, pcPath, pathLen );
-                        }
-                        #endif
-
-                        pxIOManager->xPartition.pxPathCache[ pxIOManager->xPartition.ulPCIndex ].pcPath[ pathLen ] = '\0';
-                        pxIOManager->xPartition.pxPathCache[ pxIOManager->xPartition.ulPCIndex ].ulDirCluster = xFindParams.ulDirCluster;
-
-                        pxIOManager->xPartition.ulPCIndex += 1;
-
-                        if( pxIOManager->xPartition.ulPCIndex >= ffconfigPATH_CACHE_DEPTH )
-                        {
-                            pxIOManager->xPartition.ulPCIndex = 0;
-                        }
-                    }
-                }
-                FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
-            }
-        }
-        #endif /* ffconfigPATH_CACHE */
     } /* if( pathLen > 1 ) */
 
     if( pxError != NULL )
@@ -1098,18 +1280,118 @@ FF_Error_t FF_InitEntryFetch( FF_IOManager_t * pxIOManager,
 FF_Error_t FF_CleanupEntryFetch( FF_IOManager_t * pxIOManager,
                                  FF_FetchContext_t * pxContext )
 {
-    FF_Error_t xError = FF_ERR_NONE;
+    FF_Error_t xError;
 
-    if( pxContext->pxBuffer )
+    xError = prvReleaseFetchBuffer( pxIOManager, pxContext );
+
+    #if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
     {
-        xError = FF_ReleaseBuffer( pxIOManager, pxContext->pxBuffer );
-        pxContext->pxBuffer = NULL;
+        FF_DirBlockRelease( pxIOManager, ( void * ) pxContext, pdTRUE );
     }
+    #endif
 
     return xError;
 } /* FF_CleanupEntryFetch() */
 /*-----------------------------------------------------------*/
 
+static FF_Error_t prvReleaseFetchBuffer( FF_IOManager_t * pxIOManager,
+                                         FF_FetchContext_t * pxContext )
+{
+    FF_Buffer_t * pxBuffer = pxContext->pxBuffer;
+    FF_Error_t xError = FF_ERR_NONE;
+
+    pxContext->pxBuffer = NULL;
+
+    #if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
+    {
+        if( pxBuffer == &( pxIOManager->xDirBlockBuffer ) )
+        {
+            /* A sector in the directory block, not in the cache. */
+            FF_DirBlockRelease( pxIOManager, ( void * ) pxContext, pdFALSE );
+            pxBuffer = NULL;
+        }
+    }
+    #endif
+
+    if( pxBuffer != NULL )
+    {
+        xError = FF_ReleaseBuffer( pxIOManager, pxBuffer );
+    }
+
+    return xError;
+} /* prvReleaseFetchBuffer() */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
+    static FF_Error_t prvDirBlockFetch( FF_IOManager_t * pxIOManager,
+                                        FF_FetchContext_t * pxContext,
+                                        uint32_t ulEntry,
+                                        uint32_t ulItemLBA )
+    {
+        FF_Buffer_t * pxBlockBuffer = &( pxIOManager->xDirBlockBuffer );
+        uint32_t ulBytes;
+        uint32_t ulOffset = ulEntry * FF_SIZEOF_DIRECTORY_ENTRY;
+        int32_t lResult;
+        FF_Error_t xError = FF_ERR_NONE;
+
+        /* Other tasks change the block while writing sectors, see
+         * FF_GetBuffer() and FF_BlockWrite(). */
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
+
+        if( pxIOManager->pvDirBlockOwner == NULL )
+        {
+            pxIOManager->pvDirBlockOwner = ( void * ) pxContext;
+        }
+
+        if( pxIOManager->pvDirBlockOwner == ( void * ) pxContext )
+        {
+            if( ( ulItemLBA - pxIOManager->ulDirBlockSector ) >= pxIOManager->ulDirBlockCount )
+            {
+                /* Read the rest of the cluster.  The root directory of a
+                 * FAT12/16 volume is one contiguous run of sectors. */
+                if( ( pxIOManager->xPartition.ucType != FF_T_FAT32 ) &&
+                    ( pxContext->ulDirCluster == pxIOManager->xPartition.ulRootDirCluster ) )
+                {
+                    ulBytes = pxIOManager->xPartition.ulRootDirSectors * pxIOManager->xPartition.usBlkSize;
+                }
+                else
+                {
+                    ulBytes = pxIOManager->xPartition.ulSectorsPerCluster * pxIOManager->xPartition.usBlkSize;
+                    ulOffset %= ulBytes;
+                }
+
+                /* Start at the sector that holds the entry. */
+                ulOffset -= ulOffset % pxIOManager->usSectorSize;
+
+                if( ulOffset < ulBytes )
+                {
+                    lResult = FF_DirBlockRead( pxIOManager, ulItemLBA, ( ulBytes - ulOffset ) / pxIOManager->usSectorSize );
+
+                    if( lResult < 0 )
+                    {
+                        xError = ( FF_Error_t ) lResult;
+                    }
+                }
+            }
+
+            if( ( FF_isERR( xError ) == pdFALSE ) &&
+                ( ( ulItemLBA - pxIOManager->ulDirBlockSector ) < pxIOManager->ulDirBlockCount ) )
+            {
+                pxBlockBuffer->pucBuffer = pxIOManager->pucDirBlockMem + ( ( ulItemLBA - pxIOManager->ulDirBlockSector ) * pxIOManager->usSectorSize );
+                pxBlockBuffer->ulSector = ulItemLBA;
+                pxBlockBuffer->ucMode = FF_MODE_READ;
+                pxBlockBuffer->usNumHandles = 1U;
+                pxContext->pxBuffer = pxBlockBuffer;
+            }
+        }
+
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+
+        return xError;
+    } /* prvDirBlockFetch() */
+/*-----------------------------------------------------------*/
+#endif /* ffconfigDIRECTORY_READ_SECTORS */
+
 /**
  *	@brief	Find the cluster for a given Entry within a directory
  *          Make an exception for the root directory ( non FAT32 only ):
@@ -1207,13 +1489,18 @@ FF_Error_t FF_FetchEntryWithContext( FF_IOManager_t * pxIOManager,
             ( pxContext->pxBuffer->ulSector != ulItemLBA ) ||
             ( ( pxContext->pxBuffer->ucMode & FF_MODE_WRITE ) != 0 ) )
         {
-            if( pxContext->pxBuffer != NULL )
+            xError = prvReleaseFetchBuffer( pxIOManager, pxContext );
+
+            #if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
             {
-                xError = FF_ReleaseBuffer( pxIOManager, pxContext->pxBuffer );
-                pxContext->pxBuffer = NULL;
+                if( FF_isERR( xError ) == pdFALSE )
+                {
+                    xError = prvDirBlockFetch( pxIOManager, pxContext, ulEntry, ulItemLBA );
+                }
             }
+            #endif
 
-            if( FF_isERR( xError ) == pdFALSE )
+            if( ( FF_isERR( xError ) == pdFALSE ) && ( pxContext->pxBuffer == NULL ) )
             {
                 pxContext->pxBuffer = FF_GetBuffer( pxIOManager, ulItemLBA, FF_MODE_READ );
 
@@ -1265,11 +1552,7 @@ FF_Error_t FF_PushEntryWithContext( FF_IOManager_t * pxIOManager,
             ( pxContext->pxBuffer->ulSector != ulItemLBA ) ||
             ( ( pxContext->pxBuffer->ucMode & FF_MODE_WRITE ) == 0 ) )
         {
-            if( pxContext->pxBuffer != NULL )
-            {
-                xError = FF_ReleaseBuffer( pxIOManager, pxContext->pxBuffer );
-                pxContext->pxBuffer = NULL;
-            }
+            xError = prvReleaseFetchBuffer( pxIOManager, pxContext );
 
             if( FF_isERR( xError ) == pdFALSE )
             {
@@ -1754,20 +2037,10 @@ FF_Error_t FF_PopulateLongDirent( FF_IOManager_t * pxIOManager,
 } /* FF_FindFirst() */
 /*-----------------------------------------------------------*/
 
-/**
- *	@brief	Get's the next Entry based on the data recorded in the FF_DirEnt_t object.
- *
- *	All values recorded in pxDirEntry must be preserved to and between calls to
- *	FF_FindNext( ). Please see @see FF_FindFirst( ) for find initialisation.
- *
- *	@param	pxIOManager		FF_IOManager_t object that was created by FF_CreateIOManager( ).
- *	@param	pxDirEntry		FF_DirEnt_t object to store the entry information. ( As initialised by FF_FindFirst( )).
- *
- *	@retval FF_ERR_DEVICE_DRIVER_FAILED is device access failed.
- *
- **/
-FF_Error_t FF_FindNext( FF_IOManager_t * pxIOManager,
-                        FF_DirEnt_t * pxDirEntry )
+/* Read the next entry that matches into 'pxDirEntry', leaving the fetch
+ * context open.  Used by FF_FindNext() and FF_FindNextBatch(). */
+static FF_Error_t prvFindNextEntry( FF_IOManager_t * pxIOManager,
+                                    FF_DirEnt_t * pxDirEntry )
 {
     FF_Error_t xError;
     BaseType_t xLFNCount;
@@ -1777,195 +2050,218 @@ FF_Error_t FF_FindNext( FF_IOManager_t * pxIOManager,
         BaseType_t b;
     #endif
 
-    if( pxIOManager == NULL )
-    {
-        xError = FF_createERR( FF_ERR_NULL_POINTER, FF_FINDNEXT );
-    }
+    xError = FF_ERR_NONE;
 
-    #if ( ffconfigREMOVABLE_MEDIA != 0 )
-        else if( ( pxIOManager->ucFlags & FF_IOMAN_DEVICE_IS_EXTRACTED ) != 0 )
-        {
-            xError = FF_createERR( FF_ERR_IOMAN_DRIVER_NOMEDIUM, FF_FINDNEXT );
-        }
-    #endif /* ffconfigREMOVABLE_MEDIA */
-    else
+    for( ; pxDirEntry->usCurrentItem < FF_MAX_ENTRIES_PER_DIRECTORY; pxDirEntry->usCurrentItem++ )
     {
-        xError = FF_ERR_NONE;
-
-        for( ; pxDirEntry->usCurrentItem < FF_MAX_ENTRIES_PER_DIRECTORY; pxDirEntry->usCurrentItem++ )
+        if( ( pucEntryBuffer == NULL ) ||
+            ( pucEntryBuffer >= ( pxDirEntry->xFetchContext.pxBuffer->pucBuffer + ( pxIOManager->usSectorSize - FF_SIZEOF_DIRECTORY_ENTRY ) ) ) )
         {
-            if( ( pucEntryBuffer == NULL ) ||
-                ( pucEntryBuffer >= ( pxDirEntry->xFetchContext.pxBuffer->pucBuffer + ( pxIOManager->usSectorSize - FF_SIZEOF_DIRECTORY_ENTRY ) ) ) )
-            {
-                xError = FF_FetchEntryWithContext( pxIOManager, pxDirEntry->usCurrentItem, &( pxDirEntry->xFetchContext ), NULL );
-
-                if( FF_isERR( xError ) )
-                {
-                    break;
-                }
+            xError = FF_FetchEntryWithContext( pxIOManager, pxDirEntry->usCurrentItem, &( pxDirEntry->xFetchContext ), NULL );
 
-                if( pucEntryBuffer == NULL )
-                {
-                    pucEntryBuffer = pxDirEntry->xFetchContext.pxBuffer->pucBuffer +
-                                     ( FF_SIZEOF_DIRECTORY_ENTRY * ( pxDirEntry->usCurrentItem % ( pxIOManager->usSectorSize / FF_SIZEOF_DIRECTORY_ENTRY ) ) );
-                }
-                else
-                {
-                    pucEntryBuffer = pxDirEntry->xFetchContext.pxBuffer->pucBuffer;
-                }
-            }
-            else
+            if( FF_isERR( xError ) )
             {
-                pucEntryBuffer += FF_SIZEOF_DIRECTORY_ENTRY;
+                break;
             }
 
-            if( FF_isDeleted( pucEntryBuffer ) != pdFALSE )
+            if( pucEntryBuffer == NULL )
             {
-                /* The entry is not in use or deleted. */
-                continue;
+                pucEntryBuffer = pxDirEntry->xFetchContext.pxBuffer->pucBuffer +
+                                 ( FF_SIZEOF_DIRECTORY_ENTRY * ( pxDirEntry->usCurrentItem % ( pxIOManager->usSectorSize / FF_SIZEOF_DIRECTORY_ENTRY ) ) );
             }
-
-            if( FF_isEndOfDir( pucEntryBuffer ) )
+            else
             {
-                /* End of directory, generate a pseudo error 'DIR_END_OF_DIR'. */
-                xError = FF_createERR( FF_ERR_DIR_END_OF_DIR, FF_FINDNEXT );
-                break;
+                pucEntryBuffer = pxDirEntry->xFetchContext.pxBuffer->pucBuffer;
             }
+        }
+        else
+        {
+            pucEntryBuffer += FF_SIZEOF_DIRECTORY_ENTRY;
+        }
 
-            pxDirEntry->ucAttrib = FF_getChar( pucEntryBuffer, ( uint16_t ) ( FF_FAT_DIRENT_ATTRIB ) );
+        if( FF_isDeleted( pucEntryBuffer ) != pdFALSE )
+        {
+            /* The entry is not in use or deleted. */
+            continue;
+        }
 
-            if( ( pxDirEntry->ucAttrib & FF_FAT_ATTR_LFN ) == FF_FAT_ATTR_LFN )
+        if( FF_isEndOfDir( pucEntryBuffer ) )
+        {
+            /* End of directory, generate a pseudo error 'DIR_END_OF_DIR'. */
+            xError = FF_createERR( FF_ERR_DIR_END_OF_DIR, FF_FINDNEXT );
+            break;
+        }
+
+        pxDirEntry->ucAttrib = FF_getChar( pucEntryBuffer, ( uint16_t ) ( FF_FAT_DIRENT_ATTRIB ) );
+
+        if( ( pxDirEntry->ucAttrib & FF_FAT_ATTR_LFN ) == FF_FAT_ATTR_LFN )
+        {
+            /* LFN Processing. */
+            xLFNCount = ( BaseType_t ) ( pucEntryBuffer[ 0 ] & ~0x40 );
+            /* Get the shortname and check if it is marked deleted. */
+            #if ( ffconfigLFN_SUPPORT != 0 )
             {
-                /* LFN Processing. */
-                xLFNCount = ( BaseType_t ) ( pucEntryBuffer[ 0 ] & ~0x40 );
-                /* Get the shortname and check if it is marked deleted. */
-                #if ( ffconfigLFN_SUPPORT != 0 )
+                /* Reserve 32 bytes to hold one directory entry. */
+                uint8_t Buffer[ FF_SIZEOF_DIRECTORY_ENTRY ];
+
+                /* Fetch the shortname, and get it's checksum, or for a deleted item with
+                 * orphaned LFN entries. */
+                xError = FF_FetchEntryWithContext( pxIOManager, ( uint32_t ) ( pxDirEntry->usCurrentItem + xLFNCount ), &pxDirEntry->xFetchContext, Buffer );
+
+                if( FF_isERR( xError ) )
                 {
-                    /* Reserve 32 bytes to hold one directory entry. */
-                    uint8_t Buffer[ FF_SIZEOF_DIRECTORY_ENTRY ];
+                    break;
+                }
 
-                    /* Fetch the shortname, and get it's checksum, or for a deleted item with
-                     * orphaned LFN entries. */
-                    xError = FF_FetchEntryWithContext( pxIOManager, ( uint32_t ) ( pxDirEntry->usCurrentItem + xLFNCount ), &pxDirEntry->xFetchContext, Buffer );
+                if( FF_isDeleted( Buffer ) == pdFALSE )
+                {
+                    xError = FF_PopulateLongDirent( pxIOManager, pxDirEntry, pxDirEntry->usCurrentItem, &pxDirEntry->xFetchContext );
 
                     if( FF_isERR( xError ) )
                     {
                         break;
                     }
 
-                    if( FF_isDeleted( Buffer ) == pdFALSE )
+                    #if ( ffconfigINCLUDE_SHORT_NAME != 0 )
                     {
-                        xError = FF_PopulateLongDirent( pxIOManager, pxDirEntry, pxDirEntry->usCurrentItem, &pxDirEntry->xFetchContext );
-
-                        if( FF_isERR( xError ) )
-                        {
-                            break;
-                        }
+                        pxDirEntry->ucAttrib |= FF_FAT_ATTR_IS_LFN;
+                    }
+                    #endif
 
-                        #if ( ffconfigINCLUDE_SHORT_NAME != 0 )
-                        {
-                            pxDirEntry->ucAttrib |= FF_FAT_ATTR_IS_LFN;
-                        }
+                    #if ( ffconfigFINDAPI_ALLOW_WILDCARDS != 0 )
+                    {
+                        #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+                            if( wcscmp( pxDirEntry->pcWildCard, L"" ) )
+                        #else
+                            if( pxDirEntry->pcWildCard[ 0 ] )
                         #endif
-
-                        #if ( ffconfigFINDAPI_ALLOW_WILDCARDS != 0 )
                         {
-                            #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
-                                if( wcscmp( pxDirEntry->pcWildCard, L"" ) )
-                            #else
-                                if( pxDirEntry->pcWildCard[ 0 ] )
-                            #endif
-                            {
-                                b = FF_wildcompare( pxDirEntry->pcWildCard, pxDirEntry->pcFileName );
-
-                                if( pxDirEntry->xInvertWildCard != pdFALSE )
-                                {
-                                    b = !b;
-                                }
-
-                                if( b != 0 )
-                                {
-                                    break;
-                                }
+                            b = FF_wildcompare( pxDirEntry->pcWildCard, pxDirEntry->pcFileName );
 
-                                /* 'usCurrentItem' has already incremented by FF_PopulateLongDirent(),
-                                 * this loop will increment it again. */
-                                pxDirEntry->usCurrentItem -= 1;
-
-                                /* xFetchContext/usCurrentItem have changed.  Update
-                                 * 'pucEntryBuffer' to point to the current buffer position. */
-                                pucEntryBuffer = pxDirEntry->xFetchContext.pxBuffer->pucBuffer +
-                                                 ( FF_SIZEOF_DIRECTORY_ENTRY * ( pxDirEntry->usCurrentItem % ( pxIOManager->usSectorSize / FF_SIZEOF_DIRECTORY_ENTRY ) ) );
+                            if( pxDirEntry->xInvertWildCard != pdFALSE )
+                            {
+                                b = !b;
                             }
-                            else
+
+                            if( b != 0 )
                             {
                                 break;
                             }
+
+                            /* 'usCurrentItem' has already incremented by FF_PopulateLongDirent(),
+                             * this loop will increment it again. */
+                            pxDirEntry->usCurrentItem -= 1;
+
+                            /* xFetchContext/usCurrentItem have changed.  Update
+                             * 'pucEntryBuffer' to point to the current buffer position. */
+                            pucEntryBuffer = pxDirEntry->xFetchContext.pxBuffer->pucBuffer +
+                                             ( FF_SIZEOF_DIRECTORY_ENTRY * ( pxDirEntry->usCurrentItem % ( pxIOManager->usSectorSize / FF_SIZEOF_DIRECTORY_ENTRY ) ) );
                         }
-                        #else /* ffconfigFINDAPI_ALLOW_WILDCARDS == 0 */
+                        else
                         {
-                            /* usCurrentItem has been incremented by FF_PopulateLongDirent().
-                             * Entry will be returned. */
                             break;
                         }
-                        #endif /* if ( ffconfigFINDAPI_ALLOW_WILDCARDS != 0 ) */
                     }
+                    #else /* ffconfigFINDAPI_ALLOW_WILDCARDS == 0 */
+                    {
+                        /* usCurrentItem has been incremented by FF_PopulateLongDirent().
+                         * Entry will be returned. */
+                        break;
+                    }
+                    #endif /* if ( ffconfigFINDAPI_ALLOW_WILDCARDS != 0 ) */
                 }
-                #else /* ffconfigLFN_SUPPORT */
-                {
-                    /* Increment 'usCurrentItem' with (xLFNCount-1),
-                     * the loop will do an extra increment. */
-                    pxDirEntry->usCurrentItem += ( xLFNCount - 1 );
-                }
-                #endif /* ffconfigLFN_SUPPORT */
-            } /* ( ( pxDirEntry->ucAttrib & FF_FAT_ATTR_LFN ) == FF_FAT_ATTR_LFN ) */
-            else if( ( pxDirEntry->ucAttrib & FF_FAT_ATTR_VOLID ) != FF_FAT_ATTR_VOLID )
+            }
+            #else /* ffconfigLFN_SUPPORT */
             {
-                /* If it's not a LFN entry, neither a Volume ID, it is a normal short name entry. */
-                FF_PopulateShortDirent( pxIOManager, pxDirEntry, pucEntryBuffer );
-                #if ( ffconfigSHORTNAME_CASE != 0 )
-                {
-                    /* Apply NT/XP+ bits to get correct case. */
-                    FF_CaseShortName( pxDirEntry->pcFileName, FF_getChar( pucEntryBuffer, FF_FAT_CASE_OFFS ) );
-                }
-                #endif
+                /* Increment 'usCurrentItem' with (xLFNCount-1),
+                 * the loop will do an extra increment. */
+                pxDirEntry->usCurrentItem += ( xLFNCount - 1 );
+            }
+            #endif /* ffconfigLFN_SUPPORT */
+        } /* ( ( pxDirEntry->ucAttrib & FF_FAT_ATTR_LFN ) == FF_FAT_ATTR_LFN ) */
+        else if( ( pxDirEntry->ucAttrib & FF_FAT_ATTR_VOLID ) != FF_FAT_ATTR_VOLID )
+        {
+            /* If it's not a LFN entry, neither a Volume ID, it is a normal short name entry. */
+            FF_PopulateShortDirent( pxIOManager, pxDirEntry, pucEntryBuffer );
+            #if ( ffconfigSHORTNAME_CASE != 0 )
+            {
+                /* Apply NT/XP+ bits to get correct case. */
+                FF_CaseShortName( pxDirEntry->pcFileName, FF_getChar( pucEntryBuffer, FF_FAT_CASE_OFFS ) );
+            }
+            #endif
 
-                #if ( ffconfigFINDAPI_ALLOW_WILDCARDS != 0 )
+            #if ( ffconfigFINDAPI_ALLOW_WILDCARDS != 0 )
+            {
+                if( pxDirEntry->pcWildCard[ 0 ] )
                 {
-                    if( pxDirEntry->pcWildCard[ 0 ] )
-                    {
-                        b = FF_wildcompare( pxDirEntry->pcWildCard, pxDirEntry->pcFileName );
-
-                        if( pxDirEntry->xInvertWildCard != pdFALSE )
-                        {
-                            b = !b;
-                        }
+                    b = FF_wildcompare( pxDirEntry->pcWildCard, pxDirEntry->pcFileName );
 
-                        if( b != 0 )
-                        {
-                            pxDirEntry->usCurrentItem += 1;
-                            break;
-                        }
+                    if( pxDirEntry->xInvertWildCard != pdFALSE )
+                    {
+                        b = !b;
                     }
-                    else
+
+                    if( b != 0 )
                     {
                         pxDirEntry->usCurrentItem += 1;
                         break;
                     }
                 }
-                #else /* ffconfigFINDAPI_ALLOW_WILDCARDS */
+                else
                 {
                     pxDirEntry->usCurrentItem += 1;
                     break;
                 }
-                #endif /* if ( ffconfigFINDAPI_ALLOW_WILDCARDS != 0 ) */
             }
-        } /* for ( ; pxDirEntry->usCurrentItem < FF_MAX_ENTRIES_PER_DIRECTORY; pxDirEntry->usCurrentItem++ ) */
+            #else /* ffconfigFINDAPI_ALLOW_WILDCARDS */
+            {
+                pxDirEntry->usCurrentItem += 1;
+                break;
+            }
+            #endif /* if ( ffconfigFINDAPI_ALLOW_WILDCARDS != 0 ) */
+        }
+    } /* for ( ; pxDirEntry->usCurrentItem < FF_MAX_ENTRIES_PER_DIRECTORY; pxDirEntry->usCurrentItem++ ) */
 
-        if( pxDirEntry->usCurrentItem == FF_MAX_ENTRIES_PER_DIRECTORY )
+    if( pxDirEntry->usCurrentItem == FF_MAX_ENTRIES_PER_DIRECTORY )
+    {
+        xError = FF_createERR( FF_ERR_DIR_END_OF_DIR, FF_FINDNEXT );
+    }
+
+    return xError;
+} /* prvFindNextEntry() */
+/*-----------------------------------------------------------*/
+
+/**
+ *	@brief	Get's the next Entry based on the data recorded in the FF_DirEnt_t object.
+ *
+ *	All values recorded in pxDirEntry must be preserved to and between calls to
+ *	FF_FindNext( ). Please see @see FF_FindFirst( ) for find initialisation.
+ *
+ *	@param	pxIOManager		FF_IOManager_t object that was created by FF_CreateIOManager( ).
+ *	@param	pxDirEntry		FF_DirEnt_t object to store the entry information. ( As initialised by FF_FindFirst( )).
+ *
+ *	@retval FF_ERR_DEVICE_DRIVER_FAILED is device access failed.
+ *
+ **/
+FF_Error_t FF_FindNext( FF_IOManager_t * pxIOManager,
+                        FF_DirEnt_t * pxDirEntry )
+{
+    FF_Error_t xError;
+
+    if( pxIOManager == NULL )
+    {
+        xError = FF_createERR( FF_ERR_NULL_POINTER, FF_FINDNEXT );
+    }
+
+    #if ( ffconfigREMOVABLE_MEDIA != 0 )
+        else if( ( pxIOManager->ucFlags & FF_IOMAN_DEVICE_IS_EXTRACTED ) != 0 )
         {
-            xError = FF_createERR( FF_ERR_DIR_END_OF_DIR, FF_FINDNEXT );
+            xError = FF_createERR( FF_ERR_IOMAN_DRIVER_NOMEDIUM, FF_FINDNEXT );
         }
+    #endif /* ffconfigREMOVABLE_MEDIA */
+    else
+    {
+        xError = prvFindNextEntry( pxIOManager, pxDirEntry );
 
         {
             FF_Error_t xTempError;
@@ -1982,6 +2278,101 @@ FF_Error_t FF_FindNext( FF_IOManager_t * pxIOManager,
 } /* FF_FindNext() */
 /*-----------------------------------------------------------*/
 
+/**
+ *	@brief	Reads the entries that follow the one in 'pxDirEntry' into an array,
+ *          in a single pass while the directory is locked.
+ *
+ *	@param	pxIOManager		FF_IOManager_t object that was created by FF_CreateIOManager( ).
+ *	@param	pxDirEntry		FF_DirEnt_t object as initialised by FF_FindFirst( ), it keeps the position.
+ *	@param	pxInfo			An array that receives up to 'ulMaxCount' entries.
+ *	@param	ulMaxCount		The number of elements in 'pxInfo'.
+ *	@param	pulCount		Receives the number of entries stored in 'pxInfo'.
+ *
+ *	@retval	FF_ERR_NONE when the array was filled, FF_ERR_DIR_END_OF_DIR when the
+ *          end of the directory was reached first, or another error.
+ *
+ *	The entries are the ones FF_FindNext( ) would return, afterwards 'pxDirEntry'
+ *	holds the last one of them.  The fetch context stays open between the
+ *	entries, instead of being released after each of them.
+ **/
+FF_Error_t FF_FindNextBatch( FF_IOManager_t * pxIOManager,
+                             FF_DirEnt_t * pxDirEntry,
+                             FF_DirInfo_t * pxInfo,
+                             uint32_t ulMaxCount,
+                             uint32_t * pulCount )
+{
+    FF_Error_t xError = FF_ERR_NONE;
+    FF_Error_t xTempError;
+    FF_DirInfo_t * pxTarget;
+    uint32_t ulCount = 0U;
+
+    if( ( pxIOManager == NULL ) || ( pxDirEntry == NULL ) || ( pxInfo == NULL ) || ( pulCount == NULL ) )
+    {
+        xError = FF_createERR( FF_ERR_NULL_POINTER, FF_FINDNEXTBATCH );
+    }
+
+    #if ( ffconfigREMOVABLE_MEDIA != 0 )
+        else if( ( pxIOManager->ucFlags & FF_IOMAN_DEVICE_IS_EXTRACTED ) != 0 )
+        {
+            xError = FF_createERR( FF_ERR_IOMAN_DRIVER_NOMEDIUM, FF_FINDNEXTBATCH );
+        }
+    #endif /* ffconfigREMOVABLE_MEDIA */
+    else
+    {
+        /* No entries will be added or removed during the pass. */
+        FF_LockDirectoryCluster( pxIOManager, pxDirEntry->ulDirCluster );
+
+        while( ulCount < ulMaxCount )
+        {
+            xError = prvFindNextEntry( pxIOManager, pxDirEntry );
+
+            if( FF_isERR( xError ) )
+            {
+                break;
+            }
+
+            pxTarget = &( pxInfo[ ulCount ] );
+            pxTarget->ulFileSize = pxDirEntry->ulFileSize;
+            pxTarget->ulObjectCluster = pxDirEntry->ulObjectCluster;
+            pxTarget->ucAttrib = pxDirEntry->ucAttrib;
+            #if ( ffconfigTIME_SUPPORT != 0 )
+            {
+                memcpy( &( pxTarget->xCreateTime ), &( pxDirEntry->xCreateTime ), sizeof( pxTarget->xCreateTime ) );
+                memcpy( &( pxTarget->xModifiedTime ), &( pxDirEntry->xModifiedTime ), sizeof( pxTarget->xModifiedTime ) );
+                memcpy( &( pxTarget->xAccessedTime ), &( pxDirEntry->xAccessedTime ), sizeof( pxTarget->xAccessedTime ) );
+            }
+            #endif
+            #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+            {
+                wcscpy( pxTarget->pcFileName, pxDirEntry->pcFileName );
+            }
+            #else
+            {
+                strcpy( pxTarget->pcFileName, pxDirEntry->pcFileName );
+            }
+            #endif
+            ulCount++;
+        }
+
+        xTempError = FF_CleanupEntryFetch( pxIOManager, &( pxDirEntry->xFetchContext ) );
+
+        FF_UnlockDirectoryCluster( pxIOManager, pxDirEntry->ulDirCluster );
+
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            xError = xTempError;
+        }
+    }
+
+    if( pulCount != NULL )
+    {
+        *pulCount = ulCount;
+    }
+
+    return xError;
+} /* FF_FindNextBatch() */
+/*-----------------------------------------------------------*/
+
 
 /*
  *  Returns >= 0 for a free dirent entry.
@@ -2804,6 +3195,10 @@ FF_Error_t FF_ExtendDirectory( FF_IOManager_t * pxIOManager,
         /* root directories on FAT12 and FAT16 can not be extended. */
         xError = FF_createERR( FF_ERR_DIR_CANT_EXTEND_ROOT_DIR, FF_EXTENDDIRECTORY );
     }
+    else if( FF_FreeScanBusy( pxIOManager ) != pdFALSE )
+    {
+        /* The free clusters are still being counted, FF_FindFreeCluster() will tell. */
+    }
     else if( pxIOManager->xPartition.ulFreeClusterCount == 0UL )
     {
         /* The number of free clusters was not yet calculated or equal to zero. */
@@ -2812,7 +3207,7 @@ FF_Error_t FF_ExtendDirectory( FF_IOManager_t * pxIOManager,
 
     if( FF_isERR( xError ) == pdFALSE )
     {
-        if( pxIOManager->xPartition.ulFreeClusterCount == 0UL )
+        if( ( pxIOManager->xPartition.ulFreeClusterCount == 0UL ) && ( FF_FreeScanBusy( pxIOManager ) == pdFALSE ) )
         {
             xError = FF_createERR( FF_ERR_FAT_NO_FREE_CLUSTERS, FF_EXTENDDIRECTORY );
         }
@@ -2930,6 +3325,13 @@ FF_Error_t FF_CreateDirent( FF_IOManager_t * pxIOManager,
     #if ( ffconfigHASH_CACHE != 0 )
         char pcShortName[ 13 ];
     #endif
+    #if ( ffconfigLFN_INDEX != 0 )
+        #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+            FF_T_WCHAR pcIndexName[ 13 ];
+        #else
+            char pcIndexName[ 13 ];
+        #endif
+    #endif
     #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
         uint16_t NameLen = ( uint16_t ) wcslen( pxDirEntry->pcFileName );
     #else
@@ -2957,8 +3359,9 @@ FF_Error_t FF_CreateDirent( FF_IOManager_t * pxIOManager,
     }
     #endif
 
-    /* Create the ShortName. */
-    FF_LockDirectory( pxIOManager );
+    /* Create the ShortName.  Only this directory has to be locked, the
+     * directory may be extended by FF_FindFreeDirent() while it is. */
+    FF_LockDirectoryCluster( pxIOManager, ulDirCluster );
 
     do
     {
@@ -3077,11 +3480,33 @@ FF_Error_t FF_CreateDirent( FF_IOManager_t * pxIOManager,
                 #endif /* ffconfigHASH_FUNCTION */
             }
             #endif /* ffconfigHASH_CACHE*/
+
+            #if ( ffconfigLFN_INDEX != 0 )
+            {
+                if( xLFNCount > 0 )
+                {
+                    FF_LFNIndexAdd( pxIOManager, ulDirCluster, pxDirEntry->pcFileName, ( uint16_t ) lFreeEntry );
+                }
+                else
+                {
+                    /* Without LFN entries, FF_FindEntryInDir() will compare
+                     * with the formatted short name. */
+                    memcpy( pcIndexName, pucEntryBuffer, 11 );
+                    FF_ProcessShortName( ( char * ) pcIndexName );
+                    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+                    {
+                        FF_ShortNameExpand( pcIndexName );
+                    }
+                    #endif
+                    FF_LFNIndexAdd( pxIOManager, ulDirCluster, pcIndexName, ( uint16_t ) lFreeEntry );
+                }
+            }
+            #endif /* ffconfigLFN_INDEX */
         }
     }
     while( pdFALSE );
 
-    FF_UnlockDirectory( pxIOManager );
+    FF_UnlockDirectoryCluster( pxIOManager, ulDirCluster );
 
     if( FF_isERR( xReturn ) == pdFALSE )
     {
@@ -3407,6 +3832,11 @@ FF_Error_t FF_RmLFNs( FF_IOManager_t * pxIOManager,
     FF_Error_t xError = FF_ERR_NONE;
     uint8_t pucEntryBuffer[ FF_SIZEOF_DIRECTORY_ENTRY ];
 
+    #if ( ffconfigLFN_INDEX != 0 )
+        uint16_t usFirstEntry = usDirEntry;
+        uint16_t usLastEntry = usDirEntry;
+    #endif
+
     if( usDirEntry != 0 )
     {
         usDirEntry--;
@@ -3429,6 +3859,12 @@ FF_Error_t FF_RmLFNs( FF_IOManager_t * pxIOManager,
                 {
                     break;
                 }
+
+                #if ( ffconfigLFN_INDEX != 0 )
+                {
+                    usFirstEntry = usDirEntry;
+                }
+                #endif
             }
 
             if( usDirEntry == 0 )
@@ -3440,10 +3876,523 @@ FF_Error_t FF_RmLFNs( FF_IOManager_t * pxIOManager,
         } while( FF_getChar( pucEntryBuffer, ( uint16_t ) ( FF_FAT_DIRENT_ATTRIB ) ) == FF_FAT_ATTR_LFN );
     }
 
+    #if ( ffconfigLFN_INDEX != 0 )
+    {
+        /* The short entry has been deleted by the caller, so the name is gone
+         * even if not all of its LFN entries could be removed. */
+        FF_LFNIndexRemove( pxIOManager, pxContext->ulDirCluster, usFirstEntry, usLastEntry );
+    }
+    #endif
+
     return xError;
 } /* FF_RmLFNs() */
 /*-----------------------------------------------------------*/
 
+#if ( ffconfigLFN_INDEX != 0 )
+
+/* The number of names that an index will hold at first. */
+    #define ffLFN_INDEX_FIRST_SPACE    32U
+
+/* The maximum number of names with the same hash that will be compared in
+ * one look-up.  When there are more, the directory will be scanned. */
+    #define ffLFN_INDEX_MAX_MATCHES    4
+
+    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+        static uint16_t prvLFNIndexHash( const FF_T_WCHAR * pcName )
+    #else
+        static uint16_t prvLFNIndexHash( const char * pcName )
+    #endif
+    {
+        /* FNV-1a, folded to 16 bits.  Names that wcsicmp() or FF_stricmp()
+         * consider equal must get the same hash. */
+        uint32_t ulHash = 0x811C9DC5UL;
+        uint32_t ulChar;
+
+        for( ; *pcName != 0; pcName++ )
+        {
+            #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+            {
+                ulChar = ( uint32_t ) towlower( ( wint_t ) *pcName );
+            }
+            #else
+            {
+                ulChar = ( uint32_t ) ( uint8_t ) *pcName;
+
+                if( ( ulChar >= ( uint32_t ) 'A' ) && ( ulChar <= ( uint32_t ) 'Z' ) )
+                {
+                    ulChar += 32U;
+                }
+                else if( ulChar >= 0x80U )
+                {
+                    /* Whether these are folded depends on the locale. */
+                    ulChar = 0x80U;
+                }
+            }
+            #endif /* ffconfigUNICODE_UTF16_SUPPORT */
+            ulHash = ( ulHash ^ ulChar ) * 0x01000193UL;
+        }
+
+        return ( uint16_t ) ( ulHash ^ ( ulHash >> 16 ) );
+    } /* prvLFNIndexHash() */
+/*-----------------------------------------------------------*/
+
+    static BaseType_t prvLFNIndexAppend( FF_LFNIndex_t * pxIndex,
+                                         uint16_t usHash,
+                                         uint16_t usEntry )
+    {
+        FF_LFNIndexEntry_t * pxEntries = NULL;
+        uint32_t ulSpace;
+        BaseType_t xResult = pdTRUE;
+
+        if( pxIndex->usCount == pxIndex->usSpace )
+        {
+            ulSpace = 2U * ( uint32_t ) pxIndex->usSpace;
+
+            if( ulSpace > ( uint32_t ) ffconfigLFN_INDEX_MAX_ENTRIES )
+            {
+                ulSpace = ( uint32_t ) ffconfigLFN_INDEX_MAX_ENTRIES;
+            }
+
+            if( ulSpace > ( uint32_t ) pxIndex->usSpace )
+            {
+                pxEntries = ( FF_LFNIndexEntry_t * ) ffconfigMALLOC( sizeof( FF_LFNIndexEntry_t ) * ulSpace );
+            }
+
+            if( pxEntries != NULL )
+            {
+                memcpy( pxEntries, pxIndex->pxEntries, sizeof( FF_LFNIndexEntry_t ) * pxIndex->usCount );
+                ffconfigFREE( pxIndex->pxEntries );
+                pxIndex->pxEntries = pxEntries;
+                pxIndex->usSpace = ( uint16_t ) ulSpace;
+            }
+            else
+            {
+                /* Too many names, or out of memory: from now on this
+                 * directory will be scanned. */
+                if( pxIndex->pxEntries != NULL )
+                {
+                    ffconfigFREE( pxIndex->pxEntries );
+                    pxIndex->pxEntries = NULL;
+                }
+
+                pxIndex->usCount = 0U;
+                pxIndex->usSpace = 0U;
+                xResult = pdFALSE;
+            }
+        }
+
+        if( xResult != pdFALSE )
+        {
+            pxIndex->pxEntries[ pxIndex->usCount ].usHash = usHash;
+            pxIndex->pxEntries[ pxIndex->usCount ].usEntry = usEntry;
+            pxIndex->usCount++;
+        }
+
+        return xResult;
+    } /* prvLFNIndexAppend() */
+/*-----------------------------------------------------------*/
+
+/* Returns the index of a directory, or NULL.  The caller must hold
+ * 'pvSemaphore'. */
+    static FF_LFNIndex_t * prvLFNIndexGet( FF_IOManager_t * pxIOManager,
+                                           uint32_t ulDirCluster )
+    {
+        FF_LFNIndex_t * pxIndex = pxIOManager->xLFNIndex;
+        FF_LFNIndex_t * pxLast = pxIOManager->xLFNIndex + ffconfigLFN_INDEX_DEPTH;
+
+        for( ; pxIndex < pxLast; pxIndex++ )
+        {
+            if( pxIndex->ulDirCluster == ulDirCluster )
+            {
+                return pxIndex;
+            }
+        }
+
+        return NULL;
+    } /* prvLFNIndexGet() */
+/*-----------------------------------------------------------*/
+
+    static void prvLFNIndexRelease( FF_LFNIndex_t * pxIndex )
+    {
+        if( pxIndex->pxEntries != NULL )
+        {
+            ffconfigFREE( pxIndex->pxEntries );
+        }
+
+        memset( pxIndex, '\0', sizeof( *pxIndex ) );
+    } /* prvLFNIndexRelease() */
+/*-----------------------------------------------------------*/
+
+/* Scan a directory and install an index of its names.  Returns pdTRUE when
+ * an index was installed. */
+    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+        static BaseType_t prvLFNIndexBuild( FF_IOManager_t * pxIOManager,
+                                            uint32_t ulDirCluster,
+                                            const FF_T_WCHAR * pcName,
+                                            FF_DirEnt_t * pxDirEntry )
+    #else
+        static BaseType_t prvLFNIndexBuild( FF_IOManager_t * pxIOManager,
+                                            uint32_t ulDirCluster,
+                                            const char * pcName,
+                                            FF_DirEnt_t * pxDirEntry )
+    #endif
+    {
+        FF_LFNIndex_t xIndex;
+        FF_LFNIndex_t * pxSlot;
+        FF_FindParams_t xFindParams;
+        FF_Error_t xError;
+        uint32_t ulChanges;
+        BaseType_t xSlot;
+        BaseType_t xInstalled = pdFALSE;
+
+        memset( &xIndex, '\0', sizeof( xIndex ) );
+        xIndex.ulDirCluster = ulDirCluster;
+        xIndex.usSpace = ( ffLFN_INDEX_FIRST_SPACE < ffconfigLFN_INDEX_MAX_ENTRIES ) ? ffLFN_INDEX_FIRST_SPACE : ffconfigLFN_INDEX_MAX_ENTRIES;
+        xIndex.pxEntries = ( FF_LFNIndexEntry_t * ) ffconfigMALLOC( sizeof( FF_LFNIndexEntry_t ) * xIndex.usSpace );
+
+        if( xIndex.pxEntries != NULL )
+        {
+            FF_PendSemaphore( pxIOManager->pvSemaphore );
+            {
+                ulChanges = pxIOManager->ulLFNIndexChanges;
+            }
+            FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+
+            /* Let FF_FindEntryInDir() walk through the entire directory. */
+            memset( &xFindParams, '\0', sizeof( xFindParams ) );
+            xFindParams.ulDirCluster = ulDirCluster;
+            xFindParams.pxLFNIndex = &xIndex;
+            ( void ) FF_FindEntryInDir( pxIOManager, &xFindParams, pcName, 0x00, pxDirEntry, &xError );
+
+            if( ( FF_isERR( xError ) == pdFALSE ) || ( FF_GETERROR( xError ) == FF_ERR_DIR_END_OF_DIR ) )
+            {
+                FF_PendSemaphore( pxIOManager->pvSemaphore );
+
+                /* A name that was created or removed by another task during
+                 * the scan might be missing.  Also, another task might have
+                 * installed an index of the same directory. */
+                if( pxIOManager->ulLFNIndexChanges == ulChanges )
+                {
+                    /* Replace a free slot, or else the one that was used least recently. */
+                    pxSlot = pxIOManager->xLFNIndex;
+
+                    for( xSlot = 1; ( xSlot < ffconfigLFN_INDEX_DEPTH ) && ( pxSlot->ulDirCluster != 0U ); xSlot++ )
+                    {
+                        if( ( pxIOManager->xLFNIndex[ xSlot ].ulDirCluster == 0U ) ||
+                            ( pxIOManager->xLFNIndex[ xSlot ].ulLastUsed < pxSlot->ulLastUsed ) )
+                        {
+                            pxSlot = &( pxIOManager->xLFNIndex[ xSlot ] );
+                        }
+                    }
+
+                    prvLFNIndexRelease( pxSlot );
+                    /* When the scan ran out of space, 'pxEntries' is NULL:
+                     * the directory will be scanned from now on. */
+                    *pxSlot = xIndex;
+                    pxSlot->ulLastUsed = ++( pxIOManager->ulLFNIndexClock );
+                    pxIOManager->ulLFNIndexChanges++;
+                    xIndex.pxEntries = NULL;
+                    xInstalled = pdTRUE;
+                }
+
+                FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+            }
+
+            if( xIndex.pxEntries != NULL )
+            {
+                ffconfigFREE( xIndex.pxEntries );
+            }
+        }
+
+        return xInstalled;
+    } /* prvLFNIndexBuild() */
+/*-----------------------------------------------------------*/
+
+/* Read the name that starts at 'usEntry' and see if it is the one that
+ * FF_FindEntryInDir() is looking for. */
+    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+        static BaseType_t prvLFNIndexCheck( FF_IOManager_t * pxIOManager,
+                                            uint32_t ulDirCluster,
+                                            uint16_t usEntry,
+                                            const FF_T_WCHAR * pcName,
+                                            uint8_t ucAttrib,
+                                            FF_DirEnt_t * pxDirEntry,
+                                            FF_Error_t * pxError )
+    #else
+        static BaseType_t prvLFNIndexCheck( FF_IOManager_t * pxIOManager,
+                                            uint32_t ulDirCluster,
+                                            uint16_t usEntry,
+                                            const char * pcName,
+                                            uint8_t ucAttrib,
+                                            FF_DirEnt_t * pxDirEntry,
+                                            FF_Error_t * pxError )
+    #endif
+    {
+        uint8_t ucEntryBuffer[ FF_SIZEOF_DIRECTORY_ENTRY ];
+        FF_FetchContext_t xFetchContext;
+        FF_Error_t xError;
+        BaseType_t xFound = pdFALSE;
+
+        xError = FF_InitEntryFetch( pxIOManager, ulDirCluster, &xFetchContext );
+
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            xError = FF_FetchEntryWithContext( pxIOManager, usEntry, &xFetchContext, ucEntryBuffer );
+
+            if( ( FF_isERR( xError ) == pdFALSE ) &&
+                ( FF_isDeleted( ucEntryBuffer ) == pdFALSE ) &&
+                ( FF_isEndOfDir( ucEntryBuffer ) == pdFALSE ) )
+            {
+                pxDirEntry->ucAttrib = FF_getChar( ucEntryBuffer, ( uint16_t ) ( FF_FAT_DIRENT_ATTRIB ) );
+
+                if( ( pxDirEntry->ucAttrib & FF_FAT_ATTR_LFN ) == FF_FAT_ATTR_LFN )
+                {
+                    xError = FF_PopulateLongDirent( pxIOManager, pxDirEntry, usEntry, &xFetchContext );
+                    xFound = pdTRUE;
+                }
+                else if( ( pxDirEntry->ucAttrib & FF_FAT_ATTR_VOLID ) != FF_FAT_ATTR_VOLID )
+                {
+                    FF_PopulateShortDirent( pxIOManager, pxDirEntry, ucEntryBuffer );
+                    pxDirEntry->usCurrentItem = ( uint16_t ) ( usEntry + 1U );
+                    xFound = pdTRUE;
+                }
+
+                /* Only the hash was compared so far.  Also, the entry might have
+                 * been replaced by another task since the index was consulted. */
+                if( ( xFound != pdFALSE ) &&
+                    ( FF_isERR( xError ) == pdFALSE ) &&
+                    ( ( pxDirEntry->ucAttrib & ucAttrib ) == ucAttrib ) )
+                {
+                    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+                        xFound = ( wcsicmp( ( const char * ) pcName, ( const char * ) pxDirEntry->pcFileName ) == 0 ) ? pdTRUE : pdFALSE;
+                    #else
+                        xFound = ( FF_stricmp( ( const char * ) pcName, ( const char * ) pxDirEntry->pcFileName ) == 0 ) ? pdTRUE : pdFALSE;
+                    #endif
+                }
+                else
+                {
+                    xFound = pdFALSE;
+                }
+            }
+
+            {
+                FF_Error_t xTempError;
+                xTempError = FF_CleanupEntryFetch( pxIOManager, &xFetchContext );
+
+                if( FF_isERR( xError ) == pdFALSE )
+                {
+                    xError = xTempError;
+                }
+            }
+        }
+
+        *pxError = xError;
+
+        return xFound;
+    } /* prvLFNIndexCheck() */
+/*-----------------------------------------------------------*/
+
+    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+        static BaseType_t prvLFNIndexFind( FF_IOManager_t * pxIOManager,
+                                           FF_FindParams_t * pxFindParams,
+                                           const FF_T_WCHAR * pcName,
+                                           uint8_t ucAttrib,
+                                           FF_DirEnt_t * pxDirEntry,
+                                           uint32_t * pulResult,
+                                           FF_Error_t * pxError )
+    #else
+        static BaseType_t prvLFNIndexFind( FF_IOManager_t * pxIOManager,
+                                           FF_FindParams_t * pxFindParams,
+                                           const char * pcName,
+                                           uint8_t ucAttrib,
+                                           FF_DirEnt_t * pxDirEntry,
+                                           uint32_t * pulResult,
+                                           FF_Error_t * pxError )
+    #endif
+    {
+        FF_LFNIndex_t * pxIndex = NULL;
+        uint16_t usMatches[ ffLFN_INDEX_MAX_MATCHES ];
+        uint16_t usHash = prvLFNIndexHash( pcName );
+        BaseType_t xMatchCount = -1; /* Stays -1 when the directory must be scanned. */
+        BaseType_t xAttempt;
+        BaseType_t xIndex;
+
+        /* Cluster 0 marks a free index slot. */
+        for( xAttempt = 0; ( xAttempt < 2 ) && ( pxFindParams->ulDirCluster != 0U ); xAttempt++ )
+        {
+            FF_PendSemaphore( pxIOManager->pvSemaphore );
+            {
+                pxIndex = prvLFNIndexGet( pxIOManager, pxFindParams->ulDirCluster );
+
+                if( pxIndex != NULL )
+                {
+                    pxIndex->ulLastUsed = ++( pxIOManager->ulLFNIndexClock );
+
+                    if( pxIndex->pxEntries != NULL )
+                    {
+                        xMatchCount = 0;
+
+                        for( xIndex = 0; xIndex < ( BaseType_t ) pxIndex->usCount; xIndex++ )
+                        {
+                            if( pxIndex->pxEntries[ xIndex ].usHash == usHash )
+                            {
+                                if( xMatchCount == ffLFN_INDEX_MAX_MATCHES )
+                                {
+                                    xMatchCount = -1;
+                                    break;
+                                }
+
+                                usMatches[ xMatchCount++ ] = pxIndex->pxEntries[ xIndex ].usEntry;
+                            }
+                        }
+                    }
+                }
+            }
+            FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+
+            if( ( pxIndex != NULL ) ||
+                ( prvLFNIndexBuild( pxIOManager, pxFindParams->ulDirCluster, pcName, pxDirEntry ) == pdFALSE ) )
+            {
+                break;
+            }
+        }
+
+        if( xMatchCount >= 0 )
+        {
+            *pulResult = 0U;
+            *pxError = FF_ERR_NONE;
+
+            for( xIndex = 0; xIndex < xMatchCount; xIndex++ )
+            {
+                if( prvLFNIndexCheck( pxIOManager, pxFindParams->ulDirCluster, usMatches[ xIndex ], pcName, ucAttrib, pxDirEntry, pxError ) != pdFALSE )
+                {
+                    /* Object found, the cluster number will be returned. */
+                    *pulResult = pxDirEntry->ulObjectCluster;
+                    break;
+                }
+
+                if( FF_isERR( *pxError ) != pdFALSE )
+                {
+                    break;
+                }
+            }
+
+            if( xIndex == xMatchCount )
+            {
+                /* Not found: make sure that the caller won't mistake the last
+                 * name read for the one it was looking for. */
+                pxDirEntry->pcFileName[ 0 ] = 0;
+            }
+        }
+
+        return ( xMatchCount >= 0 ) ? pdTRUE : pdFALSE;
+    } /* prvLFNIndexFind() */
+/*-----------------------------------------------------------*/
+
+    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+        void FF_LFNIndexAdd( FF_IOManager_t * pxIOManager,
+                             uint32_t ulDirCluster,
+                             const FF_T_WCHAR * pcName,
+                             uint16_t usEntry )
+    #else
+        void FF_LFNIndexAdd( FF_IOManager_t * pxIOManager,
+                             uint32_t ulDirCluster,
+                             const char * pcName,
+                             uint16_t usEntry )
+    #endif
+    {
+        FF_LFNIndex_t * pxIndex;
+
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
+        {
+            pxIndex = prvLFNIndexGet( pxIOManager, ulDirCluster );
+
+            if( ( pxIndex != NULL ) && ( pxIndex->pxEntries != NULL ) )
+            {
+                ( void ) prvLFNIndexAppend( pxIndex, prvLFNIndexHash( pcName ), usEntry );
+            }
+
+            pxIOManager->ulLFNIndexChanges++;
+        }
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+    } /* FF_LFNIndexAdd() */
+/*-----------------------------------------------------------*/
+
+/* FF_LFNIndexRemove() : forget the name that occupies the directory entries
+ * 'usFirstEntry' up to and including 'usLastEntry'. */
+    void FF_LFNIndexRemove( FF_IOManager_t * pxIOManager,
+                            uint32_t ulDirCluster,
+                            uint16_t usFirstEntry,
+                            uint16_t usLastEntry )
+    {
+        FF_LFNIndex_t * pxIndex;
+        uint16_t usIndex = 0U;
+
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
+        {
+            pxIndex = prvLFNIndexGet( pxIOManager, ulDirCluster );
+
+            if( ( pxIndex != NULL ) && ( pxIndex->pxEntries != NULL ) )
+            {
+                while( usIndex < pxIndex->usCount )
+                {
+                    if( ( pxIndex->pxEntries[ usIndex ].usEntry >= usFirstEntry ) &&
+                        ( pxIndex->pxEntries[ usIndex ].usEntry <= usLastEntry ) )
+                    {
+                        /* The order of the names is not important. */
+                        pxIndex->usCount--;
+                        pxIndex->pxEntries[ usIndex ] = pxIndex->pxEntries[ pxIndex->usCount ];
+                    }
+                    else
+                    {
+                        usIndex++;
+                    }
+                }
+            }
+
+            pxIOManager->ulLFNIndexChanges++;
+        }
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+    } /* FF_LFNIndexRemove() */
+/*-----------------------------------------------------------*/
+
+/* FF_LFNIndexInvalidate() : drop the index of a directory that is removed. */
+    void FF_LFNIndexInvalidate( FF_IOManager_t * pxIOManager,
+                                uint32_t ulDirCluster )
+    {
+        FF_LFNIndex_t * pxIndex;
+
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
+        {
+            pxIndex = prvLFNIndexGet( pxIOManager, ulDirCluster );
+
+            if( pxIndex != NULL )
+            {
+                prvLFNIndexRelease( pxIndex );
+            }
+
+            pxIOManager->ulLFNIndexChanges++;
+        }
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+    } /* FF_LFNIndexInvalidate() */
+/*-----------------------------------------------------------*/
+
+/* FF_LFNIndexFlush() : drop all indexes when a volume is (un)mounted, or
+ * when the I/O manager is deleted.  The volume may not be in use. */
+    void FF_LFNIndexFlush( FF_IOManager_t * pxIOManager )
+    {
+        BaseType_t xIndex;
+
+        for( xIndex = 0; xIndex < ffconfigLFN_INDEX_DEPTH; xIndex++ )
+        {
+            prvLFNIndexRelease( &( pxIOManager->xLFNIndex[ xIndex ] ) );
+        }
+
+        pxIOManager->ulLFNIndexChanges++;
+    } /* FF_LFNIndexFlush() */
+/*-----------------------------------------------------------*/
+#endif /* ffconfigLFN_INDEX */
+
 #if ( ffconfigHASH_CACHE != 0 )
     FF_Error_t FF_HashDir( FF_IOManager_t * pxIOManager,
                            uint32_t ulDirCluster )
@@ -3457,23 +4406,39 @@ FF_Error_t FF_RmLFNs( FF_IOManager_t * pxIOManager,
         uint32_t ulHash;
         FF_Error_t xError;
 
-        for( xIndex = 0; xIndex < ffconfigHASH_CACHE_DEPTH; xIndex++ )
+        /* Tasks that change different directories may hash them at the same
+         * time, see ffconfigDIRECTORY_LOCKS.  A table is claimed while the
+         * semaphore is held, and it can not be replaced until it is filled. */
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
         {
-            if( pxIOManager->xHashCache[ xIndex ].ulNumHandles == 0 )
+            for( xIndex = 0; xIndex < ffconfigHASH_CACHE_DEPTH; xIndex++ )
             {
-                if( pxHashCache == NULL )
+                if( pxIOManager->xHashCache[ xIndex ].ulNumHandles == 0 )
                 {
-                    pxHashCache = &pxIOManager->xHashCache[ xIndex ];
-                }
-                else
-                {
-                    if( ( pxIOManager->xHashCache[ xIndex ].ulMisses > pxHashCache->ulMisses ) )
+                    if( pxHashCache == NULL )
                     {
                         pxHashCache = &pxIOManager->xHashCache[ xIndex ];
                     }
+                    else
+                    {
+                        if( ( pxIOManager->xHashCache[ xIndex ].ulMisses > pxHashCache->ulMisses ) )
+                        {
+                            pxHashCache = &pxIOManager->xHashCache[ xIndex ];
+                        }
+                    }
                 }
             }
+
+            if( pxHashCache != NULL )
+            {
+                /* Clear the hash table! */
+                memset( pxHashCache, '\0', sizeof( *pxHashCache ) );
+                pxHashCache->ulDirCluster = ulDirCluster;
+                pxHashCache->ulMisses = 0;
+                pxHashCache->ulNumHandles = 1;
+            }
         }
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
 
         if( pxHashCache != NULL )
         {
@@ -3482,10 +4447,6 @@ FF_Error_t FF_RmLFNs( FF_IOManager_t * pxIOManager,
             #else
                 char pcMyShortName[ 13 ];
             #endif
-            /* Clear the hash table! */
-            memset( pxHashCache, '\0', sizeof( *pxHashCache ) );
-            pxHashCache->ulDirCluster = ulDirCluster;
-            pxHashCache->ulMisses = 0;
 
             /* Hash the directory! */
 
@@ -3553,6 +4514,12 @@ FF_Error_t FF_RmLFNs( FF_IOManager_t * pxIOManager,
                     }
                 }
             }
+
+            FF_PendSemaphore( pxIOManager->pvSemaphore );
+            {
+                pxHashCache->ulNumHandles = 0;
+            }
+            FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
         } /* if( pxHashCache != NULL ) */
         else
         {
@@ -3575,14 +4542,18 @@ FF_Error_t FF_RmLFNs( FF_IOManager_t * pxIOManager,
         FF_HashTable_t * pxHash = pxIOManager->xHashCache;
         FF_HashTable_t * pxLast = pxIOManager->xHashCache + ffconfigHASH_CACHE_DEPTH;
 
-        for( ; pxHash < pxLast; pxHash++ )
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
         {
-            if( pxHash->ulDirCluster == ulDirCluster )
+            for( ; pxHash < pxLast; pxHash++ )
             {
-                pxHash->ulDirCluster = 0;
-                break;
+                if( pxHash->ulDirCluster == ulDirCluster )
+                {
+                    pxHash->ulDirCluster = 0;
+                    break;
+                }
             }
         }
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
     } /* FF_UnHashDir() */
 #endif /* ffconfigHASH_CACHE */
 /*-----------------------------------------------------------*/
@@ -3651,14 +4622,19 @@ FF_Error_t FF_RmLFNs( FF_IOManager_t * pxIOManager,
         FF_HashTable_t * pxHash = pxIOManager->xHashCache;
         FF_HashTable_t * pxLast = pxIOManager->xHashCache + ffconfigHASH_CACHE_DEPTH;
 
-        for( ; pxHash < pxLast; pxHash++ )
+        /* The table might be claimed by FF_HashDir() for another directory. */
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
         {
-            if( pxHash->ulDirCluster == ulDirCluster )
+            for( ; pxHash < pxLast; pxHash++ )
             {
-                FF_SetHash( pxHash, ulHash );
-                break;
+                if( pxHash->ulDirCluster == ulDirCluster )
+                {
+                    FF_SetHash( pxHash, ulHash );
+                    break;
+                }
             }
         }
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
     } /* FF_AddDirentHash() */
 #endif /* ffconfigHASH_CACHE*/
 /*-----------------------------------------------------------*/
@@ -3672,22 +4648,26 @@ FF_Error_t FF_RmLFNs( FF_IOManager_t * pxIOManager,
         FF_HashTable_t * pxLast = pxIOManager->xHashCache + ffconfigHASH_CACHE_DEPTH;
         BaseType_t xResult;
 
-        for( ; ; )
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
         {
-            if( pxHash->ulDirCluster == ulDirCluster )
+            for( ; ; )
             {
-                xResult = FF_isHashSet( pxHash, ulHash );
-                break;
-            }
+                if( pxHash->ulDirCluster == ulDirCluster )
+                {
+                    xResult = FF_isHashSet( pxHash, ulHash );
+                    break;
+                }
 
-            pxHash++;
+                pxHash++;
 
-            if( pxHash >= pxLast )
-            {
-                xResult = -1;
-                break;
+                if( pxHash >= pxLast )
+                {
+                    xResult = -1;
+                    break;
+                }
             }
         }
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
 
         return xResult;
     } /* FF_CheckDirentHash() */
@@ -107,6 +107,7 @@
             { "FF_MkDir",                 FF_GETMOD_FUNC( FF_MKDIR )                 },
             { "FF_Traverse",              FF_GETMOD_FUNC( FF_TRAVERSE )              },
             { "FF_FindDir",               FF_GETMOD_FUNC( FF_FINDDIR )               },
+            { "FF_FindNextBatch",         FF_GETMOD_FUNC( FF_FINDNEXTBATCH )         },
 
 /*----- FF_FILE - The FreeRTOS+FAT file handling routines */
             { "FF_GetModeBits",           FF_GETMOD_FUNC( FF_GETMODEBITS )           },
@@ -134,6 +135,7 @@
             { "FF_BytesLeft",             FF_GETMOD_FUNC( FF_BYTESLEFT )             },
             { "FF_SetFileTime",           FF_GETMOD_FUNC( FF_SETFILETIME )           },
             { "FF_InitBuf",               FF_GETMOD_FUNC( FF_INITBUF )               },
+            { "FF_Preallocate",           FF_GETMOD_FUNC( FF_PREALLOCATE )           },
 
 /*----- FF_FAT - The FreeRTOS+FAT FAT handling routines */
             { "FF_getFATEntry",           FF_GETMOD_FUNC( FF_GETFATENTRY )           },
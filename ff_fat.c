@@ -101,6 +101,84 @@ FF_Buffer_t * prvGetFromFATBuffers( FF_IOManager_t * pxIOManager,
                                                 FF_Error_t * pxError );
 #endif /* ffconfigFAT12_SUPPORT */
 
+/* FAT16 and FAT32 entries are decoded in groups of 32, one bit per entry in a
+ * 32-bit mask, or one word of the free cluster bitmap. */
+#define ffFAT_DECODE_ENTRIES    32u
+
+/* Decode up to ffFAT_DECODE_ENTRIES FAT16 or FAT32 entries into native values.
+ * The reserved top 4 bits of FAT32 entries are cleared.
+ */
+static void prvDecodeEntries( const uint8_t * pucEntries,
+                              uint32_t * pulValues,
+                              uint32_t ulCount,
+                              BaseType_t xIsFAT32 );
+
+#if ( ffconfigFREE_CLUSTER_BITMAP != 0 ) && !defined( ffFAT_LOWEST_BIT )
+
+/* The number of the lowest bit set in 'ulWord', which must not be zero. */
+    #if defined( __GNUC__ )
+        #define ffFAT_LOWEST_BIT( ulWord )    ( ( uint32_t ) __builtin_ctz( ( unsigned int ) ( ulWord ) ) )
+    #else
+        /* Multiplying the lowest bit with a de Bruijn sequence puts a unique
+         * pattern in the top 5 bits. */
+        static const uint8_t ucLowestBit[ 32 ] =
+        {
+            0,  1,  28, 2,  29, 14, 24, 3,  30, 22, 20, 15, 25, 17, 4,  8,
+            31, 27, 13, 23, 21, 19, 16, 7,  26, 12, 18, 6,  11, 5,  10, 9
+        };
+        #define ffFAT_LOWEST_BIT( ulWord ) \
+    ( ( uint32_t ) ucLowestBit[ ( uint32_t ) ( ( ( ulWord ) & ( 0ul - ( ulWord ) ) ) * 0x077CB531ul ) >> 27 ] )
+    #endif
+#endif /* ffconfigFREE_CLUSTER_BITMAP */
+
+#if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+
+/* Returns a mask with bit 'x' set when the decoded entry 'x' is free. */
+    static uint32_t prvFreeMask( const uint32_t * pulValues,
+                                 uint32_t ulCount );
+#endif
+
+#if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+
+/* Read the entire FAT once and set a bit for every free cluster.
+ * Returns pdFALSE when the bitmap can not be used, the FAT must be searched instead.
+ */
+    static BaseType_t prvBuildFreeBitmap( FF_IOManager_t * pxIOManager,
+                                          FF_Error_t * pxError );
+
+/* Find the first bit set in 'pulBitmap', which covers the clusters below 'ulLimit',
+ * starting at 'ulStart' and wrapping around to cluster 2.
+ * Returns 0 when there are no free clusters.
+ */
+    static uint32_t prvFindFreeInBitmap( const uint32_t * pulBitmap,
+                                         uint32_t ulLimit,
+                                         uint32_t ulStart );
+#endif /* ffconfigFREE_CLUSTER_BITMAP */
+
+#if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+
+/* Let the background scan know that the clusters 'ulFirst' up to and including
+ * 'ulLast' have been written to the FAT.
+ */
+    static void prvFreeScanUpdate( FF_IOManager_t * pxIOManager,
+                                   uint32_t ulFirst,
+                                   uint32_t ulLast,
+                                   BaseType_t xWasFree,
+                                   BaseType_t xIsFree,
+                                   FF_Error_t xError );
+
+/* The task that counts the free clusters after FF_StartFreeScan(). */
+    static void prvFreeScanTask( void * pvParameters );
+
+/* While the scan is running, look for a free cluster in the part of the FAT
+ * that has been scanned, starting at '*pulCluster'.  When there is none,
+ * '*pulCluster' is set to the first cluster that has not been scanned yet,
+ * and pdFALSE is returned: the FAT must be searched from there.
+ */
+    static BaseType_t prvFindFreeInScan( FF_IOManager_t * pxIOManager,
+                                         uint32_t * pulCluster );
+#endif /* ffconfigBACKGROUND_FREE_SCAN */
+
 
 
 /* Have a cluster number and translate it to an LBA (Logical Block Address).
@@ -438,7 +516,7 @@ uint32_t FF_getFATEntry( FF_IOManager_t * pxIOManager,
 /* preferred mode, user might want to update this entry. */
     uint8_t ucMode = pxFATBuffers ? pxFATBuffers->ucMode : FF_MODE_READ;
 
-    FF_Assert_Lock( pxIOManager, FF_FAT_LOCK );
+    FF_Assert_Lock( pxIOManager, FF_FAT_SHARED_LOCK );
 
     if( ulCluster >= pxIOManager->xPartition.ulNumClusters )
     {
@@ -649,7 +727,7 @@ uint32_t FF_TraverseFAT( FF_IOManager_t * pxIOManager,
     uint32_t ulFatEntry = ulStart;
     uint32_t ulCurrentCluster = ulStart;
     FF_FATBuffers_t xFATBuffers;
-    BaseType_t xTakeLock = FF_Has_Lock( pxIOManager, FF_FAT_LOCK ) == pdFALSE;
+    BaseType_t xTakeLock = FF_Has_Lock( pxIOManager, FF_FAT_SHARED_LOCK ) == pdFALSE;
 
     /* xFATBuffers is nothing more than an array of FF_Buffer_t's.
      * One buffer for each FAT copy on disk. */
@@ -657,7 +735,7 @@ uint32_t FF_TraverseFAT( FF_IOManager_t * pxIOManager,
 
     if( xTakeLock )
     {
-        FF_LockFAT( pxIOManager );
+        FF_LockFATShared( pxIOManager );
     }
 
     for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
@@ -681,7 +759,7 @@ uint32_t FF_TraverseFAT( FF_IOManager_t * pxIOManager,
 
     if( xTakeLock )
     {
-        FF_UnlockFAT( pxIOManager );
+        FF_UnlockFATShared( pxIOManager );
     }
 
     {
@@ -888,6 +966,10 @@ FF_Error_t FF_putFATEntry( FF_IOManager_t * pxIOManager,
         const BaseType_t xNumFATs = 1;
     #endif
 
+    #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+        BaseType_t xWasFree = pdFALSE;
+    #endif
+
 
     FF_Assert_Lock( pxIOManager, FF_FAT_LOCK );
 
@@ -950,6 +1032,21 @@ FF_Error_t FF_putFATEntry( FF_IOManager_t * pxIOManager,
                 break;
             }
 
+            #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+                if( xIndex == 0 )
+                {
+                    /* The background scan wants to know the old value. */
+                    if( pxIOManager->xPartition.ucType == FF_T_FAT32 )
+                    {
+                        xWasFree = ( FF_getLong( pxBuffer->pucBuffer, ulRelClusterEntry ) & 0x0fffffff ) == 0ul;
+                    }
+                    else
+                    {
+                        xWasFree = FF_getShort( pxBuffer->pucBuffer, ulRelClusterEntry ) == 0u;
+                    }
+                }
+            #endif
+
             if( pxIOManager->xPartition.ucType == FF_T_FAT32 )
             {
                 /* Clear the top 4 bits. */
@@ -997,6 +1094,36 @@ FF_Error_t FF_putFATEntry( FF_IOManager_t * pxIOManager,
         }
     }
 
+    #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+    {
+        uint32_t * pulFreeBitmap = pxIOManager->xPartition.pulFreeBitmap;
+
+        if( ( pulFreeBitmap != NULL ) && ( ulCluster != 0ul ) && ( ulCluster < pxIOManager->xPartition.ulNumClusters ) )
+        {
+            if( FF_isERR( xError ) )
+            {
+                /* The state of the FAT entry is not known any more. */
+                FF_ReleaseFreeBitmap( pxIOManager );
+            }
+            else if( ulValue == 0ul )
+            {
+                pulFreeBitmap[ ulCluster / 32 ] |= ( 1ul << ( ulCluster % 32 ) );
+            }
+            else
+            {
+                pulFreeBitmap[ ulCluster / 32 ] &= ~( 1ul << ( ulCluster % 32 ) );
+            }
+        }
+    }
+    #endif /* ffconfigFREE_CLUSTER_BITMAP */
+
+    #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+        if( ( ulCluster != 0ul ) && ( ulCluster < pxIOManager->xPartition.ulNumClusters ) )
+        {
+            prvFreeScanUpdate( pxIOManager, ulCluster, ulCluster, xWasFree, ( ulValue == 0ul ), xError );
+        }
+    #endif
+
     /* FF_putFATEntry() returns just an error code, not an address. */
     return xError;
 } /* FF_putFATEntry() */
@@ -1065,6 +1192,190 @@ FF_Error_t FF_putFATEntry( FF_IOManager_t * pxIOManager,
 #endif /* if ( ffconfigFAT12_SUPPORT != 0 ) */
 /*-----------------------------------------------------------*/
 
+#if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+    void FF_ReleaseFreeBitmap( FF_IOManager_t * pxIOManager )
+    {
+        if( pxIOManager->xPartition.pulFreeBitmap != NULL )
+        {
+            ffconfigFREE( pxIOManager->xPartition.pulFreeBitmap );
+            pxIOManager->xPartition.pulFreeBitmap = NULL;
+        }
+
+        pxIOManager->xPartition.ucFreeBitmapNoMem = pdFALSE;
+    }
+#endif /* ffconfigFREE_CLUSTER_BITMAP */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+    static BaseType_t prvBuildFreeBitmap( FF_IOManager_t * pxIOManager,
+                                          FF_Error_t * pxError )
+    {
+        FF_Error_t xError = FF_ERR_NONE;
+        FF_Buffer_t * pxBuffer;
+        uint32_t * pulFreeBitmap;
+        uint32_t ulIndex, x;
+        uint32_t ulEntries;
+        uint32_t ulMask;
+        uint32_t ulEntriesPerSector;
+        uint32_t ulValues[ ffFAT_DECODE_ENTRIES ];
+        uint32_t ulCluster = 0ul;
+        const uint32_t ulNumClusters = pxIOManager->xPartition.ulNumClusters;
+        const BaseType_t xIsFAT32 = ( pxIOManager->xPartition.ucType == FF_T_FAT32 );
+        const size_t uxBitmapSize = ( size_t ) ( ( ulNumClusters + 31ul ) / 32ul ) * sizeof( uint32_t );
+        BaseType_t xResult = pdFALSE;
+
+        if( pxIOManager->xPartition.pulFreeBitmap != NULL )
+        {
+            /* Built earlier and kept up-to-date by FF_putFATEntry(). */
+            xResult = pdTRUE;
+        }
+
+        #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+            else if( pxIOManager->xPartition.ucFreeScanBusy != pdFALSE )
+            {
+                /* The background scan is building the bitmap, see prvFindFreeInScan(). */
+            }
+        #endif
+        else if( ( pxIOManager->xPartition.ucFreeBitmapNoMem == pdFALSE ) && ( ulNumClusters != 0ul ) )
+        {
+            pulFreeBitmap = ( uint32_t * ) ffconfigMALLOC( uxBitmapSize );
+
+            if( pulFreeBitmap == NULL )
+            {
+                /* Fall back to searching the FAT, and don't try again. */
+                pxIOManager->xPartition.ucFreeBitmapNoMem = pdTRUE;
+            }
+            else
+            {
+                memset( pulFreeBitmap, '\0', uxBitmapSize );
+
+                if( xIsFAT32 != pdFALSE )
+                {
+                    ulEntriesPerSector = pxIOManager->usSectorSize / 4;
+                }
+                else
+                {
+                    ulEntriesPerSector = pxIOManager->usSectorSize / 2;
+                }
+
+                for( ulIndex = 0;
+                     ( ulIndex < pxIOManager->xPartition.ulSectorsPerFAT ) && ( ulCluster < ulNumClusters );
+                     ulIndex++ )
+                {
+                    pxBuffer = FF_GetBuffer( pxIOManager, pxIOManager->xPartition.ulFATBeginLBA + ulIndex, FF_MODE_READ );
+
+                    if( pxBuffer == NULL )
+                    {
+                        xError = FF_createERR( FF_ERR_DEVICE_DRIVER_FAILED, FF_FINDFREECLUSTER );
+                        break;
+                    }
+
+                    #if USE_SOFT_WDT
+                    {
+                        clearWDT();
+
+                        if( ( ( ulIndex + 1 ) % 32 ) == 0 )
+                        {
+                            FF_Sleep( 1 );
+                        }
+                    }
+                    #endif
+
+                    /* A sector holds a multiple of 32 entries, so every group
+                     * fills exactly one word of the bitmap. */
+                    for( x = 0; ( x < ulEntriesPerSector ) && ( ulCluster < ulNumClusters ); x += ulEntries, ulCluster += ulEntries )
+                    {
+                        ulEntries = ulNumClusters - ulCluster;
+
+                        if( ulEntries > ffFAT_DECODE_ENTRIES )
+                        {
+                            ulEntries = ffFAT_DECODE_ENTRIES;
+                        }
+
+                        prvDecodeEntries( pxBuffer->pucBuffer + ( x * ( xIsFAT32 ? 4 : 2 ) ), ulValues, ulEntries, xIsFAT32 );
+                        ulMask = prvFreeMask( ulValues, ulEntries );
+
+                        if( ulCluster == 0ul )
+                        {
+                            /* The first two entries are reserved and never free. */
+                            ulMask &= ~0x03ul;
+                        }
+
+                        pulFreeBitmap[ ulCluster / 32 ] = ulMask;
+                    }
+
+                    xError = FF_ReleaseBuffer( pxIOManager, pxBuffer );
+
+                    if( FF_isERR( xError ) )
+                    {
+                        break;
+                    }
+                }
+
+                if( FF_isERR( xError ) )
+                {
+                    ffconfigFREE( pulFreeBitmap );
+                }
+                else
+                {
+                    pxIOManager->xPartition.pulFreeBitmap = pulFreeBitmap;
+                    xResult = pdTRUE;
+                }
+            }
+        }
+
+        *pxError = xError;
+
+        return xResult;
+    }
+#endif /* ffconfigFREE_CLUSTER_BITMAP */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+    static uint32_t prvFindFreeInBitmap( const uint32_t * pulBitmap,
+                                         uint32_t ulLimit,
+                                         uint32_t ulStart )
+    {
+        const uint32_t ulWordCount = ( ulLimit + 31ul ) / 32ul;
+        uint32_t ulWordIndex;
+        uint32_t ulWord;
+        uint32_t ulCount;
+        uint32_t ulCluster = 0ul;
+
+        if( ulStart >= ulLimit )
+        {
+            ulStart = 0ul;
+        }
+
+        ulWordIndex = ulStart / 32;
+        /* Ignore the clusters below 'ulStart' in the first word. */
+        ulWord = pulBitmap[ ulWordIndex ] & ( uint32_t ) ( 0xFFFFFFFFul << ( ulStart % 32 ) );
+
+        /* Visit every word once, and the first word a second time for the
+         * clusters below 'ulStart'. */
+        for( ulCount = 0; ulCount <= ulWordCount; ulCount++ )
+        {
+            if( ulWord != 0ul )
+            {
+                ulCluster = ( ulWordIndex * 32 ) + ffFAT_LOWEST_BIT( ulWord );
+                break;
+            }
+
+            ulWordIndex++;
+
+            if( ulWordIndex == ulWordCount )
+            {
+                ulWordIndex = 0;
+            }
+
+            ulWord = pulBitmap[ ulWordIndex ];
+        }
+
+        return ulCluster;
+    }
+#endif /* ffconfigFREE_CLUSTER_BITMAP */
+/*-----------------------------------------------------------*/
+
 uint32_t FF_FindFreeCluster( FF_IOManager_t * pxIOManager,
                              FF_Error_t * pxError,
                              BaseType_t xDoClaim )
@@ -1124,6 +1435,31 @@ uint32_t FF_FindFreeCluster( FF_IOManager_t * pxIOManager,
         }
         #endif /* if ( ffconfigFSINFO_TRUSTED != 0 ) */
 
+        #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+            if( ( FF_isERR( xError ) == pdFALSE ) &&
+                ( prvBuildFreeBitmap( pxIOManager, &xError ) != pdFALSE ) )
+            {
+                /* The bitmap is up-to-date, no need to read the FAT. */
+                ulCluster = prvFindFreeInBitmap( pxIOManager->xPartition.pulFreeBitmap, uNumClusters, ulCluster );
+
+                if( ulCluster == 0ul )
+                {
+                    xError = FF_createERR( FF_ERR_IOMAN_NOT_ENOUGH_FREE_SPACE, FF_FINDFREECLUSTER );
+                }
+            }
+            else
+        #endif /* ffconfigFREE_CLUSTER_BITMAP */
+
+        #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+            if( ( FF_isERR( xError ) == pdFALSE ) &&
+                ( pxIOManager->xPartition.ucFreeScanBusy != pdFALSE ) &&
+                ( prvFindFreeInScan( pxIOManager, &ulCluster ) != pdFALSE ) )
+            {
+                /* Found in the part of the FAT that has been scanned already. */
+            }
+            else
+        #endif /* ffconfigBACKGROUND_FREE_SCAN */
+
         if( FF_isERR( xError ) == pdFALSE )
         {
             uint32_t ulFATSector;
@@ -1237,80 +1573,515 @@ uint32_t FF_FindFreeCluster( FF_IOManager_t * pxIOManager,
 } /* FF_FindFreeCluster */
 /*-----------------------------------------------------------*/
 
-/**
- * @brief	Creates a Cluster Chain
- *	@retval > 0 New created cluster
- *	@retval = 0 See pxError
- **/
-uint32_t FF_CreateClusterChain( FF_IOManager_t * pxIOManager,
-                                FF_Error_t * pxError )
+/* Test a single cluster, using the free-cluster bitmap when it is available. */
+static BaseType_t prvIsFreeCluster( FF_IOManager_t * pxIOManager,
+                                    uint32_t ulCluster,
+                                    FF_FATBuffers_t * pxFATBuffers,
+                                    FF_Error_t * pxError )
 {
-    uint32_t ulStartCluster;
-    FF_Error_t xError = FF_ERR_NONE;
-
-    FF_LockFAT( pxIOManager );
-    {
-        ulStartCluster = FF_FindFreeCluster( pxIOManager, &xError, pdTRUE );
-    }
-    FF_UnlockFAT( pxIOManager );
+    BaseType_t xResult;
 
-    if( ulStartCluster != 0L )
+    #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+        if( pxIOManager->xPartition.pulFreeBitmap != NULL )
+        {
+            xResult = ( ( pxIOManager->xPartition.pulFreeBitmap[ ulCluster / 32 ] >> ( ulCluster % 32 ) ) & 1ul ) != 0ul;
+        }
+        else
+    #endif
+    #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+        if( ( pxIOManager->xPartition.ucFreeScanBusy != pdFALSE ) &&
+            ( ulCluster < pxIOManager->xPartition.ulScanCluster ) )
+        {
+            /* The background scan has seen this cluster already. */
+            xResult = ( ( pxIOManager->xPartition.pulScanBitmap[ ulCluster / 32 ] >> ( ulCluster % 32 ) ) & 1ul ) != 0ul;
+        }
+        else
+    #endif
     {
-        xError = FF_DecreaseFreeClusters( pxIOManager, 1 );
+        xResult = ( FF_getFATEntry( pxIOManager, ulCluster, pxError, pxFATBuffers ) == 0ul ) && ( FF_isERR( *pxError ) == pdFALSE );
     }
 
-    *pxError = xError;
-
-    return ulStartCluster;
+    return xResult;
 }
 /*-----------------------------------------------------------*/
 
-uint32_t FF_GetChainLength( FF_IOManager_t * pxIOManager,
+/**
+ *	@brief	Finds a run of up to 'ulCount' contiguous free clusters in a single pass over the FAT.
+ *
+ *	@param	pxIOManager		IOMAN Object.
+ *	@param	ulStartCluster	The preferred first cluster, normally the one following the end of a chain.
+ *							When it is not free, the search starts at 'ulLastFreeCluster'.
+ *	@param	ulCount			The number of clusters wanted.
+ *	@param	ulWindow		The number of clusters to look at after the first free one, before
+ *							the longest run seen is accepted. 0 takes the first run found.
+ *	@param	pulLength		Receives the length of the run found, between 1 and 'ulCount'.
+ *
+ *	@return	The first cluster of the run. The first run long enough is taken, or else the longest one
+ *			seen within the window, or before the search came back to where it started.
+ *	@retval 0 when there are no free clusters, or on error.
+ *	@note	The clusters are not claimed, see FF_ClaimClusterExtent().
+ **/
+uint32_t FF_FindFreeExtent( FF_IOManager_t * pxIOManager,
                             uint32_t ulStartCluster,
-                            uint32_t * pulEndOfChain,
+                            uint32_t ulCount,
+                            uint32_t ulWindow,
+                            uint32_t * pulLength,
                             FF_Error_t * pxError )
 {
-    uint32_t ulLength = 0;
-    FF_FATBuffers_t xFATBuffers;
     FF_Error_t xError = FF_ERR_NONE;
+    FF_FATBuffers_t xFATBuffers;
+    const uint32_t ulNumClusters = pxIOManager->xPartition.ulNumClusters;
+    uint32_t ulCluster;
+    uint32_t ulVisited = 0ul;
+    uint32_t ulRunStart = 0ul, ulRunLength = 0ul;
+    uint32_t ulBestStart = 0ul, ulBestLength = 0ul;
+    uint32_t ulWindowEnd = 0ul;
 
+    FF_Assert_Lock( pxIOManager, FF_FAT_LOCK );
     FF_InitFATBuffers( &xFATBuffers, FF_MODE_READ );
 
-    FF_LockFAT( pxIOManager );
+    #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
     {
-        while( FF_isEndOfChain( pxIOManager, ulStartCluster ) == pdFALSE )
+        #if ( ffconfigFAT12_SUPPORT != 0 )
+            if( pxIOManager->xPartition.ucType != FF_T_FAT12 )
+        #endif
         {
-            ulStartCluster = FF_getFATEntry( pxIOManager, ulStartCluster, &xError, &xFATBuffers );
+            ( void ) prvBuildFreeBitmap( pxIOManager, &xError );
+        }
+    }
+    #endif
 
-            if( FF_isERR( xError ) )
+    if( ( ulStartCluster < 2ul ) || ( ulStartCluster >= ulNumClusters ) )
+    {
+        ulStartCluster = 2ul;
+    }
+
+    if( ( ulWindow != 0ul ) &&
+        ( FF_isERR( xError ) == pdFALSE ) &&
+        ( prvIsFreeCluster( pxIOManager, ulStartCluster, &xFATBuffers, &xError ) == pdFALSE ) &&
+        ( pxIOManager->xPartition.ulLastFreeCluster >= 2ul ) &&
+        ( pxIOManager->xPartition.ulLastFreeCluster < ulNumClusters ) )
+    {
+        /* The chain can not grow in place, continue where the last free cluster was found.
+         * A first-fit search keeps going forward from 'ulStartCluster', so that a chain
+         * allocated run by run does not scan the same clusters again for every run. */
+        ulStartCluster = pxIOManager->xPartition.ulLastFreeCluster;
+    }
+
+    ulCluster = ulStartCluster;
+
+    while( ( FF_isERR( xError ) == pdFALSE ) && ( ulVisited < ulNumClusters - 2ul ) )
+    {
+        #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+        {
+            /* Skip 32 clusters in use at once. */
+            if( ( pxIOManager->xPartition.pulFreeBitmap != NULL ) &&
+                ( ( ulCluster % 32 ) == 0 ) &&
+                ( pxIOManager->xPartition.pulFreeBitmap[ ulCluster / 32 ] == 0ul ) &&
+                ( ulCluster + 32 <= ulNumClusters ) )
             {
-                ulLength = 0;
-                break;
-            }
+                if( ( ulBestLength != 0ul ) && ( ulVisited >= ulWindowEnd ) )
+                {
+                    break;
+                }
 
-            ulLength++;
+                ulRunLength = 0ul;
+                ulVisited += 32;
+                ulCluster += 32;
+
+                if( ulCluster == ulNumClusters )
+                {
+                    ulCluster = 2ul;
+                }
+
+                continue;
+            }
         }
+        #endif /* ffconfigFREE_CLUSTER_BITMAP */
 
-        if( pulEndOfChain != NULL )
+        if( prvIsFreeCluster( pxIOManager, ulCluster, &xFATBuffers, &xError ) != pdFALSE )
         {
-            /* _HT_
-             * ulStartCluster has just been tested as an end-of-chain token.
-             * Not sure if the caller expects this. */
-            *pulEndOfChain = ulStartCluster;
-        }
+            if( ulRunLength == 0ul )
+            {
+                ulRunStart = ulCluster;
 
-        xError = FF_ReleaseFATBuffers( pxIOManager, &xFATBuffers );
-    }
-    FF_UnlockFAT( pxIOManager );
+                if( ulBestLength == 0ul )
+                {
+                    if( ( ulStartCluster == pxIOManager->xPartition.ulLastFreeCluster ) &&
+                        ( ulCluster > ulStartCluster ) )
+                    {
+                        /* All clusters in between are in use, move the hint forward. */
+                        pxIOManager->xPartition.ulLastFreeCluster = ulCluster;
+                    }
 
-    *pxError = xError;
+                    /* The first free cluster, the window starts here. */
+                    if( ulWindow < ulNumClusters )
+                    {
+                        ulWindowEnd = ulVisited + ulWindow;
+                    }
+                    else
+                    {
+                        ulWindowEnd = ulNumClusters;
+                    }
+                }
+            }
 
-    return ulLength;
-}
-/*-----------------------------------------------------------*/
+            ulRunLength++;
 
-/**
- *	@brief Free's Disk space by freeing unused links on Cluster Chains
+            if( ulRunLength > ulBestLength )
+            {
+                ulBestStart = ulRunStart;
+                ulBestLength = ulRunLength;
+
+                if( ulBestLength >= ulCount )
+                {
+                    break;
+                }
+            }
+        }
+        else
+        {
+            ulRunLength = 0ul;
+
+            if( ( ulBestLength != 0ul ) && ( ulVisited >= ulWindowEnd ) )
+            {
+                /* No run long enough within the window, take the longest one seen. */
+                break;
+            }
+        }
+
+        ulVisited++;
+        ulCluster++;
+
+        if( ulCluster == ulNumClusters )
+        {
+            /* Wrap around, a run can not continue from the last to the first cluster. */
+            ulCluster = 2ul;
+            ulRunLength = 0ul;
+        }
+    }
+
+    {
+        FF_Error_t xTempError;
+
+        xTempError = FF_ReleaseFATBuffers( pxIOManager, &xFATBuffers );
+
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            xError = xTempError;
+        }
+    }
+
+    if( FF_isERR( xError ) )
+    {
+        ulBestStart = 0ul;
+        ulBestLength = 0ul;
+    }
+
+    *pulLength = ulBestLength;
+    *pxError = xError;
+
+    return ulBestStart;
+} /* FF_FindFreeExtent() */
+/*-----------------------------------------------------------*/
+
+/**
+ *	@brief	Claims a run of free clusters found by FF_FindFreeExtent() and links it to a chain.
+ *
+ *	@param	pxIOManager	IOMAN Object.
+ *	@param	ulPrevious	The last cluster of the chain to be extended, or 0 to start a new chain.
+ *	@param	ulFirst		The first cluster of the run.
+ *	@param	ulLength	The number of clusters in the run.
+ *
+ *	The run is written as one chain, sharing the FAT buffers between consecutive entries,
+ *	and only then linked to 'ulPrevious'. The free cluster count is not changed here.
+ **/
+FF_Error_t FF_ClaimClusterExtent( FF_IOManager_t * pxIOManager,
+                                  uint32_t ulPrevious,
+                                  uint32_t ulFirst,
+                                  uint32_t ulLength )
+{
+    FF_Error_t xError = FF_ERR_NONE;
+    FF_Error_t xTempError;
+    FF_FATBuffers_t xFATBuffers;
+    uint32_t ulLast = ulFirst + ulLength - 1;
+    uint32_t ulCluster;
+
+    FF_Assert_Lock( pxIOManager, FF_FAT_LOCK );
+    FF_InitFATBuffers( &xFATBuffers, FF_MODE_WRITE );
+
+    for( ulCluster = ulFirst; ulCluster < ulLast; ulCluster++ )
+    {
+        xError = FF_putFATEntry( pxIOManager, ulCluster, ulCluster + 1, &xFATBuffers );
+
+        if( FF_isERR( xError ) )
+        {
+            break;
+        }
+    }
+
+    if( FF_isERR( xError ) == pdFALSE )
+    {
+        xError = FF_putFATEntry( pxIOManager, ulLast, 0xFFFFFFFF, &xFATBuffers );
+    }
+
+    if( ( FF_isERR( xError ) == pdFALSE ) && ( ulPrevious != 0ul ) )
+    {
+        xError = FF_putFATEntry( pxIOManager, ulPrevious, ulFirst, &xFATBuffers );
+    }
+
+    xTempError = FF_ReleaseFATBuffers( pxIOManager, &xFATBuffers );
+
+    if( FF_isERR( xError ) == pdFALSE )
+    {
+        xError = xTempError;
+
+        /* Keep 'ulLastFreeCluster' below or at the first free cluster. */
+        if( ( pxIOManager->xPartition.ulLastFreeCluster >= ulFirst ) &&
+            ( pxIOManager->xPartition.ulLastFreeCluster <= ulLast ) )
+        {
+            pxIOManager->xPartition.ulLastFreeCluster = ulLast + 1;
+        }
+    }
+
+    return xError;
+} /* FF_ClaimClusterExtent() */
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief	Creates a Cluster Chain
+ *	@retval > 0 New created cluster
+ *	@retval = 0 See pxError
+ **/
+uint32_t FF_CreateClusterChain( FF_IOManager_t * pxIOManager,
+                                FF_Error_t * pxError )
+{
+    uint32_t ulStartCluster;
+    FF_Error_t xError = FF_ERR_NONE;
+
+    FF_LockFAT( pxIOManager );
+    {
+        ulStartCluster = FF_FindFreeCluster( pxIOManager, &xError, pdTRUE );
+    }
+    FF_UnlockFAT( pxIOManager );
+
+    if( ulStartCluster != 0L )
+    {
+        xError = FF_DecreaseFreeClusters( pxIOManager, 1 );
+    }
+
+    *pxError = xError;
+
+    return ulStartCluster;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t FF_GetChainLength( FF_IOManager_t * pxIOManager,
+                            uint32_t ulStartCluster,
+                            uint32_t * pulEndOfChain,
+                            FF_Error_t * pxError )
+{
+    uint32_t ulLength = 0;
+    FF_FATBuffers_t xFATBuffers;
+    FF_Error_t xError = FF_ERR_NONE;
+
+    FF_InitFATBuffers( &xFATBuffers, FF_MODE_READ );
+
+    FF_LockFATShared( pxIOManager );
+    {
+        while( FF_isEndOfChain( pxIOManager, ulStartCluster ) == pdFALSE )
+        {
+            ulStartCluster = FF_getFATEntry( pxIOManager, ulStartCluster, &xError, &xFATBuffers );
+
+            if( FF_isERR( xError ) )
+            {
+                ulLength = 0;
+                break;
+            }
+
+            ulLength++;
+        }
+
+        if( pulEndOfChain != NULL )
+        {
+            /* _HT_
+             * ulStartCluster has just been tested as an end-of-chain token.
+             * Not sure if the caller expects this. */
+            *pulEndOfChain = ulStartCluster;
+        }
+
+        xError = FF_ReleaseFATBuffers( pxIOManager, &xFATBuffers );
+    }
+    FF_UnlockFATShared( pxIOManager );
+
+    *pxError = xError;
+
+    return ulLength;
+}
+/*-----------------------------------------------------------*/
+
+/* Called by FF_UnlinkClusterChain() on FAT16 and FAT32 partitions.  Free
+ * the run of clusters that starts at 'ulCluster', in which every FAT entry
+ * points to the next cluster.  The run ends at the first entry that does not
+ * point to its neighbour, or at the end of the FAT sector.  The entries of
+ * the run are cleared with a single memset() in each copy of the FAT.
+ * Returns the FAT entry of the last cluster in the run, and stores the
+ * number of clusters freed in 'pulCount'. */
+static uint32_t prvUnlinkClusterRun( FF_IOManager_t * pxIOManager,
+                                     uint32_t ulCluster,
+                                     FF_FATBuffers_t * pxFATBuffers,
+                                     uint32_t * pulCount,
+                                     FF_Error_t * pxError )
+{
+    FF_Buffer_t * pxBuffer;
+    const uint32_t ulEntrySize = ( pxIOManager->xPartition.ucType == FF_T_FAT32 ) ? 4ul : 2ul;
+    uint32_t ulFATOffset;
+    uint32_t ulFATSector = 0;
+    uint32_t ulRelClusterEntry = 0;
+    uint32_t ulLast = ulCluster;
+    uint32_t ulFATEntry = 0;
+    BaseType_t xIndex;
+    FF_Error_t xError = FF_ERR_NONE;
+
+    #if ( ffconfigWRITE_BOTH_FATS != 0 )
+        const BaseType_t xNumFATs = pxIOManager->xPartition.ucNumFATS;
+    #else
+        const BaseType_t xNumFATs = 1;
+    #endif
+
+    FF_Assert_Lock( pxIOManager, FF_FAT_LOCK );
+
+    /* Avoid corrupting the disk. */
+    if( ( ulCluster < 2ul ) || ( ulCluster >= pxIOManager->xPartition.ulNumClusters ) )
+    {
+        xError = FF_createERR( FF_ERR_IOMAN_NOT_ENOUGH_FREE_SPACE, FF_PUTFATENTRY );
+    }
+    else
+    {
+        ulFATOffset = ulCluster * ulEntrySize;
+        ulFATSector = pxIOManager->xPartition.ulFATBeginLBA + ( ulFATOffset / pxIOManager->xPartition.usBlkSize );
+        ulFATOffset = ulFATOffset % pxIOManager->xPartition.usBlkSize;
+        ulFATSector = FF_getRealLBA( pxIOManager, ulFATSector ) + ( ulFATOffset / pxIOManager->usSectorSize );
+        ulRelClusterEntry = ulFATOffset % pxIOManager->usSectorSize;
+
+        pxBuffer = prvGetFromFATBuffers( pxIOManager, pxFATBuffers, 0, ulFATSector, &xError, FF_MODE_WRITE );
+
+        if( FF_isERR( xError ) )
+        {
+            xError = FF_createERR( FF_GETERROR( xError ), FF_PUTFATENTRY );
+        }
+        else
+        {
+            uint32_t ulOffset = ulRelClusterEntry;
+
+            /* Find the end of the run within this sector. */
+            for( ; ; )
+            {
+                if( ulEntrySize == 4ul )
+                {
+                    ulFATEntry = FF_getLong( pxBuffer->pucBuffer, ulOffset ) & 0x0fffffff;
+                }
+                else
+                {
+                    ulFATEntry = ( uint32_t ) FF_getShort( pxBuffer->pucBuffer, ulOffset );
+                }
+
+                if( ( ulFATEntry != ulLast + 1 ) ||
+                    ( ulFATEntry >= pxIOManager->xPartition.ulNumClusters ) ||
+                    ( ulOffset + ulEntrySize >= ( uint32_t ) pxIOManager->usSectorSize ) )
+                {
+                    break;
+                }
+
+                ulLast++;
+                ulOffset += ulEntrySize;
+            }
+
+            for( xIndex = 0; xIndex < xNumFATs; xIndex++ )
+            {
+                if( xIndex > 0 )
+                {
+                    ulFATSector += pxIOManager->xPartition.ulSectorsPerFAT;
+                    pxBuffer = prvGetFromFATBuffers( pxIOManager, pxFATBuffers, xIndex, ulFATSector, &xError, FF_MODE_WRITE );
+
+                    if( FF_isERR( xError ) )
+                    {
+                        xError = FF_createERR( FF_GETERROR( xError ), FF_PUTFATENTRY );
+                        break;
+                    }
+                }
+
+                memset( pxBuffer->pucBuffer + ulRelClusterEntry, 0, ( size_t ) ( ( ulLast - ulCluster ) + 1 ) * ulEntrySize );
+
+                if( xIndex < ffconfigBUF_STORE_COUNT )
+                {
+                    /* Store it for later use. */
+                    pxFATBuffers->pxBuffers[ xIndex ] = pxBuffer;
+                    pxFATBuffers->ucMode = FF_MODE_WRITE;
+                }
+                else
+                {
+                    xError = FF_ReleaseBuffer( pxIOManager, pxBuffer );
+
+                    if( FF_isERR( xError ) )
+                    {
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+    {
+        uint32_t * pulFreeBitmap = pxIOManager->xPartition.pulFreeBitmap;
+
+        if( pulFreeBitmap != NULL )
+        {
+            if( FF_isERR( xError ) )
+            {
+                /* The state of the FAT entries is not known any more. */
+                FF_ReleaseFreeBitmap( pxIOManager );
+            }
+            else
+            {
+                uint32_t ulBit;
+
+                for( ulBit = ulCluster; ulBit <= ulLast; ulBit++ )
+                {
+                    pulFreeBitmap[ ulBit / 32 ] |= ( 1ul << ( ulBit % 32 ) );
+                }
+            }
+        }
+    }
+    #endif /* ffconfigFREE_CLUSTER_BITMAP */
+
+    #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+        if( ( ulCluster >= 2ul ) && ( ulCluster < pxIOManager->xPartition.ulNumClusters ) )
+        {
+            /* The clusters of a chain were in use. */
+            prvFreeScanUpdate( pxIOManager, ulCluster, ulLast, pdFALSE, pdTRUE, xError );
+        }
+    #endif
+
+    if( FF_isERR( xError ) )
+    {
+        ulFATEntry = 0ul;
+        *pulCount = 0ul;
+    }
+    else
+    {
+        *pulCount = ( ulLast - ulCluster ) + 1;
+    }
+
+    *pxError = xError;
+
+    return ulFATEntry;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *	@brief Free's Disk space by freeing unused links on Cluster Chains
  *
  *	@param	pxIOManager	    IOMAN object.
  *	@param	ulStartCluster	Cluster Number that starts the chain.
@@ -1351,22 +2122,34 @@ FF_Error_t FF_UnlinkClusterChain( FF_IOManager_t * pxIOManager,
 
     do
     {
-        /* Sector will now be fetched in write-mode. */
-        ulFATEntry = FF_getFATEntry( pxIOManager, ulFATEntry, &xError, &xFATBuffers );
-
-        if( FF_isERR( xError ) )
+        if( ( pxIOManager->xPartition.ucType != FF_T_FAT12 ) &&
+            ( ( xDoTruncate == pdFALSE ) || ( ulCurrentCluster != ulStartCluster ) ) )
         {
-            break;
-        }
+            uint32_t ulCount;
 
-        if( ( xDoTruncate != pdFALSE ) && ( ulCurrentCluster == ulStartCluster ) )
-        {
-            xError = FF_putFATEntry( pxIOManager, ulCurrentCluster, 0xFFFFFFFF, &xFATBuffers );
+            /* Free all clusters up to the next jump in the chain at once. */
+            ulFATEntry = prvUnlinkClusterRun( pxIOManager, ulCurrentCluster, &xFATBuffers, &ulCount, &xError );
+            ulLength += ulCount;
         }
         else
         {
-            xError = FF_putFATEntry( pxIOManager, ulCurrentCluster, 0x00000000, &xFATBuffers );
-            ulLength++;
+            /* Sector will now be fetched in write-mode. */
+            ulFATEntry = FF_getFATEntry( pxIOManager, ulFATEntry, &xError, &xFATBuffers );
+
+            if( FF_isERR( xError ) )
+            {
+                break;
+            }
+
+            if( ( xDoTruncate != pdFALSE ) && ( ulCurrentCluster == ulStartCluster ) )
+            {
+                xError = FF_putFATEntry( pxIOManager, ulCurrentCluster, 0xFFFFFFFF, &xFATBuffers );
+            }
+            else
+            {
+                xError = FF_putFATEntry( pxIOManager, ulCurrentCluster, 0x00000000, &xFATBuffers );
+                ulLength++;
+            }
         }
 
         if( FF_isERR( xError ) )
@@ -1420,46 +2203,147 @@ FF_Error_t FF_UnlinkClusterChain( FF_IOManager_t * pxIOManager,
     static uint32_t prvCountFreeClustersSimple( FF_IOManager_t * pxIOManager,
                                                 FF_Error_t * pxError )
     {
-        FF_Error_t xError = FF_ERR_NONE;
+        FF_Error_t xError = FF_ERR_NONE;
+        uint32_t ulIndex;
+        uint32_t ulFATEntry;
+        uint32_t ulFreeClusters = 0;
+        const uint32_t xTotalClusters =
+            pxIOManager->xPartition.ulDataSectors / pxIOManager->xPartition.ulSectorsPerCluster;
+
+        for( ulIndex = 0; ulIndex < xTotalClusters; ulIndex++ )
+        {
+            ulFATEntry = FF_getFATEntry( pxIOManager, ulIndex, &xError, NULL );
+
+            if( FF_isERR( xError ) )
+            {
+                break;
+            }
+
+            if( ulFATEntry == 0UL )
+            {
+                ulFreeClusters++;
+            }
+        }
+
+        *pxError = xError;
+
+        return ulFreeClusters;
+    }
+#endif /* if ( ffconfigFAT12_SUPPORT != 0 ) */
+/*-----------------------------------------------------------*/
+
+
+static void prvDecodeEntries( const uint8_t * pucEntries,
+                              uint32_t * pulValues,
+                              uint32_t ulCount,
+                              BaseType_t xIsFAT32 )
+{
+    uint32_t ulIndex;
+
+    if( xIsFAT32 != pdFALSE )
+    {
+        FF_getLongs( pucEntries, 0, pulValues, ulCount );
+
+        for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+        {
+            /* Clearing the top 4 bits. */
+            pulValues[ ulIndex ] &= 0x0fffffffUL;
+        }
+    }
+    else
+    {
+        FF_getShorts( pucEntries, 0, pulValues, ulCount );
+    }
+}
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+    static uint32_t prvFreeMask( const uint32_t * pulValues,
+                                 uint32_t ulCount )
+    {
+        uint32_t ulMask = 0;
         uint32_t ulIndex;
-        uint32_t ulFATEntry;
-        uint32_t ulFreeClusters = 0;
-        const uint32_t xTotalClusters =
-            pxIOManager->xPartition.ulDataSectors / pxIOManager->xPartition.ulSectorsPerCluster;
 
-        for( ulIndex = 0; ulIndex < xTotalClusters; ulIndex++ )
+        for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
         {
-            ulFATEntry = FF_getFATEntry( pxIOManager, ulIndex, &xError, NULL );
+            ulMask |= ( ( pulValues[ ulIndex ] == 0UL ) ? 1UL : 0UL ) << ulIndex;
+        }
 
-            if( FF_isERR( xError ) )
+        return ulMask;
+    }
+#endif /* ffconfigFREE_CLUSTER_BITMAP */
+/*-----------------------------------------------------------*/
+
+/* Count the FAT16 or FAT32 entries that are zero in an array of 'ulCount'
+ * entries.  On little endian CPU's, the entries are loaded as words when the
+ * array is properly aligned or when the CPU allows unaligned access, which
+ * lets the compiler vectorise the loop.  Otherwise they are decoded in groups
+ * by FF_getLongs() or FF_getShorts(). */
+static uint32_t prvCountFreeEntries( const uint8_t * pucEntries,
+                                     uint32_t ulCount,
+                                     BaseType_t xIsFAT32 )
+{
+    uint32_t ulFree = 0;
+    uint32_t ulIndex;
+
+    #if ( ffconfigBYTE_ORDER == pdFREERTOS_LITTLE_ENDIAN )
+        if( ( ffMEMORY_WORD_ACCESS != 0 ) || ( ( ( ( uintptr_t ) pucEntries ) & 3u ) == 0u ) )
+        {
+            if( xIsFAT32 != pdFALSE )
             {
-                break;
-            }
+                uint32_t ulEntry;
 
-            if( ulFATEntry == 0UL )
+                for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+                {
+                    memcpy( &ulEntry, &( pucEntries[ ulIndex * 4 ] ), sizeof( ulEntry ) );
+                    /* The top 4 bits are reserved. */
+                    ulFree += ( ( ulEntry & 0x0fffffffUL ) == 0UL ) ? 1UL : 0UL;
+                }
+            }
+            else
             {
-                ulFreeClusters++;
+                uint16_t usEntry;
+
+                for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+                {
+                    memcpy( &usEntry, &( pucEntries[ ulIndex * 2 ] ), sizeof( usEntry ) );
+                    ulFree += ( usEntry == 0U ) ? 1UL : 0UL;
+                }
             }
         }
+        else
+    #endif /* ffconfigBYTE_ORDER == pdFREERTOS_LITTLE_ENDIAN */
+    {
+        uint32_t ulValues[ ffFAT_DECODE_ENTRIES ];
+        uint32_t ulEntries;
 
-        *pxError = xError;
+        while( ulCount > 0 )
+        {
+            ulEntries = ( ulCount < ffFAT_DECODE_ENTRIES ) ? ulCount : ffFAT_DECODE_ENTRIES;
+            prvDecodeEntries( pucEntries, ulValues, ulEntries, xIsFAT32 );
 
-        return ulFreeClusters;
+            for( ulIndex = 0; ulIndex < ulEntries; ulIndex++ )
+            {
+                ulFree += ( ulValues[ ulIndex ] == 0UL ) ? 1UL : 0UL;
+            }
+
+            pucEntries += ulEntries * ( ( xIsFAT32 != pdFALSE ) ? 4 : 2 );
+            ulCount -= ulEntries;
+        }
     }
-#endif /* if ( ffconfigFAT12_SUPPORT != 0 ) */
-/*-----------------------------------------------------------*/
 
+    return ulFree;
+}
+/*-----------------------------------------------------------*/
 
 uint32_t FF_CountFreeClusters( FF_IOManager_t * pxIOManager,
                                FF_Error_t * pxError )
 {
     FF_Error_t xError = FF_ERR_NONE;
     FF_Buffer_t * pxBuffer;
-    uint32_t ulIndex, x;
-    uint32_t ulFATEntry;
+    uint32_t ulIndex;
     uint32_t ulEntriesPerSector;
     uint32_t ulFreeClusters = 0;
-    uint32_t ClusterNum = 0;
     BaseType_t xInfoKnown = pdFALSE;
     BaseType_t xTakeLock = FF_Has_Lock( pxIOManager, FF_FAT_LOCK ) == pdFALSE;
 
@@ -1520,7 +2404,14 @@ uint32_t FF_CountFreeClusters( FF_IOManager_t * pxIOManager,
 
         if( ( xInfoKnown == pdFALSE ) && ( pxIOManager->xPartition.usBlkSize != 0 ) )
         {
-            if( pxIOManager->xPartition.ucType == FF_T_FAT32 )
+            const BaseType_t xIsFAT32 = ( pxIOManager->xPartition.ucType == FF_T_FAT32 );
+            /* FAT table might not be cluster aligned.  Stop counting after
+             * the entry of the last cluster. */
+            uint32_t ulEntriesLeft = pxIOManager->xPartition.ulNumClusters + 2;
+            uint8_t * pucSectors = NULL;
+            uint32_t ulSectorCount = 1;
+
+            if( xIsFAT32 != pdFALSE )
             {
                 ulEntriesPerSector = pxIOManager->usSectorSize / 4;
             }
@@ -1529,14 +2420,61 @@ uint32_t FF_CountFreeClusters( FF_IOManager_t * pxIOManager,
                 ulEntriesPerSector = pxIOManager->usSectorSize / 2;
             }
 
-            for( ulIndex = 0; ulIndex < pxIOManager->xPartition.ulSectorsPerFAT; ulIndex++ )
+            #if ( ffconfigCOUNT_FREE_READ_SECTORS != 0 )
             {
-                pxBuffer = FF_GetBuffer( pxIOManager, pxIOManager->xPartition.ulFATBeginLBA + ulIndex, FF_MODE_READ );
+                /* Read many sectors with a single call to the driver. */
+                pucSectors = ( uint8_t * ) ffconfigMALLOC( ( size_t ) ffconfigCOUNT_FREE_READ_SECTORS * pxIOManager->usSectorSize );
+            }
+            #endif
 
-                if( pxBuffer == NULL )
+            for( ulIndex = 0; ( ulIndex < pxIOManager->xPartition.ulSectorsPerFAT ) && ( ulEntriesLeft != 0 ); ulIndex += ulSectorCount )
+            {
+                uint32_t ulSector = pxIOManager->xPartition.ulFATBeginLBA + ulIndex;
+                uint32_t ulEntries;
+
+                if( pucSectors != NULL )
                 {
-                    xError = FF_createERR( FF_ERR_DEVICE_DRIVER_FAILED, FF_COUNTFREECLUSTERS );
-                    break;
+                    #if ( ffconfigCOUNT_FREE_READ_SECTORS != 0 )
+                    {
+                        /* Do not read beyond the sector that holds the last entry. */
+                        ulSectorCount = ( ulEntriesLeft + ulEntriesPerSector - 1 ) / ulEntriesPerSector;
+
+                        if( ulSectorCount > pxIOManager->xPartition.ulSectorsPerFAT - ulIndex )
+                        {
+                            ulSectorCount = pxIOManager->xPartition.ulSectorsPerFAT - ulIndex;
+                        }
+
+                        if( ulSectorCount > ffconfigCOUNT_FREE_READ_SECTORS )
+                        {
+                            ulSectorCount = ffconfigCOUNT_FREE_READ_SECTORS;
+                        }
+                    }
+                    #endif
+
+                    /* The cache may hold a more recent copy of these sectors. */
+                    xError = FF_FlushBuffers( pxIOManager, ulSector, ulSectorCount );
+
+                    if( FF_isERR( xError ) == pdFALSE )
+                    {
+                        xError = FF_BlockRead( pxIOManager, ulSector, ulSectorCount, pucSectors, pdFALSE );
+                    }
+
+                    if( FF_isERR( xError ) )
+                    {
+                        break;
+                    }
+
+                    pxBuffer = NULL;
+                }
+                else
+                {
+                    pxBuffer = FF_GetBuffer( pxIOManager, ulSector, FF_MODE_READ );
+
+                    if( pxBuffer == NULL )
+                    {
+                        xError = FF_createERR( FF_ERR_DEVICE_DRIVER_FAILED, FF_COUNTFREECLUSTERS );
+                        break;
+                    }
                 }
 
                 #if USE_SOFT_WDT
@@ -1544,77 +2482,371 @@ uint32_t FF_CountFreeClusters( FF_IOManager_t * pxIOManager,
                     /* _HT_ : FF_CountFreeClusters was a little too busy, have it call the WDT and sleep */
                     clearWDT();
 
-                    if( ( ( ulIndex + 1 ) % 32 ) == 0 )
+                    if( ( ( ulIndex + ulSectorCount ) % 32 ) < ulSectorCount )
                     {
                         FF_Sleep( 1 );
                     }
                 }
                 #endif
 
-                for( x = 0; x < ulEntriesPerSector; x++ )
+                ulEntries = ulEntriesPerSector * ulSectorCount;
+
+                if( ulEntries > ulEntriesLeft )
                 {
-                    if( pxIOManager->xPartition.ucType == FF_T_FAT32 )
+                    ulEntries = ulEntriesLeft;
+                }
+
+                ulFreeClusters += prvCountFreeEntries( ( pxBuffer != NULL ) ? pxBuffer->pucBuffer : pucSectors, ulEntries, xIsFAT32 );
+                ulEntriesLeft -= ulEntries;
+
+                if( pxBuffer != NULL )
+                {
+                    xError = FF_ReleaseBuffer( pxIOManager, pxBuffer );
+                    pxBuffer = NULL;
+
+                    if( FF_isERR( xError ) )
+                    {
+                        break;
+                    }
+                }
+            } /* for( ulIndex = 0; ulIndex < pxIOManager->xPartition.ulSectorsPerFAT; ulIndex += ulSectorCount ) */
+
+            if( pucSectors != NULL )
+            {
+                ffconfigFREE( pucSectors );
+            }
+
+            /* ulFreeClusters is -2 because the first 2 fat entries in the table are reserved. */
+            if( ulFreeClusters > pxIOManager->xPartition.ulNumClusters )
+            {
+                ulFreeClusters = pxIOManager->xPartition.ulNumClusters;
+            }
+        }
+    }
+
+    if( xTakeLock )
+    {
+        FF_UnlockFAT( pxIOManager );
+    }
+
+    if( FF_isERR( xError ) )
+    {
+        ulFreeClusters = 0;
+    }
+
+    *pxError = xError;
+
+    return ulFreeClusters;
+}
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+    BaseType_t FF_StartFreeScan( FF_IOManager_t * pxIOManager )
+    {
+        FF_Partition_t * pxPartition = &( pxIOManager->xPartition );
+        const size_t uxBitmapSize = ( size_t ) ( ( pxPartition->ulNumClusters + 31ul ) / 32ul ) * sizeof( uint32_t );
+        BaseType_t xResult = pdFALSE;
+
+        FF_StopFreeScan( pxIOManager );
+
+        /* FAT12 tables are small enough to be counted right away.  Without
+         * a running scheduler, the task would never get a chance to run. */
+        if( ( pxPartition->ucType != FF_T_FAT12 ) &&
+            ( pxPartition->ulNumClusters != 0ul ) &&
+            ( xTaskGetSchedulerState() == taskSCHEDULER_RUNNING ) )
+        {
+            pxPartition->pulScanBitmap = ( uint32_t * ) ffconfigMALLOC( uxBitmapSize );
+
+            if( pxPartition->pulScanBitmap != NULL )
+            {
+                memset( pxPartition->pulScanBitmap, '\0', uxBitmapSize );
+                pxPartition->ulScanCluster = 0ul;
+                pxPartition->ulScanFree = 0ul;
+                pxPartition->ucFreeScanStop = pdFALSE;
+                pxPartition->ucFreeScanTask = pdTRUE;
+                pxPartition->ucFreeScanBusy = pdTRUE;
+
+                if( xTaskCreate( prvFreeScanTask, "FreeScan", ffconfigFREE_SCAN_STACK_SIZE, pxIOManager,
+                                 ffconfigFREE_SCAN_TASK_PRIORITY, NULL ) == pdPASS )
+                {
+                    xResult = pdTRUE;
+                }
+                else
+                {
+                    pxPartition->ucFreeScanBusy = pdFALSE;
+                    pxPartition->ucFreeScanTask = pdFALSE;
+                    ffconfigFREE( pxPartition->pulScanBitmap );
+                    pxPartition->pulScanBitmap = NULL;
+                }
+            }
+        }
+
+        return xResult;
+    }
+#endif /* ffconfigBACKGROUND_FREE_SCAN */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+    void FF_StopFreeScan( FF_IOManager_t * pxIOManager )
+    {
+        /* The caller must not own the FAT lock, the scan task may be waiting for it. */
+        while( pxIOManager->xPartition.ucFreeScanTask != pdFALSE )
+        {
+            pxIOManager->xPartition.ucFreeScanStop = pdTRUE;
+            FF_Sleep( 1 );
+        }
+    }
+#endif /* ffconfigBACKGROUND_FREE_SCAN */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+    static void prvFreeScanUpdate( FF_IOManager_t * pxIOManager,
+                                   uint32_t ulFirst,
+                                   uint32_t ulLast,
+                                   BaseType_t xWasFree,
+                                   BaseType_t xIsFree,
+                                   FF_Error_t xError )
+    {
+        FF_Partition_t * pxPartition = &( pxIOManager->xPartition );
+        uint32_t ulCluster;
+
+        if( pxPartition->ucFreeScanBusy == pdFALSE )
+        {
+            /* No scan is running. */
+        }
+        else if( FF_isERR( xError ) )
+        {
+            /* The state of the FAT entries is not known any more. */
+            pxPartition->ucFreeScanStop = pdTRUE;
+        }
+        else if( xWasFree != xIsFree )
+        {
+            for( ulCluster = ulFirst; ulCluster <= ulLast; ulCluster++ )
+            {
+                if( ulCluster < pxPartition->ulScanCluster )
+                {
+                    /* Scanned already.  The caller will report the change to
+                     * FF_IncreaseFreeClusters() or FF_DecreaseFreeClusters(). */
+                    if( xIsFree != pdFALSE )
                     {
-                        /* Clearing the top 4 bits. */
-                        ulFATEntry = FF_getLong( pxBuffer->pucBuffer, x * 4 ) & 0x0fffffff;
+                        pxPartition->pulScanBitmap[ ulCluster / 32 ] |= ( 1ul << ( ulCluster % 32 ) );
                     }
                     else
                     {
-                        ulFATEntry = ( uint32_t ) FF_getShort( pxBuffer->pucBuffer, x * 2 );
+                        pxPartition->pulScanBitmap[ ulCluster / 32 ] &= ~( 1ul << ( ulCluster % 32 ) );
+                    }
+                }
+                else
+                {
+                    /* The scan will see the new value.  Count the old value
+                     * instead, the caller will report the change. */
+                    taskENTER_CRITICAL();
+                    {
+                        if( xWasFree != pdFALSE )
+                        {
+                            pxPartition->ulScanFree++;
+                        }
+                        else
+                        {
+                            pxPartition->ulScanFree--;
+                        }
+                    }
+                    taskEXIT_CRITICAL();
+                }
+            }
+        }
+    }
+#endif /* ffconfigBACKGROUND_FREE_SCAN */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+    static BaseType_t prvFindFreeInScan( FF_IOManager_t * pxIOManager,
+                                         uint32_t * pulCluster )
+    {
+        FF_Partition_t * pxPartition = &( pxIOManager->xPartition );
+        uint32_t ulScanned = pxPartition->ulScanCluster;
+        uint32_t ulCluster;
+        BaseType_t xResult = pdFALSE;
+
+        FF_Assert_Lock( pxIOManager, FF_FAT_LOCK );
+
+        /* The scan also counts the two entries beyond the last cluster. */
+        if( ulScanned > pxPartition->ulNumClusters )
+        {
+            ulScanned = pxPartition->ulNumClusters;
+        }
+
+        if( ulScanned > 2ul )
+        {
+            /* FF_putFATEntry() keeps the bits below 'ulScanCluster' up-to-date,
+             * the bits above it are still zero. */
+            ulCluster = prvFindFreeInBitmap( pxPartition->pulScanBitmap, ulScanned, *pulCluster );
+
+            if( ulCluster != 0ul )
+            {
+                *pulCluster = ulCluster;
+                xResult = pdTRUE;
+            }
+        }
+
+        if( xResult == pdFALSE )
+        {
+            /* All clusters seen so far are in use. */
+            *pulCluster = ulScanned;
+        }
+
+        return xResult;
+    }
+#endif /* ffconfigBACKGROUND_FREE_SCAN */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+    static void prvFreeScanTask( void * pvParameters )
+    {
+        FF_IOManager_t * pxIOManager = ( FF_IOManager_t * ) pvParameters;
+        FF_Partition_t * pxPartition = &( pxIOManager->xPartition );
+        FF_Buffer_t * pxBuffer;
+        FF_Error_t xError = FF_ERR_NONE;
+        const BaseType_t xIsFAT32 = ( pxPartition->ucType == FF_T_FAT32 );
+        const uint32_t ulEntriesPerSector = pxIOManager->usSectorSize / ( xIsFAT32 ? 4 : 2 );
+        /* Count the same entries as FF_CountFreeClusters() does. */
+        const uint32_t ulEntryCount = pxPartition->ulNumClusters + 2;
+        uint32_t ulSectorCount;
+        uint32_t ulCluster;
+        uint32_t ulEntries;
+        uint32_t ulFree;
+        uint32_t ulCount;
+        uint32_t ulMask;
+        uint32_t ulBits;
+        uint32_t ulValues[ ffFAT_DECODE_ENTRIES ];
+        uint32_t x;
+
+        while( ( pxPartition->ulScanCluster < ulEntryCount ) && ( pxPartition->ucFreeScanStop == pdFALSE ) )
+        {
+            /* Hold the FAT lock for a few sectors only. */
+            FF_LockFAT( pxIOManager );
+
+            for( ulSectorCount = 0;
+                 ( ulSectorCount < ffconfigFREE_SCAN_STEP_SECTORS ) && ( pxPartition->ulScanCluster < ulEntryCount );
+                 ulSectorCount++ )
+            {
+                ulCluster = pxPartition->ulScanCluster;
+                pxBuffer = FF_GetBuffer( pxIOManager, pxPartition->ulFATBeginLBA + ( ulCluster / ulEntriesPerSector ), FF_MODE_READ );
+
+                if( pxBuffer == NULL )
+                {
+                    xError = FF_createERR( FF_ERR_DEVICE_DRIVER_FAILED, FF_COUNTFREECLUSTERS );
+                    break;
+                }
+
+                ulEntries = ulEntryCount - ulCluster;
+
+                if( ulEntries > ulEntriesPerSector )
+                {
+                    ulEntries = ulEntriesPerSector;
+                }
+
+                ulFree = 0;
+
+                for( x = 0; x < ulEntries; x += ulCount, ulCluster += ulCount )
+                {
+                    ulCount = ulEntries - x;
+
+                    if( ulCount > ffFAT_DECODE_ENTRIES )
+                    {
+                        ulCount = ffFAT_DECODE_ENTRIES;
+                    }
+
+                    prvDecodeEntries( pxBuffer->pucBuffer + ( x * ( xIsFAT32 ? 4 : 2 ) ), ulValues, ulCount, xIsFAT32 );
+                    ulMask = prvFreeMask( ulValues, ulCount );
+
+                    for( ulBits = ulMask; ulBits != 0ul; ulBits &= ulBits - 1ul )
+                    {
+                        ulFree++;
                     }
 
-                    if( ulFATEntry == 0ul )
+                    if( ulCluster == 0ul )
                     {
-                        ulFreeClusters++;
+                        /* The bitmap does not include the two reserved entries. */
+                        ulMask &= ~0x03ul;
                     }
 
-                    /* FAT table might not be cluster aligned. */
-                    if( ClusterNum > pxIOManager->xPartition.ulNumClusters )
+                    if( ulCluster < pxPartition->ulNumClusters )
                     {
-                        /* Stop counting if that's the case. */
-                        break;
+                        if( ( pxPartition->ulNumClusters - ulCluster ) < ffFAT_DECODE_ENTRIES )
+                        {
+                            /* Nor the entries beyond the last cluster. */
+                            ulMask &= ( 1ul << ( pxPartition->ulNumClusters - ulCluster ) ) - 1ul;
+                        }
+
+                        pxPartition->pulScanBitmap[ ulCluster / 32 ] |= ulMask;
                     }
+                }
 
-                    ClusterNum++;
+                taskENTER_CRITICAL();
+                {
+                    pxPartition->ulScanFree += ulFree;
                 }
+                taskEXIT_CRITICAL();
 
+                pxPartition->ulScanCluster = ulCluster;
                 xError = FF_ReleaseBuffer( pxIOManager, pxBuffer );
-                pxBuffer = NULL;
 
                 if( FF_isERR( xError ) )
                 {
                     break;
                 }
+            }
 
-                if( ClusterNum > pxIOManager->xPartition.ulNumClusters )
-                {
-                    /* Break out of 2nd loop too ^^ */
-                    break;
-                }
+            if( FF_isERR( xError ) )
+            {
+                pxPartition->ucFreeScanStop = pdTRUE;
+            }
+
+            FF_UnlockFAT( pxIOManager );
+        }
+
+        FF_LockFAT( pxIOManager );
+        {
+            uint32_t ulFreeClusters = 0ul;
+
+            if( pxPartition->ucFreeScanStop == pdFALSE )
+            {
+                /* From now on, FF_putFATEntry() keeps the bitmap up-to-date. */
+                pxPartition->pulFreeBitmap = pxPartition->pulScanBitmap;
+                ulFreeClusters = pxPartition->ulScanFree;
 
-                /* ulFreeClusters is -2 because the first 2 fat entries in the table are reserved. */
-                if( ulFreeClusters > pxIOManager->xPartition.ulNumClusters )
+                if( ulFreeClusters > pxPartition->ulNumClusters )
                 {
-                    ulFreeClusters = pxIOManager->xPartition.ulNumClusters;
+                    ulFreeClusters = pxPartition->ulNumClusters;
                 }
-            } /* for( ulIndex = 0; ulIndex < pxIOManager->xPartition.ulSectorsPerFAT; ulIndex++ ) */
-        }
-    }
+            }
+            else
+            {
+                /* Zero means: count the free clusters when needed. */
+                ffconfigFREE( pxPartition->pulScanBitmap );
+            }
 
-    if( xTakeLock )
-    {
-        FF_UnlockFAT( pxIOManager );
-    }
+            pxPartition->pulScanBitmap = NULL;
 
-    if( FF_isERR( xError ) )
-    {
-        ulFreeClusters = 0;
-    }
+            /* FF_IncreaseFreeClusters() and FF_DecreaseFreeClusters() update either
+             * ulScanFree or ulFreeClusterCount, depending on 'ucFreeScanBusy'. */
+            taskENTER_CRITICAL();
+            {
+                pxPartition->ulFreeClusterCount = ulFreeClusters;
+                pxPartition->ucFreeScanBusy = pdFALSE;
+            }
+            taskEXIT_CRITICAL();
+        }
+        FF_UnlockFAT( pxIOManager );
 
-    *pxError = xError;
+        /* FF_StopFreeScan() waits for this.  The I/O manager may be deleted
+         * as soon as it is cleared. */
+        pxPartition->ucFreeScanTask = pdFALSE;
 
-    return ulFreeClusters;
-}
+        vTaskDelete( NULL );
+    }
+#endif /* ffconfigBACKGROUND_FREE_SCAN */
 /*-----------------------------------------------------------*/
 
 #if ( ffconfig64_NUM_SUPPORT != 0 )
@@ -1627,6 +2859,12 @@ uint32_t FF_CountFreeClusters( FF_IOManager_t * pxIOManager,
 
         if( pxIOManager != NULL )
         {
+            while( FF_FreeScanBusy( pxIOManager ) != pdFALSE )
+            {
+                /* Wait for the background scan to count the free clusters. */
+                FF_Sleep( 1 );
+            }
+
             if( pxIOManager->xPartition.ulFreeClusterCount == 0ul )
             {
                 FF_LockFAT( pxIOManager );
@@ -1660,6 +2898,12 @@ uint32_t FF_CountFreeClusters( FF_IOManager_t * pxIOManager,
 
         if( pxIOManager != NULL )
         {
+            while( FF_FreeScanBusy( pxIOManager ) != pdFALSE )
+            {
+                /* Wait for the background scan to count the free clusters. */
+                FF_Sleep( 1 );
+            }
+
             if( pxIOManager->xPartition.ulFreeClusterCount == 0ul )
             {
                 FF_LockFAT( pxIOManager );
@@ -64,6 +64,84 @@ static uint32_t FF_FileLBA( FF_FILE * pxFile );
 static FF_Error_t FF_ExtendFile( FF_FILE * pxFile,
                                  uint32_t ulSize );
 
+static uint32_t prvWriteData( FF_FILE * pxFile,
+                              uint32_t ulBytesLeft,
+                              uint8_t * pucBuffer,
+                              FF_Error_t * pxError );
+
+#if ( ffconfigDELAYED_ALLOCATION != 0 )
+    static BaseType_t prvDelayWrite( FF_FILE * pxFile,
+                                     const uint8_t * pucSource,
+                                     uint32_t ulCount,
+                                     FF_Error_t * pxError );
+
+    static FF_Error_t prvFlushDelayedData( FF_FILE * pxFile );
+#endif
+
+/* Read sectors of a file directly from the disk, bypassing the cache. */
+static int32_t prvReadFileSectors( FF_FILE * pxFile,
+                                   uint32_t ulItemLBA,
+                                   uint32_t ulSectors,
+                                   void * pvBuffer );
+
+/* Write sectors of a file directly to the disk, bypassing the cache. */
+static int32_t prvWriteFileSectors( FF_IOManager_t * pxIOManager,
+                                    uint32_t ulItemLBA,
+                                    uint32_t ulSectors,
+                                    void * pvBuffer );
+
+/* Return how many clusters directly follow the current cluster of the handle
+ * on disk, at most 'ulCount - 1'. */
+static uint32_t prvClusterRun( FF_FILE * pxFile,
+                               uint32_t ulCount,
+                               FF_Error_t * pxError );
+
+/* Move the current cluster of the handle 'ulClusters' clusters further. */
+static FF_Error_t prvAdvanceClusters( FF_FILE * pxFile,
+                                      uint32_t ulClusters );
+
+#if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+
+/* Read or write 'ulCount' whole clusters with the driver's fnSubmitBlocks(),
+ * and look up the next run in the FAT while a run is being transferred. */
+    static FF_Error_t prvTransferClusters( FF_FILE * pxFile,
+                                           uint32_t ulCount,
+                                           uint8_t * pucBuffer,
+                                           BaseType_t xWrite );
+#endif
+
+#if ( ffconfigREAD_AHEAD_SECTORS > 1 )
+
+/* Called before reading sector 'ulItemLBA' of a file through the cache.  When
+ * the handle reads sector after sector, read the next run of sectors in one go. */
+    static void prvReadAhead( FF_FILE * pxFile,
+                              uint32_t ulItemLBA );
+#endif
+
+#if ( ffconfigFILE_EXTENT_MAP != 0 )
+
+/* Remember that 'ulLength' clusters of the file, starting at file cluster
+ * 'ulFileCluster', are stored contiguously from cluster 'ulCluster'. */
+    static void prvAddExtent( FF_FILE * pxFile,
+                              uint32_t ulFileCluster,
+                              uint32_t ulCluster,
+                              uint32_t ulLength );
+
+/* Look up file cluster 'ulFileCluster' in the extent map.  Returns the cluster
+ * on disk, or 0 when unknown.  'pulRemaining' receives the number of clusters
+ * that are known to follow it contiguously. */
+    static uint32_t prvFindExtent( const FF_FILE * pxFile,
+                                   uint32_t ulFileCluster,
+                                   uint32_t * pulRemaining );
+
+/* Translate file cluster 'ulFileCluster' to a cluster on disk.  Works like
+ * FF_TraverseFAT(), but it starts from the closest known run and it adds the
+ * runs that it passes to the extent map. */
+    static uint32_t prvMapFileCluster( FF_FILE * pxFile,
+                                       uint32_t ulFileCluster,
+                                       FF_Error_t * pxError );
+#endif /* ffconfigFILE_EXTENT_MAP */
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -127,6 +205,7 @@ uint8_t FF_GetModeBits( const char * pcMode )
 /*-----------------------------------------------------------*/
 
 static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
+                                     uint8_t ucMode,
                                      FF_Error_t * pxError )
 {
     FF_FILE * pxFile;
@@ -141,28 +220,31 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
     {
         memset( pxFile, 0, sizeof( *pxFile ) );
 
-        #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 )
-        {
-            pxFile->pucBuffer = ( uint8_t * ) ffconfigMALLOC( pxIOManager->usSectorSize );
-
-            if( pxFile->pucBuffer != NULL )
-            {
-                memset( pxFile->pucBuffer, 0, pxIOManager->usSectorSize );
-            }
-            else
+        #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 )
+            /* Without the optimisation, only direct access needs a buffer of its own. */
+            if( ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ( ucMode & FF_MODE_DIRECT ) != 0 ) )
             {
-                *pxError = FF_createERR( FF_ERR_NOT_ENOUGH_MEMORY, FF_OPEN );
-                ffconfigFREE( pxFile );
-                /* Make sure that NULL will be returned. */
-                pxFile = NULL;
+                pxFile->pucBuffer = ( uint8_t * ) ffconfigMALLOC( pxIOManager->usSectorSize );
+
+                if( pxFile->pucBuffer != NULL )
+                {
+                    memset( pxFile->pucBuffer, 0, pxIOManager->usSectorSize );
+                }
+                else
+                {
+                    *pxError = FF_createERR( FF_ERR_NOT_ENOUGH_MEMORY, FF_OPEN );
+                    ffconfigFREE( pxFile );
+                    /* Make sure that NULL will be returned. */
+                    pxFile = NULL;
+                }
             }
-        }
-        #else /* if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) */
+        #else /* if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 ) */
         {
             /* Remove compiler warnings. */
             ( void ) pxIOManager;
+            ( void ) ucMode;
         }
-        #endif /* if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) */
+        #endif /* if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 ) */
     }
 
     return pxFile;
@@ -322,7 +404,7 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
         else if( FF_isERR( xError ) == pdFALSE )
         {
             /* Allocate an empty file handle and buffer space for 'unaligned access'. */
-            pxFile = prvAllocFileHandle( pxIOManager, &xError );
+            pxFile = prvAllocFileHandle( pxIOManager, ucMode, &xError );
         }
     }
 
@@ -464,9 +546,12 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
     {
         if( pxFile != NULL )
         {
-            #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 )
+            #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 )
             {
-                ffconfigFREE( pxFile->pucBuffer );
+                if( pxFile->pucBuffer != NULL )
+                {
+                    ffconfigFREE( pxFile->pucBuffer );
+                }
             }
             #endif
             ffconfigFREE( pxFile );
@@ -549,31 +634,26 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
 /*-----------------------------------------------------------*/
 
 #if ( ffconfigPATH_CACHE != 0 )
-    /* _HT_ After a directory has been renamed, the path cache becomes out-of-date */
-    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
-        static void FF_RmPathCache( FF_IOManager_t * pxIOManager,
-                                    const FF_T_WCHAR * pcPath )
-    #else
-        static void FF_RmPathCache( FF_IOManager_t * pxIOManager,
-                                    const char * pcPath )
-    #endif
+    /* _HT_ After a directory has been removed or renamed, the path cache becomes out-of-date */
+    static void FF_RmPathCache( FF_IOManager_t * pxIOManager,
+                                uint32_t ulDirCluster )
     {
         /*
-         * The directory 'path' will be removed or renamed
-         * now clear all entries starting with 'path' in the path cache
+         * The path cache stores one entry per directory name, keyed on the
+         * cluster of its parent.  Forget the entry of the directory itself,
+         * and any names that were cached within it, so nothing refers to
+         * 'ulDirCluster' once it is freed and re-used.
          */
-        UBaseType_t pathLen = STRLEN( pcPath );
-
         FF_PendSemaphore( pxIOManager->pvSemaphore );
         {
             for( UBaseType_t xIndex = 0; xIndex < ffconfigPATH_CACHE_DEPTH; xIndex++ )
             {
-                UBaseType_t len2 = STRLEN( pxIOManager->xPartition.pxPathCache[ xIndex ].pcPath );
+                FF_PathCache_t * pxEntry = &( pxIOManager->xPartition.pxPathCache[ xIndex ] );
 
-                if( ( len2 >= pathLen ) && FF_strmatch( pxIOManager->xPartition.pxPathCache[ xIndex ].pcPath, pcPath, ( BaseType_t ) pathLen ) )
+                if( ( pxEntry->ulDirCluster == ulDirCluster ) || ( pxEntry->ulParentCluster == ulDirCluster ) )
                 {
-                    pxIOManager->xPartition.pxPathCache[ xIndex ].pcPath[ 0 ] = '\0';
-                    pxIOManager->xPartition.pxPathCache[ xIndex ].ulDirCluster = 0;
+                    pxEntry->pcName[ 0 ] = '\0';
+                    pxEntry->ulDirCluster = 0;
                 }
             }
         }
@@ -642,6 +722,12 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
                     FF_UnHashDir( pxIOManager, pxFile->ulObjectCluster );
                 }
                 #endif /* ffconfigHASH_CACHE */
+                #if ( ffconfigLFN_INDEX != 0 )
+                {
+                    /* Its cluster may become a different directory later. */
+                    FF_LFNIndexInvalidate( pxIOManager, pxFile->ulObjectCluster );
+                }
+                #endif /* ffconfigLFN_INDEX */
                 {
                     /* Add parameter 0 to delete the entire chain!
                      * The actual directory entries on disk will be freed. */
@@ -700,10 +786,8 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
 
                 #if ( ffconfigPATH_CACHE != 0 )
                 {
-                    /* We're removing a directory which might contain
-                     * subdirectories.  Instead of iterating through all
-                     * subdirectories, just clear the path cache. */
-                    FF_RmPathCache( pxIOManager, pcPath );
+                    /* The directory is gone, its cluster may be re-used. */
+                    FF_RmPathCache( pxIOManager, pxFile->ulObjectCluster );
                 }
                 #endif
             } while( pdFALSE );
@@ -717,9 +801,8 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
                     xError = xTempError;
                 }
 
-                FF_UnlockDirectory( pxIOManager );
-
-                /* Free the file pointer resources. */
+                /* Free the file pointer resources before the directory is
+                 * unlocked, see FF_RmFile(). */
                 xTempError = FF_Close( pxFile );
 
                 if( FF_isERR( xError ) == pdFALSE )
@@ -727,6 +810,8 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
                     xError = xTempError;
                 }
 
+                FF_UnlockDirectory( pxIOManager );
+
                 xTempError = FF_FlushCache( pxIOManager );
 
                 if( FF_isERR( xError ) == pdFALSE )
@@ -785,8 +870,8 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
              * state. */
             memset( &xFetchContext, '\0', sizeof( xFetchContext ) );
 
-            /* Get sole access to "directory changes" */
-            FF_LockDirectory( pxIOManager );
+            /* Get sole access to changes of this directory. */
+            FF_LockDirectoryCluster( pxIOManager, pxFile->ulDirCluster );
 
             /* Edit the Directory Entry! (So it appears as deleted); */
             do
@@ -826,6 +911,8 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
 
             {
                 FF_Error_t xTempError;
+                uint32_t ulDirCluster = pxFile->ulDirCluster;
+
                 xTempError = FF_CleanupEntryFetch( pxIOManager, &xFetchContext );
 
                 if( FF_isERR( xError ) == pdFALSE )
@@ -833,9 +920,9 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
                     xError = xTempError;
                 }
 
-                FF_UnlockDirectory( pxIOManager );
-
-                /* Free the file pointer resources. */
+                /* Free the file pointer resources.  This must be done before
+                 * the directory is unlocked: another task may put a new file
+                 * in the freed entry, and its handle would clash with this one. */
                 xTempError = FF_Close( pxFile );
 
                 if( FF_isERR( xError ) == pdFALSE )
@@ -843,6 +930,8 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
                     xError = xTempError;
                 }
 
+                FF_UnlockDirectoryCluster( pxIOManager, ulDirCluster );
+
                 xTempError = FF_FlushCache( pxIOManager );
 
                 if( FF_isERR( xError ) == pdFALSE )
@@ -1064,10 +1153,10 @@ static FF_FILE * prvAllocFileHandle( FF_IOManager_t * pxIOManager,
                 {
                     if( xIsDirectory != 0 )
                     {
-                        /* We've renamed a directory which might contain
-                         * subdirectories.  To avoid having false entries, clear
-                         * the path cache. */
-                        FF_RmPathCache( pxIOManager, szSourceFile );
+                        /* The path cache still knows the directory under its old
+                         * name.  Entries for its subdirectories are keyed on
+                         * clusters, which did not change. */
+                        FF_RmPathCache( pxIOManager, pSrcFile->ulObjectCluster );
                     }
                 }
                 #endif
@@ -1231,7 +1320,7 @@ static uint32_t FF_GetSequentialClusters( FF_IOManager_t * pxIOManager,
 
     *pxError = FF_ERR_NONE;
 
-    FF_LockFAT( pxIOManager );
+    FF_LockFATShared( pxIOManager );
 
     do
     {
@@ -1260,7 +1349,7 @@ static uint32_t FF_GetSequentialClusters( FF_IOManager_t * pxIOManager,
     }
     while( ulNextCluster == ( ulCurrentCluster + 1 ) );
 
-    FF_UnlockFAT( pxIOManager );
+    FF_UnlockFATShared( pxIOManager );
 
     *pxError = FF_ReleaseFATBuffers( pxIOManager, &xFATBuffers );
 
@@ -1268,33 +1357,400 @@ static uint32_t FF_GetSequentialClusters( FF_IOManager_t * pxIOManager,
 } /* FF_GetSequentialClusters() */
 /*-----------------------------------------------------------*/
 
-static FF_Error_t FF_ReadClusters( FF_FILE * pxFile,
-                                   uint32_t ulCount,
-                                   uint8_t * buffer )
+#if ( ffconfigFILE_EXTENT_MAP != 0 )
+    static void prvAddExtent( FF_FILE * pxFile,
+                              uint32_t ulFileCluster,
+                              uint32_t ulCluster,
+                              uint32_t ulLength )
+    {
+        FF_FileExtent_t * pxExtent;
+        BaseType_t xIndex;
+        BaseType_t xShortest = 0;
+        uint32_t ulFirst, ulLast;
+
+        if( ( pxFile->ulObjectCluster == 0ul ) || ( ulCluster == 0ul ) || ( ulLength == 0ul ) )
+        {
+            return;
+        }
+
+        for( xIndex = 0; xIndex < ( BaseType_t ) pxFile->usExtentCount; xIndex++ )
+        {
+            pxExtent = &( pxFile->xExtents[ xIndex ] );
+
+            /* The same distance between file and disk cluster numbers, and
+             * touching or overlapping: the two form one run. */
+            if( ( ( pxExtent->ulCluster - pxExtent->ulFileCluster ) == ( ulCluster - ulFileCluster ) ) &&
+                ( ulFileCluster <= ( pxExtent->ulFileCluster + pxExtent->ulLength ) ) &&
+                ( pxExtent->ulFileCluster <= ( ulFileCluster + ulLength ) ) )
+            {
+                ulFirst = ( ulFileCluster < pxExtent->ulFileCluster ) ? ulFileCluster : pxExtent->ulFileCluster;
+                ulLast = pxExtent->ulFileCluster + pxExtent->ulLength;
+
+                if( ulLast < ( ulFileCluster + ulLength ) )
+                {
+                    ulLast = ulFileCluster + ulLength;
+                }
+
+                pxExtent->ulCluster -= ( pxExtent->ulFileCluster - ulFirst );
+                pxExtent->ulFileCluster = ulFirst;
+                pxExtent->ulLength = ulLast - ulFirst;
+                return;
+            }
+
+            if( pxExtent->ulLength < pxFile->xExtents[ xShortest ].ulLength )
+            {
+                xShortest = xIndex;
+            }
+        }
+
+        if( pxFile->usExtentCount < ffconfigFILE_EXTENT_MAP )
+        {
+            pxExtent = &( pxFile->xExtents[ pxFile->usExtentCount ] );
+            pxFile->usExtentCount++;
+        }
+        else
+        {
+            /* The map is full, forget the shortest run. */
+            pxExtent = &( pxFile->xExtents[ xShortest ] );
+        }
+
+        pxExtent->ulFileCluster = ulFileCluster;
+        pxExtent->ulCluster = ulCluster;
+        pxExtent->ulLength = ulLength;
+    }
+#endif /* ffconfigFILE_EXTENT_MAP */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigFILE_EXTENT_MAP != 0 )
+    static uint32_t prvFindExtent( const FF_FILE * pxFile,
+                                   uint32_t ulFileCluster,
+                                   uint32_t * pulRemaining )
+    {
+        const FF_FileExtent_t * pxExtent;
+        BaseType_t xIndex;
+        uint32_t ulReturn = 0ul;
+
+        *pulRemaining = 0ul;
+
+        for( xIndex = 0; xIndex < ( BaseType_t ) pxFile->usExtentCount; xIndex++ )
+        {
+            pxExtent = &( pxFile->xExtents[ xIndex ] );
+
+            if( ( ulFileCluster >= pxExtent->ulFileCluster ) &&
+                ( ulFileCluster < ( pxExtent->ulFileCluster + pxExtent->ulLength ) ) )
+            {
+                ulReturn = pxExtent->ulCluster + ( ulFileCluster - pxExtent->ulFileCluster );
+                *pulRemaining = ( pxExtent->ulFileCluster + pxExtent->ulLength ) - ulFileCluster - 1;
+                break;
+            }
+        }
+
+        return ulReturn;
+    }
+#endif /* ffconfigFILE_EXTENT_MAP */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigFILE_EXTENT_MAP != 0 )
+    static uint32_t prvMapFileCluster( FF_FILE * pxFile,
+                                       uint32_t ulFileCluster,
+                                       FF_Error_t * pxError )
+    {
+        FF_IOManager_t * pxIOManager = pxFile->pxIOManager;
+        FF_Error_t xError = FF_ERR_NONE;
+        FF_FATBuffers_t xFATBuffers;
+        const FF_FileExtent_t * pxExtent;
+        BaseType_t xIndex;
+        uint32_t ulIndex = 0ul;
+        uint32_t ulCluster = pxFile->ulObjectCluster;
+        uint32_t ulRunIndex, ulRunCluster;
+        uint32_t ulNextCluster;
+        uint32_t ulRemaining;
+
+        ulNextCluster = prvFindExtent( pxFile, ulFileCluster, &ulRemaining );
+
+        if( ulNextCluster != 0ul )
+        {
+            /* A hit, no need to access the FAT. */
+            *pxError = FF_ERR_NONE;
+
+            return ulNextCluster;
+        }
+
+        /* Start from the end of the closest run that lies before the target. */
+        for( xIndex = 0; xIndex < ( BaseType_t ) pxFile->usExtentCount; xIndex++ )
+        {
+            pxExtent = &( pxFile->xExtents[ xIndex ] );
+
+            if( ( ( pxExtent->ulFileCluster + pxExtent->ulLength - 1 ) < ulFileCluster ) &&
+                ( ( pxExtent->ulFileCluster + pxExtent->ulLength - 1 ) > ulIndex ) )
+            {
+                ulIndex = pxExtent->ulFileCluster + pxExtent->ulLength - 1;
+                ulCluster = pxExtent->ulCluster + pxExtent->ulLength - 1;
+            }
+        }
+
+        /* The current position might be closer. */
+        if( ( pxFile->ulCurrentCluster <= ulFileCluster ) &&
+            ( pxFile->ulCurrentCluster > ulIndex ) &&
+            ( pxFile->ulAddrCurrentCluster != 0ul ) )
+        {
+            ulIndex = pxFile->ulCurrentCluster;
+            ulCluster = pxFile->ulAddrCurrentCluster;
+        }
+
+        ulRunIndex = ulIndex;
+        ulRunCluster = ulCluster;
+
+        FF_InitFATBuffers( &xFATBuffers, FF_MODE_READ );
+        FF_LockFATShared( pxIOManager );
+        {
+            while( ulIndex < ulFileCluster )
+            {
+                ulNextCluster = FF_getFATEntry( pxIOManager, ulCluster, &xError, &xFATBuffers );
+
+                if( FF_isERR( xError ) || FF_isEndOfChain( pxIOManager, ulNextCluster ) )
+                {
+                    break;
+                }
+
+                if( ulNextCluster != ( ulCluster + 1 ) )
+                {
+                    /* The end of a run. */
+                    prvAddExtent( pxFile, ulRunIndex, ulRunCluster, ( ulIndex - ulRunIndex ) + 1 );
+                    ulRunIndex = ulIndex + 1;
+                    ulRunCluster = ulNextCluster;
+                }
+
+                ulCluster = ulNextCluster;
+                ulIndex++;
+            }
+        }
+        FF_UnlockFATShared( pxIOManager );
+
+        {
+            FF_Error_t xTempError;
+
+            xTempError = FF_ReleaseFATBuffers( pxIOManager, &xFATBuffers );
+
+            if( FF_isERR( xError ) == pdFALSE )
+            {
+                xError = xTempError;
+            }
+        }
+
+        if( FF_isERR( xError ) )
+        {
+            ulCluster = 0ul;
+        }
+        else
+        {
+            prvAddExtent( pxFile, ulRunIndex, ulRunCluster, ( ulIndex - ulRunIndex ) + 1 );
+        }
+
+        *pxError = xError;
+
+        return ulCluster;
+    }
+#endif /* ffconfigFILE_EXTENT_MAP */
+/*-----------------------------------------------------------*/
+
+static uint32_t prvClusterRun( FF_FILE * pxFile,
+                               uint32_t ulCount,
+                               FF_Error_t * pxError )
 {
-    uint32_t ulSectors;
     uint32_t ulSequentialClusters = 0;
-    uint32_t ulItemLBA;
-    FF_Error_t xError = FF_ERR_NONE;
 
-    while( ulCount != 0 )
+    *pxError = FF_ERR_NONE;
+
+    if( ulCount > 1U )
     {
-        if( ( ulCount - 1 ) > 0 )
+        #if ( ffconfigFILE_EXTENT_MAP != 0 )
+        {
+            uint32_t ulRemaining;
+
+            if( ( prvFindExtent( pxFile, pxFile->ulCurrentCluster, &ulRemaining ) == pxFile->ulAddrCurrentCluster ) &&
+                ( ulRemaining >= ( ulCount - 1 ) ) )
+            {
+                /* The map knows that the run is long enough. */
+                ulSequentialClusters = ulCount - 1;
+            }
+            else
+            {
+                ulSequentialClusters =
+                    FF_GetSequentialClusters( pxFile->pxIOManager, pxFile->ulAddrCurrentCluster, ulCount - 1, pxError );
+                prvAddExtent( pxFile, pxFile->ulCurrentCluster, pxFile->ulAddrCurrentCluster, ulSequentialClusters + 1 );
+            }
+        }
+        #else /* if ( ffconfigFILE_EXTENT_MAP != 0 ) */
         {
             ulSequentialClusters =
-                FF_GetSequentialClusters( pxFile->pxIOManager, pxFile->ulAddrCurrentCluster, ulCount - 1, &xError );
+                FF_GetSequentialClusters( pxFile->pxIOManager, pxFile->ulAddrCurrentCluster, ulCount - 1, pxError );
+        }
+        #endif /* if ( ffconfigFILE_EXTENT_MAP != 0 ) */
+    }
+
+    return ulSequentialClusters;
+} /* prvClusterRun() */
+/*-----------------------------------------------------------*/
+
+static FF_Error_t prvAdvanceClusters( FF_FILE * pxFile,
+                                      uint32_t ulClusters )
+{
+    FF_Error_t xError = FF_ERR_NONE;
+
+    #if ( ffconfigFILE_EXTENT_MAP != 0 )
+    {
+        pxFile->ulAddrCurrentCluster =
+            prvMapFileCluster( pxFile, pxFile->ulCurrentCluster + ulClusters, &xError );
+    }
+    #else
+    {
+        FF_LockFATShared( pxFile->pxIOManager );
+        {
+            pxFile->ulAddrCurrentCluster =
+                FF_TraverseFAT( pxFile->pxIOManager, pxFile->ulAddrCurrentCluster, ulClusters, &xError );
+        }
+        FF_UnlockFATShared( pxFile->pxIOManager );
+    }
+    #endif /* if ( ffconfigFILE_EXTENT_MAP != 0 ) */
+
+    if( FF_isERR( xError ) == pdFALSE )
+    {
+        pxFile->ulCurrentCluster += ulClusters;
+    }
+
+    return xError;
+} /* prvAdvanceClusters() */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+
+/* Returns pdTRUE when the clusters of this handle can be transferred with
+ * prvTransferClusters(). */
+    static BaseType_t prvCanSubmit( FF_FILE * pxFile )
+    {
+        BaseType_t xReturn = pdFALSE;
+
+        if( ( pxFile->pxIOManager->xBlkDevice.fnpSubmitBlocks != NULL ) &&
+            ( xTaskGetSchedulerState() == taskSCHEDULER_RUNNING ) )
+        {
+            if( pxFile->pvTransferDone == NULL )
+            {
+                pxFile->pvTransferDone = ( void * ) xSemaphoreCreateBinary();
+            }
+
+            /* Without a semaphore, the synchronous interface will be used. */
+            xReturn = ( pxFile->pvTransferDone != NULL ) ? pdTRUE : pdFALSE;
+        }
+
+        return xReturn;
+    } /* prvCanSubmit() */
+/*-----------------------------------------------------------*/
+
+    static FF_Error_t prvTransferClusters( FF_FILE * pxFile,
+                                           uint32_t ulCount,
+                                           uint8_t * pucBuffer,
+                                           BaseType_t xWrite )
+    {
+        FF_IOManager_t * pxIOManager = pxFile->pxIOManager;
+        FF_BlockRequest_t xRequest;
+        FF_Error_t xError;
+        int32_t lResult;
+        uint32_t ulSequentialClusters;
+
+        ulSequentialClusters = prvClusterRun( pxFile, ulCount, &xError );
+
+        while( ( ulCount != 0 ) && ( FF_isERR( xError ) == pdFALSE ) )
+        {
+            xRequest.pucBuffer = pucBuffer;
+            xRequest.ulCount = ( ulSequentialClusters + 1 ) * pxIOManager->xPartition.ulSectorsPerCluster;
+            xRequest.ulSectorAddress = FF_Cluster2LBA( pxIOManager, pxFile->ulAddrCurrentCluster );
+            xRequest.ulSectorAddress = FF_getRealLBA( pxIOManager, xRequest.ulSectorAddress );
+            xRequest.xWrite = xWrite;
+            xRequest.pvDone = pxFile->pvTransferDone;
+
+            /* The same precautions as prvWriteFileSectors() and prvReadFileSectors(). */
+            if( xWrite != pdFALSE )
+            {
+                FF_DiscardBuffers( pxIOManager, xRequest.ulSectorAddress, xRequest.ulCount );
+            }
+            else if( ( pxFile->ulValidFlags & FF_VALID_FLAG_CACHED ) != 0U )
+            {
+                xError = FF_FlushBuffers( pxIOManager, xRequest.ulSectorAddress, xRequest.ulCount );
+
+                if( FF_isERR( xError ) )
+                {
+                    break;
+                }
+            }
+
+            xError = FF_BlockSubmit( pxIOManager, &xRequest );
 
             if( FF_isERR( xError ) )
             {
                 break;
             }
+
+            /* While the driver is busy, find the next run. */
+            ulCount -= ulSequentialClusters + 1;
+            pucBuffer += xRequest.ulCount * pxIOManager->usSectorSize;
+            xError = prvAdvanceClusters( pxFile, ulSequentialClusters + 1 );
+
+            if( ( FF_isERR( xError ) == pdFALSE ) && ( ulCount != 0 ) )
+            {
+                ulSequentialClusters = prvClusterRun( pxFile, ulCount, &xError );
+            }
+
+            /* The buffer belongs to the driver until the transfer is done,
+             * also when the lookup failed. */
+            lResult = FF_BlockWait( &xRequest );
+
+            if( FF_isERR( lResult ) )
+            {
+                xError = lResult;
+            }
+        }
+
+        return xError;
+    } /* prvTransferClusters() */
+/*-----------------------------------------------------------*/
+#endif /* ffconfigASYNC_BLOCK_DEVICE */
+
+static FF_Error_t FF_ReadClusters( FF_FILE * pxFile,
+                                   uint32_t ulCount,
+                                   uint8_t * buffer )
+{
+    uint32_t ulSectors;
+    uint32_t ulSequentialClusters;
+    uint32_t ulItemLBA;
+    FF_Error_t xError = FF_ERR_NONE;
+
+    #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+    {
+        if( prvCanSubmit( pxFile ) != pdFALSE )
+        {
+            xError = prvTransferClusters( pxFile, ulCount, buffer, pdFALSE );
+
+            /* All clusters were transferred, skip the loop below. */
+            ulCount = 0;
+        }
+    }
+    #endif
+
+    while( ulCount != 0 )
+    {
+        ulSequentialClusters = prvClusterRun( pxFile, ulCount, &xError );
+
+        if( FF_isERR( xError ) )
+        {
+            break;
         }
 
         ulSectors = ( ulSequentialClusters + 1 ) * pxFile->pxIOManager->xPartition.ulSectorsPerCluster;
         ulItemLBA = FF_Cluster2LBA( pxFile->pxIOManager, pxFile->ulAddrCurrentCluster );
         ulItemLBA = FF_getRealLBA( pxFile->pxIOManager, ulItemLBA );
 
-        xError = FF_BlockRead( pxFile->pxIOManager, ulItemLBA, ulSectors, buffer, pdFALSE );
+        xError = prvReadFileSectors( pxFile, ulItemLBA, ulSectors, buffer );
 
         if( FF_isERR( xError ) )
         {
@@ -1303,21 +1759,14 @@ static FF_Error_t FF_ReadClusters( FF_FILE * pxFile,
 
         ulCount -= ( ulSequentialClusters + 1 );
 
-        FF_LockFAT( pxFile->pxIOManager );
-        {
-            pxFile->ulAddrCurrentCluster =
-                FF_TraverseFAT( pxFile->pxIOManager, pxFile->ulAddrCurrentCluster, ulSequentialClusters + 1, &xError );
-        }
-        FF_UnlockFAT( pxFile->pxIOManager );
+        xError = prvAdvanceClusters( pxFile, ulSequentialClusters + 1 );
 
         if( FF_isERR( xError ) )
         {
             break;
         }
 
-        pxFile->ulCurrentCluster += ( ulSequentialClusters + 1 );
         buffer += ulSectors * pxFile->pxIOManager->usSectorSize;
-        ulSequentialClusters = 0;
     }
 
     return xError;
@@ -1329,13 +1778,12 @@ static FF_Error_t FF_ExtendFile( FF_FILE * pxFile,
 {
     FF_IOManager_t * pxIOManager = pxFile->pxIOManager;
     uint32_t ulBytesPerCluster = pxIOManager->xPartition.usBlkSize * pxIOManager->xPartition.ulSectorsPerCluster;
-    uint32_t ulTotalClustersNeeded = ( ulSize + ulBytesPerCluster - 1 ) / ulBytesPerCluster;
+    /* Rounded up without adding to 'ulSize', which may be close to 4 GB. */
+    uint32_t ulTotalClustersNeeded = ( ulSize / ulBytesPerCluster ) + ( ( ( ulSize % ulBytesPerCluster ) != 0U ) ? 1U : 0U );
     uint32_t ulClusterToExtend;
-/* Initialise xIndex just for the compiler. */
-    BaseType_t xIndex = 0;
+    uint32_t ulAllocated = 0;
     FF_DirEnt_t xOriginalEntry;
     FF_Error_t xError = FF_ERR_NONE;
-    FF_FATBuffers_t xFATBuffers;
 
     if( ( pxFile->ucMode & FF_MODE_WRITE ) != FF_MODE_WRITE )
     {
@@ -1398,10 +1846,15 @@ static FF_Error_t FF_ExtendFile( FF_FILE * pxFile,
 
         if( FF_isERR( xError ) == pdFALSE )
         {
-            for( xIndex = 0; xIndex < ( BaseType_t ) ulClusterToExtend; xIndex++ )
+            uint32_t ulWindow = ffconfigFREE_EXTENT_WINDOW;
+
+            while( ulAllocated < ulClusterToExtend )
             {
-                /* In FF_ExtendFile() */
-                ulNextCluster = FF_FindFreeCluster( pxIOManager, &xError, pdTRUE );
+                uint32_t ulLength;
+
+                /* In FF_ExtendFile(): look for one run of free clusters, preferably
+                 * right after the current end of the chain. */
+                ulNextCluster = FF_FindFreeExtent( pxIOManager, ulCurrentCluster + 1, ulClusterToExtend - ulAllocated, ulWindow, &ulLength, &xError );
 
                 if( ( FF_isERR( xError ) == pdFALSE ) && ( ulNextCluster == 0UL ) )
                 {
@@ -1413,23 +1866,28 @@ static FF_Error_t FF_ExtendFile( FF_FILE * pxFile,
                     break;
                 }
 
-                /* Can not use this buffer earlier because of FF_FindEndOfChain/FF_FindFreeCluster */
-                FF_InitFATBuffers( &xFATBuffers, FF_MODE_WRITE );
-                xError = FF_putFATEntry( pxIOManager, ulCurrentCluster, ulNextCluster, &xFATBuffers );
-
-                if( FF_isERR( xError ) )
+                if( ulLength < ulClusterToExtend - ulAllocated )
                 {
-                    break;
+                    /* There is no run long enough, do not search for one again.
+                     * Allocate the rest first-fit. */
+                    ulWindow = 0ul;
                 }
 
-                xError = FF_ReleaseFATBuffers( pxIOManager, &xFATBuffers );
+                xError = FF_ClaimClusterExtent( pxIOManager, ulCurrentCluster, ulNextCluster, ulLength );
 
                 if( FF_isERR( xError ) )
                 {
                     break;
                 }
 
-                ulCurrentCluster = ulNextCluster;
+                #if ( ffconfigFILE_EXTENT_MAP != 0 )
+                {
+                    prvAddExtent( pxFile, pxFile->ulChainLength + ulAllocated, ulNextCluster, ulLength );
+                }
+                #endif
+
+                ulAllocated += ulLength;
+                ulCurrentCluster = ulNextCluster + ulLength - 1;
             }
 
             if( FF_isERR( xError ) == pdFALSE )
@@ -1437,14 +1895,14 @@ static FF_Error_t FF_ExtendFile( FF_FILE * pxFile,
                 pxFile->ulEndOfChain = ulCurrentCluster;
             }
 
-            pxFile->ulChainLength += xIndex;
+            pxFile->ulChainLength += ulAllocated;
         }
 
         FF_UnlockFAT( pxIOManager );
 
         {
             FF_Error_t xTempError;
-            xTempError = FF_DecreaseFreeClusters( pxIOManager, ( uint32_t ) xIndex ); /* Keep Tab of Numbers for fast FreeSize() */
+            xTempError = FF_DecreaseFreeClusters( pxIOManager, ulAllocated ); /* Keep Tab of Numbers for fast FreeSize() */
 
             if( FF_isERR( xError ) == pdFALSE )
             {
@@ -1491,12 +1949,12 @@ static FF_Error_t FF_ExtendFile( FF_FILE * pxFile,
                 pxFile->ulValidFlags |= FF_VALID_FLAG_EXTENDED;
                 FF_Error_t xTempError = FF_ERR_NONE;
                 uint32_t ulNewCluster = FF_getClusterChainNumber( pxIOManager, pxFile->ulFilePointer, 1 );
-                FF_LockFAT( pxIOManager );
+                FF_LockFATShared( pxIOManager );
                 {
                     pxFile->ulAddrCurrentCluster = FF_TraverseFAT( pxIOManager, pxFile->ulObjectCluster, ulNewCluster, &( xTempError ) );
                     pxFile->ulCurrentCluster = ulNewCluster;
                 }
-                FF_UnlockFAT( pxIOManager );
+                FF_UnlockFATShared( pxIOManager );
 
                 if( FF_isERR( xError ) == pdFALSE )
                 {
@@ -1515,32 +1973,37 @@ static FF_Error_t FF_WriteClusters( FF_FILE * pxFile,
                                     uint8_t * buffer )
 {
     uint32_t ulSectors;
-    uint32_t ulSequentialClusters = 0;
+    uint32_t ulSequentialClusters;
     uint32_t ulItemLBA;
     FF_Error_t xError = FF_ERR_NONE;
 
-    while( ulCount != 0 )
+    #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
     {
-        if( ulCount > 1U )
+        if( prvCanSubmit( pxFile ) != pdFALSE )
         {
-            ulSequentialClusters =
-                FF_GetSequentialClusters( pxFile->pxIOManager, pxFile->ulAddrCurrentCluster, ulCount - 1, &xError );
+            xError = prvTransferClusters( pxFile, ulCount, buffer, pdTRUE );
 
-            if( FF_isERR( xError ) )
-            {
-                break;
-            }
+            /* All clusters were transferred, skip the loop below. */
+            ulCount = 0;
         }
-        else
+    }
+    #endif
+
+    while( ulCount != 0 )
+    {
+        /* The last cluster is a run of its own. */
+        ulSequentialClusters = prvClusterRun( pxFile, ulCount, &xError );
+
+        if( FF_isERR( xError ) )
         {
-            /* Handling the last cluster which is a single one. */
+            break;
         }
 
         ulSectors = ( ulSequentialClusters + 1 ) * pxFile->pxIOManager->xPartition.ulSectorsPerCluster;
         ulItemLBA = FF_Cluster2LBA( pxFile->pxIOManager, pxFile->ulAddrCurrentCluster );
         ulItemLBA = FF_getRealLBA( pxFile->pxIOManager, ulItemLBA );
 
-        xError = FF_BlockWrite( pxFile->pxIOManager, ulItemLBA, ulSectors, buffer, pdFALSE );
+        xError = prvWriteFileSectors( pxFile->pxIOManager, ulItemLBA, ulSectors, buffer );
 
         if( FF_isERR( xError ) )
         {
@@ -1549,21 +2012,14 @@ static FF_Error_t FF_WriteClusters( FF_FILE * pxFile,
 
         ulCount -= ulSequentialClusters + 1;
 
-        FF_LockFAT( pxFile->pxIOManager );
-        {
-            pxFile->ulAddrCurrentCluster =
-                FF_TraverseFAT( pxFile->pxIOManager, pxFile->ulAddrCurrentCluster, ulSequentialClusters + 1, &xError );
-        }
-        FF_UnlockFAT( pxFile->pxIOManager );
+        xError = prvAdvanceClusters( pxFile, ulSequentialClusters + 1 );
 
         if( FF_isERR( xError ) )
         {
             break;
         }
 
-        pxFile->ulCurrentCluster += ( ulSequentialClusters + 1 );
         buffer += ulSectors * pxFile->pxIOManager->usSectorSize;
-        ulSequentialClusters = 0;
     }
 
     return xError;
@@ -1615,22 +2071,30 @@ static uint32_t FF_SetCluster( FF_FILE * pxFile,
     FF_Error_t xResult = FF_ERR_NONE;
     uint32_t ulReturn;
 
+    #if ( ffconfigFILE_EXTENT_MAP != 0 )
+        if( ulNewCluster != pxFile->ulCurrentCluster )
+        {
+            pxFile->ulAddrCurrentCluster = prvMapFileCluster( pxFile, ulNewCluster, &xResult );
+        }
+        else
+    #endif /* ffconfigFILE_EXTENT_MAP */
+
     if( ulNewCluster > pxFile->ulCurrentCluster )
     {
-        FF_LockFAT( pxIOManager );
+        FF_LockFATShared( pxIOManager );
         {
             pxFile->ulAddrCurrentCluster = FF_TraverseFAT( pxIOManager, pxFile->ulAddrCurrentCluster,
                                                            ulNewCluster - pxFile->ulCurrentCluster, &xResult );
         }
-        FF_UnlockFAT( pxIOManager );
+        FF_UnlockFATShared( pxIOManager );
     }
     else if( ulNewCluster < pxFile->ulCurrentCluster )
     {
-        FF_LockFAT( pxIOManager );
+        FF_LockFATShared( pxIOManager );
         {
             pxFile->ulAddrCurrentCluster = FF_TraverseFAT( pxIOManager, pxFile->ulObjectCluster, ulNewCluster, &xResult );
         }
-        FF_UnlockFAT( pxIOManager );
+        FF_UnlockFATShared( pxIOManager );
     }
     else
     {
@@ -1653,6 +2117,89 @@ static uint32_t FF_SetCluster( FF_FILE * pxFile,
 } /* FF_SetCluster() */
 /*-----------------------------------------------------------*/
 
+static int32_t prvReadFileSectors( FF_FILE * pxFile,
+                                   uint32_t ulItemLBA,
+                                   uint32_t ulSectors,
+                                   void * pvBuffer )
+{
+    int32_t lResult = FF_ERR_NONE;
+
+    /* The cache may hold a more recent copy of these sectors, but only when
+     * this handle wrote to them through the cache: no other handle can write
+     * to the file, and FF_Close() flushed the writes of earlier handles. */
+    if( ( pxFile->ulValidFlags & FF_VALID_FLAG_CACHED ) != 0U )
+    {
+        lResult = FF_FlushBuffers( pxFile->pxIOManager, ulItemLBA, ulSectors );
+    }
+
+    if( FF_isERR( lResult ) == pdFALSE )
+    {
+        lResult = FF_BlockRead( pxFile->pxIOManager, ulItemLBA, ulSectors, pvBuffer, pdFALSE );
+    }
+
+    return lResult;
+} /* prvReadFileSectors() */
+/*-----------------------------------------------------------*/
+
+static int32_t prvWriteFileSectors( FF_IOManager_t * pxIOManager,
+                                    uint32_t ulItemLBA,
+                                    uint32_t ulSectors,
+                                    void * pvBuffer )
+{
+    /* A cached copy of these sectors would be out of date. */
+    FF_DiscardBuffers( pxIOManager, ulItemLBA, ulSectors );
+
+    return FF_BlockWrite( pxIOManager, ulItemLBA, ulSectors, pvBuffer, pdFALSE );
+} /* prvWriteFileSectors() */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigREAD_AHEAD_SECTORS > 1 )
+    static void prvReadAhead( FF_FILE * pxFile,
+                              uint32_t ulItemLBA )
+    {
+        FF_IOManager_t * pxIOManager = pxFile->pxIOManager;
+        FF_Error_t xError = FF_ERR_NONE;
+        uint32_t ulBytesPerCluster = pxIOManager->xPartition.usBlkSize * pxIOManager->xPartition.ulSectorsPerCluster;
+        uint32_t ulSectorsPerCluster = ulBytesPerCluster / pxIOManager->usSectorSize;
+        uint32_t ulSectorStart = pxFile->ulFilePointer - ( pxFile->ulFilePointer % pxIOManager->usSectorSize );
+        uint32_t ulSectorsLeft;
+        uint32_t ulCount;
+
+        if( ( ulItemLBA == ( pxFile->ulLastReadLBA + 1 ) ) && ( ulSectorStart < pxFile->ulFileSize ) )
+        {
+            /* A sequential read: the rest of the current cluster can be read ahead. */
+            ulCount = ( ulBytesPerCluster - ( ulSectorStart % ulBytesPerCluster ) ) / pxIOManager->usSectorSize;
+            ulSectorsLeft = ( ( pxFile->ulFileSize - ulSectorStart ) + pxIOManager->usSectorSize - 1 ) / pxIOManager->usSectorSize;
+
+            /* FF_ReadAhead() reads at most ffconfigREAD_AHEAD_SECTORS at a time.
+             * When it reads in the background, it starts the next run while
+             * the caller uses the previous one, so twice as many are looked
+             * up. */
+            if( ( ulCount < ( 2U * ffconfigREAD_AHEAD_SECTORS ) ) && ( ulCount < ulSectorsLeft ) )
+            {
+                /* And so can the clusters that follow it on the disk. */
+                ulCount += ulSectorsPerCluster *
+                           FF_GetSequentialClusters( pxIOManager, pxFile->ulAddrCurrentCluster,
+                                                     ( ( 2U * ffconfigREAD_AHEAD_SECTORS ) - ulCount + ulSectorsPerCluster - 1 ) / ulSectorsPerCluster, &xError );
+            }
+
+            if( ulCount > ulSectorsLeft )
+            {
+                ulCount = ulSectorsLeft;
+            }
+
+            if( ( FF_isERR( xError ) == pdFALSE ) && ( ulCount > 1U ) )
+            {
+                /* An error will be seen again when the sector itself is read. */
+                ( void ) FF_ReadAhead( pxIOManager, ulItemLBA, ulCount );
+            }
+        }
+
+        pxFile->ulLastReadLBA = ulItemLBA;
+    } /* prvReadAhead() */
+/*-----------------------------------------------------------*/
+#endif /* ffconfigREAD_AHEAD_SECTORS */
+
 static uint32_t FF_ReadPartial( FF_FILE * pxFile,
                                 uint32_t ulItemLBA,
                                 uint32_t ulRelBlockPos,
@@ -1664,62 +2211,94 @@ static uint32_t FF_ReadPartial( FF_FILE * pxFile,
     uint32_t ulBytesRead;
 
     /* Bytes to read are within a block and less than a block size. */
-    #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 )
-    {
-        BaseType_t xLastRead;
-
-        /* Optimised method: each file handle holds one data block
-         * in cache: 'pxFile->pucBuffer'. */
-        /* See if the current block will be accessed after this read: */
-        if( ( ulRelBlockPos + ulCount ) >= ( uint32_t ) pxFile->pxIOManager->usSectorSize )
+    #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 )
+        if( pxFile->pucBuffer != NULL )
         {
-            /* After this read, ulFilePointer will point to the next block/sector. */
-            xLastRead = pdTRUE;
-        }
-        else
-        {
-            /* It is not the last read within this block/sector. */
-            xLastRead = pdFALSE;
-        }
+            BaseType_t xLastRead;
 
-        if( ( pxFile->ucState & FF_BUFSTATE_VALID ) == 0 )
-        {
-            xError = FF_BlockRead( pxFile->pxIOManager, ulItemLBA, 1, pxFile->pucBuffer, pdFALSE );
+            /* Optimised method: each file handle holds one data block
+             * in cache: 'pxFile->pucBuffer'. */
+            /* See if the current block will be accessed after this read: */
+            if( ( ulRelBlockPos + ulCount ) >= ( uint32_t ) pxFile->pxIOManager->usSectorSize )
+            {
+                /* After this read, ulFilePointer will point to the next block/sector. */
+                xLastRead = pdTRUE;
+            }
+            else
+            {
+                /* It is not the last read within this block/sector. */
+                xLastRead = pdFALSE;
+            }
 
-            if( FF_isERR( xError ) == pdFALSE )
+            if( ( pxFile->ucState & FF_BUFSTATE_VALID ) == 0 )
             {
-                pxFile->ucState = FF_BUFSTATE_VALID;
+                #if ( ffconfigREAD_AHEAD_SECTORS > 1 )
+                    if( ( pxFile->ucMode & FF_MODE_DIRECT ) == 0 )
+                    {
+                        FF_Buffer_t * pxBuffer;
+
+                        /* Go through the cache, which may hold the sectors read ahead. */
+                        prvReadAhead( pxFile, ulItemLBA );
+                        pxBuffer = FF_GetBuffer( pxFile->pxIOManager, ulItemLBA, FF_MODE_READ | FF_MODE_FILE_DATA );
+
+                        if( pxBuffer == NULL )
+                        {
+                            xError = FF_createERR( FF_ERR_DEVICE_DRIVER_FAILED, FF_READ );
+                        }
+                        else
+                        {
+                            memcpy( pxFile->pucBuffer, pxBuffer->pucBuffer, pxFile->pxIOManager->usSectorSize );
+                            xError = FF_ReleaseBuffer( pxFile->pxIOManager, pxBuffer );
+                        }
+                    }
+                    else
+                #endif /* ffconfigREAD_AHEAD_SECTORS */
+                {
+                    xError = prvReadFileSectors( pxFile, ulItemLBA, 1, pxFile->pucBuffer );
+                }
+
+                if( FF_isERR( xError ) == pdFALSE )
+                {
+                    pxFile->ucState = FF_BUFSTATE_VALID;
+                }
             }
-        }
 
-        if( ( pxFile->ucState & FF_BUFSTATE_VALID ) != 0 )
-        {
-            memcpy( pucBuffer, pxFile->pucBuffer + ulRelBlockPos, ulCount );
-            pxFile->ulFilePointer += ulCount;
-            ulBytesRead = ulCount;
+            if( ( pxFile->ucState & FF_BUFSTATE_VALID ) != 0 )
+            {
+                memcpy( pucBuffer, pxFile->pucBuffer + ulRelBlockPos, ulCount );
+                pxFile->ulFilePointer += ulCount;
+                ulBytesRead = ulCount;
 
-            if( ( xLastRead == pdTRUE ) && ( ( pxFile->ucState & FF_BUFSTATE_WRITTEN ) != 0 ) )
+                if( ( xLastRead == pdTRUE ) && ( ( pxFile->ucState & FF_BUFSTATE_WRITTEN ) != 0 ) )
+                {
+                    /* If the data was changed (file in 'update' mode), store the changes: */
+                    xError = prvWriteFileSectors( pxFile->pxIOManager, ulItemLBA, 1, pxFile->pucBuffer );
+                }
+            }
+            else
+            {
+                ulBytesRead = 0ul;
+            }
+
+            if( xLastRead == pdTRUE )
             {
-                /* If the data was changed (file in 'update' mode), store the changes: */
-                xError = FF_BlockWrite( pxFile->pxIOManager, ulItemLBA, 1, pxFile->pucBuffer, pdFALSE );
+                /* As the next FF_Read() will go passed the current block, invalidate the buffer now. */
+                pxFile->ucState = FF_BUFSTATE_INVALID;
             }
         }
         else
-        {
-            ulBytesRead = 0ul;
-        }
+    #endif /* if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 ) */
+    {
+        FF_Buffer_t * pxBuffer;
 
-        if( xLastRead == pdTRUE )
+        #if ( ffconfigREAD_AHEAD_SECTORS > 1 )
         {
-            /* As the next FF_Read() will go passed the current block, invalidate the buffer now. */
-            pxFile->ucState = FF_BUFSTATE_INVALID;
+            prvReadAhead( pxFile, ulItemLBA );
         }
-    }
-    #else /* if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) */
-    {
-        FF_Buffer_t * pxBuffer;
+        #endif
+
         /* Reading in the standard way, using FF_Buffer_t. */
-        pxBuffer = FF_GetBuffer( pxFile->pxIOManager, ulItemLBA, FF_MODE_READ );
+        pxBuffer = FF_GetBuffer( pxFile->pxIOManager, ulItemLBA, FF_MODE_READ | FF_MODE_FILE_DATA );
 
         if( pxBuffer == NULL )
         {
@@ -1737,7 +2316,6 @@ static uint32_t FF_ReadPartial( FF_FILE * pxFile,
             ulBytesRead = ulCount;
         }
     }
-    #endif /* if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) */
 
     *pxError = xError;
 
@@ -1864,7 +2442,7 @@ int32_t FF_Read( FF_FILE * pxFile,
                 }
 
                 ulSectors = pxIOManager->xPartition.ulSectorsPerCluster - ( ulRelClusterPos / pxIOManager->usSectorSize );
-                xError = FF_BlockRead( pxIOManager, ulItemLBA, ulSectors, pucBuffer, pdFALSE );
+                xError = prvReadFileSectors( pxFile, ulItemLBA, ulSectors, pucBuffer );
 
                 if( FF_isERR( xError ) )
                 {
@@ -1930,7 +2508,7 @@ int32_t FF_Read( FF_FILE * pxFile,
                     break;
                 }
 
-                xError = FF_BlockRead( pxIOManager, ulItemLBA, ulSectors, pucBuffer, pdFALSE );
+                xError = prvReadFileSectors( pxFile, ulItemLBA, ulSectors, pucBuffer );
 
                 if( FF_isERR( xError ) )
                 {
@@ -2131,70 +2709,76 @@ static uint32_t FF_WritePartial( FF_FILE * pxFile,
     FF_Error_t xError;
     uint32_t ulBytesWritten;
 
-    #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 )
-    {
-        BaseType_t xLastRead;
-
-        if( ( ulRelBlockPos + ulCount ) >= ( uint32_t ) pxFile->pxIOManager->usSectorSize )
+    #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 )
+        if( pxFile->pucBuffer != NULL )
         {
-            /* After this read, ulFilePointer will point to the next block/sector. */
-            xLastRead = pdTRUE;
-        }
-        else
-        {
-            /* It is not the last read within this block/sector. */
-            xLastRead = pdFALSE;
-        }
+            BaseType_t xLastRead;
 
-        if( ( ( pxFile->ucState & FF_BUFSTATE_VALID ) == 0 ) &&
-            ( ( ulRelBlockPos != 0 ) || ( pxFile->ulFilePointer < pxFile->ulFileSize ) ) )
-        {
-            xError = FF_BlockRead( pxFile->pxIOManager, ulItemLBA, 1, pxFile->pucBuffer, pdFALSE );
-            /* pxFile->ucState will be set later on. */
-        }
-        else
-        {
-            xError = FF_ERR_NONE;
+            if( ( ulRelBlockPos + ulCount ) >= ( uint32_t ) pxFile->pxIOManager->usSectorSize )
+            {
+                /* After this read, ulFilePointer will point to the next block/sector. */
+                xLastRead = pdTRUE;
+            }
+            else
+            {
+                /* It is not the last read within this block/sector. */
+                xLastRead = pdFALSE;
+            }
 
-            /* the buffer is valid or a whole block/sector will be written, so it is
-             * not necessary to read the contents first. */
-        }
+            if( ( ( pxFile->ucState & FF_BUFSTATE_VALID ) == 0 ) &&
+                ( ( ulRelBlockPos != 0 ) || ( pxFile->ulFilePointer < pxFile->ulFileSize ) ) )
+            {
+                xError = prvReadFileSectors( pxFile, ulItemLBA, 1, pxFile->pucBuffer );
+                /* pxFile->ucState will be set later on. */
+            }
+            else
+            {
+                xError = FF_ERR_NONE;
 
-        if( FF_isERR( xError ) == pdFALSE )
-        {
-            memcpy( pxFile->pucBuffer + ulRelBlockPos, pucBuffer, ulCount );
+                /* the buffer is valid or a whole block/sector will be written, so it is
+                 * not necessary to read the contents first. */
+            }
 
-            if( xLastRead == pdTRUE )
+            if( FF_isERR( xError ) == pdFALSE )
             {
-                xError = FF_BlockWrite( pxFile->pxIOManager, ulItemLBA, 1, pxFile->pucBuffer, pdFALSE );
-                pxFile->ucState = FF_BUFSTATE_INVALID;
+                memcpy( pxFile->pucBuffer + ulRelBlockPos, pucBuffer, ulCount );
+
+                if( xLastRead == pdTRUE )
+                {
+                    xError = prvWriteFileSectors( pxFile->pxIOManager, ulItemLBA, 1, pxFile->pucBuffer );
+                    pxFile->ucState = FF_BUFSTATE_INVALID;
+                }
+                else
+                {
+                    pxFile->ucState |= FF_BUFSTATE_WRITTEN | FF_BUFSTATE_VALID;
+                }
             }
             else
             {
-                pxFile->ucState |= FF_BUFSTATE_WRITTEN | FF_BUFSTATE_VALID;
+                pxFile->ucState = FF_BUFSTATE_INVALID;
             }
         }
         else
-        {
-            pxFile->ucState = FF_BUFSTATE_INVALID;
-        }
-    }
-    #else /* if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) */
+    #endif /* if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 ) */
     {
         FF_Buffer_t * pxBuffer;
 
         if( ( ulRelBlockPos == 0 ) && ( pxFile->ulFilePointer >= pxFile->ulFileSize ) )
         {
             /* An entire sector will be written. */
-            pxBuffer = FF_GetBuffer( pxFile->pxIOManager, ulItemLBA, FF_MODE_WR_ONLY );
+            pxBuffer = FF_GetBuffer( pxFile->pxIOManager, ulItemLBA, FF_MODE_WR_ONLY | FF_MODE_FILE_DATA );
         }
         else
         {
             /* A partial write will be done, make sure to read the contents before
              * changing anything. */
-            pxBuffer = FF_GetBuffer( pxFile->pxIOManager, ulItemLBA, FF_MODE_WRITE );
+            pxBuffer = FF_GetBuffer( pxFile->pxIOManager, ulItemLBA, FF_MODE_WRITE | FF_MODE_FILE_DATA );
         }
 
+        /* From now on the cache may hold data of the file that is newer than
+         * the disk, see prvReadFileSectors(). */
+        pxFile->ulValidFlags |= FF_VALID_FLAG_CACHED;
+
         if( pxBuffer == NULL )
         {
             xError = FF_createERR( FF_ERR_DEVICE_DRIVER_FAILED, FF_WRITE );
@@ -2207,7 +2791,6 @@ static uint32_t FF_WritePartial( FF_FILE * pxFile,
             xError = FF_ReleaseBuffer( pxFile->pxIOManager, pxBuffer );
         }
     }
-    #endif /* if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) */
 
     if( FF_isERR( xError ) == pdFALSE )
     {
@@ -2230,84 +2813,75 @@ static uint32_t FF_WritePartial( FF_FILE * pxFile,
 } /* FF_WritePartial() */
 /*-----------------------------------------------------------*/
 
-/**
- *	@brief	Writes data to a File.
- *
- *	@param	pxFile			FILE Pointer.
- *	@param	ulElementSize		Size of an Element of Data to be copied. (in bytes).
- *	@param	ulCount			Number of Elements of Data to be copied. (ulElementSize * ulCount must not exceed ((2^31)-1) bytes. (2GB). For best performance, multiples of 512 bytes or Cluster sizes are best.
- *	@param	pucBuffer			Byte-wise pucBuffer containing the data to be written.
- *
- * FF_Read() and FF_Write() work very similar. They both complete their task in 5 steps:
- *	1. Write bytes up to a sector border:  FF_WritePartial()
- *	2. Write sectors up to cluster border: FF_BlockWrite()
- *	3. Write complete clusters:            FF_WriteClusters()
- *	4. Write remaining sectors:            FF_BlockWrite()
- *	5. Write remaining bytes:              FF_WritePartial()
- *	@return FF_ERR_NONE when success, otherwise one of FF_ERR_* when failure
- **/
-int32_t FF_Write( FF_FILE * pxFile,
-                  uint32_t ulElementSize,
-                  uint32_t ulCount,
-                  uint8_t * pucBuffer )
+/* Write 'ulBytesLeft' bytes at the current position of a file that is
+ * valid and opened for writing.  The file is extended when necessary. */
+static uint32_t prvWriteData( FF_FILE * pxFile,
+                              uint32_t ulBytesLeft,
+                              uint8_t * pucBuffer,
+                              FF_Error_t * pxError )
 {
-    uint32_t ulBytesLeft = ulElementSize * ulCount;
+    FF_IOManager_t * pxIOManager = pxFile->pxIOManager;
     uint32_t nBytesWritten = 0;
     uint32_t nBytesToWrite;
-    FF_IOManager_t * pxIOManager;
     uint32_t ulRelBlockPos;
     uint32_t ulItemLBA;
-    int32_t lResult;
     uint32_t ulSectors;
     uint32_t ulRelClusterPos;
     uint32_t ulBytesPerCluster;
-    FF_Error_t xError;
+    FF_Error_t xError = FF_ERR_NONE;
 
-    if( pxFile == NULL )
-    {
-        xError = FF_createERR( FF_ERR_NULL_POINTER, FF_READ );
-    }
-    else
+    /* Open a do{} while( 0 ) loop to allow the use of breaks */
+    do
     {
-        /* Check validity of the handle and the current position within the file. */
-        xError = FF_CheckValid( pxFile );
+        /* Extend File for at least ulBytesLeft!
+         * Handle file-space allocation
+         + 1 byte because the code assumes there is always a next cluster */
+        xError = FF_ExtendFile( pxFile, pxFile->ulFilePointer + ulBytesLeft + 1 );
 
-        if( FF_isERR( xError ) == pdFALSE )
+        if( FF_isERR( xError ) )
         {
-            if( ( pxFile->ucMode & FF_MODE_WRITE ) == 0 )
-            {
-                xError = FF_createERR( FF_ERR_FILE_NOT_OPENED_IN_WRITE_MODE, FF_WRITE );
-            }
-            /* Make sure a write is after the append point. */
-            else if( ( pxFile->ucMode & FF_MODE_APPEND ) != 0 )
-            {
-                if( pxFile->ulFilePointer < pxFile->ulFileSize )
-                {
-                    xError = FF_Seek( pxFile, 0, FF_SEEK_END );
-                }
-            }
+            /* On every error, break from the while( 0 ) loop. */
+            break;
         }
-    }
 
-    if( FF_isERR( xError ) == pdFALSE )
-    {
-        pxIOManager = pxFile->pxIOManager;
+        ulRelBlockPos = FF_getMinorBlockEntry( pxIOManager, pxFile->ulFilePointer, 1 ); /* Get the position within a block. */
+        ulItemLBA = FF_SetCluster( pxFile, &xError );
 
-        /* Open a do{} while( 0 ) loop to allow the use of breaks */
-        do
+        if( FF_isERR( xError ) )
         {
-            /* Extend File for at least ulBytesLeft!
-             * Handle file-space allocation
-             + 1 byte because the code assumes there is always a next cluster */
-            xError = FF_ExtendFile( pxFile, pxFile->ulFilePointer + ulBytesLeft + 1 );
+            break;
+        }
+
+        if( ( ulRelBlockPos + ulBytesLeft ) <= ( uint32_t ) pxIOManager->usSectorSize )
+        {
+            /* Bytes to write are within a block and and do not go passed the current block. */
+            nBytesWritten = FF_WritePartial( pxFile, ulItemLBA, ulRelBlockPos, ulBytesLeft, pucBuffer, &xError );
+            break;
+        }
+
+        /*---------- Write (memcpy) to a Sector Boundary. */
+        if( ulRelBlockPos != 0 )
+        {
+            /* Not writing on a sector boundary, at this point the LBA is known. */
+            nBytesToWrite = pxIOManager->usSectorSize - ulRelBlockPos;
+            nBytesWritten = FF_WritePartial( pxFile, ulItemLBA, ulRelBlockPos, nBytesToWrite, pucBuffer, &xError );
 
             if( FF_isERR( xError ) )
             {
-                /* On every error, break from the while( 0 ) loop. */
                 break;
             }
 
-            ulRelBlockPos = FF_getMinorBlockEntry( pxIOManager, pxFile->ulFilePointer, 1 ); /* Get the position within a block. */
+            ulBytesLeft -= nBytesWritten;
+            pucBuffer += nBytesWritten;
+        }
+
+        /*---------- Write sectors, up to a Cluster Boundary. */
+        ulBytesPerCluster = ( pxIOManager->xPartition.ulSectorsPerCluster * pxIOManager->usSectorSize );
+        ulRelClusterPos = FF_getClusterPosition( pxIOManager, pxFile->ulFilePointer, 1 );
+
+        if( ( ulRelClusterPos != 0 ) && ( ( ulRelClusterPos + ulBytesLeft ) >= ulBytesPerCluster ) )
+        {
+            /* Need to get to cluster boundary */
             ulItemLBA = FF_SetCluster( pxFile, &xError );
 
             if( FF_isERR( xError ) )
@@ -2315,160 +2889,271 @@ int32_t FF_Write( FF_FILE * pxFile,
                 break;
             }
 
-            if( ( ulRelBlockPos + ulBytesLeft ) <= ( uint32_t ) pxIOManager->usSectorSize )
+            ulSectors = pxIOManager->xPartition.ulSectorsPerCluster - ( ulRelClusterPos / pxIOManager->usSectorSize );
+            xError = prvWriteFileSectors( pxIOManager, ulItemLBA, ulSectors, pucBuffer );
+
+            if( FF_isERR( xError ) )
             {
-                /* Bytes to write are within a block and and do not go passed the current block. */
-                nBytesWritten = FF_WritePartial( pxFile, ulItemLBA, ulRelBlockPos, ulBytesLeft, pucBuffer, &xError );
                 break;
             }
 
-            /*---------- Write (memcpy) to a Sector Boundary. */
-            if( ulRelBlockPos != 0 )
+            nBytesToWrite = ulSectors * pxIOManager->usSectorSize;
+            ulBytesLeft -= nBytesToWrite;
+            pucBuffer += nBytesToWrite;
+            nBytesWritten += nBytesToWrite;
+            pxFile->ulFilePointer += nBytesToWrite;
+
+            if( pxFile->ulFilePointer > pxFile->ulFileSize )
             {
-                /* Not writing on a sector boundary, at this point the LBA is known. */
-                nBytesToWrite = pxIOManager->usSectorSize - ulRelBlockPos;
-                nBytesWritten = FF_WritePartial( pxFile, ulItemLBA, ulRelBlockPos, nBytesToWrite, pucBuffer, &xError );
+                pxFile->ulFileSize = pxFile->ulFilePointer;
+            }
+        }
 
-                if( FF_isERR( xError ) )
-                {
-                    break;
-                }
+        /*---------- Write entire Clusters. */
+        if( ulBytesLeft >= ulBytesPerCluster )
+        {
+            uint32_t ulClusters;
 
-                ulBytesLeft -= nBytesWritten;
-                pucBuffer += nBytesWritten;
+            FF_SetCluster( pxFile, &xError );
+
+            if( FF_isERR( xError ) )
+            {
+                break;
             }
 
-            /*---------- Write sectors, up to a Cluster Boundary. */
-            ulBytesPerCluster = ( pxIOManager->xPartition.ulSectorsPerCluster * pxIOManager->usSectorSize );
-            ulRelClusterPos = FF_getClusterPosition( pxIOManager, pxFile->ulFilePointer, 1 );
+            ulClusters = ( ulBytesLeft / ulBytesPerCluster );
 
-            if( ( ulRelClusterPos != 0 ) && ( ( ulRelClusterPos + ulBytesLeft ) >= ulBytesPerCluster ) )
+            xError = FF_WriteClusters( pxFile, ulClusters, pucBuffer );
+
+            if( FF_isERR( xError ) )
             {
-                /* Need to get to cluster boundary */
-                ulItemLBA = FF_SetCluster( pxFile, &xError );
+                break;
+            }
 
-                if( FF_isERR( xError ) )
-                {
-                    break;
-                }
+            nBytesToWrite = ulBytesPerCluster * ulClusters;
+            ulBytesLeft -= nBytesToWrite;
+            pucBuffer += nBytesToWrite;
+            nBytesWritten += nBytesToWrite;
+            pxFile->ulFilePointer += nBytesToWrite;
 
-                ulSectors = pxIOManager->xPartition.ulSectorsPerCluster - ( ulRelClusterPos / pxIOManager->usSectorSize );
-                xError = FF_BlockWrite( pxIOManager, ulItemLBA, ulSectors, pucBuffer, pdFALSE );
+            if( pxFile->ulFilePointer > pxFile->ulFileSize )
+            {
+                pxFile->ulFileSize = pxFile->ulFilePointer;
+            }
+        }
 
-                if( FF_isERR( xError ) )
+        /*---------- Write Remaining Blocks */
+        while( ulBytesLeft >= ( uint32_t ) pxIOManager->usSectorSize )
+        {
+            ulSectors = ulBytesLeft / pxIOManager->usSectorSize;
+            {
+                /* HT: I'd leave these pPart/ulOffset for readability... */
+                FF_Partition_t * pPart = &( pxIOManager->xPartition );
+                uint32_t ulOffset = ( pxFile->ulFilePointer / pxIOManager->usSectorSize ) % pPart->ulSectorsPerCluster;
+                uint32_t ulRemain = pPart->ulSectorsPerCluster - ulOffset;
+
+                if( ulSectors > ulRemain )
                 {
-                    break;
+                    ulSectors = ulRemain;
                 }
+            }
 
-                nBytesToWrite = ulSectors * pxIOManager->usSectorSize;
-                ulBytesLeft -= nBytesToWrite;
-                pucBuffer += nBytesToWrite;
-                nBytesWritten += nBytesToWrite;
-                pxFile->ulFilePointer += nBytesToWrite;
+            ulItemLBA = FF_SetCluster( pxFile, &xError );
 
-                if( pxFile->ulFilePointer > pxFile->ulFileSize )
-                {
-                    pxFile->ulFileSize = pxFile->ulFilePointer;
-                }
+            if( FF_isERR( xError ) )
+            {
+                break;
             }
 
-            /*---------- Write entire Clusters. */
-            if( ulBytesLeft >= ulBytesPerCluster )
+            xError = prvWriteFileSectors( pxIOManager, ulItemLBA, ulSectors, pucBuffer );
+
+            if( FF_isERR( xError ) )
             {
-                uint32_t ulClusters;
+                break;
+            }
+
+            nBytesToWrite = ulSectors * pxIOManager->usSectorSize;
+            ulBytesLeft -= nBytesToWrite;
+            pucBuffer += nBytesToWrite;
+            nBytesWritten += nBytesToWrite;
+            pxFile->ulFilePointer += nBytesToWrite;
+
+            if( pxFile->ulFilePointer > pxFile->ulFileSize )
+            {
+                pxFile->ulFileSize = pxFile->ulFilePointer;
+            }
+        }
+
+        if( FF_isERR( xError ) )
+        {
+            break;
+        }
+
+        /*---------- Write (memcpy) Remaining Bytes */
+        if( ulBytesLeft == 0 )
+        {
+            break;
+        }
+
+        ulItemLBA = FF_SetCluster( pxFile, &xError );
+
+        if( FF_isERR( xError ) )
+        {
+            break;
+        }
 
-                FF_SetCluster( pxFile, &xError );
+        FF_WritePartial( pxFile, ulItemLBA, 0, ulBytesLeft, pucBuffer, &xError );
+        nBytesWritten += ulBytesLeft;
+    }
+    while( pdFALSE );
 
-                if( FF_isERR( xError ) )
-                {
-                    break;
-                }
+    *pxError = xError;
 
-                ulClusters = ( ulBytesLeft / ulBytesPerCluster );
+    return nBytesWritten;
+} /* prvWriteData() */
+/*-----------------------------------------------------------*/
 
-                xError = FF_WriteClusters( pxFile, ulClusters, pucBuffer );
+#if ( ffconfigDELAYED_ALLOCATION != 0 )
 
-                if( FF_isERR( xError ) )
-                {
-                    break;
-                }
+/* Called when data is written to a file.  Data appended to the end of the
+ * file is collected in 'pucDelayedData' without allocating clusters for it.
+ * Returns pdTRUE when the data was stored, or pdFALSE when the caller must
+ * write it.  While data is pending, the file pointer is at the end of the
+ * file, so any read returns zero bytes and does not need the data. */
+    static BaseType_t prvDelayWrite( FF_FILE * pxFile,
+                                     const uint8_t * pucSource,
+                                     uint32_t ulCount,
+                                     FF_Error_t * pxError )
+    {
+        BaseType_t xDelayed = pdFALSE;
+        FF_Error_t xError = FF_ERR_NONE;
 
-                nBytesToWrite = ulBytesPerCluster * ulClusters;
-                ulBytesLeft -= nBytesToWrite;
-                pucBuffer += nBytesToWrite;
-                nBytesWritten += nBytesToWrite;
-                pxFile->ulFilePointer += nBytesToWrite;
+        if( ( pxFile->ulDelayedLength + ulCount ) > ( uint32_t ) ffconfigDELAYED_ALLOCATION )
+        {
+            /* The data does not fit, write what is collected so far. */
+            xError = prvFlushDelayedData( pxFile );
+        }
 
-                if( pxFile->ulFilePointer > pxFile->ulFileSize )
-                {
-                    pxFile->ulFileSize = pxFile->ulFilePointer;
-                }
+        if( ( FF_isERR( xError ) == pdFALSE ) &&
+            ( ( pxFile->ucMode & FF_MODE_DIRECT ) == 0 ) &&
+            ( pxFile->ulFilePointer == pxFile->ulFileSize ) &&
+            ( ( pxFile->ulDelayedLength + ulCount ) <= ( uint32_t ) ffconfigDELAYED_ALLOCATION ) )
+        {
+            if( pxFile->pucDelayedData == NULL )
+            {
+                pxFile->pucDelayedData = ( uint8_t * ) ffconfigMALLOC( ffconfigDELAYED_ALLOCATION );
             }
 
-            /*---------- Write Remaining Blocks */
-            while( ulBytesLeft >= ( uint32_t ) pxIOManager->usSectorSize )
+            /* When there is not enough memory, the data is written at once. */
+            if( pxFile->pucDelayedData != NULL )
             {
-                ulSectors = ulBytesLeft / pxIOManager->usSectorSize;
-                {
-                    /* HT: I'd leave these pPart/ulOffset for readability... */
-                    FF_Partition_t * pPart = &( pxIOManager->xPartition );
-                    uint32_t ulOffset = ( pxFile->ulFilePointer / pxIOManager->usSectorSize ) % pPart->ulSectorsPerCluster;
-                    uint32_t ulRemain = pPart->ulSectorsPerCluster - ulOffset;
+                memcpy( pxFile->pucDelayedData + pxFile->ulDelayedLength, pucSource, ulCount );
+                pxFile->ulDelayedLength += ulCount;
+                pxFile->ulFilePointer += ulCount;
+                pxFile->ulFileSize = pxFile->ulFilePointer;
+                xDelayed = pdTRUE;
+            }
+        }
 
-                    if( ulSectors > ulRemain )
-                    {
-                        ulSectors = ulRemain;
-                    }
-                }
+        *pxError = xError;
 
-                ulItemLBA = FF_SetCluster( pxFile, &xError );
+        return xDelayed;
+    }
+/*-----------------------------------------------------------*/
 
-                if( FF_isERR( xError ) )
-                {
-                    break;
-                }
+/* Write the data collected by prvDelayWrite().  The file pointer goes back to
+ * where the data starts, and FF_ExtendFile() claims the clusters for all of
+ * it in one go. */
+    static FF_Error_t prvFlushDelayedData( FF_FILE * pxFile )
+    {
+        FF_Error_t xError = FF_ERR_NONE;
+        uint32_t ulLength = pxFile->ulDelayedLength;
 
-                xError = FF_BlockWrite( pxIOManager, ulItemLBA, ulSectors, pucBuffer, pdFALSE );
+        if( ulLength != 0U )
+        {
+            pxFile->ulDelayedLength = 0U;
+            pxFile->ulFileSize -= ulLength;
+            pxFile->ulFilePointer = pxFile->ulFileSize;
 
-                if( FF_isERR( xError ) )
-                {
-                    break;
-                }
+            ( void ) prvWriteData( pxFile, ulLength, pxFile->pucDelayedData, &xError );
+        }
 
-                nBytesToWrite = ulSectors * pxIOManager->usSectorSize;
-                ulBytesLeft -= nBytesToWrite;
-                pucBuffer += nBytesToWrite;
-                nBytesWritten += nBytesToWrite;
-                pxFile->ulFilePointer += nBytesToWrite;
+        return xError;
+    }
+/*-----------------------------------------------------------*/
 
-                if( pxFile->ulFilePointer > pxFile->ulFileSize )
-                {
-                    pxFile->ulFileSize = pxFile->ulFilePointer;
-                }
-            }
+#endif /* ffconfigDELAYED_ALLOCATION */
 
-            if( FF_isERR( xError ) )
+/**
+ *	@brief	Writes data to a File.
+ *
+ *	@param	pxFile			FILE Pointer.
+ *	@param	ulElementSize		Size of an Element of Data to be copied. (in bytes).
+ *	@param	ulCount			Number of Elements of Data to be copied. (ulElementSize * ulCount must not exceed ((2^31)-1) bytes. (2GB). For best performance, multiples of 512 bytes or Cluster sizes are best.
+ *	@param	pucBuffer			Byte-wise pucBuffer containing the data to be written.
+ *
+ * FF_Read() and FF_Write() work very similar. They both complete their task in 5 steps:
+ *	1. Write bytes up to a sector border:  FF_WritePartial()
+ *	2. Write sectors up to cluster border: FF_BlockWrite()
+ *	3. Write complete clusters:            FF_WriteClusters()
+ *	4. Write remaining sectors:            FF_BlockWrite()
+ *	5. Write remaining bytes:              FF_WritePartial()
+ *	@return FF_ERR_NONE when success, otherwise one of FF_ERR_* when failure
+ **/
+int32_t FF_Write( FF_FILE * pxFile,
+                  uint32_t ulElementSize,
+                  uint32_t ulCount,
+                  uint8_t * pucBuffer )
+{
+    uint32_t ulBytesLeft = ulElementSize * ulCount;
+    uint32_t nBytesWritten = 0;
+    int32_t lResult;
+    BaseType_t xDelayed = pdFALSE;
+    FF_Error_t xError;
+
+    if( pxFile == NULL )
+    {
+        xError = FF_createERR( FF_ERR_NULL_POINTER, FF_READ );
+    }
+    else
+    {
+        /* Check validity of the handle and the current position within the file. */
+        xError = FF_CheckValid( pxFile );
+
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            if( ( pxFile->ucMode & FF_MODE_WRITE ) == 0 )
             {
-                break;
+                xError = FF_createERR( FF_ERR_FILE_NOT_OPENED_IN_WRITE_MODE, FF_WRITE );
             }
-
-            /*---------- Write (memcpy) Remaining Bytes */
-            if( ulBytesLeft == 0 )
+            /* Make sure a write is after the append point. */
+            else if( ( pxFile->ucMode & FF_MODE_APPEND ) != 0 )
             {
-                break;
+                if( pxFile->ulFilePointer < pxFile->ulFileSize )
+                {
+                    xError = FF_Seek( pxFile, 0, FF_SEEK_END );
+                }
             }
+        }
+    }
 
-            ulItemLBA = FF_SetCluster( pxFile, &xError );
+    #if ( ffconfigDELAYED_ALLOCATION != 0 )
+    {
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            xDelayed = prvDelayWrite( pxFile, pucBuffer, ulBytesLeft, &xError );
 
-            if( FF_isERR( xError ) )
+            if( xDelayed != pdFALSE )
             {
-                break;
+                nBytesWritten = ulBytesLeft;
             }
-
-            FF_WritePartial( pxFile, ulItemLBA, 0, ulBytesLeft, pucBuffer, &xError );
-            nBytesWritten += ulBytesLeft;
         }
-        while( pdFALSE );
+    }
+    #endif /* ffconfigDELAYED_ALLOCATION */
+
+    if( ( FF_isERR( xError ) == pdFALSE ) && ( xDelayed == pdFALSE ) )
+    {
+        nBytesWritten = prvWriteData( pxFile, ulBytesLeft, pucBuffer, &xError );
     }
 
     if( FF_isERR( xError ) )
@@ -2528,6 +3213,21 @@ int32_t FF_PutC( FF_FILE * pxFile,
                 }
             }
 
+            #if ( ffconfigDELAYED_ALLOCATION != 0 )
+            {
+                if( prvDelayWrite( pxFile, &ucValue, 1U, &xResult ) != pdFALSE )
+                {
+                    xResult = ( FF_Error_t ) ucValue;
+                    break;
+                }
+
+                if( FF_isERR( xResult ) )
+                {
+                    break;
+                }
+            }
+            #endif /* ffconfigDELAYED_ALLOCATION */
+
             ulRelBlockPos = FF_getMinorBlockEntry( pxFile->pxIOManager, pxFile->ulFilePointer, 1 );
 
             /* Handle File Space Allocation. */
@@ -2581,11 +3281,27 @@ FF_Error_t FF_Seek( FF_FILE * pxFile,
 
     xError = FF_CheckValid( pxFile );
 
+    #if ( ffconfigDELAYED_ALLOCATION != 0 )
+    {
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            /* The file pointer may leave the end of the file. */
+            xError = prvFlushDelayedData( pxFile );
+        }
+    }
+    #endif
+
     if( FF_isERR( xError ) == pdFALSE )
     {
         xError = FF_FlushCache( pxFile->pxIOManager );
 
-        #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 )
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            /* The data written through the cache is on the disk now. */
+            pxFile->ulValidFlags &= ~FF_VALID_FLAG_CACHED;
+        }
+
+        #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 )
         {
             if( FF_isERR( xError ) == pdFALSE )
             {
@@ -2593,13 +3309,13 @@ FF_Error_t FF_Seek( FF_FILE * pxFile,
                  * write buffer that this is written to disk. */
                 if( ( pxFile->ucState & FF_BUFSTATE_WRITTEN ) != 0 )
                 {
-                    xError = FF_BlockWrite( pxFile->pxIOManager, FF_FileLBA( pxFile ), 1, pxFile->pucBuffer, pdFALSE );
+                    xError = prvWriteFileSectors( pxFile->pxIOManager, FF_FileLBA( pxFile ), 1, pxFile->pucBuffer );
                 }
 
                 pxFile->ucState = FF_BUFSTATE_INVALID;
             }
         }
-        #endif /* ffconfigOPTIMISE_UNALIGNED_ACCESS */
+        #endif /* ffconfigOPTIMISE_UNALIGNED_ACCESS || ffconfigDIRECT_IO */
 
         if( FF_isERR( xError ) == pdFALSE )
         {
@@ -3058,6 +3774,7 @@ FF_Error_t FF_Close( FF_FILE * pxFile )
     FF_FILE * pxFileChain;
     FF_DirEnt_t xOriginalEntry;
     FF_Error_t xError;
+    FF_Error_t xFlushError = FF_ERR_NONE;
 
     /* Opening a do {} while( 0 )  loop to allow the use of the break statement. */
     do
@@ -3100,11 +3817,30 @@ FF_Error_t FF_Close( FF_FILE * pxFile )
                 } /* Semaphore released, linked list was shortened! */
 
                 FF_ReleaseSemaphore( pxFile->pxIOManager->pvSemaphore );
-                #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 )
+                #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 )
                 {
-                    ffconfigFREE( pxFile->pucBuffer );
+                    if( pxFile->pucBuffer != NULL )
+                    {
+                        ffconfigFREE( pxFile->pucBuffer );
+                    }
                 }
-                #endif /* ffconfigOPTIMISE_UNALIGNED_ACCESS */
+                #endif /* ffconfigOPTIMISE_UNALIGNED_ACCESS || ffconfigDIRECT_IO */
+                #if ( ffconfigDELAYED_ALLOCATION != 0 )
+                {
+                    if( pxFile->pucDelayedData != NULL )
+                    {
+                        ffconfigFREE( pxFile->pucDelayedData );
+                    }
+                }
+                #endif
+                #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+                {
+                    if( pxFile->pvTransferDone != NULL )
+                    {
+                        vSemaphoreDelete( ( SemaphoreHandle_t ) pxFile->pvTransferDone );
+                    }
+                }
+                #endif
                 ffconfigFREE( pxFile ); /* So at least we have freed the pointer. */
                 xError = FF_ERR_NONE;
                 break;
@@ -3126,14 +3862,30 @@ FF_Error_t FF_Close( FF_FILE * pxFile )
             ( ( pxFile->ucMode & ( FF_MODE_WRITE | FF_MODE_APPEND | FF_MODE_CREATE ) ) != 0 ) )
         {
             uint32_t ulClusterSize;
+            BaseType_t xTrim;
+
+            #if ( ffconfigDELAYED_ALLOCATION != 0 )
+            {
+                /* Allocate clusters for the data that is still pending.  When
+                 * that fails half-way, the file keeps the part that was written:
+                 * its size is correct, and the clusters beyond it are freed below. */
+                xFlushError = prvFlushDelayedData( pxFile );
+            }
+            #endif
 
             /* File is not deleted and it was opened for writing or updating */
             ulClusterSize = pxFile->pxIOManager->xPartition.usBlkSize * pxFile->pxIOManager->xPartition.ulSectorsPerCluster;
 
-            if( ( ( pxFile->ulFileSize % ulClusterSize ) == 0 ) && ( pxFile->ulObjectCluster != 0ul ) )
+            /* The file's length is a multiple of cluster size.  This means
+             * that an extra cluster has been reserved, which wasn't necessary.
+             * Or clusters were reserved by FF_Preallocate() and not all of them
+             * have been written.  Or the pending data could not be written. */
+            xTrim = ( ( pxFile->ulFileSize % ulClusterSize ) == 0 ) ||
+                    ( ( pxFile->ulValidFlags & FF_VALID_FLAG_RESERVED ) != 0 ) ||
+                    FF_isERR( xFlushError );
+
+            if( ( FF_isERR( xError ) == pdFALSE ) && ( pxFile->ulObjectCluster != 0ul ) && ( xTrim != pdFALSE ) )
             {
-                /* The file's length is a multiple of cluster size.  This means
-                 * that an extra cluster has been reserved, which wasn't necessary. */
                 xError = FF_Truncate( pxFile, pdTRUE );
             }
 
@@ -3183,7 +3935,7 @@ FF_Error_t FF_Close( FF_FILE * pxFile )
         } /* Semaphore released, linked list was shortened! */
         FF_ReleaseSemaphore( pxFile->pxIOManager->pvSemaphore );
 
-        #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 )
+        #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 )
         {
             if( pxFile->pucBuffer != NULL )
             {
@@ -3192,7 +3944,7 @@ FF_Error_t FF_Close( FF_FILE * pxFile )
                 {
                     FF_Error_t xTempError;
 
-                    xTempError = FF_BlockWrite( pxFile->pxIOManager, FF_FileLBA( pxFile ), 1, pxFile->pucBuffer, pdFALSE );
+                    xTempError = prvWriteFileSectors( pxFile->pxIOManager, FF_FileLBA( pxFile ), 1, pxFile->pucBuffer );
 
                     if( FF_isERR( xError ) == pdFALSE )
                     {
@@ -3203,13 +3955,37 @@ FF_Error_t FF_Close( FF_FILE * pxFile )
                 ffconfigFREE( pxFile->pucBuffer );
             }
         }
-        #endif /* if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) */
+        #endif /* if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 ) */
+
+        #if ( ffconfigDELAYED_ALLOCATION != 0 )
+        {
+            if( pxFile->pucDelayedData != NULL )
+            {
+                ffconfigFREE( pxFile->pucDelayedData );
+            }
+        }
+        #endif
+
+        #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        {
+            if( pxFile->pvTransferDone != NULL )
+            {
+                vSemaphoreDelete( ( SemaphoreHandle_t ) pxFile->pvTransferDone );
+            }
+        }
+        #endif
 
         if( FF_isERR( xError ) == pdFALSE )
         {
             xError = FF_FlushCache( pxFile->pxIOManager ); /* Ensure all modified blocks are flushed to disk! */
         }
 
+        if( FF_isERR( xFlushError ) )
+        {
+            /* Report that the data written last did not make it. */
+            xError = xFlushError;
+        }
+
         ffconfigFREE( pxFile );
     }
     while( pdFALSE );
@@ -3235,16 +4011,18 @@ FF_Error_t FF_SetEof( FF_FILE * pxFile )
     if( ( ( pxFile->ulValidFlags & FF_VALID_FLAG_DELETED ) == 0 ) &&
         ( ( pxFile->ucMode & ( FF_MODE_WRITE | FF_MODE_APPEND | FF_MODE_CREATE ) ) != 0 ) )
     {
+        #if ( ffconfigDELAYED_ALLOCATION != 0 )
+            xError = prvFlushDelayedData( pxFile );
+        #else
+            xError = FF_ERR_NONE;
+        #endif
+
         pxFile->ulFileSize = pxFile->ulFilePointer;
 
-        if( pxFile->ulObjectCluster != 0ul )
+        if( ( FF_isERR( xError ) == pdFALSE ) && ( pxFile->ulObjectCluster != 0ul ) )
         {
             xError = FF_Truncate( pxFile, pdFALSE );
         }
-        else
-        {
-            xError = FF_ERR_NONE;
-        }
     }
     else
     {
@@ -3255,6 +4033,108 @@ FF_Error_t FF_SetEof( FF_FILE * pxFile )
 } /* FF_SetEof() */
 /*-----------------------------------------------------------*/
 
+/**
+ *	@brief	Writes the data of a file that is still held back, and flushes the cache.
+ *
+ *	@param	pxFile		FF_FILE object that was created by FF_Open().
+ *
+ *	With ffconfigDELAYED_ALLOCATION, data appended to a file stays in the handle
+ *	until its buffer is full, so FF_FlushCache() alone does not write it.  This
+ *	function allocates the clusters for that data and writes it.
+ *
+ *	@retval 0 on success.
+ *	@retval negative if some error occurred
+ *
+ **/
+FF_Error_t FF_FlushFile( FF_FILE * pxFile )
+{
+    FF_Error_t xError;
+
+    xError = FF_CheckValid( pxFile );
+
+    #if ( ffconfigDELAYED_ALLOCATION != 0 )
+    {
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            xError = prvFlushDelayedData( pxFile );
+        }
+    }
+    #endif
+
+    if( FF_isERR( xError ) == pdFALSE )
+    {
+        xError = FF_FlushCache( pxFile->pxIOManager );
+    }
+
+    return xError;
+} /* FF_FlushFile() */
+/*-----------------------------------------------------------*/
+
+/**
+ *	@brief	Allocate clusters for a file before they are written.
+ *
+ *	@param	pxFile		FF_FILE object that was created by FF_Open().
+ *	@param	ulSize		The number of bytes from the start of the file that must have clusters.
+ *	@param	xKeepSize	pdFALSE to make 'ulSize' the new file size, pdTRUE to leave the size unchanged.
+ *
+ *	FF_ExtendFile() looks for one run of free clusters large enough.  When there
+ *	is none, the largest runs are used.  Later writes within 'ulSize' do not
+ *	have to change the FAT.  The new clusters are not cleared: when the file
+ *	size grows, the new part of the file has undefined contents.
+ *
+ *	@retval 0 on success.
+ *	@retval negative if some error occurred
+ *
+ **/
+FF_Error_t FF_Preallocate( FF_FILE * pxFile,
+                           uint32_t ulSize,
+                           BaseType_t xKeepSize )
+{
+    FF_Error_t xError;
+
+    xError = FF_CheckValid( pxFile );
+
+    if( FF_isERR( xError ) == pdFALSE )
+    {
+        if( ( ( pxFile->ulValidFlags & FF_VALID_FLAG_DELETED ) != 0 ) ||
+            ( ( pxFile->ucMode & FF_MODE_WRITE ) == 0 ) )
+        {
+            xError = FF_createERR( FF_ERR_FILE_NOT_OPENED_IN_WRITE_MODE, FF_PREALLOCATE );
+        }
+    }
+
+    #if ( ffconfigDELAYED_ALLOCATION != 0 )
+    {
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            /* Let the pending data use the first of the new clusters. */
+            xError = prvFlushDelayedData( pxFile );
+        }
+    }
+    #endif
+
+    if( ( FF_isERR( xError ) == pdFALSE ) && ( ulSize > pxFile->ulFileSize ) )
+    {
+        xError = FF_ExtendFile( pxFile, ulSize );
+
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            if( xKeepSize == pdFALSE )
+            {
+                pxFile->ulFileSize = ulSize;
+            }
+            else
+            {
+                /* FF_Close() will free what is not used. */
+                pxFile->ulValidFlags |= FF_VALID_FLAG_RESERVED;
+            }
+        }
+    }
+
+    return xError;
+} /* FF_Preallocate() */
+/*-----------------------------------------------------------*/
+
 /**
  *	@brief	Truncate a file to 'pxFile->ulFileSize'
  *
@@ -3280,25 +4160,29 @@ static FF_Error_t FF_Truncate( FF_FILE * pxFile,
     /* See how many clusters have been allocated. */
     ulClusterCount = FF_GetChainLength( pxIOManager, pxFile->ulObjectCluster, NULL, &xError );
 
-    /* Calculate the actual number of clusters needed, rounding up */
-    ulClustersNeeded = ( pxFile->ulFileSize + ulClusterSize - 1 ) / ulClusterSize;
+    /* Calculate the actual number of clusters needed, rounding up.  This is
+     * used when the handle will be closed after truncating: this function is
+     * called because Filesize is an exact multiple of ulClusterSize, or because
+     * FF_Preallocate() reserved clusters beyond the end of the file. */
+    ulClustersNeeded = ( pxFile->ulFileSize / ulClusterSize ) + ( ( ( pxFile->ulFileSize % ulClusterSize ) != 0U ) ? 1U : 0U );
 
-    if( bClosing != pdFALSE )
-    {
-        /* The handle will be closed after truncating.  This function is called
-         * because Filesize is an exact multiple of ulClusterSize. */
-        ulClustersNeeded = pxFile->ulFileSize / ulClusterSize;
-    }
-    else
+    if( bClosing == pdFALSE )
     {
         /* This function is called to make the file size equal to the current
          * position within the file. Always keep an extra cluster to write to. */
-        ulClustersNeeded = ( pxFile->ulFileSize + ulClusterSize ) / ulClusterSize;
+        ulClustersNeeded = ( pxFile->ulFileSize / ulClusterSize ) + 1U;
     }
 
     /* First change the FAT chain. */
     if( ( FF_isERR( xError ) == pdFALSE ) && ( ulClusterCount > ulClustersNeeded ) )
     {
+        #if ( ffconfigFILE_EXTENT_MAP != 0 )
+        {
+            /* Some of the runs are about to be freed. */
+            pxFile->usExtentCount = 0;
+        }
+        #endif
+
         if( ulClustersNeeded == 0ul )
         {
             FF_LockFAT( pxIOManager );
@@ -580,6 +580,18 @@ FF_Error_t FF_FormatDisk( FF_Disk_t * pxDisk,
     xSet.xFATCount = 2;          /* Number of FAT's */
     xSet.pxIOManager = pxDisk->pxIOManager;
 
+    #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+    {
+        FF_StopFreeScan( xSet.pxIOManager );
+    }
+    #endif
+    #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+    {
+        /* The FAT is about to be overwritten. */
+        FF_ReleaseFreeBitmap( xSet.pxIOManager );
+    }
+    #endif
+
     FF_PartitionSearch( xSet.pxIOManager, &xSet.xPartitionsFound );
 
     /* Introducing a do {} while(false) loop for easy exit without return. */
@@ -936,6 +948,18 @@ FF_Error_t FF_Partition( FF_Disk_t * pxDisk,
     /* Clear caching without flushing first. */
     FF_IOMAN_InitBufferDescriptors( xSet.pxIOManager );
 
+    #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+    {
+        FF_StopFreeScan( xSet.pxIOManager );
+    }
+    #endif
+    #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+    {
+        /* The FAT is about to be overwritten. */
+        FF_ReleaseFreeBitmap( xSet.pxIOManager );
+    }
+    #endif
+
     /* Avoid sanity checks by FF_BlockRead/Write. */
     xSet.pxIOManager->xPartition.ulTotalSectors = 0;
 
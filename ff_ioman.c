@@ -74,6 +74,122 @@ static FF_Error_t FF_GetEfiPartitionEntry( FF_IOManager_t * pxIOManager,
 
 static BaseType_t prvHasActiveHandles( FF_IOManager_t * pxIOManager );
 
+/* Look up a valid buffer that holds the given sector. */
+static FF_Buffer_t * prvFindBuffer( FF_IOManager_t * pxIOManager,
+                                    uint32_t ulSector );
+
+/* Find an unused buffer of a pool that may be recycled for a new sector. */
+static FF_Buffer_t * prvFindVictimBuffer( FF_IOManager_t * pxIOManager,
+                                          BaseType_t xPool );
+
+/* Claim a wait slot for a task that waits for a sector buffer, returns the
+ * event bit to wait for. */
+static uint32_t prvBufferWaitStart( FF_IOManager_t * pxIOManager,
+                                    uint32_t ulSector );
+
+/* Give back the wait slot claimed by prvBufferWaitStart(). */
+static void prvBufferWaitEnd( FF_IOManager_t * pxIOManager,
+                              uint32_t ulWaitBits );
+
+/* Return the event bits of the tasks that wait for a buffer that just became free. */
+static uint32_t prvBufferWaitBits( const FF_IOManager_t * pxIOManager,
+                                   uint32_t ulSector );
+
+#if ( ffconfigCACHE_POOLS != 0 )
+    /* Choose the pool in which a sector will be cached. */
+    static BaseType_t prvSelectPool( FF_IOManager_t * pxIOManager,
+                                     uint32_t ulSector,
+                                     uint8_t ucMode );
+
+    #define FF_BUFFER_POOL( pxBuffer )    ( ( BaseType_t ) ( pxBuffer )->ucPool )
+#else
+    #define FF_BUFFER_POOL( pxBuffer )    ( ( BaseType_t ) FF_CACHE_POOL_DATA )
+#endif
+
+#if ( ffconfigCACHE_2Q != 0 )
+    #define FF_BUFFER_LIST( pxBuffer )    ( ( FF_BUFFER_POOL( pxBuffer ) * FF_CACHE_QUEUE_COUNT ) + ( BaseType_t ) ( pxBuffer )->ucQueue )
+#else
+    #define FF_BUFFER_LIST( pxBuffer )    FF_BUFFER_POOL( pxBuffer )
+#endif
+
+#if ( ffconfigFLUSH_MERGE_SECTORS > 1 )
+    /* Write all modified buffers without handles, merging adjacent sectors. */
+    static FF_Error_t prvFlushMergedBuffers( FF_IOManager_t * pxIOManager );
+#endif
+
+#if ( ffconfigBUFFER_HASH_INDEX != 0 )
+    /* Return the index of the hash bucket of a sector. */
+    static uint32_t prvSectorHash( FF_IOManager_t * pxIOManager,
+                                   uint32_t ulSector );
+
+    /* Return the hash bucket in which a sector will be stored. */
+    static FF_Buffer_t ** prvBufferBucket( FF_IOManager_t * pxIOManager,
+                                           uint32_t ulSector );
+
+    /* Remove a valid buffer from its hash bucket. */
+    static void prvBufferUnhash( FF_IOManager_t * pxIOManager,
+                                 FF_Buffer_t * pxBuffer );
+
+    /* Move a buffer to the head of its LRU list. */
+    static void prvBufferMakeRecent( FF_IOManager_t * pxIOManager,
+                                     FF_Buffer_t * pxBuffer );
+
+    /* Update the LRU lists for a buffer that was found in the cache. */
+    static void prvBufferHit( FF_IOManager_t * pxIOManager,
+                              FF_Buffer_t * pxBuffer );
+
+    /* Update the LRU lists for a buffer that just got a new sector. */
+    static void prvBufferAdmit( FF_IOManager_t * pxIOManager,
+                                FF_Buffer_t * pxBuffer );
+#endif
+
+#if ( ffconfigCACHE_2Q != 0 )
+    /* Remove an entry of the ghost ring from its hash chain. */
+    static void prvGhostUnlink( FF_IOManager_t * pxIOManager,
+                                uint16_t usSlot );
+
+    /* Remember a sector that leaves a FIFO queue, see prvBufferAdmit(). */
+    static void prvGhostRemember( FF_IOManager_t * pxIOManager,
+                                  uint32_t ulSector );
+
+    /* Forget a sector, return pdTRUE if it was remembered. */
+    static BaseType_t prvGhostForget( FF_IOManager_t * pxIOManager,
+                                      uint32_t ulSector );
+#endif
+
+#if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
+    /* Forget the sectors of the directory block that are about to change. */
+    static void prvDirBlockDrop( FF_IOManager_t * pxIOManager,
+                                 uint32_t ulSector,
+                                 uint32_t ulCount );
+#endif
+
+/* Call a function for every valid buffer that holds a sector of a range,
+ * until it returns an error. */
+static FF_Error_t prvForEachBufferInRange( FF_IOManager_t * pxIOManager,
+                                           uint32_t ulSector,
+                                           uint32_t ulCount,
+                                           FF_Error_t ( * pxFunction )( FF_IOManager_t * pxIOManager,
+                                                                        FF_Buffer_t * pxBuffer ) );
+
+#if ( ffconfigREAD_AHEAD_SECTORS > 1 )
+    /* Store the sectors read by FF_ReadAhead() in their buffers. */
+    static int32_t prvReadAheadStore( FF_IOManager_t * pxIOManager,
+                                      uint32_t ulSector,
+                                      BaseType_t xCount,
+                                      BaseType_t xAdjacentInMemory,
+                                      int32_t lResult );
+#endif
+
+#if ( ffconfigREAD_AHEAD_SECTORS > 1 ) && ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+    /* Return pdTRUE when a sector is being read ahead by the driver. */
+    static BaseType_t prvReadAheadHolds( const FF_IOManager_t * pxIOManager,
+                                         uint32_t ulSector );
+
+    /* Wait for the read-ahead that is in flight, and store its sectors. */
+    static void prvReadAheadFinish( FF_IOManager_t * pxIOManager );
+#endif
+
 
 /**
  *	@brief	Creates an FF_IOManager_t object, to initialise FreeRTOS+FAT
@@ -110,6 +226,16 @@ FF_IOManager_t * FF_CreateIOManager( FF_CreationParameters_t * pxParameters,
         /* The size of the caching memory (ulCacheSize) must now be atleast 2 * ulSectorSize (or a deadlock will occur). */
         xError = FF_createERR( FF_ERR_IOMAN_BAD_MEMSIZE, FF_CREATEIOMAN );
     }
+
+    #if ( ffconfigCACHE_POOLS != 0 )
+        else if( ( ( pxParameters->ulFATMemorySize % ( uint32_t ) usSectorSize ) != 0 ) ||
+                 ( ( pxParameters->ulDirMemorySize % ( uint32_t ) usSectorSize ) != 0 ) ||
+                 ( ( pxParameters->ulFATMemorySize + pxParameters->ulDirMemorySize + ( 2U * ( uint32_t ) usSectorSize ) ) > ulCacheSize ) )
+        {
+            /* The data pool, which the other pools borrow from, must also have at least 2 buffers. */
+            xError = FF_createERR( FF_ERR_IOMAN_BAD_MEMSIZE, FF_CREATEIOMAN );
+        }
+    #endif
     else
     {
         pxIOManager = ( FF_IOManager_t * ) ffconfigMALLOC( sizeof( FF_IOManager_t ) );
@@ -172,13 +298,89 @@ FF_IOManager_t * FF_CreateIOManager( FF_CreationParameters_t * pxParameters,
         pxIOManager->usSectorSize = ( uint16_t ) usSectorSize;
         pxIOManager->usCacheSize = ( uint16_t ) ( ulCacheSize / ( uint32_t ) usSectorSize );
 
+        #if ( ffconfigCACHE_POOLS != 0 )
+        {
+            FF_CachePool_t * pxPools = pxIOManager->xPools;
+
+            /* The buffers are divided in the order FAT, directories, data. */
+            pxPools[ FF_CACHE_POOL_FAT ].usCount = ( uint16_t ) ( pxParameters->ulFATMemorySize / usSectorSize );
+            pxPools[ FF_CACHE_POOL_DIR ].usFirst = pxPools[ FF_CACHE_POOL_FAT ].usCount;
+            pxPools[ FF_CACHE_POOL_DIR ].usCount = ( uint16_t ) ( pxParameters->ulDirMemorySize / usSectorSize );
+            pxPools[ FF_CACHE_POOL_DATA ].usFirst = pxPools[ FF_CACHE_POOL_DIR ].usFirst + pxPools[ FF_CACHE_POOL_DIR ].usCount;
+            pxPools[ FF_CACHE_POOL_DATA ].usCount = pxIOManager->usCacheSize - pxPools[ FF_CACHE_POOL_DATA ].usFirst;
+        }
+        #endif /* ffconfigCACHE_POOLS */
+
+        #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+        {
+            /* The number of hash buckets is the smallest power of 2 that is
+             * not less than the number of buffers. */
+            pxIOManager->ulBufferHashMask = 1U;
+
+            while( pxIOManager->ulBufferHashMask < pxIOManager->usCacheSize )
+            {
+                pxIOManager->ulBufferHashMask <<= 1;
+            }
+
+            pxIOManager->ulBufferHashMask--;
+        }
+        #endif /* ffconfigBUFFER_HASH_INDEX */
+
+        #if ( ffconfigCACHE_2Q != 0 )
+        {
+            /* Remember the last sectors that left the FIFO queue, as many as
+             * half the number of buffers. */
+            pxIOManager->usGhostCount = ( uint16_t ) ( pxIOManager->usCacheSize / 2U );
+
+            if( pxIOManager->usGhostCount == 0U )
+            {
+                pxIOManager->usGhostCount = 1U;
+            }
+        }
+        #endif /* ffconfigCACHE_2Q */
+
         /* Malloc() memory for buffer objects. FreeRTOS+FAT never refers to a
          * buffer directly but uses buffer objects instead. Allows for thread
          * safety. */
-        pxIOManager->pxBuffers = ( FF_Buffer_t * ) ffconfigMALLOC( sizeof( FF_Buffer_t ) * pxIOManager->usCacheSize );
+        #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+        {
+            size_t uxSize = ( sizeof( FF_Buffer_t ) * pxIOManager->usCacheSize ) +
+                            ( sizeof( FF_Buffer_t * ) * ( pxIOManager->ulBufferHashMask + 1U ) );
+
+            #if ( ffconfigCACHE_2Q != 0 )
+            {
+                uxSize += ( sizeof( uint32_t ) + sizeof( uint16_t ) ) * pxIOManager->usGhostCount;
+                uxSize += sizeof( uint16_t ) * ( pxIOManager->ulBufferHashMask + 1U );
+            }
+            #endif
+
+            /* The hash buckets (and the 2Q ghost sectors with their own hash
+             * chains) are allocated in the same block, right after the buffer
+             * descriptors. */
+            pxIOManager->pxBuffers = ( FF_Buffer_t * ) ffconfigMALLOC( uxSize );
+        }
+        #else
+        {
+            pxIOManager->pxBuffers = ( FF_Buffer_t * ) ffconfigMALLOC( sizeof( FF_Buffer_t ) * pxIOManager->usCacheSize );
+        }
+        #endif
 
         if( pxIOManager->pxBuffers != NULL )
         {
+            #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+            {
+                pxIOManager->ppxBufferHash = ( FF_Buffer_t ** ) &( pxIOManager->pxBuffers[ pxIOManager->usCacheSize ] );
+            }
+            #endif
+
+            #if ( ffconfigCACHE_2Q != 0 )
+            {
+                pxIOManager->pulGhostSectors = ( uint32_t * ) &( pxIOManager->ppxBufferHash[ pxIOManager->ulBufferHashMask + 1U ] );
+                pxIOManager->pusGhostLink = ( uint16_t * ) &( pxIOManager->pulGhostSectors[ pxIOManager->usGhostCount ] );
+                pxIOManager->pusGhostBucket = &( pxIOManager->pusGhostLink[ pxIOManager->usGhostCount ] );
+            }
+            #endif
+
             /* From now on a call to FF_IOMAN_InitBufferDescriptors will clear
              * pxBuffers. */
             pxIOManager->ucFlags |= FF_IOMAN_ALLOC_BUFDESCR;
@@ -188,6 +390,47 @@ FF_IOManager_t * FF_CreateIOManager( FF_CreationParameters_t * pxParameters,
             /* Finally store the semaphore for Buffer Description modifications. */
             pxIOManager->pvSemaphore = pxParameters->pvSemaphore;
 
+            #if ( ffconfigFLUSH_MERGE_SECTORS > 1 )
+            {
+                pxIOManager->pucFlushMem = ( uint8_t * ) ffconfigMALLOC( ( sizeof( FF_Buffer_t * ) * pxIOManager->usCacheSize ) +
+                                                                        ( ( size_t ) ffconfigFLUSH_MERGE_SECTORS * usSectorSize ) );
+
+                if( pxIOManager->pucFlushMem == NULL )
+                {
+                    xError = FF_createERR( FF_ERR_NOT_ENOUGH_MEMORY, FF_CREATEIOMAN );
+                }
+            }
+            #endif /* ffconfigFLUSH_MERGE_SECTORS */
+
+            #if ( ffconfigREAD_AHEAD_SECTORS > 1 )
+            {
+                pxIOManager->pucReadAheadMem = ( uint8_t * ) ffconfigMALLOC( ( size_t ) ffconfigREAD_AHEAD_SECTORS * usSectorSize );
+
+                if( pxIOManager->pucReadAheadMem == NULL )
+                {
+                    xError = FF_createERR( FF_ERR_NOT_ENOUGH_MEMORY, FF_CREATEIOMAN );
+                }
+
+                #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+                {
+                    /* Without a semaphore, the sectors are read ahead synchronously. */
+                    pxIOManager->xReadAheadRequest.pvDone = ( void * ) xSemaphoreCreateBinary();
+                }
+                #endif
+            }
+            #endif /* ffconfigREAD_AHEAD_SECTORS */
+
+            #if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
+            {
+                pxIOManager->pucDirBlockMem = ( uint8_t * ) ffconfigMALLOC( ( size_t ) ffconfigDIRECTORY_READ_SECTORS * usSectorSize );
+
+                if( pxIOManager->pucDirBlockMem == NULL )
+                {
+                    xError = FF_createERR( FF_ERR_NOT_ENOUGH_MEMORY, FF_CREATEIOMAN );
+                }
+            }
+            #endif /* ffconfigDIRECTORY_READ_SECTORS */
+
             #if ( ffconfigPROTECT_FF_FOPEN_WITH_SEMAPHORE == 1 )
                 pxIOManager->pvSemaphoreOpen = xSemaphoreCreateRecursiveMutex();
 
@@ -207,6 +450,9 @@ FF_IOManager_t * FF_CreateIOManager( FF_CreationParameters_t * pxParameters,
                 pxIOManager->xBlkDevice.fnpReadBlocks = pxParameters->fnReadBlocks;
                 pxIOManager->xBlkDevice.fnpWriteBlocks = pxParameters->fnWriteBlocks;
                 pxIOManager->xBlkDevice.pxDisk = pxParameters->pxDisk;
+                #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+                    pxIOManager->xBlkDevice.fnpSubmitBlocks = pxParameters->fnSubmitBlocks;
+                #endif
             }
         }
         else
@@ -266,6 +512,56 @@ FF_Error_t FF_DeleteIOManager( FF_IOManager_t * pxIOManager )
             ffconfigFREE( pxIOManager->pucCacheMem );
         }
 
+        #if ( ffconfigFLUSH_MERGE_SECTORS > 1 )
+        {
+            if( pxIOManager->pucFlushMem != NULL )
+            {
+                ffconfigFREE( pxIOManager->pucFlushMem );
+            }
+        }
+        #endif
+
+        #if ( ffconfigREAD_AHEAD_SECTORS > 1 )
+        {
+            #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+            {
+                if( pxIOManager->xReadAheadRequest.pvDone != NULL )
+                {
+                    /* The driver may still be writing to the buffers. */
+                    prvReadAheadFinish( pxIOManager );
+                    vSemaphoreDelete( ( SemaphoreHandle_t ) pxIOManager->xReadAheadRequest.pvDone );
+                }
+            }
+            #endif
+
+            if( pxIOManager->pucReadAheadMem != NULL )
+            {
+                ffconfigFREE( pxIOManager->pucReadAheadMem );
+            }
+        }
+        #endif
+
+        #if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
+        {
+            if( pxIOManager->pucDirBlockMem != NULL )
+            {
+                ffconfigFREE( pxIOManager->pucDirBlockMem );
+            }
+        }
+        #endif
+
+        #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+        {
+            FF_ReleaseFreeBitmap( pxIOManager );
+        }
+        #endif
+
+        #if ( ffconfigLFN_INDEX != 0 )
+        {
+            FF_LFNIndexFlush( pxIOManager );
+        }
+        #endif
+
         #if ( ffconfigPROTECT_FF_FOPEN_WITH_SEMAPHORE == 1 )
         {
             if( pxIOManager->pvSemaphoreOpen != NULL )
@@ -302,9 +598,78 @@ void FF_IOMAN_InitBufferDescriptors( FF_IOManager_t * pxIOManager )
     /* Clear the contents of the buffer descriptors. */
     memset( ( void * ) pxBuffer, '\0', sizeof( FF_Buffer_t ) * pxIOManager->usCacheSize );
 
+    #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+    {
+        memset( ( void * ) pxIOManager->ppxBufferHash, '\0', sizeof( FF_Buffer_t * ) * ( pxIOManager->ulBufferHashMask + 1U ) );
+        memset( ( void * ) pxIOManager->pxLRUHead, '\0', sizeof( pxIOManager->pxLRUHead ) );
+        memset( ( void * ) pxIOManager->pxLRUTail, '\0', sizeof( pxIOManager->pxLRUTail ) );
+    }
+    #endif /* ffconfigBUFFER_HASH_INDEX */
+
+    #if ( ffconfigCACHE_2Q != 0 )
+    {
+        memset( ( void * ) pxIOManager->usListLength, '\0', sizeof( pxIOManager->usListLength ) );
+
+        /* Forget the sectors that left a FIFO queue: 0xFF..FF is not a valid sector. */
+        memset( ( void * ) pxIOManager->pulGhostSectors, 0xFF, sizeof( uint32_t ) * pxIOManager->usGhostCount );
+        memset( ( void * ) pxIOManager->pusGhostBucket, 0xFF, sizeof( uint16_t ) * ( pxIOManager->ulBufferHashMask + 1U ) );
+        pxIOManager->usGhostNext = 0U;
+    }
+    #endif /* ffconfigCACHE_2Q */
+
+    #if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
+    {
+        /* The directory sectors may belong to a different medium. */
+        pxIOManager->ulDirBlockCount = 0U;
+    }
+    #endif
+
     while( pxBuffer < pxLastBuffer )
     {
         pxBuffer->pucBuffer = pucBuffer;
+
+        #if ( ffconfigCACHE_POOLS != 0 )
+        {
+            BaseType_t xPool = FF_CACHE_POOL_DATA;
+            uint16_t usIndex = ( uint16_t ) ( pxBuffer - pxIOManager->pxBuffers );
+
+            while( ( xPool > 0 ) && ( usIndex < pxIOManager->xPools[ xPool ].usFirst ) )
+            {
+                xPool--;
+            }
+
+            pxBuffer->ucPool = ( uint8_t ) xPool;
+        }
+        #endif /* ffconfigCACHE_POOLS */
+
+        #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+        {
+            /* All buffers are invalid, so the order of the LRU lists is not
+             * important.  Append the buffer to the list of its pool, which
+             * is the main queue when using 2Q. */
+            BaseType_t xList = FF_BUFFER_LIST( pxBuffer );
+
+            pxBuffer->pxLRUPrev = pxIOManager->pxLRUTail[ xList ];
+
+            if( pxBuffer->pxLRUPrev != NULL )
+            {
+                pxBuffer->pxLRUPrev->pxLRUNext = pxBuffer;
+            }
+            else
+            {
+                pxIOManager->pxLRUHead[ xList ] = pxBuffer;
+            }
+
+            pxIOManager->pxLRUTail[ xList ] = pxBuffer;
+
+            #if ( ffconfigCACHE_2Q != 0 )
+            {
+                pxIOManager->usListLength[ xList ]++;
+            }
+            #endif
+        }
+        #endif /* ffconfigBUFFER_HASH_INDEX */
+
         pxBuffer++;
         pucBuffer += pxIOManager->usSectorSize;
     }
@@ -316,11 +681,16 @@ void FF_IOMAN_InitBufferDescriptors( FF_IOManager_t * pxIOManager )
  *
  *	@param		pxIOManager	IOMAN Object.
  *
+ *	Data that a file handle holds back, see ffconfigDELAYED_ALLOCATION, is not
+ *	in the cache yet: FF_FlushFile() writes it.
+ *
  *	@return		FF_ERR_NONE on Success.
  **/
 FF_Error_t FF_FlushCache( FF_IOManager_t * pxIOManager )
 {
-    BaseType_t xIndex, xIndex2;
+    #if ( ffconfigFLUSH_MERGE_SECTORS <= 1 )
+        BaseType_t xIndex, xIndex2;
+    #endif
     FF_Error_t xError;
 
     if( pxIOManager == NULL )
@@ -332,6 +702,11 @@ FF_Error_t FF_FlushCache( FF_IOManager_t * pxIOManager )
         xError = FF_ERR_NONE;
 
         FF_PendSemaphore( pxIOManager->pvSemaphore );
+        #if ( ffconfigFLUSH_MERGE_SECTORS > 1 )
+        {
+            xError = prvFlushMergedBuffers( pxIOManager );
+        }
+        #else
         {
             for( xIndex = 0; xIndex < pxIOManager->usCacheSize; xIndex++ )
             {
@@ -346,10 +721,13 @@ FF_Error_t FF_FlushCache( FF_IOManager_t * pxIOManager )
                     pxIOManager->pxBuffers[ xIndex ].bModified = pdFALSE;
 
                     /* Search for other buffers that used this sector, and mark them as modified
-                     * So that further requests will result in the new sector being fetched. */
+                     * So that further requests will result in the new sector being fetched.
+                     * Buffers dropped by FF_DiscardBuffers() still carry their old sector
+                     * number, they must not be written back. */
                     for( xIndex2 = 0; xIndex2 < pxIOManager->usCacheSize; xIndex2++ )
                     {
                         if( ( xIndex != xIndex2 ) &&
+                            ( pxIOManager->pxBuffers[ xIndex2 ].bValid != pdFALSE ) &&
                             ( pxIOManager->pxBuffers[ xIndex2 ].ulSector == pxIOManager->pxBuffers[ xIndex ].ulSector ) &&
                             ( pxIOManager->pxBuffers[ xIndex2 ].ucMode == FF_MODE_READ ) )
                         {
@@ -359,6 +737,7 @@ FF_Error_t FF_FlushCache( FF_IOManager_t * pxIOManager )
                 }
             }
         }
+        #endif /* if ( ffconfigFLUSH_MERGE_SECTORS > 1 ) */
 
         if( ( pxIOManager->xBlkDevice.pxDisk != NULL ) &&
             ( pxIOManager->xBlkDevice.pxDisk->fnFlushApplicationHook != NULL ) )
@@ -375,213 +754,1431 @@ FF_Error_t FF_FlushCache( FF_IOManager_t * pxIOManager )
 } /* FF_FlushCache() */
 /*-----------------------------------------------------------*/
 
-/*
- *  A new version of FF_GetBuffer() with a simple mechanism for timeout
- */
-#define FF_GETBUFFER_SLEEP_TIME_MS    10
-#define FF_GETBUFFER_WAIT_TIME_MS     ( 20000 / FF_GETBUFFER_SLEEP_TIME_MS )
+#if ( ffconfigBUFFER_HASH_INDEX != 0 )
 
-FF_Buffer_t * FF_GetBuffer( FF_IOManager_t * pxIOManager,
-                            uint32_t ulSector,
-                            uint8_t ucMode )
-{
-    FF_Buffer_t * pxBuffer;
-/* Least Recently Used Buffer */
-    FF_Buffer_t * pxRLUBuffer;
-    FF_Buffer_t * pxMatchingBuffer = NULL;
-    int32_t lRetVal;
-    BaseType_t xLoopCount = FF_GETBUFFER_WAIT_TIME_MS;
-    const FF_Buffer_t * pxLastBuffer = &( pxIOManager->pxBuffers[ pxIOManager->usCacheSize ] );
+    static uint32_t prvSectorHash( FF_IOManager_t * pxIOManager,
+                                   uint32_t ulSector )
+    {
+        /* Fibonacci hashing: the multiplication spreads sectors that are a
+         * fixed distance apart, such as the same entry in both FAT copies. */
+        uint32_t ulHash = ( ulSector * 0x9E3779B1UL ) >> 16;
 
-    /* 'pxIOManager->usCacheSize' is bigger than zero and it is a multiple of ulSectorSize. */
+        return ulHash & pxIOManager->ulBufferHashMask;
+    }
+/*-----------------------------------------------------------*/
 
-    while( pxMatchingBuffer == NULL )
+    static FF_Buffer_t ** prvBufferBucket( FF_IOManager_t * pxIOManager,
+                                           uint32_t ulSector )
     {
-        xLoopCount--;
+        return &( pxIOManager->ppxBufferHash[ prvSectorHash( pxIOManager, ulSector ) ] );
+    }
+/*-----------------------------------------------------------*/
 
-        if( xLoopCount == 0 )
+    static void prvBufferUnhash( FF_IOManager_t * pxIOManager,
+                                 FF_Buffer_t * pxBuffer )
+    {
+        FF_Buffer_t ** ppxLink = prvBufferBucket( pxIOManager, pxBuffer->ulSector );
+
+        while( *ppxLink != NULL )
         {
-            break;
+            if( *ppxLink == pxBuffer )
+            {
+                *ppxLink = pxBuffer->pxHashNext;
+                break;
+            }
+
+            ppxLink = &( ( *ppxLink )->pxHashNext );
         }
 
-        FF_PendSemaphore( pxIOManager->pvSemaphore );
+        pxBuffer->pxHashNext = NULL;
+    }
+/*-----------------------------------------------------------*/
 
-        for( pxBuffer = pxIOManager->pxBuffers; pxBuffer < pxLastBuffer; pxBuffer++ )
+    static void prvBufferMakeRecent( FF_IOManager_t * pxIOManager,
+                                     FF_Buffer_t * pxBuffer )
+    {
+        /* Every pool (and with 2Q every queue) has its own LRU list. */
+        BaseType_t xList = FF_BUFFER_LIST( pxBuffer );
+
+        if( pxIOManager->pxLRUHead[ xList ] != pxBuffer )
         {
-            if( ( pxBuffer->ulSector == ulSector ) && ( pxBuffer->bValid ) )
+            /* Unlink the buffer, it is not the head so it has a predecessor. */
+            pxBuffer->pxLRUPrev->pxLRUNext = pxBuffer->pxLRUNext;
+
+            if( pxBuffer->pxLRUNext != NULL )
             {
-                pxMatchingBuffer = pxBuffer;
-                /* Don't look further if you found a perfect match. */
-                break;
+                pxBuffer->pxLRUNext->pxLRUPrev = pxBuffer->pxLRUPrev;
+            }
+            else
+            {
+                pxIOManager->pxLRUTail[ xList ] = pxBuffer->pxLRUPrev;
             }
+
+            /* And insert it at the head. */
+            pxBuffer->pxLRUPrev = NULL;
+            pxBuffer->pxLRUNext = pxIOManager->pxLRUHead[ xList ];
+            pxIOManager->pxLRUHead[ xList ]->pxLRUPrev = pxBuffer;
+            pxIOManager->pxLRUHead[ xList ] = pxBuffer;
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvBufferHit( FF_IOManager_t * pxIOManager,
+                              FF_Buffer_t * pxBuffer )
+    {
+        #if ( ffconfigCACHE_2Q != 0 )
+            /* Hits in the FIFO queue are normally a few accesses in a row to
+             * the same sector, they do not make it a frequently used sector. */
+            if( pxBuffer->ucQueue == FF_CACHE_QUEUE_MAIN )
+        #endif
+        {
+            prvBufferMakeRecent( pxIOManager, pxBuffer );
         }
+    }
+/*-----------------------------------------------------------*/
 
-        if( pxMatchingBuffer != NULL )
+    static void prvBufferAdmit( FF_IOManager_t * pxIOManager,
+                                FF_Buffer_t * pxBuffer )
+    {
+        #if ( ffconfigCACHE_2Q != 0 )
         {
-            /* A Match was found process! */
-            if( ( ucMode == FF_MODE_READ ) && ( pxMatchingBuffer->ucMode == FF_MODE_READ ) )
+            BaseType_t xList = FF_BUFFER_LIST( pxBuffer );
+            uint8_t ucQueue = FF_CACHE_QUEUE_IN;
+
+            if( prvGhostForget( pxIOManager, pxBuffer->ulSector ) != pdFALSE )
             {
-                pxMatchingBuffer->usNumHandles += 1;
-                pxMatchingBuffer->usPersistence += 1;
-                break;
+                /* The sector is used again, shortly after it left the FIFO queue. */
+                ucQueue = FF_CACHE_QUEUE_MAIN;
             }
 
-            if( pxMatchingBuffer->usNumHandles == 0 )
+            /* Move the buffer to the head of the other list. */
+            if( pxBuffer->pxLRUPrev != NULL )
             {
-                /* Copy the read & write flags. */
-                pxMatchingBuffer->ucMode = ( ucMode & FF_MODE_RD_WR );
+                pxBuffer->pxLRUPrev->pxLRUNext = pxBuffer->pxLRUNext;
+            }
+            else
+            {
+                pxIOManager->pxLRUHead[ xList ] = pxBuffer->pxLRUNext;
+            }
 
-                if( ( ucMode & FF_MODE_WRITE ) != 0 )
-                {
-                    /* This buffer has no attached handles. */
-                    pxMatchingBuffer->bModified = pdTRUE;
-                }
+            if( pxBuffer->pxLRUNext != NULL )
+            {
+                pxBuffer->pxLRUNext->pxLRUPrev = pxBuffer->pxLRUPrev;
+            }
+            else
+            {
+                pxIOManager->pxLRUTail[ xList ] = pxBuffer->pxLRUPrev;
+            }
 
-                pxMatchingBuffer->usNumHandles = 1;
-                pxMatchingBuffer->usPersistence += 1;
-                break;
+            pxIOManager->usListLength[ xList ]--;
+
+            pxBuffer->ucQueue = ucQueue;
+            xList = FF_BUFFER_LIST( pxBuffer );
+
+            pxBuffer->pxLRUPrev = NULL;
+            pxBuffer->pxLRUNext = pxIOManager->pxLRUHead[ xList ];
+
+            if( pxBuffer->pxLRUNext != NULL )
+            {
+                pxBuffer->pxLRUNext->pxLRUPrev = pxBuffer;
+            }
+            else
+            {
+                pxIOManager->pxLRUTail[ xList ] = pxBuffer;
             }
 
-            /* Sector is already in use in a different mode, keep yielding until its available! */
-            pxMatchingBuffer = NULL;
+            pxIOManager->pxLRUHead[ xList ] = pxBuffer;
+            pxIOManager->usListLength[ xList ]++;
         }
-        else
+        #else /* if ( ffconfigCACHE_2Q != 0 ) */
         {
-            /* There is no valid buffer now for the desired sector.
-             * Find a free buffer and use it for that sector. */
-            pxRLUBuffer = NULL;
+            prvBufferMakeRecent( pxIOManager, pxBuffer );
+        }
+        #endif /* if ( ffconfigCACHE_2Q != 0 ) */
+    }
+/*-----------------------------------------------------------*/
 
-            for( pxBuffer = pxIOManager->pxBuffers; pxBuffer < pxLastBuffer; pxBuffer++ )
-            {
-                if( pxBuffer->usNumHandles != 0 )
-                {
-                    continue; /* Occupied */
-                }
+#endif /* ffconfigBUFFER_HASH_INDEX */
 
-                pxBuffer->ulLRU += 1;
+#if ( ffconfigCACHE_2Q != 0 )
 
-                if( ( pxRLUBuffer == NULL ) ||
-                    ( pxBuffer->ulLRU > pxRLUBuffer->ulLRU ) ||
-                    ( ( pxBuffer->ulLRU == pxRLUBuffer->ulLRU ) && ( pxBuffer->usPersistence > pxRLUBuffer->usPersistence ) ) )
-                {
-                    pxRLUBuffer = pxBuffer;
-                }
+    static void prvGhostUnlink( FF_IOManager_t * pxIOManager,
+                                uint16_t usSlot )
+    {
+        uint16_t * pusLink = &( pxIOManager->pusGhostBucket[ prvSectorHash( pxIOManager, pxIOManager->pulGhostSectors[ usSlot ] ) ] );
+
+        while( *pusLink != FF_GHOST_NONE )
+        {
+            if( *pusLink == usSlot )
+            {
+                *pusLink = pxIOManager->pusGhostLink[ usSlot ];
+                break;
             }
 
-            /* A free buffer with the highest value of 'ulLRU' was found: */
-            if( pxRLUBuffer != NULL )
+            pusLink = &( pxIOManager->pusGhostLink[ *pusLink ] );
+        }
+
+        pxIOManager->pulGhostSectors[ usSlot ] = 0xFFFFFFFFUL;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvGhostRemember( FF_IOManager_t * pxIOManager,
+                                  uint32_t ulSector )
+    {
+        uint16_t usSlot = pxIOManager->usGhostNext;
+        uint16_t * pusBucket = &( pxIOManager->pusGhostBucket[ prvSectorHash( pxIOManager, ulSector ) ] );
+
+        /* The oldest sector in the ring is forgotten. */
+        if( pxIOManager->pulGhostSectors[ usSlot ] != 0xFFFFFFFFUL )
+        {
+            prvGhostUnlink( pxIOManager, usSlot );
+        }
+
+        pxIOManager->pulGhostSectors[ usSlot ] = ulSector;
+        pxIOManager->pusGhostLink[ usSlot ] = *pusBucket;
+        *pusBucket = usSlot;
+
+        pxIOManager->usGhostNext = ( uint16_t ) ( ( usSlot + 1U ) % pxIOManager->usGhostCount );
+    }
+/*-----------------------------------------------------------*/
+
+    static BaseType_t prvGhostForget( FF_IOManager_t * pxIOManager,
+                                      uint32_t ulSector )
+    {
+        uint16_t usSlot = pxIOManager->pusGhostBucket[ prvSectorHash( pxIOManager, ulSector ) ];
+        BaseType_t xFound = pdFALSE;
+
+        /* A chain holds about one entry, as there are more buckets than
+         * remembered sectors. */
+        while( usSlot != FF_GHOST_NONE )
+        {
+            if( pxIOManager->pulGhostSectors[ usSlot ] == ulSector )
             {
-                /* Process the suitable candidate. */
-                if( pxRLUBuffer->bModified == pdTRUE )
+                prvGhostUnlink( pxIOManager, usSlot );
+                xFound = pdTRUE;
+                break;
+            }
+
+            usSlot = pxIOManager->pusGhostLink[ usSlot ];
+        }
+
+        return xFound;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* ffconfigCACHE_2Q */
+
+static FF_Buffer_t * prvFindBuffer( FF_IOManager_t * pxIOManager,
+                                    uint32_t ulSector )
+{
+    FF_Buffer_t * pxBuffer;
+
+    #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+    {
+        /* Only valid buffers are stored in the hash buckets. */
+        for( pxBuffer = *prvBufferBucket( pxIOManager, ulSector ); pxBuffer != NULL; pxBuffer = pxBuffer->pxHashNext )
+        {
+            if( pxBuffer->ulSector == ulSector )
+            {
+                break;
+            }
+        }
+    }
+    #else /* if ( ffconfigBUFFER_HASH_INDEX != 0 ) */
+    {
+        const FF_Buffer_t * pxLastBuffer = &( pxIOManager->pxBuffers[ pxIOManager->usCacheSize ] );
+        FF_Buffer_t * pxFound = NULL;
+
+        for( pxBuffer = pxIOManager->pxBuffers; pxBuffer < pxLastBuffer; pxBuffer++ )
+        {
+            if( ( pxBuffer->ulSector == ulSector ) && ( pxBuffer->bValid ) )
+            {
+                pxFound = pxBuffer;
+                /* Don't look further if you found a perfect match. */
+                break;
+            }
+        }
+
+        pxBuffer = pxFound;
+    }
+    #endif /* if ( ffconfigBUFFER_HASH_INDEX != 0 ) */
+
+    return pxBuffer;
+} /* prvFindBuffer() */
+/*-----------------------------------------------------------*/
+
+static FF_Buffer_t * prvFindVictimBuffer( FF_IOManager_t * pxIOManager,
+                                          BaseType_t xPool )
+{
+    FF_Buffer_t * pxBuffer;
+/* Least Recently Used Buffer */
+    FF_Buffer_t * pxRLUBuffer = NULL;
+
+    #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+    {
+        BaseType_t xList = xPool * FF_CACHE_QUEUE_COUNT;
+        BaseType_t xTry;
+
+        #if ( ffconfigCACHE_2Q != 0 )
+        {
+            BaseType_t xIn = xList + FF_CACHE_QUEUE_IN;
+            uint16_t usPoolSize;
+
+            #if ( ffconfigCACHE_POOLS != 0 )
+                usPoolSize = pxIOManager->xPools[ xPool ].usCount;
+            #else
+                usPoolSize = pxIOManager->usCacheSize;
+            #endif
+
+            /* Take from the FIFO queue once it holds more than a quarter of
+             * the pool, and from the main list otherwise.  Buffers that were
+             * never used are at the tail of the main list, they go first. */
+            if( ( pxIOManager->usListLength[ xIn ] > ( usPoolSize / 4U ) ) &&
+                ( ( pxIOManager->pxLRUTail[ xList ] == NULL ) ||
+                  ( pxIOManager->pxLRUTail[ xList ]->bValid != pdFALSE ) ||
+                  ( pxIOManager->pxLRUTail[ xList ]->usNumHandles != 0 ) ) )
+            {
+                xList = xIn;
+            }
+        }
+        #endif /* ffconfigCACHE_2Q */
+
+        for( xTry = 0; ( xTry < FF_CACHE_QUEUE_COUNT ) && ( pxRLUBuffer == NULL ); xTry++ )
+        {
+            /* Walk from the least recently used end.  Normally only a few buffers
+             * have handles, so an unused buffer is found after a few steps. */
+            for( pxBuffer = pxIOManager->pxLRUTail[ xList ]; pxBuffer != NULL; pxBuffer = pxBuffer->pxLRUPrev )
+            {
+                if( pxBuffer->usNumHandles == 0 )
+                {
+                    pxRLUBuffer = pxBuffer;
+                    break;
+                }
+            }
+
+            /* With 2Q, try the other queue of the same pool. */
+            xList ^= ( FF_CACHE_QUEUE_COUNT - 1 );
+        }
+
+        #if ( ffconfigCACHE_2Q != 0 )
+        {
+            if( ( pxRLUBuffer != NULL ) && ( pxRLUBuffer->ucQueue == FF_CACHE_QUEUE_IN ) && ( pxRLUBuffer->bValid != pdFALSE ) )
+            {
+                /* Remember the sector for a while, see prvBufferAdmit(). */
+                prvGhostRemember( pxIOManager, pxRLUBuffer->ulSector );
+            }
+        }
+        #endif /* ffconfigCACHE_2Q */
+    }
+    #else /* if ( ffconfigBUFFER_HASH_INDEX != 0 ) */
+    {
+        #if ( ffconfigCACHE_POOLS != 0 )
+            FF_Buffer_t * pxFirstBuffer = &( pxIOManager->pxBuffers[ pxIOManager->xPools[ xPool ].usFirst ] );
+            const FF_Buffer_t * pxLastBuffer = pxFirstBuffer + pxIOManager->xPools[ xPool ].usCount;
+        #else
+            FF_Buffer_t * pxFirstBuffer = pxIOManager->pxBuffers;
+            const FF_Buffer_t * pxLastBuffer = &( pxIOManager->pxBuffers[ pxIOManager->usCacheSize ] );
+
+            ( void ) xPool;
+        #endif
+
+        for( pxBuffer = pxFirstBuffer; pxBuffer < pxLastBuffer; pxBuffer++ )
+        {
+            if( pxBuffer->usNumHandles != 0 )
+            {
+                continue; /* Occupied */
+            }
+
+            pxBuffer->ulLRU += 1;
+
+            if( ( pxRLUBuffer == NULL ) ||
+                ( pxBuffer->ulLRU > pxRLUBuffer->ulLRU ) ||
+                ( ( pxBuffer->ulLRU == pxRLUBuffer->ulLRU ) && ( pxBuffer->usPersistence > pxRLUBuffer->usPersistence ) ) )
+            {
+                pxRLUBuffer = pxBuffer;
+            }
+        }
+    }
+    #endif /* if ( ffconfigBUFFER_HASH_INDEX != 0 ) */
+
+    #if ( ffconfigCACHE_POOLS != 0 )
+    {
+        if( ( pxRLUBuffer == NULL ) && ( xPool != FF_CACHE_POOL_DATA ) )
+        {
+            /* All buffers of the pool are in use, borrow one from the data pool. */
+            pxRLUBuffer = prvFindVictimBuffer( pxIOManager, FF_CACHE_POOL_DATA );
+        }
+    }
+    #endif
+
+    return pxRLUBuffer;
+} /* prvFindVictimBuffer() */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigCACHE_POOLS != 0 )
+
+    static BaseType_t prvSelectPool( FF_IOManager_t * pxIOManager,
+                                     uint32_t ulSector,
+                                     uint8_t ucMode )
+    {
+        const FF_Partition_t * pxPartition = &( pxIOManager->xPartition );
+        BaseType_t xPool;
+
+        if( ( ucMode & FF_MODE_FILE_DATA ) != 0 )
+        {
+            xPool = FF_CACHE_POOL_DATA;
+        }
+        else if( ( ulSector >= pxPartition->ulFATBeginLBA ) &&
+                 ( ( ulSector - pxPartition->ulFATBeginLBA ) < ( pxPartition->ulSectorsPerFAT * pxPartition->ucNumFATS ) ) )
+        {
+            xPool = FF_CACHE_POOL_FAT;
+        }
+        else
+        {
+            /* Directories, the boot sectors and FS info. */
+            xPool = FF_CACHE_POOL_DIR;
+        }
+
+        return xPool;
+    } /* prvSelectPool() */
+/*-----------------------------------------------------------*/
+
+#endif /* ffconfigCACHE_POOLS */
+
+#if ( ffconfigFLUSH_MERGE_SECTORS > 1 )
+
+    static int prvCompareBufferSectors( const void * pvLeft,
+                                        const void * pvRight )
+    {
+        const FF_Buffer_t * pxLeft = *( ( const FF_Buffer_t * const * ) pvLeft );
+        const FF_Buffer_t * pxRight = *( ( const FF_Buffer_t * const * ) pvRight );
+        int iResult;
+
+        if( pxLeft->ulSector < pxRight->ulSector )
+        {
+            iResult = -1;
+        }
+        else if( pxLeft->ulSector > pxRight->ulSector )
+        {
+            iResult = 1;
+        }
+        else
+        {
+            iResult = 0;
+        }
+
+        return iResult;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ *	@brief	Writes all modified buffers that have no handles. The buffers are
+ *          sorted on their sector number, so that a run of adjacent sectors
+ *          can be written with a single call to the driver.
+ *
+ *	@pre	The cache semaphore must be taken.
+ **/
+    static FF_Error_t prvFlushMergedBuffers( FF_IOManager_t * pxIOManager )
+    {
+        FF_Buffer_t ** ppxDirty = ( FF_Buffer_t ** ) pxIOManager->pucFlushMem;
+        uint8_t * pucBounce = pxIOManager->pucFlushMem + ( sizeof( FF_Buffer_t * ) * pxIOManager->usCacheSize );
+        uint8_t * pucSource;
+        FF_Error_t xError = FF_ERR_NONE;
+        int32_t lResult;
+        BaseType_t xCount = 0;
+        BaseType_t xFirst, xLast, xIndex;
+        BaseType_t xAdjacentInMemory;
+
+        for( xIndex = 0; xIndex < pxIOManager->usCacheSize; xIndex++ )
+        {
+            /* If a buffers has no users and if it has been modified... */
+            if( ( pxIOManager->pxBuffers[ xIndex ].usNumHandles == 0 ) && ( pxIOManager->pxBuffers[ xIndex ].bModified == pdTRUE ) )
+            {
+                ppxDirty[ xCount ] = &( pxIOManager->pxBuffers[ xIndex ] );
+                xCount++;
+            }
+        }
+
+        if( xCount > 1 )
+        {
+            qsort( ppxDirty, ( size_t ) xCount, sizeof( FF_Buffer_t * ), prvCompareBufferSectors );
+        }
+
+        for( xFirst = 0; xFirst < xCount; xFirst = xLast )
+        {
+            /* Find the end of a run of adjacent sectors. */
+            xAdjacentInMemory = pdTRUE;
+
+            for( xLast = xFirst + 1; xLast < xCount; xLast++ )
+            {
+                if( ( ( xLast - xFirst ) >= ffconfigFLUSH_MERGE_SECTORS ) ||
+                    ( ppxDirty[ xLast ]->ulSector != ( ppxDirty[ xLast - 1 ]->ulSector + 1U ) ) )
+                {
+                    break;
+                }
+
+                if( ppxDirty[ xLast ]->pucBuffer != ( ppxDirty[ xLast - 1 ]->pucBuffer + pxIOManager->usSectorSize ) )
+                {
+                    xAdjacentInMemory = pdFALSE;
+                }
+            }
+
+            if( xAdjacentInMemory != pdFALSE )
+            {
+                /* The sectors can be written straight from the cache. */
+                pucSource = ppxDirty[ xFirst ]->pucBuffer;
+            }
+            else
+            {
+                for( xIndex = xFirst; xIndex < xLast; xIndex++ )
+                {
+                    memcpy( pucBounce + ( ( size_t ) ( xIndex - xFirst ) * pxIOManager->usSectorSize ),
+                            ppxDirty[ xIndex ]->pucBuffer,
+                            pxIOManager->usSectorSize );
+                }
+
+                pucSource = pucBounce;
+            }
+
+            lResult = FF_BlockWrite( pxIOManager, ppxDirty[ xFirst ]->ulSector, ( uint32_t ) ( xLast - xFirst ), pucSource, pdTRUE );
+
+            pxIOManager->ulFlushWriteCount++;
+            pxIOManager->ulFlushMergeCount += ( uint32_t ) ( xLast - xFirst - 1 );
+
+            if( lResult < 0 )
+            {
+                /* Leave the buffers modified, so a later flush can retry. */
+                xError = lResult;
+            }
+            else
+            {
+                for( xIndex = xFirst; xIndex < xLast; xIndex++ )
+                {
+                    /* Buffer has now been flushed, mark it as a read buffer and unmodified.
+                     * A sector is never cached in more than one buffer. */
+                    ppxDirty[ xIndex ]->ucMode = FF_MODE_READ;
+                    ppxDirty[ xIndex ]->bModified = pdFALSE;
+                }
+            }
+        }
+
+        return xError;
+    } /* prvFlushMergedBuffers() */
+/*-----------------------------------------------------------*/
+
+#endif /* ffconfigFLUSH_MERGE_SECTORS */
+
+static uint32_t prvBufferWaitStart( FF_IOManager_t * pxIOManager,
+                                    uint32_t ulSector )
+{
+    BaseType_t xSlot;
+    uint32_t ulWaitBits = FF_BUF_LOCK;
+
+    for( xSlot = 0; xSlot < FF_BUF_WAIT_SLOTS; xSlot++ )
+    {
+        if( ( pxIOManager->ucBufferWaitSlots & ( 1U << xSlot ) ) == 0U )
+        {
+            pxIOManager->ucBufferWaitSlots |= ( uint8_t ) ( 1U << xSlot );
+            pxIOManager->ulBufferWaitSector[ xSlot ] = ulSector;
+            ulWaitBits = FF_BUF_WAIT_BIT( xSlot );
+            break;
+        }
+    }
+
+    if( ulWaitBits == FF_BUF_LOCK )
+    {
+        /* All slots are in use, wake up at every release. */
+        pxIOManager->ucBufferWaitOthers++;
+    }
+
+    return ulWaitBits;
+}
+/*-----------------------------------------------------------*/
+
+static void prvBufferWaitEnd( FF_IOManager_t * pxIOManager,
+                              uint32_t ulWaitBits )
+{
+    BaseType_t xSlot;
+
+    if( ulWaitBits == FF_BUF_LOCK )
+    {
+        pxIOManager->ucBufferWaitOthers--;
+    }
+    else
+    {
+        for( xSlot = 0; xSlot < FF_BUF_WAIT_SLOTS; xSlot++ )
+        {
+            if( ulWaitBits == FF_BUF_WAIT_BIT( xSlot ) )
+            {
+                pxIOManager->ucBufferWaitSlots &= ( uint8_t ) ~( 1U << xSlot );
+                break;
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvBufferWaitBits( const FF_IOManager_t * pxIOManager,
+                                   uint32_t ulSector )
+{
+    BaseType_t xSlot;
+    uint32_t ulWakeBits = 0U;
+
+    for( xSlot = 0; xSlot < FF_BUF_WAIT_SLOTS; xSlot++ )
+    {
+        if( ( ( pxIOManager->ucBufferWaitSlots & ( 1U << xSlot ) ) != 0U ) &&
+            ( ( pxIOManager->ulBufferWaitSector[ xSlot ] == ulSector ) ||
+              ( pxIOManager->ulBufferWaitSector[ xSlot ] == FF_BUF_WAIT_ANY ) ) )
+        {
+            ulWakeBits |= FF_BUF_WAIT_BIT( xSlot );
+        }
+    }
+
+    if( pxIOManager->ucBufferWaitOthers != 0U )
+    {
+        ulWakeBits |= FF_BUF_LOCK;
+    }
+
+    return ulWakeBits;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ *  A new version of FF_GetBuffer() with a simple mechanism for timeout
+ */
+#define FF_GETBUFFER_SLEEP_TIME_MS    10
+#define FF_GETBUFFER_WAIT_TIME_MS     ( 20000 / FF_GETBUFFER_SLEEP_TIME_MS )
+
+FF_Buffer_t * FF_GetBuffer( FF_IOManager_t * pxIOManager,
+                            uint32_t ulSector,
+                            uint8_t ucMode )
+{
+/* Least Recently Used Buffer */
+    FF_Buffer_t * pxRLUBuffer;
+    FF_Buffer_t * pxMatchingBuffer = NULL;
+    int32_t lRetVal;
+    BaseType_t xLoopCount = FF_GETBUFFER_WAIT_TIME_MS;
+    BaseType_t xPool;
+    uint32_t ulWaitBits = 0U;
+    uint32_t ulWaitSector;
+    BaseType_t xDirBlockHeld = pdFALSE;
+
+    /* 'pxIOManager->usCacheSize' is bigger than zero and it is a multiple of ulSectorSize. */
+
+    #if ( ffconfigCACHE_POOLS != 0 )
+    {
+        xPool = prvSelectPool( pxIOManager, ulSector, ucMode );
+    }
+    #else
+    {
+        xPool = FF_CACHE_POOL_DATA;
+    }
+    #endif
+
+    /* The pool hint is not part of the buffer mode. */
+    ucMode &= ( uint8_t ) ~FF_MODE_FILE_DATA;
+
+    while( pxMatchingBuffer == NULL )
+    {
+        xLoopCount--;
+
+        if( xLoopCount == 0 )
+        {
+            break;
+        }
+
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
+
+        if( ulWaitBits != 0U )
+        {
+            prvBufferWaitEnd( pxIOManager, ulWaitBits );
+            ulWaitBits = 0U;
+        }
+
+        #if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
+        {
+            if( ( ucMode & FF_MODE_WRITE ) != 0 )
+            {
+                if( ( pxIOManager->xDirBlockBuffer.usNumHandles != 0U ) &&
+                    ( pxIOManager->xDirBlockBuffer.ulSector == ulSector ) )
+                {
+                    /* A directory search is reading its copy of the sector,
+                     * which counts as a read handle. */
+                    xDirBlockHeld = pdTRUE;
+                }
+                else
+                {
+                    prvDirBlockDrop( pxIOManager, ulSector, 1U );
+                }
+            }
+        }
+        #endif
+
+        #if ( ffconfigREAD_AHEAD_SECTORS > 1 ) && ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        {
+            if( prvReadAheadHolds( pxIOManager, ulSector ) != pdFALSE )
+            {
+                prvReadAheadFinish( pxIOManager );
+            }
+        }
+        #endif
+
+        pxMatchingBuffer = prvFindBuffer( pxIOManager, ulSector );
+        ulWaitSector = FF_BUF_WAIT_ANY;
+
+        if( xDirBlockHeld != pdFALSE )
+        {
+            /* Wait until FF_DirBlockRelease() gives the sector back. */
+            pxMatchingBuffer = NULL;
+            ulWaitSector = ulSector;
+            xDirBlockHeld = pdFALSE;
+        }
+        else if( pxMatchingBuffer != NULL )
+        {
+            /* A Match was found process! */
+            if( ( ucMode == FF_MODE_READ ) && ( pxMatchingBuffer->ucMode == FF_MODE_READ ) )
+            {
+                pxMatchingBuffer->usNumHandles += 1;
+                pxMatchingBuffer->usPersistence += 1;
+            }
+            else if( pxMatchingBuffer->usNumHandles == 0 )
+            {
+                /* Copy the read & write flags. */
+                pxMatchingBuffer->ucMode = ( ucMode & FF_MODE_RD_WR );
+
+                if( ( ucMode & FF_MODE_WRITE ) != 0 )
+                {
+                    /* This buffer has no attached handles. */
+                    pxMatchingBuffer->bModified = pdTRUE;
+                }
+
+                pxMatchingBuffer->usNumHandles = 1;
+                pxMatchingBuffer->usPersistence += 1;
+            }
+            else
+            {
+                /* Sector is already in use in a different mode, keep yielding until its available! */
+                pxMatchingBuffer = NULL;
+                ulWaitSector = ulSector;
+            }
+
+            if( pxMatchingBuffer != NULL )
+            {
+                #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+                {
+                    prvBufferHit( pxIOManager, pxMatchingBuffer );
+                }
+                #endif
+                #if ( ffconfigCACHE_POOLS != 0 )
+                {
+                    pxIOManager->xPools[ xPool ].ulHits++;
+                }
+                #endif
+                break;
+            }
+        }
+        else
+        {
+            /* There is no valid buffer now for the desired sector.
+             * Find a free buffer and use it for that sector. */
+            pxRLUBuffer = prvFindVictimBuffer( pxIOManager, xPool );
+
+            /* A free buffer with the highest value of 'ulLRU' was found: */
+            if( pxRLUBuffer != NULL )
+            {
+                #if ( ffconfigCACHE_POOLS != 0 )
+                {
+                    pxIOManager->xPools[ xPool ].ulMisses++;
+                }
+                #endif
+
+                /* Process the suitable candidate. */
+                if( pxRLUBuffer->bModified == pdTRUE )
+                {
+                    /* Along with the pdTRUE parameter to indicate semaphore has been claimed already. */
+                    lRetVal = FF_BlockWrite( pxIOManager, pxRLUBuffer->ulSector, 1, pxRLUBuffer->pucBuffer, pdTRUE );
+
+                    if( lRetVal < 0 )
+                    {
+                        /* NULL will be returned because 'pxMatchingBuffer' is still NULL. */
+                        break;
+                    }
+                }
+
+                #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+                {
+                    if( pxRLUBuffer->bValid )
+                    {
+                        /* The buffer will get a new sector number. */
+                        prvBufferUnhash( pxIOManager, pxRLUBuffer );
+                    }
+                }
+                #endif
+
+                if( ucMode == FF_MODE_WR_ONLY )
+                {
+                    memset( pxRLUBuffer->pucBuffer, '\0', pxIOManager->usSectorSize );
+                }
+                else
+                {
+                    lRetVal = FF_BlockRead( pxIOManager, ulSector, 1, pxRLUBuffer->pucBuffer, pdTRUE );
+
+                    if( lRetVal < 0 )
+                    {
+                        /* The contents of the buffer are lost, and a modified
+                         * sector was written to disk already. */
+                        pxRLUBuffer->bValid = pdFALSE;
+                        pxRLUBuffer->bModified = pdFALSE;
+                        /* 'pxMatchingBuffer' is NULL. */
+                        break;
+                    }
+                }
+
+                pxRLUBuffer->ucMode = ( ucMode & FF_MODE_RD_WR );
+                pxRLUBuffer->usPersistence = 1;
+                pxRLUBuffer->ulLRU = 0;
+                pxRLUBuffer->usNumHandles = 1;
+                pxRLUBuffer->ulSector = ulSector;
+
+                pxRLUBuffer->bModified = ( ucMode & FF_MODE_WRITE ) != 0;
+
+                pxRLUBuffer->bValid = pdTRUE;
+
+                #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+                {
+                    FF_Buffer_t ** ppxBucket = prvBufferBucket( pxIOManager, ulSector );
+
+                    pxRLUBuffer->pxHashNext = *ppxBucket;
+                    *ppxBucket = pxRLUBuffer;
+                    prvBufferAdmit( pxIOManager, pxRLUBuffer );
+                }
+                #endif
+
+                pxMatchingBuffer = pxRLUBuffer;
+                break;
+            } /* if( pxRLUBuffer != NULL ) */
+        }     /* else ( pxMatchingBuffer == NULL ) */
+
+        /* The sector is in use in a conflicting mode, or all buffers have handles.
+         * Sleep until FF_ReleaseBuffer() frees the buffer that is needed, which
+         * gives a low-priority task a chance to release buffer(s).  The timeout
+         * only limits the total time spent in this loop. */
+        ulWaitBits = prvBufferWaitStart( pxIOManager, ulWaitSector );
+
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+
+        FF_BufferWait( pxIOManager, ulWaitBits, FF_GETBUFFER_SLEEP_TIME_MS );
+    } /* while( pxMatchingBuffer == NULL ) */
+
+    if( xLoopCount > 0 )
+    {
+        /* If xLoopCount is 0 here, the semaphore was not taken. */
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+    }
+    else if( ulWaitBits != 0U )
+    {
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
+        prvBufferWaitEnd( pxIOManager, ulWaitBits );
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+    }
+
+    if( pxMatchingBuffer == NULL )
+    {
+        FF_PRINTF( "FF_GetBuffer[0x%X]: failed mode 0x%X\n", ( unsigned ) ulSector, ( unsigned ) ucMode );
+    }
+
+    return pxMatchingBuffer; /* Return the Matched Buffer! */
+} /* FF_GetBuffer() */
+/*-----------------------------------------------------------*/
+
+/**
+ *	@brief	Releases a buffer resource.
+ *
+ *	@param	pxIOManager	Pointer to an FF_IOManager_t object.
+ *	@param	pxBuffer	Pointer to an FF_Buffer_t object.
+ *
+ **/
+FF_Error_t FF_ReleaseBuffer( FF_IOManager_t * pxIOManager,
+                             FF_Buffer_t * pxBuffer )
+{
+    FF_Error_t xError = FF_ERR_NONE;
+    uint32_t ulWakeBits = 0U;
+
+    /* Protect description changes with a semaphore. */
+    FF_PendSemaphore( pxIOManager->pvSemaphore );
+    {
+        if( pxBuffer->bDiscard != pdFALSE )
+        {
+            /* The sector was written directly to the disk, see FF_DiscardBuffers(). */
+            pxBuffer->bModified = pdFALSE;
+        }
+
+        #if ( ffconfigCACHE_WRITE_THROUGH != 0 )
+            if( pxBuffer->bModified == pdTRUE )
+            {
+                xError = FF_BlockWrite( pxIOManager, pxBuffer->ulSector, 1, pxBuffer->pucBuffer, pdTRUE );
+
+                if( FF_isERR( xError ) == pdFALSE )
+                {
+                    /* Ensure if an error occurs its still possible to write the block again. */
+                    pxBuffer->bModified = pdFALSE;
+                }
+            }
+        #endif /* if ( ffconfigCACHE_WRITE_THROUGH != 0 ) */
+        configASSERT( pxBuffer->usNumHandles != 0 );
+
+        if( pxBuffer->usNumHandles != 0 )
+        {
+            pxBuffer->usNumHandles--;
+
+            if( pxBuffer->usNumHandles == 0 )
+            {
+                pxBuffer->bDiscard = pdFALSE;
+
+                /* No handle conflicts with a new request any more. */
+                ulWakeBits = prvBufferWaitBits( pxIOManager, pxBuffer->ulSector );
+            }
+        }
+        else
+        {
+            /*printf ("FF_ReleaseBuffer: buffer not claimed\n"); */
+        }
+    }
+
+    FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+
+    if( ulWakeBits != 0U )
+    {
+        /* Notify tasks which are waiting in FF_GetBuffer() */
+        FF_BufferProceed( pxIOManager, ulWakeBits );
+    }
+
+    return xError;
+} /* FF_ReleaseBuffer() */
+/*-----------------------------------------------------------*/
+
+static FF_Error_t prvForEachBufferInRange( FF_IOManager_t * pxIOManager,
+                                           uint32_t ulSector,
+                                           uint32_t ulCount,
+                                           FF_Error_t ( * pxFunction )( FF_IOManager_t * pxIOManager,
+                                                                        FF_Buffer_t * pxBuffer ) )
+{
+    FF_Buffer_t * pxBuffer;
+    FF_Error_t xError = FF_ERR_NONE;
+
+    #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+        if( ulCount < pxIOManager->usCacheSize )
+        {
+            /* Fewer look-ups than there are buffers. */
+            for( ; ulCount != 0U; ulCount--, ulSector++ )
+            {
+                pxBuffer = prvFindBuffer( pxIOManager, ulSector );
+
+                if( pxBuffer != NULL )
+                {
+                    xError = pxFunction( pxIOManager, pxBuffer );
+
+                    if( FF_isERR( xError ) )
+                    {
+                        break;
+                    }
+                }
+            }
+        }
+        else
+    #endif /* ffconfigBUFFER_HASH_INDEX */
+    {
+        const FF_Buffer_t * pxLastBuffer = &( pxIOManager->pxBuffers[ pxIOManager->usCacheSize ] );
+
+        for( pxBuffer = pxIOManager->pxBuffers; pxBuffer < pxLastBuffer; pxBuffer++ )
+        {
+            if( ( pxBuffer->bValid != pdFALSE ) &&
+                ( pxBuffer->ulSector >= ulSector ) &&
+                ( ( pxBuffer->ulSector - ulSector ) < ulCount ) )
+            {
+                xError = pxFunction( pxIOManager, pxBuffer );
+
+                if( FF_isERR( xError ) )
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    return xError;
+} /* prvForEachBufferInRange() */
+/*-----------------------------------------------------------*/
+
+static FF_Error_t prvDiscardBuffer( FF_IOManager_t * pxIOManager,
+                                    FF_Buffer_t * pxBuffer )
+{
+    #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+    {
+        prvBufferUnhash( pxIOManager, pxBuffer );
+    }
+    #else
+    {
+        ( void ) pxIOManager;
+    }
+    #endif
+
+    pxBuffer->bValid = pdFALSE;
+    pxBuffer->bModified = pdFALSE;
+
+    if( pxBuffer->usNumHandles != 0 )
+    {
+        /* The holder keeps using the old contents until it releases the
+         * buffer, a new request for the sector gets another buffer. */
+        pxBuffer->bDiscard = pdTRUE;
+    }
+
+    return FF_ERR_NONE;
+} /* prvDiscardBuffer() */
+/*-----------------------------------------------------------*/
+
+/**
+ *	@brief	Forgets the cached copies of sectors that are about to be written
+ *          directly to the disk, i.e. without using the cache.
+ *
+ *	@param	pxIOManager	Pointer to an FF_IOManager_t object.
+ *	@param	ulSector	The first sector that will be written.
+ *	@param	ulCount		The number of sectors that will be written.
+ *
+ *	Otherwise a later read would return the old contents of a sector, and a
+ *	modified buffer would overwrite the new contents when it gets flushed.
+ *	A buffer that has handles is dropped when the last handle is released,
+ *	without writing it.
+ **/
+void FF_DiscardBuffers( FF_IOManager_t * pxIOManager,
+                        uint32_t ulSector,
+                        uint32_t ulCount )
+{
+    FF_PendSemaphore( pxIOManager->pvSemaphore );
+    {
+        #if ( ffconfigREAD_AHEAD_SECTORS > 1 ) && ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        {
+            /* Sectors read ahead must not be stored after they were written. */
+            prvReadAheadFinish( pxIOManager );
+        }
+        #endif
+
+        ( void ) prvForEachBufferInRange( pxIOManager, ulSector, ulCount, prvDiscardBuffer );
+    }
+    FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+} /* FF_DiscardBuffers() */
+/*-----------------------------------------------------------*/
+
+static FF_Error_t prvFlushBuffer( FF_IOManager_t * pxIOManager,
+                                  FF_Buffer_t * pxBuffer )
+{
+    FF_Error_t xError = FF_ERR_NONE;
+
+    if( ( pxBuffer->bModified != pdFALSE ) && ( pxBuffer->usNumHandles == 0 ) )
+    {
+        xError = FF_BlockWrite( pxIOManager, pxBuffer->ulSector, 1, pxBuffer->pucBuffer, pdTRUE );
+
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            pxBuffer->bModified = pdFALSE;
+            xError = FF_ERR_NONE;
+        }
+    }
+
+    return xError;
+} /* prvFlushBuffer() */
+/*-----------------------------------------------------------*/
+
+/**
+ *	@brief	Writes the modified cached copies of a range of sectors to the disk,
+ *          before these sectors are read directly, i.e. without using the cache.
+ *
+ *	@param	pxIOManager	Pointer to an FF_IOManager_t object.
+ *	@param	ulSector	The first sector that will be read.
+ *	@param	ulCount		The number of sectors that will be read.
+ *
+ *	@return	FF_ERR_NONE on success, or an error from the driver.
+ **/
+FF_Error_t FF_FlushBuffers( FF_IOManager_t * pxIOManager,
+                            uint32_t ulSector,
+                            uint32_t ulCount )
+{
+    FF_Error_t xError;
+
+    FF_PendSemaphore( pxIOManager->pvSemaphore );
+    {
+        xError = prvForEachBufferInRange( pxIOManager, ulSector, ulCount, prvFlushBuffer );
+    }
+    FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+
+    return xError;
+} /* FF_FlushBuffers() */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigREAD_AHEAD_SECTORS > 1 )
+
+    static int32_t prvReadAheadStore( FF_IOManager_t * pxIOManager,
+                                      uint32_t ulSector,
+                                      BaseType_t xCount,
+                                      BaseType_t xAdjacentInMemory,
+                                      int32_t lResult )
+    {
+        FF_Buffer_t * pxBuffer;
+        BaseType_t xIndex;
+
+        /* Insert the last sector first, so the sector that will be
+         * needed first becomes the most recently used one. */
+        for( xIndex = xCount - 1; xIndex >= 0; xIndex-- )
+        {
+            pxBuffer = pxIOManager->pxReadAheadBuffers[ xIndex ];
+            pxBuffer->usNumHandles = 0;
+
+            if( lResult >= 0 )
+            {
+                if( xAdjacentInMemory == pdFALSE )
+                {
+                    memcpy( pxBuffer->pucBuffer, pxIOManager->pucReadAheadMem + ( ( size_t ) xIndex * pxIOManager->usSectorSize ), pxIOManager->usSectorSize );
+                }
+
+                pxBuffer->ulSector = ulSector + ( uint32_t ) xIndex;
+                pxBuffer->ucMode = FF_MODE_READ;
+                pxBuffer->bModified = pdFALSE;
+                pxBuffer->usPersistence = 1;
+                pxBuffer->ulLRU = 0;
+                pxBuffer->bValid = pdTRUE;
+
+                #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+                {
+                    FF_Buffer_t ** ppxBucket = prvBufferBucket( pxIOManager, pxBuffer->ulSector );
+
+                    pxBuffer->pxHashNext = *ppxBucket;
+                    *ppxBucket = pxBuffer;
+                    prvBufferAdmit( pxIOManager, pxBuffer );
+                }
+                #endif
+            }
+        }
+
+        if( lResult >= 0 )
+        {
+            pxIOManager->ulReadAheadCount += ( uint32_t ) xCount;
+            lResult = ( int32_t ) xCount;
+        }
+
+        return lResult;
+    } /* prvReadAheadStore() */
+/*-----------------------------------------------------------*/
+
+    #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        static BaseType_t prvReadAheadHolds( const FF_IOManager_t * pxIOManager,
+                                             uint32_t ulSector )
+        {
+            return ( ( pxIOManager->usReadAheadPending != 0U ) &&
+                     ( ulSector >= pxIOManager->xReadAheadRequest.ulSectorAddress ) &&
+                     ( ( ulSector - pxIOManager->xReadAheadRequest.ulSectorAddress ) < pxIOManager->usReadAheadPending ) ) ? pdTRUE : pdFALSE;
+        } /* prvReadAheadHolds() */
+/*-----------------------------------------------------------*/
+
+/* Called with the semaphore taken.  The buffers of the read-ahead have a
+ * handle, so they can not be recycled while the driver fills them. */
+        static void prvReadAheadFinish( FF_IOManager_t * pxIOManager )
+        {
+            int32_t lResult;
+
+            if( pxIOManager->usReadAheadPending != 0U )
+            {
+                lResult = FF_BlockWait( &( pxIOManager->xReadAheadRequest ) );
+                ( void ) prvReadAheadStore( pxIOManager,
+                                            pxIOManager->xReadAheadRequest.ulSectorAddress,
+                                            ( BaseType_t ) pxIOManager->usReadAheadPending,
+                                            pxIOManager->xReadAheadAdjacent,
+                                            lResult );
+                pxIOManager->usReadAheadPending = 0U;
+            }
+        } /* prvReadAheadFinish() */
+/*-----------------------------------------------------------*/
+    #endif /* ffconfigASYNC_BLOCK_DEVICE */
+
+/**
+ *	@brief	Reads a run of sectors into the cache with a single call to the driver.
+ *
+ *	@param	pxIOManager	Pointer to an FF_IOManager_t object.
+ *	@param	ulSector	The sector that the caller is about to read.
+ *	@param	ulCount		The number of contiguous sectors that may be read, starting at 'ulSector'.
+ *
+ *	@return	The number of sectors that were read or submitted, or a negative error code.
+ *
+ *	At most ffconfigREAD_AHEAD_SECTORS are read.  The run stops at the first
+ *	sector that is already cached, or when there is no unused and unmodified
+ *	buffer to recycle: reading ahead never causes a write to the disk.
+ *
+ *	When the driver has fnSubmitBlocks(), the run is submitted and this
+ *	function returns without waiting for it.  'ulSector' itself is then left
+ *	to FF_GetBuffer(), which needs it right away, and the run starts after
+ *	it.  When the caller gets to the first sector of that run, the next run
+ *	is submitted, so that the driver reads while the caller uses the sectors
+ *	read before.  FF_GetBuffer() waits for a sector that is still in flight.
+ **/
+    int32_t FF_ReadAhead( FF_IOManager_t * pxIOManager,
+                          uint32_t ulSector,
+                          uint32_t ulCount )
+    {
+        FF_Buffer_t * pxBuffer;
+        uint8_t * pucTarget;
+        BaseType_t xCount = 0;
+        BaseType_t xAdjacentInMemory = pdTRUE;
+        uint32_t ulFirst = ulSector;
+        uint32_t ulEnd = ulSector + ulCount;
+        int32_t lResult = 0;
+
+        #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+            BaseType_t xSubmit = pdFALSE;
+        #endif
+
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
+        {
+            #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+            {
+                if( ( pxIOManager->xBlkDevice.fnpSubmitBlocks != NULL ) &&
+                    ( pxIOManager->xReadAheadRequest.pvDone != NULL ) &&
+                    ( xTaskGetSchedulerState() == taskSCHEDULER_RUNNING ) )
+                {
+                    xSubmit = pdTRUE;
+
+                    if( ( prvReadAheadHolds( pxIOManager, ulSector ) == pdFALSE ) &&
+                        ( prvFindBuffer( pxIOManager, ulSector ) == NULL ) )
+                    {
+                        /* A miss, read the sectors that follow it in the background. */
+                        ulFirst = ulSector + 1U;
+                    }
+                    else if( ( ulSector == pxIOManager->ulReadAheadMark ) &&
+                             ( pxIOManager->ulReadAheadNext > ulSector ) )
+                    {
+                        /* The caller got to the run read ahead last time. */
+                        ulFirst = pxIOManager->ulReadAheadNext;
+                    }
+                    else
+                    {
+                        ulFirst = ulEnd;
+                    }
+
+                    if( ulFirst < ulEnd )
+                    {
+                        /* There is one request at a time. */
+                        prvReadAheadFinish( pxIOManager );
+                    }
+                }
+            }
+            #endif /* ffconfigASYNC_BLOCK_DEVICE */
+
+            if( ( ulFirst < ulEnd ) && ( ( ulEnd - ulFirst ) > ffconfigREAD_AHEAD_SECTORS ) )
+            {
+                ulEnd = ulFirst + ffconfigREAD_AHEAD_SECTORS;
+            }
+
+            while( ( ulFirst + ( uint32_t ) xCount ) < ulEnd )
+            {
+                if( prvFindBuffer( pxIOManager, ulFirst + ( uint32_t ) xCount ) != NULL )
+                {
+                    break;
+                }
+
+                pxBuffer = prvFindVictimBuffer( pxIOManager, FF_CACHE_POOL_DATA );
+
+                if( ( pxBuffer == NULL ) || ( pxBuffer->bModified == pdTRUE ) )
                 {
-                    /* Along with the pdTRUE parameter to indicate semaphore has been claimed already. */
-                    lRetVal = FF_BlockWrite( pxIOManager, pxRLUBuffer->ulSector, 1, pxRLUBuffer->pucBuffer, pdTRUE );
+                    break;
+                }
 
-                    if( lRetVal < 0 )
+                #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+                {
+                    if( pxBuffer->bValid )
                     {
-                        /* NULL will be returned because 'pxMatchingBuffer' is still NULL. */
-                        break;
+                        prvBufferUnhash( pxIOManager, pxBuffer );
                     }
                 }
+                #endif
 
-                if( ucMode == FF_MODE_WR_ONLY )
+                /* Hold the buffer, so that it won't be chosen twice. */
+                pxBuffer->bValid = pdFALSE;
+                pxBuffer->usNumHandles = 1;
+
+                if( ( xCount > 0 ) && ( pxBuffer->pucBuffer != ( pxIOManager->pxReadAheadBuffers[ xCount - 1 ]->pucBuffer + pxIOManager->usSectorSize ) ) )
                 {
-                    memset( pxRLUBuffer->pucBuffer, '\0', pxIOManager->usSectorSize );
+                    xAdjacentInMemory = pdFALSE;
                 }
-                else
-                {
-                    lRetVal = FF_BlockRead( pxIOManager, ulSector, 1, pxRLUBuffer->pucBuffer, pdTRUE );
 
-                    if( lRetVal < 0 )
+                pxIOManager->pxReadAheadBuffers[ xCount ] = pxBuffer;
+                xCount++;
+            }
+
+            if( xCount > 0 )
+            {
+                pucTarget = ( xAdjacentInMemory != pdFALSE ) ? pxIOManager->pxReadAheadBuffers[ 0 ]->pucBuffer : pxIOManager->pucReadAheadMem;
+
+                #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+                    if( xSubmit != pdFALSE )
                     {
-                        /* 'pxMatchingBuffer' is NULL. */
-                        break;
+                        pxIOManager->xReadAheadRequest.pucBuffer = pucTarget;
+                        pxIOManager->xReadAheadRequest.ulSectorAddress = ulFirst;
+                        pxIOManager->xReadAheadRequest.ulCount = ( uint32_t ) xCount;
+                        pxIOManager->xReadAheadRequest.xWrite = pdFALSE;
+                        lResult = FF_BlockSubmit( pxIOManager, &( pxIOManager->xReadAheadRequest ) );
+
+                        if( lResult == 0 )
+                        {
+                            /* The buffers keep their handle until prvReadAheadFinish(). */
+                            pxIOManager->usReadAheadPending = ( uint16_t ) xCount;
+                            pxIOManager->xReadAheadAdjacent = xAdjacentInMemory;
+                            pxIOManager->ulReadAheadMark = ulFirst;
+                            pxIOManager->ulReadAheadNext = ulFirst + ( uint32_t ) xCount;
+                            lResult = ( int32_t ) xCount;
+                        }
+                        else
+                        {
+                            ( void ) prvReadAheadStore( pxIOManager, ulFirst, xCount, xAdjacentInMemory, lResult );
+                        }
                     }
+                    else
+                #endif /* ffconfigASYNC_BLOCK_DEVICE */
+                {
+                    lResult = FF_BlockRead( pxIOManager, ulFirst, ( uint32_t ) xCount, pucTarget, pdTRUE );
+                    lResult = prvReadAheadStore( pxIOManager, ulFirst, xCount, xAdjacentInMemory, lResult );
                 }
+            }
+        }
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
 
-                pxRLUBuffer->ucMode = ( ucMode & FF_MODE_RD_WR );
-                pxRLUBuffer->usPersistence = 1;
-                pxRLUBuffer->ulLRU = 0;
-                pxRLUBuffer->usNumHandles = 1;
-                pxRLUBuffer->ulSector = ulSector;
+        return lResult;
+    } /* FF_ReadAhead() */
+/*-----------------------------------------------------------*/
 
-                pxRLUBuffer->bModified = ( ucMode & FF_MODE_WRITE ) != 0;
+#endif /* ffconfigREAD_AHEAD_SECTORS */
 
-                pxRLUBuffer->bValid = pdTRUE;
-                pxMatchingBuffer = pxRLUBuffer;
-                break;
-            } /* if( pxRLUBuffer != NULL ) */
-        }     /* else ( pxMatchingBuffer == NULL ) */
+#if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
 
-        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+/**
+ *	@brief	Reads a run of directory sectors into 'pucDirBlockMem' with a single
+ *          call to the driver, see FF_FetchEntryWithContext().
+ *
+ *	@param	pxIOManager	Pointer to an FF_IOManager_t object.
+ *	@param	ulSector	The first sector to read.
+ *	@param	ulCount		The number of sectors wanted, at most ffconfigDIRECTORY_READ_SECTORS will be read.
+ *
+ *	@return	The number of sectors that may be used, or a negative error code.
+ *
+ *	A sector that is in the cache is copied from there, because the cached
+ *	copy may be more recent.  The run stops at a sector that is held in write
+ *	mode, its contents are still being changed.
+ **/
+    int32_t FF_DirBlockRead( FF_IOManager_t * pxIOManager,
+                             uint32_t ulSector,
+                             uint32_t ulCount )
+    {
+        FF_Buffer_t * pxBuffer;
+        uint32_t ulIndex = 0U;
+        int32_t lResult;
 
-        /* Better to go asleep to give low-priority task a chance to release buffer(s). */
-        FF_BufferWait( pxIOManager, FF_GETBUFFER_SLEEP_TIME_MS );
-    } /* while( pxMatchingBuffer == NULL ) */
+        if( ulCount > ffconfigDIRECTORY_READ_SECTORS )
+        {
+            ulCount = ffconfigDIRECTORY_READ_SECTORS;
+        }
 
-    if( xLoopCount > 0 )
-    {
-        /* If xLoopCount is 0 here, the semaphore was not taken. */
-        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
-    }
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
+        {
+            pxIOManager->ulDirBlockCount = 0U;
+            lResult = FF_BlockRead( pxIOManager, ulSector, ulCount, pxIOManager->pucDirBlockMem, pdTRUE );
 
-    if( pxMatchingBuffer == NULL )
-    {
-        FF_PRINTF( "FF_GetBuffer[0x%X]: failed mode 0x%X\n", ( unsigned ) ulSector, ( unsigned ) ucMode );
-    }
+            if( lResult >= 0 )
+            {
+                for( ; ulIndex < ulCount; ulIndex++ )
+                {
+                    pxBuffer = prvFindBuffer( pxIOManager, ulSector + ulIndex );
 
-    return pxMatchingBuffer; /* Return the Matched Buffer! */
-} /* FF_GetBuffer() */
+                    if( pxBuffer != NULL )
+                    {
+                        if( ( ( pxBuffer->ucMode & FF_MODE_WRITE ) != 0 ) && ( pxBuffer->usNumHandles != 0 ) )
+                        {
+                            break;
+                        }
+
+                        memcpy( pxIOManager->pucDirBlockMem + ( ( size_t ) ulIndex * pxIOManager->usSectorSize ), pxBuffer->pucBuffer, pxIOManager->usSectorSize );
+                    }
+                }
+
+                pxIOManager->ulDirBlockSector = ulSector;
+                pxIOManager->ulDirBlockCount = ulIndex;
+                lResult = ( int32_t ) ulIndex;
+            }
+        }
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+
+        return lResult;
+    } /* FF_DirBlockRead() */
 /*-----------------------------------------------------------*/
 
 /**
- *	@brief	Releases a buffer resource.
+ *	@brief	Gives back the sector of the directory block that the fetch context
+ *          'pvOwner' was reading, see FF_FetchEntryWithContext().
  *
  *	@param	pxIOManager	Pointer to an FF_IOManager_t object.
- *	@param	pxBuffer	Pointer to an FF_Buffer_t object.
+ *	@param	pvOwner		The fetch context.
+ *	@param	xDisown		pdTRUE when the context is done, another context may then use the block.
  *
+ *	The sector counts as a read handle while the context reads it, so a task
+ *	that wants it in write mode waits in FF_GetBuffer() until it is released.
  **/
-FF_Error_t FF_ReleaseBuffer( FF_IOManager_t * pxIOManager,
-                             FF_Buffer_t * pxBuffer )
-{
-    FF_Error_t xError = FF_ERR_NONE;
-
-    /* Protect description changes with a semaphore. */
-    FF_PendSemaphore( pxIOManager->pvSemaphore );
+    void FF_DirBlockRelease( FF_IOManager_t * pxIOManager,
+                             void * pvOwner,
+                             BaseType_t xDisown )
     {
-        #if ( ffconfigCACHE_WRITE_THROUGH != 0 )
-            if( pxBuffer->bModified == pdTRUE )
+        FF_Buffer_t * pxBlockBuffer = &( pxIOManager->xDirBlockBuffer );
+        uint32_t ulWakeBits = 0U;
+
+        FF_PendSemaphore( pxIOManager->pvSemaphore );
+        {
+            if( pxIOManager->pvDirBlockOwner == pvOwner )
             {
-                xError = FF_BlockWrite( pxIOManager, pxBuffer->ulSector, 1, pxBuffer->pucBuffer, pdTRUE );
+                if( pxBlockBuffer->usNumHandles != 0U )
+                {
+                    pxBlockBuffer->usNumHandles = 0U;
+                    ulWakeBits = prvBufferWaitBits( pxIOManager, pxBlockBuffer->ulSector );
+                }
 
-                if( FF_isERR( xError ) == pdFALSE )
+                if( xDisown != pdFALSE )
                 {
-                    /* Ensure if an error occurs its still possible to write the block again. */
-                    pxBuffer->bModified = pdFALSE;
+                    /* The contents of the block stay valid for the next user. */
+                    pxIOManager->pvDirBlockOwner = NULL;
                 }
             }
-        #endif /* if ( ffconfigCACHE_WRITE_THROUGH != 0 ) */
-        configASSERT( pxBuffer->usNumHandles != 0 );
-
-        if( pxBuffer->usNumHandles != 0 )
-        {
-            pxBuffer->usNumHandles--;
         }
-        else
+        FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+
+        if( ulWakeBits != 0U )
         {
-            /*printf ("FF_ReleaseBuffer: buffer not claimed\n"); */
+            /* Notify tasks which are waiting in FF_GetBuffer() */
+            FF_BufferProceed( pxIOManager, ulWakeBits );
         }
-    }
-
-    FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+    } /* FF_DirBlockRelease() */
+/*-----------------------------------------------------------*/
 
-    /* Notify tasks which may be waiting in FF_GetBuffer() */
-    FF_BufferProceed( pxIOManager );
+/* A change to the sectors from 'ulSector' onward makes the directory block
+ * end right before it.  Called with the semaphore taken. */
+    static void prvDirBlockDrop( FF_IOManager_t * pxIOManager,
+                                 uint32_t ulSector,
+                                 uint32_t ulCount )
+    {
+        uint32_t ulFirst = pxIOManager->ulDirBlockSector;
 
-    return xError;
-} /* FF_ReleaseBuffer() */
+        if( ( ulSector < ( ulFirst + pxIOManager->ulDirBlockCount ) ) && ( ( ulSector + ulCount ) > ulFirst ) )
+        {
+            pxIOManager->ulDirBlockCount = ( ulSector > ulFirst ) ? ( ulSector - ulFirst ) : 0U;
+        }
+    } /* prvDirBlockDrop() */
 /*-----------------------------------------------------------*/
 
+#endif /* ffconfigDIRECTORY_READ_SECTORS */
+
 /* New Interface for FreeRTOS+FAT to read blocks. */
 int32_t FF_BlockRead( FF_IOManager_t * pxIOManager,
                       uint32_t ulSectorLBA,
@@ -656,6 +2253,24 @@ int32_t FF_BlockWrite( FF_IOManager_t * pxIOManager,
 
     if( ( slRetVal == 0ul ) && ( pxIOManager->xBlkDevice.fnpWriteBlocks != NULL ) )
     {
+        #if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
+        {
+            /* Sectors written to the disk directly must be read again.  The
+             * directory block is shared, change it under the semaphore. */
+            if( xSemLocked == pdFALSE )
+            {
+                FF_PendSemaphore( pxIOManager->pvSemaphore );
+            }
+
+            prvDirBlockDrop( pxIOManager, ulSectorLBA, ulNumSectors );
+
+            if( xSemLocked == pdFALSE )
+            {
+                FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+            }
+        }
+        #endif
+
         do
         { /* Make sure we don't execute a NULL. */
             if( ( xSemLocked == pdFALSE ) &&
@@ -688,6 +2303,101 @@ int32_t FF_BlockWrite( FF_IOManager_t * pxIOManager,
 } /* FF_BlockWrite() */
 /*-----------------------------------------------------------*/
 
+#if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+
+/* Called by the driver when a submitted transfer has finished. */
+    static void prvBlockDone( FF_BlockRequest_t * pxRequest,
+                              int32_t lResult,
+                              BaseType_t * pxHigherPriorityTaskWoken )
+    {
+        pxRequest->lResult = lResult;
+
+        if( pxHigherPriorityTaskWoken != NULL )
+        {
+            ( void ) xSemaphoreGiveFromISR( ( SemaphoreHandle_t ) pxRequest->pvDone, pxHigherPriorityTaskWoken );
+        }
+        else
+        {
+            ( void ) xSemaphoreGive( ( SemaphoreHandle_t ) pxRequest->pvDone );
+        }
+    } /* prvBlockDone() */
+/*-----------------------------------------------------------*/
+
+/* Start the transfer described by 'pxRequest' without waiting for it.  The
+ * caller fills in pucBuffer, ulSectorAddress, ulCount, xWrite and pvDone, a
+ * binary semaphore that is not taken.  When 0 is returned, FF_BlockWait()
+ * must be called before the buffer or the request is used again. */
+    int32_t FF_BlockSubmit( FF_IOManager_t * pxIOManager,
+                            FF_BlockRequest_t * pxRequest )
+    {
+        int32_t slRetVal = 0;
+
+        if( pxIOManager->xPartition.ulTotalSectors != 0ul )
+        {
+            if( ( pxRequest->ulSectorAddress + pxRequest->ulCount ) > ( pxIOManager->xPartition.ulTotalSectors + pxIOManager->xPartition.ulBeginLBA ) )
+            {
+                if( pxRequest->xWrite != pdFALSE )
+                {
+                    slRetVal = FF_createERR( FF_ERR_IOMAN_OUT_OF_BOUNDS_WRITE, FF_BLOCKWRITE );
+                }
+                else
+                {
+                    slRetVal = FF_createERR( FF_ERR_IOMAN_OUT_OF_BOUNDS_READ, FF_BLOCKREAD );
+                }
+            }
+        }
+
+        if( ( slRetVal == 0 ) && ( pxIOManager->xBlkDevice.fnpSubmitBlocks == NULL ) )
+        {
+            slRetVal = FF_createERR( FF_ERR_NULL_POINTER, ( pxRequest->xWrite != pdFALSE ) ? FF_BLOCKWRITE : FF_BLOCKREAD );
+        }
+
+        if( slRetVal == 0 )
+        {
+            pxRequest->pxDisk = pxIOManager->xBlkDevice.pxDisk;
+            pxRequest->fnDone = prvBlockDone;
+            pxRequest->lResult = 0;
+
+            do
+            {
+                /* Only the submission is protected, the transfer itself may
+                 * run while other tasks use the driver. */
+                if( ( pxIOManager->ucFlags & FF_IOMAN_BLOCK_DEVICE_IS_REENTRANT ) == pdFALSE )
+                {
+                    FF_PendSemaphore( pxIOManager->pvSemaphore );
+                }
+
+                slRetVal = pxIOManager->xBlkDevice.fnpSubmitBlocks( pxRequest, pxRequest->pxDisk );
+
+                if( ( pxIOManager->ucFlags & FF_IOMAN_BLOCK_DEVICE_IS_REENTRANT ) == pdFALSE )
+                {
+                    FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+                }
+
+                if( slRetVal != ( int32_t ) FF_ERR_DRIVER_BUSY )
+                {
+                    break;
+                }
+
+                FF_Sleep( ffconfigDRIVER_BUSY_SLEEP_MS );
+            } while( pdTRUE );
+        }
+
+        return slRetVal;
+    } /* FF_BlockSubmit() */
+/*-----------------------------------------------------------*/
+
+/* Wait for a transfer started with FF_BlockSubmit(), and return its result. */
+    int32_t FF_BlockWait( FF_BlockRequest_t * pxRequest )
+    {
+        ( void ) xSemaphoreTake( ( SemaphoreHandle_t ) pxRequest->pvDone, portMAX_DELAY );
+
+        return pxRequest->lResult;
+    } /* FF_BlockWait() */
+/*-----------------------------------------------------------*/
+
+#endif /* ffconfigASYNC_BLOCK_DEVICE */
+
 /*
  * This global variable is a kind of expert option:
  * It may be set to one of these values: FF_T_FAT[12,16,32]
@@ -1483,6 +3193,25 @@ FF_Error_t FF_Mount( FF_Disk_t * pxDisk,
         #if ( ffconfigPATH_CACHE != 0 )
         {
             memset( pxPartition->pxPathCache, '\0', sizeof( pxPartition->pxPathCache ) );
+            pxPartition->ulPCClock = 0;
+            pxPartition->ulPCHits = 0;
+            pxPartition->ulPCMisses = 0;
+        }
+        #endif
+        #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+        {
+            FF_StopFreeScan( pxIOManager );
+        }
+        #endif
+        #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+        {
+            /* A bitmap of a previous mount would not be valid anymore. */
+            FF_ReleaseFreeBitmap( pxIOManager );
+        }
+        #endif
+        #if ( ffconfigLFN_INDEX != 0 )
+        {
+            FF_LFNIndexFlush( pxIOManager );
         }
         #endif
         FF_IOMAN_InitBufferDescriptors( pxIOManager );
@@ -1632,30 +3361,44 @@ FF_Error_t FF_Mount( FF_Disk_t * pxDisk,
         pxPartition->ulLastFreeCluster = 0;
         #if ( ffconfigMOUNT_FIND_FREE != 0 )
         {
-            FF_LockFAT( pxIOManager );
+            BaseType_t xScanning = pdFALSE;
+
+            #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
             {
-                /* The parameter 'pdFALSE' means: do not claim the free cluster found. */
-                pxPartition->ulLastFreeCluster = FF_FindFreeCluster( pxIOManager, &xError, pdFALSE );
+                /* Let a task count the free clusters, FF_Mount() does not wait for it.
+                 * The first free cluster will be looked up when it is needed. */
+                pxPartition->ulFreeClusterCount = 0;
+                xScanning = FF_StartFreeScan( pxIOManager );
             }
-            FF_UnlockFAT( pxIOManager );
+            #endif
 
-            if( FF_isERR( xError ) )
+            if( xScanning == pdFALSE )
             {
-                if( FF_GETERROR( xError ) == FF_ERR_IOMAN_NOT_ENOUGH_FREE_SPACE )
+                FF_LockFAT( pxIOManager );
                 {
-                    pxPartition->ulLastFreeCluster = 0;
+                    /* The parameter 'pdFALSE' means: do not claim the free cluster found. */
+                    pxPartition->ulLastFreeCluster = FF_FindFreeCluster( pxIOManager, &xError, pdFALSE );
                 }
-                else
+                FF_UnlockFAT( pxIOManager );
+
+                if( FF_isERR( xError ) )
                 {
-                    break;
+                    if( FF_GETERROR( xError ) == FF_ERR_IOMAN_NOT_ENOUGH_FREE_SPACE )
+                    {
+                        pxPartition->ulLastFreeCluster = 0;
+                    }
+                    else
+                    {
+                        break;
+                    }
                 }
-            }
 
-            pxPartition->ulFreeClusterCount = FF_CountFreeClusters( pxIOManager, &xError );
+                pxPartition->ulFreeClusterCount = FF_CountFreeClusters( pxIOManager, &xError );
 
-            if( FF_isERR( xError ) )
-            {
-                break;
+                if( FF_isERR( xError ) )
+                {
+                    break;
+                }
             }
         }
         #else /* if ( ffconfigMOUNT_FIND_FREE != 0 ) */
@@ -1741,6 +3484,13 @@ FF_Error_t FF_Unmount( FF_Disk_t * pxDisk )
         pxIOManager = pxDisk->pxIOManager;
         FF_PendSemaphore( pxIOManager->pvSemaphore ); /* Ensure that there are no File Handles */
         {
+            #if ( ffconfigREAD_AHEAD_SECTORS > 1 ) && ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+            {
+                /* The buffers of a read-ahead have a handle until it is finished. */
+                prvReadAheadFinish( pxIOManager );
+            }
+            #endif
+
             if( prvHasActiveHandles( pxIOManager ) != 0 )
             {
                 /* Active handles found on the cache. */
@@ -1755,6 +3505,12 @@ FF_Error_t FF_Unmount( FF_Disk_t * pxDisk )
             {
                 /* Release Semaphore to call this function! */
                 FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
+                #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+                {
+                    /* The scan task uses the cache, and it needs the semaphore. */
+                    FF_StopFreeScan( pxIOManager );
+                }
+                #endif
                 /* Flush any unwritten sectors to disk. */
                 xError = FF_FlushCache( pxIOManager );
                 /* Reclaim Semaphore */
@@ -1764,6 +3520,18 @@ FF_Error_t FF_Unmount( FF_Disk_t * pxDisk )
                 {
                     pxIOManager->xPartition.ucPartitionMounted = pdFALSE;
 
+                    #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+                    {
+                        FF_ReleaseFreeBitmap( pxIOManager );
+                    }
+                    #endif
+
+                    #if ( ffconfigLFN_INDEX != 0 )
+                    {
+                        FF_LFNIndexFlush( pxIOManager );
+                    }
+                    #endif
+
                     #if ( ffconfigMIRROR_FATS_UMOUNT != 0 )
                     {
                         FF_ReleaseSemaphore( pxIOManager->pvSemaphore );
@@ -1799,6 +3567,47 @@ FF_Error_t FF_Unmount( FF_Disk_t * pxDisk )
 } /* FF_Unmount() */
 /*-----------------------------------------------------------*/
 
+#if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+
+/* While the background scan is running, changes in the number of free
+ * clusters are added to its count.  Returns pdFALSE when the scan has finished
+ * and ulFreeClusterCount must be updated instead. */
+    static BaseType_t prvFreeScanAdd( FF_IOManager_t * pxIOManager,
+                                      uint32_t ulCount )
+    {
+        BaseType_t xResult = pdFALSE;
+
+        taskENTER_CRITICAL();
+        {
+            if( pxIOManager->xPartition.ucFreeScanBusy != pdFALSE )
+            {
+                pxIOManager->xPartition.ulScanFree += ulCount;
+                xResult = pdTRUE;
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        return xResult;
+    }
+#endif /* ffconfigBACKGROUND_FREE_SCAN */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigWRITE_FREE_COUNT != 0 )
+    /* The free count to be stored in the FSINFO sector, 0xFFFFFFFF when it is not known. */
+    static uint32_t prvFSInfoFreeCount( FF_IOManager_t * pxIOManager )
+    {
+        uint32_t ulCount = pxIOManager->xPartition.ulFreeClusterCount;
+
+        if( FF_FreeScanBusy( pxIOManager ) != pdFALSE )
+        {
+            ulCount = ~( ( uint32_t ) 0U );
+        }
+
+        return ulCount;
+    }
+#endif /* ffconfigWRITE_FREE_COUNT */
+/*-----------------------------------------------------------*/
+
 FF_Error_t FF_IncreaseFreeClusters( FF_IOManager_t * pxIOManager,
                                     uint32_t Count )
 {
@@ -1811,6 +3620,14 @@ FF_Error_t FF_IncreaseFreeClusters( FF_IOManager_t * pxIOManager,
     do
     {
         /* Open a do {} while( pdFALSE ) loop to allow the use of break statements. */
+        #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+            if( prvFreeScanAdd( pxIOManager, Count ) != pdFALSE )
+            {
+                /* The background scan will set ulFreeClusterCount. */
+                xError = FF_ERR_NONE;
+            }
+            else
+        #endif
         if( pxIOManager->xPartition.ulFreeClusterCount == 0ul )
         {
             /* Apparently the number of free clusters has not been calculated yet,
@@ -1879,7 +3696,7 @@ FF_Error_t FF_IncreaseFreeClusters( FF_IOManager_t * pxIOManager,
                         ( ulSignature2 == FS_INFO_SIGNATURE2_0x61417272 ) )
                     {
                         /* FSINFO sector magic numbers we're verified. Safe to write. */
-                        FF_putLong( pxBuffer->pucBuffer, FS_INFO_OFFSET_FREE_COUNT_488, pxIOManager->xPartition.ulFreeClusterCount );
+                        FF_putLong( pxBuffer->pucBuffer, FS_INFO_OFFSET_FREE_COUNT_488, prvFSInfoFreeCount( pxIOManager ) );
                         FF_putLong( pxBuffer->pucBuffer, FS_INFO_OFFSET_FREE_CLUSTER_492, pxIOManager->xPartition.ulLastFreeCluster );
                     }
 
@@ -1904,6 +3721,13 @@ FF_Error_t FF_DecreaseFreeClusters( FF_IOManager_t * pxIOManager,
         FF_Buffer_t * pxBuffer;
     #endif
 
+    #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+        if( prvFreeScanAdd( pxIOManager, 0ul - Count ) != pdFALSE )
+        {
+            /* The background scan will set ulFreeClusterCount. */
+        }
+        else
+    #endif
     if( pxIOManager->xPartition.ulFreeClusterCount == 0ul )
     {
         pxIOManager->xPartition.ulFreeClusterCount = FF_CountFreeClusters( pxIOManager, &xError );
@@ -1947,7 +3771,7 @@ FF_Error_t FF_DecreaseFreeClusters( FF_IOManager_t * pxIOManager,
                         ( FF_getLong( pxBuffer->pucBuffer, FS_INFO_OFFSET_SIGNATURE2_484 ) == FS_INFO_SIGNATURE2_0x61417272 ) )
                     {
                         /* FSINFO sector magic nums we're verified. Safe to write. */
-                        FF_putLong( pxBuffer->pucBuffer, FS_INFO_OFFSET_FREE_COUNT_488, pxIOManager->xPartition.ulFreeClusterCount );
+                        FF_putLong( pxBuffer->pucBuffer, FS_INFO_OFFSET_FREE_COUNT_488, prvFSInfoFreeCount( pxIOManager ) );
                         FF_putLong( pxBuffer->pucBuffer, FS_INFO_OFFSET_FREE_CLUSTER_492, pxIOManager->xPartition.ulLastFreeCluster );
                     }
 
@@ -53,8 +53,13 @@
 #define FF_FAT_LOCK_EVENT_BITS    ( ( const EventBits_t ) FF_FAT_LOCK )
 #define FF_DIR_LOCK_EVENT_BITS    ( ( const EventBits_t ) FF_DIR_LOCK )
 
+/* This bit is high as long as no task owns the FAT, or waits to own it.
+ * Tasks that want shared access to the FAT wait for it, see FF_LockFATShared(). */
+#define FF_FAT_SHARED_LOCK_EVENT_BITS    ( ( const EventBits_t ) FF_FAT_SHARED_LOCK )
+
 /* This is not a real lock: it is a bit (or semaphore) will will be given
- * each time when a sector buffer is released. */
+ * when a sector buffer is released while tasks wait for it.  Tasks that
+ * got a wait slot use the bits FF_BUF_WAIT_BIT( x ) instead. */
 #define FF_BUF_LOCK_EVENT_BITS    ( ( const EventBits_t ) FF_BUF_LOCK )
 
 #ifndef FF_TIME_TO_WAIT_FOR_EVENT_TICKS
@@ -129,6 +134,21 @@ void FF_DeleteEvents( FF_IOManager_t * pxIOManager )
     {
         vEventGroupDelete( pxIOManager->xEventGroup );
     }
+
+    #if ( ffconfigDIRECTORY_LOCKS != 0 )
+    {
+        BaseType_t xIndex;
+
+        for( xIndex = 0; xIndex < ffconfigDIRECTORY_LOCKS; xIndex++ )
+        {
+            if( pxIOManager->pvDirectoryLocks[ xIndex ] != NULL )
+            {
+                vSemaphoreDelete( ( SemaphoreHandle_t ) pxIOManager->pvDirectoryLocks[ xIndex ] );
+                pxIOManager->pvDirectoryLocks[ xIndex ] = NULL;
+            }
+        }
+    }
+    #endif /* ffconfigDIRECTORY_LOCKS */
 }
 /*-----------------------------------------------------------*/
 
@@ -141,7 +161,7 @@ BaseType_t FF_CreateEvents( FF_IOManager_t * pxIOManager )
     if( pxIOManager->xEventGroup != NULL )
     {
         xEventGroupSetBits( pxIOManager->xEventGroup,
-                            FF_FAT_LOCK_EVENT_BITS | FF_DIR_LOCK_EVENT_BITS | FF_BUF_LOCK_EVENT_BITS );
+                            FF_FAT_LOCK_EVENT_BITS | FF_DIR_LOCK_EVENT_BITS | FF_BUF_LOCK_EVENT_BITS | FF_FAT_SHARED_LOCK_EVENT_BITS );
         xResult = pdTRUE;
     }
     else
@@ -149,6 +169,23 @@ BaseType_t FF_CreateEvents( FF_IOManager_t * pxIOManager )
         xResult = pdFALSE;
     }
 
+    #if ( ffconfigDIRECTORY_LOCKS != 0 )
+    {
+        BaseType_t xIndex;
+
+        for( xIndex = 0; ( xIndex < ffconfigDIRECTORY_LOCKS ) && ( xResult != pdFALSE ); xIndex++ )
+        {
+            pxIOManager->pvDirectoryLocks[ xIndex ] = ( void * ) xSemaphoreCreateRecursiveMutex();
+
+            if( pxIOManager->pvDirectoryLocks[ xIndex ] == NULL )
+            {
+                /* FF_DeleteEvents() will delete the locks created so far. */
+                xResult = pdFALSE;
+            }
+        }
+    }
+    #endif /* ffconfigDIRECTORY_LOCKS */
+
     return xResult;
 }
 /*-----------------------------------------------------------*/
@@ -159,7 +196,11 @@ void FF_LockDirectory( FF_IOManager_t * pxIOManager )
      * It waits for the desired bit to come high, and clears the
      * bit so that other tasks can not take it. */
 
-    EventBits_t xBits;
+    #if ( ffconfigDIRECTORY_LOCKS != 0 )
+        BaseType_t xIndex;
+    #else
+        EventBits_t xBits;
+    #endif
 
     if( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING )
     {
@@ -167,6 +208,16 @@ void FF_LockDirectory( FF_IOManager_t * pxIOManager )
         return;
     }
 
+    #if ( ffconfigDIRECTORY_LOCKS != 0 )
+    {
+        /* Take the lock of every directory, always in the same order so
+         * that two tasks doing this can not dead-lock. */
+        for( xIndex = 0; xIndex < ffconfigDIRECTORY_LOCKS; xIndex++ )
+        {
+            FF_PendSemaphore( pxIOManager->pvDirectoryLocks[ xIndex ] );
+        }
+    }
+    #else /* if ( ffconfigDIRECTORY_LOCKS != 0 ) */
     for( ; ; )
     {
         xEventGroupWaitBits( pxIOManager->xEventGroup,
@@ -188,19 +239,100 @@ void FF_LockDirectory( FF_IOManager_t * pxIOManager )
             break;
         }
     }
+    #endif /* if ( ffconfigDIRECTORY_LOCKS != 0 ) */
 }
 /*-----------------------------------------------------------*/
 
 void FF_UnlockDirectory( FF_IOManager_t * pxIOManager )
 {
+    #if ( ffconfigDIRECTORY_LOCKS != 0 )
+        BaseType_t xIndex;
+    #endif
+
     if( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING )
     {
         /* Scheduler not yet active. */
         return;
     }
 
-    configASSERT( ( xEventGroupGetBits( pxIOManager->xEventGroup ) & FF_DIR_LOCK_EVENT_BITS ) == 0 );
-    xEventGroupSetBits( pxIOManager->xEventGroup, FF_DIR_LOCK_EVENT_BITS );
+    #if ( ffconfigDIRECTORY_LOCKS != 0 )
+    {
+        for( xIndex = ffconfigDIRECTORY_LOCKS - 1; xIndex >= 0; xIndex-- )
+        {
+            FF_ReleaseSemaphore( pxIOManager->pvDirectoryLocks[ xIndex ] );
+        }
+    }
+    #else
+    {
+        configASSERT( ( xEventGroupGetBits( pxIOManager->xEventGroup ) & FF_DIR_LOCK_EVENT_BITS ) == 0 );
+        xEventGroupSetBits( pxIOManager->xEventGroup, FF_DIR_LOCK_EVENT_BITS );
+    }
+    #endif /* if ( ffconfigDIRECTORY_LOCKS != 0 ) */
+}
+/*-----------------------------------------------------------*/
+
+void FF_LockDirectoryCluster( FF_IOManager_t * pxIOManager,
+                              uint32_t ulDirCluster )
+{
+    /* Called when a task wants to make changes to a single directory.
+     * Without a table of directory locks, all directories are locked. */
+    #if ( ffconfigDIRECTORY_LOCKS != 0 )
+    {
+        FF_PendSemaphore( pxIOManager->pvDirectoryLocks[ ulDirCluster % ffconfigDIRECTORY_LOCKS ] );
+    }
+    #else
+    {
+        ( void ) ulDirCluster;
+        FF_LockDirectory( pxIOManager );
+    }
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+void FF_UnlockDirectoryCluster( FF_IOManager_t * pxIOManager,
+                                uint32_t ulDirCluster )
+{
+    #if ( ffconfigDIRECTORY_LOCKS != 0 )
+    {
+        FF_ReleaseSemaphore( pxIOManager->pvDirectoryLocks[ ulDirCluster % ffconfigDIRECTORY_LOCKS ] );
+    }
+    #else
+    {
+        ( void ) ulDirCluster;
+        FF_UnlockDirectory( pxIOManager );
+    }
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvIsFATReader( FF_IOManager_t * pxIOManager,
+                                  void * pvHandle )
+{
+    BaseType_t xReturn = pdFALSE;
+
+    #if ( ffconfigFAT_LOCK_READERS != 0 )
+    {
+        BaseType_t xIndex;
+
+        /* Only the task itself adds or removes its own handle, so there is
+         * no need to suspend the scheduler here. */
+        for( xIndex = 0; xIndex < ffconfigFAT_LOCK_READERS; xIndex++ )
+        {
+            if( pxIOManager->pvFATLockReaders[ xIndex ] == pvHandle )
+            {
+                xReturn = pdTRUE;
+                break;
+            }
+        }
+    }
+    #else
+    {
+        ( void ) pxIOManager;
+        ( void ) pvHandle;
+    }
+    #endif /* if ( ffconfigFAT_LOCK_READERS != 0 ) */
+
+    return xReturn;
 }
 /*-----------------------------------------------------------*/
 
@@ -217,12 +349,16 @@ int FF_Has_Lock( FF_IOManager_t * pxIOManager,
 
     void * handle = xTaskGetCurrentTaskHandle();
 
-    if( ( aBits & FF_FAT_LOCK_EVENT_BITS ) != 0 )
+    if( ( aBits & ( FF_FAT_LOCK_EVENT_BITS | FF_FAT_SHARED_LOCK_EVENT_BITS ) ) != 0 )
     {
         if( ( pxIOManager->pvFATLockHandle != NULL ) && ( pxIOManager->pvFATLockHandle == handle ) )
         {
             iReturn = pdTRUE;
         }
+        else if( ( aBits & FF_FAT_SHARED_LOCK_EVENT_BITS ) != 0 )
+        {
+            iReturn = ( int ) prvIsFATReader( pxIOManager, handle );
+        }
         else
         {
             iReturn = pdFALSE;
@@ -256,6 +392,10 @@ void FF_Assert_Lock( FF_IOManager_t * pxIOManager,
         ( void ) pxIOManager;
         ( void ) handle;
     }
+    else if( ( aBits & FF_FAT_SHARED_LOCK_EVENT_BITS ) != 0 )
+    {
+        configASSERT( FF_Has_Lock( pxIOManager, FF_FAT_SHARED_LOCK ) != pdFALSE );
+    }
 }
 
 void FF_LockFAT( FF_IOManager_t * pxIOManager )
@@ -272,7 +412,21 @@ void FF_LockFAT( FF_IOManager_t * pxIOManager )
         return;
     }
 
-    configASSERT( FF_Has_Lock( pxIOManager, FF_FAT_LOCK ) == pdFALSE );
+    /* A task that holds a shared lock can not upgrade it. */
+    configASSERT( FF_Has_Lock( pxIOManager, FF_FAT_SHARED_LOCK ) == pdFALSE );
+
+    #if ( ffconfigFAT_LOCK_READERS != 0 )
+    {
+        /* Stop admitting new readers, the FAT lock bit will come high when
+         * the last reader is done. */
+        vTaskSuspendAll();
+        {
+            pxIOManager->ucFATLockWritersWaiting++;
+            ( void ) xEventGroupClearBits( pxIOManager->xEventGroup, FF_FAT_SHARED_LOCK_EVENT_BITS );
+        }
+        ( void ) xTaskResumeAll();
+    }
+    #endif
 
     for( ; ; )
     {
@@ -292,8 +446,20 @@ void FF_LockFAT( FF_IOManager_t * pxIOManager )
         {
             /* This task has cleared the desired bit.
              * It now 'owns' the resource. */
+            #if ( ffconfigFAT_LOCK_READERS != 0 )
+            {
+                /* A reader must either see a waiting writer, or an owner. */
+                vTaskSuspendAll();
+                pxIOManager->ucFATLockWritersWaiting--;
+            }
+            #endif
             configASSERT( pxIOManager->pvFATLockHandle == NULL );
             pxIOManager->pvFATLockHandle = xTaskGetCurrentTaskHandle();
+            #if ( ffconfigFAT_LOCK_READERS != 0 )
+            {
+                ( void ) xTaskResumeAll();
+            }
+            #endif
             break;
         }
     }
@@ -309,12 +475,182 @@ void FF_UnlockFAT( FF_IOManager_t * pxIOManager )
     }
 
     configASSERT( ( xEventGroupGetBits( pxIOManager->xEventGroup ) & FF_FAT_LOCK_EVENT_BITS ) == 0 );
-    pxIOManager->pvFATLockHandle = NULL;
-    xEventGroupSetBits( pxIOManager->xEventGroup, FF_FAT_LOCK_EVENT_BITS );
+    #if ( ffconfigFAT_LOCK_READERS != 0 )
+    {
+        EventBits_t xBits = FF_FAT_LOCK_EVENT_BITS;
+
+        vTaskSuspendAll();
+        {
+            pxIOManager->pvFATLockHandle = NULL;
+
+            if( pxIOManager->ucFATLockWritersWaiting == 0 )
+            {
+                /* Let the readers in again. */
+                xBits |= FF_FAT_SHARED_LOCK_EVENT_BITS;
+            }
+
+            xEventGroupSetBits( pxIOManager->xEventGroup, xBits );
+        }
+        ( void ) xTaskResumeAll();
+    }
+    #else
+    {
+        pxIOManager->pvFATLockHandle = NULL;
+        xEventGroupSetBits( pxIOManager->xEventGroup, FF_FAT_LOCK_EVENT_BITS );
+    }
+    #endif /* if ( ffconfigFAT_LOCK_READERS != 0 ) */
+}
+/*-----------------------------------------------------------*/
+
+void FF_LockFATShared( FF_IOManager_t * pxIOManager )
+{
+    /* Called when a task wants to read the FAT area without changing it.
+     * The first reader clears the FAT lock bit, so that FF_LockFAT() has to
+     * wait for it, and the last reader sets it again. */
+
+    #if ( ffconfigFAT_LOCK_READERS != 0 )
+        void * pvHandle;
+        BaseType_t xIndex;
+        BaseType_t xAdmitted = pdFALSE;
+        BaseType_t xExclusive = pdFALSE;
+    #endif
+
+    if( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING )
+    {
+        /* Scheduler not yet active. */
+        return;
+    }
+
+    #if ( ffconfigFAT_LOCK_READERS != 0 )
+    {
+        configASSERT( FF_Has_Lock( pxIOManager, FF_FAT_SHARED_LOCK ) == pdFALSE );
+
+        pvHandle = xTaskGetCurrentTaskHandle();
+
+        for( ; ; )
+        {
+            vTaskSuspendAll();
+            {
+                if( ( pxIOManager->pvFATLockHandle == NULL ) && ( pxIOManager->ucFATLockWritersWaiting == 0 ) )
+                {
+                    if( pxIOManager->ucFATLockReaderCount < ffconfigFAT_LOCK_READERS )
+                    {
+                        if( pxIOManager->ucFATLockReaderCount == 0 )
+                        {
+                            EventBits_t xBits = xEventGroupClearBits( pxIOManager->xEventGroup,
+                                                                      FF_FAT_LOCK_EVENT_BITS );
+
+                            /* Nobody owns the FAT, so the bit must be high. */
+                            configASSERT( ( xBits & FF_FAT_LOCK_EVENT_BITS ) != 0 );
+                            ( void ) xBits;
+                        }
+
+                        for( xIndex = 0; xIndex < ffconfigFAT_LOCK_READERS; xIndex++ )
+                        {
+                            if( pxIOManager->pvFATLockReaders[ xIndex ] == NULL )
+                            {
+                                pxIOManager->pvFATLockReaders[ xIndex ] = pvHandle;
+                                break;
+                            }
+                        }
+
+                        pxIOManager->ucFATLockReaderCount++;
+                        xAdmitted = pdTRUE;
+                    }
+                    else
+                    {
+                        /* All places are taken, wait for exclusive access. */
+                        xExclusive = pdTRUE;
+                    }
+                }
+            }
+            ( void ) xTaskResumeAll();
+
+            if( ( xAdmitted != pdFALSE ) || ( xExclusive != pdFALSE ) )
+            {
+                break;
+            }
+
+            /* Wait until the task that owns the FAT, and all tasks that wait
+             * to own it, are done. */
+            xEventGroupWaitBits( pxIOManager->xEventGroup,
+                                 FF_FAT_SHARED_LOCK_EVENT_BITS, /* uxBitsToWaitFor */
+                                 pdFALSE,                       /* xClearOnExit */
+                                 pdFALSE,                       /* xWaitForAllBits n.a. */
+                                 FF_TIME_TO_WAIT_FOR_EVENT_TICKS );
+        }
+
+        if( xExclusive != pdFALSE )
+        {
+            FF_LockFAT( pxIOManager );
+        }
+    }
+    #else /* if ( ffconfigFAT_LOCK_READERS != 0 ) */
+    {
+        FF_LockFAT( pxIOManager );
+    }
+    #endif /* if ( ffconfigFAT_LOCK_READERS != 0 ) */
+}
+/*-----------------------------------------------------------*/
+
+void FF_UnlockFATShared( FF_IOManager_t * pxIOManager )
+{
+    #if ( ffconfigFAT_LOCK_READERS != 0 )
+        void * pvHandle;
+        BaseType_t xIndex;
+    #endif
+
+    if( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING )
+    {
+        /* Scheduler not yet active. */
+        return;
+    }
+
+    #if ( ffconfigFAT_LOCK_READERS != 0 )
+    {
+        pvHandle = xTaskGetCurrentTaskHandle();
+
+        if( pxIOManager->pvFATLockHandle == pvHandle )
+        {
+            /* FF_LockFATShared() had to take the lock exclusively. */
+            FF_UnlockFAT( pxIOManager );
+        }
+        else
+        {
+            vTaskSuspendAll();
+            {
+                for( xIndex = 0; xIndex < ffconfigFAT_LOCK_READERS; xIndex++ )
+                {
+                    if( pxIOManager->pvFATLockReaders[ xIndex ] == pvHandle )
+                    {
+                        pxIOManager->pvFATLockReaders[ xIndex ] = NULL;
+                        break;
+                    }
+                }
+
+                configASSERT( xIndex < ffconfigFAT_LOCK_READERS );
+                configASSERT( pxIOManager->ucFATLockReaderCount != 0 );
+                pxIOManager->ucFATLockReaderCount--;
+
+                if( pxIOManager->ucFATLockReaderCount == 0 )
+                {
+                    /* The last reader is done, a writer may proceed now. */
+                    xEventGroupSetBits( pxIOManager->xEventGroup, FF_FAT_LOCK_EVENT_BITS );
+                }
+            }
+            ( void ) xTaskResumeAll();
+        }
+    }
+    #else /* if ( ffconfigFAT_LOCK_READERS != 0 ) */
+    {
+        FF_UnlockFAT( pxIOManager );
+    }
+    #endif /* if ( ffconfigFAT_LOCK_READERS != 0 ) */
 }
 /*-----------------------------------------------------------*/
 
 BaseType_t FF_BufferWait( FF_IOManager_t * pxIOManager,
+                          uint32_t ulWaitBits,
                           uint32_t xWaitMS )
 {
     EventBits_t xBits;
@@ -327,15 +663,15 @@ BaseType_t FF_BufferWait( FF_IOManager_t * pxIOManager,
     }
 
     /* This function is called when a task is waiting for a sector buffer
-     * to become available.  Each time when a sector buffer becomes available,
-     * the bit will be set ( see FF_BufferProceed() here below ). */
+     * to become available.  When the buffer becomes available, the bit will
+     * be set ( see FF_BufferProceed() here below ). */
     xBits = xEventGroupWaitBits( pxIOManager->xEventGroup,
-                                 FF_BUF_LOCK_EVENT_BITS, /* uxBitsToWaitFor */
-                                 pdTRUE,                 /* xClearOnExit */
-                                 pdFALSE,                /* xWaitForAllBits n.a. */
+                                 ( EventBits_t ) ulWaitBits, /* uxBitsToWaitFor */
+                                 pdTRUE,                     /* xClearOnExit */
+                                 pdFALSE,                    /* xWaitForAllBits n.a. */
                                  pdMS_TO_TICKS( xWaitMS ) );
 
-    if( ( xBits & FF_BUF_LOCK_EVENT_BITS ) != 0 )
+    if( ( xBits & ( EventBits_t ) ulWaitBits ) != 0 )
     {
         xReturn = pdTRUE;
     }
@@ -348,7 +684,8 @@ BaseType_t FF_BufferWait( FF_IOManager_t * pxIOManager,
 }
 /*-----------------------------------------------------------*/
 
-void FF_BufferProceed( FF_IOManager_t * pxIOManager )
+void FF_BufferProceed( FF_IOManager_t * pxIOManager,
+                       uint32_t ulWakeBits )
 {
     if( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING )
     {
@@ -356,7 +693,7 @@ void FF_BufferProceed( FF_IOManager_t * pxIOManager )
         return;
     }
 
-    /* Wake-up a task that is waiting for a sector buffer to become available. */
-    xEventGroupSetBits( pxIOManager->xEventGroup, FF_BUF_LOCK_EVENT_BITS );
+    /* Wake-up the tasks that are waiting for a sector buffer to become available. */
+    xEventGroupSetBits( pxIOManager->xEventGroup, ( EventBits_t ) ulWakeBits );
 }
 /*-----------------------------------------------------------*/
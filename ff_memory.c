@@ -61,8 +61,12 @@
         FF_T_UN16 u16;
 
         pBuffer += aOffset;
-        u16.bytes.u8_1 = pBuffer[ 1 ];
-        u16.bytes.u8_0 = pBuffer[ 0 ];
+        #if ( ffMEMORY_WORD_ACCESS != 0 )
+            memcpy( &( u16.u16 ), pBuffer, sizeof( u16.u16 ) );
+        #else
+            u16.bytes.u8_1 = pBuffer[ 1 ];
+            u16.bytes.u8_0 = pBuffer[ 0 ];
+        #endif
 
         return u16.u16;
     }
@@ -73,10 +77,14 @@
         FF_T_UN32 u32;
 
         pBuffer += aOffset;
-        u32.bytes.u8_3 = pBuffer[ 3 ];
-        u32.bytes.u8_2 = pBuffer[ 2 ];
-        u32.bytes.u8_1 = pBuffer[ 1 ];
-        u32.bytes.u8_0 = pBuffer[ 0 ];
+        #if ( ffMEMORY_WORD_ACCESS != 0 )
+            memcpy( &( u32.u32 ), pBuffer, sizeof( u32.u32 ) );
+        #else
+            u32.bytes.u8_3 = pBuffer[ 3 ];
+            u32.bytes.u8_2 = pBuffer[ 2 ];
+            u32.bytes.u8_1 = pBuffer[ 1 ];
+            u32.bytes.u8_0 = pBuffer[ 0 ];
+        #endif
 
         return u32.u32;
     }
@@ -96,8 +104,12 @@
 
         u16.u16 = ( uint16_t ) Value;
         pBuffer += aOffset;
-        pBuffer[ 0 ] = u16.bytes.u8_0;
-        pBuffer[ 1 ] = u16.bytes.u8_1;
+        #if ( ffMEMORY_WORD_ACCESS != 0 )
+            memcpy( pBuffer, &( u16.u16 ), sizeof( u16.u16 ) );
+        #else
+            pBuffer[ 0 ] = u16.bytes.u8_0;
+            pBuffer[ 1 ] = u16.bytes.u8_1;
+        #endif
     }
 
     void FF_putLong( uint8_t * pBuffer,
@@ -108,10 +120,64 @@
 
         u32.u32 = Value;
         pBuffer += aOffset;
-        pBuffer[ 0 ] = u32.bytes.u8_0;
-        pBuffer[ 1 ] = u32.bytes.u8_1;
-        pBuffer[ 2 ] = u32.bytes.u8_2;
-        pBuffer[ 3 ] = u32.bytes.u8_3;
+        #if ( ffMEMORY_WORD_ACCESS != 0 )
+            memcpy( pBuffer, &( u32.u32 ), sizeof( u32.u32 ) );
+        #else
+            pBuffer[ 0 ] = u32.bytes.u8_0;
+            pBuffer[ 1 ] = u32.bytes.u8_1;
+            pBuffer[ 2 ] = u32.bytes.u8_2;
+            pBuffer[ 3 ] = u32.bytes.u8_3;
+        #endif
     }
 
 #endif /* if ( ffconfigINLINE_MEMORY_ACCESS == 0 ) */
+/*-----------------------------------------------------------*/
+
+/*
+ * The bulk versions below decode a whole array of values in one pass.
+ * On a little endian CPU, the 32-bit values are copied 1-to-1, the
+ * alignment of the buffer doesn't matter to memcpy().
+ */
+void FF_getLongs( const uint8_t * pBuffer,
+                  uint32_t aOffset,
+                  uint32_t * pulValues,
+                  uint32_t ulCount )
+{
+    pBuffer += aOffset;
+
+    #if ( ffconfigBYTE_ORDER == pdFREERTOS_LITTLE_ENDIAN )
+    {
+        memcpy( pulValues, pBuffer, ulCount * sizeof( *pulValues ) );
+    }
+    #else
+    {
+        uint32_t ulIndex;
+
+        for( ulIndex = 0; ulIndex < ulCount; ulIndex++, pBuffer += 4 )
+        {
+            pulValues[ ulIndex ] = ( ( uint32_t ) pBuffer[ 0 ] ) |
+                                   ( ( ( uint32_t ) pBuffer[ 1 ] ) << 8 ) |
+                                   ( ( ( uint32_t ) pBuffer[ 2 ] ) << 16 ) |
+                                   ( ( ( uint32_t ) pBuffer[ 3 ] ) << 24 );
+        }
+    }
+    #endif /* if ( ffconfigBYTE_ORDER == pdFREERTOS_LITTLE_ENDIAN ) */
+}
+/*-----------------------------------------------------------*/
+
+void FF_getShorts( const uint8_t * pBuffer,
+                   uint32_t aOffset,
+                   uint32_t * pulValues,
+                   uint32_t ulCount )
+{
+    uint32_t ulIndex;
+
+    pBuffer += aOffset;
+
+    for( ulIndex = 0; ulIndex < ulCount; ulIndex++, pBuffer += 2 )
+    {
+        pulValues[ ulIndex ] = ( ( uint32_t ) pBuffer[ 0 ] ) |
+                               ( ( ( uint32_t ) pBuffer[ 1 ] ) << 8 );
+    }
+}
+/*-----------------------------------------------------------*/
@@ -75,6 +75,20 @@ int prvFFErrorToErrno( FF_Error_t xError );
     static time_t prvFileTime( FF_SystemTime_t * pxTime );
 #endif
 
+/*
+ * Fill in the current time, used for the dot-entries.
+ */
+#if ( ffconfigTIME_SUPPORT != 0 )
+    static void prvCurrentTime( FF_SystemTime_t * pxTime );
+#endif
+
+/*
+ * Store the entry that ff_findnext() has found in an element of the array
+ * that is filled by ff_readdir_batch().
+ */
+static void prvStoreDirInfo( FF_DirInfo_t * pxInfo,
+                             const FF_FindData_t * pxFindData );
+
 #if ( ffconfigHAS_CWD == 1 )
 
 /* FreeRTOS+FAT requires two thread local storage pointers.  One for errno
@@ -552,6 +566,48 @@ int ff_seteof( FF_FILE * pxStream )
 }
 /*-----------------------------------------------------------*/
 
+int ff_fallocate( FF_FILE * pxStream,
+                  int iMode,
+                  long lOffset,
+                  long lLength )
+{
+    FF_Error_t xError;
+    int iReturn, ff_errno;
+
+    if( ( lOffset < 0L ) || ( lLength <= 0L ) || ( ( iMode & ~FF_FALLOC_KEEP_SIZE ) != 0 ) )
+    {
+        ff_errno = pdFREERTOS_ERRNO_EINVAL;
+    }
+    else if( ( ( unsigned long ) lOffset > 0xFFFFFFFFUL ) ||
+             ( ( unsigned long ) lLength > ( 0xFFFFFFFFUL - ( unsigned long ) lOffset ) ) )
+    {
+        /* A FAT file can not be larger than 4 GB - 1. */
+        ff_errno = pdFREERTOS_ERRNO_EFBIG;
+    }
+    else
+    {
+        xError = FF_Preallocate( pxStream, ( uint32_t ) lOffset + ( uint32_t ) lLength,
+                                 ( ( iMode & FF_FALLOC_KEEP_SIZE ) != 0 ) ? pdTRUE : pdFALSE );
+
+        ff_errno = prvFFErrorToErrno( xError );
+    }
+
+    if( ff_errno == 0 )
+    {
+        iReturn = 0;
+    }
+    else
+    {
+        iReturn = FF_EOF;
+    }
+
+    /* Store the errno to thread local storage. */
+    stdioSET_ERRNO( ff_errno );
+
+    return iReturn;
+}
+/*-----------------------------------------------------------*/
+
 /*_RB_ The norm would be to return an int, but in either case it is not clear
  * what state the file is left in (open/closed). */
 FF_FILE * ff_truncate( const char * pcFileName,
@@ -676,6 +732,41 @@ FF_FILE * ff_truncate( const char * pcFileName,
 }
 /*-----------------------------------------------------------*/
 
+int ff_fflush( FF_FILE * pxStream )
+{
+    FF_Error_t xError;
+    int iReturn, ff_errno;
+
+    #if ( ffconfigDEV_SUPPORT != 0 )
+        if( ( pxStream != NULL ) && ( pxStream->pxDevNode != NULL ) )
+        {
+            /* A device has nothing to flush. */
+            xError = FF_ERR_NONE;
+        }
+        else
+    #endif
+    {
+        xError = FF_FlushFile( pxStream );
+    }
+
+    ff_errno = prvFFErrorToErrno( xError );
+
+    if( ff_errno == 0 )
+    {
+        iReturn = 0;
+    }
+    else
+    {
+        iReturn = FF_EOF;
+    }
+
+    /* Store the errno to thread local storage. */
+    stdioSET_ERRNO( ff_errno );
+
+    return iReturn;
+}
+/*-----------------------------------------------------------*/
+
 #if ( ffconfigMKDIR_RECURSIVE == 0 )
 
 /* The normal mkdir() : if assumes that the directories leading to the last
@@ -1480,18 +1571,7 @@ int ff_findnext( FF_FindData_t * pxFindData )
         {
             if( xSetTime != pdFALSE )
             {
-                FF_TimeStruct_t xTimeStruct;
-                time_t xSeconds;
-
-                xSeconds = FreeRTOS_time( NULL );
-                FreeRTOS_gmtime_r( &xSeconds, &xTimeStruct );
-
-                pxFindData->xDirectoryEntry.xCreateTime.Year = ( uint16_t ) ( xTimeStruct.tm_year + 1900 ); /* Year (e.g. 2009). */
-                pxFindData->xDirectoryEntry.xCreateTime.Month = ( uint16_t ) ( xTimeStruct.tm_mon + 1 );    /* Month (e.g. 1 = Jan, 12 = Dec). */
-                pxFindData->xDirectoryEntry.xCreateTime.Day = ( uint16_t ) xTimeStruct.tm_mday;             /* Day (1 - 31). */
-                pxFindData->xDirectoryEntry.xCreateTime.Hour = ( uint16_t ) xTimeStruct.tm_hour;            /* Hour (0 - 23). */
-                pxFindData->xDirectoryEntry.xCreateTime.Minute = ( uint16_t ) xTimeStruct.tm_min;           /* Min (0 - 59). */
-                pxFindData->xDirectoryEntry.xCreateTime.Second = ( uint16_t ) xTimeStruct.tm_sec;           /* Second (0 - 59). */
+                prvCurrentTime( &( pxFindData->xDirectoryEntry.xCreateTime ) );
                 /* Date and Time Modified. */
                 memcpy( &( pxFindData->xDirectoryEntry.xModifiedTime ),
                         &( pxFindData->xDirectoryEntry.xCreateTime ),
@@ -1520,6 +1600,141 @@ int ff_findnext( FF_FindData_t * pxFindData )
 }
 /*-----------------------------------------------------------*/
 
+int ff_readdir_batch( const char * pcDirectory,
+                      FF_FindData_t * pxFindData,
+                      FF_DirInfo_t * pxEntries,
+                      size_t xMaxEntries )
+{
+    FF_Error_t xError = FF_ERR_NONE;
+    uint32_t ulCount = 0U;
+    uint32_t ulFound;
+    uint32_t ulIndex;
+    int iReturn;
+
+    if( xMaxEntries == 0U )
+    {
+        /* Nothing to do. */
+    }
+    else if( pcDirectory != NULL )
+    {
+        /* Start a new listing, ff_findfirst() gets the first entry. */
+        xError = ( FF_Error_t ) ff_findfirst( pcDirectory, pxFindData );
+
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            prvStoreDirInfo( &( pxEntries[ 0 ] ), pxFindData );
+            ulCount = 1U;
+        }
+    }
+    else if( pxFindData->xDirectoryHandler.u.bits.bIsValid == pdFALSE )
+    {
+        /* The listing has ended already. */
+        xError = FF_createERR( FF_ERR_DIR_END_OF_DIR, FF_FINDNEXT );
+    }
+    else
+    {
+        /* Continue the listing. */
+    }
+
+    if( ( FF_isERR( xError ) == pdFALSE ) &&
+        ( ulCount < xMaxEntries ) &&
+        ( pxFindData->xDirectoryHandler.pxManager != NULL ) &&
+        ( pxFindData->xDirectoryHandler.u.bits.bFirstCalled != pdFALSE ) &&
+        ( pxFindData->xDirectoryHandler.u.bits.bEndOfDir == pdFALSE )
+        #if ( ffconfigDEV_SUPPORT != 0 )
+            && ( pxFindData->bIsDeviceDir == pdFALSE )
+        #endif
+        )
+    {
+        /* Read the physical entries in one pass. */
+        xError = FF_FindNextBatch( pxFindData->xDirectoryHandler.pxManager, &( pxFindData->xDirectoryEntry ),
+                                   &( pxEntries[ ulCount ] ), ( uint32_t ) ( xMaxEntries - ulCount ), &ulFound );
+
+        /* The dot-entries get a time-stamp, and will not be added again
+         * at the end, just like in ff_findnext(). */
+        for( ulIndex = ulCount; ulIndex < ulCount + ulFound; ulIndex++ )
+        {
+            if( pxEntries[ ulIndex ].pcFileName[ 0 ] == '.' )
+            {
+                if( ( pxEntries[ ulIndex ].pcFileName[ 1 ] == '.' ) &&
+                    ( pxEntries[ ulIndex ].pcFileName[ 2 ] == '\0' ) )
+                {
+                    pxFindData->xDirectoryHandler.u.bits.bAddDotEntries &= stdioDIR_ENTRY_DOT_1;
+                }
+                else if( pxEntries[ ulIndex ].pcFileName[ 1 ] == '\0' )
+                {
+                    pxFindData->xDirectoryHandler.u.bits.bAddDotEntries &= stdioDIR_ENTRY_DOT_2;
+                }
+                else
+                {
+                    continue;
+                }
+
+                #if ( ffconfigTIME_SUPPORT != 0 )
+                {
+                    prvCurrentTime( &( pxEntries[ ulIndex ].xCreateTime ) );
+                    memcpy( &( pxEntries[ ulIndex ].xModifiedTime ),
+                            &( pxEntries[ ulIndex ].xCreateTime ),
+                            sizeof( pxEntries[ ulIndex ].xModifiedTime ) );
+                    memcpy( &( pxEntries[ ulIndex ].xAccessedTime ),
+                            &( pxEntries[ ulIndex ].xCreateTime ),
+                            sizeof( pxEntries[ ulIndex ].xAccessedTime ) );
+                }
+                #endif /* ffconfigTIME_SUPPORT */
+            }
+        }
+
+        ulCount += ulFound;
+
+        if( FF_GETERROR( xError ) == FF_ERR_DIR_END_OF_DIR )
+        {
+            /* ff_findnext() will add the FS entries and dot-entries. */
+            pxFindData->xDirectoryHandler.u.bits.bEndOfDir = pdTRUE;
+            xError = FF_ERR_NONE;
+        }
+        else if( FF_isERR( xError ) != pdFALSE )
+        {
+            stdioSET_ERRNO( prvFFErrorToErrno( xError ) );
+        }
+        else
+        {
+            /* The array is full. */
+        }
+
+        if( ulFound != 0U )
+        {
+            pxFindData->ucAttributes = pxFindData->xDirectoryEntry.ucAttrib;
+            pxFindData->ulFileSize = pxFindData->xDirectoryEntry.ulFileSize;
+        }
+    }
+
+    /* Device directories, FS entries and dot-entries are added one by one. */
+    while( ( FF_isERR( xError ) == pdFALSE ) && ( ulCount < xMaxEntries ) )
+    {
+        xError = ( FF_Error_t ) ff_findnext( pxFindData );
+
+        if( FF_isERR( xError ) == pdFALSE )
+        {
+            prvStoreDirInfo( &( pxEntries[ ulCount ] ), pxFindData );
+            ulCount++;
+        }
+    }
+
+    if( ( FF_isERR( xError ) == pdFALSE ) || ( FF_GETERROR( xError ) == FF_ERR_DIR_END_OF_DIR ) )
+    {
+        iReturn = ( int ) ulCount;
+        stdioSET_ERRNO( 0 );
+    }
+    else
+    {
+        /* errno has already been set. */
+        iReturn = -1;
+    }
+
+    return iReturn;
+}
+/*-----------------------------------------------------------*/
+
 /*-----------------------------------------------------------
  * ff_isdirempty() returns 1 if a given directory is empty
  * (has no entries)
@@ -2183,3 +2398,43 @@ int prvFFErrorToErrno( FF_Error_t xError )
 
 #endif /* if ( ffconfigTIME_SUPPORT == 1 ) */
 /*-----------------------------------------------------------*/
+
+#if ( ffconfigTIME_SUPPORT != 0 )
+
+    static void prvCurrentTime( FF_SystemTime_t * pxTime )
+    {
+        FF_TimeStruct_t xTimeStruct;
+        time_t xSeconds;
+
+        xSeconds = FreeRTOS_time( NULL );
+        FreeRTOS_gmtime_r( &xSeconds, &xTimeStruct );
+
+        pxTime->Year = ( uint16_t ) ( xTimeStruct.tm_year + 1900 ); /* Year (e.g. 2009). */
+        pxTime->Month = ( uint16_t ) ( xTimeStruct.tm_mon + 1 );    /* Month (e.g. 1 = Jan, 12 = Dec). */
+        pxTime->Day = ( uint16_t ) xTimeStruct.tm_mday;             /* Day (1 - 31). */
+        pxTime->Hour = ( uint16_t ) xTimeStruct.tm_hour;            /* Hour (0 - 23). */
+        pxTime->Minute = ( uint16_t ) xTimeStruct.tm_min;           /* Min (0 - 59). */
+        pxTime->Second = ( uint16_t ) xTimeStruct.tm_sec;           /* Second (0 - 59). */
+    }
+
+#endif /* if ( ffconfigTIME_SUPPORT != 0 ) */
+/*-----------------------------------------------------------*/
+
+static void prvStoreDirInfo( FF_DirInfo_t * pxInfo,
+                             const FF_FindData_t * pxFindData )
+{
+    const FF_DirEnt_t * pxEntry = &( pxFindData->xDirectoryEntry );
+
+    pxInfo->ulFileSize = pxEntry->ulFileSize;
+    pxInfo->ulObjectCluster = pxEntry->ulObjectCluster;
+    pxInfo->ucAttrib = pxEntry->ucAttrib;
+    #if ( ffconfigTIME_SUPPORT != 0 )
+    {
+        memcpy( &( pxInfo->xCreateTime ), &( pxEntry->xCreateTime ), sizeof( pxInfo->xCreateTime ) );
+        memcpy( &( pxInfo->xModifiedTime ), &( pxEntry->xModifiedTime ), sizeof( pxInfo->xModifiedTime ) );
+        memcpy( &( pxInfo->xAccessedTime ), &( pxEntry->xAccessedTime ), sizeof( pxInfo->xAccessedTime ) );
+    }
+    #endif
+    strcpy( pxInfo->pcFileName, pxEntry->pcFileName );
+}
+/*-----------------------------------------------------------*/
@@ -167,6 +167,18 @@
     #define ffconfigOPTIMISE_UNALIGNED_ACCESS    0
 #endif
 
+#if !defined( ffconfigDIRECT_IO )
+
+/* Set to 1 to honour the FF_MODE_DIRECT flag of FF_Open().  The data of a file
+ * that is opened in this mode never passes through the sector cache, so that
+ * streaming a large file will not push the FAT and directory sectors out of
+ * the cache.  Each such file handle allocates a one sector buffer for the
+ * bytes before the first and after the last whole sector of a transfer.
+ *
+ * When set to 0, FF_MODE_DIRECT is ignored. */
+    #define ffconfigDIRECT_IO    0
+#endif
+
 #if !defined( ffconfigCACHE_WRITE_THROUGH )
 
 /* Input and output to a disk uses buffers that are only flushed at the
@@ -182,6 +194,118 @@
     #define ffconfigCACHE_WRITE_THROUGH    0
 #endif
 
+#if !defined( ffconfigBUFFER_HASH_INDEX )
+
+/* FF_GetBuffer() normally finds a cached sector, and chooses a buffer to
+ * recycle, by looking at every buffer descriptor in the cache.  That is cheap
+ * for a small cache, but the time spent with the cache semaphore taken grows
+ * with the number of buffers.
+ *
+ * Set to 1 to index the buffers on their sector number with a small hash
+ * table, and to keep them in a list ordered from most to least recently used.
+ * Both a lookup and the choice of a buffer to recycle then take a constant
+ * amount of time, independent of the cache size, at the cost of 3 pointers per
+ * buffer and one pointer per hash bucket.
+ *
+ * Set to 0 to keep the linear search. */
+    #define ffconfigBUFFER_HASH_INDEX    0
+#endif
+
+#if !defined( ffconfigCACHE_POOLS )
+
+/* All sectors normally compete for the same cache buffers, so reading or
+ * writing a large file will evict the FAT and directory sectors.
+ *
+ * Set to 1 to divide the cache in three pools: one for FAT sectors, one for
+ * directory sectors and one for file data.  The sizes of the FAT and directory
+ * pools are set with the 'ulFATMemorySize' and 'ulDirMemorySize' fields of
+ * FF_CreationParameters_t, the data pool gets the rest of 'ulMemorySize'.
+ * When a FAT or directory pool has no buffer to spare, a buffer is borrowed
+ * from the data pool.  Each pool counts its hits and misses.
+ *
+ * Set to 0 to use a single pool. */
+    #define ffconfigCACHE_POOLS    0
+#endif
+
+#if !defined( ffconfigCACHE_2Q )
+
+/* With ffconfigBUFFER_HASH_INDEX, the buffer that was used least recently is
+ * recycled first.  A directory scan or a large file copy touches many sectors
+ * only once, and pushes sectors that are used all the time out of the cache.
+ *
+ * Set to 1 to use the 2Q algorithm instead.  A sector that is read for the
+ * first time enters a short FIFO queue, which holds a quarter of the buffers
+ * of a pool.  Using it again while it is in that queue does not count.  When
+ * it leaves the queue, its sector number is remembered for a while.  Only a
+ * sector that is read again within that time enters the main LRU list.  The
+ * remembered sector numbers are found through the hash buckets of the
+ * buffers, they take 3 bytes per cache buffer plus 2 bytes per bucket.
+ *
+ * Set to 0 to use plain LRU.  Requires ffconfigBUFFER_HASH_INDEX. */
+    #define ffconfigCACHE_2Q    0
+#endif
+
+#if ( ffconfigCACHE_2Q != 0 ) && ( ffconfigBUFFER_HASH_INDEX == 0 )
+    #error ffconfigCACHE_2Q requires ffconfigBUFFER_HASH_INDEX
+#endif
+
+#if !defined( ffconfigFLUSH_MERGE_SECTORS )
+
+/* FF_FlushCache() normally writes every modified sector with a separate call
+ * to the driver's write function.  Most media are much faster when writing a
+ * few large blocks than many single sectors.
+ *
+ * Set to a value of 2 or more to let FF_FlushCache() sort the modified
+ * buffers on their sector number, and write runs of adjacent sectors with a
+ * single call, of at most ffconfigFLUSH_MERGE_SECTORS sectors.  A bounce
+ * buffer of that many sectors is allocated together with the I/O manager, for
+ * runs whose buffers are not adjacent in the cache memory.
+ *
+ * Set to 0 to write each sector separately. */
+    #define ffconfigFLUSH_MERGE_SECTORS    0
+#endif
+
+#if !defined( ffconfigREAD_AHEAD_SECTORS )
+
+/* FF_Read() normally reads only the sectors that are asked for.  A task that
+ * reads a file in small pieces will cause one call to the driver for every
+ * sector.
+ *
+ * Set to 2 or more to detect per file handle that sectors are read one after
+ * the other.  When the next sector is not in the cache, up to this number of
+ * sectors of the current run of clusters are read with one call to the
+ * driver, and stored in the cache.  Unless the cache buffers happen to be
+ * adjacent in memory, a bounce buffer of that many sectors is allocated
+ * together with the I/O manager.  The cache must be a good deal larger than
+ * this number.
+ *
+ * With ffconfigASYNC_BLOCK_DEVICE and a driver that sets fnSubmitBlocks, the
+ * sectors are read in the background: the next run is submitted as soon as
+ * the reader gets to the previous one.
+ *
+ * Set to 0 to only read what is asked for. */
+    #define ffconfigREAD_AHEAD_SECTORS    0
+#endif
+
+#if !defined( ffconfigDIRECTORY_READ_SECTORS )
+
+/* Searching or listing a directory normally gets every sector of it from the
+ * cache, one at a time.
+ *
+ * Set to 2 or more to have FF_FetchEntryWithContext() read up to this number
+ * of sectors of the current directory cluster with a single call to the
+ * driver, into a block of memory that is allocated together with the I/O
+ * manager.  The entries are then read from that block, without a cache
+ * look-up per sector.  Sectors that are in the cache are copied from there,
+ * and a sector that is changed through the cache or written to the disk is
+ * dropped from the block.  Only one directory scan at a time uses the block,
+ * others use the cache as usual.  A value of at least the number of sectors
+ * per cluster makes the most sense.
+ *
+ * Set to 0 to read directories through the cache only. */
+    #define ffconfigDIRECTORY_READ_SECTORS    0
+#endif
+
 #if !defined( ffconfigWRITE_BOTH_FATS )
 
 /* In most cases, the FAT table has two identical copies on the disk,
@@ -250,6 +374,100 @@
     #define ffconfigFSINFO_TRUSTED    0
 #endif
 
+#if !defined( ffconfigBACKGROUND_FREE_SCAN )
+
+/* Set to 1 to let FF_Mount() return before the free clusters are counted,
+ * when ffconfigMOUNT_FIND_FREE is set.  A task is created that reads the FAT
+ * in the background, and builds the free-cluster bitmap while counting.
+ * Clusters can be allocated and freed while the scan is running: free
+ * clusters are taken from the part of the bitmap that is ready, the rest of
+ * the FAT is only searched when that part is full.  FF_GetFreeSize() waits
+ * for the scan to finish.
+ *
+ * When the task can not be created, or for FAT12, FF_Mount() counts the free
+ * clusters as usual. */
+    #define ffconfigBACKGROUND_FREE_SCAN    0
+#endif
+
+#if !defined( ffconfigFREE_SCAN_TASK_PRIORITY )
+    /* The priority of the task that counts the free clusters. */
+    #define ffconfigFREE_SCAN_TASK_PRIORITY    ( tskIDLE_PRIORITY )
+#endif
+
+#if !defined( ffconfigFREE_SCAN_STACK_SIZE )
+    /* The stack size, in words, of the task that counts the free clusters. */
+    #define ffconfigFREE_SCAN_STACK_SIZE    ( configMINIMAL_STACK_SIZE * 2 )
+#endif
+
+#if !defined( ffconfigFREE_SCAN_STEP_SECTORS )
+
+/* The number of FAT sectors that the background scan reads before releasing
+ * the FAT lock, giving other tasks a chance to allocate clusters. */
+    #define ffconfigFREE_SCAN_STEP_SECTORS    16
+#endif
+
+#if !defined( ffconfigCOUNT_FREE_READ_SECTORS )
+
+/* FF_CountFreeClusters() reads the entire FAT, for instance when a disk is
+ * mounted with ffconfigMOUNT_FIND_FREE.  Set to the number of FAT sectors
+ * that it reads with a single call to the driver.  A buffer of this many
+ * sectors is allocated with ffconfigMALLOC() while counting.  When the
+ * allocation fails, the FAT is read through the cache.
+ *
+ * Set to 0 to always read the FAT through the cache, one sector at a time. */
+    #define ffconfigCOUNT_FREE_READ_SECTORS    0
+#endif
+
+#if !defined( ffconfigFREE_CLUSTER_BITMAP )
+
+/* Set to 1 to keep a bitmap in RAM with one bit for every cluster of the
+ * mounted FAT16 or FAT32 partition.  The bitmap is built by reading the FAT
+ * once, the first time that a free cluster is needed, and it is kept up to
+ * date by FF_putFATEntry().  From then on FF_FindFreeCluster() will find
+ * free clusters without reading the FAT.  The bitmap needs ( ulNumClusters / 8 )
+ * bytes of heap, e.g. 128 KB for a 32 GB volume with 32 KB clusters.  When the
+ * allocation fails, the FAT will be scanned as usual.
+ *
+ * Set to 0 to search the FAT itself for free clusters. */
+    #define ffconfigFREE_CLUSTER_BITMAP    0
+#endif
+
+#if ( ffconfigBACKGROUND_FREE_SCAN != 0 ) && ( ffconfigFREE_CLUSTER_BITMAP == 0 )
+    #error ffconfigBACKGROUND_FREE_SCAN requires ffconfigFREE_CLUSTER_BITMAP
+#endif
+
+#if !defined( ffconfigFAT_LOCK_READERS )
+
+/* Read-only walks along a cluster chain, like FF_TraverseFAT() and
+ * FF_GetChainLength(), only need shared access to the FAT.  Set to the
+ * maximum number of tasks that may hold the FAT lock in shared mode at the
+ * same time, e.g. the number of tasks that read files concurrently.  A task
+ * that wants to change the FAT waits until all readers are done, and no new
+ * readers are admitted while it waits.  Every reader takes a pointer in the
+ * I/O manager.  When all places are taken, a reader will wait for exclusive
+ * access.
+ *
+ * Set to 0 to let all tasks access the FAT one at a time. */
+    #define ffconfigFAT_LOCK_READERS    0
+#endif
+
+#if ( ffconfigFAT_LOCK_READERS > 255 )
+    #error ffconfigFAT_LOCK_READERS can not be larger than 255
+#endif
+
+#if !defined( ffconfigDIRECTORY_LOCKS )
+
+/* Creating or deleting a directory entry requires a lock on the directory.
+ * Set to the number of locks in a table of directory locks.  A directory
+ * uses the lock with the index ( start cluster % ffconfigDIRECTORY_LOCKS ),
+ * so tasks that change different directories mostly do not have to wait for
+ * each other.  Operations that involve two directories, like FF_Move() and
+ * FF_RmDir(), take all locks of the table.  Each lock is a recursive mutex.
+ *
+ * Set to 0 to use a single lock for all directories. */
+    #define ffconfigDIRECTORY_LOCKS    0
+#endif
+
 #if !defined( ffconfigFINDAPI_ALLOW_WILDCARDS )
     /* For now must be set to 0. */
     #define ffconfigFINDAPI_ALLOW_WILDCARDS    0
@@ -262,9 +480,12 @@
 
 #if !defined( ffconfigPATH_CACHE )
 
-/* Set to 1 to store recent paths in a cache, enabling much faster access
- * when the path is deep within a directory structure at the expense of
- * additional RAM usage.
+/* Set to 1 to store recently used directory names in a cache, enabling much
+ * faster access when the path is deep within a directory structure at the
+ * expense of additional RAM usage.  Every entry maps a directory name within
+ * a parent directory to its cluster, so a path like "/data/2026/10/16" can
+ * reuse the entries of "/data/2026/10", and only "16" has to be searched on
+ * disk.  The entry that was used least recently is replaced first.
  *
  * Set to 0 to not use a path cache. */
     #define ffconfigPATH_CACHE    0
@@ -274,8 +495,9 @@
 
 /* Only used if ffconfigPATH_CACHE is 1.
  *
- * Sets the maximum number of paths that can exist in the patch cache at any
- * one time. */
+ * Sets the maximum number of directory names that can exist in the path cache
+ * at any one time.  Each entry takes about ffconfigMAX_FILENAME bytes, or
+ * twice as much with ffconfigUNICODE_UTF16_SUPPORT. */
     #define ffconfigPATH_CACHE_DEPTH    5
 #endif
 
@@ -307,6 +529,68 @@
     #endif
 #endif /* ffconfigHASH_CACHE != 0 */
 
+#if !defined( ffconfigCRC_SLICING_BY_8 )
+
+/* Set to 1 to let FF_GetCRC32(), FF_GetCRC16() and FF_GetCRC8() handle 8 bytes
+ * at a time, using 7 extra lookup tables per CRC.  The tables are constant and
+ * take about 12 KB of ROM.  The CRC's are used for the short name hashes of
+ * ffconfigHASH_CACHE, for the tails of new short names and for GPT headers.
+ *
+ * Set to 0 to handle one byte at a time. */
+    #define ffconfigCRC_SLICING_BY_8    0
+#endif
+
+#if !defined( ffconfigCRC_HARDWARE )
+
+/* Set to 1 to let FF_GetCRC32() use the CRC instructions of the CPU, if the
+ * compiler reports that they are available: the ARMv8 CRC32 instructions
+ * (__ARM_FEATURE_CRC32, e.g. -march=armv8-a+crc), or carry-less multiplication
+ * on x86 (__PCLMUL__ and __SSE4_1__, e.g. -mpclmul -msse4.1).  On x86, only
+ * blocks of 64 bytes or more are handled with PCLMULQDQ.  The CPU has no
+ * instructions for the polynomials of FF_GetCRC16() and FF_GetCRC8().
+ *
+ * Set to 0 to use tables only. */
+    #define ffconfigCRC_HARDWARE    0
+#endif
+
+#if !defined( ffconfigLFN_INDEX )
+
+/* Set to 1 to keep an index of the names in recently searched directories.
+ * For every name, the index holds a 16-bit hash of the case-folded name and
+ * the number of its first directory entry.  FF_FindEntryInDir() will then
+ * only decode the few entries whose hash matches, in stead of every long file
+ * name in the directory.  An index is built the first time a directory is
+ * searched, and it is kept up to date by FF_CreateDirent() and FF_RmLFNs().
+ * It takes 4 bytes of heap for every name in the directory.
+ *
+ * Set to 0 to scan the directory for every look-up.  Requires
+ * ffconfigLFN_SUPPORT. */
+    #define ffconfigLFN_INDEX    0
+#endif
+
+#if ( ffconfigLFN_INDEX != 0 )
+    #if ( ffconfigLFN_SUPPORT == 0 )
+        #error ffconfigLFN_INDEX requires ffconfigLFN_SUPPORT
+    #endif
+
+    #if !defined( ffconfigLFN_INDEX_DEPTH )
+
+/* Only used if ffconfigLFN_INDEX is set to 1
+ *
+ * The number of directories that can be indexed at the same time. */
+        #define ffconfigLFN_INDEX_DEPTH    2
+    #endif
+
+    #if !defined( ffconfigLFN_INDEX_MAX_ENTRIES )
+
+/* Only used if ffconfigLFN_INDEX is set to 1
+ *
+ * A directory with more names than this will not be indexed, it will be
+ * scanned as usual.  Can not be more than 65535. */
+        #define ffconfigLFN_INDEX_MAX_ENTRIES    8192
+    #endif
+#endif /* ffconfigLFN_INDEX != 0 */
+
 #if !defined( ffconfigMKDIR_RECURSIVE )
 
 /* Set to 1 to add a parameter to ff_mkdir() that allows an entire directory
@@ -367,6 +651,20 @@
     #define ffconfigDRIVER_BUSY_SLEEP_MS    20
 #endif
 
+#if !defined( ffconfigASYNC_BLOCK_DEVICE )
+
+/* Set to 1 to let drivers offer an asynchronous interface next to
+ * fnWriteBlocks and fnReadBlocks, see FF_SubmitBlocks_t.  When a driver sets
+ * fnSubmitBlocks, reads and writes of whole clusters will submit a run of
+ * clusters to the driver, and look up the next run in the FAT while the
+ * transfer is in progress.  Every file handle that does so uses a binary
+ * semaphore to wait for its transfers.  So does the I/O manager when
+ * ffconfigREAD_AHEAD_SECTORS is used.
+ *
+ * Set to 0 to always wait for the driver. */
+    #define ffconfigASYNC_BLOCK_DEVICE    0
+#endif
+
 #if !defined( ffconfigFPRINTF_SUPPORT )
 
 /* Set to 1 to include the ff_fprintf() function.
@@ -410,6 +708,17 @@
     #define ffconfigINLINE_MEMORY_ACCESS    0
 #endif
 
+#if !defined( ffconfigUNALIGNED_ACCESS )
+
+/* Set to 1 if the CPU can load and store 16 and 32-bit words at any byte
+ * address.  On little endian CPU's, FF_getShort(), FF_getLong(),
+ * FF_putShort() and FF_putLong() will then access a value with a single load
+ * or store, instead of assembling it byte by byte.
+ *
+ * Set to 0 to always access the values one byte at a time. */
+    #define ffconfigUNALIGNED_ACCESS    0
+#endif
+
 #if !defined( ffconfigMIRROR_FATS_UMOUNT )
     /*_RB_ not sure. */
     #define ffconfigMIRROR_FATS_UMOUNT    0
@@ -457,6 +766,48 @@
     #define ffconfigFILE_EXTEND_FLUSHES_BUFFERS    1
 #endif
 
+#if !defined( ffconfigFREE_EXTENT_WINDOW )
+
+/* When a file grows, FF_FindFreeExtent() looks for a run of free clusters
+ * that is long enough for the whole extension.  On a fragmented volume there
+ * may be no such run, and the search would visit every cluster of the FAT.
+ * The search gives up this number of clusters after the first free cluster it
+ * found, and takes the longest run seen so far.  The rest of the extension is
+ * then allocated first-fit, run by run.
+ *
+ * Set to 0 to allocate first-fit from the start. */
+    #define ffconfigFREE_EXTENT_WINDOW    4096
+#endif
+
+#if !defined( ffconfigFILE_EXTENT_MAP )
+
+/* Each file handle may remember where the runs of contiguous clusters of its
+ * file are located.  The map is filled while the cluster chain is followed,
+ * and it makes FF_Seek() and random reads go directly to the right cluster
+ * instead of walking the FAT from the start of the file.  Set to the number
+ * of runs to remember per handle, each of them takes 12 bytes.  When the map
+ * is full, the shortest run is forgotten.
+ *
+ * Set to 0 to follow the FAT each time. */
+    #define ffconfigFILE_EXTENT_MAP    0
+#endif
+
+#if !defined( ffconfigDELAYED_ALLOCATION )
+
+/* When a file grows, FF_Write() normally allocates its clusters right away,
+ * and tasks that append to different files at the same time get interleaved
+ * clusters.  When this is set to a non-zero value, each handle gets a buffer
+ * of ffconfigDELAYED_ALLOCATION bytes in which data that is appended to the
+ * end of the file is collected.  Clusters are only allocated when the
+ * buffer is written: when it is full, or when the handle is closed, seeked or
+ * truncated.  All clusters for the buffered data are then claimed as one run.
+ * FF_FlushCache() does not write these buffers, FF_FlushFile() writes the
+ * buffer of one handle and then flushes the cache.  The buffer is allocated with ffconfigMALLOC() when it is first used.
+ *
+ * Set to 0 to allocate clusters on every write. */
+    #define ffconfigDELAYED_ALLOCATION    0
+#endif
+
 #if !defined( FF_PRINTF )
     #define FF_PRINTF    FF_PRINTF
     static portINLINE void FF_PRINTF( const char * pcFormat,
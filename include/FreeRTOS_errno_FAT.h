@@ -84,4 +84,9 @@
 
 #endif /* pdFREERTOS_ERRNO_NONE */
 
+/* Not defined by older versions of this file, nor by the kernel. */
+#ifndef pdFREERTOS_ERRNO_EFBIG
+    #define pdFREERTOS_ERRNO_EFBIG    27 /* File too large */
+#endif
+
 #endif /* FREERTOS_ERRNO_FAT */
@@ -99,6 +99,24 @@ typedef struct
     FF_FetchContext_t xFetchContext;
 } FF_DirEnt_t;
 
+/* The properties of one directory entry, as stored by FF_FindNextBatch(). */
+typedef struct
+{
+    uint32_t ulFileSize;
+    uint32_t ulObjectCluster;
+    #if ( ffconfigTIME_SUPPORT != 0 )
+        FF_SystemTime_t xCreateTime;   /* Date and Time Created. */
+        FF_SystemTime_t xModifiedTime; /* Date and Time Modified. */
+        FF_SystemTime_t xAccessedTime; /* Date of Last Access. */
+    #endif
+    uint8_t ucAttrib;
+    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+        FF_T_WCHAR pcFileName[ ffconfigMAX_FILENAME ];
+    #else
+        char pcFileName[ ffconfigMAX_FILENAME ];
+    #endif
+} FF_DirInfo_t;
+
 
 
 /*
@@ -120,6 +138,11 @@ typedef struct
 
 FF_Error_t FF_FindNext( FF_IOManager_t * pxIOManager,
                         FF_DirEnt_t * pxDirent );
+FF_Error_t FF_FindNextBatch( FF_IOManager_t * pxIOManager,
+                             FF_DirEnt_t * pxDirent,
+                             FF_DirInfo_t * pxInfo,
+                             uint32_t ulMaxCount,
+                             uint32_t * pulCount );
 
 static portINLINE void FF_RewindFind( FF_DirEnt_t * pxDirent )
 {
@@ -200,6 +223,9 @@ struct _FF_FIND_PARAMS
     char pcEntryBuffer[ 32 ]; /* LFN converted to short name. */
     uint8_t ucCaseAttrib;
     uint8_t ucFirstTilde;
+    #if ( ffconfigLFN_INDEX != 0 )
+        FF_LFNIndex_t * pxLFNIndex; /* Only set while FF_FindEntryInDir() builds an index of the directory. */
+    #endif
 };
 
 typedef struct _FF_FIND_PARAMS FF_FindParams_t;
@@ -273,6 +299,27 @@ FF_Error_t FF_RmLFNs( FF_IOManager_t * pxIOManager,
                        uint32_t ulDirCluster );
 #endif /* if ( ffconfigHASH_CACHE != 0 ) */
 
+#if ( ffconfigLFN_INDEX != 0 )
+    #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
+        void FF_LFNIndexAdd( FF_IOManager_t * pxIOManager,
+                             uint32_t ulDirCluster,
+                             const FF_T_WCHAR * pcName,
+                             uint16_t usEntry );
+    #else
+        void FF_LFNIndexAdd( FF_IOManager_t * pxIOManager,
+                             uint32_t ulDirCluster,
+                             const char * pcName,
+                             uint16_t usEntry );
+    #endif
+    void FF_LFNIndexRemove( FF_IOManager_t * pxIOManager,
+                            uint32_t ulDirCluster,
+                            uint16_t usFirstEntry,
+                            uint16_t usLastEntry );
+    void FF_LFNIndexInvalidate( FF_IOManager_t * pxIOManager,
+                                uint32_t ulDirCluster );
+    void FF_LFNIndexFlush( FF_IOManager_t * pxIOManager );
+#endif /* if ( ffconfigLFN_INDEX != 0 ) */
+
 struct SBuffStats
 {
     unsigned sectorMatch;
@@ -119,6 +119,7 @@
 #define FF_TRAVERSE                  ( ( 13 << FF_FUNCTION_SHIFT ) | FF_MODULE_DIR )
 #define FF_FINDDIR                   ( ( 14 << FF_FUNCTION_SHIFT ) | FF_MODULE_DIR )
 #define FF_CREATEFILE                ( ( 15 << FF_FUNCTION_SHIFT ) | FF_MODULE_DIR )
+#define FF_FINDNEXTBATCH             ( ( 16 << FF_FUNCTION_SHIFT ) | FF_MODULE_DIR )
 
 /*----- FF_FILE - The FreeRTOS+FAT file handling routines. */
 #define FF_GETMODEBITS               ( ( 1 << FF_FUNCTION_SHIFT ) | FF_MODULE_FILE )
@@ -147,6 +148,7 @@
 #define FF_SETFILETIME               ( ( 24 << FF_FUNCTION_SHIFT ) | FF_MODULE_FILE )
 #define FF_INITBUF                   ( ( 25 << FF_FUNCTION_SHIFT ) | FF_MODULE_FILE )
 #define FF_SETEOF                    ( ( 26 << FF_FUNCTION_SHIFT ) | FF_MODULE_FILE )
+#define FF_PREALLOCATE               ( ( 27 << FF_FUNCTION_SHIFT ) | FF_MODULE_FILE )
 
 /*----- FF_FAT - The FreeRTOS+FAT FAT handling routines. */
 #define FF_GETFATENTRY               ( ( 1 << FF_FUNCTION_SHIFT ) | FF_MODULE_FAT )
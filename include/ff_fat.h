@@ -110,6 +110,16 @@ BaseType_t FF_isEndOfChain( FF_IOManager_t * pxIOManager,
 uint32_t FF_FindFreeCluster( FF_IOManager_t * pxIOManager,
                              FF_Error_t * pxError,
                              BaseType_t aDoClaim );
+uint32_t FF_FindFreeExtent( FF_IOManager_t * pxIOManager,
+                            uint32_t ulStartCluster,
+                            uint32_t ulCount,
+                            uint32_t ulWindow,
+                            uint32_t * pulLength,
+                            FF_Error_t * pxError );
+FF_Error_t FF_ClaimClusterExtent( FF_IOManager_t * pxIOManager,
+                                  uint32_t ulPrevious,
+                                  uint32_t ulFirst,
+                                  uint32_t ulLength );
 uint32_t FF_ExtendClusterChain( FF_IOManager_t * pxIOManager,
                                 uint32_t ulStartCluster,
                                 uint32_t ulCount );
@@ -147,6 +157,27 @@ uint32_t FF_CountFreeClusters( FF_IOManager_t * pxIOManager,
 FF_Error_t FF_ReleaseFATBuffers( FF_IOManager_t * pxIOManager,
                                  FF_FATBuffers_t * pxFATBuffers );
 
+#if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+    /* Forget the free-cluster bitmap, it will be rebuilt when needed. */
+    void FF_ReleaseFreeBitmap( FF_IOManager_t * pxIOManager );
+#endif
+
+#if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+
+/* Start a task that counts the free clusters and builds the free-cluster bitmap.
+ * Returns pdFALSE when the task could not be started, the caller must count the
+ * free clusters itself. */
+    BaseType_t FF_StartFreeScan( FF_IOManager_t * pxIOManager );
+
+/* Stop the background scan, if any, and wait until its task has finished. */
+    void FF_StopFreeScan( FF_IOManager_t * pxIOManager );
+
+/* pdTRUE as long as ulFreeClusterCount is not known because the scan is still running. */
+    #define FF_FreeScanBusy( pxIOManager )    ( ( pxIOManager )->xPartition.ucFreeScanBusy != pdFALSE )
+#else
+    #define FF_FreeScanBusy( pxIOManager )    ( pdFALSE )
+#endif
+
 static portINLINE void FF_InitFATBuffers( FF_FATBuffers_t * pxFATBuffers,
                                           uint8_t ucMode )
 {
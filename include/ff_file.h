@@ -39,7 +39,7 @@
 #define FF_SEEK_CUR                1
 #define FF_SEEK_END                2
 
-#if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 )
+#if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 )
     #define FF_BUFSTATE_INVALID    0x00             /* Data in file handle buffer is invalid. */
     #define FF_BUFSTATE_VALID      0x01             /* Valid data in pBuf (Something has been read into it). */
     #define FF_BUFSTATE_WRITTEN    0x02             /* Data was written into pBuf, this must be saved when leaving sector. */
@@ -53,6 +53,18 @@
     };
 #endif
 
+#if ( ffconfigFILE_EXTENT_MAP != 0 )
+
+/* Clusters 'ulFileCluster' up to 'ulFileCluster + ulLength - 1' of a file are
+ * stored contiguously on disk, starting at cluster 'ulCluster'. */
+    typedef struct xFF_FILE_EXTENT
+    {
+        uint32_t ulFileCluster; /* Relative cluster number within the file. */
+        uint32_t ulCluster;     /* Cluster number on the partition. */
+        uint32_t ulLength;      /* Number of clusters in the run. */
+    } FF_FileExtent_t;
+#endif
+
 typedef struct _FF_FILE
 {
     FF_IOManager_t * pxIOManager;  /* Ioman Pointer! */
@@ -66,13 +78,31 @@ typedef struct _FF_FILE
     uint32_t ulDirCluster;         /* Cluster Number that the Dirent is in. */
     uint32_t ulValidFlags;         /* Handle validation flags. */
 
-    #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 )
-        uint8_t * pucBuffer; /* A buffer for providing fast unaligned access. */
+    #if ( ffconfigOPTIMISE_UNALIGNED_ACCESS != 0 ) || ( ffconfigDIRECT_IO != 0 )
+        uint8_t * pucBuffer; /* A buffer for providing fast unaligned access, NULL if the cache is used instead. */
         uint8_t ucState;     /* State information about the buffer. */
     #endif
     uint8_t ucMode;          /* Mode that File Was opened in. */
     uint16_t usDirEntry;     /* Dirent Entry Number describing this file. */
 
+    #if ( ffconfigFILE_EXTENT_MAP != 0 )
+        FF_FileExtent_t xExtents[ ffconfigFILE_EXTENT_MAP ]; /* Runs of the cluster chain seen so far. */
+        uint16_t usExtentCount;                              /* Number of valid entries in xExtents[]. */
+    #endif
+
+    #if ( ffconfigDELAYED_ALLOCATION != 0 )
+        uint8_t * pucDelayedData; /* Data appended to the file that has no clusters yet, see ffconfigDELAYED_ALLOCATION. */
+        uint32_t ulDelayedLength; /* Number of bytes in pucDelayedData, they are at the end of the file. */
+    #endif
+
+    #if ( ffconfigREAD_AHEAD_SECTORS > 1 )
+        uint32_t ulLastReadLBA; /* The sector read last through FF_ReadPartial(), to detect sequential reads. */
+    #endif
+
+    #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        void * pvTransferDone; /* A binary semaphore to wait for submitted transfers, created when first needed. */
+    #endif
+
     #if ( ffconfigDEV_SUPPORT != 0 )
         struct SFileCache * pxDevNode;
     #endif
@@ -82,6 +112,8 @@ typedef struct _FF_FILE
 #define FF_VALID_FLAG_INVALID     0x00000001U
 #define FF_VALID_FLAG_DELETED     0x00000002U
 #define FF_VALID_FLAG_EXTENDED    0x00000004U
+#define FF_VALID_FLAG_RESERVED    0x00000008U /* FF_Preallocate() may have left clusters beyond the end of the file. */
+#define FF_VALID_FLAG_CACHED      0x00000010U /* Data of the file was written through the sector cache. */
 
 /*---------- PROTOTYPES */
 /* PUBLIC (Interfaces): */
@@ -154,6 +186,19 @@ typedef struct _FF_FILE
 
 FF_Error_t FF_SetEof( FF_FILE * pFile );
 
+/* Write the data that the handle holds back, see ffconfigDELAYED_ALLOCATION,
+ * and flush the cache. */
+FF_Error_t FF_FlushFile( FF_FILE * pFile );
+
+/* Make sure that clusters are allocated for the first 'ulSize' bytes of the
+ * file, as one contiguous run when possible.  The clusters are not cleared.
+ * When 'xKeepSize' is pdFALSE, the file size becomes 'ulSize', otherwise the
+ * clusters are only reserved, and those that are still beyond the end of the
+ * file are freed when the file is closed. */
+FF_Error_t FF_Preallocate( FF_FILE * pFile,
+                           uint32_t ulSize,
+                           BaseType_t xKeepSize );
+
 FF_Error_t FF_Close( FF_FILE * pFile );
 int32_t FF_GetC( FF_FILE * pFile );
 int32_t FF_GetLine( FF_FILE * pFile,
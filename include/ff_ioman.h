@@ -51,6 +51,8 @@
     #define FF_MODE_APPEND                  0x04                             /* FILE Mode Append Access. */
     #define FF_MODE_CREATE                  0x08                             /* FILE Mode Create file if not existing. */
     #define FF_MODE_TRUNCATE                0x10                             /* FILE Mode Truncate an Existing file. */
+    #define FF_MODE_DIRECT                  0x20                             /* FILE Mode Do not cache the contents (see ffconfigDIRECT_IO). */
+    #define FF_MODE_FILE_DATA               0x20                             /* Buffer mode: the sector holds file data, see ffconfigCACHE_POOLS. */
     #define FF_MODE_VIRGIN                  0x40                             /* Buffer mode: do not fetch content from disk. Used for write-only buffers. */
     #define FF_MODE_DIR                     0x80                             /* Special Mode to open a Dir. (Internal use ONLY!) */
 
@@ -113,6 +115,23 @@
                                  uint32_t ulHash );
     #endif /* ffconfigHASH_CACHE */
 
+    #if ( ffconfigLFN_INDEX != 0 )
+        typedef struct xLFN_INDEX_ENTRY
+        {
+            uint16_t usHash;  /* Hash of the case-folded name. */
+            uint16_t usEntry; /* The first directory entry of the name: its first LFN entry, or the short entry. */
+        } FF_LFNIndexEntry_t;
+
+        typedef struct xLFN_INDEX
+        {
+            uint32_t ulDirCluster;          /* The starting cluster of the indexed directory, or 0 when the slot is free. */
+            uint32_t ulLastUsed;            /* The value of 'ulLFNIndexClock' when this index was last used. */
+            FF_LFNIndexEntry_t * pxEntries; /* The names in the directory, or NULL when it has too many names. */
+            uint16_t usCount;               /* The number of entries in use. */
+            uint16_t usSpace;               /* The number of entries allocated. */
+        } FF_LFNIndex_t;
+    #endif /* ffconfigLFN_INDEX */
+
 /* A forward declaration for the I/O manager, to be used in 'struct xFFDisk'. */
     struct _FF_IOMAN;
     struct xFFDisk;
@@ -188,6 +207,39 @@
                                             uint32_t ulCount,
                                             FF_Disk_t * pxDisk );
 
+    #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        typedef struct xFF_BLOCK_REQUEST FF_BlockRequest_t;
+
+/* Called by the driver when a submitted transfer has finished.  'lResult' has
+ * the same meaning as the value returned by FF_ReadBlocks_t or FF_WriteBlocks_t.
+ * When called from an ISR, 'pxHigherPriorityTaskWoken' points to a variable
+ * that will be set to pdTRUE when a context switch is needed.  When called from
+ * a task, it must be NULL. */
+        typedef void ( * FF_BlockDone_t ) ( FF_BlockRequest_t * pxRequest,
+                                            int32_t lResult,
+                                            BaseType_t * pxHigherPriorityTaskWoken );
+
+        struct xFF_BLOCK_REQUEST
+        {
+            uint8_t * pucBuffer;      /* The data to be written, or the space for the data to be read. */
+            uint32_t ulSectorAddress; /* The first sector to transfer. */
+            uint32_t ulCount;         /* The number of sectors to transfer. */
+            BaseType_t xWrite;        /* pdTRUE for a write, pdFALSE for a read. */
+            FF_Disk_t * pxDisk;       /* The disk, as passed to FF_SubmitBlocks_t. */
+            FF_BlockDone_t fnDone;    /* To be called by the driver when the transfer has finished. */
+            void * pvDone;            /* Used by the library to wait for fnDone(). */
+            int32_t lResult;          /* The result passed to fnDone(). */
+        };
+
+/* Start a transfer and return without waiting for it to finish.  Return 0 when
+ * the request was accepted, the driver must call pxRequest->fnDone() exactly
+ * once, from its own task or ISR.  Any other value is an error, and fnDone()
+ * will not be called.  FF_ERR_DRIVER_BUSY means: try again later.  The driver
+ * is responsible for ordering its asynchronous and synchronous transfers. */
+        typedef int32_t ( * FF_SubmitBlocks_t ) ( FF_BlockRequest_t * pxRequest,
+                                                  FF_Disk_t * pxDisk );
+    #endif /* ffconfigASYNC_BLOCK_DEVICE */
+
 /**
  *	@public
  *	@brief	Describes the block device driver interface to FreeRTOS+FAT.
@@ -197,33 +249,84 @@
         FF_WriteBlocks_t fnpWriteBlocks; /* Function Pointer, to write a block(s) from a block device. */
         FF_ReadBlocks_t fnpReadBlocks;   /* Function Pointer, to read a block(s) from a block device. */
         FF_Disk_t * pxDisk;              /* Earlier called 'pParam': pointer to some parameters e.g. for a Low-Level Driver Handle. */
+        #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+            FF_SubmitBlocks_t fnpSubmitBlocks; /* Optional, to start a transfer without waiting for it. */
+        #endif
     } FF_BlockDevice_t;
 
+    #if ( ffconfigCACHE_POOLS != 0 )
+        #define FF_CACHE_POOL_FAT      0 /* Sectors of the FAT tables. */
+        #define FF_CACHE_POOL_DIR      1 /* Directory sectors, and any other sector that is not file data. */
+        #define FF_CACHE_POOL_DATA     2 /* File data, other pools borrow from this one when full. */
+        #define FF_CACHE_POOL_COUNT    3
+    #else
+        #define FF_CACHE_POOL_DATA     0 /* The one and only pool. */
+        #define FF_CACHE_POOL_COUNT    1
+    #endif
+
+    #if ( ffconfigCACHE_2Q != 0 )
+        #define FF_CACHE_QUEUE_MAIN     0 /* 2Q: sectors that were used again after a while, in LRU order. */
+        #define FF_CACHE_QUEUE_IN       1 /* 2Q: sectors that were read for the first time, in FIFO order. */
+        #define FF_CACHE_QUEUE_COUNT    2
+        #define FF_GHOST_NONE           0xFFFFU /* 2Q: the end of a hash chain of remembered sectors. */
+    #else
+        #define FF_CACHE_QUEUE_COUNT    1
+    #endif
+
+/* The number of lists of buffers, ordered from most to least recently used. */
+    #define FF_CACHE_LIST_COUNT         ( FF_CACHE_POOL_COUNT * FF_CACHE_QUEUE_COUNT )
+
 /**
  *	@private
  *	@brief	FreeRTOS+FAT handles memory with buffers, described as below.
  *	@note	This may change throughout development.
  **/
-    typedef struct
+    typedef struct xFF_BUFFER
     {
         uint32_t ulSector;      /* The LBA of the Cached sector. */
         uint32_t ulLRU;         /* For the Least Recently Used algorithm. */
         uint8_t * pucBuffer;    /* Pointer to the cache block. */
         uint32_t ucMode : 8,    /* Read or Write mode. */
                  bModified : 1, /* If the sector was modified since read. */
-                 bValid : 1;    /* Initially FALSE. */
+                 bValid : 1,    /* Initially FALSE. */
+                 bDiscard : 1;  /* The sector was written directly while the buffer had handles, see FF_DiscardBuffers(). */
         uint16_t usNumHandles;  /* Number of objects using this buffer. */
         uint16_t usPersistence; /* For the persistence algorithm. */
+        #if ( ffconfigCACHE_POOLS != 0 )
+            uint8_t ucPool;     /* The pool that owns this buffer, one of FF_CACHE_POOL_xxx. */
+        #endif
+        #if ( ffconfigCACHE_2Q != 0 )
+            uint8_t ucQueue;    /* The queue in which this buffer is, one of FF_CACHE_QUEUE_xxx. */
+        #endif
+        #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+            struct xFF_BUFFER * pxHashNext; /* Next valid buffer in the same hash bucket. */
+            struct xFF_BUFFER * pxLRUPrev;  /* Neighbour which was used more recently. */
+            struct xFF_BUFFER * pxLRUNext;  /* Neighbour which was used less recently. */
+        #endif
     } FF_Buffer_t;
 
+    #if ( ffconfigCACHE_POOLS != 0 )
+        typedef struct xFF_CACHE_POOL
+        {
+            uint16_t usFirst;  /* Index in 'pxBuffers' of the first buffer of the pool. */
+            uint16_t usCount;  /* The number of buffers in the pool. */
+            uint32_t ulHits;   /* The number of times FF_GetBuffer() found a sector in the cache. */
+            uint32_t ulMisses; /* The number of times FF_GetBuffer() had to recycle a buffer. */
+        } FF_CachePool_t;
+    #endif
+
+/* An entry of the path cache: the cluster of directory 'pcName' within the
+ * directory that starts at 'ulParentCluster'. */
     typedef struct
     {
         #if ( ffconfigUNICODE_UTF16_SUPPORT != 0 )
-            FF_T_WCHAR pcPath[ ffconfigMAX_FILENAME ];
+            FF_T_WCHAR pcName[ ffconfigMAX_FILENAME ];
         #else
-            char pcPath[ ffconfigMAX_FILENAME ];
+            char pcName[ ffconfigMAX_FILENAME ];
         #endif
-        uint32_t ulDirCluster;
+        uint32_t ulParentCluster;
+        uint32_t ulDirCluster; /* 0 when the entry is not in use. */
+        uint32_t ulLastUsed;   /* The value of 'ulPCClock' when the entry was last used. */
     } FF_PathCache_t;
 
 /**
@@ -262,7 +365,23 @@
 
         #if ( ffconfigPATH_CACHE != 0 )
             FF_PathCache_t pxPathCache[ ffconfigPATH_CACHE_DEPTH ];
-            uint32_t ulPCIndex;
+            uint32_t ulPCClock;  /* Incremented every time an entry is used. */
+            uint32_t ulPCHits;   /* The number of directory names found in the path cache. */
+            uint32_t ulPCMisses; /* The number of directory names that had to be searched on disk. */
+        #endif
+
+        #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+            uint32_t * pulFreeBitmap;  /* One bit per cluster, set when the cluster is free, or NULL when not built. */
+            uint8_t ucFreeBitmapNoMem; /* pdTRUE when the bitmap could not be allocated, don't try again until the next mount. */
+        #endif
+
+        #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+            uint32_t * pulScanBitmap; /* The bitmap being built by the background scan. */
+            uint32_t ulScanCluster;   /* The FAT entries below this one have been scanned. */
+            uint32_t ulScanFree;      /* The free clusters counted so far, plus the changes made while scanning. */
+            uint8_t ucFreeScanBusy;   /* pdTRUE until the scan has set ulFreeClusterCount. */
+            uint8_t ucFreeScanTask;   /* pdTRUE as long as the scan task exists. */
+            uint8_t ucFreeScanStop;   /* Set to pdTRUE to make the scan task give up. */
         #endif
     } FF_Partition_t;
 
@@ -274,9 +393,19 @@
  *
  *	FreeRTOS+FAT functions around an object like this.
  **/
-    #define FF_FAT_LOCK    0x01     /* Lock bit mask for FAT table locking. */
-    #define FF_DIR_LOCK    0x02     /* Lock bit mask for DIR modification locking. */
-    #define FF_BUF_LOCK    0x04     /* Lock bit mask for buffers. */
+    #define FF_FAT_LOCK           0x01 /* Lock bit mask for FAT table locking. */
+    #define FF_DIR_LOCK           0x02 /* Lock bit mask for DIR modification locking. */
+    #define FF_BUF_LOCK           0x04 /* Lock bit mask for buffers. */
+    #define FF_FAT_SHARED_LOCK    0x08 /* Lock bit mask for read-only access to the FAT, see FF_LockFATShared(). */
+
+/* A task that waits for a buffer in FF_GetBuffer() claims one of these slots,
+ * each with its own event bit.  FF_ReleaseBuffer() sets the bit when the
+ * buffer that the task waits for becomes free.  The slots use the event bits
+ * 0x10 to 0x80, which exist even when configUSE_16_BIT_TICKS is set.  A task
+ * that finds all slots in use waits for FF_BUF_LOCK. */
+    #define FF_BUF_WAIT_SLOTS       4
+    #define FF_BUF_WAIT_BIT( x )    ( ( uint32_t ) 0x10U << ( x ) )
+    #define FF_BUF_WAIT_ANY         0xFFFFFFFFUL /* The task waits for any buffer to become free. */
 
 /**
  *	@public
@@ -299,10 +428,67 @@
         uint16_t usCacheSize;        /* Size of the cache in number of Sectors. */
         uint8_t ucPreventFlush;      /* Flushing to disk only allowed when 0. */
         uint8_t ucFlags;             /* Bit-Mask: identifying allocated pointers and other flags */
+        uint8_t ucBufferWaitSlots;   /* Bit-Mask of the wait slots that are in use, see FF_BUF_WAIT_SLOTS. */
+        uint8_t ucBufferWaitOthers;  /* The number of tasks that wait for FF_BUF_LOCK, because all slots were in use. */
+        uint32_t ulBufferWaitSector[ FF_BUF_WAIT_SLOTS ]; /* Per slot, the sector that the task waits for, or FF_BUF_WAIT_ANY. */
         #if ( ffconfigHASH_CACHE != 0 )
             FF_HashTable_t xHashCache[ ffconfigHASH_CACHE_DEPTH ];
         #endif
+        #if ( ffconfigLFN_INDEX != 0 )
+            FF_LFNIndex_t xLFNIndex[ ffconfigLFN_INDEX_DEPTH ];
+            uint32_t ulLFNIndexClock;   /* Incremented for every look-up in an index. */
+            uint32_t ulLFNIndexChanges; /* Incremented for every change to an index, see prvLFNIndexBuild(). */
+        #endif
+        #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+            FF_Buffer_t ** ppxBufferHash;                     /* Hash buckets of valid buffers, stored right after 'pxBuffers'. */
+            FF_Buffer_t * pxLRUHead[ FF_CACHE_LIST_COUNT ]; /* Per pool and queue, the buffer that was used most recently. */
+            FF_Buffer_t * pxLRUTail[ FF_CACHE_LIST_COUNT ]; /* Per pool and queue, the buffer that was used least recently. */
+            uint32_t ulBufferHashMask;                        /* The number of hash buckets minus 1. */
+        #endif
+        #if ( ffconfigCACHE_2Q != 0 )
+            uint16_t usListLength[ FF_CACHE_LIST_COUNT ]; /* The number of buffers in each list. */
+            uint32_t * pulGhostSectors;                   /* A ring of sectors that left a FIFO queue recently. */
+            uint16_t * pusGhostLink;                      /* Per entry of 'pulGhostSectors', the next entry in the same hash chain. */
+            uint16_t * pusGhostBucket;                    /* Per hash bucket, the first entry of 'pulGhostSectors', or FF_GHOST_NONE. */
+            uint16_t usGhostCount;                        /* The number of entries in 'pulGhostSectors'. */
+            uint16_t usGhostNext;                         /* The entry that will be overwritten next. */
+        #endif
+        #if ( ffconfigCACHE_POOLS != 0 )
+            FF_CachePool_t xPools[ FF_CACHE_POOL_COUNT ];
+        #endif
+        #if ( ffconfigFLUSH_MERGE_SECTORS > 1 )
+            uint8_t * pucFlushMem;       /* A list of buffers to be sorted, followed by a bounce buffer, used by FF_FlushCache(). */
+            uint32_t ulFlushWriteCount;  /* The number of writes done by FF_FlushCache(). */
+            uint32_t ulFlushMergeCount;  /* The number of sector writes saved by merging adjacent sectors. */
+        #endif
+        #if ( ffconfigREAD_AHEAD_SECTORS > 1 )
+            uint8_t * pucReadAheadMem;   /* A bounce buffer for FF_ReadAhead(). */
+            uint32_t ulReadAheadCount;   /* The number of sectors read ahead. */
+            FF_Buffer_t * pxReadAheadBuffers[ ffconfigREAD_AHEAD_SECTORS ]; /* The buffers that FF_ReadAhead() fills. */
+            #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+                FF_BlockRequest_t xReadAheadRequest; /* The read-ahead that was submitted to the driver. */
+                uint16_t usReadAheadPending;         /* The number of sectors of 'xReadAheadRequest' still in flight, or 0. */
+                BaseType_t xReadAheadAdjacent;       /* pdTRUE when the driver reads straight into the buffers. */
+                uint32_t ulReadAheadMark;            /* The first sector of the last run read ahead. */
+                uint32_t ulReadAheadNext;            /* The sector after the last run read ahead. */
+            #endif
+        #endif
+        #if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
+            uint8_t * pucDirBlockMem;    /* Directory sectors read by FF_DirBlockRead(). */
+            uint32_t ulDirBlockSector;   /* The first sector in 'pucDirBlockMem'. */
+            uint32_t ulDirBlockCount;    /* The number of valid sectors in 'pucDirBlockMem', 0 when empty. */
+            void * pvDirBlockOwner;      /* The fetch context that uses 'pucDirBlockMem', or NULL. */
+            FF_Buffer_t xDirBlockBuffer; /* Points the owner to one sector in 'pucDirBlockMem', 'usNumHandles' is 1 while it reads it. */
+        #endif
         void * pvFATLockHandle;
+        #if ( ffconfigFAT_LOCK_READERS != 0 )
+            void * pvFATLockReaders[ ffconfigFAT_LOCK_READERS ]; /* The tasks that hold the FAT lock in shared mode. */
+            uint8_t ucFATLockReaderCount;                        /* The number of non-NULL entries in 'pvFATLockReaders'. */
+            uint8_t ucFATLockWritersWaiting;                     /* Tasks waiting in FF_LockFAT(), no new readers are admitted while non-zero. */
+        #endif
+        #if ( ffconfigDIRECTORY_LOCKS != 0 )
+            void * pvDirectoryLocks[ ffconfigDIRECTORY_LOCKS ]; /* Recursive mutexes, see FF_LockDirectoryCluster(). */
+        #endif
     } FF_IOManager_t;
 
 /* Bit values for 'FF_IOManager_t::ucFlags': */
@@ -324,6 +510,13 @@
         FF_Disk_t * pxDisk;                 /* Some properties of the disk driver. */
         void * pvSemaphore;                 /* Pointer to a Semaphore object. */
         BaseType_t xBlockDeviceIsReentrant; /* Make non-zero if ffRead/ffWrite are re-entrant. */
+        #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+            FF_SubmitBlocks_t fnSubmitBlocks; /* Optional, a function to start a transfer without waiting for it. */
+        #endif
+        #if ( ffconfigCACHE_POOLS != 0 )
+            uint32_t ulFATMemorySize;       /* Part of 'ulMemorySize' used for FAT sectors only, a multiple of 'ulSectorSize'. */
+            uint32_t ulDirMemorySize;       /* Part of 'ulMemorySize' used for directory sectors only, a multiple of 'ulSectorSize'. */
+        #endif
     } FF_CreationParameters_t;
 
 /*---------- PROTOTYPES (in order of appearance). */
@@ -360,6 +553,11 @@
                            uint32_t ulNumSectors,
                            void * pBuffer,
                            BaseType_t aSemLocked );
+    #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        int32_t FF_BlockSubmit( FF_IOManager_t * pxIOManager,
+                                FF_BlockRequest_t * pxRequest );
+        int32_t FF_BlockWait( FF_BlockRequest_t * pxRequest );
+    #endif
     FF_Error_t FF_IncreaseFreeClusters( FF_IOManager_t * pxIOManager,
                                         uint32_t Count );
     FF_Error_t FF_DecreaseFreeClusters( FF_IOManager_t * pxIOManager,
@@ -369,6 +567,25 @@
                                 uint8_t Mode );
     FF_Error_t FF_ReleaseBuffer( FF_IOManager_t * pxIOManager,
                                  FF_Buffer_t * pBuffer );
+    void FF_DiscardBuffers( FF_IOManager_t * pxIOManager,
+                            uint32_t ulSector,
+                            uint32_t ulCount );
+    FF_Error_t FF_FlushBuffers( FF_IOManager_t * pxIOManager,
+                                uint32_t ulSector,
+                                uint32_t ulCount );
+    #if ( ffconfigREAD_AHEAD_SECTORS > 1 )
+        int32_t FF_ReadAhead( FF_IOManager_t * pxIOManager,
+                              uint32_t ulSector,
+                              uint32_t ulCount );
+    #endif
+    #if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
+        int32_t FF_DirBlockRead( FF_IOManager_t * pxIOManager,
+                                 uint32_t ulSector,
+                                 uint32_t ulCount );
+        void FF_DirBlockRelease( FF_IOManager_t * pxIOManager,
+                                 void * pvOwner,
+                                 BaseType_t xDisown );
+    #endif
 
 /* 'Internal' to FreeRTOS+FAT. */
     typedef struct _SPart
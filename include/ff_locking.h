@@ -62,20 +62,42 @@
 /* Release the lock on all DIR operations. */
     void FF_UnlockDirectory( FF_IOManager_t * pxIOManager );
 
+/* Get a lock on changes to the directory that starts at 'ulDirCluster'.
+ * Other directories may be changed at the same time, see
+ * ffconfigDIRECTORY_LOCKS. */
+    void FF_LockDirectoryCluster( FF_IOManager_t * pxIOManager,
+                                  uint32_t ulDirCluster );
+
+/* Release a lock obtained with FF_LockDirectoryCluster(). */
+    void FF_UnlockDirectoryCluster( FF_IOManager_t * pxIOManager,
+                                    uint32_t ulDirCluster );
+
 /* Get a lock on all FAT operations for a given I/O manager. */
     void FF_LockFAT( FF_IOManager_t * pxIOManager );
 
 /* Release the lock on all FAT operations. */
     void FF_UnlockFAT( FF_IOManager_t * pxIOManager );
 
-/* Called from FF_GetBuffer() as long as no buffer is available. */
+/* Get a shared lock on the FAT, for operations that only read it.  Other
+ * readers may hold it at the same time, see ffconfigFAT_LOCK_READERS. */
+    void FF_LockFATShared( FF_IOManager_t * pxIOManager );
+
+/* Release a lock obtained with FF_LockFATShared(). */
+    void FF_UnlockFATShared( FF_IOManager_t * pxIOManager );
+
+/* Called from FF_GetBuffer() as long as no buffer is available.  Waits until
+ * one of the event bits in 'ulWaitBits' is set, and clears it. */
     BaseType_t FF_BufferWait( FF_IOManager_t * pxIOManager,
+                              uint32_t ulWaitBits,
                               uint32_t xWaitMS );
 
-/* Called from FF_ReleaseBuffer(). */
-    void FF_BufferProceed( FF_IOManager_t * pxIOManager );
+/* Called from FF_ReleaseBuffer(), sets the event bits of the tasks that can
+ * proceed now. */
+    void FF_BufferProceed( FF_IOManager_t * pxIOManager,
+                           uint32_t ulWakeBits );
 
-/* Check if the current task already has locked the FAT. */
+/* Check if the current task already has locked the FAT.  With FF_FAT_LOCK
+ * only exclusive ownership counts, with FF_FAT_SHARED_LOCK either mode. */
     int FF_Has_Lock( FF_IOManager_t * pxIOManager,
                      uint32_t aBits );
 
@@ -94,6 +94,15 @@ typedef union
     FF_TLong_t bytes;
 } FF_T_UN32;
 
+/* On a little endian CPU that allows unaligned access, a value in a sector
+ * buffer is accessed with a single load or store.  The fixed-size memcpy()
+ * calls below are turned into one instruction by the compiler. */
+#if ( ffconfigBYTE_ORDER == pdFREERTOS_LITTLE_ENDIAN ) && ( ffconfigUNALIGNED_ACCESS != 0 )
+    #define ffMEMORY_WORD_ACCESS    1
+#else
+    #define ffMEMORY_WORD_ACCESS    0
+#endif
+
 /*	HT inlined these functions:
  */
 
@@ -111,8 +120,12 @@ typedef union
         FF_T_UN16 u16;
 
         pBuffer += aOffset;
-        u16.bytes.u8_1 = pBuffer[ 1 ];
-        u16.bytes.u8_0 = pBuffer[ 0 ];
+        #if ( ffMEMORY_WORD_ACCESS != 0 )
+            memcpy( &( u16.u16 ), pBuffer, sizeof( u16.u16 ) );
+        #else
+            u16.bytes.u8_1 = pBuffer[ 1 ];
+            u16.bytes.u8_0 = pBuffer[ 0 ];
+        #endif
 
         return u16.u16;
     }
@@ -123,10 +136,14 @@ typedef union
         FF_T_UN32 u32;
 
         pBuffer += aOffset;
-        u32.bytes.u8_3 = pBuffer[ 3 ];
-        u32.bytes.u8_2 = pBuffer[ 2 ];
-        u32.bytes.u8_1 = pBuffer[ 1 ];
-        u32.bytes.u8_0 = pBuffer[ 0 ];
+        #if ( ffMEMORY_WORD_ACCESS != 0 )
+            memcpy( &( u32.u32 ), pBuffer, sizeof( u32.u32 ) );
+        #else
+            u32.bytes.u8_3 = pBuffer[ 3 ];
+            u32.bytes.u8_2 = pBuffer[ 2 ];
+            u32.bytes.u8_1 = pBuffer[ 1 ];
+            u32.bytes.u8_0 = pBuffer[ 0 ];
+        #endif
 
         return u32.u32;
     }
@@ -146,8 +163,12 @@ typedef union
 
         u16.u16 = ( uint16_t ) Value;
         pBuffer += aOffset;
-        pBuffer[ 0 ] = u16.bytes.u8_0;
-        pBuffer[ 1 ] = u16.bytes.u8_1;
+        #if ( ffMEMORY_WORD_ACCESS != 0 )
+            memcpy( pBuffer, &( u16.u16 ), sizeof( u16.u16 ) );
+        #else
+            pBuffer[ 0 ] = u16.bytes.u8_0;
+            pBuffer[ 1 ] = u16.bytes.u8_1;
+        #endif
     }
 
     static portINLINE void FF_putLong( uint8_t * pBuffer,
@@ -158,10 +179,14 @@ typedef union
 
         u32.u32 = Value;
         pBuffer += aOffset;
-        pBuffer[ 0 ] = u32.bytes.u8_0;
-        pBuffer[ 1 ] = u32.bytes.u8_1;
-        pBuffer[ 2 ] = u32.bytes.u8_2;
-        pBuffer[ 3 ] = u32.bytes.u8_3;
+        #if ( ffMEMORY_WORD_ACCESS != 0 )
+            memcpy( pBuffer, &( u32.u32 ), sizeof( u32.u32 ) );
+        #else
+            pBuffer[ 0 ] = u32.bytes.u8_0;
+            pBuffer[ 1 ] = u32.bytes.u8_1;
+            pBuffer[ 2 ] = u32.bytes.u8_2;
+            pBuffer[ 3 ] = u32.bytes.u8_3;
+        #endif
     }
 
 #else /* ffconfigINLINE_MEMORY_ACCESS */
@@ -184,4 +209,15 @@ typedef union
 
 #endif /* ffconfigINLINE_MEMORY_ACCESS */
 
+/* Decode 'ulCount' consecutive 32-bit or 16-bit little endian values, such as
+ * the entries of a FAT sector, into an array of native 32-bit values. */
+void FF_getLongs( const uint8_t * pBuffer,
+                  uint32_t aOffset,
+                  uint32_t * pulValues,
+                  uint32_t ulCount );
+void FF_getShorts( const uint8_t * pBuffer,
+                   uint32_t aOffset,
+                   uint32_t * pulValues,
+                   uint32_t ulCount );
+
 #endif /* _FF_MEMORY_H_ */
@@ -71,6 +71,9 @@
     #define FF_FA_DIREC                          0x10
     #define FF_FA_ARCH                           0x20
 
+/* Bits used in the 'iMode' parameter of ff_fallocate(). */
+    #define FF_FALLOC_KEEP_SIZE                  0x01
+
 /* FreeRTOS+FAT uses three thread local buffers.  The first stores errno, the
  * second a pointer to the CWD structure (if one is used), and the third the more
  * descriptive error code. */
@@ -257,6 +260,20 @@
  *-----------------------------------------------------------*/
     int ff_seteof( FF_FILE * pxStream );
 
+/*-----------------------------------------------------------
+ * Allocate disk space for the bytes from 0 to ( lOffset + lLength ) of a file,
+ * as one contiguous run when possible.  The new space is not cleared.
+ * With FF_FALLOC_KEEP_SIZE in iMode, the length of the file does not change,
+ * and the space that is still beyond the end of the file is freed when the
+ * file is closed.  Otherwise the file will have at least this length.
+ * File should have been opened in "w", "a" or "+" mode.
+ * Returns 0 on success, or -1 with an error code in ff_errno.
+ *-----------------------------------------------------------*/
+    int ff_fallocate( FF_FILE * pxStream,
+                      int iMode,
+                      long lOffset,
+                      long lLength );
+
 /*-----------------------------------------------------------
  * Open a file in append/update mode, truncate its length to a given value,
  * or write zero's up until the required length, and return a handle to the open
@@ -371,6 +388,16 @@
     int ff_findfirst( const char * pcDirectory,
                       FF_FindData_t * pxFindData );
     int ff_findnext( FF_FindData_t * pxFindData );
+
+/* Fill 'pxEntries' with up to 'xMaxEntries' entries of a directory.  A
+ * non-NULL 'pcDirectory' starts a new listing, pass NULL to continue it.
+ * The physical entries are read in one pass while the directory is locked.
+ * Returns the number of entries stored, 0 at the end of the listing, or -1
+ * with errno set. */
+    int ff_readdir_batch( const char * pcDirectory,
+                          FF_FindData_t * pxFindData,
+                          FF_DirInfo_t * pxEntries,
+                          size_t xMaxEntries );
     int ff_isdirempty( const char * pcPath );
 
 
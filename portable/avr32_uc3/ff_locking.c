@@ -65,8 +65,13 @@
 #define FF_FAT_LOCK_EVENT_BITS    ( ( const EventBits_t ) FF_FAT_LOCK )
 #define FF_DIR_LOCK_EVENT_BITS    ( ( const EventBits_t ) FF_DIR_LOCK )
 
+/* This port has no readers' lock on the FAT: FF_LockFATShared() takes the
+ * exclusive lock, so a task that holds FF_FAT_SHARED_LOCK owns the FAT. */
+#define FF_FAT_SHARED_LOCK_EVENT_BITS    ( ( const EventBits_t ) FF_FAT_SHARED_LOCK )
+
 /* This is not a real lock: it is a bit (or semaphore) will will be given
- * each time when a sector buffer is released. */
+ * when a sector buffer is released while tasks wait for it.  Tasks that
+ * got a wait slot use the bits FF_BUF_WAIT_BIT( x ) instead. */
 #define FF_BUF_LOCK_EVENT_BITS    ( ( const EventBits_t ) FF_BUF_LOCK )
 
 extern void myTaskDelay( unsigned aTime );
@@ -260,6 +265,24 @@ void FF_UnlockDirectory( FF_IOManager_t * pxIOManager )
 }
 /*-----------------------------------------------------------*/
 
+void FF_LockDirectoryCluster( FF_IOManager_t * pxIOManager,
+                              uint32_t ulDirCluster )
+{
+    /* This port has no table of directory locks, see ffconfigDIRECTORY_LOCKS:
+     * all directories are locked. */
+    ( void ) ulDirCluster;
+    FF_LockDirectory( pxIOManager );
+}
+/*-----------------------------------------------------------*/
+
+void FF_UnlockDirectoryCluster( FF_IOManager_t * pxIOManager,
+                                uint32_t ulDirCluster )
+{
+    ( void ) ulDirCluster;
+    FF_UnlockDirectory( pxIOManager );
+}
+/*-----------------------------------------------------------*/
+
 int FF_Has_Lock( FF_IOManager_t * pxIOManager,
                  uint32_t aBits )
 {
@@ -267,7 +290,7 @@ int FF_Has_Lock( FF_IOManager_t * pxIOManager,
 
     void * handle = xTaskGetCurrentTaskHandle();
 
-    if( ( aBits & FF_FAT_LOCK_EVENT_BITS ) != 0 )
+    if( ( aBits & ( FF_FAT_LOCK_EVENT_BITS | FF_FAT_SHARED_LOCK_EVENT_BITS ) ) != 0 )
     {
         if( ( pxIOManager->pvFATLockHandle != NULL ) && ( pxIOManager->pvFATLockHandle == handle ) )
         {
@@ -291,7 +314,7 @@ void FF_Assert_Lock( FF_IOManager_t * pxIOManager,
 {
     void * handle = xTaskGetCurrentTaskHandle();
 
-    if( ( aBits & FF_FAT_LOCK_EVENT_BITS ) != 0 )
+    if( ( aBits & ( FF_FAT_LOCK_EVENT_BITS | FF_FAT_SHARED_LOCK_EVENT_BITS ) ) != 0 )
     {
         configASSERT( pxIOManager->pvFATLockHandle != NULL && pxIOManager->pvFATLockHandle == handle );
 
@@ -353,7 +376,21 @@ void FF_UnlockFAT( FF_IOManager_t * pxIOManager )
 }
 /*-----------------------------------------------------------*/
 
+void FF_LockFATShared( FF_IOManager_t * pxIOManager )
+{
+    /* Readers are not told apart from writers in this port. */
+    FF_LockFAT( pxIOManager );
+}
+/*-----------------------------------------------------------*/
+
+void FF_UnlockFATShared( FF_IOManager_t * pxIOManager )
+{
+    FF_UnlockFAT( pxIOManager );
+}
+/*-----------------------------------------------------------*/
+
 BaseType_t FF_BufferWait( FF_IOManager_t * pxIOManager,
+                          uint32_t ulWaitBits,
                           uint32_t xWaitMS )
 {
     EventBits_t xBits;
@@ -362,12 +399,12 @@ BaseType_t FF_BufferWait( FF_IOManager_t * pxIOManager,
     /* This function is called when a task is waiting for a sector buffer
      * to become available. */
     xBits = xEventGroupWaitBits( pxIOManager->xEventGroup,
-                                 FF_BUF_LOCK_EVENT_BITS, /* uxBitsToWaitFor */
-                                 FF_BUF_LOCK_EVENT_BITS, /* xClearOnExit */
-                                 pdFALSE,                /* xWaitForAllBits n.a. */
+                                 ( EventBits_t ) ulWaitBits, /* uxBitsToWaitFor */
+                                 pdTRUE,                     /* xClearOnExit */
+                                 pdFALSE,                    /* xWaitForAllBits n.a. */
                                  pdMS_TO_TICKS( xWaitMS ) );
 
-    if( ( xBits & FF_BUF_LOCK_EVENT_BITS ) != 0 )
+    if( ( xBits & ( EventBits_t ) ulWaitBits ) != 0 )
     {
         xReturn = pdTRUE;
     }
@@ -380,9 +417,10 @@ BaseType_t FF_BufferWait( FF_IOManager_t * pxIOManager,
 }
 /*-----------------------------------------------------------*/
 
-void FF_BufferProceed( FF_IOManager_t * pxIOManager )
+void FF_BufferProceed( FF_IOManager_t * pxIOManager,
+                       uint32_t ulWakeBits )
 {
-    /* Wake-up all tasks that are waiting for a sector buffer to become available. */
-    xEventGroupSetBits( pxIOManager->xEventGroup, FF_BUF_LOCK_EVENT_BITS );
+    /* Wake-up the tasks that are waiting for a sector buffer to become available. */
+    xEventGroupSetBits( pxIOManager->xEventGroup, ( EventBits_t ) ulWakeBits );
 }
 /*-----------------------------------------------------------*/
@@ -35,6 +35,7 @@
 #include "task.h"
 #include "semphr.h"
 #include "portmacro.h"
+#include "portable.h"
 
 /* FreeRTOS+FAT includes. */
 #include "ff_headers.h"
@@ -53,6 +54,27 @@
  * disk. */
 #define ramSIGNATURE              0x41404342
 
+#if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+    #include "queue.h"
+
+/* The number of requests that can wait for the worker task.  A submission
+ * when the queue is full gets FF_ERR_DRIVER_BUSY. */
+    #ifndef ramASYNC_QUEUE_LENGTH
+        #define ramASYNC_QUEUE_LENGTH    4
+    #endif
+
+/* The worker task plays the role of a DMA controller. */
+    #ifndef ramASYNC_TASK_PRIORITY
+        #define ramASYNC_TASK_PRIORITY    ( configMAX_PRIORITIES - 1 )
+    #endif
+
+/* The stack of the worker task, in words.  It only calls memcpy() and the
+ * fnDone() function of the requests. */
+    #ifndef ramASYNC_TASK_STACK_SIZE
+        #define ramASYNC_TASK_STACK_SIZE    configMINIMAL_STACK_SIZE
+    #endif
+#endif /* ffconfigASYNC_BLOCK_DEVICE */
+
 /*-----------------------------------------------------------*/
 
 /*
@@ -80,6 +102,33 @@ static int32_t prvReadRAM( uint8_t * pucBuffer,
  */
 static FF_Error_t prvPartitionAndFormatDisk( FF_Disk_t * pxDisk );
 
+#if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+
+/*
+ * Pass a request to the worker task, which performs it with prvReadRAM() or
+ * prvWriteRAM() and reports the result through pxRequest->fnDone().
+ */
+    static int32_t prvSubmitRAM( FF_BlockRequest_t * pxRequest,
+                                 FF_Disk_t * pxDisk );
+
+/*
+ * The worker task, shared by all RAM disks.  'pvParameters' is its queue.
+ */
+    static void prvRAMDiskTask( void * pvParameters );
+
+/*
+ * Let the worker task delete its queue and itself once no disk uses it.
+ */
+    static void prvRAMDiskTaskStop( void );
+
+/* The requests for the worker task, created together with the task by the
+ * first call to FF_RAMDiskInit(). */
+    static QueueHandle_t xRAMDiskQueue = NULL;
+
+/* The number of disks that submit requests to the worker task. */
+    static UBaseType_t uxRAMDiskCount = 0U;
+#endif /* ffconfigASYNC_BLOCK_DEVICE */
+
 /*-----------------------------------------------------------*/
 
 /* This is the prototype of the function used to initialise the RAM disk driver.
@@ -140,6 +189,28 @@ FF_Disk_t * FF_RAMDiskInit( char * pcName,
         xParameters.fnReadBlocks = prvReadRAM;
         xParameters.pxDisk = pxDisk;
 
+        #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        {
+            if( xRAMDiskQueue == NULL )
+            {
+                xRAMDiskQueue = xQueueCreate( ramASYNC_QUEUE_LENGTH, sizeof( FF_BlockRequest_t * ) );
+
+                if( ( xRAMDiskQueue != NULL ) &&
+                    ( xTaskCreate( prvRAMDiskTask, "RAMDisk", ramASYNC_TASK_STACK_SIZE, ( void * ) xRAMDiskQueue, ramASYNC_TASK_PRIORITY, NULL ) != pdPASS ) )
+                {
+                    vQueueDelete( xRAMDiskQueue );
+                    xRAMDiskQueue = NULL;
+                }
+            }
+
+            /* Without a worker task, only the synchronous functions are used. */
+            if( xRAMDiskQueue != NULL )
+            {
+                xParameters.fnSubmitBlocks = prvSubmitRAM;
+            }
+        }
+        #endif /* ffconfigASYNC_BLOCK_DEVICE */
+
         /* Driver is reentrant so xBlockDeviceIsReentrant can be set to pdTRUE.
          * In this case the semaphore is only used to protect FAT data
          * structures. */
@@ -148,6 +219,15 @@ FF_Disk_t * FF_RAMDiskInit( char * pcName,
 
         pxDisk->pxIOManager = FF_CreateIOManager( &xParameters, &xError );
 
+        #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        {
+            if( ( pxDisk->pxIOManager != NULL ) && ( xParameters.fnSubmitBlocks != NULL ) )
+            {
+                uxRAMDiskCount++;
+            }
+        }
+        #endif
+
         if( ( pxDisk->pxIOManager != NULL ) && ( FF_isERR( xError ) == pdFALSE ) )
         {
             /* Record that the RAM disk has been initialised. */
@@ -200,6 +280,8 @@ FF_Disk_t * FF_RAMDiskInit( char * pcName,
 
 BaseType_t FF_RAMDiskDelete( FF_Disk_t * pxDisk )
 {
+    SemaphoreHandle_t xSemaphore;
+
     if( pxDisk != NULL )
     {
         pxDisk->ulSignature = 0;
@@ -207,10 +289,34 @@ BaseType_t FF_RAMDiskDelete( FF_Disk_t * pxDisk )
 
         if( pxDisk->pxIOManager != NULL )
         {
+            #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+            {
+                if( pxDisk->pxIOManager->xBlkDevice.fnpSubmitBlocks != NULL )
+                {
+                    uxRAMDiskCount--;
+                }
+            }
+            #endif
+
+            xSemaphore = ( SemaphoreHandle_t ) pxDisk->pxIOManager->pvSemaphore;
             FF_DeleteIOManager( pxDisk->pxIOManager );
+
+            /* The mutex was created by FF_RAMDiskInit(). */
+            if( xSemaphore != NULL )
+            {
+                vSemaphoreDelete( xSemaphore );
+            }
         }
 
         vPortFree( pxDisk );
+
+        #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        {
+            /* The I/O manager waited for its requests, a worker task that
+             * no disk uses any more can go. */
+            prvRAMDiskTaskStop();
+        }
+        #endif
     }
 
     return pdPASS;
@@ -331,6 +437,82 @@ static int32_t prvWriteRAM( uint8_t * pucSource,
 }
 /*-----------------------------------------------------------*/
 
+#if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+
+    static int32_t prvSubmitRAM( FF_BlockRequest_t * pxRequest,
+                                 FF_Disk_t * pxDisk )
+    {
+        int32_t lReturn;
+
+        if( ( pxDisk == NULL ) || ( pxDisk->ulSignature != ramSIGNATURE ) )
+        {
+            lReturn = FF_ERR_IOMAN_DRIVER_FATAL_ERROR | FF_ERRFLAG;
+        }
+        else if( xQueueSend( xRAMDiskQueue, &pxRequest, 0U ) != pdPASS )
+        {
+            /* FF_BlockSubmit() will try again later. */
+            lReturn = ( int32_t ) FF_ERR_DRIVER_BUSY;
+        }
+        else
+        {
+            lReturn = FF_ERR_NONE;
+        }
+
+        return lReturn;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvRAMDiskTask( void * pvParameters )
+    {
+        QueueHandle_t xQueue = ( QueueHandle_t ) pvParameters;
+        FF_BlockRequest_t * pxRequest = NULL;
+        int32_t lResult;
+
+        for( ; ; )
+        {
+            if( xQueueReceive( xQueue, &pxRequest, portMAX_DELAY ) == pdPASS )
+            {
+                if( pxRequest == NULL )
+                {
+                    /* Sent by prvRAMDiskTaskStop(). */
+                    break;
+                }
+
+                if( pxRequest->xWrite != pdFALSE )
+                {
+                    lResult = prvWriteRAM( pxRequest->pucBuffer, pxRequest->ulSectorAddress, pxRequest->ulCount, pxRequest->pxDisk );
+                }
+                else
+                {
+                    lResult = prvReadRAM( pxRequest->pucBuffer, pxRequest->ulSectorAddress, pxRequest->ulCount, pxRequest->pxDisk );
+                }
+
+                /* Called from a task, so no context switch has to be requested. */
+                pxRequest->fnDone( pxRequest, lResult, NULL );
+            }
+        }
+
+        vQueueDelete( xQueue );
+        vTaskDelete( NULL );
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvRAMDiskTaskStop( void )
+    {
+        FF_BlockRequest_t * pxStop = NULL;
+
+        if( ( uxRAMDiskCount == 0U ) && ( xRAMDiskQueue != NULL ) )
+        {
+            /* No disk submits requests any more, so the queue has room.  The
+             * next call to FF_RAMDiskInit() creates a new queue and task. */
+            ( void ) xQueueSend( xRAMDiskQueue, &pxStop, portMAX_DELAY );
+            xRAMDiskQueue = NULL;
+        }
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* ffconfigASYNC_BLOCK_DEVICE */
+
 static FF_Error_t prvPartitionAndFormatDisk( FF_Disk_t * pxDisk )
 {
     FF_PartitionParameters_t xPartition;
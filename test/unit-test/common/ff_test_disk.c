@@ -0,0 +1,271 @@
+/*
+ * A RAM disk and a formatted volume for the tests that run the library on an
+ * in-memory block device.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * This file is compiled into every test that uses it, with the options of
+ * the library that the test links, so that it sees the same structures.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "unity.h"
+
+#include "ff_headers.h"
+#include "ff_test_disk.h"
+
+FF_Disk_t xTestDisk;
+uint8_t * pucTestDiskMemory = NULL;
+uint32_t ulTestDiskSectors = 0U;
+
+uint32_t ulTestDiskReadCalls = 0U;
+uint32_t ulTestDiskSectorsRead = 0U;
+
+uint32_t ulTestDiskRegionReads = 0U;
+uint32_t ulTestDiskRegionWrites = 0U;
+
+uint32_t ulTestDiskReadDelayUs = 0U;
+
+static uint32_t ulRegionFirst = 0U;
+static uint32_t ulRegionCount = 0U;
+
+#if defined( TEST_MALLOC_CAN_FAIL ) && ( TEST_MALLOC_CAN_FAIL != 0 )
+    BaseType_t xTestMallocFails = pdFALSE;
+
+    void * pvTestMalloc( size_t uxSize )
+    {
+        return ( xTestMallocFails != pdFALSE ) ? NULL : malloc( uxSize );
+    }
+#endif
+
+/*-----------------------------------------------------------*/
+/* Block device callbacks.                                    */
+/*-----------------------------------------------------------*/
+
+/* The number of sectors of a transfer that lie in the watched region. */
+static uint32_t prvSectorsInRegion( uint32_t ulSectorAddress,
+                                    uint32_t ulCount )
+{
+    uint32_t ulStart = ( ulSectorAddress > ulRegionFirst ) ? ulSectorAddress : ulRegionFirst;
+    uint32_t ulEnd = ( ( ulSectorAddress + ulCount ) < ( ulRegionFirst + ulRegionCount ) ) ?
+                     ( ulSectorAddress + ulCount ) : ( ulRegionFirst + ulRegionCount );
+
+    return ( ulEnd > ulStart ) ? ( ulEnd - ulStart ) : 0U;
+}
+
+static int32_t prvReadBlocks( uint8_t * pucBuffer,
+                              uint32_t ulSectorAddress,
+                              uint32_t ulCount,
+                              FF_Disk_t * pxDisk )
+{
+    ( void ) pxDisk;
+
+    if( ( ulSectorAddress + ulCount ) > ulTestDiskSectors )
+    {
+        return -1;
+    }
+
+    if( ulTestDiskReadDelayUs != 0U )
+    {
+        struct timespec xDelay = { 0, ( long ) ulTestDiskReadDelayUs * 1000L };
+
+        ( void ) nanosleep( &xDelay, NULL );
+    }
+
+    memcpy( pucBuffer,
+            &pucTestDiskMemory[ ( size_t ) ulSectorAddress * testDISK_SECTOR_SIZE ],
+            ( size_t ) ulCount * testDISK_SECTOR_SIZE );
+
+    ulTestDiskReadCalls++;
+    ulTestDiskSectorsRead += ulCount;
+    ulTestDiskRegionReads += prvSectorsInRegion( ulSectorAddress, ulCount );
+
+    return ( int32_t ) ulCount;
+}
+
+static int32_t prvWriteBlocks( uint8_t * pucBuffer,
+                               uint32_t ulSectorAddress,
+                               uint32_t ulCount,
+                               FF_Disk_t * pxDisk )
+{
+    ( void ) pxDisk;
+
+    if( ( ulSectorAddress + ulCount ) > ulTestDiskSectors )
+    {
+        return -1;
+    }
+
+    memcpy( &pucTestDiskMemory[ ( size_t ) ulSectorAddress * testDISK_SECTOR_SIZE ],
+            pucBuffer,
+            ( size_t ) ulCount * testDISK_SECTOR_SIZE );
+
+    ulTestDiskRegionWrites += prvSectorsInRegion( ulSectorAddress, ulCount );
+
+    return ( int32_t ) ulCount;
+}
+
+/*-----------------------------------------------------------*/
+/* Disk and volume.                                           */
+/*-----------------------------------------------------------*/
+
+void vTestDiskInit( uint32_t ulSectorCount )
+{
+    vTestDiskFree();
+
+    pucTestDiskMemory = ( uint8_t * ) calloc( ulSectorCount, testDISK_SECTOR_SIZE );
+    TEST_ASSERT_NOT_NULL( pucTestDiskMemory );
+    ulTestDiskSectors = ulSectorCount;
+
+    memset( &xTestDisk, 0, sizeof( xTestDisk ) );
+    xTestDisk.ulNumberOfSectors = ulSectorCount;
+
+    ulTestDiskReadCalls = 0U;
+    ulTestDiskSectorsRead = 0U;
+    ulTestDiskReadDelayUs = 0U;
+    vTestDiskWatch( 0U, 0U );
+
+    #if defined( TEST_MALLOC_CAN_FAIL ) && ( TEST_MALLOC_CAN_FAIL != 0 )
+        xTestMallocFails = pdFALSE;
+    #endif
+}
+
+void vTestDiskWatch( uint32_t ulFirst,
+                     uint32_t ulCount )
+{
+    ulRegionFirst = ulFirst;
+    ulRegionCount = ulCount;
+    ulTestDiskRegionReads = 0U;
+    ulTestDiskRegionWrites = 0U;
+}
+
+void vTestDiskWatchFAT( const FF_IOManager_t * pxIOManager )
+{
+    vTestDiskWatch( pxIOManager->xPartition.ulFATBeginLBA,
+                    pxIOManager->xPartition.ulSectorsPerFAT * pxIOManager->xPartition.ucNumFATS );
+}
+
+void vTestDiskFree( void )
+{
+    if( xTestDisk.pxIOManager != NULL )
+    {
+        vTestDiskDeleteVolume();
+    }
+
+    free( pucTestDiskMemory );
+    pucTestDiskMemory = NULL;
+    ulTestDiskSectors = 0U;
+}
+
+void vTestDiskParameters( FF_CreationParameters_t * pxParameters,
+                          uint32_t ulCacheSectors )
+{
+    memset( pxParameters, 0, sizeof( *pxParameters ) );
+    pxParameters->ulMemorySize = ulCacheSectors * testDISK_SECTOR_SIZE;
+    pxParameters->ulSectorSize = testDISK_SECTOR_SIZE;
+    pxParameters->fnReadBlocks = prvReadBlocks;
+    pxParameters->fnWriteBlocks = prvWriteBlocks;
+    pxParameters->pxDisk = &xTestDisk;
+    pxParameters->pvSemaphore = NULL;
+    pxParameters->xBlockDeviceIsReentrant = pdTRUE;
+}
+
+FF_IOManager_t * pxTestDiskFormat( const FF_CreationParameters_t * pxParameters,
+                                   BaseType_t xPreferFAT16 )
+{
+    FF_CreationParameters_t xParameters = *pxParameters;
+    FF_PartitionParameters_t xPartition;
+    FF_Error_t xError = FF_ERR_NONE;
+
+    TEST_ASSERT_NOT_NULL( pucTestDiskMemory );
+    TEST_ASSERT_NULL( xTestDisk.pxIOManager );
+
+    xTestDisk.pxIOManager = FF_CreateIOManager( &xParameters, &xError );
+    TEST_ASSERT_NOT_NULL( xTestDisk.pxIOManager );
+    xTestDisk.xStatus.bIsInitialised = pdTRUE;
+
+    memset( &xPartition, 0, sizeof( xPartition ) );
+    xPartition.ulSectorCount = ulTestDiskSectors;
+    xPartition.ulHiddenSectors = testDISK_HIDDEN_SECTORS;
+    xPartition.xPrimaryCount = 1;
+    xPartition.eSizeType = eSizeIsQuota;
+
+    xError = FF_Partition( &xTestDisk, &xPartition );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    xError = FF_Format( &xTestDisk, 0, xPreferFAT16, pdTRUE );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    xError = FF_Mount( &xTestDisk, 0 );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    return xTestDisk.pxIOManager;
+}
+
+FF_IOManager_t * pxTestDiskCreateVolume( uint32_t ulCacheSectors )
+{
+    FF_CreationParameters_t xParameters;
+
+    vTestDiskParameters( &xParameters, ulCacheSectors );
+
+    return pxTestDiskFormat( &xParameters, pdTRUE );
+}
+
+void vTestDiskDeleteVolume( void )
+{
+    ( void ) FF_Unmount( &xTestDisk );
+    ( void ) FF_DeleteIOManager( xTestDisk.pxIOManager );
+    xTestDisk.pxIOManager = NULL;
+}
+
+/*-----------------------------------------------------------*/
+/* Directory helpers.                                         */
+/*-----------------------------------------------------------*/
+
+void vTestDiskCreateFiles( FF_IOManager_t * pxIOManager,
+                           const char * pcDirectory,
+                           uint32_t ulCount )
+{
+    char pcName[ 32 ];
+    FF_FILE * pxFile;
+    FF_Error_t xError;
+    uint32_t ulIndex;
+
+    xError = FF_MkDir( pxIOManager, pcDirectory );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+    {
+        snprintf( pcName, sizeof( pcName ), "%s/F%07u.TXT", pcDirectory, ( unsigned ) ulIndex );
+        pxFile = FF_Open( pxIOManager, pcName, FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+        TEST_ASSERT_NOT_NULL( pxFile );
+
+        if( ( ulIndex % 10U ) == 0U )
+        {
+            TEST_ASSERT_EQUAL_INT32( ( int32_t ) ( ulIndex % 97U ) + 1,
+                                     FF_Write( pxFile, 1, ( ulIndex % 97U ) + 1U, ( uint8_t * ) pcName ) );
+        }
+
+        xError = FF_Close( pxFile );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    }
+}
+
+void vTestDiskAssertSameEntries( const FF_DirInfo_t * pxExpected,
+                                 const FF_DirInfo_t * pxActual,
+                                 uint32_t ulCount )
+{
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+    {
+        TEST_ASSERT_EQUAL_STRING( pxExpected[ ulIndex ].pcFileName, pxActual[ ulIndex ].pcFileName );
+        TEST_ASSERT_EQUAL_UINT32( pxExpected[ ulIndex ].ulFileSize, pxActual[ ulIndex ].ulFileSize );
+        TEST_ASSERT_EQUAL_UINT32( pxExpected[ ulIndex ].ulObjectCluster, pxActual[ ulIndex ].ulObjectCluster );
+        TEST_ASSERT_EQUAL_HEX8( pxExpected[ ulIndex ].ucAttrib, pxActual[ ulIndex ].ucAttrib );
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * A RAM disk and a formatted volume for the tests that run the library on an
+ * in-memory block device.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * The disk is allocated by vTestDiskInit() and freed by vTestDiskFree(), so
+ * every test starts on a disk full of zeros.  The helpers fail the running
+ * test with a Unity assertion when a call into the library fails.
+ */
+
+#ifndef FF_TEST_DISK_H
+#define FF_TEST_DISK_H
+
+#include "ff_headers.h"
+
+#define testDISK_SECTOR_SIZE       ( 512U )
+#define testDISK_HIDDEN_SECTORS    ( 8U )
+
+/* The disk, its contents, and its size in sectors. */
+extern FF_Disk_t xTestDisk;
+extern uint8_t * pucTestDiskMemory;
+extern uint32_t ulTestDiskSectors;
+
+/* Read calls to the driver, and the number of sectors read by them. */
+extern uint32_t ulTestDiskReadCalls;
+extern uint32_t ulTestDiskSectorsRead;
+
+/* Sectors read and written within the region set by vTestDiskWatch(). */
+extern uint32_t ulTestDiskRegionReads;
+extern uint32_t ulTestDiskRegionWrites;
+
+/* Every read call sleeps this long, in microseconds, to slow down a task
+ * that reads the disk while another task uses it. */
+extern uint32_t ulTestDiskReadDelayUs;
+
+#if defined( TEST_MALLOC_CAN_FAIL ) && ( TEST_MALLOC_CAN_FAIL != 0 )
+    /* ffconfigMALLOC() returns NULL while this is pdTRUE. */
+    extern BaseType_t xTestMallocFails;
+#endif
+
+/* Allocate a disk of 'ulSectorCount' zeroed sectors, clear the counters and
+ * the read delay, and stop watching a region. */
+void vTestDiskInit( uint32_t ulSectorCount );
+
+/* Count the sectors from 'ulFirst' on, 'ulCount' of them, that the driver
+ * reads and writes from now on, and clear the counters. */
+void vTestDiskWatch( uint32_t ulFirst,
+                     uint32_t ulCount );
+
+/* Watch the sectors of all copies of the FAT of the mounted volume. */
+void vTestDiskWatchFAT( const FF_IOManager_t * pxIOManager );
+
+/* Delete the volume, if there is one, and free the disk. */
+void vTestDiskFree( void );
+
+/* The parameters of an I/O manager on the disk, with a cache of
+ * 'ulCacheSectors' sectors and no semaphore. */
+void vTestDiskParameters( FF_CreationParameters_t * pxParameters,
+                          uint32_t ulCacheSectors );
+
+/* Create an I/O manager with 'pxParameters', then partition, format and
+ * mount the disk.  See FF_Format() for 'xPreferFAT16'. */
+FF_IOManager_t * pxTestDiskFormat( const FF_CreationParameters_t * pxParameters,
+                                   BaseType_t xPreferFAT16 );
+
+/* The same with the parameters of vTestDiskParameters(), FAT16 if it fits. */
+FF_IOManager_t * pxTestDiskCreateVolume( uint32_t ulCacheSectors );
+
+/* Unmount the volume and delete its I/O manager.  A semaphore passed in the
+ * creation parameters is left to the caller. */
+void vTestDiskDeleteVolume( void );
+
+/* Create 'ulCount' files in a new directory 'pcDirectory', every tenth one
+ * has some data. */
+void vTestDiskCreateFiles( FF_IOManager_t * pxIOManager,
+                           const char * pcDirectory,
+                           uint32_t ulCount );
+
+/* The two arrays hold the same 'ulCount' directory entries, in that order. */
+void vTestDiskAssertSameEntries( const FF_DirInfo_t * pxExpected,
+                                 const FF_DirInfo_t * pxActual,
+                                 uint32_t ulCount );
+
+#endif /* FF_TEST_DISK_H */
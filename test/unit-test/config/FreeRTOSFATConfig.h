@@ -29,9 +29,15 @@
 #define ffconfigMAX_PARTITIONS    ( 4 )
 
 /* Use the standard C allocator on the host so the I/O manager can be created
- * without a running FreeRTOS heap. */
-#define ffconfigMALLOC( size )    malloc( size )
-#define ffconfigFREE( ptr )       free( ptr )
+ * without a running FreeRTOS heap.  A build with TEST_MALLOC_CAN_FAIL lets a
+ * test make ffconfigMALLOC() return NULL, see common/ff_test_disk.h. */
+#if defined( TEST_MALLOC_CAN_FAIL ) && ( TEST_MALLOC_CAN_FAIL != 0 )
+    void * pvTestMalloc( size_t uxSize );
+    #define ffconfigMALLOC( size )    pvTestMalloc( size )
+#else
+    #define ffconfigMALLOC( size )    malloc( size )
+#endif
+#define ffconfigFREE( ptr )           free( ptr )
 
 /* CMock does not evaluate preprocessor conditionals, so for the dual-prototype
  * helpers (FF_GetFreeSize / FF_GetVolumeSize) it generates the 64-bit variant.
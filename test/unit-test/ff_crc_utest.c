@@ -0,0 +1,262 @@
+/*
+ * Unit tests for the CRC functions in ff_crc.c.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * The test configuration builds ff_crc.c with ffconfigCRC_SLICING_BY_8, so
+ * that buffers of 8 bytes or more go through the slicing-by-8 kernels.  The
+ * results are compared with bit-by-bit implementations of the same CRC's, for
+ * every length up to a few hundred bytes and every alignment.  The reference
+ * implementations themselves are checked against the byte-wise crc32_table.
+ *
+ * The last test is a micro-benchmark: it prints the time taken by the
+ * library functions, and by a byte-wise loop over crc32_table, and only fails
+ * when the results differ.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "unity.h"
+
+#include "ff_headers.h"
+
+/*-----------------------------------------------------------*/
+
+#define TEST_MAX_LENGTH     ( 300U )
+#define TEST_MAX_OFFSET     ( 8U )
+#define TEST_BENCH_ROUNDS   ( 200000U )
+
+static uint8_t ucData[ TEST_MAX_LENGTH + TEST_MAX_OFFSET ];
+
+/*-----------------------------------------------------------*/
+/* Bit-by-bit references.                                     */
+/*-----------------------------------------------------------*/
+
+/* CRC-32 as used by GPT: reflected polynomial 0xEDB88320, inverted. */
+static uint32_t prvReferenceCRC32( const uint8_t * pucData,
+                                   uint32_t ulLength )
+{
+    uint32_t ulCRC = 0xFFFFFFFFU;
+    int iBit;
+
+    while( ulLength-- != 0U )
+    {
+        ulCRC ^= *( pucData++ );
+
+        for( iBit = 0; iBit < 8; iBit++ )
+        {
+            ulCRC = ( ( ulCRC & 1U ) != 0U ) ? ( ( ulCRC >> 1 ) ^ 0xEDB88320U ) : ( ulCRC >> 1 );
+        }
+    }
+
+    return ulCRC ^ 0xFFFFFFFFU;
+}
+
+/* CRC-16/ARC: reflected polynomial 0xA001, starting at 0. */
+static uint16_t prvReferenceCRC16( const uint8_t * pucData,
+                                   uint32_t ulLength )
+{
+    uint16_t usCRC = 0U;
+    int iBit;
+
+    while( ulLength-- != 0U )
+    {
+        usCRC ^= *( pucData++ );
+
+        for( iBit = 0; iBit < 8; iBit++ )
+        {
+            usCRC = ( ( usCRC & 1U ) != 0U ) ? ( uint16_t ) ( ( usCRC >> 1 ) ^ 0xA001U ) : ( uint16_t ) ( usCRC >> 1 );
+        }
+    }
+
+    return usCRC;
+}
+
+/* CRC-8/MAXIM: reflected polynomial 0x8C, starting at 0. */
+static uint8_t prvReferenceCRC8( const uint8_t * pucData,
+                                 uint32_t ulLength )
+{
+    uint8_t ucCRC = 0U;
+    int iBit;
+
+    while( ulLength-- != 0U )
+    {
+        ucCRC ^= *( pucData++ );
+
+        for( iBit = 0; iBit < 8; iBit++ )
+        {
+            ucCRC = ( ( ucCRC & 1U ) != 0U ) ? ( uint8_t ) ( ( ucCRC >> 1 ) ^ 0x8CU ) : ( uint8_t ) ( ucCRC >> 1 );
+        }
+    }
+
+    return ucCRC;
+}
+
+/* The byte-wise table loop that FF_GetCRC32() used before slicing-by-8. */
+static uint32_t prvTableCRC32( const uint8_t * pucData,
+                               uint32_t ulLength )
+{
+    uint32_t ulCRC = 0xFFFFFFFFU;
+
+    while( ulLength-- != 0U )
+    {
+        ulCRC = ( ulCRC >> 8 ) ^ crc32_table[ ( ulCRC ^ *( pucData++ ) ) & 0xFFU ];
+    }
+
+    return ulCRC ^ 0xFFFFFFFFU;
+}
+
+/*-----------------------------------------------------------*/
+
+void setUp( void )
+{
+    uint32_t ulIndex;
+    uint32_t ulSeed = 0x12345678U;
+
+    /* A simple LCG, so that every run sees the same data. */
+    for( ulIndex = 0; ulIndex < sizeof( ucData ); ulIndex++ )
+    {
+        ulSeed = ( ulSeed * 1103515245U ) + 12345U;
+        ucData[ ulIndex ] = ( uint8_t ) ( ulSeed >> 16 );
+    }
+}
+
+void tearDown( void )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+/* The reference agrees with the existing byte-wise table. */
+void test_ReferenceCRC32_MatchesTable( void )
+{
+    uint32_t ulLength;
+
+    for( ulLength = 0; ulLength <= TEST_MAX_LENGTH; ulLength++ )
+    {
+        TEST_ASSERT_EQUAL_HEX32( prvTableCRC32( ucData, ulLength ), prvReferenceCRC32( ucData, ulLength ) );
+    }
+}
+
+/* Well-known check values for the ASCII string "123456789". */
+void test_CRC_CheckValues( void )
+{
+    uint8_t ucCheck[] = "123456789";
+
+    TEST_ASSERT_EQUAL_HEX32( 0xCBF43926U, FF_GetCRC32( ucCheck, 9U ) );
+    TEST_ASSERT_EQUAL_HEX16( 0xBB3DU, FF_GetCRC16( ucCheck, 9U ) );
+    TEST_ASSERT_EQUAL_HEX8( 0xA1U, FF_GetCRC8( ucCheck, 9U ) );
+}
+
+void test_GetCRC32_AllLengthsAndAlignments( void )
+{
+    uint32_t ulOffset, ulLength;
+
+    for( ulOffset = 0; ulOffset < TEST_MAX_OFFSET; ulOffset++ )
+    {
+        for( ulLength = 0; ulLength <= TEST_MAX_LENGTH; ulLength++ )
+        {
+            TEST_ASSERT_EQUAL_HEX32( prvReferenceCRC32( &ucData[ ulOffset ], ulLength ),
+                                     FF_GetCRC32( &ucData[ ulOffset ], ulLength ) );
+        }
+    }
+}
+
+void test_GetCRC16_AllLengthsAndAlignments( void )
+{
+    uint32_t ulOffset, ulLength;
+
+    for( ulOffset = 0; ulOffset < TEST_MAX_OFFSET; ulOffset++ )
+    {
+        for( ulLength = 0; ulLength <= TEST_MAX_LENGTH; ulLength++ )
+        {
+            TEST_ASSERT_EQUAL_HEX16( prvReferenceCRC16( &ucData[ ulOffset ], ulLength ),
+                                     FF_GetCRC16( &ucData[ ulOffset ], ulLength ) );
+        }
+    }
+}
+
+void test_GetCRC8_AllLengthsAndAlignments( void )
+{
+    uint32_t ulOffset, ulLength;
+
+    for( ulOffset = 0; ulOffset < TEST_MAX_OFFSET; ulOffset++ )
+    {
+        for( ulLength = 0; ulLength <= TEST_MAX_LENGTH; ulLength++ )
+        {
+            TEST_ASSERT_EQUAL_HEX8( prvReferenceCRC8( &ucData[ ulOffset ], ulLength ),
+                                    FF_GetCRC8( &ucData[ ulOffset ], ulLength ) );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Short names of 12 bytes are what ffconfigHASH_CACHE hashes, 4 KB stands for
+ * a large block. */
+void test_CRC_Benchmark( void )
+{
+    #if ( TEST_RUN_BENCHMARKS != 0 )
+        uint32_t ulRound;
+        uint32_t ulSum = 0U, ulTableSum = 0U;
+        clock_t xStart;
+        double dNameCRC16, dNameCRC8, dBlockCRC32, dBlockTable;
+        static uint8_t ucBlock[ 4096 ];
+
+        memset( ucBlock, 0x5A, sizeof( ucBlock ) );
+
+        xStart = clock();
+
+        for( ulRound = 0; ulRound < TEST_BENCH_ROUNDS; ulRound++ )
+        {
+            ulSum += FF_GetCRC16( &ucData[ ulRound & 7U ], 12U );
+        }
+
+        dNameCRC16 = ( double ) ( clock() - xStart ) / CLOCKS_PER_SEC;
+
+        xStart = clock();
+
+        for( ulRound = 0; ulRound < TEST_BENCH_ROUNDS; ulRound++ )
+        {
+            ulSum += FF_GetCRC8( &ucData[ ulRound & 7U ], 12U );
+        }
+
+        dNameCRC8 = ( double ) ( clock() - xStart ) / CLOCKS_PER_SEC;
+
+        xStart = clock();
+
+        for( ulRound = 0; ulRound < ( TEST_BENCH_ROUNDS / 256U ); ulRound++ )
+        {
+            ucBlock[ 0 ] = ( uint8_t ) ulRound;
+            ulSum += FF_GetCRC32( ucBlock, sizeof( ucBlock ) );
+        }
+
+        dBlockCRC32 = ( double ) ( clock() - xStart ) / CLOCKS_PER_SEC;
+
+        xStart = clock();
+
+        for( ulRound = 0; ulRound < ( TEST_BENCH_ROUNDS / 256U ); ulRound++ )
+        {
+            ucBlock[ 0 ] = ( uint8_t ) ulRound;
+            ulTableSum += prvTableCRC32( ucBlock, sizeof( ucBlock ) );
+        }
+
+        dBlockTable = ( double ) ( clock() - xStart ) / CLOCKS_PER_SEC;
+
+        printf( "FF_GetCRC16, 12 bytes: %.1f ns\n", ( dNameCRC16 * 1e9 ) / TEST_BENCH_ROUNDS );
+        printf( "FF_GetCRC8, 12 bytes:  %.1f ns\n", ( dNameCRC8 * 1e9 ) / TEST_BENCH_ROUNDS );
+        printf( "FF_GetCRC32, 4 KB:     %.1f us (byte-wise table: %.1f us)\n",
+                ( dBlockCRC32 * 1e6 ) / ( TEST_BENCH_ROUNDS / 256U ),
+                ( dBlockTable * 1e6 ) / ( TEST_BENCH_ROUNDS / 256U ) );
+
+        /* The last rounds of both CRC32 loops must agree. */
+        TEST_ASSERT_EQUAL_HEX32( prvTableCRC32( ucBlock, sizeof( ucBlock ) ), FF_GetCRC32( ucBlock, sizeof( ucBlock ) ) );
+        ( void ) ulSum;
+        ( void ) ulTableSum;
+    #else
+        TEST_IGNORE_MESSAGE( "Configure with -DFAT_UNIT_TEST_BENCHMARKS=ON to run the benchmarks" );
+    #endif
+}
@@ -0,0 +1,484 @@
+/*
+ * Unit tests for FF_FindNextBatch() and the long file name index in ff_dir.c.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * A FAT volume is formatted on an in-memory block device and filled with
+ * files.  The entries returned by FF_FindNextBatch() are compared with the
+ * ones returned by FF_FindFirst() / FF_FindNext(), for several array sizes.
+ *
+ * The directory, FAT, file, format and I/O manager layers run for real, only
+ * the locking layer is a CMock generated mock.
+ *
+ * A benchmark lists a directory of 10,000 files with FF_FindNext() and with
+ * FF_FindNextBatch(), prints the time taken by both, and only fails when the
+ * listings differ.
+ *
+ * The tests of the long file name index only run when the file is built with
+ * ffconfigLFN_INDEX, as ff_dir_lfn_index_utest.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "unity.h"
+
+/* CMock generated mock of the locking layer. */
+#include "mock_ff_locking.h"
+
+#include "ff_headers.h"
+#include "ff_test_disk.h"
+
+/*-----------------------------------------------------------*/
+/* Test parameters.                                           */
+/*-----------------------------------------------------------*/
+
+#define TEST_DISK_SECTORS      ( 16384U ) /* 8 MB. */
+#define TEST_CACHE_SECTORS     ( 16U )
+
+#define TEST_SMALL_COUNT       ( 300U )
+#define TEST_BENCH_COUNT       ( 10000U )
+#define TEST_BENCH_ROUNDS      ( 5U )
+
+/* The listing also holds "." and "..", and one free element lets a full
+ * listing still reach the end of the directory. */
+#define TEST_MAX_ENTRIES       ( TEST_BENCH_COUNT + 3U )
+
+static FF_DirInfo_t xExpected[ TEST_MAX_ENTRIES ];
+static FF_DirInfo_t xFound[ TEST_MAX_ENTRIES ];
+
+/*-----------------------------------------------------------*/
+/* Listing helpers.                                           */
+/*-----------------------------------------------------------*/
+
+static void prvCopyEntry( FF_DirInfo_t * pxInfo,
+                          const FF_DirEnt_t * pxDirEntry )
+{
+    memset( pxInfo, 0, sizeof( *pxInfo ) );
+    pxInfo->ulFileSize = pxDirEntry->ulFileSize;
+    pxInfo->ulObjectCluster = pxDirEntry->ulObjectCluster;
+    pxInfo->ucAttrib = pxDirEntry->ucAttrib;
+    strcpy( pxInfo->pcFileName, pxDirEntry->pcFileName );
+}
+
+/* List a directory with FF_FindFirst() and FF_FindNext(). */
+static uint32_t prvListOneByOne( FF_IOManager_t * pxIOManager,
+                                 const char * pcDirectory,
+                                 FF_DirInfo_t * pxInfo )
+{
+    FF_DirEnt_t xDirEntry;
+    FF_Error_t xError;
+    uint32_t ulCount = 0U;
+
+    memset( &xDirEntry, 0, sizeof( xDirEntry ) );
+
+    for( xError = FF_FindFirst( pxIOManager, &xDirEntry, pcDirectory );
+         FF_isERR( xError ) == pdFALSE;
+         xError = FF_FindNext( pxIOManager, &xDirEntry ) )
+    {
+        TEST_ASSERT_LESS_THAN_UINT32( TEST_MAX_ENTRIES, ulCount );
+        prvCopyEntry( &( pxInfo[ ulCount ] ), &xDirEntry );
+        ulCount++;
+    }
+
+    TEST_ASSERT_EQUAL_INT( FF_ERR_DIR_END_OF_DIR, FF_GETERROR( xError ) );
+
+    return ulCount;
+}
+
+/* List a directory with FF_FindFirst() and FF_FindNextBatch(), asking for
+ * at most 'ulBatchSize' entries per call. */
+static uint32_t prvListInBatches( FF_IOManager_t * pxIOManager,
+                                  const char * pcDirectory,
+                                  FF_DirInfo_t * pxInfo,
+                                  uint32_t ulBatchSize )
+{
+    FF_DirEnt_t xDirEntry;
+    FF_Error_t xError;
+    uint32_t ulCount = 0U;
+    uint32_t ulFound;
+
+    memset( &xDirEntry, 0, sizeof( xDirEntry ) );
+
+    xError = FF_FindFirst( pxIOManager, &xDirEntry, pcDirectory );
+
+    if( FF_isERR( xError ) == pdFALSE )
+    {
+        prvCopyEntry( &( pxInfo[ ulCount ] ), &xDirEntry );
+        ulCount++;
+
+        do
+        {
+            if( ( ulCount + ulBatchSize ) > TEST_MAX_ENTRIES )
+            {
+                ulBatchSize = TEST_MAX_ENTRIES - ulCount;
+            }
+
+            ulFound = 0xFFFFFFFFU;
+            xError = FF_FindNextBatch( pxIOManager, &xDirEntry, &( pxInfo[ ulCount ] ), ulBatchSize, &ulFound );
+            TEST_ASSERT_LESS_OR_EQUAL_UINT32( ulBatchSize, ulFound );
+
+            if( FF_isERR( xError ) == pdFALSE )
+            {
+                /* Only a full array is reported without an error. */
+                TEST_ASSERT_EQUAL_UINT32( ulBatchSize, ulFound );
+            }
+
+            ulCount += ulFound;
+        } while( FF_isERR( xError ) == pdFALSE );
+    }
+
+    TEST_ASSERT_EQUAL_INT( FF_ERR_DIR_END_OF_DIR, FF_GETERROR( xError ) );
+
+    return ulCount;
+}
+
+/*-----------------------------------------------------------*/
+/* Unity fixtures.                                            */
+/*-----------------------------------------------------------*/
+
+void setUp( void )
+{
+    vTestDiskInit( TEST_DISK_SECTORS );
+
+    FF_CreateEvents_IgnoreAndReturn( pdTRUE );
+    FF_DeleteEvents_Ignore();
+    FF_PendSemaphore_Ignore();
+    FF_ReleaseSemaphore_Ignore();
+    FF_BufferWait_IgnoreAndReturn( pdTRUE );
+    FF_BufferProceed_Ignore();
+    FF_Sleep_Ignore();
+    FF_LockDirectory_Ignore();
+    FF_UnlockDirectory_Ignore();
+    FF_LockDirectoryCluster_Ignore();
+    FF_UnlockDirectoryCluster_Ignore();
+    FF_LockFAT_Ignore();
+    FF_UnlockFAT_Ignore();
+    FF_LockFATShared_Ignore();
+    FF_UnlockFATShared_Ignore();
+    FF_Has_Lock_IgnoreAndReturn( pdFALSE );
+    FF_Assert_Lock_Ignore();
+}
+
+void tearDown( void )
+{
+    vTestDiskFree();
+}
+
+/*-----------------------------------------------------------*/
+/* Tests.                                                     */
+/*-----------------------------------------------------------*/
+
+/*
+ * Any array size gives the entries of FF_FindNext(), in the same order, and
+ * FF_ERR_DIR_END_OF_DIR is reported together with the last entries.
+ */
+void test_FindNextBatch_returns_the_entries_of_FindNext( void )
+{
+    FF_IOManager_t * pxIOManager = pxTestDiskCreateVolume( TEST_CACHE_SECTORS );
+    const uint32_t ulBatchSizes[] = { 1U, 7U, 64U, TEST_MAX_ENTRIES };
+    uint32_t ulExpected, ulCount, ulIndex;
+
+    vTestDiskCreateFiles( pxIOManager, "/dir", TEST_SMALL_COUNT );
+
+    ulExpected = prvListOneByOne( pxIOManager, "/dir", xExpected );
+    TEST_ASSERT_EQUAL_UINT32( TEST_SMALL_COUNT + 2U, ulExpected );
+
+    for( ulIndex = 0; ulIndex < ( sizeof( ulBatchSizes ) / sizeof( ulBatchSizes[ 0 ] ) ); ulIndex++ )
+    {
+        memset( xFound, 0, sizeof( xFound ) );
+        ulCount = prvListInBatches( pxIOManager, "/dir", xFound, ulBatchSizes[ ulIndex ] );
+        TEST_ASSERT_EQUAL_UINT32( ulExpected, ulCount );
+        vTestDiskAssertSameEntries( xExpected, xFound, ulCount );
+    }
+}
+
+/*
+ * The arguments are checked, and an empty array reads nothing.
+ */
+void test_FindNextBatch_checks_its_arguments( void )
+{
+    FF_IOManager_t * pxIOManager = pxTestDiskCreateVolume( TEST_CACHE_SECTORS );
+    FF_DirEnt_t xDirEntry;
+    FF_Error_t xError;
+    uint32_t ulFound = 0xFFFFFFFFU;
+
+    vTestDiskCreateFiles( pxIOManager, "/dir", 3U );
+
+    memset( &xDirEntry, 0, sizeof( xDirEntry ) );
+    xError = FF_FindFirst( pxIOManager, &xDirEntry, "/dir" );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    xError = FF_FindNextBatch( NULL, &xDirEntry, xFound, 1U, &ulFound );
+    TEST_ASSERT_EQUAL_INT( FF_ERR_NULL_POINTER, FF_GETERROR( xError ) );
+    xError = FF_FindNextBatch( pxIOManager, &xDirEntry, NULL, 1U, &ulFound );
+    TEST_ASSERT_EQUAL_INT( FF_ERR_NULL_POINTER, FF_GETERROR( xError ) );
+    xError = FF_FindNextBatch( pxIOManager, &xDirEntry, xFound, 1U, NULL );
+    TEST_ASSERT_EQUAL_INT( FF_ERR_NULL_POINTER, FF_GETERROR( xError ) );
+
+    xError = FF_FindNextBatch( pxIOManager, &xDirEntry, xFound, 0U, &ulFound );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    TEST_ASSERT_EQUAL_UINT32( 0U, ulFound );
+
+    /* The position was not changed, ".." and the 3 files follow. */
+    xError = FF_FindNextBatch( pxIOManager, &xDirEntry, xFound, 8U, &ulFound );
+    TEST_ASSERT_EQUAL_INT( FF_ERR_DIR_END_OF_DIR, FF_GETERROR( xError ) );
+    TEST_ASSERT_EQUAL_UINT32( 4U, ulFound );
+    TEST_ASSERT_EQUAL_UINT32( 5U, prvListOneByOne( pxIOManager, "/dir", xExpected ) );
+    vTestDiskAssertSameEntries( &( xExpected[ 1 ] ), xFound, ulFound );
+}
+
+/*
+ * List a directory of 10,000 files one entry at a time, and in arrays of 64
+ * entries.  The best time of a few rounds is printed.
+ */
+void test_FindNextBatch_Benchmark( void )
+{
+    #if ( TEST_RUN_BENCHMARKS != 0 )
+        FF_IOManager_t * pxIOManager = pxTestDiskCreateVolume( TEST_CACHE_SECTORS );
+        uint32_t ulRound, ulExpected = 0U, ulCount = 0U;
+        clock_t xStart;
+        double dOneByOne = 1e9, dBatch = 1e9, dTime;
+
+        vTestDiskCreateFiles( pxIOManager, "/big", TEST_BENCH_COUNT );
+
+        for( ulRound = 0; ulRound < TEST_BENCH_ROUNDS; ulRound++ )
+        {
+            xStart = clock();
+            ulExpected = prvListOneByOne( pxIOManager, "/big", xExpected );
+            dTime = ( double ) ( clock() - xStart ) / CLOCKS_PER_SEC;
+
+            if( dTime < dOneByOne )
+            {
+                dOneByOne = dTime;
+            }
+
+            xStart = clock();
+            ulCount = prvListInBatches( pxIOManager, "/big", xFound, 64U );
+            dTime = ( double ) ( clock() - xStart ) / CLOCKS_PER_SEC;
+
+            if( dTime < dBatch )
+            {
+                dBatch = dTime;
+            }
+        }
+
+        printf( "Listing %u entries: FF_FindNext %.2f ms, FF_FindNextBatch (64) %.2f ms\n",
+                ( unsigned ) ulExpected, dOneByOne * 1e3, dBatch * 1e3 );
+
+        TEST_ASSERT_EQUAL_UINT32( TEST_BENCH_COUNT + 2U, ulExpected );
+        TEST_ASSERT_EQUAL_UINT32( ulExpected, ulCount );
+        vTestDiskAssertSameEntries( xExpected, xFound, ulCount );
+    #else
+        TEST_IGNORE_MESSAGE( "Configure with -DFAT_UNIT_TEST_BENCHMARKS=ON to run the benchmarks" );
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+/* Long file name index, see ffconfigLFN_INDEX.              */
+/*-----------------------------------------------------------*/
+
+#if ( ffconfigLFN_INDEX != 0 )
+
+/* Create 'ulCount' files with long names in 'pcDirectory', each file holds
+ * its own name.  Then drop the index, so that the next look-up builds it. */
+    static void prvCreateLongNames( FF_IOManager_t * pxIOManager,
+                                    const char * pcDirectory,
+                                    uint32_t ulCount )
+    {
+        char pcName[ 64 ];
+        FF_FILE * pxFile;
+        FF_Error_t xError;
+        uint32_t ulIndex;
+
+        xError = FF_MkDir( pxIOManager, pcDirectory );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+        for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+        {
+            snprintf( pcName, sizeof( pcName ), "%s/Long file name %04u.txt", pcDirectory, ( unsigned ) ulIndex );
+            pxFile = FF_Open( pxIOManager, pcName, FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+            TEST_ASSERT_NOT_NULL( pxFile );
+            TEST_ASSERT_EQUAL_INT32( ( int32_t ) strlen( pcName ),
+                                     FF_Write( pxFile, 1, strlen( pcName ), ( uint8_t * ) pcName ) );
+            xError = FF_Close( pxFile );
+            TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        }
+
+        FF_LFNIndexFlush( pxIOManager );
+    }
+
+/* Open 'pcPath' for reading.  Returns pdFALSE when it does not exist, and
+ * checks that the file holds 'pcContents' when it does. */
+    static BaseType_t prvFileExists( FF_IOManager_t * pxIOManager,
+                                     const char * pcPath,
+                                     const char * pcContents )
+    {
+        char pcRead[ 64 ];
+        FF_FILE * pxFile;
+        FF_Error_t xError = FF_ERR_NONE;
+        size_t uxLength = strlen( pcContents );
+
+        pxFile = FF_Open( pxIOManager, pcPath, FF_MODE_READ, &xError );
+
+        if( pxFile == NULL )
+        {
+            TEST_ASSERT_EQUAL_INT( FF_ERR_FILE_NOT_FOUND, FF_GETERROR( xError ) );
+            return pdFALSE;
+        }
+
+        memset( pcRead, 0, sizeof( pcRead ) );
+        TEST_ASSERT_EQUAL_INT32( ( int32_t ) uxLength, FF_Read( pxFile, 1, sizeof( pcRead ) - 1U, ( uint8_t * ) pcRead ) );
+        TEST_ASSERT_EQUAL_STRING( pcContents, pcRead );
+        xError = FF_Close( pxFile );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+        return pdTRUE;
+    }
+
+/* Returns the index slot of a directory, or NULL when it is not indexed. */
+    static FF_LFNIndex_t * prvIndexOf( FF_IOManager_t * pxIOManager,
+                                       const char * pcDirectory )
+    {
+        FF_Error_t xError = FF_ERR_NONE;
+        uint32_t ulCluster;
+        BaseType_t xSlot;
+
+        ulCluster = FF_FindDir( pxIOManager, pcDirectory, ( uint16_t ) strlen( pcDirectory ), &xError );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        TEST_ASSERT_NOT_EQUAL( 0U, ulCluster );
+
+        for( xSlot = 0; xSlot < ffconfigLFN_INDEX_DEPTH; xSlot++ )
+        {
+            if( pxIOManager->xLFNIndex[ xSlot ].ulDirCluster == ulCluster )
+            {
+                return &( pxIOManager->xLFNIndex[ xSlot ] );
+            }
+        }
+
+        return NULL;
+    }
+
+#endif /* ffconfigLFN_INDEX */
+
+/*
+ * ff_dir_lfn_index_utest: the first look-up in a directory builds its index,
+ * which holds every name.  Later look-ups, in any case, use the index and
+ * find the right file.  A name that is not in the directory is reported as
+ * missing without building the index again.
+ */
+void test_LFNIndex_finds_names_and_reports_missing_ones( void )
+{
+    #if ( ffconfigLFN_INDEX != 0 )
+        FF_IOManager_t * pxIOManager = pxTestDiskCreateVolume( TEST_CACHE_SECTORS );
+        FF_LFNIndex_t * pxIndex;
+        uint32_t ulChanges, ulLastUsed;
+
+        prvCreateLongNames( pxIOManager, "/lfn", 20U );
+        TEST_ASSERT_NULL( prvIndexOf( pxIOManager, "/lfn" ) );
+
+        TEST_ASSERT_TRUE( prvFileExists( pxIOManager, "/lfn/Long file name 0007.txt", "/lfn/Long file name 0007.txt" ) );
+        pxIndex = prvIndexOf( pxIOManager, "/lfn" );
+        TEST_ASSERT_NOT_NULL( pxIndex );
+        TEST_ASSERT_NOT_NULL( pxIndex->pxEntries );
+        TEST_ASSERT_EQUAL_UINT16( 22U, pxIndex->usCount ); /* Also "." and "..". */
+
+        ulChanges = pxIOManager->ulLFNIndexChanges;
+        ulLastUsed = pxIndex->ulLastUsed;
+        TEST_ASSERT_TRUE( prvFileExists( pxIOManager, "/lfn/LONG FILE NAME 0019.TXT", "/lfn/Long file name 0019.txt" ) );
+        TEST_ASSERT_GREATER_THAN_UINT32( ulLastUsed, pxIndex->ulLastUsed );
+        TEST_ASSERT_TRUE( prvFileExists( pxIOManager, "/lfn/long file name 0000.txt", "/lfn/Long file name 0000.txt" ) );
+        TEST_ASSERT_FALSE( prvFileExists( pxIOManager, "/lfn/Long file name 0020.txt", "" ) );
+        TEST_ASSERT_FALSE( prvFileExists( pxIOManager, "/lfn/Long file name", "" ) );
+        TEST_ASSERT_EQUAL_UINT32( ulChanges, pxIOManager->ulLFNIndexChanges );
+        TEST_ASSERT_EQUAL_PTR( pxIndex, prvIndexOf( pxIOManager, "/lfn" ) );
+        TEST_ASSERT_EQUAL_UINT16( 22U, pxIndex->usCount );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigLFN_INDEX" );
+    #endif
+}
+
+/*
+ * ff_dir_lfn_index_utest: creating, renaming and deleting a file updates the
+ * index of its directory, so that look-ups give the same answers as a scan
+ * would.
+ */
+void test_LFNIndex_follows_create_rename_and_delete( void )
+{
+    #if ( ffconfigLFN_INDEX != 0 )
+        FF_IOManager_t * pxIOManager = pxTestDiskCreateVolume( TEST_CACHE_SECTORS );
+        FF_LFNIndex_t * pxIndex;
+        FF_FILE * pxFile;
+        FF_Error_t xError;
+
+        prvCreateLongNames( pxIOManager, "/lfn", 20U );
+        TEST_ASSERT_TRUE( prvFileExists( pxIOManager, "/lfn/Long file name 0001.txt", "/lfn/Long file name 0001.txt" ) );
+        pxIndex = prvIndexOf( pxIOManager, "/lfn" );
+        TEST_ASSERT_NOT_NULL( pxIndex );
+        TEST_ASSERT_EQUAL_UINT16( 22U, pxIndex->usCount );
+
+        /* Create. */
+        TEST_ASSERT_FALSE( prvFileExists( pxIOManager, "/lfn/A file created later.txt", "" ) );
+        pxFile = FF_Open( pxIOManager, "/lfn/A file created later.txt", FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+        TEST_ASSERT_NOT_NULL( pxFile );
+        TEST_ASSERT_EQUAL_INT32( 5, FF_Write( pxFile, 1, 5, ( uint8_t * ) "later" ) );
+        TEST_ASSERT_FALSE( FF_isERR( FF_Close( pxFile ) ) );
+        TEST_ASSERT_EQUAL_PTR( pxIndex, prvIndexOf( pxIOManager, "/lfn" ) );
+        TEST_ASSERT_EQUAL_UINT16( 23U, pxIndex->usCount );
+        TEST_ASSERT_TRUE( prvFileExists( pxIOManager, "/lfn/A FILE CREATED LATER.TXT", "later" ) );
+
+        /* Rename. */
+        xError = FF_Move( pxIOManager, "/lfn/Long file name 0003.txt", "/lfn/Renamed with a long name.txt", pdFALSE );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        TEST_ASSERT_EQUAL_PTR( pxIndex, prvIndexOf( pxIOManager, "/lfn" ) );
+        TEST_ASSERT_EQUAL_UINT16( 23U, pxIndex->usCount );
+        TEST_ASSERT_FALSE( prvFileExists( pxIOManager, "/lfn/Long file name 0003.txt", "" ) );
+        TEST_ASSERT_TRUE( prvFileExists( pxIOManager, "/lfn/Renamed with a long name.txt", "/lfn/Long file name 0003.txt" ) );
+
+        /* Delete. */
+        xError = FF_RmFile( pxIOManager, "/lfn/Long file name 0005.txt" );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        TEST_ASSERT_EQUAL_PTR( pxIndex, prvIndexOf( pxIOManager, "/lfn" ) );
+        TEST_ASSERT_EQUAL_UINT16( 22U, pxIndex->usCount );
+        TEST_ASSERT_FALSE( prvFileExists( pxIOManager, "/lfn/Long file name 0005.txt", "" ) );
+
+        /* The names around the changes are still found. */
+        TEST_ASSERT_TRUE( prvFileExists( pxIOManager, "/lfn/Long file name 0004.txt", "/lfn/Long file name 0004.txt" ) );
+        TEST_ASSERT_TRUE( prvFileExists( pxIOManager, "/lfn/Long file name 0006.txt", "/lfn/Long file name 0006.txt" ) );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigLFN_INDEX" );
+    #endif
+}
+
+/*
+ * ff_dir_lfn_index_utest: a directory with more than
+ * ffconfigLFN_INDEX_MAX_ENTRIES names gets an empty index, and is scanned
+ * for every look-up.  The answers are still right.
+ */
+void test_LFNIndex_scans_a_directory_with_too_many_names( void )
+{
+    #if ( ffconfigLFN_INDEX != 0 )
+        FF_IOManager_t * pxIOManager = pxTestDiskCreateVolume( TEST_CACHE_SECTORS );
+        FF_LFNIndex_t * pxIndex;
+        char pcName[ 64 ];
+        uint32_t ulLast = ffconfigLFN_INDEX_MAX_ENTRIES + 10U;
+
+        prvCreateLongNames( pxIOManager, "/many", ulLast + 1U );
+
+        snprintf( pcName, sizeof( pcName ), "/many/Long file name %04u.txt", ( unsigned ) ulLast );
+        TEST_ASSERT_TRUE( prvFileExists( pxIOManager, pcName, pcName ) );
+        pxIndex = prvIndexOf( pxIOManager, "/many" );
+        TEST_ASSERT_NOT_NULL( pxIndex );
+        TEST_ASSERT_NULL( pxIndex->pxEntries );
+        TEST_ASSERT_EQUAL_UINT16( 0U, pxIndex->usCount );
+
+        TEST_ASSERT_TRUE( prvFileExists( pxIOManager, "/many/LONG FILE NAME 0000.TXT", "/many/Long file name 0000.txt" ) );
+        TEST_ASSERT_FALSE( prvFileExists( pxIOManager, "/many/Not in the directory.txt", "" ) );
+        TEST_ASSERT_NULL( pxIndex->pxEntries );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigLFN_INDEX" );
+    #endif
+}
+/*-----------------------------------------------------------*/
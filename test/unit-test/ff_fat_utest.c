@@ -0,0 +1,360 @@
+/*
+ * Unit tests for freeing cluster chains, see FF_UnlinkClusterChain() in
+ * ff_fat.c, and for the free-cluster bitmap that is kept with
+ * ffconfigFREE_CLUSTER_BITMAP.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * A FAT32 volume is formatted on an in-memory block device with one sector
+ * per cluster.  Files are deleted with FF_RmFile(), and the number of free
+ * clusters that the I/O manager keeps is compared with the number that
+ * FF_CountFreeClusters() finds in the FAT.
+ *
+ * The directory, FAT, file, format and I/O manager layers run for real, only
+ * the locking layer is a CMock generated mock.
+ *
+ * The last test is a benchmark: it prints the time that deleting a large
+ * contiguous file and a fragmented file takes, and only fails when the free
+ * cluster counts differ.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "unity.h"
+
+/* CMock generated mock of the locking layer. */
+#include "mock_ff_locking.h"
+
+#include "ff_headers.h"
+#include "ff_test_disk.h"
+
+/*-----------------------------------------------------------*/
+/* Test parameters.                                           */
+/*-----------------------------------------------------------*/
+
+#define TEST_DISK_SECTORS       ( 131072U ) /* 64 MB, enough for FAT32 with 1 sector per cluster. */
+#define TEST_CACHE_SECTORS      ( 64U )
+
+#define TEST_CONTIGUOUS_SIZE    ( 48U * 1024U * 1024U )
+#define TEST_FRAGMENTS          ( 4000U ) /* Clusters in each of the two fragmented files. */
+#define TEST_BENCH_ROUNDS       ( 3U )
+
+/*-----------------------------------------------------------*/
+/* Helpers.                                                   */
+/*-----------------------------------------------------------*/
+
+/* Partition, format and mount the RAM disk as FAT32. */
+static FF_IOManager_t * prvCreateVolume( void )
+{
+    FF_CreationParameters_t xParameters;
+    FF_IOManager_t * pxIOManager;
+
+    vTestDiskParameters( &xParameters, TEST_CACHE_SECTORS );
+    pxIOManager = pxTestDiskFormat( &xParameters, pdFALSE );
+    TEST_ASSERT_EQUAL_UINT8( FF_T_FAT32, pxIOManager->xPartition.ucType );
+    TEST_ASSERT_EQUAL_UINT32( 1U, pxIOManager->xPartition.ulSectorsPerCluster );
+
+    return pxIOManager;
+}
+
+/* The free cluster count of the I/O manager must be the one in the FAT. */
+static void prvAssertFreeCount( FF_IOManager_t * pxIOManager,
+                                uint32_t ulExpected )
+{
+    FF_Error_t xError = FF_ERR_NONE;
+
+    TEST_ASSERT_FALSE( FF_isERR( FF_FlushCache( pxIOManager ) ) );
+    TEST_ASSERT_EQUAL_UINT32( ulExpected, FF_CountFreeClusters( pxIOManager, &xError ) );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    TEST_ASSERT_EQUAL_UINT32( ulExpected, pxIOManager->xPartition.ulFreeClusterCount );
+}
+
+/* Create 'pcName' with one contiguous chain of 'ulSize' bytes. */
+static void prvCreateContiguous( FF_IOManager_t * pxIOManager,
+                                 const char * pcName,
+                                 uint32_t ulSize )
+{
+    FF_FILE * pxFile;
+    FF_Error_t xError;
+
+    pxFile = FF_Open( pxIOManager, pcName, FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+    xError = FF_Preallocate( pxFile, ulSize, pdFALSE );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+}
+
+/* Create two files of 'ulClusters' clusters each, written one cluster at a
+ * time in turn, so that their chains jump at every cluster. */
+static void prvCreateFragmented( FF_IOManager_t * pxIOManager,
+                                 const char * pcName1,
+                                 const char * pcName2,
+                                 uint32_t ulClusters )
+{
+    uint8_t ucCluster[ testDISK_SECTOR_SIZE ];
+    FF_FILE * pxFiles[ 2 ];
+    FF_Error_t xError;
+    uint32_t ulIndex;
+
+    memset( ucCluster, 0xA5, sizeof( ucCluster ) );
+    pxFiles[ 0 ] = FF_Open( pxIOManager, pcName1, FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+    TEST_ASSERT_NOT_NULL( pxFiles[ 0 ] );
+    pxFiles[ 1 ] = FF_Open( pxIOManager, pcName2, FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+    TEST_ASSERT_NOT_NULL( pxFiles[ 1 ] );
+
+    for( ulIndex = 0U; ulIndex < ( 2U * ulClusters ); ulIndex++ )
+    {
+        TEST_ASSERT_EQUAL_INT32( sizeof( ucCluster ), FF_Write( pxFiles[ ulIndex % 2U ], 1, sizeof( ucCluster ), ucCluster ) );
+    }
+
+    TEST_ASSERT_FALSE( FF_isERR( FF_Close( pxFiles[ 0 ] ) ) );
+    TEST_ASSERT_FALSE( FF_isERR( FF_Close( pxFiles[ 1 ] ) ) );
+}
+
+#if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+
+/* The free-cluster bitmap must exist, and have a bit set for every cluster
+ * that is free in the FAT, and for no other cluster. */
+    static void prvAssertBitmap( FF_IOManager_t * pxIOManager )
+    {
+        const uint32_t * pulFreeBitmap = pxIOManager->xPartition.pulFreeBitmap;
+        FF_Error_t xError = FF_ERR_NONE;
+        uint32_t ulCluster, ulEntry;
+
+        TEST_ASSERT_NOT_NULL( pulFreeBitmap );
+        TEST_ASSERT_EQUAL_HEX32( 0U, pulFreeBitmap[ 0 ] & 0x03U );
+
+        for( ulCluster = 2U; ulCluster < pxIOManager->xPartition.ulNumClusters; ulCluster++ )
+        {
+            ulEntry = FF_getFATEntry( pxIOManager, ulCluster, &xError, NULL );
+            TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+            if( ( ( pulFreeBitmap[ ulCluster / 32U ] >> ( ulCluster % 32U ) ) & 1U ) != ( ulEntry == 0U ) )
+            {
+                TEST_FAIL_MESSAGE( "The bitmap does not agree with the FAT" );
+            }
+        }
+    }
+
+/* Write 'ulSize' bytes to a new file 'pcName'. */
+    static void prvCreateFile( FF_IOManager_t * pxIOManager,
+                               const char * pcName,
+                               uint32_t ulSize )
+    {
+        uint8_t ucSector[ testDISK_SECTOR_SIZE ];
+        FF_FILE * pxFile;
+        FF_Error_t xError;
+        uint32_t ulDone;
+
+        memset( ucSector, 0x5A, sizeof( ucSector ) );
+        pxFile = FF_Open( pxIOManager, pcName, FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+        TEST_ASSERT_NOT_NULL( pxFile );
+
+        for( ulDone = 0U; ulDone < ulSize; ulDone += sizeof( ucSector ) )
+        {
+            TEST_ASSERT_EQUAL_INT32( sizeof( ucSector ), FF_Write( pxFile, 1, sizeof( ucSector ), ucSector ) );
+        }
+
+        TEST_ASSERT_FALSE( FF_isERR( FF_Close( pxFile ) ) );
+    }
+#endif /* ffconfigFREE_CLUSTER_BITMAP */
+
+/* Delete 'pcName' and return the time it took in seconds. */
+static double prvTimeDelete( FF_IOManager_t * pxIOManager,
+                             const char * pcName )
+{
+    FF_Error_t xError;
+    clock_t xStart;
+
+    xStart = clock();
+    xError = FF_RmFile( pxIOManager, pcName );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    return ( double ) ( clock() - xStart ) / CLOCKS_PER_SEC;
+}
+
+/*-----------------------------------------------------------*/
+/* Unity fixtures.                                            */
+/*-----------------------------------------------------------*/
+
+void setUp( void )
+{
+    vTestDiskInit( TEST_DISK_SECTORS );
+
+    FF_CreateEvents_IgnoreAndReturn( pdTRUE );
+    FF_DeleteEvents_Ignore();
+    FF_PendSemaphore_Ignore();
+    FF_ReleaseSemaphore_Ignore();
+    FF_BufferWait_IgnoreAndReturn( pdTRUE );
+    FF_BufferProceed_Ignore();
+    FF_Sleep_Ignore();
+    FF_LockDirectory_Ignore();
+    FF_UnlockDirectory_Ignore();
+    FF_LockDirectoryCluster_Ignore();
+    FF_UnlockDirectoryCluster_Ignore();
+    FF_LockFAT_Ignore();
+    FF_UnlockFAT_Ignore();
+    FF_LockFATShared_Ignore();
+    FF_UnlockFATShared_Ignore();
+    FF_Has_Lock_IgnoreAndReturn( pdFALSE );
+    FF_Assert_Lock_Ignore();
+}
+
+void tearDown( void )
+{
+    vTestDiskFree();
+}
+
+/*-----------------------------------------------------------*/
+/* Tests.                                                     */
+/*-----------------------------------------------------------*/
+
+/*
+ * Deleting a contiguous file, and files whose chains jump at every cluster,
+ * gives back every cluster, in the FAT and in the free cluster count.  The
+ * file that is not deleted keeps its data.
+ */
+void test_RmFile_frees_every_cluster( void )
+{
+    FF_IOManager_t * pxIOManager = prvCreateVolume();
+    uint8_t ucRead[ testDISK_SECTOR_SIZE ];
+    FF_FILE * pxFile;
+    FF_Error_t xError = FF_ERR_NONE;
+    uint32_t ulFree, ulIndex;
+
+    ulFree = FF_CountFreeClusters( pxIOManager, &xError );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    prvCreateContiguous( pxIOManager, "/big.bin", 1000U * testDISK_SECTOR_SIZE );
+    prvAssertFreeCount( pxIOManager, ulFree - 1000U );
+    ( void ) prvTimeDelete( pxIOManager, "/big.bin" );
+    prvAssertFreeCount( pxIOManager, ulFree );
+
+    prvCreateFragmented( pxIOManager, "/odd.bin", "/even.bin", 300U );
+    prvAssertFreeCount( pxIOManager, ulFree - 600U );
+    ( void ) prvTimeDelete( pxIOManager, "/odd.bin" );
+    prvAssertFreeCount( pxIOManager, ulFree - 300U );
+
+    pxFile = FF_Open( pxIOManager, "/even.bin", FF_MODE_READ, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+
+    for( ulIndex = 0U; ulIndex < 300U; ulIndex++ )
+    {
+        memset( ucRead, 0, sizeof( ucRead ) );
+        TEST_ASSERT_EQUAL_INT32( sizeof( ucRead ), FF_Read( pxFile, 1, sizeof( ucRead ), ucRead ) );
+        TEST_ASSERT_EACH_EQUAL_UINT8( 0xA5, ucRead, sizeof( ucRead ) );
+    }
+
+    TEST_ASSERT_FALSE( FF_isERR( FF_Close( pxFile ) ) );
+
+    ( void ) prvTimeDelete( pxIOManager, "/even.bin" );
+    prvAssertFreeCount( pxIOManager, ulFree );
+}
+
+/*
+ * The free-cluster bitmap is built the first time that a free cluster is
+ * needed, and must agree with the FAT after clusters are allocated one by one
+ * and in runs, after chains are freed one cluster at a time and in runs by
+ * prvUnlinkClusterRun(), and after the volume is mounted again or formatted.
+ */
+void test_FreeBitmap_agrees_with_the_FAT( void )
+{
+    #if ( ffconfigFREE_CLUSTER_BITMAP != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        FF_Error_t xError = FF_ERR_NONE;
+        uint32_t ulFree;
+
+        ulFree = FF_CountFreeClusters( pxIOManager, &xError );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+        /* Runs of clusters, and clusters allocated one by one. */
+        prvCreateContiguous( pxIOManager, "/big.bin", 1000U * testDISK_SECTOR_SIZE );
+        prvAssertBitmap( pxIOManager );
+        prvCreateFragmented( pxIOManager, "/odd.bin", "/even.bin", 300U );
+        prvCreateFile( pxIOManager, "/small.bin", 5U * testDISK_SECTOR_SIZE );
+        prvAssertBitmap( pxIOManager );
+
+        /* A chain that jumps at every cluster, and one long run. */
+        ( void ) prvTimeDelete( pxIOManager, "/odd.bin" );
+        prvAssertBitmap( pxIOManager );
+        ( void ) prvTimeDelete( pxIOManager, "/big.bin" );
+        prvAssertBitmap( pxIOManager );
+        prvAssertFreeCount( pxIOManager, ulFree - 305U );
+
+        /* The holes that were left are used again. */
+        prvCreateFile( pxIOManager, "/again.bin", 400U * testDISK_SECTOR_SIZE );
+        prvAssertBitmap( pxIOManager );
+
+        /* Mounting again releases the bitmap, it is built from the FAT on disk. */
+        TEST_ASSERT_FALSE( FF_isERR( FF_Unmount( &xTestDisk ) ) );
+        TEST_ASSERT_NULL( pxIOManager->xPartition.pulFreeBitmap );
+        TEST_ASSERT_FALSE( FF_isERR( FF_Mount( &xTestDisk, 0 ) ) );
+        prvCreateFile( pxIOManager, "/mounted.bin", 3U * testDISK_SECTOR_SIZE );
+        prvAssertBitmap( pxIOManager );
+        ( void ) prvTimeDelete( pxIOManager, "/even.bin" );
+        prvAssertBitmap( pxIOManager );
+
+        /* After a format, all clusters but the root directory are free again. */
+        TEST_ASSERT_FALSE( FF_isERR( FF_Unmount( &xTestDisk ) ) );
+        TEST_ASSERT_FALSE( FF_isERR( FF_Format( &xTestDisk, 0, pdFALSE, pdTRUE ) ) );
+        TEST_ASSERT_FALSE( FF_isERR( FF_Mount( &xTestDisk, 0 ) ) );
+        prvCreateFile( pxIOManager, "/new.bin", 2U * testDISK_SECTOR_SIZE );
+        prvAssertBitmap( pxIOManager );
+        prvAssertFreeCount( pxIOManager, ulFree - 2U );
+    #else /* if ( ffconfigFREE_CLUSTER_BITMAP != 0 ) */
+        TEST_IGNORE_MESSAGE( "Needs ffconfigFREE_CLUSTER_BITMAP" );
+    #endif /* if ( ffconfigFREE_CLUSTER_BITMAP != 0 ) */
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Delete a contiguous file of 48 MB, and a file of 4000 clusters whose chain
+ * jumps at every cluster, and print the best time of a few rounds.
+ */
+void test_RmFile_Benchmark( void )
+{
+    #if ( TEST_RUN_BENCHMARKS != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        FF_Error_t xError = FF_ERR_NONE;
+        double dContiguous = 1e9, dFragmented = 1e9, dTime;
+        uint32_t ulFree, ulRound;
+
+        ulFree = FF_CountFreeClusters( pxIOManager, &xError );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+        for( ulRound = 0U; ulRound < TEST_BENCH_ROUNDS; ulRound++ )
+        {
+            prvCreateContiguous( pxIOManager, "/big.bin", TEST_CONTIGUOUS_SIZE );
+            dTime = prvTimeDelete( pxIOManager, "/big.bin" );
+            prvAssertFreeCount( pxIOManager, ulFree );
+
+            if( dTime < dContiguous )
+            {
+                dContiguous = dTime;
+            }
+
+            prvCreateFragmented( pxIOManager, "/odd.bin", "/even.bin", TEST_FRAGMENTS );
+            dTime = prvTimeDelete( pxIOManager, "/odd.bin" );
+            prvAssertFreeCount( pxIOManager, ulFree - TEST_FRAGMENTS );
+
+            if( dTime < dFragmented )
+            {
+                dFragmented = dTime;
+            }
+
+            ( void ) prvTimeDelete( pxIOManager, "/even.bin" );
+            prvAssertFreeCount( pxIOManager, ulFree );
+        }
+
+        printf( "Deleting %u contiguous clusters: %.2f ms, %u fragmented clusters: %.2f ms\n",
+                ( unsigned ) ( TEST_CONTIGUOUS_SIZE / testDISK_SECTOR_SIZE ), dContiguous * 1e3,
+                ( unsigned ) TEST_FRAGMENTS, dFragmented * 1e3 );
+    #else
+        TEST_IGNORE_MESSAGE( "Configure with -DFAT_UNIT_TEST_BENCHMARKS=ON to run the benchmarks" );
+    #endif
+}
+/*-----------------------------------------------------------*/
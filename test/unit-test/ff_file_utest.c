@@ -0,0 +1,1619 @@
+/*
+ * Unit tests for reading files in small pieces, see FF_Read() in ff_file.c
+ * and FF_ReadAhead() in ff_ioman.c, for direct I/O, for random reads through
+ * the extent map, and for appending with delayed allocation.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * A FAT volume is formatted on an in-memory block device.  A file is written
+ * and read back in pieces that are much smaller than a sector, and the data
+ * is compared.  The driver counts its calls, so that a test can see whether
+ * the sectors were read ahead.
+ *
+ * The test is built with the test configuration, as ff_file_readahead_utest
+ * with ffconfigREAD_AHEAD_SECTORS and ffconfigASYNC_BLOCK_DEVICE, as
+ * ff_file_delayed_utest with ffconfigDELAYED_ALLOCATION, as
+ * ff_file_extent_utest with ffconfigFILE_EXTENT_MAP, and as
+ * ff_file_direct_utest with ffconfigDIRECT_IO.  The read-ahead
+ * build has a driver with fnSubmitBlocks(), which completes a transfer when
+ * the library waits for it, and a few fake kernel functions for
+ * FF_BlockSubmit() / FF_BlockWait().  It also runs the RAM disk of
+ * portable/common/ff_ramdisk.c, whose worker task gets no thread: it handles
+ * its queue when the library waits.
+ *
+ * The directory, FAT, file, format and I/O manager layers run for real, only
+ * the locking layer is a CMock generated mock.
+ *
+ * The last test is a benchmark: it prints the throughput of 64-byte reads,
+ * and only fails when the data differs.
+ */
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "unity.h"
+
+/* CMock generated mock of the locking layer. */
+#include "mock_ff_locking.h"
+
+#include "ff_headers.h"
+#include "ff_test_disk.h"
+
+#if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+    #include "queue.h"
+    #include "ff_ramdisk.h"
+    #include "ff_sys.h"
+#endif
+
+/*-----------------------------------------------------------*/
+/* Test parameters.                                           */
+/*-----------------------------------------------------------*/
+
+#define TEST_DISK_SECTORS      ( 16384U ) /* 8 MB. */
+#define TEST_CACHE_SECTORS     ( 64U )
+
+#define TEST_FILE_SIZE         ( 256U * 1024U )
+#define TEST_PIECE_SIZE        ( 37U )
+
+#define TEST_BENCH_SIZE        ( 1024U * 1024U )
+#define TEST_BENCH_PIECE       ( 64U )
+#define TEST_BENCH_ROUNDS      ( 5U )
+
+/* The number of transfers that the fake driver can have in flight. */
+#define TEST_MAX_PENDING       ( 4U )
+
+/* The size of the disks created with FF_RAMDiskInit(). */
+#define TEST_RAM_DISK_SECTORS  ( 16384U ) /* 8 MB. */
+
+static uint8_t ucWritten[ TEST_BENCH_SIZE ];
+/* The last read of a file finds nothing, but still needs space. */
+static uint8_t ucRead[ TEST_BENCH_SIZE + TEST_BENCH_PIECE ];
+
+#if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+
+/*-----------------------------------------------------------*/
+/* Asynchronous driver and kernel fakes.                      */
+/*-----------------------------------------------------------*/
+
+/* Submitted transfers are kept here until the library waits for them, so
+ * FF_Read() returns while they are still in flight. */
+    static FF_BlockRequest_t * pxPending[ TEST_MAX_PENDING ];
+    static uint32_t ulSubmits;
+    static BaseType_t xSchedulerState = taskSCHEDULER_RUNNING;
+
+    static int32_t prvSubmitBlocks( FF_BlockRequest_t * pxRequest,
+                                    FF_Disk_t * pxDisk )
+    {
+        uint32_t ulIndex;
+
+        ( void ) pxDisk;
+
+        if( ( pxRequest->ulSectorAddress + pxRequest->ulCount ) > TEST_DISK_SECTORS )
+        {
+            return -1;
+        }
+
+        for( ulIndex = 0; ulIndex < TEST_MAX_PENDING; ulIndex++ )
+        {
+            if( pxPending[ ulIndex ] == NULL )
+            {
+                pxPending[ ulIndex ] = pxRequest;
+                ulSubmits++;
+
+                if( pxRequest->xWrite == pdFALSE )
+                {
+                    ulTestDiskReadCalls++;
+                }
+
+                return 0;
+            }
+        }
+
+        TEST_FAIL_MESSAGE( "Too many transfers in flight" );
+
+        return -1;
+    }
+
+/* Carry out the transfers that will give 'xSemaphore'. */
+    static void prvCompletePending( SemaphoreHandle_t xSemaphore )
+    {
+        FF_BlockRequest_t * pxRequest;
+        uint32_t ulIndex;
+        size_t uxLength;
+
+        for( ulIndex = 0; ulIndex < TEST_MAX_PENDING; ulIndex++ )
+        {
+            pxRequest = pxPending[ ulIndex ];
+
+            if( ( pxRequest != NULL ) && ( pxRequest->pvDone == ( void * ) xSemaphore ) )
+            {
+                pxPending[ ulIndex ] = NULL;
+                uxLength = ( size_t ) pxRequest->ulCount * testDISK_SECTOR_SIZE;
+
+                if( pxRequest->xWrite != pdFALSE )
+                {
+                    memcpy( &pucTestDiskMemory[ pxRequest->ulSectorAddress * testDISK_SECTOR_SIZE ], pxRequest->pucBuffer, uxLength );
+                }
+                else
+                {
+                    memcpy( pxRequest->pucBuffer, &pucTestDiskMemory[ pxRequest->ulSectorAddress * testDISK_SECTOR_SIZE ], uxLength );
+                    ulTestDiskSectorsRead += pxRequest->ulCount;
+                }
+
+                pxRequest->fnDone( pxRequest, ( int32_t ) pxRequest->ulCount, NULL );
+            }
+        }
+    }
+
+    static uint32_t prvPendingCount( void )
+    {
+        uint32_t ulIndex, ulCount = 0U;
+
+        for( ulIndex = 0; ulIndex < TEST_MAX_PENDING; ulIndex++ )
+        {
+            if( pxPending[ ulIndex ] != NULL )
+            {
+                ulCount++;
+            }
+        }
+
+        return ulCount;
+    }
+
+/*-----------------------------------------------------------*/
+/* RAM disk worker task and queue fakes.                      */
+/*-----------------------------------------------------------*/
+
+/* The worker task of portable/common/ff_ramdisk.c gets no thread.  It runs
+ * when the library waits for a transfer, until its queue is empty, and then
+ * returns to prvRunRAMDiskTask() through xRAMDiskTaskExit. */
+    typedef struct xTEST_QUEUE
+    {
+        UBaseType_t uxLength;
+        UBaseType_t uxCount;
+        UBaseType_t uxHead;
+        void * pvItems[ TEST_MAX_PENDING ];
+    } TestQueue_t;
+
+    static TaskFunction_t pxRAMDiskTask;
+    static void * pvRAMDiskTaskParameters;
+    static jmp_buf xRAMDiskTaskExit;
+    static uint32_t ulTasksCreated;
+    static uint32_t ulTasksDeleted;
+    static uint32_t ulQueuesCreated;
+    static uint32_t ulQueuesDeleted;
+    static uint32_t ulRAMDiskRequests;
+
+    BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                            const char * const pcName,
+                            const uint16_t usStackDepth,
+                            void * const pvParameters,
+                            UBaseType_t uxPriority,
+                            TaskHandle_t * const pxCreatedTask )
+    {
+        ( void ) pcName;
+        ( void ) usStackDepth;
+        ( void ) uxPriority;
+        ( void ) pxCreatedTask;
+
+        /* One worker task at a time. */
+        TEST_ASSERT_NULL( pxRAMDiskTask );
+        pxRAMDiskTask = pxTaskCode;
+        pvRAMDiskTaskParameters = pvParameters;
+        ulTasksCreated++;
+
+        return pdPASS;
+    }
+
+    void vTaskDelete( TaskHandle_t xTaskToDelete )
+    {
+        TEST_ASSERT_NULL( xTaskToDelete );
+        pxRAMDiskTask = NULL;
+        ulTasksDeleted++;
+        longjmp( xRAMDiskTaskExit, 1 );
+    }
+
+    QueueHandle_t xQueueCreate( UBaseType_t uxQueueLength,
+                                UBaseType_t uxItemSize )
+    {
+        TestQueue_t * pxQueue;
+
+        TEST_ASSERT_EQUAL_UINT32( sizeof( void * ), uxItemSize );
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32( TEST_MAX_PENDING, uxQueueLength );
+
+        pxQueue = ( TestQueue_t * ) calloc( 1, sizeof( *pxQueue ) );
+        TEST_ASSERT_NOT_NULL( pxQueue );
+        pxQueue->uxLength = uxQueueLength;
+        ulQueuesCreated++;
+
+        return ( QueueHandle_t ) pxQueue;
+    }
+
+    void vQueueDelete( QueueHandle_t xQueue )
+    {
+        free( xQueue );
+        ulQueuesDeleted++;
+    }
+
+    BaseType_t xQueueSend( QueueHandle_t xQueue,
+                           const void * pvItemToQueue,
+                           TickType_t xTicksToWait )
+    {
+        TestQueue_t * pxQueue = ( TestQueue_t * ) xQueue;
+        void * pvItem;
+
+        ( void ) xTicksToWait;
+
+        if( pxQueue->uxCount == pxQueue->uxLength )
+        {
+            return errQUEUE_FULL;
+        }
+
+        memcpy( &pvItem, pvItemToQueue, sizeof( pvItem ) );
+        pxQueue->pvItems[ ( pxQueue->uxHead + pxQueue->uxCount ) % pxQueue->uxLength ] = pvItem;
+        pxQueue->uxCount++;
+
+        if( pvItem != NULL )
+        {
+            ulRAMDiskRequests++;
+        }
+
+        return pdPASS;
+    }
+
+    BaseType_t xQueueReceive( QueueHandle_t xQueue,
+                              void * pvBuffer,
+                              TickType_t xTicksToWait )
+    {
+        TestQueue_t * pxQueue = ( TestQueue_t * ) xQueue;
+
+        ( void ) xTicksToWait;
+
+        if( pxQueue->uxCount == 0U )
+        {
+            /* The task would block here. */
+            longjmp( xRAMDiskTaskExit, 1 );
+        }
+
+        memcpy( pvBuffer, &( pxQueue->pvItems[ pxQueue->uxHead ] ), sizeof( void * ) );
+        pxQueue->uxHead = ( pxQueue->uxHead + 1U ) % pxQueue->uxLength;
+        pxQueue->uxCount--;
+
+        return pdPASS;
+    }
+
+/* Let the worker task handle the requests in its queue. */
+    static void prvRunRAMDiskTask( void )
+    {
+        if( pxRAMDiskTask != NULL )
+        {
+            if( setjmp( xRAMDiskTaskExit ) == 0 )
+            {
+                pxRAMDiskTask( pvRAMDiskTaskParameters );
+            }
+        }
+    }
+
+/* The RAM disk allocates with pvPortMalloc(), ff_sys.c suspends the
+ * scheduler, which does not run. */
+    void * pvPortMalloc( size_t xWantedSize )
+    {
+        return malloc( xWantedSize );
+    }
+
+    void vPortFree( void * pv )
+    {
+        free( pv );
+    }
+
+    void vTaskSuspendAll( void )
+    {
+    }
+
+    BaseType_t xTaskResumeAll( void )
+    {
+        return pdFALSE;
+    }
+
+/* A binary semaphore is a counter on the heap. */
+    SemaphoreHandle_t xSemaphoreCreateBinary( void )
+    {
+        return ( SemaphoreHandle_t ) calloc( 1, sizeof( uint32_t ) );
+    }
+
+/* Only created by the RAM disk, the locking layer that would take it is a
+ * mock. */
+    SemaphoreHandle_t xSemaphoreCreateRecursiveMutex( void )
+    {
+        return xSemaphoreCreateBinary();
+    }
+
+    void vSemaphoreDelete( SemaphoreHandle_t xSemaphore )
+    {
+        free( ( void * ) xSemaphore );
+    }
+
+    BaseType_t xSemaphoreGive( SemaphoreHandle_t xSemaphore )
+    {
+        *( ( uint32_t * ) xSemaphore ) = 1U;
+
+        return pdTRUE;
+    }
+
+    BaseType_t xSemaphoreGiveFromISR( SemaphoreHandle_t xSemaphore,
+                                      BaseType_t * pxHigherPriorityTaskWoken )
+    {
+        *pxHigherPriorityTaskWoken = pdTRUE;
+
+        return xSemaphoreGive( xSemaphore );
+    }
+
+    BaseType_t xSemaphoreTake( SemaphoreHandle_t xSemaphore,
+                               TickType_t xTicksToWait )
+    {
+        uint32_t * pulCount = ( uint32_t * ) xSemaphore;
+
+        ( void ) xTicksToWait;
+
+        prvCompletePending( xSemaphore );
+        prvRunRAMDiskTask();
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE( 1U, *pulCount, "Waiting for a transfer that was not submitted" );
+        *pulCount = 0U;
+
+        return pdTRUE;
+    }
+
+    BaseType_t xTaskGetSchedulerState( void )
+    {
+        return xSchedulerState;
+    }
+
+#endif /* ffconfigASYNC_BLOCK_DEVICE */
+
+/*-----------------------------------------------------------*/
+/* Volume helpers.                                            */
+/*-----------------------------------------------------------*/
+
+/* Partition, format and mount the RAM disk. */
+static FF_IOManager_t * prvCreateVolume( void )
+{
+    FF_CreationParameters_t xParameters;
+
+    vTestDiskParameters( &xParameters, TEST_CACHE_SECTORS );
+    #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        xParameters.fnSubmitBlocks = prvSubmitBlocks;
+    #endif
+
+    return pxTestDiskFormat( &xParameters, pdTRUE );
+}
+
+/* Fill the first 'ulSize' bytes of ucWritten[] with a pattern that changes
+ * with 'ucSeed'. */
+static void prvFillPattern( uint32_t ulSize,
+                            uint8_t ucSeed )
+{
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < ulSize; ulIndex++ )
+    {
+        ucWritten[ ulIndex ] = ( uint8_t ) ( ( ulIndex * 13U ) + ( ulIndex >> 9 ) + ucSeed );
+    }
+}
+
+/* Write 'ulSize' bytes of a pattern that changes with 'ucSeed' to 'pcName'. */
+static void prvWriteFile( FF_IOManager_t * pxIOManager,
+                          const char * pcName,
+                          uint32_t ulSize,
+                          uint8_t ucSeed )
+{
+    FF_FILE * pxFile;
+    FF_Error_t xError;
+
+    prvFillPattern( ulSize, ucSeed );
+
+    pxFile = FF_Open( pxIOManager, pcName, FF_MODE_WRITE | FF_MODE_CREATE | FF_MODE_TRUNCATE, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+    TEST_ASSERT_EQUAL_INT32( ( int32_t ) ulSize, FF_Write( pxFile, 1, ulSize, ucWritten ) );
+
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+}
+
+/* Write the cache to the disk and forget it, so the next reads go to the
+ * driver. */
+static void prvColdCache( FF_IOManager_t * pxIOManager )
+{
+    FF_Error_t xError;
+
+    xError = FF_FlushCache( pxIOManager );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    FF_DiscardBuffers( pxIOManager, 0U, TEST_DISK_SECTORS );
+
+    ulTestDiskReadCalls = 0U;
+    ulTestDiskSectorsRead = 0U;
+}
+
+/* Read 'pcName' in pieces of 'ulPiece' bytes, and return the number of
+ * bytes read.  'pulInFlight' counts the pieces that were returned while a
+ * transfer was still in flight. */
+static uint32_t prvReadInPieces( FF_IOManager_t * pxIOManager,
+                                 const char * pcName,
+                                 uint32_t ulPiece,
+                                 uint32_t * pulInFlight )
+{
+    FF_FILE * pxFile;
+    FF_Error_t xError;
+    int32_t lCount;
+    uint32_t ulPosition = 0U;
+
+    pxFile = FF_Open( pxIOManager, pcName, FF_MODE_READ, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+
+    do
+    {
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32( sizeof( ucRead ), ulPosition + ulPiece );
+        lCount = FF_Read( pxFile, 1, ulPiece, &( ucRead[ ulPosition ] ) );
+        TEST_ASSERT_GREATER_OR_EQUAL_INT32( 0, lCount );
+        ulPosition += ( uint32_t ) lCount;
+
+        #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        {
+            if( prvPendingCount() != 0U )
+            {
+                ( *pulInFlight )++;
+            }
+        }
+        #endif
+    } while( lCount != 0 );
+
+    ( void ) pulInFlight;
+
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    return ulPosition;
+}
+
+/* The number of runs of contiguous clusters in the chain of 'pcName'. */
+static uint32_t prvCountFragments( FF_IOManager_t * pxIOManager,
+                                   const char * pcName )
+{
+    FF_FILE * pxFile;
+    FF_Error_t xError = FF_ERR_NONE;
+    uint32_t ulCluster, ulNext;
+    uint32_t ulFragments = 0U;
+
+    pxFile = FF_Open( pxIOManager, pcName, FF_MODE_READ, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+
+    for( ulCluster = pxFile->ulObjectCluster; ulCluster != 0U; ulCluster = ulNext )
+    {
+        ulNext = FF_getFATEntry( pxIOManager, ulCluster, &xError, NULL );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+        if( FF_isEndOfChain( pxIOManager, ulNext ) != pdFALSE )
+        {
+            ulNext = 0U;
+        }
+
+        if( ulNext != ( ulCluster + 1U ) )
+        {
+            ulFragments++;
+        }
+    }
+
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    return ulFragments;
+}
+
+/* The number of free clusters that can be allocated.  The allocator only
+ * hands out cluster numbers below ulNumClusters, so unlike
+ * FF_CountFreeClusters() this does not count the last two clusters. */
+static uint32_t prvFreeClusters( FF_IOManager_t * pxIOManager )
+{
+    FF_Error_t xError = FF_ERR_NONE;
+    uint32_t ulCluster;
+    uint32_t ulCount = 0U;
+
+    for( ulCluster = 2U; ulCluster < pxIOManager->xPartition.ulNumClusters; ulCluster++ )
+    {
+        if( FF_getFATEntry( pxIOManager, ulCluster, &xError, NULL ) == 0U )
+        {
+            ulCount++;
+        }
+
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    }
+
+    return ulCount;
+}
+
+/* The size of a cluster of the volume in bytes. */
+static uint32_t prvClusterSize( const FF_IOManager_t * pxIOManager )
+{
+    return ( uint32_t ) pxIOManager->xPartition.usBlkSize * pxIOManager->xPartition.ulSectorsPerCluster;
+}
+
+/* Write 'ulClusters' clusters of a pattern to 'pcName', one cluster at a time,
+ * and a cluster to "/gap.bin" after each of them, so that the clusters of the
+ * file are not contiguous. */
+static void prvWriteFragmented( FF_IOManager_t * pxIOManager,
+                                const char * pcName,
+                                uint32_t ulClusters,
+                                uint8_t ucSeed )
+{
+    uint32_t ulClusterSize = prvClusterSize( pxIOManager );
+    FF_FILE * pxFile;
+    FF_FILE * pxGap;
+    FF_Error_t xError;
+    uint32_t ulIndex;
+
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( sizeof( ucWritten ), ulClusters * ulClusterSize );
+    prvFillPattern( ulClusters * ulClusterSize, ucSeed );
+    memset( ucRead, 0xA5, ulClusterSize );
+
+    pxFile = FF_Open( pxIOManager, pcName, FF_MODE_WRITE | FF_MODE_CREATE | FF_MODE_TRUNCATE, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+    pxGap = FF_Open( pxIOManager, "/gap.bin", FF_MODE_WRITE | FF_MODE_APPEND | FF_MODE_CREATE, &xError );
+    TEST_ASSERT_NOT_NULL( pxGap );
+
+    for( ulIndex = 0U; ulIndex < ulClusters; ulIndex++ )
+    {
+        TEST_ASSERT_EQUAL_INT32( ( int32_t ) ulClusterSize,
+                                 FF_Write( pxFile, 1, ulClusterSize, &( ucWritten[ ulIndex * ulClusterSize ] ) ) );
+        TEST_ASSERT_EQUAL_INT32( ( int32_t ) ulClusterSize, FF_Write( pxGap, 1, ulClusterSize, ucRead ) );
+
+        /* With delayed allocation, the clusters are allocated now. */
+        TEST_ASSERT_FALSE( FF_isERR( FF_FlushFile( pxFile ) ) );
+        TEST_ASSERT_FALSE( FF_isERR( FF_FlushFile( pxGap ) ) );
+    }
+
+    xError = FF_Close( pxGap );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+}
+
+/* Seek to 'ulCount' random positions below 'ulSize', read up to 100 bytes at
+ * each of them and compare them with ucWritten[].  With 'xCheckChain', the
+ * cluster that the handle stopped at must be the one that the FAT gives. */
+static void prvRandomReads( FF_FILE * pxFile,
+                            uint32_t ulSize,
+                            uint32_t ulCount,
+                            BaseType_t xCheckChain )
+{
+    FF_Error_t xError = FF_ERR_NONE;
+    uint32_t ulRandom = 4711U;
+    uint32_t ulIndex, ulPosition, ulLength;
+
+    for( ulIndex = 0U; ulIndex < ulCount; ulIndex++ )
+    {
+        ulRandom = ( ulRandom * 1103515245U ) + 12345U;
+        ulPosition = ( ulRandom >> 8 ) % ulSize;
+        ulLength = ( ( ulSize - ulPosition ) < 100U ) ? ( ulSize - ulPosition ) : 100U;
+
+        xError = FF_Seek( pxFile, ( int32_t ) ulPosition, FF_SEEK_SET );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        TEST_ASSERT_EQUAL_INT32( ( int32_t ) ulLength, FF_Read( pxFile, 1, ulLength, ucRead ) );
+        TEST_ASSERT_EQUAL_MEMORY( &( ucWritten[ ulPosition ] ), ucRead, ulLength );
+
+        if( xCheckChain != pdFALSE )
+        {
+            TEST_ASSERT_EQUAL_UINT32( FF_TraverseFAT( pxFile->pxIOManager, pxFile->ulObjectCluster, pxFile->ulCurrentCluster, &xError ),
+                                      pxFile->ulAddrCurrentCluster );
+            TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+/* Unity fixtures.                                            */
+/*-----------------------------------------------------------*/
+
+void setUp( void )
+{
+    vTestDiskInit( TEST_DISK_SECTORS );
+
+    #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+    {
+        memset( pxPending, 0, sizeof( pxPending ) );
+        ulSubmits = 0U;
+        xSchedulerState = taskSCHEDULER_RUNNING;
+
+        ulTasksCreated = 0U;
+        ulTasksDeleted = 0U;
+        ulQueuesCreated = 0U;
+        ulQueuesDeleted = 0U;
+        ulRAMDiskRequests = 0U;
+    }
+    #endif
+
+    FF_CreateEvents_IgnoreAndReturn( pdTRUE );
+    FF_DeleteEvents_Ignore();
+    FF_PendSemaphore_Ignore();
+    FF_ReleaseSemaphore_Ignore();
+    FF_BufferWait_IgnoreAndReturn( pdTRUE );
+    FF_BufferProceed_Ignore();
+    FF_Sleep_Ignore();
+    FF_LockDirectory_Ignore();
+    FF_UnlockDirectory_Ignore();
+    FF_LockDirectoryCluster_Ignore();
+    FF_UnlockDirectoryCluster_Ignore();
+    FF_LockFAT_Ignore();
+    FF_UnlockFAT_Ignore();
+    FF_LockFATShared_Ignore();
+    FF_UnlockFATShared_Ignore();
+    FF_Has_Lock_IgnoreAndReturn( pdFALSE );
+    FF_Assert_Lock_Ignore();
+}
+
+void tearDown( void )
+{
+    vTestDiskFree();
+}
+
+/*-----------------------------------------------------------*/
+/* Tests.                                                     */
+/*-----------------------------------------------------------*/
+
+/*
+ * A file read in pieces of 37 bytes gives the data that was written.  With
+ * ffconfigREAD_AHEAD_SECTORS, the sectors are read from the driver in runs.
+ */
+void test_Read_small_pieces_gives_the_written_data( void )
+{
+    FF_IOManager_t * pxIOManager = prvCreateVolume();
+    uint32_t ulInFlight = 0U;
+
+    prvWriteFile( pxIOManager, "/small.bin", TEST_FILE_SIZE, 0U );
+    prvColdCache( pxIOManager );
+
+    TEST_ASSERT_EQUAL_UINT32( TEST_FILE_SIZE, prvReadInPieces( pxIOManager, "/small.bin", TEST_PIECE_SIZE, &ulInFlight ) );
+    TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, TEST_FILE_SIZE );
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32( TEST_FILE_SIZE / testDISK_SECTOR_SIZE, ulTestDiskSectorsRead );
+
+    #if ( ffconfigREAD_AHEAD_SECTORS > 1 )
+    {
+        /* Most sectors were read in runs, not one by one. */
+        TEST_ASSERT_LESS_THAN_UINT32( ulTestDiskSectorsRead / 4U, ulTestDiskReadCalls );
+    }
+    #endif
+}
+
+/*
+ * Sectors that are cached while a file is read are not used any more after
+ * the file was overwritten with whole clusters, which are written to the
+ * disk directly.
+ */
+void test_Read_after_direct_write_is_not_stale( void )
+{
+    FF_IOManager_t * pxIOManager = prvCreateVolume();
+    FF_FILE * pxFile;
+    FF_Error_t xError;
+    uint8_t ucPiece[ 100 ];
+    uint32_t ulInFlight = 0U;
+
+    prvWriteFile( pxIOManager, "/over.bin", TEST_FILE_SIZE, 0U );
+    prvColdCache( pxIOManager );
+
+    /* Get part of the file into the cache. */
+    pxFile = FF_Open( pxIOManager, "/over.bin", FF_MODE_READ | FF_MODE_WRITE, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+    TEST_ASSERT_EQUAL_INT32( 0, FF_Seek( pxFile, 4096, FF_SEEK_SET ) );
+    TEST_ASSERT_EQUAL_INT32( sizeof( ucPiece ), FF_Read( pxFile, 1, sizeof( ucPiece ), ucPiece ) );
+    TEST_ASSERT_EQUAL_MEMORY( &( ucWritten[ 4096 ] ), ucPiece, sizeof( ucPiece ) );
+
+    /* Overwrite the first 64 KB. */
+    memset( ucWritten, 0x5A, 65536U );
+    TEST_ASSERT_EQUAL_INT32( 0, FF_Seek( pxFile, 0, FF_SEEK_SET ) );
+    TEST_ASSERT_EQUAL_INT32( 65536, FF_Write( pxFile, 1, 65536U, ucWritten ) );
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    TEST_ASSERT_EQUAL_UINT32( TEST_FILE_SIZE, prvReadInPieces( pxIOManager, "/over.bin", TEST_PIECE_SIZE, &ulInFlight ) );
+    TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, TEST_FILE_SIZE );
+}
+
+/*
+ * A part of a sector written through the cache is seen when the same handle
+ * reads it back with whole sectors, which bypass the cache.
+ */
+void test_Read_after_cached_write_is_not_stale( void )
+{
+    FF_IOManager_t * pxIOManager = prvCreateVolume();
+    FF_FILE * pxFile;
+    FF_Error_t xError;
+
+    prvWriteFile( pxIOManager, "/upd.bin", TEST_FILE_SIZE, 1U );
+    prvColdCache( pxIOManager );
+
+    pxFile = FF_Open( pxIOManager, "/upd.bin", FF_MODE_READ | FF_MODE_WRITE, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+
+    memset( &( ucWritten[ 1000 ] ), 0xEE, 10U );
+    TEST_ASSERT_EQUAL_INT32( 0, FF_Seek( pxFile, 1000, FF_SEEK_SET ) );
+    TEST_ASSERT_EQUAL_INT32( 10, FF_Write( pxFile, 1, 10U, &( ucWritten[ 1000 ] ) ) );
+
+    TEST_ASSERT_EQUAL_INT32( 0, FF_Seek( pxFile, 0, FF_SEEK_SET ) );
+    TEST_ASSERT_EQUAL_INT32( 65536, FF_Read( pxFile, 1, 65536U, ucRead ) );
+    TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, 65536U );
+
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+}
+
+/*
+ * With ffconfigDIRECT_IO, a handle opened with FF_MODE_DIRECT writes and
+ * reads parts of sectors at both ends of a transfer through its own sector
+ * buffer.  Sectors of the file that were cached before are not returned
+ * stale afterwards.
+ */
+void test_DirectIO_unaligned_head_and_tail( void )
+{
+    #if ( ffconfigDIRECT_IO != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        FF_FILE * pxFile;
+        FF_Error_t xError;
+        uint32_t ulInFlight = 0U;
+
+        prvWriteFile( pxIOManager, "/direct.bin", TEST_FILE_SIZE, 2U );
+
+        /* Get the file into the cache. */
+        prvColdCache( pxIOManager );
+        TEST_ASSERT_EQUAL_UINT32( TEST_FILE_SIZE, prvReadInPieces( pxIOManager, "/direct.bin", TEST_PIECE_SIZE, &ulInFlight ) );
+
+        pxFile = FF_Open( pxIOManager, "/direct.bin", FF_MODE_READ | FF_MODE_WRITE | FF_MODE_DIRECT, &xError );
+        TEST_ASSERT_NOT_NULL( pxFile );
+        TEST_ASSERT_NOT_NULL( pxFile->pucBuffer );
+
+        /* 24 bytes up to a sector boundary, 3 whole sectors and 276 bytes. */
+        memset( &( ucWritten[ 1000 ] ), 0xC3, 1836U );
+        TEST_ASSERT_EQUAL_INT32( 0, FF_Seek( pxFile, 1000, FF_SEEK_SET ) );
+        TEST_ASSERT_EQUAL_INT32( 1836, FF_Write( pxFile, 1, 1836U, &( ucWritten[ 1000 ] ) ) );
+
+        TEST_ASSERT_EQUAL_INT32( 0, FF_Seek( pxFile, 777, FF_SEEK_SET ) );
+        TEST_ASSERT_EQUAL_INT32( 2500, FF_Read( pxFile, 1, 2500U, ucRead ) );
+        TEST_ASSERT_EQUAL_MEMORY( &( ucWritten[ 777 ] ), ucRead, 2500U );
+
+        xError = FF_Close( pxFile );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+        TEST_ASSERT_EQUAL_UINT32( TEST_FILE_SIZE, prvReadInPieces( pxIOManager, "/direct.bin", TEST_PIECE_SIZE, &ulInFlight ) );
+        TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, TEST_FILE_SIZE );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigDIRECT_IO" );
+    #endif
+}
+
+/*
+ * A file of 512 sectors read in small pieces with FF_MODE_DIRECT does not
+ * pass through the cache of 64 sectors: when it is read again, the FAT and
+ * root directory sectors are still cached.
+ */
+void test_DirectIO_keeps_FAT_and_directory_sectors_cached( void )
+{
+    #if ( ffconfigDIRECT_IO != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        FF_FILE * pxFile;
+        FF_Error_t xError;
+        uint32_t ulPass, ulPosition;
+        int32_t lCount;
+
+        prvWriteFile( pxIOManager, "/stream.bin", TEST_FILE_SIZE, 3U );
+        prvColdCache( pxIOManager );
+
+        for( ulPass = 0U; ulPass < 2U; ulPass++ )
+        {
+            if( ulPass == 1U )
+            {
+                /* The FAT and the root directory of FAT16 lie before the clusters. */
+                vTestDiskWatch( pxIOManager->xPartition.ulFATBeginLBA,
+                                pxIOManager->xPartition.ulClusterBeginLBA - pxIOManager->xPartition.ulFATBeginLBA );
+            }
+
+            pxFile = FF_Open( pxIOManager, "/stream.bin", FF_MODE_READ | FF_MODE_DIRECT, &xError );
+            TEST_ASSERT_NOT_NULL( pxFile );
+            ulPosition = 0U;
+
+            do
+            {
+                lCount = FF_Read( pxFile, 1, TEST_PIECE_SIZE, &( ucRead[ ulPosition ] ) );
+                TEST_ASSERT_GREATER_OR_EQUAL_INT32( 0, lCount );
+                ulPosition += ( uint32_t ) lCount;
+            } while( lCount != 0 );
+
+            xError = FF_Close( pxFile );
+            TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+            TEST_ASSERT_EQUAL_UINT32( TEST_FILE_SIZE, ulPosition );
+            TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, TEST_FILE_SIZE );
+        }
+
+        TEST_ASSERT_EQUAL_UINT32( 0U, ulTestDiskRegionReads );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigDIRECT_IO" );
+    #endif
+}
+
+/*
+ * With a driver that has fnSubmitBlocks(), the sectors that follow are
+ * submitted, and FF_Read() returns before they have been read.
+ */
+void test_ReadAhead_uses_the_async_driver( void )
+{
+    #if ( ( ffconfigREAD_AHEAD_SECTORS > 1 ) && ( ffconfigASYNC_BLOCK_DEVICE != 0 ) )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        uint32_t ulInFlight = 0U;
+
+        prvWriteFile( pxIOManager, "/async.bin", TEST_FILE_SIZE, 3U );
+        prvColdCache( pxIOManager );
+        ulSubmits = 0U;
+
+        TEST_ASSERT_EQUAL_UINT32( TEST_FILE_SIZE, prvReadInPieces( pxIOManager, "/async.bin", TEST_PIECE_SIZE, &ulInFlight ) );
+        TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, TEST_FILE_SIZE );
+
+        /* Every run after the first sector of the file was submitted. */
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32( ( TEST_FILE_SIZE / testDISK_SECTOR_SIZE ) / ffconfigREAD_AHEAD_SECTORS, ulSubmits );
+        TEST_ASSERT_GREATER_THAN_UINT32( 0U, ulInFlight );
+
+        /* Closing the file leaves nothing in flight once the volume is
+         * unmounted. */
+        TEST_ASSERT_FALSE( FF_isERR( FF_Unmount( &xTestDisk ) ) );
+        TEST_ASSERT_EQUAL_UINT32( 0U, prvPendingCount() );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigREAD_AHEAD_SECTORS and ffconfigASYNC_BLOCK_DEVICE" );
+    #endif
+}
+
+/*
+ * Two disks of portable/common/ff_ramdisk.c share its worker task, which
+ * performs the transfers that FF_Write() and FF_Read() submit.  The files
+ * read back as they were written.  The task and its queue are deleted with
+ * the last disk, and created again for the next one.
+ */
+void test_RAMDisk_worker_task_transfers_and_stops( void )
+{
+    #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+        const size_t uxDiskSize = ( size_t ) TEST_RAM_DISK_SECTORS * testDISK_SECTOR_SIZE;
+        char pcNames[ 2 ][ 8 ] = { "/ram0", "/ram1" };
+        uint8_t * pucMemory = ( uint8_t * ) malloc( 2U * uxDiskSize );
+        FF_Disk_t * pxDisks[ 2 ];
+        uint32_t ulInFlight = 0U;
+        uint32_t ulIndex;
+
+        TEST_ASSERT_NOT_NULL( pucMemory );
+
+        for( ulIndex = 0U; ulIndex < 2U; ulIndex++ )
+        {
+            pxDisks[ ulIndex ] = FF_RAMDiskInit( pcNames[ ulIndex ], &( pucMemory[ ulIndex * uxDiskSize ] ),
+                                                 TEST_RAM_DISK_SECTORS, TEST_CACHE_SECTORS * testDISK_SECTOR_SIZE );
+            TEST_ASSERT_NOT_NULL( pxDisks[ ulIndex ] );
+            TEST_ASSERT_TRUE( FF_Mounted( pxDisks[ ulIndex ]->pxIOManager ) );
+            TEST_ASSERT_NOT_NULL( pxDisks[ ulIndex ]->pxIOManager->xBlkDevice.fnpSubmitBlocks );
+        }
+
+        TEST_ASSERT_EQUAL_UINT32( 1U, ulTasksCreated );
+        TEST_ASSERT_EQUAL_UINT32( 1U, ulQueuesCreated );
+
+        for( ulIndex = 0U; ulIndex < 2U; ulIndex++ )
+        {
+            prvWriteFile( pxDisks[ ulIndex ]->pxIOManager, "/ram.bin", TEST_FILE_SIZE, ( uint8_t ) ulIndex );
+            prvColdCache( pxDisks[ ulIndex ]->pxIOManager );
+
+            TEST_ASSERT_EQUAL_UINT32( TEST_FILE_SIZE, prvReadInPieces( pxDisks[ ulIndex ]->pxIOManager, "/ram.bin", TEST_PIECE_SIZE, &ulInFlight ) );
+            TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, TEST_FILE_SIZE );
+        }
+
+        TEST_ASSERT_GREATER_THAN_UINT32( 0U, ulRAMDiskRequests );
+
+        /* The task stays while a disk uses it. */
+        FF_FS_Remove( pcNames[ 0 ] );
+        TEST_ASSERT_FALSE( FF_isERR( FF_Unmount( pxDisks[ 0 ] ) ) );
+        FF_RAMDiskDelete( pxDisks[ 0 ] );
+        prvRunRAMDiskTask();
+        TEST_ASSERT_EQUAL_UINT32( 0U, ulTasksDeleted );
+        TEST_ASSERT_EQUAL_UINT32( 0U, ulQueuesDeleted );
+
+        FF_FS_Remove( pcNames[ 1 ] );
+        TEST_ASSERT_FALSE( FF_isERR( FF_Unmount( pxDisks[ 1 ] ) ) );
+        FF_RAMDiskDelete( pxDisks[ 1 ] );
+        prvRunRAMDiskTask();
+        TEST_ASSERT_EQUAL_UINT32( 1U, ulTasksDeleted );
+        TEST_ASSERT_EQUAL_UINT32( 1U, ulQueuesDeleted );
+
+        /* A new disk gets a new task. */
+        pxDisks[ 0 ] = FF_RAMDiskInit( pcNames[ 0 ], pucMemory, TEST_RAM_DISK_SECTORS, TEST_CACHE_SECTORS * testDISK_SECTOR_SIZE );
+        TEST_ASSERT_NOT_NULL( pxDisks[ 0 ] );
+        TEST_ASSERT_EQUAL_UINT32( 2U, ulTasksCreated );
+
+        FF_FS_Remove( pcNames[ 0 ] );
+        TEST_ASSERT_FALSE( FF_isERR( FF_Unmount( pxDisks[ 0 ] ) ) );
+        FF_RAMDiskDelete( pxDisks[ 0 ] );
+        prvRunRAMDiskTask();
+        TEST_ASSERT_EQUAL_UINT32( 2U, ulTasksDeleted );
+        TEST_ASSERT_EQUAL_UINT32( 2U, ulQueuesDeleted );
+
+        free( pucMemory );
+    #else /* if ( ffconfigASYNC_BLOCK_DEVICE != 0 ) */
+        TEST_IGNORE_MESSAGE( "Needs ffconfigASYNC_BLOCK_DEVICE" );
+    #endif /* if ( ffconfigASYNC_BLOCK_DEVICE != 0 ) */
+}
+
+/*
+ * A size close to 4 GB must not wrap around when it is rounded up to whole
+ * clusters: on a volume of 8 MB, preallocating it fails and the file keeps
+ * its size.
+ */
+void test_Preallocate_near_4_GB_fails( void )
+{
+    FF_IOManager_t * pxIOManager = prvCreateVolume();
+    const uint32_t ulSizes[] = { 0xFFFFFFFFU, 0xFFFFFE01U };
+    FF_FILE * pxFile;
+    FF_Error_t xError;
+    uint32_t ulIndex;
+
+    pxFile = FF_Open( pxIOManager, "/huge.bin", FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+
+    for( ulIndex = 0U; ulIndex < ( sizeof( ulSizes ) / sizeof( ulSizes[ 0 ] ) ); ulIndex++ )
+    {
+        xError = FF_Preallocate( pxFile, ulSizes[ ulIndex ], pdFALSE );
+        TEST_ASSERT_TRUE( FF_isERR( xError ) );
+        TEST_ASSERT_EQUAL_UINT32( 0U, pxFile->ulFileSize );
+
+        xError = FF_Preallocate( pxFile, ulSizes[ ulIndex ], pdTRUE );
+        TEST_ASSERT_TRUE( FF_isERR( xError ) );
+        TEST_ASSERT_EQUAL_UINT32( 0U, pxFile->ulFileSize );
+    }
+
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+}
+
+/*
+ * Once a file was preallocated with its new size, writing it from the start
+ * in pieces does not write a FAT sector: every cluster is already in the
+ * chain.  The file reads back as it was written.  The size does not end on a
+ * cluster boundary, where FF_Write() would claim one more cluster to write
+ * to.
+ */
+void test_Preallocate_sequential_writes_make_no_FAT_writes( void )
+{
+    FF_IOManager_t * pxIOManager = prvCreateVolume();
+    uint32_t ulSize = ( 32U * prvClusterSize( pxIOManager ) ) - 100U;
+    uint32_t ulPosition, ulLength;
+    FF_FILE * pxFile;
+    FF_Error_t xError = FF_ERR_NONE;
+
+    prvFillPattern( ulSize, 9U );
+
+    pxFile = FF_Open( pxIOManager, "/prealloc.bin", FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+
+    xError = FF_Preallocate( pxFile, ulSize, pdFALSE );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    TEST_ASSERT_EQUAL_UINT32( ulSize, pxFile->ulFileSize );
+    TEST_ASSERT_EQUAL_UINT32( 32U, FF_GetChainLength( pxIOManager, pxFile->ulObjectCluster, NULL, &xError ) );
+
+    /* The chain is on the disk, only the writes that follow are counted. */
+    xError = FF_FlushCache( pxIOManager );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    vTestDiskWatchFAT( pxIOManager );
+
+    for( ulPosition = 0U; ulPosition < ulSize; ulPosition += ulLength )
+    {
+        ulLength = ( ( ulSize - ulPosition ) < 1000U ) ? ( ulSize - ulPosition ) : 1000U;
+        TEST_ASSERT_EQUAL_INT32( ( int32_t ) ulLength, FF_Write( pxFile, 1, ulLength, &( ucWritten[ ulPosition ] ) ) );
+    }
+
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    xError = FF_FlushCache( pxIOManager );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    TEST_ASSERT_EQUAL_UINT32( 0U, ulTestDiskRegionWrites );
+    TEST_ASSERT_EQUAL_UINT32( ulSize, prvReadInPieces( pxIOManager, "/prealloc.bin", TEST_PIECE_SIZE, &ulPosition ) );
+    TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, ulSize );
+}
+
+/*
+ * Clusters preallocated with the size kept, and not reached by the writes
+ * that follow, are freed by FF_Close().  The file keeps the clusters that
+ * hold its data, and its data.
+ */
+void test_Preallocate_keep_size_is_trimmed_on_close( void )
+{
+    FF_IOManager_t * pxIOManager = prvCreateVolume();
+    uint32_t ulClusterSize = prvClusterSize( pxIOManager );
+    uint32_t ulSize = ( 3U * ulClusterSize ) + 100U;
+    uint32_t ulFree;
+    FF_FILE * pxFile;
+    FF_Error_t xError = FF_ERR_NONE;
+
+    prvWriteFile( pxIOManager, "/keep.bin", 100U, 4U );
+    ulFree = prvFreeClusters( pxIOManager );
+
+    pxFile = FF_Open( pxIOManager, "/keep.bin", FF_MODE_READ | FF_MODE_WRITE, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+
+    xError = FF_Preallocate( pxFile, 16U * ulClusterSize, pdTRUE );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    TEST_ASSERT_EQUAL_UINT32( 100U, pxFile->ulFileSize );
+    TEST_ASSERT_EQUAL_UINT32( 16U, FF_GetChainLength( pxIOManager, pxFile->ulObjectCluster, NULL, &xError ) );
+    TEST_ASSERT_EQUAL_UINT32( ulFree - 15U, prvFreeClusters( pxIOManager ) );
+
+    /* The file grows into the fourth of the reserved clusters. */
+    prvFillPattern( ulSize, 4U );
+    xError = FF_Seek( pxFile, 100, FF_SEEK_SET );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    TEST_ASSERT_EQUAL_INT32( ( int32_t ) ( ulSize - 100U ), FF_Write( pxFile, 1, ulSize - 100U, &( ucWritten[ 100 ] ) ) );
+
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    TEST_ASSERT_EQUAL_UINT32( ulFree - 3U, prvFreeClusters( pxIOManager ) );
+
+    pxFile = FF_Open( pxIOManager, "/keep.bin", FF_MODE_READ, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+    TEST_ASSERT_EQUAL_UINT32( ulSize, pxFile->ulFileSize );
+    TEST_ASSERT_EQUAL_UINT32( 4U, FF_GetChainLength( pxIOManager, pxFile->ulObjectCluster, NULL, &xError ) );
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    TEST_ASSERT_EQUAL_UINT32( ulSize, prvReadInPieces( pxIOManager, "/keep.bin", TEST_PIECE_SIZE, &ulFree ) );
+    TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, ulSize );
+}
+
+/*
+ * Random seeks and reads in a file of 48 fragments give the written data, and
+ * stop at the cluster that the FAT gives.  The test runs in every build, with
+ * ffconfigFILE_EXTENT_MAP it also sees runs being forgotten because the map is
+ * full.
+ */
+void test_ExtentMap_random_reads_on_a_fragmented_file( void )
+{
+    FF_IOManager_t * pxIOManager = prvCreateVolume();
+    uint32_t ulSize = 48U * prvClusterSize( pxIOManager );
+    FF_FILE * pxFile;
+    FF_Error_t xError;
+
+    prvWriteFragmented( pxIOManager, "/frag.bin", 48U, 5U );
+    TEST_ASSERT_GREATER_THAN_UINT32( 24U, prvCountFragments( pxIOManager, "/frag.bin" ) );
+
+    pxFile = FF_Open( pxIOManager, "/frag.bin", FF_MODE_READ, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+    prvRandomReads( pxFile, ulSize, 500U, pdTRUE );
+
+    #if ( ffconfigFILE_EXTENT_MAP != 0 )
+    {
+        TEST_ASSERT_EQUAL_UINT16( ffconfigFILE_EXTENT_MAP, pxFile->usExtentCount );
+    }
+    #endif
+
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+}
+
+/*
+ * Once a handle has followed the whole chain of a file with fewer fragments
+ * than the map holds, random reads do not read a FAT sector from the disk.
+ * Without the map, the chain is followed from the start after every seek
+ * backwards.
+ */
+void test_ExtentMap_warm_map_reads_no_FAT_sectors( void )
+{
+    FF_IOManager_t * pxIOManager = prvCreateVolume();
+    uint32_t ulSize = 6U * prvClusterSize( pxIOManager );
+    FF_FILE * pxFile;
+    FF_Error_t xError;
+
+    prvWriteFragmented( pxIOManager, "/frag.bin", 6U, 6U );
+
+    pxFile = FF_Open( pxIOManager, "/frag.bin", FF_MODE_READ, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+    TEST_ASSERT_EQUAL_INT32( ( int32_t ) ulSize, FF_Read( pxFile, 1, ulSize, ucRead ) );
+
+    prvColdCache( pxIOManager );
+    vTestDiskWatchFAT( pxIOManager );
+    prvRandomReads( pxFile, ulSize, 200U, pdFALSE );
+
+    #if ( ffconfigFILE_EXTENT_MAP != 0 )
+    {
+        TEST_ASSERT_EQUAL_UINT32( 0U, ulTestDiskRegionReads );
+    }
+    #else
+    {
+        TEST_ASSERT_GREATER_THAN_UINT32( 0U, ulTestDiskRegionReads );
+    }
+    #endif
+
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+}
+
+/*
+ * FF_SetEof() frees the clusters after the new end.  Another file takes them,
+ * and the handle extends its file again: it must not read the freed clusters
+ * through runs that it remembered before.
+ */
+void test_ExtentMap_truncate_and_extend( void )
+{
+    FF_IOManager_t * pxIOManager = prvCreateVolume();
+    uint32_t ulClusterSize = prvClusterSize( pxIOManager );
+    uint32_t ulSize = 12U * ulClusterSize;
+    uint32_t ulKeep = ( 5U * ulClusterSize ) + 100U;
+    uint32_t ulIndex;
+    FF_FILE * pxFile;
+    FF_FILE * pxOther;
+    FF_Error_t xError;
+
+    prvWriteFragmented( pxIOManager, "/frag.bin", 12U, 7U );
+
+    pxFile = FF_Open( pxIOManager, "/frag.bin", FF_MODE_READ | FF_MODE_WRITE, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+    prvRandomReads( pxFile, ulSize, 100U, pdTRUE );
+
+    xError = FF_Seek( pxFile, ( int32_t ) ulKeep, FF_SEEK_SET );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    xError = FF_SetEof( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    /* Another file takes the freed clusters. */
+    memset( ucRead, 0x3C, ulClusterSize );
+    pxOther = FF_Open( pxIOManager, "/other.bin", FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+    TEST_ASSERT_NOT_NULL( pxOther );
+
+    for( ulIndex = 0U; ulIndex < 8U; ulIndex++ )
+    {
+        TEST_ASSERT_EQUAL_INT32( ( int32_t ) ulClusterSize, FF_Write( pxOther, 1, ulClusterSize, ucRead ) );
+    }
+
+    xError = FF_Close( pxOther );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    /* The file grows again, with other data. */
+    for( ulIndex = ulKeep; ulIndex < ulSize; ulIndex++ )
+    {
+        ucWritten[ ulIndex ] ^= 0x5AU;
+    }
+
+    TEST_ASSERT_EQUAL_INT32( ( int32_t ) ( ulSize - ulKeep ), FF_Write( pxFile, 1, ulSize - ulKeep, &( ucWritten[ ulKeep ] ) ) );
+    prvRandomReads( pxFile, ulSize, 200U, pdTRUE );
+
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    TEST_ASSERT_EQUAL_UINT32( ulSize, prvReadInPieces( pxIOManager, "/frag.bin", TEST_PIECE_SIZE, &ulIndex ) );
+    TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, ulSize );
+}
+
+/*
+ * Clusters preallocated beyond the end of a fragmented file are freed by
+ * FF_Close(), after the handle has read through them.  The file keeps its
+ * clusters and data, and no clusters are lost.
+ */
+void test_ExtentMap_Close_trims_preallocated_clusters( void )
+{
+    FF_IOManager_t * pxIOManager = prvCreateVolume();
+    uint32_t ulClusterSize = prvClusterSize( pxIOManager );
+    uint32_t ulSize = 8U * ulClusterSize;
+    uint32_t ulFree, ulClusters;
+    FF_FILE * pxFile;
+    FF_Error_t xError = FF_ERR_NONE;
+
+    prvWriteFragmented( pxIOManager, "/frag.bin", 8U, 8U );
+    ulFree = prvFreeClusters( pxIOManager );
+
+    pxFile = FF_Open( pxIOManager, "/frag.bin", FF_MODE_READ | FF_MODE_WRITE, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+    ulClusters = FF_GetChainLength( pxIOManager, pxFile->ulObjectCluster, NULL, &xError );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    xError = FF_Preallocate( pxFile, ulSize + ( 16U * ulClusterSize ), pdTRUE );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    TEST_ASSERT_EQUAL_UINT32( ulSize, pxFile->ulFileSize );
+    TEST_ASSERT_LESS_THAN_UINT32( ulFree, prvFreeClusters( pxIOManager ) );
+
+    prvRandomReads( pxFile, ulSize, 100U, pdTRUE );
+
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+    TEST_ASSERT_EQUAL_UINT32( ulFree, prvFreeClusters( pxIOManager ) );
+
+    pxFile = FF_Open( pxIOManager, "/frag.bin", FF_MODE_READ, &xError );
+    TEST_ASSERT_NOT_NULL( pxFile );
+    TEST_ASSERT_EQUAL_UINT32( ulClusters, FF_GetChainLength( pxIOManager, pxFile->ulObjectCluster, NULL, &xError ) );
+    prvRandomReads( pxFile, ulSize, 100U, pdTRUE );
+
+    xError = FF_Close( pxFile );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+}
+
+/*
+ * Data appended in small pieces stays in the handle, without clusters, until
+ * ffconfigDELAYED_ALLOCATION bytes are pending.  The file reads back as it
+ * was written.
+ */
+void test_DelayedAllocation_append_and_read_back( void )
+{
+    #if ( ffconfigDELAYED_ALLOCATION != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        FF_FILE * pxFile;
+        FF_Error_t xError;
+        uint32_t ulInFlight = 0U;
+        uint32_t ulPosition;
+
+        prvFillPattern( TEST_FILE_SIZE, 1U );
+
+        pxFile = FF_Open( pxIOManager, "/append.bin", FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+        TEST_ASSERT_NOT_NULL( pxFile );
+
+        for( ulPosition = 0U; ulPosition < TEST_FILE_SIZE; ulPosition += TEST_PIECE_SIZE )
+        {
+            uint32_t ulLength = TEST_FILE_SIZE - ulPosition;
+
+            if( ulLength > TEST_PIECE_SIZE )
+            {
+                ulLength = TEST_PIECE_SIZE;
+            }
+
+            TEST_ASSERT_EQUAL_INT32( ( int32_t ) ulLength, FF_Write( pxFile, 1, ulLength, &( ucWritten[ ulPosition ] ) ) );
+
+            if( ( ulPosition + ulLength ) <= ffconfigDELAYED_ALLOCATION )
+            {
+                /* The file still has only the cluster that FF_Open() gave it. */
+                TEST_ASSERT_TRUE( FF_isEndOfChain( pxIOManager, FF_getFATEntry( pxIOManager, pxFile->ulObjectCluster, &xError, NULL ) ) );
+                TEST_ASSERT_EQUAL_UINT32( ulPosition + ulLength, pxFile->ulDelayedLength );
+            }
+
+            TEST_ASSERT_EQUAL_UINT32( ulPosition + ulLength, pxFile->ulFileSize );
+        }
+
+        xError = FF_Close( pxFile );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+        prvColdCache( pxIOManager );
+        TEST_ASSERT_EQUAL_UINT32( TEST_FILE_SIZE, prvReadInPieces( pxIOManager, "/append.bin", TEST_PIECE_SIZE, &ulInFlight ) );
+        TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, TEST_FILE_SIZE );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigDELAYED_ALLOCATION" );
+    #endif
+}
+
+/*
+ * Two handles that append to different files in turn get one run of clusters
+ * per buffer, not one cluster each in turn.
+ */
+void test_DelayedAllocation_keeps_two_appenders_apart( void )
+{
+    #if ( ffconfigDELAYED_ALLOCATION != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        FF_FILE * pxFiles[ 2 ];
+        FF_Error_t xError;
+        uint32_t ulPosition, ulFile, ulClusterSize;
+
+        prvFillPattern( TEST_FILE_SIZE, 2U );
+        ulClusterSize = pxIOManager->xPartition.usBlkSize * pxIOManager->xPartition.ulSectorsPerCluster;
+
+        pxFiles[ 0 ] = FF_Open( pxIOManager, "/log0.txt", FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+        TEST_ASSERT_NOT_NULL( pxFiles[ 0 ] );
+        pxFiles[ 1 ] = FF_Open( pxIOManager, "/log1.txt", FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+        TEST_ASSERT_NOT_NULL( pxFiles[ 1 ] );
+
+        for( ulPosition = 0U; ulPosition < ( TEST_FILE_SIZE / 4U ); ulPosition += 100U )
+        {
+            for( ulFile = 0U; ulFile < 2U; ulFile++ )
+            {
+                TEST_ASSERT_EQUAL_INT32( 100, FF_Write( pxFiles[ ulFile ], 1, 100U, &( ucWritten[ ulPosition ] ) ) );
+            }
+        }
+
+        for( ulFile = 0U; ulFile < 2U; ulFile++ )
+        {
+            xError = FF_Close( pxFiles[ ulFile ] );
+            TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        }
+
+        /* A buffer holds at least one cluster, so there is at most one run
+         * per buffer, plus the cluster that FF_Open() gave to the new file
+         * and the spare cluster at the end. */
+        if( ulClusterSize <= ffconfigDELAYED_ALLOCATION )
+        {
+            TEST_ASSERT_LESS_OR_EQUAL_UINT32( ( ( TEST_FILE_SIZE / 4U ) / ffconfigDELAYED_ALLOCATION ) + 2U,
+                                              prvCountFragments( pxIOManager, "/log0.txt" ) );
+            TEST_ASSERT_LESS_OR_EQUAL_UINT32( ( ( TEST_FILE_SIZE / 4U ) / ffconfigDELAYED_ALLOCATION ) + 2U,
+                                              prvCountFragments( pxIOManager, "/log1.txt" ) );
+        }
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigDELAYED_ALLOCATION" );
+    #endif
+}
+
+/*
+ * Seeking back into data that is still pending writes it first, so that it
+ * can be read and overwritten.
+ */
+void test_DelayedAllocation_seek_into_pending_data( void )
+{
+    #if ( ffconfigDELAYED_ALLOCATION != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        FF_FILE * pxFile;
+        FF_Error_t xError;
+        uint8_t ucPiece[ 100 ];
+        uint32_t ulInFlight = 0U;
+
+        prvFillPattern( 1000U, 3U );
+
+        pxFile = FF_Open( pxIOManager, "/seek.bin", FF_MODE_READ | FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+        TEST_ASSERT_NOT_NULL( pxFile );
+        TEST_ASSERT_EQUAL_INT32( 1000, FF_Write( pxFile, 1, 1000U, ucWritten ) );
+        TEST_ASSERT_EQUAL_UINT32( 1000U, pxFile->ulDelayedLength );
+
+        TEST_ASSERT_EQUAL_INT32( 0, FF_Seek( pxFile, 500, FF_SEEK_SET ) );
+        TEST_ASSERT_EQUAL_UINT32( 0U, pxFile->ulDelayedLength );
+        TEST_ASSERT_NOT_EQUAL( 0U, pxFile->ulObjectCluster );
+        TEST_ASSERT_EQUAL_UINT32( 1000U, pxFile->ulFileSize );
+
+        TEST_ASSERT_EQUAL_INT32( sizeof( ucPiece ), FF_Read( pxFile, 1, sizeof( ucPiece ), ucPiece ) );
+        TEST_ASSERT_EQUAL_MEMORY( &( ucWritten[ 500 ] ), ucPiece, sizeof( ucPiece ) );
+
+        /* Overwrite a part in the middle, the file does not grow. */
+        memset( &( ucWritten[ 600 ] ), 0xA5, 50U );
+        TEST_ASSERT_EQUAL_INT32( 50, FF_Write( pxFile, 1, 50U, &( ucWritten[ 600 ] ) ) );
+        TEST_ASSERT_EQUAL_UINT32( 0U, pxFile->ulDelayedLength );
+        TEST_ASSERT_EQUAL_UINT32( 1000U, pxFile->ulFileSize );
+
+        xError = FF_Close( pxFile );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+        prvColdCache( pxIOManager );
+        TEST_ASSERT_EQUAL_UINT32( 1000U, prvReadInPieces( pxIOManager, "/seek.bin", TEST_PIECE_SIZE, &ulInFlight ) );
+        TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, 1000U );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigDELAYED_ALLOCATION" );
+    #endif
+}
+
+/*
+ * FF_SetEof() writes the pending data before it truncates the file.  The
+ * file keeps the data up to the file pointer.
+ */
+void test_DelayedAllocation_SetEof( void )
+{
+    #if ( ffconfigDELAYED_ALLOCATION != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        FF_FILE * pxFile;
+        FF_Error_t xError;
+        uint32_t ulInFlight = 0U;
+
+        prvFillPattern( 2000U, 4U );
+
+        pxFile = FF_Open( pxIOManager, "/eof.bin", FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+        TEST_ASSERT_NOT_NULL( pxFile );
+        TEST_ASSERT_EQUAL_INT32( 2000, FF_Write( pxFile, 1, 2000U, ucWritten ) );
+        TEST_ASSERT_EQUAL_UINT32( 2000U, pxFile->ulDelayedLength );
+
+        xError = FF_SetEof( pxFile );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        TEST_ASSERT_EQUAL_UINT32( 0U, pxFile->ulDelayedLength );
+        TEST_ASSERT_EQUAL_UINT32( 2000U, pxFile->ulFileSize );
+
+        /* Now cut the file short. */
+        TEST_ASSERT_EQUAL_INT32( 0, FF_Seek( pxFile, 700, FF_SEEK_SET ) );
+        xError = FF_SetEof( pxFile );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        TEST_ASSERT_EQUAL_UINT32( 700U, pxFile->ulFileSize );
+
+        xError = FF_Close( pxFile );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+        prvColdCache( pxIOManager );
+        TEST_ASSERT_EQUAL_UINT32( 700U, prvReadInPieces( pxIOManager, "/eof.bin", TEST_PIECE_SIZE, &ulInFlight ) );
+        TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, 700U );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigDELAYED_ALLOCATION" );
+    #endif
+}
+
+/*
+ * When the buffer of the handle can not be allocated, the data is written at
+ * once, as without ffconfigDELAYED_ALLOCATION.
+ */
+void test_DelayedAllocation_writes_at_once_without_memory( void )
+{
+    #if ( ffconfigDELAYED_ALLOCATION != 0 ) && defined( TEST_MALLOC_CAN_FAIL ) && ( TEST_MALLOC_CAN_FAIL != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        FF_FILE * pxFile;
+        FF_Error_t xError;
+        uint32_t ulInFlight = 0U;
+
+        prvFillPattern( 300U, 5U );
+
+        pxFile = FF_Open( pxIOManager, "/nomem.bin", FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+        TEST_ASSERT_NOT_NULL( pxFile );
+
+        xTestMallocFails = pdTRUE;
+        TEST_ASSERT_EQUAL_INT32( 300, FF_Write( pxFile, 1, 300U, ucWritten ) );
+        xTestMallocFails = pdFALSE;
+
+        TEST_ASSERT_NULL( pxFile->pucDelayedData );
+        TEST_ASSERT_EQUAL_UINT32( 0U, pxFile->ulDelayedLength );
+        TEST_ASSERT_NOT_EQUAL( 0U, pxFile->ulObjectCluster );
+        TEST_ASSERT_EQUAL_UINT32( 300U, pxFile->ulFileSize );
+
+        xError = FF_Close( pxFile );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+        prvColdCache( pxIOManager );
+        TEST_ASSERT_EQUAL_UINT32( 300U, prvReadInPieces( pxIOManager, "/nomem.bin", TEST_PIECE_SIZE, &ulInFlight ) );
+        TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, 300U );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigDELAYED_ALLOCATION and TEST_MALLOC_CAN_FAIL" );
+    #endif
+}
+
+/*
+ * FF_Close() writes the data that is still pending, and FF_FlushFile() does
+ * so without closing the handle.
+ */
+void test_DelayedAllocation_close_and_flush_write_pending_data( void )
+{
+    #if ( ffconfigDELAYED_ALLOCATION != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        FF_FILE * pxFile;
+        FF_Error_t xError;
+        uint32_t ulInFlight = 0U;
+        uint32_t ulLBA;
+
+        prvFillPattern( 1500U, 6U );
+
+        pxFile = FF_Open( pxIOManager, "/close.bin", FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+        TEST_ASSERT_NOT_NULL( pxFile );
+        TEST_ASSERT_EQUAL_INT32( 1000, FF_Write( pxFile, 1, 1000U, ucWritten ) );
+        TEST_ASSERT_EQUAL_UINT32( 1000U, pxFile->ulDelayedLength );
+
+        /* After FF_FlushFile() the data is on the disk. */
+        xError = FF_FlushFile( pxFile );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        TEST_ASSERT_EQUAL_UINT32( 0U, pxFile->ulDelayedLength );
+        TEST_ASSERT_NOT_EQUAL( 0U, pxFile->ulObjectCluster );
+
+        ulLBA = FF_getRealLBA( pxIOManager, FF_Cluster2LBA( pxIOManager, pxFile->ulObjectCluster ) );
+        TEST_ASSERT_EQUAL_MEMORY( ucWritten, &( pucTestDiskMemory[ ulLBA * testDISK_SECTOR_SIZE ] ), 1000U );
+
+        /* Close with more data pending. */
+        TEST_ASSERT_EQUAL_INT32( 500, FF_Write( pxFile, 1, 500U, &( ucWritten[ 1000 ] ) ) );
+        TEST_ASSERT_EQUAL_UINT32( 500U, pxFile->ulDelayedLength );
+
+        xError = FF_Close( pxFile );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+        prvColdCache( pxIOManager );
+        TEST_ASSERT_EQUAL_UINT32( 1500U, prvReadInPieces( pxIOManager, "/close.bin", TEST_PIECE_SIZE, &ulInFlight ) );
+        TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, 1500U );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigDELAYED_ALLOCATION" );
+    #endif
+}
+
+/*
+ * When the volume fills up while FF_Close() writes the pending data, the
+ * error is returned, the clusters that were claimed for the lost part are
+ * freed, and the directory entry shows what was written.
+ */
+void test_DelayedAllocation_close_on_a_full_volume( void )
+{
+    #if ( ffconfigDELAYED_ALLOCATION != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        FF_FILE * pxFile;
+        FF_DirEnt_t xDirEntry;
+        FF_Error_t xError;
+        uint32_t ulClusterSize, ulFree;
+
+        ulClusterSize = pxIOManager->xPartition.usBlkSize * pxIOManager->xPartition.ulSectorsPerCluster;
+        prvFillPattern( ffconfigDELAYED_ALLOCATION, 7U );
+
+        /* Leave one free cluster, which the new file takes.  The file that
+         * fills the volume already has one cluster. */
+        TEST_ASSERT_GREATER_THAN_UINT32( ulClusterSize, ffconfigDELAYED_ALLOCATION );
+        pxFile = FF_Open( pxIOManager, "/fill.bin", FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+        TEST_ASSERT_NOT_NULL( pxFile );
+        xError = FF_Preallocate( pxFile, prvFreeClusters( pxIOManager ) * ulClusterSize, pdFALSE );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        xError = FF_Close( pxFile );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        ulFree = prvFreeClusters( pxIOManager );
+        TEST_ASSERT_EQUAL_UINT32( 1U, ulFree );
+
+        pxFile = FF_Open( pxIOManager, "/full.bin", FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+        TEST_ASSERT_NOT_NULL( pxFile );
+        TEST_ASSERT_EQUAL_INT32( ffconfigDELAYED_ALLOCATION, FF_Write( pxFile, 1, ffconfigDELAYED_ALLOCATION, ucWritten ) );
+        TEST_ASSERT_EQUAL_UINT32( 0U, prvFreeClusters( pxIOManager ) );
+
+        xError = FF_Close( pxFile );
+        TEST_ASSERT_EQUAL_INT( FF_ERR_FAT_NO_FREE_CLUSTERS, FF_GETERROR( xError ) );
+
+        /* Nothing was written, and the cluster of the file is free again. */
+        TEST_ASSERT_EQUAL_UINT32( ulFree, prvFreeClusters( pxIOManager ) );
+        memset( &xDirEntry, 0, sizeof( xDirEntry ) );
+        xError = FF_FindFirst( pxIOManager, &xDirEntry, "/" );
+
+        while( ( FF_isERR( xError ) == pdFALSE ) && ( strcmp( xDirEntry.pcFileName, "full.bin" ) != 0 ) )
+        {
+            xError = FF_FindNext( pxIOManager, &xDirEntry );
+        }
+
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        TEST_ASSERT_EQUAL_UINT32( 0U, xDirEntry.ulFileSize );
+        TEST_ASSERT_EQUAL_UINT32( 0U, xDirEntry.ulObjectCluster );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigDELAYED_ALLOCATION" );
+    #endif
+}
+
+/*
+ * Read a file of 1 MB in pieces of 64 bytes from a cold cache, and print the
+ * best throughput of a few rounds.  With an asynchronous driver, the same is
+ * done without fnSubmitBlocks() to compare.
+ */
+void test_SmallRead_Benchmark( void )
+{
+    #if ( TEST_RUN_BENCHMARKS != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        uint32_t ulRound, ulMode, ulModes = 1U;
+        uint32_t ulInFlight = 0U, ulBytes = 0U, ulCalls = 0U;
+        clock_t xStart;
+        double dBest, dTime;
+
+        prvWriteFile( pxIOManager, "/bench.bin", TEST_BENCH_SIZE, 7U );
+
+        #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+            ulModes = 2U;
+        #endif
+
+        for( ulMode = 0; ulMode < ulModes; ulMode++ )
+        {
+            #if ( ffconfigASYNC_BLOCK_DEVICE != 0 )
+            {
+                pxIOManager->xBlkDevice.fnpSubmitBlocks = ( ulMode == 0U ) ? prvSubmitBlocks : NULL;
+            }
+            #endif
+
+            dBest = 1e9;
+
+            for( ulRound = 0; ulRound < TEST_BENCH_ROUNDS; ulRound++ )
+            {
+                prvColdCache( pxIOManager );
+                memset( ucRead, 0, sizeof( ucRead ) );
+
+                xStart = clock();
+                ulBytes = prvReadInPieces( pxIOManager, "/bench.bin", TEST_BENCH_PIECE, &ulInFlight );
+                dTime = ( double ) ( clock() - xStart ) / CLOCKS_PER_SEC;
+                ulCalls = ulTestDiskReadCalls;
+
+                if( dTime < dBest )
+                {
+                    dBest = dTime;
+                }
+
+                TEST_ASSERT_EQUAL_UINT32( TEST_BENCH_SIZE, ulBytes );
+                TEST_ASSERT_EQUAL_MEMORY( ucWritten, ucRead, TEST_BENCH_SIZE );
+            }
+
+            printf( "Reading 1 MB in %u-byte pieces (read-ahead %u%s): %.2f ms, %.1f MB/s, %u driver reads\n",
+                    ( unsigned ) TEST_BENCH_PIECE, ( unsigned ) ffconfigREAD_AHEAD_SECTORS,
+                    ( ulModes == 1U ) ? "" : ( ( ulMode == 0U ) ? ", submitted" : ", synchronous" ),
+                    dBest * 1e3, ( ( double ) ulBytes / ( 1024.0 * 1024.0 ) ) / dBest, ( unsigned ) ulCalls );
+        }
+    #else
+        TEST_IGNORE_MESSAGE( "Configure with -DFAT_UNIT_TEST_BENCHMARKS=ON to run the benchmarks" );
+    #endif
+}
+/*-----------------------------------------------------------*/
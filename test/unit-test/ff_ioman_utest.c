@@ -16,7 +16,9 @@
  */
 
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 #include "unity.h"
 
@@ -35,6 +37,15 @@
 #define TEST_SECTOR_SIZE      ( 512U )
 #define TEST_DISK_SECTORS     ( 256U )
 #define TEST_CACHE_SECTORS    ( 8U )
+#define TEST_HIT_ROUNDS       ( 1000000U )
+
+/* The traces replayed by test_GetBuffer_trace_hit_rate_Benchmark(). */
+#define TEST_TRACE_CACHE      ( 32U )
+#define TEST_TRACE_HOT        ( 24U ) /* Sectors 0..23 are used all the time. */
+#define TEST_TRACE_LENGTH     ( 8000U )
+
+/* The hits of both traces in the ff_ioman_utest build, the baseline. */
+#define TEST_TRACE_BASELINE_HITS    { 3996U, 5338U }
 
 /* Partition-table byte offsets within an MBR/EBR entry. */
 #define PTBL_BASE             ( 0x1BEU )
@@ -42,6 +53,12 @@
 
 static uint8_t ucVirtualDisk[ TEST_DISK_SECTORS * TEST_SECTOR_SIZE ];
 
+/* Number of sectors read from the virtual disk since the last setUp(). */
+static uint32_t ulSectorsRead;
+
+/* Number of calls to prvWriteBlocks() since the last setUp(). */
+static uint32_t ulWriteCalls;
+
 static int32_t prvReadBlocks( uint8_t * pucBuffer,
                               uint32_t ulSectorAddress,
                               uint32_t ulCount,
@@ -57,6 +74,7 @@ static int32_t prvReadBlocks( uint8_t * pucBuffer,
     memcpy( pucBuffer,
             &ucVirtualDisk[ ulSectorAddress * TEST_SECTOR_SIZE ],
             ulCount * TEST_SECTOR_SIZE );
+    ulSectorsRead += ulCount;
 
     return ( int32_t ) ulCount;
 }
@@ -66,11 +84,18 @@ static int32_t prvWriteBlocks( uint8_t * pucBuffer,
                                uint32_t ulCount,
                                FF_Disk_t * pxDisk )
 {
-    ( void ) pucBuffer;
-    ( void ) ulSectorAddress;
     ( void ) pxDisk;
 
-    /* The partition-search path is read-only. */
+    if( ( ulSectorAddress + ulCount ) > TEST_DISK_SECTORS )
+    {
+        return -1;
+    }
+
+    memcpy( &ucVirtualDisk[ ulSectorAddress * TEST_SECTOR_SIZE ],
+            pucBuffer,
+            ulCount * TEST_SECTOR_SIZE );
+    ulWriteCalls++;
+
     return ( int32_t ) ulCount;
 }
 
@@ -119,13 +144,13 @@ static uint8_t * prvSector( uint32_t ulSectorNr )
 /* I/O manager lifecycle for a single test.                   */
 /*-----------------------------------------------------------*/
 
-static FF_IOManager_t * prvCreateTestIOManager( void )
+static FF_IOManager_t * prvCreateSizedIOManager( uint32_t ulCacheSectors )
 {
     FF_CreationParameters_t xParameters;
     FF_Error_t xError = FF_ERR_NONE;
 
     memset( &xParameters, 0, sizeof( xParameters ) );
-    xParameters.ulMemorySize = TEST_CACHE_SECTORS * TEST_SECTOR_SIZE;
+    xParameters.ulMemorySize = ulCacheSectors * TEST_SECTOR_SIZE;
     xParameters.ulSectorSize = TEST_SECTOR_SIZE;
     xParameters.fnReadBlocks = prvReadBlocks;
     xParameters.fnWriteBlocks = prvWriteBlocks;
@@ -136,6 +161,11 @@ static FF_IOManager_t * prvCreateTestIOManager( void )
     return FF_CreateIOManager( &xParameters, &xError );
 }
 
+static FF_IOManager_t * prvCreateTestIOManager( void )
+{
+    return prvCreateSizedIOManager( TEST_CACHE_SECTORS );
+}
+
 /*
  * Build an MBR (sector 0) whose first entry is an extended partition, and a
  * forward-linked EBR chain. Each EBR defines one logical (data) partition and,
@@ -242,6 +272,8 @@ static int prvGuardIntact( const GuardedPartsFound_t * pxGuarded )
 void setUp( void )
 {
     memset( ucVirtualDisk, 0, sizeof( ucVirtualDisk ) );
+    ulSectorsRead = 0U;
+    ulWriteCalls = 0U;
 
     /* The locking layer is irrelevant to partition parsing: let every call
      * pass through. FF_CreateEvents must report success so the I/O manager is
@@ -593,3 +625,615 @@ void test_CreateIOManager_accepts_4096_byte_sector( void )
 
     ( void ) FF_DeleteIOManager( pxIOManager );
 }
+
+/*-----------------------------------------------------------*/
+/* Sector cache in FF_GetBuffer().                            */
+/*-----------------------------------------------------------*/
+
+/*
+ * A sector that is still cached must be returned from the cache, without
+ * another read from the disk.
+ */
+void test_GetBuffer_cached_sector_is_not_read_again( void )
+{
+    FF_IOManager_t * pxIOManager;
+    FF_Buffer_t * pxFirst;
+    FF_Buffer_t * pxSecond;
+
+    pxIOManager = prvCreateTestIOManager();
+    TEST_ASSERT_NOT_NULL( pxIOManager );
+
+    pxFirst = FF_GetBuffer( pxIOManager, 10U, FF_MODE_READ );
+    TEST_ASSERT_NOT_NULL( pxFirst );
+    ( void ) FF_ReleaseBuffer( pxIOManager, pxFirst );
+
+    pxSecond = FF_GetBuffer( pxIOManager, 10U, FF_MODE_READ );
+    TEST_ASSERT_EQUAL_PTR( pxFirst, pxSecond );
+    TEST_ASSERT_EQUAL_UINT32( 1U, ulSectorsRead );
+    ( void ) FF_ReleaseBuffer( pxIOManager, pxSecond );
+
+    ( void ) FF_DeleteIOManager( pxIOManager );
+}
+
+/*
+ * With ffconfigBUFFER_HASH_INDEX, a full cache recycles the least recently
+ * used buffer without handles: a recently used sector must survive, and a
+ * buffer that is still held may never be taken.
+ */
+void test_GetBuffer_recycles_least_recently_used_buffer( void )
+{
+    #if ( ffconfigBUFFER_HASH_INDEX != 0 )
+        FF_IOManager_t * pxIOManager;
+        FF_Buffer_t * pxHeld;
+        FF_Buffer_t * pxBuffer;
+        uint32_t ulSector;
+
+        #if ( ffconfigCACHE_2Q != 0 )
+        {
+            /* 2Q recycles the sectors that were used only once first. */
+            TEST_IGNORE_MESSAGE( "Plain LRU only" );
+        }
+        #endif
+
+        pxIOManager = prvCreateTestIOManager();
+        TEST_ASSERT_NOT_NULL( pxIOManager );
+
+        /* Sector 20 stays held, sectors 21..27 fill the rest of the cache. */
+        pxHeld = FF_GetBuffer( pxIOManager, 20U, FF_MODE_READ );
+        TEST_ASSERT_NOT_NULL( pxHeld );
+
+        for( ulSector = 21U; ulSector < 20U + TEST_CACHE_SECTORS; ulSector++ )
+        {
+            pxBuffer = FF_GetBuffer( pxIOManager, ulSector, FF_MODE_READ );
+            TEST_ASSERT_NOT_NULL( pxBuffer );
+            ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+        }
+
+        /* Use sector 21 again, so 22 becomes the least recently used. */
+        pxBuffer = FF_GetBuffer( pxIOManager, 21U, FF_MODE_READ );
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+        TEST_ASSERT_EQUAL_UINT32( TEST_CACHE_SECTORS, ulSectorsRead );
+
+        /* A new sector takes the place of sector 22. */
+        pxBuffer = FF_GetBuffer( pxIOManager, 40U, FF_MODE_READ );
+        TEST_ASSERT_NOT_NULL( pxBuffer );
+        TEST_ASSERT_TRUE( pxBuffer != pxHeld );
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+        TEST_ASSERT_EQUAL_UINT32( TEST_CACHE_SECTORS + 1U, ulSectorsRead );
+
+        /* Sectors 20 and 21 are still cached, 22 must be read again. */
+        pxBuffer = FF_GetBuffer( pxIOManager, 21U, FF_MODE_READ );
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+        pxBuffer = FF_GetBuffer( pxIOManager, 20U, FF_MODE_READ );
+        TEST_ASSERT_EQUAL_PTR( pxHeld, pxBuffer );
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+        TEST_ASSERT_EQUAL_UINT32( TEST_CACHE_SECTORS + 1U, ulSectorsRead );
+
+        pxBuffer = FF_GetBuffer( pxIOManager, 22U, FF_MODE_READ );
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+        TEST_ASSERT_EQUAL_UINT32( TEST_CACHE_SECTORS + 2U, ulSectorsRead );
+
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxHeld );
+        ( void ) FF_DeleteIOManager( pxIOManager );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigBUFFER_HASH_INDEX" );
+    #endif
+}
+
+/* Read 'ulCount' sectors from 'ulFirst' on, and release them. */
+static void prvReadSectors( FF_IOManager_t * pxIOManager,
+                            uint32_t ulFirst,
+                            uint32_t ulCount )
+{
+    FF_Buffer_t * pxBuffer;
+    uint32_t ulSector;
+
+    for( ulSector = ulFirst; ulSector < ( ulFirst + ulCount ); ulSector++ )
+    {
+        pxBuffer = FF_GetBuffer( pxIOManager, ulSector, FF_MODE_READ );
+        TEST_ASSERT_NOT_NULL( pxBuffer );
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+    }
+}
+
+/*
+ * With ffconfigCACHE_2Q, a sector that is read again shortly after it left
+ * the FIFO queue is found among the remembered sectors, and enters the main
+ * list, where a file that is read once does not push it out.  Once more
+ * sectors have left the FIFO queue than are remembered, the sector is
+ * forgotten and it is treated as new again.
+ */
+void test_GetBuffer_2Q_keeps_a_sector_that_is_used_again( void )
+{
+    #if ( ffconfigCACHE_2Q != 0 )
+        FF_IOManager_t * pxIOManager;
+        uint32_t ulGhostCount;
+
+        pxIOManager = prvCreateTestIOManager();
+        TEST_ASSERT_NOT_NULL( pxIOManager );
+        ulGhostCount = pxIOManager->usGhostCount;
+
+        /* Sector 100 leaves the FIFO queue, and is read again. */
+        prvReadSectors( pxIOManager, 100U, TEST_CACHE_SECTORS + 1U );
+        prvReadSectors( pxIOManager, 100U, 1U );
+        TEST_ASSERT_EQUAL_UINT32( TEST_CACHE_SECTORS + 2U, ulSectorsRead );
+
+        /* A file passes through the FIFO queue, sector 100 stays cached. */
+        prvReadSectors( pxIOManager, 200U, 4U * TEST_CACHE_SECTORS );
+        ulSectorsRead = 0U;
+        prvReadSectors( pxIOManager, 100U, 1U );
+        TEST_ASSERT_EQUAL_UINT32( 0U, ulSectorsRead );
+
+        /* Sector 150 leaves the FIFO queue, followed by more sectors than
+         * are remembered. */
+        prvReadSectors( pxIOManager, 150U, TEST_CACHE_SECTORS );
+        prvReadSectors( pxIOManager, 160U, ulGhostCount + TEST_CACHE_SECTORS );
+
+        /* It is read as a new sector, and a file pushes it out again. */
+        ulSectorsRead = 0U;
+        prvReadSectors( pxIOManager, 150U, 1U );
+        prvReadSectors( pxIOManager, 200U, 4U * TEST_CACHE_SECTORS );
+        prvReadSectors( pxIOManager, 150U, 1U );
+        TEST_ASSERT_EQUAL_UINT32( 2U + ( 4U * TEST_CACHE_SECTORS ), ulSectorsRead );
+
+        /* Sector 100 is still cached. */
+        ulSectorsRead = 0U;
+        prvReadSectors( pxIOManager, 100U, 1U );
+        TEST_ASSERT_EQUAL_UINT32( 0U, ulSectorsRead );
+
+        ( void ) FF_DeleteIOManager( pxIOManager );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigCACHE_2Q" );
+    #endif
+}
+
+/*
+ * A request that conflicts with a held buffer waits in a slot of its own,
+ * and gives the slot back when FF_GetBuffer() gives up.
+ */
+void test_GetBuffer_conflicting_request_gives_back_wait_slot( void )
+{
+    FF_IOManager_t * pxIOManager;
+    FF_Buffer_t * pxWriter;
+    FF_Buffer_t * pxReader;
+
+    pxIOManager = prvCreateTestIOManager();
+    TEST_ASSERT_NOT_NULL( pxIOManager );
+
+    pxWriter = FF_GetBuffer( pxIOManager, 30U, FF_MODE_WRITE );
+    TEST_ASSERT_NOT_NULL( pxWriter );
+
+    /* FF_BufferWait() returns at once, so this only spins until the timeout. */
+    pxReader = FF_GetBuffer( pxIOManager, 30U, FF_MODE_READ );
+    TEST_ASSERT_NULL( pxReader );
+    TEST_ASSERT_EQUAL_UINT8( 0U, pxIOManager->ucBufferWaitSlots );
+    TEST_ASSERT_EQUAL_UINT8( 0U, pxIOManager->ucBufferWaitOthers );
+
+    ( void ) FF_ReleaseBuffer( pxIOManager, pxWriter );
+
+    /* Once released, the sector is shared by readers again. */
+    pxReader = FF_GetBuffer( pxIOManager, 30U, FF_MODE_READ );
+    TEST_ASSERT_EQUAL_PTR( pxWriter, pxReader );
+    ( void ) FF_ReleaseBuffer( pxIOManager, pxReader );
+
+    ( void ) FF_DeleteIOManager( pxIOManager );
+}
+
+/*
+ * With ffconfigCACHE_POOLS, reading a lot of file data may not evict a FAT
+ * sector from its own pool.
+ */
+void test_GetBuffer_file_data_does_not_evict_FAT_pool( void )
+{
+    #if ( ffconfigCACHE_POOLS != 0 )
+        FF_CreationParameters_t xParameters;
+        FF_Error_t xError = FF_ERR_NONE;
+        FF_IOManager_t * pxIOManager;
+        FF_Buffer_t * pxBuffer;
+        uint32_t ulSector;
+
+        memset( &xParameters, 0, sizeof( xParameters ) );
+        xParameters.ulMemorySize = TEST_CACHE_SECTORS * TEST_SECTOR_SIZE;
+        xParameters.ulSectorSize = TEST_SECTOR_SIZE;
+        xParameters.ulFATMemorySize = 2U * TEST_SECTOR_SIZE;
+        xParameters.fnReadBlocks = prvReadBlocks;
+        xParameters.fnWriteBlocks = prvWriteBlocks;
+        xParameters.xBlockDeviceIsReentrant = pdTRUE;
+
+        pxIOManager = FF_CreateIOManager( &xParameters, &xError );
+        TEST_ASSERT_NOT_NULL( pxIOManager );
+        TEST_ASSERT_EQUAL_UINT16( 2U, pxIOManager->xPools[ FF_CACHE_POOL_FAT ].usCount );
+        TEST_ASSERT_EQUAL_UINT16( TEST_CACHE_SECTORS - 2U, pxIOManager->xPools[ FF_CACHE_POOL_DATA ].usCount );
+
+        /* A FAT of 4 sectors starts at sector 4. */
+        pxIOManager->xPartition.ulFATBeginLBA = 4U;
+        pxIOManager->xPartition.ulSectorsPerFAT = 4U;
+        pxIOManager->xPartition.ucNumFATS = 1U;
+
+        pxBuffer = FF_GetBuffer( pxIOManager, 5U, FF_MODE_READ );
+        TEST_ASSERT_NOT_NULL( pxBuffer );
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+
+        for( ulSector = 100U; ulSector < 100U + ( 4U * TEST_CACHE_SECTORS ); ulSector++ )
+        {
+            pxBuffer = FF_GetBuffer( pxIOManager, ulSector, FF_MODE_READ | FF_MODE_FILE_DATA );
+            TEST_ASSERT_NOT_NULL( pxBuffer );
+            ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+        }
+
+        TEST_ASSERT_EQUAL_UINT32( 1U + ( 4U * TEST_CACHE_SECTORS ), ulSectorsRead );
+
+        pxBuffer = FF_GetBuffer( pxIOManager, 5U, FF_MODE_READ );
+        TEST_ASSERT_NOT_NULL( pxBuffer );
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+
+        TEST_ASSERT_EQUAL_UINT32( 1U + ( 4U * TEST_CACHE_SECTORS ), ulSectorsRead );
+        TEST_ASSERT_EQUAL_UINT32( 1U, pxIOManager->xPools[ FF_CACHE_POOL_FAT ].ulHits );
+        TEST_ASSERT_EQUAL_UINT32( 1U, pxIOManager->xPools[ FF_CACHE_POOL_FAT ].ulMisses );
+        TEST_ASSERT_EQUAL_UINT32( 4U * TEST_CACHE_SECTORS, pxIOManager->xPools[ FF_CACHE_POOL_DATA ].ulMisses );
+
+        ( void ) FF_DeleteIOManager( pxIOManager );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigCACHE_POOLS" );
+    #endif
+}
+
+/*
+ * FF_FlushCache() must write a run of adjacent modified sectors with a single
+ * call to the driver, no matter where the buffers are in the cache memory.
+ */
+void test_FlushCache_merges_adjacent_sectors( void )
+{
+    #if ( ffconfigFLUSH_MERGE_SECTORS > 1 )
+        FF_IOManager_t * pxIOManager;
+        FF_Buffer_t * pxBuffer;
+        FF_Error_t xError;
+        /* Sector 52 is claimed first, so the buffers are not in sector order. */
+        const uint32_t ulSectors[] = { 52U, 50U, 51U, 60U };
+        uint32_t ulIndex;
+
+        pxIOManager = prvCreateTestIOManager();
+        TEST_ASSERT_NOT_NULL( pxIOManager );
+
+        for( ulIndex = 0U; ulIndex < ( sizeof( ulSectors ) / sizeof( ulSectors[ 0 ] ) ); ulIndex++ )
+        {
+            pxBuffer = FF_GetBuffer( pxIOManager, ulSectors[ ulIndex ], FF_MODE_WRITE );
+            TEST_ASSERT_NOT_NULL( pxBuffer );
+            memset( pxBuffer->pucBuffer, ( int ) ulSectors[ ulIndex ], TEST_SECTOR_SIZE );
+            ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+        }
+
+        xError = FF_FlushCache( pxIOManager );
+
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        TEST_ASSERT_EQUAL_UINT32( 2U, ulWriteCalls );
+        TEST_ASSERT_EQUAL_UINT32( 2U, pxIOManager->ulFlushMergeCount );
+
+        for( ulIndex = 0U; ulIndex < ( sizeof( ulSectors ) / sizeof( ulSectors[ 0 ] ) ); ulIndex++ )
+        {
+            TEST_ASSERT_EQUAL_HEX8( ( uint8_t ) ulSectors[ ulIndex ], prvSector( ulSectors[ ulIndex ] )[ 0 ] );
+            TEST_ASSERT_EQUAL_HEX8( ( uint8_t ) ulSectors[ ulIndex ], prvSector( ulSectors[ ulIndex ] )[ TEST_SECTOR_SIZE - 1U ] );
+        }
+
+        /* Nothing is left to be written. */
+        xError = FF_FlushCache( pxIOManager );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        TEST_ASSERT_EQUAL_UINT32( 2U, ulWriteCalls );
+
+        ( void ) FF_DeleteIOManager( pxIOManager );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigFLUSH_MERGE_SECTORS" );
+    #endif
+}
+
+/*
+ * FF_FlushBuffers() writes the modified sectors within the range only, and
+ * FF_DiscardBuffers() drops a modified sector without writing it.
+ */
+void test_FlushBuffers_and_DiscardBuffers_use_the_range( void )
+{
+    FF_IOManager_t * pxIOManager;
+    FF_Buffer_t * pxBuffer;
+    FF_Error_t xError;
+    const uint32_t ulSectors[] = { 50U, 51U, 60U, 61U };
+    uint32_t ulIndex;
+
+    pxIOManager = prvCreateTestIOManager();
+    TEST_ASSERT_NOT_NULL( pxIOManager );
+
+    for( ulIndex = 0U; ulIndex < ( sizeof( ulSectors ) / sizeof( ulSectors[ 0 ] ) ); ulIndex++ )
+    {
+        pxBuffer = FF_GetBuffer( pxIOManager, ulSectors[ ulIndex ], FF_MODE_WRITE );
+        TEST_ASSERT_NOT_NULL( pxBuffer );
+        memset( pxBuffer->pucBuffer, ( int ) ulSectors[ ulIndex ], TEST_SECTOR_SIZE );
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+    }
+
+    xError = FF_FlushBuffers( pxIOManager, 49U, 3U );
+
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    TEST_ASSERT_EQUAL_UINT32( 2U, ulWriteCalls );
+    TEST_ASSERT_EQUAL_HEX8( 50U, prvSector( 50U )[ 0 ] );
+    TEST_ASSERT_EQUAL_HEX8( 51U, prvSector( 51U )[ 0 ] );
+    TEST_ASSERT_EQUAL_HEX8( 0U, prvSector( 60U )[ 0 ] );
+
+    FF_DiscardBuffers( pxIOManager, 61U, 1U );
+
+    /* Only sector 60 is left to be written. */
+    xError = FF_FlushCache( pxIOManager );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    TEST_ASSERT_EQUAL_UINT32( 3U, ulWriteCalls );
+    TEST_ASSERT_EQUAL_HEX8( 60U, prvSector( 60U )[ 0 ] );
+    TEST_ASSERT_EQUAL_HEX8( 0U, prvSector( 61U )[ 0 ] );
+
+    ( void ) FF_DeleteIOManager( pxIOManager );
+}
+
+/*
+ * A sector that is written directly while its buffer is held gets a new
+ * buffer when it is requested again.  The held buffer is dropped when it is
+ * released, it is not written even though it was modified.
+ */
+void test_DiscardBuffers_drops_held_buffer_on_release( void )
+{
+    FF_IOManager_t * pxIOManager;
+    FF_Buffer_t * pxHeld;
+    FF_Buffer_t * pxBuffer;
+    FF_Error_t xError;
+
+    pxIOManager = prvCreateTestIOManager();
+    TEST_ASSERT_NOT_NULL( pxIOManager );
+
+    pxHeld = FF_GetBuffer( pxIOManager, 70U, FF_MODE_WRITE );
+    TEST_ASSERT_NOT_NULL( pxHeld );
+    memset( pxHeld->pucBuffer, 0x77, TEST_SECTOR_SIZE );
+
+    /* Sector 70 is written around the cache. */
+    FF_DiscardBuffers( pxIOManager, 70U, 1U );
+    memset( prvSector( 70U ), 0x42, TEST_SECTOR_SIZE );
+
+    pxBuffer = FF_GetBuffer( pxIOManager, 70U, FF_MODE_READ );
+    TEST_ASSERT_NOT_NULL( pxBuffer );
+    TEST_ASSERT_TRUE( pxBuffer != pxHeld );
+    TEST_ASSERT_EQUAL_HEX8( 0x42U, pxBuffer->pucBuffer[ 0 ] );
+    TEST_ASSERT_EQUAL_UINT32( 2U, ulSectorsRead );
+    ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+
+    ( void ) FF_ReleaseBuffer( pxIOManager, pxHeld );
+    TEST_ASSERT_FALSE( pxHeld->bDiscard );
+
+    xError = FF_FlushCache( pxIOManager );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    TEST_ASSERT_EQUAL_UINT32( 0U, ulWriteCalls );
+    TEST_ASSERT_EQUAL_HEX8( 0x42U, prvSector( 70U )[ 0 ] );
+
+    /* A range larger than the cache is handled without the hash index. */
+    FF_DiscardBuffers( pxIOManager, 0U, TEST_DISK_SECTORS );
+
+    pxBuffer = FF_GetBuffer( pxIOManager, 70U, FF_MODE_READ );
+    TEST_ASSERT_NOT_NULL( pxBuffer );
+    TEST_ASSERT_EQUAL_UINT32( 3U, ulSectorsRead );
+    ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+
+    ( void ) FF_DeleteIOManager( pxIOManager );
+}
+
+/*
+ * FF_DirBlockRead() takes the cached copy of a sector when there is one, and
+ * stops at a sector that is held in write mode.  A sector that changes is
+ * dropped from the directory block, together with the sectors after it.
+ */
+void test_DirBlockRead_is_coherent_with_the_cache( void )
+{
+    #if ( ffconfigDIRECTORY_READ_SECTORS > 1 )
+        FF_IOManager_t * pxIOManager;
+        FF_Buffer_t * pxBuffer;
+        int32_t lResult;
+        uint32_t ulIndex;
+
+        for( ulIndex = 0U; ulIndex < 6U; ulIndex++ )
+        {
+            memset( prvSector( 40U + ulIndex ), ( int ) ( 0xA0U + ulIndex ), TEST_SECTOR_SIZE );
+        }
+
+        pxIOManager = prvCreateTestIOManager();
+        TEST_ASSERT_NOT_NULL( pxIOManager );
+
+        /* Sector 41 is changed in the cache only. */
+        pxBuffer = FF_GetBuffer( pxIOManager, 41U, FF_MODE_WRITE );
+        TEST_ASSERT_NOT_NULL( pxBuffer );
+        memset( pxBuffer->pucBuffer, 0x11, TEST_SECTOR_SIZE );
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+        ulSectorsRead = 0U;
+
+        /* At most ffconfigDIRECTORY_READ_SECTORS are read. */
+        lResult = FF_DirBlockRead( pxIOManager, 40U, 6U );
+
+        TEST_ASSERT_EQUAL_INT32( 4, lResult );
+        TEST_ASSERT_EQUAL_UINT32( 4U, ulSectorsRead );
+        TEST_ASSERT_EQUAL_UINT32( 40U, pxIOManager->ulDirBlockSector );
+        TEST_ASSERT_EQUAL_UINT32( 4U, pxIOManager->ulDirBlockCount );
+        TEST_ASSERT_EQUAL_HEX8( 0xA0U, pxIOManager->pucDirBlockMem[ 0 ] );
+        TEST_ASSERT_EQUAL_HEX8( 0x11U, pxIOManager->pucDirBlockMem[ TEST_SECTOR_SIZE ] );
+        TEST_ASSERT_EQUAL_HEX8( 0xA3U, pxIOManager->pucDirBlockMem[ ( 4U * TEST_SECTOR_SIZE ) - 1U ] );
+
+        /* Sector 42 is about to change, while it is held it won't be read. */
+        pxBuffer = FF_GetBuffer( pxIOManager, 42U, FF_MODE_WRITE );
+        TEST_ASSERT_NOT_NULL( pxBuffer );
+        TEST_ASSERT_EQUAL_UINT32( 2U, pxIOManager->ulDirBlockCount );
+
+        lResult = FF_DirBlockRead( pxIOManager, 40U, 4U );
+        TEST_ASSERT_EQUAL_INT32( 2, lResult );
+
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+
+        /* A direct write to the disk drops the block from that sector onward. */
+        lResult = FF_BlockWrite( pxIOManager, 40U, 1U, prvSector( 50U ), pdFALSE );
+        TEST_ASSERT_EQUAL_INT32( 1, lResult );
+        TEST_ASSERT_EQUAL_UINT32( 0U, pxIOManager->ulDirBlockCount );
+
+        ( void ) FF_DeleteIOManager( pxIOManager );
+    #else
+        TEST_IGNORE_MESSAGE( "Needs ffconfigDIRECTORY_READ_SECTORS" );
+    #endif
+}
+
+/*
+ * Benchmark: the time of a cache hit, FF_GetBuffer() followed by
+ * FF_ReleaseBuffer(), in caches of 8 up to 256 buffers.  With
+ * ffconfigBUFFER_HASH_INDEX the time should stay the same when the cache
+ * grows.  The times are printed, the test checks that every sector was read
+ * from the disk only once, so that all the timed requests were hits.
+ */
+void test_GetBuffer_hit_latency_Benchmark( void )
+{
+    #if ( TEST_RUN_BENCHMARKS != 0 )
+        const uint32_t ulCacheSizes[] = { 8U, 32U, 128U, TEST_DISK_SECTORS };
+        FF_IOManager_t * pxIOManager;
+        FF_Buffer_t * pxBuffer;
+        uint32_t ulIndex, ulSector, ulRound, ulCacheSize;
+        clock_t xStart;
+        double dTime;
+
+        for( ulIndex = 0U; ulIndex < ( sizeof( ulCacheSizes ) / sizeof( ulCacheSizes[ 0 ] ) ); ulIndex++ )
+        {
+            ulCacheSize = ulCacheSizes[ ulIndex ];
+            pxIOManager = prvCreateSizedIOManager( ulCacheSize );
+            TEST_ASSERT_NOT_NULL( pxIOManager );
+            ulSectorsRead = 0U;
+
+            /* Fill the cache. */
+            for( ulSector = 0U; ulSector < ulCacheSize; ulSector++ )
+            {
+                pxBuffer = FF_GetBuffer( pxIOManager, ulSector, FF_MODE_READ );
+                TEST_ASSERT_NOT_NULL( pxBuffer );
+                ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+            }
+
+            xStart = clock();
+
+            for( ulRound = 0U; ulRound < TEST_HIT_ROUNDS; ulRound++ )
+            {
+                /* 37 has no factor in common with the cache sizes, all the
+                 * sectors are visited in a scattered order. */
+                pxBuffer = FF_GetBuffer( pxIOManager, ( ulRound * 37U ) % ulCacheSize, FF_MODE_READ );
+                ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+            }
+
+            dTime = ( double ) ( clock() - xStart ) / CLOCKS_PER_SEC;
+
+            printf( "FF_GetBuffer hit, %3u buffers: %.1f ns\n",
+                    ( unsigned ) ulCacheSize, ( dTime * 1e9 ) / TEST_HIT_ROUNDS );
+
+            TEST_ASSERT_EQUAL_UINT32( ulCacheSize, ulSectorsRead );
+
+            ( void ) FF_DeleteIOManager( pxIOManager );
+        }
+    #else
+        TEST_IGNORE_MESSAGE( "Configure with -DFAT_UNIT_TEST_BENCHMARKS=ON to run the benchmarks" );
+    #endif
+}
+
+
+/* Replay a trace of TEST_TRACE_LENGTH requests on a cache of
+ * TEST_TRACE_CACHE buffers: 'ulHotUses' random uses of the hot sectors, then
+ * 'ulScanRun' sectors of a file that is read once, and so on.  Return the
+ * number of hits of the cache. */
+static uint32_t prvReplayTrace( uint32_t ulHotUses,
+                                uint32_t ulScanRun )
+{
+    FF_IOManager_t * pxIOManager;
+    FF_Buffer_t * pxBuffer;
+    uint32_t ulRequest, ulSector, ulHits;
+    uint32_t ulScan = 0U, ulRandom = 12345U;
+
+    pxIOManager = prvCreateSizedIOManager( TEST_TRACE_CACHE );
+    TEST_ASSERT_NOT_NULL( pxIOManager );
+    ulSectorsRead = 0U;
+
+    for( ulRequest = 0U; ulRequest < TEST_TRACE_LENGTH; ulRequest++ )
+    {
+        if( ( ulRequest % ( ulHotUses + ulScanRun ) ) < ulHotUses )
+        {
+            ulRandom = ( ulRandom * 1103515245U ) + 12345U;
+            ulSector = ( ulRandom >> 16 ) % TEST_TRACE_HOT;
+        }
+        else
+        {
+            /* The files go round the rest of the disk. */
+            ulSector = 64U + ( ulScan % ( TEST_DISK_SECTORS - 64U ) );
+            ulScan++;
+        }
+
+        pxBuffer = FF_GetBuffer( pxIOManager, ulSector, FF_MODE_READ );
+        TEST_ASSERT_NOT_NULL( pxBuffer );
+        ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+    }
+
+    ulHits = TEST_TRACE_LENGTH - ulSectorsRead;
+
+    ( void ) FF_DeleteIOManager( pxIOManager );
+
+    return ulHits;
+}
+
+/*
+ * Replay two traces through FF_GetBuffer(), and print the hit rate of the
+ * cache.
+ *
+ * 24 sectors, like the FAT and a directory, are used all the time while
+ * files are read once.  In the first trace every fourth request reads the
+ * next sector of a file, as when a file is copied.  LRU lets the file push
+ * out the hot sectors, with ffconfigCACHE_2Q the file stays in the FIFO
+ * queue.  In the second trace 200 uses of the hot sectors alternate with a
+ * file of 64 sectors.  2Q only keeps a sector that is used again after it
+ * left the FIFO queue, which does not happen here, so it does no better than
+ * LRU.
+ *
+ * The baseline is the cache without ffconfigBUFFER_HASH_INDEX, which ages
+ * the buffers while it searches all of them for one to recycle.  The
+ * ff_ioman_utest build checks that it still has the hits of
+ * TEST_TRACE_BASELINE_HITS, the other builds that they have no fewer.  2Q
+ * must have more on the first trace.
+ */
+void test_GetBuffer_trace_hit_rate_Benchmark( void )
+{
+    #if ( TEST_RUN_BENCHMARKS != 0 )
+        const uint32_t ulHotUses[] = { 3U, 200U };
+        const uint32_t ulScanRuns[] = { 1U, 64U };
+        const uint32_t ulBaselineHits[] = TEST_TRACE_BASELINE_HITS;
+        uint32_t ulIndex, ulHits;
+
+        for( ulIndex = 0U; ulIndex < ( sizeof( ulHotUses ) / sizeof( ulHotUses[ 0 ] ) ); ulIndex++ )
+        {
+            ulHits = prvReplayTrace( ulHotUses[ ulIndex ], ulScanRuns[ ulIndex ] );
+
+            printf( "Trace %u hot / %u file, %u buffers: %s %.1f %% hits, linear search %.1f %% hits\n",
+                    ( unsigned ) ulHotUses[ ulIndex ], ( unsigned ) ulScanRuns[ ulIndex ], ( unsigned ) TEST_TRACE_CACHE,
+                    ( ffconfigCACHE_2Q != 0 ) ? "2Q" : ( ffconfigBUFFER_HASH_INDEX != 0 ) ? "LRU lists" : "linear search",
+                    ( 100.0 * ulHits ) / TEST_TRACE_LENGTH,
+                    ( 100.0 * ulBaselineHits[ ulIndex ] ) / TEST_TRACE_LENGTH );
+
+            #if ( ffconfigBUFFER_HASH_INDEX == 0 )
+            {
+                TEST_ASSERT_EQUAL_UINT32( ulBaselineHits[ ulIndex ], ulHits );
+            }
+            #else
+            {
+                TEST_ASSERT_GREATER_OR_EQUAL_UINT32( ulBaselineHits[ ulIndex ], ulHits );
+
+                #if ( ffconfigCACHE_2Q != 0 )
+                {
+                    if( ulIndex == 0U )
+                    {
+                        TEST_ASSERT_GREATER_THAN_UINT32( ulBaselineHits[ ulIndex ], ulHits );
+                    }
+                }
+                #endif
+            }
+            #endif
+        }
+    #else
+        TEST_IGNORE_MESSAGE( "Configure with -DFAT_UNIT_TEST_BENCHMARKS=ON to run the benchmarks" );
+    #endif
+}
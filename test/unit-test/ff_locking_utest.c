@@ -0,0 +1,1074 @@
+/*
+ * Tests and benchmarks for ff_locking.c with several tasks.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Nothing is mocked here.  The locking layer runs for real, on the kernel
+ * stand-in in kernel/posix_kernel.c, and every task is a POSIX thread.  The
+ * other layers run for real on an in-memory block device.
+ *
+ * Timings depend on the host and its scheduler, so the benchmarks only
+ * print them.  They fail when the result of the work is wrong.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "unity.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "ff_headers.h"
+#include "ff_test_disk.h"
+
+/*-----------------------------------------------------------*/
+/* Test parameters.                                           */
+/*-----------------------------------------------------------*/
+
+#define TEST_DISK_SECTORS      ( 16384U ) /* 8 MB. */
+#define TEST_WAIT_CACHE        ( 8U )     /* Cache sectors in the wait benchmark. */
+#define TEST_VOLUME_CACHE      ( 64U )    /* Cache sectors on a formatted volume. */
+
+#define TEST_MAX_TASKS         ( 8U )
+#define TEST_WAIT_ROUNDS       ( 2000U )
+#define TEST_HOLD_NS           ( 2000U )   /* The time a task holds the buffer. */
+#define TEST_GAP_NS            ( 2000U )   /* The time between two requests. */
+#define TEST_SHARED_SECTOR     ( 10U )
+
+#define TEST_CREATE_TASKS      ( 6U )
+#define TEST_CREATE_FILES      ( 500U )   /* Files created by every task. */
+#define TEST_CREATE_ROUNDS     ( 3U )
+
+#define TEST_LIST_FILES        ( 400U )   /* Files created while another task lists them. */
+#define TEST_HELD_WAIT_MS      ( 50U )    /* The time a held directory sector is kept. */
+
+#define TEST_SCAN_CLUSTERS     ( 16U )    /* Clusters taken while the free scan runs. */
+#define TEST_SCAN_DELAY_US     ( 1000U )  /* Slows down every FAT sector that the scan reads. */
+
+/*-----------------------------------------------------------*/
+/* Helpers.                                                   */
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNanoseconds( void )
+{
+    struct timespec xNow;
+
+    clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000000U ) + ( uint64_t ) xNow.tv_nsec;
+}
+
+static int prvCompareTimes( const void * pvLeft,
+                            const void * pvRight )
+{
+    uint64_t ullLeft = *( ( const uint64_t * ) pvLeft );
+    uint64_t ullRight = *( ( const uint64_t * ) pvRight );
+
+    return ( ullLeft > ullRight ) - ( ullLeft < ullRight );
+}
+
+/* Sort 'ulCount' times and print the 50th and 99th percentile and the maximum. */
+static void prvPrintPercentiles( const char * pcWhat,
+                                 uint64_t * pullTimes,
+                                 uint32_t ulCount )
+{
+    qsort( pullTimes, ulCount, sizeof( pullTimes[ 0 ] ), prvCompareTimes );
+
+    printf( "%s: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+            pcWhat,
+            ( double ) pullTimes[ ulCount / 2U ] / 1e3,
+            ( double ) pullTimes[ ( ulCount * 99U ) / 100U ] / 1e3,
+            ( double ) pullTimes[ ulCount - 1U ] / 1e3 );
+}
+
+static FF_IOManager_t * prvCreateIOManager( uint32_t ulCacheSectors )
+{
+    FF_CreationParameters_t xParameters;
+    FF_Error_t xError = FF_ERR_NONE;
+    FF_IOManager_t * pxIOManager;
+
+    vTestDiskParameters( &xParameters, ulCacheSectors );
+    xParameters.pvSemaphore = ( void * ) xSemaphoreCreateRecursiveMutex();
+
+    pxIOManager = FF_CreateIOManager( &xParameters, &xError );
+    TEST_ASSERT_NOT_NULL( pxIOManager );
+
+    return pxIOManager;
+}
+
+static void prvDeleteIOManager( FF_IOManager_t * pxIOManager )
+{
+    void * pvSemaphore = pxIOManager->pvSemaphore;
+
+    ( void ) FF_DeleteIOManager( pxIOManager );
+    vSemaphoreDelete( ( SemaphoreHandle_t ) pvSemaphore );
+}
+
+/* Partition, format and mount the RAM disk, with a semaphore. */
+static FF_IOManager_t * prvCreateVolume( void )
+{
+    FF_CreationParameters_t xParameters;
+
+    vTestDiskParameters( &xParameters, TEST_VOLUME_CACHE );
+    xParameters.pvSemaphore = ( void * ) xSemaphoreCreateRecursiveMutex();
+
+    return pxTestDiskFormat( &xParameters, pdTRUE );
+}
+
+static void prvDeleteVolume( FF_IOManager_t * pxIOManager )
+{
+    void * pvSemaphore = pxIOManager->pvSemaphore;
+
+    vTestDiskDeleteVolume();
+    vSemaphoreDelete( ( SemaphoreHandle_t ) pvSemaphore );
+}
+
+/* Returns the number of entries in a directory, without "." and "..". */
+static uint32_t prvCountEntries( FF_IOManager_t * pxIOManager,
+                                 const char * pcDirectory )
+{
+    FF_DirEnt_t xDirEntry;
+    FF_Error_t xError;
+    uint32_t ulCount = 0U;
+
+    memset( &xDirEntry, 0, sizeof( xDirEntry ) );
+
+    for( xError = FF_FindFirst( pxIOManager, &xDirEntry, pcDirectory );
+         FF_isERR( xError ) == pdFALSE;
+         xError = FF_FindNext( pxIOManager, &xDirEntry ) )
+    {
+        if( xDirEntry.pcFileName[ 0 ] != '.' )
+        {
+            ulCount++;
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT( FF_ERR_DIR_END_OF_DIR, FF_GETERROR( xError ) );
+
+    return ulCount;
+}
+
+/*-----------------------------------------------------------*/
+/* Tasks waiting for a buffer in FF_GetBuffer().             */
+/*-----------------------------------------------------------*/
+
+typedef struct
+{
+    FF_IOManager_t * pxIOManager;
+    uint64_t * pullWaitTimes; /* TEST_WAIT_ROUNDS times, one per request. */
+    uint32_t ulFailures;
+} WaitTask_t;
+
+/* Take the shared sector in write mode, count in it, hold it for a while,
+ * give it back, and wait a little before the next request. */
+static void * prvWaitTask( void * pvParameter )
+{
+    WaitTask_t * pxTask = ( WaitTask_t * ) pvParameter;
+    FF_Buffer_t * pxBuffer;
+    uint64_t ullStart;
+    uint32_t ulRound;
+
+    for( ulRound = 0U; ulRound < TEST_WAIT_ROUNDS; ulRound++ )
+    {
+        ullStart = prvNanoseconds();
+        pxBuffer = FF_GetBuffer( pxTask->pxIOManager, TEST_SHARED_SECTOR, FF_MODE_WRITE );
+        pxTask->pullWaitTimes[ ulRound ] = prvNanoseconds() - ullStart;
+
+        if( pxBuffer == NULL )
+        {
+            pxTask->ulFailures++;
+            continue;
+        }
+
+        FF_putLong( pxBuffer->pucBuffer, 0U, FF_getLong( pxBuffer->pucBuffer, 0U ) + 1U );
+        ullStart = prvNanoseconds();
+
+        while( ( prvNanoseconds() - ullStart ) < TEST_HOLD_NS )
+        {
+            /* Keep the buffer for a while. */
+        }
+
+        ( void ) FF_ReleaseBuffer( pxTask->pxIOManager, pxBuffer );
+        ullStart = prvNanoseconds();
+
+        while( ( prvNanoseconds() - ullStart ) < TEST_GAP_NS )
+        {
+            /* Give the other tasks a chance to take the buffer. */
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+/* Tasks creating and deleting files.                        */
+/*-----------------------------------------------------------*/
+
+typedef struct
+{
+    FF_IOManager_t * pxIOManager;
+    char pcDirectory[ 16 ];
+    uint32_t ulTask;
+    uint32_t ulFailures;
+} CreateTask_t;
+
+/* Create TEST_CREATE_FILES empty files, and delete every fifth one. */
+static void * prvCreateTask( void * pvParameter )
+{
+    CreateTask_t * pxTask = ( CreateTask_t * ) pvParameter;
+    char pcName[ 40 ];
+    FF_FILE * pxFile;
+    FF_Error_t xError;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0U; ulIndex < TEST_CREATE_FILES; ulIndex++ )
+    {
+        snprintf( pcName, sizeof( pcName ), "%s/T%uF%05u.TXT", pxTask->pcDirectory, ( unsigned ) pxTask->ulTask, ( unsigned ) ulIndex );
+        pxFile = FF_Open( pxTask->pxIOManager, pcName, FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+
+        if( ( pxFile == NULL ) || FF_isERR( FF_Close( pxFile ) ) )
+        {
+            pxTask->ulFailures++;
+        }
+
+        if( ( ulIndex % 5U ) == 4U )
+        {
+            snprintf( pcName, sizeof( pcName ), "%s/T%uF%05u.TXT", pxTask->pcDirectory, ( unsigned ) pxTask->ulTask, ( unsigned ) ( ulIndex - 2U ) );
+
+            if( FF_isERR( FF_RmFile( pxTask->pxIOManager, pcName ) ) )
+            {
+                pxTask->ulFailures++;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+/* A task listing a directory that another task changes.      */
+/*-----------------------------------------------------------*/
+
+typedef struct
+{
+    FF_IOManager_t * pxIOManager;
+    uint32_t ulCreated; /* Files created so far, written by the writer task only. */
+    uint32_t ulDone;    /* Set by the writer task when it is done. */
+    uint32_t ulFailures;
+    uint32_t ulListings;
+} ListTask_t;
+
+/* Create TEST_LIST_FILES files, and delete the ones with an index that ends
+ * in 2 or 7, so that the changes are spread over the whole directory. */
+static void * prvListWriterTask( void * pvParameter )
+{
+    ListTask_t * pxTask = ( ListTask_t * ) pvParameter;
+    char pcName[ 40 ];
+    FF_FILE * pxFile;
+    FF_Error_t xError;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0U; ulIndex < TEST_LIST_FILES; ulIndex++ )
+    {
+        snprintf( pcName, sizeof( pcName ), "/dir/W%05u.TXT", ( unsigned ) ulIndex );
+        pxFile = FF_Open( pxTask->pxIOManager, pcName, FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+
+        if( ( pxFile == NULL ) || FF_isERR( FF_Close( pxFile ) ) )
+        {
+            pxTask->ulFailures++;
+        }
+
+        __atomic_store_n( &( pxTask->ulCreated ), ulIndex + 1U, __ATOMIC_RELEASE );
+
+        if( ( ulIndex % 5U ) == 4U )
+        {
+            snprintf( pcName, sizeof( pcName ), "/dir/W%05u.TXT", ( unsigned ) ( ulIndex - 2U ) );
+
+            if( FF_isERR( FF_RmFile( pxTask->pxIOManager, pcName ) ) )
+            {
+                pxTask->ulFailures++;
+            }
+        }
+    }
+
+    __atomic_store_n( &( pxTask->ulDone ), 1U, __ATOMIC_RELEASE );
+
+    return NULL;
+}
+
+/* List "/dir" until the writer is done.  Every listing must show each file
+ * that was created before it started and that is never deleted, and no name
+ * may show up twice. */
+static void * prvListReaderTask( void * pvParameter )
+{
+    ListTask_t * pxTask = ( ListTask_t * ) pvParameter;
+    static uint8_t ucSeen[ TEST_LIST_FILES ];
+    FF_DirEnt_t xDirEntry;
+    FF_Error_t xError;
+    uint32_t ulCreated, ulDone, ulIndex;
+    unsigned uIndex;
+
+    do
+    {
+        ulDone = __atomic_load_n( &( pxTask->ulDone ), __ATOMIC_ACQUIRE );
+        ulCreated = __atomic_load_n( &( pxTask->ulCreated ), __ATOMIC_ACQUIRE );
+        memset( ucSeen, 0, sizeof( ucSeen ) );
+        memset( &xDirEntry, 0, sizeof( xDirEntry ) );
+
+        for( xError = FF_FindFirst( pxTask->pxIOManager, &xDirEntry, "/dir" );
+             FF_isERR( xError ) == pdFALSE;
+             xError = FF_FindNext( pxTask->pxIOManager, &xDirEntry ) )
+        {
+            /* Short names may be listed in lower case. */
+            if( ( ( xDirEntry.pcFileName[ 0 ] == 'W' ) || ( xDirEntry.pcFileName[ 0 ] == 'w' ) ) &&
+                ( sscanf( &( xDirEntry.pcFileName[ 1 ] ), "%5u", &uIndex ) == 1 ) )
+            {
+                if( ( uIndex >= TEST_LIST_FILES ) || ( ucSeen[ uIndex ] != 0U ) )
+                {
+                    pxTask->ulFailures++;
+                }
+                else
+                {
+                    ucSeen[ uIndex ] = 1U;
+                }
+            }
+        }
+
+        if( FF_GETERROR( xError ) != FF_ERR_DIR_END_OF_DIR )
+        {
+            pxTask->ulFailures++;
+        }
+
+        for( ulIndex = 0U; ulIndex < ulCreated; ulIndex++ )
+        {
+            if( ( ( ulIndex % 5U ) != 2U ) && ( ucSeen[ ulIndex ] == 0U ) )
+            {
+                pxTask->ulFailures++;
+            }
+        }
+
+        pxTask->ulListings++;
+    } while( ulDone == 0U );
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+/* A task writing a directory sector that a listing holds.    */
+/*-----------------------------------------------------------*/
+
+typedef struct
+{
+    FF_IOManager_t * pxIOManager;
+    uint32_t ulSector;
+    uint32_t ulDone; /* Set once the task has the sector in write mode. */
+    uint32_t ulFailures;
+} HeldTask_t;
+
+/* Take the sector in write mode, and give it back. */
+static void * prvHeldWriteTask( void * pvParameter )
+{
+    HeldTask_t * pxTask = ( HeldTask_t * ) pvParameter;
+    FF_Buffer_t * pxBuffer;
+
+    pxBuffer = FF_GetBuffer( pxTask->pxIOManager, pxTask->ulSector, FF_MODE_WRITE );
+
+    if( pxBuffer == NULL )
+    {
+        pxTask->ulFailures++;
+    }
+    else
+    {
+        __atomic_store_n( &( pxTask->ulDone ), 1U, __ATOMIC_RELEASE );
+        ( void ) FF_ReleaseBuffer( pxTask->pxIOManager, pxBuffer );
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+/* Tasks taking the FAT lock or a directory lock.             */
+/*-----------------------------------------------------------*/
+
+typedef struct
+{
+    FF_IOManager_t * pxIOManager;
+    const char * pcPath;    /* The file that prvCreateFileTask() creates. */
+    uint32_t ulLocked;      /* Set once the task has the lock, or has created the file. */
+    uint32_t ulRelease;     /* Set by the test to let the task give back the lock. */
+    uint32_t ulOrder;       /* The value of 'ulLockOrder' when the task got the lock. */
+    uint32_t ulExclusive;   /* Set when FF_LockFATShared() took the lock exclusively. */
+    uint32_t ulFailures;
+} LockTask_t;
+
+/* Counts the tasks that got the FAT lock, in the order that they got it. */
+static uint32_t ulLockOrder;
+
+/* Record that the task has the lock, and wait until the test releases it. */
+static void prvHoldLock( LockTask_t * pxTask )
+{
+    pxTask->ulOrder = __atomic_add_fetch( &ulLockOrder, 1U, __ATOMIC_ACQ_REL );
+    __atomic_store_n( &( pxTask->ulLocked ), 1U, __ATOMIC_RELEASE );
+
+    while( __atomic_load_n( &( pxTask->ulRelease ), __ATOMIC_ACQUIRE ) == 0U )
+    {
+        vTaskDelay( 1 );
+    }
+}
+
+static void * prvWriterTask( void * pvParameter )
+{
+    LockTask_t * pxTask = ( LockTask_t * ) pvParameter;
+
+    FF_LockFAT( pxTask->pxIOManager );
+    prvHoldLock( pxTask );
+    FF_UnlockFAT( pxTask->pxIOManager );
+
+    return NULL;
+}
+
+static void * prvReaderTask( void * pvParameter )
+{
+    LockTask_t * pxTask = ( LockTask_t * ) pvParameter;
+
+    FF_LockFATShared( pxTask->pxIOManager );
+
+    if( FF_Has_Lock( pxTask->pxIOManager, FF_FAT_SHARED_LOCK ) == pdFALSE )
+    {
+        pxTask->ulFailures++;
+    }
+
+    if( pxTask->pxIOManager->pvFATLockHandle == xTaskGetCurrentTaskHandle() )
+    {
+        pxTask->ulExclusive = 1U;
+    }
+
+    prvHoldLock( pxTask );
+    FF_UnlockFATShared( pxTask->pxIOManager );
+
+    return NULL;
+}
+
+/* Create an empty file, FF_CreateDirent() locks its directory. */
+static void * prvCreateFileTask( void * pvParameter )
+{
+    LockTask_t * pxTask = ( LockTask_t * ) pvParameter;
+    FF_FILE * pxFile;
+    FF_Error_t xError;
+
+    pxFile = FF_Open( pxTask->pxIOManager, pxTask->pcPath, FF_MODE_WRITE | FF_MODE_CREATE, &xError );
+
+    if( ( pxFile == NULL ) || FF_isERR( FF_Close( pxFile ) ) )
+    {
+        pxTask->ulFailures++;
+    }
+
+    __atomic_store_n( &( pxTask->ulLocked ), 1U, __ATOMIC_RELEASE );
+
+    return NULL;
+}
+
+/* Wait until the task has the lock. */
+static void prvWaitLocked( LockTask_t * pxTask )
+{
+    while( __atomic_load_n( &( pxTask->ulLocked ), __ATOMIC_ACQUIRE ) == 0U )
+    {
+        vTaskDelay( 1 );
+    }
+}
+
+/* Start 'pxTask', and wait until it has the lock when 'xWait' is pdTRUE. */
+static void prvStartTask( pthread_t * pxThread,
+                          void * ( *pxFunction )( void * ),
+                          LockTask_t * pxTask,
+                          BaseType_t xWait )
+{
+    TEST_ASSERT_EQUAL_INT( 0, pthread_create( pxThread, NULL, pxFunction, pxTask ) );
+
+    if( xWait != pdFALSE )
+    {
+        prvWaitLocked( pxTask );
+    }
+}
+
+/* The task must still be waiting for the lock after TEST_HELD_WAIT_MS. */
+static void prvAssertWaiting( LockTask_t * pxTask )
+{
+    vTaskDelay( TEST_HELD_WAIT_MS );
+    TEST_ASSERT_EQUAL_UINT32( 0U, __atomic_load_n( &( pxTask->ulLocked ), __ATOMIC_ACQUIRE ) );
+}
+
+/* Let the task give back its lock, and wait for it to end. */
+static void prvStopTask( pthread_t xThread,
+                         LockTask_t * pxTask )
+{
+    __atomic_store_n( &( pxTask->ulRelease ), 1U, __ATOMIC_RELEASE );
+    TEST_ASSERT_EQUAL_INT( 0, pthread_join( xThread, NULL ) );
+    TEST_ASSERT_EQUAL_UINT32( 1U, pxTask->ulLocked );
+    TEST_ASSERT_EQUAL_UINT32( 0U, pxTask->ulFailures );
+}
+
+/* Returns the index of the first 'ulValue' in 'pulValues'. */
+static uint32_t prvIndexOf( const uint32_t * pulValues,
+                            uint32_t ulCount,
+                            uint32_t ulValue )
+{
+    uint32_t ulIndex;
+
+    for( ulIndex = 0U; ulIndex < ulCount; ulIndex++ )
+    {
+        if( pulValues[ ulIndex ] == ulValue )
+        {
+            break;
+        }
+    }
+
+    return ulIndex;
+}
+
+/*-----------------------------------------------------------*/
+/* Unity fixtures.                                            */
+/*-----------------------------------------------------------*/
+
+void setUp( void )
+{
+    vTestDiskInit( TEST_DISK_SECTORS );
+    ulLockOrder = 0U;
+}
+
+void tearDown( void )
+{
+    vTestDiskFree();
+}
+
+/*-----------------------------------------------------------*/
+/* Tests.                                                     */
+/*-----------------------------------------------------------*/
+
+/*
+ * 2, 4 and 8 tasks take the same sector in write mode, one at a time, and
+ * print the time that FF_GetBuffer() took.  Up to FF_BUF_WAIT_SLOTS tasks
+ * wait on an event bit of their own, the others share FF_BUF_LOCK.  Every
+ * task adds one to a counter in the sector, so the counter shows whether
+ * the buffer was ever given to two tasks at once.
+ */
+void test_GetBuffer_wait_time_Benchmark( void )
+{
+    #if ( TEST_RUN_BENCHMARKS != 0 )
+        const uint32_t ulTaskCounts[] = { 2U, 4U, TEST_MAX_TASKS };
+        static uint64_t ullWaitTimes[ TEST_MAX_TASKS * TEST_WAIT_ROUNDS ];
+        WaitTask_t xTasks[ TEST_MAX_TASKS ];
+        pthread_t xThreads[ TEST_MAX_TASKS ];
+        FF_IOManager_t * pxIOManager;
+        FF_Buffer_t * pxBuffer;
+        uint32_t ulIndex, ulTask, ulTaskCount;
+        char pcWhat[ 48 ];
+
+        for( ulIndex = 0U; ulIndex < ( sizeof( ulTaskCounts ) / sizeof( ulTaskCounts[ 0 ] ) ); ulIndex++ )
+        {
+            ulTaskCount = ulTaskCounts[ ulIndex ];
+            pxIOManager = prvCreateIOManager( TEST_WAIT_CACHE );
+
+            for( ulTask = 0U; ulTask < ulTaskCount; ulTask++ )
+            {
+                xTasks[ ulTask ].pxIOManager = pxIOManager;
+                xTasks[ ulTask ].pullWaitTimes = &( ullWaitTimes[ ulTask * TEST_WAIT_ROUNDS ] );
+                xTasks[ ulTask ].ulFailures = 0U;
+                TEST_ASSERT_EQUAL_INT( 0, pthread_create( &( xThreads[ ulTask ] ), NULL, prvWaitTask, &( xTasks[ ulTask ] ) ) );
+            }
+
+            for( ulTask = 0U; ulTask < ulTaskCount; ulTask++ )
+            {
+                TEST_ASSERT_EQUAL_INT( 0, pthread_join( xThreads[ ulTask ], NULL ) );
+                TEST_ASSERT_EQUAL_UINT32( 0U, xTasks[ ulTask ].ulFailures );
+            }
+
+            snprintf( pcWhat, sizeof( pcWhat ), "FF_GetBuffer wait, %u tasks", ( unsigned ) ulTaskCount );
+            prvPrintPercentiles( pcWhat, ullWaitTimes, ulTaskCount * TEST_WAIT_ROUNDS );
+
+            pxBuffer = FF_GetBuffer( pxIOManager, TEST_SHARED_SECTOR, FF_MODE_READ );
+            TEST_ASSERT_NOT_NULL( pxBuffer );
+            TEST_ASSERT_EQUAL_UINT32( ulTaskCount * TEST_WAIT_ROUNDS, FF_getLong( pxBuffer->pucBuffer, 0U ) );
+            ( void ) FF_ReleaseBuffer( pxIOManager, pxBuffer );
+
+            TEST_ASSERT_EQUAL_UINT8( 0U, pxIOManager->ucBufferWaitSlots );
+            TEST_ASSERT_EQUAL_UINT8( 0U, pxIOManager->ucBufferWaitOthers );
+
+            prvDeleteIOManager( pxIOManager );
+        }
+    #else
+        TEST_IGNORE_MESSAGE( "Configure with -DFAT_UNIT_TEST_BENCHMARKS=ON to run the benchmarks" );
+    #endif
+}
+
+/*
+ * TEST_CREATE_TASKS tasks create TEST_CREATE_FILES files each, and delete
+ * every fifth one: first every task in a directory of its own, then all
+ * tasks in the same directory.  The best time of a few rounds is printed.
+ * With ffconfigDIRECTORY_LOCKS, tasks in different directories do not have
+ * to wait for each other.  The test fails when a create or delete fails, or
+ * when a directory does not hold the expected number of files.
+ */
+void test_CreateFiles_Benchmark( void )
+{
+    #if ( TEST_RUN_BENCHMARKS != 0 )
+        const char * pcLayouts[] = { "own directories", "one directory" };
+        CreateTask_t xTasks[ TEST_CREATE_TASKS ];
+        pthread_t xThreads[ TEST_CREATE_TASKS ];
+        FF_IOManager_t * pxIOManager;
+        FF_Error_t xError;
+        uint32_t ulLayout, ulRound, ulTask, ulExpected;
+        uint64_t ullStart, ullTime, ullBest;
+
+        for( ulLayout = 0U; ulLayout < 2U; ulLayout++ )
+        {
+            ullBest = UINT64_MAX;
+
+            for( ulRound = 0U; ulRound < TEST_CREATE_ROUNDS; ulRound++ )
+            {
+                pxIOManager = prvCreateVolume();
+
+                for( ulTask = 0U; ulTask < TEST_CREATE_TASKS; ulTask++ )
+                {
+                    xTasks[ ulTask ].pxIOManager = pxIOManager;
+                    xTasks[ ulTask ].ulTask = ulTask;
+                    xTasks[ ulTask ].ulFailures = 0U;
+                    snprintf( xTasks[ ulTask ].pcDirectory, sizeof( xTasks[ ulTask ].pcDirectory ), "/dir%u",
+                              ( unsigned ) ( ( ulLayout == 0U ) ? ulTask : 0U ) );
+
+                    if( ( ulLayout == 0U ) || ( ulTask == 0U ) )
+                    {
+                        xError = FF_MkDir( pxIOManager, xTasks[ ulTask ].pcDirectory );
+                        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+                    }
+                }
+
+                ullStart = prvNanoseconds();
+
+                for( ulTask = 0U; ulTask < TEST_CREATE_TASKS; ulTask++ )
+                {
+                    TEST_ASSERT_EQUAL_INT( 0, pthread_create( &( xThreads[ ulTask ] ), NULL, prvCreateTask, &( xTasks[ ulTask ] ) ) );
+                }
+
+                for( ulTask = 0U; ulTask < TEST_CREATE_TASKS; ulTask++ )
+                {
+                    TEST_ASSERT_EQUAL_INT( 0, pthread_join( xThreads[ ulTask ], NULL ) );
+                }
+
+                ullTime = prvNanoseconds() - ullStart;
+
+                if( ullTime < ullBest )
+                {
+                    ullBest = ullTime;
+                }
+
+                for( ulTask = 0U; ulTask < TEST_CREATE_TASKS; ulTask++ )
+                {
+                    TEST_ASSERT_EQUAL_UINT32( 0U, xTasks[ ulTask ].ulFailures );
+                }
+
+                ulExpected = ( TEST_CREATE_FILES * 4U ) / 5U;
+
+                if( ulLayout == 0U )
+                {
+                    for( ulTask = 0U; ulTask < TEST_CREATE_TASKS; ulTask++ )
+                    {
+                        TEST_ASSERT_EQUAL_UINT32( ulExpected, prvCountEntries( pxIOManager, xTasks[ ulTask ].pcDirectory ) );
+                    }
+                }
+                else
+                {
+                    TEST_ASSERT_EQUAL_UINT32( ulExpected * TEST_CREATE_TASKS, prvCountEntries( pxIOManager, "/dir0" ) );
+                }
+
+                prvDeleteVolume( pxIOManager );
+            }
+
+            printf( "%u tasks creating %u files each in %s, %u directory locks: %.1f ms\n",
+                    ( unsigned ) TEST_CREATE_TASKS, ( unsigned ) TEST_CREATE_FILES, pcLayouts[ ulLayout ],
+                    ( unsigned ) ffconfigDIRECTORY_LOCKS, ( double ) ullBest / 1e6 );
+        }
+    #else
+        TEST_IGNORE_MESSAGE( "Configure with -DFAT_UNIT_TEST_BENCHMARKS=ON to run the benchmarks" );
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * One task lists a directory again and again, while another task creates
+ * and deletes files in it.  With ffconfigDIRECTORY_READ_SECTORS the listing
+ * reads the directory block of the I/O manager, which the writer changes.
+ * A listing must not miss a file that existed for the whole listing, nor see
+ * a file twice.  The last listing starts after the writer is done, and must
+ * find all of the files.
+ */
+void test_FindNext_sees_the_changes_of_another_task( void )
+{
+    ListTask_t xTask;
+    pthread_t xWriter, xReader;
+
+    memset( &xTask, 0, sizeof( xTask ) );
+    xTask.pxIOManager = prvCreateVolume();
+    vTestDiskCreateFiles( xTask.pxIOManager, "/dir", 100U );
+
+    TEST_ASSERT_EQUAL_INT( 0, pthread_create( &xReader, NULL, prvListReaderTask, &xTask ) );
+    TEST_ASSERT_EQUAL_INT( 0, pthread_create( &xWriter, NULL, prvListWriterTask, &xTask ) );
+    TEST_ASSERT_EQUAL_INT( 0, pthread_join( xWriter, NULL ) );
+    TEST_ASSERT_EQUAL_INT( 0, pthread_join( xReader, NULL ) );
+
+    TEST_ASSERT_EQUAL_UINT32( 0U, xTask.ulFailures );
+    TEST_ASSERT_GREATER_THAN_UINT32( 1U, xTask.ulListings );
+    TEST_ASSERT_EQUAL_UINT32( 100U + ( ( TEST_LIST_FILES * 4U ) / 5U ), prvCountEntries( xTask.pxIOManager, "/dir" ) );
+
+    prvDeleteVolume( xTask.pxIOManager );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * A fetch context holds the directory sector of the entry that it fetched
+ * last, either a cache buffer or the directory block of the I/O manager.
+ * Another task that asks for that sector in write mode must wait until the
+ * context lets go of it.
+ */
+void test_GetBuffer_waits_for_a_held_directory_sector( void )
+{
+    HeldTask_t xTask;
+    FF_FetchContext_t xContext;
+    uint8_t pucEntry[ FF_SIZEOF_DIRECTORY_ENTRY ];
+    struct timespec xDelay = { 0, TEST_HELD_WAIT_MS * 1000000L };
+    pthread_t xWriter;
+    FF_Error_t xError = FF_ERR_NONE;
+    uint32_t ulCluster;
+
+    memset( &xTask, 0, sizeof( xTask ) );
+    xTask.pxIOManager = prvCreateVolume();
+    vTestDiskCreateFiles( xTask.pxIOManager, "/dir", 20U );
+
+    ulCluster = FF_FindDir( xTask.pxIOManager, "/dir", 4U, &xError );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    TEST_ASSERT_NOT_EQUAL( 0U, ulCluster );
+
+    xError = FF_InitEntryFetch( xTask.pxIOManager, ulCluster, &xContext );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    xError = FF_FetchEntryWithContext( xTask.pxIOManager, 2U, &xContext, pucEntry );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    TEST_ASSERT_NOT_NULL( xContext.pxBuffer );
+    xTask.ulSector = xContext.pxBuffer->ulSector;
+
+    TEST_ASSERT_EQUAL_INT( 0, pthread_create( &xWriter, NULL, prvHeldWriteTask, &xTask ) );
+    ( void ) nanosleep( &xDelay, NULL );
+    TEST_ASSERT_EQUAL_UINT32( 0U, __atomic_load_n( &( xTask.ulDone ), __ATOMIC_ACQUIRE ) );
+
+    xError = FF_CleanupEntryFetch( xTask.pxIOManager, &xContext );
+    TEST_ASSERT_FALSE( FF_isERR( xError ) );
+    TEST_ASSERT_EQUAL_INT( 0, pthread_join( xWriter, NULL ) );
+
+    TEST_ASSERT_EQUAL_UINT32( 0U, xTask.ulFailures );
+    TEST_ASSERT_EQUAL_UINT32( 1U, xTask.ulDone );
+
+    prvDeleteVolume( xTask.pxIOManager );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * FF_Mount() leaves the free clusters to the background scan, and does not
+ * search for the first free one.  Clusters are taken before the scan has
+ * read anything, and then between its steps, from the part of the FAT that
+ * it has seen.  Every third one is freed again.  When the scan is done, its
+ * count and its bitmap must agree with the FAT.
+ */
+void test_FreeScan_allocates_while_the_scan_runs( void )
+{
+    #if ( ffconfigBACKGROUND_FREE_SCAN != 0 )
+        FF_IOManager_t * pxIOManager;
+        uint32_t pulClusters[ TEST_SCAN_CLUSTERS ];
+        uint32_t ulCount = 0U;
+        uint32_t ulIndex;
+        uint32_t ulScanned;
+        uint32_t ulCluster;
+        uint32_t ulFreeClusters;
+        BaseType_t xIsFree;
+        FF_Error_t xError = FF_ERR_NONE;
+
+        pxIOManager = prvCreateVolume();
+        vTestDiskCreateFiles( pxIOManager, "/dir", 100U );
+        xError = FF_Unmount( &xTestDisk );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+        /* Keep the scan task waiting until the first cluster has been taken,
+         * and let it take a while for every FAT sector. */
+        ulTestDiskReadDelayUs = TEST_SCAN_DELAY_US;
+        FF_LockFAT( pxIOManager );
+        {
+            xError = FF_Mount( &xTestDisk, 0 );
+            TEST_ASSERT_FALSE( FF_isERR( xError ) );
+            TEST_ASSERT_TRUE( FF_FreeScanBusy( pxIOManager ) );
+            TEST_ASSERT_EQUAL_UINT32( 0U, pxIOManager->xPartition.ulLastFreeCluster );
+            TEST_ASSERT_EQUAL_UINT32( 0U, pxIOManager->xPartition.ulScanCluster );
+
+            pulClusters[ ulCount ] = FF_FindFreeCluster( pxIOManager, &xError, pdTRUE );
+            TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        }
+        FF_UnlockFAT( pxIOManager );
+
+        xError = FF_DecreaseFreeClusters( pxIOManager, 1 );
+        TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        ulCount++;
+
+        while( ( FF_FreeScanBusy( pxIOManager ) != pdFALSE ) && ( ulCount < TEST_SCAN_CLUSTERS ) )
+        {
+            /* Let the scan take a step. */
+            ulScanned = __atomic_load_n( &( pxIOManager->xPartition.ulScanCluster ), __ATOMIC_ACQUIRE );
+
+            while( ( FF_FreeScanBusy( pxIOManager ) != pdFALSE ) &&
+                   ( __atomic_load_n( &( pxIOManager->xPartition.ulScanCluster ), __ATOMIC_ACQUIRE ) == ulScanned ) )
+            {
+                vTaskDelay( 0 );
+            }
+
+            pulClusters[ ulCount ] = FF_CreateClusterChain( pxIOManager, &xError );
+            TEST_ASSERT_FALSE( FF_isERR( xError ) );
+
+            if( ( ulCount % 3U ) == 2U )
+            {
+                xError = FF_UnlinkClusterChain( pxIOManager, pulClusters[ ulCount ], pdFALSE );
+                TEST_ASSERT_FALSE( FF_isERR( xError ) );
+                pulClusters[ ulCount ] = 0U;
+            }
+
+            ulCount++;
+        }
+
+        while( FF_FreeScanBusy( pxIOManager ) != pdFALSE )
+        {
+            vTaskDelay( 1 );
+        }
+
+        /* The scan task takes the FAT lock again right away, how often this
+         * task gets it in between depends on the host. */
+        ulTestDiskReadDelayUs = 0U;
+        TEST_ASSERT_GREATER_THAN_UINT32( 1U, ulCount );
+
+        FF_LockFAT( pxIOManager );
+        {
+            ulFreeClusters = FF_CountFreeClusters( pxIOManager, &xError );
+            TEST_ASSERT_FALSE( FF_isERR( xError ) );
+            TEST_ASSERT_EQUAL_UINT32( ulFreeClusters, pxIOManager->xPartition.ulFreeClusterCount );
+            TEST_ASSERT_NOT_NULL( pxIOManager->xPartition.pulFreeBitmap );
+
+            for( ulCluster = 2U; ulCluster < pxIOManager->xPartition.ulNumClusters; ulCluster++ )
+            {
+                xIsFree = ( FF_getFATEntry( pxIOManager, ulCluster, &xError, NULL ) == 0U );
+                TEST_ASSERT_FALSE( FF_isERR( xError ) );
+                TEST_ASSERT_EQUAL_INT( xIsFree, ( pxIOManager->xPartition.pulFreeBitmap[ ulCluster / 32U ] >> ( ulCluster % 32U ) ) & 1U );
+            }
+
+            /* No cluster was handed out twice. */
+            for( ulIndex = 0U; ulIndex < ulCount; ulIndex++ )
+            {
+                if( pulClusters[ ulIndex ] != 0U )
+                {
+                    TEST_ASSERT_NOT_EQUAL( 0U, FF_getFATEntry( pxIOManager, pulClusters[ ulIndex ], &xError, NULL ) );
+                    TEST_ASSERT_EQUAL_UINT32( ulIndex, prvIndexOf( pulClusters, ulCount, pulClusters[ ulIndex ] ) );
+                }
+            }
+        }
+        FF_UnlockFAT( pxIOManager );
+
+        prvDeleteVolume( pxIOManager );
+    #else /* if ( ffconfigBACKGROUND_FREE_SCAN != 0 ) */
+        TEST_IGNORE_MESSAGE( "Needs ffconfigBACKGROUND_FREE_SCAN" );
+    #endif /* if ( ffconfigBACKGROUND_FREE_SCAN != 0 ) */
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * A task that wants to change the FAT waits until the task that reads it
+ * gives back its shared lock.
+ */
+void test_LockFAT_waits_for_the_readers( void )
+{
+    #if ( ffconfigFAT_LOCK_READERS != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateIOManager( TEST_WAIT_CACHE );
+        LockTask_t xReader, xWriter;
+        pthread_t xReaderThread, xWriterThread;
+
+        memset( &xReader, 0, sizeof( xReader ) );
+        memset( &xWriter, 0, sizeof( xWriter ) );
+        xReader.pxIOManager = pxIOManager;
+        xWriter.pxIOManager = pxIOManager;
+
+        prvStartTask( &xReaderThread, prvReaderTask, &xReader, pdTRUE );
+        prvStartTask( &xWriterThread, prvWriterTask, &xWriter, pdFALSE );
+        prvAssertWaiting( &xWriter );
+        TEST_ASSERT_EQUAL_UINT8( 1U, pxIOManager->ucFATLockWritersWaiting );
+
+        prvStopTask( xReaderThread, &xReader );
+        prvStopTask( xWriterThread, &xWriter );
+        TEST_ASSERT_EQUAL_UINT32( 0U, xReader.ulExclusive );
+        TEST_ASSERT_EQUAL_UINT32( 2U, xWriter.ulOrder );
+
+        prvDeleteIOManager( pxIOManager );
+    #else /* if ( ffconfigFAT_LOCK_READERS != 0 ) */
+        TEST_IGNORE_MESSAGE( "Needs ffconfigFAT_LOCK_READERS" );
+    #endif /* if ( ffconfigFAT_LOCK_READERS != 0 ) */
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Once a writer waits for the FAT, a new reader is not admitted, even though
+ * another reader still has the FAT.  It gets the lock after the writer.
+ */
+void test_LockFATShared_waits_for_a_waiting_writer( void )
+{
+    #if ( ffconfigFAT_LOCK_READERS != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateIOManager( TEST_WAIT_CACHE );
+        LockTask_t xFirst, xWriter, xSecond;
+        pthread_t xFirstThread, xWriterThread, xSecondThread;
+
+        memset( &xFirst, 0, sizeof( xFirst ) );
+        memset( &xWriter, 0, sizeof( xWriter ) );
+        memset( &xSecond, 0, sizeof( xSecond ) );
+        xFirst.pxIOManager = pxIOManager;
+        xWriter.pxIOManager = pxIOManager;
+        xSecond.pxIOManager = pxIOManager;
+
+        prvStartTask( &xFirstThread, prvReaderTask, &xFirst, pdTRUE );
+        prvStartTask( &xWriterThread, prvWriterTask, &xWriter, pdFALSE );
+
+        while( pxIOManager->ucFATLockWritersWaiting == 0U )
+        {
+            vTaskDelay( 1 );
+        }
+
+        prvStartTask( &xSecondThread, prvReaderTask, &xSecond, pdFALSE );
+        prvAssertWaiting( &xSecond );
+        TEST_ASSERT_EQUAL_UINT8( 1U, pxIOManager->ucFATLockReaderCount );
+
+        /* The writer gets the lock, and holds it until it is released. */
+        prvStopTask( xFirstThread, &xFirst );
+        prvWaitLocked( &xWriter );
+        prvAssertWaiting( &xSecond );
+
+        prvStopTask( xWriterThread, &xWriter );
+        prvStopTask( xSecondThread, &xSecond );
+        TEST_ASSERT_EQUAL_UINT32( 2U, xWriter.ulOrder );
+        TEST_ASSERT_EQUAL_UINT32( 3U, xSecond.ulOrder );
+        TEST_ASSERT_EQUAL_UINT32( 0U, xSecond.ulExclusive );
+
+        prvDeleteIOManager( pxIOManager );
+    #else /* if ( ffconfigFAT_LOCK_READERS != 0 ) */
+        TEST_IGNORE_MESSAGE( "Needs ffconfigFAT_LOCK_READERS" );
+    #endif /* if ( ffconfigFAT_LOCK_READERS != 0 ) */
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * When all ffconfigFAT_LOCK_READERS places are taken, one more reader takes
+ * the FAT lock exclusively: it waits for the others to be done, and gives
+ * the lock back with FF_UnlockFATShared().
+ */
+void test_LockFATShared_is_exclusive_when_the_readers_are_full( void )
+{
+    #if ( ffconfigFAT_LOCK_READERS != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateIOManager( TEST_WAIT_CACHE );
+        LockTask_t xReaders[ ffconfigFAT_LOCK_READERS + 1 ];
+        pthread_t xThreads[ ffconfigFAT_LOCK_READERS + 1 ];
+        LockTask_t * pxLast = &( xReaders[ ffconfigFAT_LOCK_READERS ] );
+        BaseType_t xIndex;
+
+        memset( xReaders, 0, sizeof( xReaders ) );
+
+        for( xIndex = 0; xIndex <= ffconfigFAT_LOCK_READERS; xIndex++ )
+        {
+            xReaders[ xIndex ].pxIOManager = pxIOManager;
+            prvStartTask( &( xThreads[ xIndex ] ), prvReaderTask, &( xReaders[ xIndex ] ), xIndex < ffconfigFAT_LOCK_READERS );
+        }
+
+        prvAssertWaiting( pxLast );
+        TEST_ASSERT_EQUAL_UINT8( ffconfigFAT_LOCK_READERS, pxIOManager->ucFATLockReaderCount );
+        TEST_ASSERT_EQUAL_UINT8( 1U, pxIOManager->ucFATLockWritersWaiting );
+
+        for( xIndex = 0; xIndex < ffconfigFAT_LOCK_READERS; xIndex++ )
+        {
+            prvStopTask( xThreads[ xIndex ], &( xReaders[ xIndex ] ) );
+            TEST_ASSERT_EQUAL_UINT32( 0U, xReaders[ xIndex ].ulExclusive );
+        }
+
+        prvStopTask( xThreads[ ffconfigFAT_LOCK_READERS ], pxLast );
+        TEST_ASSERT_EQUAL_UINT32( 1U, pxLast->ulExclusive );
+        TEST_ASSERT_EQUAL_UINT32( ffconfigFAT_LOCK_READERS + 1U, pxLast->ulOrder );
+
+        /* Everything was given back. */
+        TEST_ASSERT_EQUAL_UINT8( 0U, pxIOManager->ucFATLockReaderCount );
+        TEST_ASSERT_EQUAL_UINT8( 0U, pxIOManager->ucFATLockWritersWaiting );
+        TEST_ASSERT_NULL( pxIOManager->pvFATLockHandle );
+
+        prvDeleteIOManager( pxIOManager );
+    #else /* if ( ffconfigFAT_LOCK_READERS != 0 ) */
+        TEST_IGNORE_MESSAGE( "Needs ffconfigFAT_LOCK_READERS" );
+    #endif /* if ( ffconfigFAT_LOCK_READERS != 0 ) */
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * FF_CreateDirent() locks ( directory cluster % ffconfigDIRECTORY_LOCKS ).
+ * While that lock is held, a file can not be created in another directory
+ * with the same lock, but it can in a directory with a different lock.
+ */
+void test_CreateDirent_waits_for_a_directory_with_the_same_lock( void )
+{
+    #if ( ffconfigDIRECTORY_LOCKS != 0 )
+        FF_IOManager_t * pxIOManager = prvCreateVolume();
+        LockTask_t xSame, xOther;
+        pthread_t xSameThread, xOtherThread;
+        char pcName[ 16 ];
+        char pcSamePath[ 32 ];
+        uint32_t ulClusters[ ffconfigDIRECTORY_LOCKS + 1 ];
+        FF_Error_t xError = FF_ERR_NONE;
+        uint32_t ulIndex;
+
+        /* Directories are created in clusters that follow each other. */
+        for( ulIndex = 0U; ulIndex <= ffconfigDIRECTORY_LOCKS; ulIndex++ )
+        {
+            snprintf( pcName, sizeof( pcName ), "/d%u", ( unsigned ) ulIndex );
+            TEST_ASSERT_FALSE( FF_isERR( FF_MkDir( pxIOManager, pcName ) ) );
+            ulClusters[ ulIndex ] = FF_FindDir( pxIOManager, pcName, ( uint16_t ) strlen( pcName ), &xError );
+            TEST_ASSERT_FALSE( FF_isERR( xError ) );
+        }
+
+        TEST_ASSERT_EQUAL_UINT32( ulClusters[ 0 ] % ffconfigDIRECTORY_LOCKS, ulClusters[ ffconfigDIRECTORY_LOCKS ] % ffconfigDIRECTORY_LOCKS );
+        TEST_ASSERT_NOT_EQUAL( ulClusters[ 0 ] % ffconfigDIRECTORY_LOCKS, ulClusters[ 1 ] % ffconfigDIRECTORY_LOCKS );
+
+        memset( &xSame, 0, sizeof( xSame ) );
+        memset( &xOther, 0, sizeof( xOther ) );
+        xSame.pxIOManager = pxIOManager;
+        snprintf( pcSamePath, sizeof( pcSamePath ), "%s/same.txt", pcName );
+        xSame.pcPath = pcSamePath;
+        xOther.pxIOManager = pxIOManager;
+        xOther.pcPath = "/d1/other.txt";
+
+        /* Hold the lock of /d0, as FF_CreateDirent() does. */
+        FF_LockDirectoryCluster( pxIOManager, ulClusters[ 0 ] );
+        {
+            prvStartTask( &xSameThread, prvCreateFileTask, &xSame, pdFALSE );
+            prvStartTask( &xOtherThread, prvCreateFileTask, &xOther, pdTRUE );
+            prvAssertWaiting( &xSame );
+        }
+        FF_UnlockDirectoryCluster( pxIOManager, ulClusters[ 0 ] );
+
+        prvStopTask( xSameThread, &xSame );
+        prvStopTask( xOtherThread, &xOther );
+        TEST_ASSERT_EQUAL_UINT32( 1U, prvCountEntries( pxIOManager, pcName ) );
+        TEST_ASSERT_EQUAL_UINT32( 1U, prvCountEntries( pxIOManager, "/d1" ) );
+
+        prvDeleteVolume( pxIOManager );
+    #else /* if ( ffconfigDIRECTORY_LOCKS != 0 ) */
+        TEST_IGNORE_MESSAGE( "Needs ffconfigDIRECTORY_LOCKS" );
+    #endif /* if ( ffconfigDIRECTORY_LOCKS != 0 ) */
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,381 @@
+/*
+ * Unit tests for ff_readdir_batch(), ff_fflush() and ff_fallocate() in
+ * ff_stdio.c.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * A FAT volume is formatted on an in-memory block device and added to the
+ * file systems of ff_sys.c as "/ram".  Directories are listed with
+ * ff_readdir_batch(), in several calls, and the entries are compared with
+ * the ones returned by ff_findfirst() / ff_findnext().
+ *
+ * The stdio, directory, FAT, file, format and I/O manager layers run for
+ * real, only the locking layer is a CMock generated mock.  The test source
+ * supplies the thread local storage that ff_stdio.c uses for errno, and
+ * the scheduler functions of ff_sys.c.
+ */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "unity.h"
+
+/* CMock generated mock of the locking layer. */
+#include "mock_ff_locking.h"
+
+#include "ff_headers.h"
+#include "ff_test_disk.h"
+#include "ff_stdio.h"
+#include "ff_sys.h"
+
+/*-----------------------------------------------------------*/
+/* Test parameters.                                           */
+/*-----------------------------------------------------------*/
+
+#define TEST_DISK_SECTORS      ( 16384U ) /* 8 MB. */
+#define TEST_CACHE_SECTORS     ( 16U )
+
+#define TEST_FILE_COUNT        ( 300U )
+
+/* The listing also holds "." and "..", and one free element lets a full
+ * listing still reach the end of the directory. */
+#define TEST_MAX_ENTRIES       ( TEST_FILE_COUNT + 3U )
+
+static FF_DirInfo_t xExpected[ TEST_MAX_ENTRIES ];
+static FF_DirInfo_t xFound[ TEST_MAX_ENTRIES ];
+
+/* errno, the CWD and the +FAT error code of the one task that runs. */
+static void * pvThreadLocal[ configNUM_THREAD_LOCAL_STORAGE_POINTERS ];
+
+/*-----------------------------------------------------------*/
+/* Kernel functions used by ff_stdio.c.                       */
+/*-----------------------------------------------------------*/
+
+void vTaskSetThreadLocalStoragePointer( TaskHandle_t xTaskToSet,
+                                        BaseType_t xIndex,
+                                        void * pvValue )
+{
+    ( void ) xTaskToSet;
+
+    TEST_ASSERT_LESS_THAN_INT( configNUM_THREAD_LOCAL_STORAGE_POINTERS, xIndex );
+    pvThreadLocal[ xIndex ] = pvValue;
+}
+
+void * pvTaskGetThreadLocalStoragePointer( TaskHandle_t xTaskToQuery,
+                                           BaseType_t xIndex )
+{
+    ( void ) xTaskToQuery;
+
+    TEST_ASSERT_LESS_THAN_INT( configNUM_THREAD_LOCAL_STORAGE_POINTERS, xIndex );
+
+    return pvThreadLocal[ xIndex ];
+}
+
+/* FF_FS_Add() and FF_FS_Remove() suspend the scheduler, which does not run. */
+void vTaskSuspendAll( void )
+{
+}
+
+BaseType_t xTaskResumeAll( void )
+{
+    return pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+/* Listing helpers.                                           */
+/*-----------------------------------------------------------*/
+
+/* List a directory with ff_findfirst() and ff_findnext(). */
+static uint32_t prvListOneByOne( const char * pcDirectory,
+                                 FF_DirInfo_t * pxInfo )
+{
+    FF_FindData_t xFindData;
+    uint32_t ulCount = 0U;
+    int iResult;
+
+    memset( &xFindData, 0, sizeof( xFindData ) );
+
+    for( iResult = ff_findfirst( pcDirectory, &xFindData );
+         iResult == 0;
+         iResult = ff_findnext( &xFindData ) )
+    {
+        TEST_ASSERT_LESS_THAN_UINT32( TEST_MAX_ENTRIES, ulCount );
+        memset( &( pxInfo[ ulCount ] ), 0, sizeof( pxInfo[ ulCount ] ) );
+        pxInfo[ ulCount ].ulFileSize = xFindData.ulFileSize;
+        pxInfo[ ulCount ].ulObjectCluster = xFindData.xDirectoryEntry.ulObjectCluster;
+        pxInfo[ ulCount ].ucAttrib = xFindData.ucAttributes;
+        strcpy( pxInfo[ ulCount ].pcFileName, xFindData.pcFileName );
+        ulCount++;
+    }
+
+    TEST_ASSERT_EQUAL_INT( pdFREERTOS_ERRNO_ENMFILE, stdioGET_ERRNO() );
+
+    return ulCount;
+}
+
+/* List a directory with ff_readdir_batch(), asking for at most 'xBatchSize'
+ * entries per call.  Every call before the last one fills the array, and the
+ * listing ends with a call that returns 0. */
+static uint32_t prvListInBatches( const char * pcDirectory,
+                                  FF_DirInfo_t * pxInfo,
+                                  size_t xBatchSize )
+{
+    FF_FindData_t xFindData;
+    FF_DirInfo_t xExtra;
+    const char * pcPath = pcDirectory;
+    uint32_t ulCount = 0U;
+    int iResult;
+
+    memset( &xFindData, 0, sizeof( xFindData ) );
+
+    do
+    {
+        TEST_ASSERT_LESS_THAN_UINT32( TEST_MAX_ENTRIES, ulCount );
+
+        if( ( ulCount + xBatchSize ) > TEST_MAX_ENTRIES )
+        {
+            xBatchSize = TEST_MAX_ENTRIES - ulCount;
+        }
+
+        iResult = ff_readdir_batch( pcPath, &xFindData, &( pxInfo[ ulCount ] ), xBatchSize );
+        TEST_ASSERT_GREATER_OR_EQUAL_INT( 0, iResult );
+        TEST_ASSERT_LESS_OR_EQUAL_INT( ( int ) xBatchSize, iResult );
+        TEST_ASSERT_EQUAL_INT( 0, stdioGET_ERRNO() );
+
+        ulCount += ( uint32_t ) iResult;
+        pcPath = NULL;
+    } while( iResult == ( int ) xBatchSize );
+
+    /* A short array ends the listing, later calls keep returning 0. */
+    TEST_ASSERT_EQUAL_INT( 0, ff_readdir_batch( NULL, &xFindData, &xExtra, 1U ) );
+    TEST_ASSERT_EQUAL_INT( 0, ff_readdir_batch( NULL, &xFindData, &xExtra, 1U ) );
+
+    return ulCount;
+}
+
+static uint32_t prvCountName( const FF_DirInfo_t * pxInfo,
+                              uint32_t ulCount,
+                              const char * pcName )
+{
+    uint32_t ulIndex, ulFound = 0U;
+
+    for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+    {
+        if( strcmp( pxInfo[ ulIndex ].pcFileName, pcName ) == 0 )
+        {
+            ulFound++;
+        }
+    }
+
+    return ulFound;
+}
+
+/*-----------------------------------------------------------*/
+/* Unity fixtures.                                            */
+/*-----------------------------------------------------------*/
+
+void setUp( void )
+{
+    vTestDiskInit( TEST_DISK_SECTORS );
+    memset( pvThreadLocal, 0, sizeof( pvThreadLocal ) );
+
+    FF_CreateEvents_IgnoreAndReturn( pdTRUE );
+    FF_DeleteEvents_Ignore();
+    FF_PendSemaphore_Ignore();
+    FF_ReleaseSemaphore_Ignore();
+    FF_BufferWait_IgnoreAndReturn( pdTRUE );
+    FF_BufferProceed_Ignore();
+    FF_Sleep_Ignore();
+    FF_LockDirectory_Ignore();
+    FF_UnlockDirectory_Ignore();
+    FF_LockDirectoryCluster_Ignore();
+    FF_UnlockDirectoryCluster_Ignore();
+    FF_LockFAT_Ignore();
+    FF_UnlockFAT_Ignore();
+    FF_LockFATShared_Ignore();
+    FF_UnlockFATShared_Ignore();
+    FF_Has_Lock_IgnoreAndReturn( pdFALSE );
+    FF_Assert_Lock_Ignore();
+
+    /* The volume is added as "/ram". */
+    FF_FS_Init();
+    ( void ) pxTestDiskCreateVolume( TEST_CACHE_SECTORS );
+    TEST_ASSERT_EQUAL_INT( pdTRUE, FF_FS_Add( "/ram", &xTestDisk ) );
+}
+
+void tearDown( void )
+{
+    if( xTestDisk.pxIOManager != NULL )
+    {
+        FF_FS_Remove( "/ram" );
+    }
+
+    vTestDiskFree();
+}
+
+/*-----------------------------------------------------------*/
+/* Tests.                                                     */
+/*-----------------------------------------------------------*/
+
+/*
+ * A listing that is continued over many calls gives the entries of
+ * ff_findnext(), in the same order, whatever the size of the array.
+ */
+void test_readdir_batch_returns_the_entries_of_findnext( void )
+{
+    const size_t xBatchSizes[] = { 1U, 7U, 64U, TEST_MAX_ENTRIES };
+    uint32_t ulExpected, ulCount, ulIndex;
+
+    vTestDiskCreateFiles( xTestDisk.pxIOManager, "/dir", TEST_FILE_COUNT );
+
+    ulExpected = prvListOneByOne( "/ram/dir", xExpected );
+    TEST_ASSERT_EQUAL_UINT32( TEST_FILE_COUNT + 2U, ulExpected );
+
+    for( ulIndex = 0; ulIndex < ( sizeof( xBatchSizes ) / sizeof( xBatchSizes[ 0 ] ) ); ulIndex++ )
+    {
+        memset( xFound, 0, sizeof( xFound ) );
+        ulCount = prvListInBatches( "/ram/dir", xFound, xBatchSizes[ ulIndex ] );
+        TEST_ASSERT_EQUAL_UINT32( ulExpected, ulCount );
+        vTestDiskAssertSameEntries( xExpected, xFound, ulCount );
+    }
+}
+
+/*
+ * "." and ".." are listed once.  A sub-directory has them on disk, and they
+ * must not be added again at the end.  The root directory of "/ram" has
+ * none, they are added after the last file.  The listing of "/" has "."
+ * and the entry "ram".
+ */
+void test_readdir_batch_lists_the_dot_entries_once( void )
+{
+    uint32_t ulCount;
+
+    vTestDiskCreateFiles( xTestDisk.pxIOManager, "/dir", 10U );
+    vTestDiskCreateFiles( xTestDisk.pxIOManager, "/dir/sub", 3U );
+
+    ulCount = prvListInBatches( "/ram/dir/sub", xFound, 2U );
+    TEST_ASSERT_EQUAL_UINT32( 5U, ulCount );
+    TEST_ASSERT_EQUAL_STRING( ".", xFound[ 0 ].pcFileName );
+    TEST_ASSERT_EQUAL_STRING( "..", xFound[ 1 ].pcFileName );
+
+    /* "dir" and the dot-entries. */
+    ulCount = prvListInBatches( "/ram", xFound, 2U );
+    TEST_ASSERT_EQUAL_UINT32( 3U, ulCount );
+    TEST_ASSERT_EQUAL_STRING( "dir", xFound[ 0 ].pcFileName );
+    TEST_ASSERT_EQUAL_STRING( "..", xFound[ 1 ].pcFileName );
+    TEST_ASSERT_EQUAL_STRING( ".", xFound[ 2 ].pcFileName );
+    TEST_ASSERT_EQUAL_UINT32( prvListOneByOne( "/ram", xExpected ), ulCount );
+    vTestDiskAssertSameEntries( xExpected, xFound, ulCount );
+
+    ulCount = prvListInBatches( "/", xFound, 1U );
+    TEST_ASSERT_EQUAL_UINT32( 2U, ulCount );
+    TEST_ASSERT_EQUAL_UINT32( 1U, prvCountName( xFound, ulCount, "ram" ) );
+    TEST_ASSERT_EQUAL_UINT32( 1U, prvCountName( xFound, ulCount, "." ) );
+    TEST_ASSERT_EQUAL_UINT32( 0U, prvCountName( xFound, ulCount, ".." ) );
+}
+
+/*
+ * An empty array returns 0 without ending the listing, a missing directory
+ * returns -1 with errno set, and a listing that has ended returns 0.
+ */
+void test_readdir_batch_reports_the_end_and_errors( void )
+{
+    FF_FindData_t xFindData;
+
+    vTestDiskCreateFiles( xTestDisk.pxIOManager, "/dir", 3U );
+
+    memset( &xFindData, 0, sizeof( xFindData ) );
+    TEST_ASSERT_EQUAL_INT( -1, ff_readdir_batch( "/ram/none", &xFindData, xFound, 8U ) );
+    TEST_ASSERT_NOT_EQUAL( 0, stdioGET_ERRNO() );
+    TEST_ASSERT_EQUAL_INT( FF_ERR_FILE_INVALID_PATH, FF_GETERROR( stdioGET_FF_ERROR() ) );
+
+    memset( &xFindData, 0, sizeof( xFindData ) );
+    TEST_ASSERT_EQUAL_INT( 1, ff_readdir_batch( "/ram/dir", &xFindData, xFound, 1U ) );
+    TEST_ASSERT_EQUAL_STRING( ".", xFound[ 0 ].pcFileName );
+    TEST_ASSERT_EQUAL_INT( 0, ff_readdir_batch( NULL, &xFindData, xFound, 0U ) );
+
+    /* ".." and the 3 files, the position was not changed by the empty array. */
+    TEST_ASSERT_EQUAL_INT( 4, ff_readdir_batch( NULL, &xFindData, xFound, 8U ) );
+    TEST_ASSERT_EQUAL_UINT32( 5U, prvListOneByOne( "/ram/dir", xExpected ) );
+    vTestDiskAssertSameEntries( &( xExpected[ 1 ] ), xFound, 4U );
+    TEST_ASSERT_EQUAL_INT( 0, ff_readdir_batch( NULL, &xFindData, xFound, 8U ) );
+    TEST_ASSERT_EQUAL_INT( 0, stdioGET_ERRNO() );
+}
+
+/*
+ * ff_fflush() writes what was written to a stream so far, the stream stays
+ * open.  Without a stream it fails.
+ */
+void test_fflush_writes_the_stream( void )
+{
+    FF_FILE * pxStream;
+    char pcData[ 64 ];
+
+    pxStream = ff_fopen( "/ram/flush.txt", "w" );
+    TEST_ASSERT_NOT_NULL( pxStream );
+    TEST_ASSERT_EQUAL_UINT32( 11U, ( uint32_t ) ff_fwrite( "hello flush", 1, 11U, pxStream ) );
+
+    TEST_ASSERT_EQUAL_INT( 0, ff_fflush( pxStream ) );
+    TEST_ASSERT_EQUAL_INT( 0, stdioGET_ERRNO() );
+    TEST_ASSERT_EQUAL_UINT32( 5U, ( uint32_t ) ff_fwrite( " more", 1, 5U, pxStream ) );
+    TEST_ASSERT_EQUAL_INT( 0, ff_fclose( pxStream ) );
+
+    TEST_ASSERT_EQUAL_INT( -1, ff_fflush( NULL ) );
+    TEST_ASSERT_NOT_EQUAL( 0, stdioGET_ERRNO() );
+
+    pxStream = ff_fopen( "/ram/flush.txt", "r" );
+    TEST_ASSERT_NOT_NULL( pxStream );
+    memset( pcData, 0, sizeof( pcData ) );
+    TEST_ASSERT_EQUAL_UINT32( 16U, ( uint32_t ) ff_fread( pcData, 1, sizeof( pcData ), pxStream ) );
+    TEST_ASSERT_EQUAL_STRING( "hello flush more", pcData );
+    TEST_ASSERT_EQUAL_INT( 0, ff_fclose( pxStream ) );
+}
+
+/*
+ * ff_fallocate() returns -1 with errno EINVAL for a negative offset, a length
+ * that is not positive or an unknown mode, and EFBIG when the end would be
+ * beyond 4 GB - 1 (only possible where long has more than 32 bits).  Valid
+ * calls reserve the space, with FF_FALLOC_KEEP_SIZE the length stays.
+ */
+void test_fallocate_checks_its_arguments( void )
+{
+    FF_FILE * pxStream;
+
+    pxStream = ff_fopen( "/ram/alloc.bin", "w" );
+    TEST_ASSERT_NOT_NULL( pxStream );
+
+    TEST_ASSERT_EQUAL_INT( -1, ff_fallocate( pxStream, 0, -1L, 512L ) );
+    TEST_ASSERT_EQUAL_INT( pdFREERTOS_ERRNO_EINVAL, stdioGET_ERRNO() );
+    TEST_ASSERT_EQUAL_INT( -1, ff_fallocate( pxStream, 0, 0L, 0L ) );
+    TEST_ASSERT_EQUAL_INT( pdFREERTOS_ERRNO_EINVAL, stdioGET_ERRNO() );
+    TEST_ASSERT_EQUAL_INT( -1, ff_fallocate( pxStream, 0, 0L, -512L ) );
+    TEST_ASSERT_EQUAL_INT( pdFREERTOS_ERRNO_EINVAL, stdioGET_ERRNO() );
+    TEST_ASSERT_EQUAL_INT( -1, ff_fallocate( pxStream, FF_FALLOC_KEEP_SIZE << 1, 0L, 512L ) );
+    TEST_ASSERT_EQUAL_INT( pdFREERTOS_ERRNO_EINVAL, stdioGET_ERRNO() );
+
+    #if ( LONG_MAX > 0x7FFFFFFFL )
+    {
+        TEST_ASSERT_EQUAL_INT( -1, ff_fallocate( pxStream, 0, 0xFFFFFFFFL, 1L ) );
+        TEST_ASSERT_EQUAL_INT( pdFREERTOS_ERRNO_EFBIG, stdioGET_ERRNO() );
+        TEST_ASSERT_EQUAL_INT( -1, ff_fallocate( pxStream, 0, 0x100000000L, 512L ) );
+        TEST_ASSERT_EQUAL_INT( pdFREERTOS_ERRNO_EFBIG, stdioGET_ERRNO() );
+        TEST_ASSERT_EQUAL_INT( -1, ff_fallocate( pxStream, 0, 1L, 0xFFFFFFFFL ) );
+        TEST_ASSERT_EQUAL_INT( pdFREERTOS_ERRNO_EFBIG, stdioGET_ERRNO() );
+    }
+    #endif
+
+    /* Nothing was allocated by the calls that failed. */
+    TEST_ASSERT_EQUAL_UINT32( 0U, ( uint32_t ) ff_filelength( pxStream ) );
+
+    TEST_ASSERT_EQUAL_INT( 0, ff_fallocate( pxStream, FF_FALLOC_KEEP_SIZE, 0L, 4096L ) );
+    TEST_ASSERT_EQUAL_INT( 0, stdioGET_ERRNO() );
+    TEST_ASSERT_EQUAL_UINT32( 0U, ( uint32_t ) ff_filelength( pxStream ) );
+
+    TEST_ASSERT_EQUAL_INT( 0, ff_fallocate( pxStream, 0, 1000L, 3000L ) );
+    TEST_ASSERT_EQUAL_INT( 0, stdioGET_ERRNO() );
+    TEST_ASSERT_EQUAL_UINT32( 4000U, ( uint32_t ) ff_filelength( pxStream ) );
+
+    TEST_ASSERT_EQUAL_INT( 0, ff_fclose( pxStream ) );
+}
@@ -60,9 +60,17 @@ typedef uint32_t        StackType_t;
     #define configASSERT( x )    assert( x )
 #endif
 
-/* Critical-section macros become no-ops on the host. */
-#define taskENTER_CRITICAL()    do {} while( 0 )
-#define taskEXIT_CRITICAL()     do {} while( 0 )
+/* Critical-section macros become no-ops on the host, unless the test runs
+ * several tasks on kernel/posix_kernel.c. */
+#if defined( TEST_POSIX_KERNEL ) && ( TEST_POSIX_KERNEL != 0 )
+    void vTaskEnterCritical( void );
+    void vTaskExitCritical( void );
+    #define taskENTER_CRITICAL()    vTaskEnterCritical()
+    #define taskEXIT_CRITICAL()     vTaskExitCritical()
+#else
+    #define taskENTER_CRITICAL()    do {} while( 0 )
+    #define taskEXIT_CRITICAL()     do {} while( 0 )
+#endif
 #define taskYIELD()             do {} while( 0 )
 #define portYIELD()             do {} while( 0 )
 
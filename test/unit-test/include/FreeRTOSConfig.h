@@ -10,5 +10,12 @@
 #define configUSE_16_BIT_TICKS              0
 #define configSUPPORT_DYNAMIC_ALLOCATION    1
 #define configSUPPORT_STATIC_ALLOCATION     0
+#define configUSE_RECURSIVE_MUTEXES         1
+#define INCLUDE_vTaskDelay                  1
+#define configMINIMAL_STACK_SIZE            ( ( uint16_t ) 128 )
+#define configMAX_PRIORITIES                ( 5 )
+
+/* errno, the CWD and the +FAT error code of ff_stdio.c. */
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS    3
 
 #endif /* UNIT_TEST_FREERTOS_CONFIG_H */
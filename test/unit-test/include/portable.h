@@ -0,0 +1,15 @@
+/*
+ * Minimal FreeRTOS portable.h stub for host-based FreeRTOS+FAT unit tests.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef UNIT_TEST_PORTABLE_H
+#define UNIT_TEST_PORTABLE_H
+
+#include "FreeRTOS.h"
+
+void * pvPortMalloc( size_t xWantedSize );
+void vPortFree( void * pv );
+
+#endif /* UNIT_TEST_PORTABLE_H */
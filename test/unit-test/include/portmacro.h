@@ -0,0 +1,15 @@
+/*
+ * Minimal FreeRTOS portmacro.h stub for host-based FreeRTOS+FAT unit tests.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * The port types and macros are in FreeRTOS.h, this header only lets the
+ * drivers in portable/ include it.
+ */
+
+#ifndef UNIT_TEST_PORTMACRO_H
+#define UNIT_TEST_PORTMACRO_H
+
+#include "FreeRTOS.h"
+
+#endif /* UNIT_TEST_PORTMACRO_H */
@@ -0,0 +1,26 @@
+/*
+ * Minimal FreeRTOS queue.h stub for host-based FreeRTOS+FAT unit tests.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef UNIT_TEST_QUEUE_H
+#define UNIT_TEST_QUEUE_H
+
+#include "FreeRTOS.h"
+
+typedef void * QueueHandle_t;
+
+#define errQUEUE_FULL    ( ( BaseType_t ) 0 )
+
+QueueHandle_t xQueueCreate( UBaseType_t uxQueueLength,
+                            UBaseType_t uxItemSize );
+void vQueueDelete( QueueHandle_t xQueue );
+BaseType_t xQueueSend( QueueHandle_t xQueue,
+                       const void * pvItemToQueue,
+                       TickType_t xTicksToWait );
+BaseType_t xQueueReceive( QueueHandle_t xQueue,
+                          void * pvBuffer,
+                          TickType_t xTicksToWait );
+
+#endif /* UNIT_TEST_QUEUE_H */
@@ -16,5 +16,11 @@ void vSemaphoreDelete( SemaphoreHandle_t xSemaphore );
 BaseType_t xSemaphoreTakeRecursive( SemaphoreHandle_t xMutex,
                                     TickType_t xBlockTime );
 BaseType_t xSemaphoreGiveRecursive( SemaphoreHandle_t xMutex );
+SemaphoreHandle_t xSemaphoreCreateBinary( void );
+BaseType_t xSemaphoreTake( SemaphoreHandle_t xSemaphore,
+                           TickType_t xBlockTime );
+BaseType_t xSemaphoreGive( SemaphoreHandle_t xSemaphore );
+BaseType_t xSemaphoreGiveFromISR( SemaphoreHandle_t xSemaphore,
+                                  BaseType_t * pxHigherPriorityTaskWoken );
 
 #endif /* UNIT_TEST_SEMPHR_H */
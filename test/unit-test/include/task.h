@@ -10,8 +10,30 @@
 #include "FreeRTOS.h"
 
 typedef void * TaskHandle_t;
+typedef void (* TaskFunction_t)( void * pvParameters );
 
+#define tskIDLE_PRIORITY             ( ( UBaseType_t ) 0U )
+
+#define taskSCHEDULER_SUSPENDED      ( ( BaseType_t ) 0 )
+#define taskSCHEDULER_NOT_STARTED    ( ( BaseType_t ) 1 )
+#define taskSCHEDULER_RUNNING        ( ( BaseType_t ) 2 )
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char * const pcName,
+                        const uint16_t usStackDepth,
+                        void * const pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t * const pxCreatedTask );
+void vTaskDelete( TaskHandle_t xTaskToDelete );
 void vTaskDelay( TickType_t xTicksToDelay );
 TaskHandle_t xTaskGetCurrentTaskHandle( void );
+BaseType_t xTaskGetSchedulerState( void );
+void vTaskSuspendAll( void );
+BaseType_t xTaskResumeAll( void );
+void vTaskSetThreadLocalStoragePointer( TaskHandle_t xTaskToSet,
+                                        BaseType_t xIndex,
+                                        void * pvValue );
+void * pvTaskGetThreadLocalStoragePointer( TaskHandle_t xTaskToQuery,
+                                           BaseType_t xIndex );
 
 #endif /* UNIT_TEST_TASK_H */
@@ -0,0 +1,505 @@
+/*
+ * A stand-in for the FreeRTOS kernel functions used by ff_locking.c, built
+ * on POSIX threads.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * This is NOT the FreeRTOS kernel.  It lets the real locking layer run on a
+ * host, with every task being a POSIX thread that the test starts itself.
+ * Only what ff_locking.c and the asynchronous driver interface need is here:
+ * recursive mutexes, binary semaphores, event groups, vTaskDelay() and
+ * vTaskSuspendAll() / xTaskResumeAll().  Ticks are milliseconds.
+ *
+ * xTaskCreate() starts a detached thread for the background free-cluster
+ * scan, and the critical sections are real when TEST_POSIX_KERNEL is set.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "event_groups.h"
+
+typedef struct
+{
+    pthread_mutex_t xMutex;
+    pthread_cond_t xCondition;
+    uint32_t ulCount;       /* 1 when the semaphore can be taken. */
+    BaseType_t xRecursive;  /* pdTRUE for a recursive mutex. */
+    pthread_t xOwner;       /* The owner of a recursive mutex. */
+    uint32_t ulDepth;       /* The number of times the owner has taken it. */
+} Semaphore_t;
+
+typedef struct
+{
+    pthread_mutex_t xMutex;
+    pthread_cond_t xCondition;
+    EventBits_t uxBits;
+} EventGroup_t;
+
+/* vTaskSuspendAll() only keeps out the other tasks that suspend all.  It may
+ * be nested, so the mutex is recursive. */
+static pthread_once_t xSuspendOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t xSuspendMutex;
+
+/* A critical section keeps out the other tasks that enter one. */
+static pthread_once_t xCriticalOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t xCriticalMutex;
+
+/* What the thread started by xTaskCreate() must run. */
+typedef struct
+{
+    TaskFunction_t pxTaskCode;
+    void * pvParameters;
+} TaskStart_t;
+
+/* The address of this variable identifies the calling task. */
+static __thread uint8_t ucTaskIdentity;
+
+/*-----------------------------------------------------------*/
+
+/* Turn a time-out in ticks into a deadline for pthread_cond_timedwait(). */
+static void prvDeadline( struct timespec * pxDeadline,
+                         TickType_t xTicksToWait )
+{
+    clock_gettime( CLOCK_REALTIME, pxDeadline );
+    pxDeadline->tv_sec += ( time_t ) ( xTicksToWait / 1000U );
+    pxDeadline->tv_nsec += ( long ) ( xTicksToWait % 1000U ) * 1000000L;
+
+    if( pxDeadline->tv_nsec >= 1000000000L )
+    {
+        pxDeadline->tv_sec++;
+        pxDeadline->tv_nsec -= 1000000000L;
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Wait on a condition until it is signalled or the deadline passes.  Return
+ * pdFALSE once the deadline has passed. */
+static BaseType_t prvWait( pthread_cond_t * pxCondition,
+                           pthread_mutex_t * pxMutex,
+                           TickType_t xTicksToWait,
+                           const struct timespec * pxDeadline )
+{
+    int iResult;
+
+    if( xTicksToWait == portMAX_DELAY )
+    {
+        iResult = pthread_cond_wait( pxCondition, pxMutex );
+    }
+    else
+    {
+        iResult = pthread_cond_timedwait( pxCondition, pxMutex, pxDeadline );
+    }
+
+    return ( iResult == ETIMEDOUT ) ? pdFALSE : pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskGetSchedulerState( void )
+{
+    return taskSCHEDULER_RUNNING;
+}
+/*-----------------------------------------------------------*/
+
+static void * prvTaskStart( void * pvStart )
+{
+    TaskStart_t xStart = *( ( TaskStart_t * ) pvStart );
+
+    free( pvStart );
+    xStart.pxTaskCode( xStart.pvParameters );
+
+    return NULL;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char * const pcName,
+                        const uint16_t usStackDepth,
+                        void * const pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t * const pxCreatedTask )
+{
+    TaskStart_t * pxStart;
+    pthread_attr_t xAttributes;
+    pthread_t xThread;
+    BaseType_t xResult = pdFAIL;
+
+    ( void ) pcName;
+    ( void ) usStackDepth;
+    ( void ) uxPriority;
+
+    /* Handles of other tasks are not supported. */
+    configASSERT( pxCreatedTask == NULL );
+
+    pxStart = ( TaskStart_t * ) malloc( sizeof( *pxStart ) );
+
+    if( pxStart != NULL )
+    {
+        pxStart->pxTaskCode = pxTaskCode;
+        pxStart->pvParameters = pvParameters;
+
+        pthread_attr_init( &xAttributes );
+        pthread_attr_setdetachstate( &xAttributes, PTHREAD_CREATE_DETACHED );
+
+        if( pthread_create( &xThread, &xAttributes, prvTaskStart, pxStart ) == 0 )
+        {
+            xResult = pdPASS;
+        }
+        else
+        {
+            free( pxStart );
+        }
+
+        pthread_attr_destroy( &xAttributes );
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+void vTaskDelete( TaskHandle_t xTaskToDelete )
+{
+    /* A task can only delete itself. */
+    configASSERT( xTaskToDelete == NULL );
+
+    pthread_exit( NULL );
+}
+/*-----------------------------------------------------------*/
+
+TaskHandle_t xTaskGetCurrentTaskHandle( void )
+{
+    return ( TaskHandle_t ) &ucTaskIdentity;
+}
+/*-----------------------------------------------------------*/
+
+void vTaskDelay( TickType_t xTicksToDelay )
+{
+    struct timespec xDelay;
+
+    if( xTicksToDelay == 0U )
+    {
+        ( void ) sched_yield();
+    }
+    else
+    {
+        xDelay.tv_sec = ( time_t ) ( xTicksToDelay / 1000U );
+        xDelay.tv_nsec = ( long ) ( xTicksToDelay % 1000U ) * 1000000L;
+        ( void ) nanosleep( &xDelay, NULL );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvSuspendInit( void )
+{
+    pthread_mutexattr_t xAttributes;
+
+    pthread_mutexattr_init( &xAttributes );
+    pthread_mutexattr_settype( &xAttributes, PTHREAD_MUTEX_RECURSIVE );
+    pthread_mutex_init( &xSuspendMutex, &xAttributes );
+    pthread_mutexattr_destroy( &xAttributes );
+}
+/*-----------------------------------------------------------*/
+
+void vTaskSuspendAll( void )
+{
+    ( void ) pthread_once( &xSuspendOnce, prvSuspendInit );
+    pthread_mutex_lock( &xSuspendMutex );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskResumeAll( void )
+{
+    pthread_mutex_unlock( &xSuspendMutex );
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvCriticalInit( void )
+{
+    pthread_mutexattr_t xAttributes;
+
+    pthread_mutexattr_init( &xAttributes );
+    pthread_mutexattr_settype( &xAttributes, PTHREAD_MUTEX_RECURSIVE );
+    pthread_mutex_init( &xCriticalMutex, &xAttributes );
+    pthread_mutexattr_destroy( &xAttributes );
+}
+/*-----------------------------------------------------------*/
+
+void vTaskEnterCritical( void )
+{
+    ( void ) pthread_once( &xCriticalOnce, prvCriticalInit );
+    pthread_mutex_lock( &xCriticalMutex );
+}
+/*-----------------------------------------------------------*/
+
+void vTaskExitCritical( void )
+{
+    pthread_mutex_unlock( &xCriticalMutex );
+}
+/*-----------------------------------------------------------*/
+
+static SemaphoreHandle_t prvCreateSemaphore( uint32_t ulCount,
+                                             BaseType_t xRecursive )
+{
+    Semaphore_t * pxSemaphore = ( Semaphore_t * ) calloc( 1, sizeof( *pxSemaphore ) );
+
+    if( pxSemaphore != NULL )
+    {
+        pthread_mutex_init( &( pxSemaphore->xMutex ), NULL );
+        pthread_cond_init( &( pxSemaphore->xCondition ), NULL );
+        pxSemaphore->ulCount = ulCount;
+        pxSemaphore->xRecursive = xRecursive;
+    }
+
+    return ( SemaphoreHandle_t ) pxSemaphore;
+}
+/*-----------------------------------------------------------*/
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex( void )
+{
+    return prvCreateSemaphore( 1U, pdTRUE );
+}
+/*-----------------------------------------------------------*/
+
+SemaphoreHandle_t xSemaphoreCreateBinary( void )
+{
+    return prvCreateSemaphore( 0U, pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+void vSemaphoreDelete( SemaphoreHandle_t xSemaphore )
+{
+    Semaphore_t * pxSemaphore = ( Semaphore_t * ) xSemaphore;
+
+    pthread_cond_destroy( &( pxSemaphore->xCondition ) );
+    pthread_mutex_destroy( &( pxSemaphore->xMutex ) );
+    free( pxSemaphore );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xSemaphoreTake( SemaphoreHandle_t xSemaphore,
+                           TickType_t xBlockTime )
+{
+    Semaphore_t * pxSemaphore = ( Semaphore_t * ) xSemaphore;
+    struct timespec xDeadline;
+    BaseType_t xReturn = pdTRUE;
+
+    pthread_mutex_lock( &( pxSemaphore->xMutex ) );
+
+    if( ( pxSemaphore->xRecursive != pdFALSE ) &&
+        ( pxSemaphore->ulDepth != 0U ) &&
+        ( pthread_equal( pxSemaphore->xOwner, pthread_self() ) != 0 ) )
+    {
+        pxSemaphore->ulDepth++;
+    }
+    else
+    {
+        if( xBlockTime != portMAX_DELAY )
+        {
+            prvDeadline( &xDeadline, xBlockTime );
+        }
+
+        while( ( pxSemaphore->ulCount == 0U ) && ( xReturn != pdFALSE ) )
+        {
+            xReturn = prvWait( &( pxSemaphore->xCondition ), &( pxSemaphore->xMutex ), xBlockTime, &xDeadline );
+        }
+
+        if( pxSemaphore->ulCount != 0U )
+        {
+            pxSemaphore->ulCount = 0U;
+            pxSemaphore->xOwner = pthread_self();
+            pxSemaphore->ulDepth = 1U;
+            xReturn = pdTRUE;
+        }
+    }
+
+    pthread_mutex_unlock( &( pxSemaphore->xMutex ) );
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xSemaphoreGive( SemaphoreHandle_t xSemaphore )
+{
+    Semaphore_t * pxSemaphore = ( Semaphore_t * ) xSemaphore;
+    BaseType_t xReturn = pdFALSE;
+
+    pthread_mutex_lock( &( pxSemaphore->xMutex ) );
+
+    if( pxSemaphore->xRecursive != pdFALSE )
+    {
+        if( ( pxSemaphore->ulDepth != 0U ) && ( pthread_equal( pxSemaphore->xOwner, pthread_self() ) != 0 ) )
+        {
+            pxSemaphore->ulDepth--;
+            xReturn = pdTRUE;
+
+            if( pxSemaphore->ulDepth == 0U )
+            {
+                pxSemaphore->ulCount = 1U;
+                pthread_cond_broadcast( &( pxSemaphore->xCondition ) );
+            }
+        }
+    }
+    else if( pxSemaphore->ulCount == 0U )
+    {
+        pxSemaphore->ulCount = 1U;
+        pthread_cond_broadcast( &( pxSemaphore->xCondition ) );
+        xReturn = pdTRUE;
+    }
+
+    pthread_mutex_unlock( &( pxSemaphore->xMutex ) );
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xSemaphoreGiveFromISR( SemaphoreHandle_t xSemaphore,
+                                  BaseType_t * pxHigherPriorityTaskWoken )
+{
+    if( pxHigherPriorityTaskWoken != NULL )
+    {
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    }
+
+    return xSemaphoreGive( xSemaphore );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xSemaphoreTakeRecursive( SemaphoreHandle_t xMutex,
+                                    TickType_t xBlockTime )
+{
+    return xSemaphoreTake( xMutex, xBlockTime );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xSemaphoreGiveRecursive( SemaphoreHandle_t xMutex )
+{
+    return xSemaphoreGive( xMutex );
+}
+/*-----------------------------------------------------------*/
+
+EventGroupHandle_t xEventGroupCreate( void )
+{
+    EventGroup_t * pxGroup = ( EventGroup_t * ) calloc( 1, sizeof( *pxGroup ) );
+
+    if( pxGroup != NULL )
+    {
+        pthread_mutex_init( &( pxGroup->xMutex ), NULL );
+        pthread_cond_init( &( pxGroup->xCondition ), NULL );
+    }
+
+    return ( EventGroupHandle_t ) pxGroup;
+}
+/*-----------------------------------------------------------*/
+
+void vEventGroupDelete( EventGroupHandle_t xEventGroup )
+{
+    EventGroup_t * pxGroup = ( EventGroup_t * ) xEventGroup;
+
+    pthread_cond_destroy( &( pxGroup->xCondition ) );
+    pthread_mutex_destroy( &( pxGroup->xMutex ) );
+    free( pxGroup );
+}
+/*-----------------------------------------------------------*/
+
+EventBits_t xEventGroupSetBits( EventGroupHandle_t xEventGroup,
+                                const EventBits_t uxBitsToSet )
+{
+    EventGroup_t * pxGroup = ( EventGroup_t * ) xEventGroup;
+    EventBits_t uxBits;
+
+    pthread_mutex_lock( &( pxGroup->xMutex ) );
+    pxGroup->uxBits |= uxBitsToSet;
+    uxBits = pxGroup->uxBits;
+    pthread_cond_broadcast( &( pxGroup->xCondition ) );
+    pthread_mutex_unlock( &( pxGroup->xMutex ) );
+
+    return uxBits;
+}
+/*-----------------------------------------------------------*/
+
+EventBits_t xEventGroupClearBits( EventGroupHandle_t xEventGroup,
+                                  const EventBits_t uxBitsToClear )
+{
+    EventGroup_t * pxGroup = ( EventGroup_t * ) xEventGroup;
+    EventBits_t uxBits;
+
+    pthread_mutex_lock( &( pxGroup->xMutex ) );
+    uxBits = pxGroup->uxBits;
+    pxGroup->uxBits &= ~uxBitsToClear;
+    pthread_mutex_unlock( &( pxGroup->xMutex ) );
+
+    return uxBits;
+}
+/*-----------------------------------------------------------*/
+
+EventBits_t xEventGroupGetBits( EventGroupHandle_t xEventGroup )
+{
+    EventGroup_t * pxGroup = ( EventGroup_t * ) xEventGroup;
+    EventBits_t uxBits;
+
+    pthread_mutex_lock( &( pxGroup->xMutex ) );
+    uxBits = pxGroup->uxBits;
+    pthread_mutex_unlock( &( pxGroup->xMutex ) );
+
+    return uxBits;
+}
+/*-----------------------------------------------------------*/
+
+EventBits_t xEventGroupWaitBits( EventGroupHandle_t xEventGroup,
+                                 const EventBits_t uxBitsToWaitFor,
+                                 const BaseType_t xClearOnExit,
+                                 const BaseType_t xWaitForAllBits,
+                                 TickType_t xTicksToWait )
+{
+    EventGroup_t * pxGroup = ( EventGroup_t * ) xEventGroup;
+    struct timespec xDeadline;
+    BaseType_t xWaiting = pdTRUE;
+    BaseType_t xDone = pdFALSE;
+    EventBits_t uxBits;
+
+    pthread_mutex_lock( &( pxGroup->xMutex ) );
+
+    if( ( xTicksToWait != 0U ) && ( xTicksToWait != portMAX_DELAY ) )
+    {
+        prvDeadline( &xDeadline, xTicksToWait );
+    }
+
+    for( ; ; )
+    {
+        if( xWaitForAllBits != pdFALSE )
+        {
+            xDone = ( ( pxGroup->uxBits & uxBitsToWaitFor ) == uxBitsToWaitFor ) ? pdTRUE : pdFALSE;
+        }
+        else
+        {
+            xDone = ( ( pxGroup->uxBits & uxBitsToWaitFor ) != 0U ) ? pdTRUE : pdFALSE;
+        }
+
+        if( ( xDone != pdFALSE ) || ( xWaiting == pdFALSE ) || ( xTicksToWait == 0U ) )
+        {
+            break;
+        }
+
+        xWaiting = prvWait( &( pxGroup->xCondition ), &( pxGroup->xMutex ), xTicksToWait, &xDeadline );
+    }
+
+    uxBits = pxGroup->uxBits;
+
+    if( ( xDone != pdFALSE ) && ( xClearOnExit != pdFALSE ) )
+    {
+        pxGroup->uxBits &= ~uxBitsToWaitFor;
+    }
+
+    pthread_mutex_unlock( &( pxGroup->xMutex ) );
+
+    return uxBits;
+}
+/*-----------------------------------------------------------*/